@@ -0,0 +1,150 @@
+// Backend code quality benchmark
+//
+// Compiles a synthetic module of loop- and call-heavy functions, half of
+// them with more live locals than there are registers, and counts what
+// the backend emitted: instructions, memory loads (memory source operand)
+// and memory stores (memory destination operand), plus codegen time.
+// Arguments: number of function pairs (default 1000), target (x64 or
+// arm64, default x64), and "peephole" to run the machine-level peephole
+// pass as well (its time is part of codegen time).
+
+#include "syclang/lexer/lexer.h"
+#include "syclang/parser/parser.h"
+#include "syclang/ir/ir_generator.h"
+#include "syclang/codegen/x64/x64_codegen.h"
+#include "syclang/codegen/arm64/arm64_codegen.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace {
+
+std::string makeSource(size_t functions) {
+    std::string src;
+    for (size_t f = 0; f < functions; ++f) {
+        std::string n = std::to_string(f);
+        src += "fn mix_" + n + "() -> i64 {\n";
+        src += "    let mut a: i64 = " + n + ";\n";
+        src += "    let mut b: i64 = a * 3 + 1;\n";
+        src += "    let mut c: i64 = 0;\n";
+        src += "    let mut i: i64 = 0;\n";
+        src += "    while (i < 64) {\n";
+        src += "        a = a + b * i;\n";
+        src += "        b = b ^ (a >> 3);\n";
+        src += "        c = c + (a & b) - i;\n";
+        src += "        if (c > 1000) {\n";
+        src += "            c = c / 7;\n";
+        src += "        }\n";
+        src += "        i = i + 1;\n";
+        src += "    }\n";
+        src += "    let d: i64 = helper(a, b);\n";
+        src += "    return a + b + c + d;\n";
+        src += "}\n\n";
+
+        // More simultaneously live locals than allocatable registers
+        src += "fn spill_" + n + "() -> i64 {\n";
+        for (char v = 'a'; v <= 'l'; ++v) {
+            src += std::string("    let mut ") + v + ": i64 = " + std::to_string(v - 'a' + f) + ";\n";
+        }
+        src += "    let mut i: i64 = 0;\n";
+        src += "    while (i < 10) {\n";
+        for (char v = 'a'; v < 'l'; ++v) {
+            src += std::string("        ") + v + " = " + v + " + " + char(v + 1) + ";\n";
+        }
+        src += "        l = l + a % 7;\n";
+        src += "        a = a - helper(a, l);\n";
+        src += "        i += 1;\n";
+        src += "    }\n";
+        src += "    return a + b + c + d + e + f + g + h + i + j + k + l;\n";
+        src += "}\n\n";
+    }
+    return src;
+}
+
+struct Counts {
+    size_t instructions = 0;
+    size_t loads = 0;
+    size_t stores = 0;
+};
+
+Counts countMemoryOperands(const std::string& assembly) {
+    Counts counts;
+    size_t pos = 0;
+    while (pos < assembly.size()) {
+        size_t end = assembly.find('\n', pos);
+        if (end == std::string::npos) {
+            end = assembly.size();
+        }
+        std::string_view line(assembly.data() + pos, end - pos);
+        pos = end + 1;
+
+        // Instructions are indented; labels and directives are not
+        if (line.size() < 5 || line.substr(0, 4) != "    " || line[4] == '.') {
+            continue;
+        }
+        ++counts.instructions;
+        // AArch64 load/store mnemonics say which way data moves
+        std::string_view mnemonic = line.substr(4, 2);
+        if (mnemonic == "ld" || mnemonic == "st") {
+            ++(mnemonic == "ld" ? counts.loads : counts.stores);
+            continue;
+        }
+        size_t bracket = line.find('[');
+        if (bracket == std::string_view::npos || line.substr(4, 3) == "lea") {
+            continue;
+        }
+        size_t comma = line.find(',');
+        if (comma != std::string_view::npos && bracket < comma) {
+            ++counts.stores;
+        } else {
+            ++counts.loads;
+        }
+    }
+    return counts;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t functions = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000;
+    std::string source = makeSource(functions);
+
+    syclang::Lexer lexer(source);
+    auto tokens = lexer.tokenize();
+    syclang::Parser parser(tokens);
+    auto program = parser.parse();
+    syclang::IRGenerator irGen(syclang::Architecture::X64);
+    auto module = irGen.generate(program);
+
+    bool arm64 = argc > 2 && std::string(argv[2]) == "arm64";
+    std::unique_ptr<syclang::CodeGenerator> codegen;
+    if (arm64) {
+        codegen = std::make_unique<syclang::ARM64CodeGenerator>();
+    } else {
+        codegen = std::make_unique<syclang::X64CodeGenerator>();
+    }
+    bool peephole = argc > 3 && std::string(argv[3]) == "peephole";
+    codegen->setPeephole(peephole);
+
+    auto start = std::chrono::steady_clock::now();
+    codegen->generate(module);
+    double ms = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+
+    Counts counts = countMemoryOperands(codegen->getOutput());
+    std::printf("Codegen benchmark (%s%s): %zu functions, %zu IR instructions\n",
+                arm64 ? "arm64" : "x64", peephole ? ", peephole" : "", functions * 2,
+                static_cast<size_t>(module->arena.getStats().instructions));
+    std::printf("  %zu instructions, %zu loads, %zu stores (%.1f / %.1f per function)\n",
+                counts.instructions, counts.loads, counts.stores,
+                static_cast<double>(counts.loads) / (functions * 2),
+                static_cast<double>(counts.stores) / (functions * 2));
+    std::printf("  codegen %.2f ms, %zu bytes of assembly\n", ms, codegen->getOutput().size());
+    if (peephole) {
+        std::printf("%s", codegen->getPeepholeStats().format().c_str());
+    }
+    return 0;
+}
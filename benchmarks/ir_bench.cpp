@@ -0,0 +1,150 @@
+// IR construction benchmark
+//
+// Generates a synthetic ~100k-line SysLang module, then runs
+// lex -> parse -> IR generation -> optimization -> x64 codegen and
+// reports heap allocation counts and peak RSS per phase. Codegen runs
+// once serially and once on a thread pool (second argument: jobs,
+// default all cores).
+
+#include "syclang/lexer/lexer.h"
+#include "syclang/parser/parser.h"
+#include "syclang/ir/ir_generator.h"
+#include "syclang/optimizer/optimizer.h"
+#include "syclang/codegen/x64/x64_codegen.h"
+#include "syclang/thread_pool.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <sys/resource.h>
+
+namespace {
+
+size_t g_allocCount = 0;
+size_t g_allocBytes = 0;
+
+std::string makeSource(size_t targetLines) {
+    std::string src;
+    size_t lines = 0;
+    for (size_t f = 0; lines < targetLines; ++f) {
+        std::string name = "kernel_" + std::to_string(f);
+        src += "fn " + name + "() -> i64 {\n";
+        src += "    let mut x: i64 = " + std::to_string(f) + " + 5 * 3;\n";
+        src += "    let mut y: i64 = x - 7;\n";
+        src += "    let mut i: i64 = 0;\n";
+        src += "    while (i < 16) {\n";
+        src += "        x = x + y * i;\n";
+        src += "        y = y ^ (x >> 2);\n";
+        src += "        i = i + 1;\n";
+        src += "    }\n";
+        src += "    if (x > y) {\n";
+        src += "        return x & 255;\n";
+        src += "    } else {\n";
+        src += "        return y | 15;\n";
+        src += "    }\n";
+        src += "}\n\n";
+        lines += 16;
+    }
+    return src;
+}
+
+long peakRssKb() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+struct Phase {
+    size_t allocs;
+    size_t bytes;
+    std::chrono::steady_clock::time_point start;
+
+    Phase() : allocs(g_allocCount), bytes(g_allocBytes),
+              start(std::chrono::steady_clock::now()) {}
+
+    void report(const char* name) const {
+        double ms = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start).count();
+        std::printf("  %-14s %10zu allocs %12zu bytes %9.2f ms  peak RSS %ld KB\n",
+                    name, g_allocCount - allocs, g_allocBytes - bytes, ms, peakRssKb());
+    }
+};
+
+} // namespace
+
+void* operator new(size_t size) {
+    ++g_allocCount;
+    g_allocBytes += size;
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+int main(int argc, char* argv[]) {
+    size_t lines = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100000;
+    std::string source = makeSource(lines);
+
+    std::printf("IR benchmark: %zu lines, %zu bytes of source\n", lines, source.size());
+
+    Phase lexPhase;
+    syclang::Lexer lexer(source);
+    auto tokens = lexer.tokenize();
+    lexPhase.report("lex");
+
+    Phase parsePhase;
+    syclang::Parser parser(tokens);
+    auto program = parser.parse();
+    parsePhase.report("parse");
+
+    Phase irPhase;
+    syclang::IRGenerator irGen(syclang::Architecture::X64);
+    auto module = irGen.generate(program);
+    irPhase.report("irgen");
+
+    auto liveInstructions = [&]() {
+        size_t count = 0;
+        for (const auto& func : module->functions) {
+            for (syclang::BlockId block : func->blocks) {
+                count += module->arena.block(block).instructions.size();
+            }
+        }
+        return count;
+    };
+    size_t generated = liveInstructions();
+    Phase optPhase;
+    syclang::Optimizer optimizer;
+    optimizer.setOptimizationLevel(2);
+    optimizer.optimize(module);
+    optPhase.report("optimize");
+    std::printf("  %zu -> %zu instructions in blocks\n", generated, liveInstructions());
+
+    Phase serialPhase;
+    syclang::X64CodeGenerator serialCodegen;
+    serialCodegen.generate(module);
+    serialPhase.report("codegen");
+
+    syclang::ThreadPool pool(argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 0);
+    Phase parallelPhase;
+    syclang::X64CodeGenerator parallelCodegen;
+    parallelCodegen.setThreadPool(&pool);
+    parallelCodegen.generate(module);
+    parallelPhase.report(("codegen -j" + std::to_string(pool.concurrency())).c_str());
+    if (parallelCodegen.getOutput() != serialCodegen.getOutput()) {
+        std::printf("  parallel codegen output differs!\n");
+        return 1;
+    }
+
+    auto stats = module->arena.getStats();
+    std::printf("  %zu tokens, %zu functions, %zu parse errors\n", tokens.size(),
+                module->functions.size(), parser.getErrors().size());
+    std::printf("  arena: %u values (%u constants), %u instructions, %u blocks, "
+                "%u operands, %zu KB reserved\n",
+                stats.values, stats.constants, stats.instructions, stats.blocks,
+                stats.operands, stats.bytes / 1024);
+    return 0;
+}
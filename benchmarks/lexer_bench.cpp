@@ -0,0 +1,109 @@
+// Lexer throughput benchmark
+//
+// Generates a synthetic source file heavy on comments, indentation and
+// long identifiers, then reports tokenize() throughput and the raw speed
+// of each scan kernel for every instruction set the CPU supports.
+
+#include "syclang/lexer/lexer.h"
+#include "syclang/lexer/simd_scan.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+namespace {
+
+std::string makeSource(size_t targetLines) {
+    std::string src;
+    size_t lines = 0;
+    for (size_t f = 0; lines < targetLines; ++f) {
+        std::string name = "compute_accumulated_checksum_" + std::to_string(f);
+        src += "/*\n";
+        src += " * " + name + ": folds a block of samples into a running checksum.\n";
+        src += " * The loop body is intentionally simple; this comment is not.\n";
+        src += " */\n";
+        src += "fn " + name + "() -> i64 {\n";
+        src += "    // running state\n";
+        src += "    let mut accumulated_checksum_value: i64 = " + std::to_string(f) + ";\n";
+        src += "    let mut sample_index_counter: i64 = 0;\n";
+        src += "    while (sample_index_counter < 64) {\n";
+        src += "        accumulated_checksum_value = accumulated_checksum_value ^ sample_index_counter;\n";
+        src += "        sample_index_counter = sample_index_counter + 1;  // next sample\n";
+        src += "    }\n";
+        src += "    return accumulated_checksum_value;\n";
+        src += "}\n\n";
+        lines += 15;
+    }
+    return src;
+}
+
+template <typename Fn>
+double bestOfMs(int runs, Fn&& fn) {
+    double best = 1e300;
+    for (int i = 0; i < runs; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        double ms = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start).count();
+        if (ms < best) best = ms;
+    }
+    return best;
+}
+
+double megabytesPerSecond(size_t bytes, double ms) {
+    return bytes / (1024.0 * 1024.0) / (ms / 1000.0);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t lines = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 200000;
+    std::string source = makeSource(lines);
+    const char* begin = source.data();
+    const char* end = begin + source.size();
+    const int runs = 5;
+
+    std::printf("Lexer benchmark: %zu lines, %zu bytes of source\n", lines, source.size());
+
+    const syclang::ScanIsa isas[] = {
+        syclang::ScanIsa::SCALAR, syclang::ScanIsa::SSE2, syclang::ScanIsa::AVX2
+    };
+    for (syclang::ScanIsa isa : isas) {
+        const syclang::ScanKernels* scan = syclang::getScanKernels(isa);
+        if (!scan) {
+            continue;
+        }
+        syclang::setActiveScanIsa(isa);
+
+        size_t tokenCount = 0;
+        double tokenizeMs = bestOfMs(runs, [&] {
+            syclang::Lexer lexer(source);
+            tokenCount = lexer.tokenize().size();
+        });
+
+        size_t newlines = 0;
+        double newlineMs = bestOfMs(runs, [&] {
+            newlines = scan->countNewlines(begin, end);
+        });
+
+        // Hop from comment to comment through the whole buffer
+        size_t comments = 0;
+        double commentMs = bestOfMs(runs, [&] {
+            comments = 0;
+            for (const char* p = begin; (p = scan->findByte(p, end, '/')) < end; ++p) {
+                if (p + 1 < end && p[1] == '*') {
+                    p = scan->findBlockCommentEnd(p + 2, end);
+                    if (p == end) break;
+                    ++comments;
+                }
+            }
+        });
+
+        std::printf("  %-7s tokenize %8.2f ms %8.1f MB/s (%zu tokens) | "
+                    "newlines %7.1f MB/s (%zu) | comments %7.1f MB/s (%zu)\n",
+                    scan->name, tokenizeMs, megabytesPerSecond(source.size(), tokenizeMs),
+                    tokenCount, megabytesPerSecond(source.size(), newlineMs), newlines,
+                    megabytesPerSecond(source.size(), commentMs), comments);
+    }
+    return 0;
+}
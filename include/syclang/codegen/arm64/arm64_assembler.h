@@ -0,0 +1,19 @@
+#ifndef SYCLANG_CODEGEN_ARM64_ARM64_ASSEMBLER_H
+#define SYCLANG_CODEGEN_ARM64_ARM64_ASSEMBLER_H
+
+#include "syclang/codegen/object_code.h"
+#include <string_view>
+
+namespace syclang {
+
+// In-process assembler for the A64 subset ARM64CodeGenerator emits:
+// instructions, labels, .global, .section .text/.data, .quad and .zero.
+// Aliases (mov, cmp, cset, lsl #n, ...) get the encodings GNU as and
+// llvm-mc pick. Branches to labels in the same text are resolved here;
+// bl, adrp and :lo12: operands become relocations. Throws
+// std::runtime_error on anything else.
+ObjectCode assembleArm64(std::string_view assembly);
+
+} // namespace syclang
+
+#endif // SYCLANG_CODEGEN_ARM64_ARM64_ASSEMBLER_H
@@ -2,6 +2,7 @@
 #define SYCLANG_CODEGEN_ARM64_ARM64_CODEGEN_H
 
 #include "syclang/codegen/codegen_base.h"
+#include "syclang/codegen/liveness.h"
 #include <string>
 
 namespace syclang {
@@ -9,30 +10,60 @@ namespace syclang {
 class ARM64CodeGenerator : public CodeGenerator {
 public:
     ARM64CodeGenerator();
-    
+
     void generate(std::shared_ptr<IRModule> module) override;
-    std::string getOutput() const override { return output_; }
-    
+    bool canEmitObjectCode() const override { return true; }
+
 private:
-    std::string output_;
-    
+    // Per-function state while emitting
+    RegisterAllocation allocation_;
+    std::vector<int> savedRegisters_; // Callee-saved registers stored in the prologue
+    int frameSize_ = 0;
+    int outgoingSlots_ = 0;           // Stack-passed call arguments, at the bottom of the frame
+    std::string nextBlock_;           // Label laid out after the current block
+    BlockId currentBlock_ = INVALID_ID;
+    std::vector<std::pair<BlockId, BlockId>> edgeBlocks_; // Conditional edges with PHI copies
+    std::unordered_map<ValueId, int> vectorRegisters_; // NEON register indices in the current block
+
+    void emitFunction(const IRFunction& func);
+    void emitArguments(const IRFunction& func);
     void emitPrologue(const std::string& funcName) override;
     void emitEpilogue(const std::string& funcName) override;
-    void emitInstruction(std::shared_ptr<IRInstruction> inst) override;
-    
+    void emitInstruction(const IRInstruction& inst) override;
+
     std::string getReturnValueRegister() override { return "x0"; }
     std::string getStackPointerRegister() override { return "sp"; }
     std::string getFramePointerRegister() override { return "x29"; }
-    
+
     // ARM64 specific
-    std::string valueToOperand(std::shared_ptr<IRValue> value);
-    std::string emitBinaryOp(Opcode op, std::shared_ptr<IRValue> left,
-                            std::shared_ptr<IRValue> right);
-    std::string emitUnaryOp(Opcode op, std::shared_ptr<IRValue> operand);
-    std::string emitComparison(Opcode op);
-    
+    std::string valueToOperand(ValueId value);
+    std::string slotAddress(int slot) const;
+    bool isDead(ValueId value) const;
+    std::string sourceRegister(ValueId value, const char* scratch);
+    std::string resultRegister(ValueId value, const char* scratch);
+    void emitLoadImmediate(const std::string& reg, int64_t value);
+    void emitMoveTo(const std::string& reg, ValueId value);
+    void emitWriteBack(ValueId dst, const std::string& reg);
+    void emitCopy(ValueId dst, ValueId src);
+    void emitBinaryOp(const char* mnemonic, ValueId dst, ValueId left, ValueId right,
+                      bool allowImmediate);
+    void emitCompare(ValueId left, ValueId right);
+    void emitIndexedLoad(const IRInstruction& inst);
+    void emitIndexedStore(const IRInstruction& inst);
+    void emitTruncate(const IRInstruction& inst);
+    std::string vectorAddress(ValueId base, ValueId index, size_t scale);
+    std::string vectorRegister(ValueId value) const;
+    void emitVectorInstruction(const IRInstruction& inst);
+    void emitBranch(const char* condition, const char* inverse,
+                    const std::string& onTrue, const std::string& onFalse);
+    std::string branchTarget(BlockId to);
+    std::vector<OperandMove> edgeMoves(BlockId from, BlockId to);
+    void emitEdgeCopies(BlockId from, BlockId to);
+    void emitOperandMove(const std::string& dst, const std::string& src);
+
     // ARM64 registers
     void initRegisters();
+    std::vector<AllocatableRegister> allocatableRegisters() const;
 };
 
 } // namespace syclang
@@ -0,0 +1,23 @@
+#ifndef SYCLANG_CODEGEN_ARM64_ARM64_PEEPHOLE_H
+#define SYCLANG_CODEGEN_ARM64_ARM64_PEEPHOLE_H
+
+#include "syclang/codegen/peephole.h"
+#include <vector>
+
+namespace syclang {
+
+// Rewrite one function's instructions, as ARM64CodeGenerator emits them,
+// in place: delete copies to self and swapped copies back, write results
+// straight into the register they are copied to, rename through copies
+// of dying registers, fold constants into add, sub, cmp, logical
+// immediates and stores of xzr, forward stored values to later loads of
+// the same slot and drop stores of what was just loaded, drop results
+// nothing reads, and fuse instructions (shifted operands, madd/msub,
+// cbz/cbnz for comparisons with zero). There are no memory operands to
+// merge into arithmetic, so load-op-store becomes store-to-load
+// forwarding here.
+PeepholeStats peepholeArm64(std::vector<MachineInstruction>& code);
+
+} // namespace syclang
+
+#endif // SYCLANG_CODEGEN_ARM64_ARM64_PEEPHOLE_H
@@ -2,23 +2,79 @@
 #define SYCLANG_CODEGEN_CODEGEN_BASE_H
 
 #include "syclang/ir/ir.h"
+#include "syclang/codegen/object_code.h"
+#include "syclang/codegen/output_buffer.h"
+#include "syclang/codegen/peephole.h"
+#include "syclang/codegen/register_allocation.h"
+#include <initializer_list>
 #include <memory>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 namespace syclang {
 
+class ThreadPool;
+
 class CodeGenerator {
 public:
     virtual ~CodeGenerator() = default;
     
     virtual void generate(std::shared_ptr<IRModule> module) = 0;
-    virtual std::string getOutput() const = 0;
+    
+    // The assembly text, as one string (a copy of the buffer's pages)
+    std::string getOutput() const { return output_.str(); }
+    // The buffer itself, without copying; the generator's output is empty
+    // afterwards
+    OutputBuffer takeOutput() { return std::exchange(output_, OutputBuffer()); }
+    // Write the assembly to `fd` page by page while generating instead of
+    // keeping it; takeOutput() then holds only what is not written yet
+    void setOutputFile(int fd) { output_.setFile(fd); }
     
     Architecture getArchitecture() const { return arch_; }
     
+    // Emit functions in parallel on `pool` (nullptr = serial). Output is
+    // identical either way.
+    void setThreadPool(ThreadPool* pool) { pool_ = pool; }
+    
+    // Backends with an in-process assembler can produce machine code
+    // instead of text: generate() then fills getObjectCode() and leaves
+    // getOutput() empty
+    virtual bool canEmitObjectCode() const { return false; }
+    void setEmitObjectCode(bool enabled) { emitObjectCode_ = enabled; }
+    const ObjectCode& getObjectCode() const { return object_; }
+    
+    // Rewrite each function's instructions with the backend's peephole
+    // pass before they are printed or assembled (off by default)
+    void setPeephole(bool enabled) { peephole_ = enabled; }
+    // What the peephole pass did to the last module, summed over functions
+    const PeepholeStats& getPeepholeStats() const { return peepholeStats_; }
+    
+    // Register allocation summary of one emitted function
+    struct AllocationStats {
+        std::string function;
+        uint32_t values;         // Values that needed a location
+        uint32_t registers;      // Distinct registers handed out
+        uint32_t spilled;        // Values living in stack slots
+        uint32_t coalescedMoves; // Copies that needed no instruction
+        uint32_t calleeSaved;    // Registers saved in the prologue
+    };
+    
+    // One entry per emitted function, in module order
+    const std::vector<AllocationStats>& getAllocationStats() const { return allocationStats_; }
+    std::string formatAllocationStats() const;
+    
 protected:
     Architecture arch_;
+    std::shared_ptr<IRModule> module_;
+    ThreadPool* pool_ = nullptr;
+    bool emitObjectCode_ = false;
+    bool peephole_ = false;
+    PeepholeStats peepholeStats_;
+    OutputBuffer output_;
+    ObjectCode object_;
     
     // Register allocation
     struct RegisterInfo {
@@ -28,13 +84,56 @@ protected:
     };
     std::vector<RegisterInfo> registers_;
     
+    std::vector<AllocationStats> allocationStats_;
+    void recordAllocation(const std::string& function, const RegisterAllocation& allocation);
+    
+    // Function code goes through emit(): with the peephole pass on it is
+    // collected in code_ and printed by runPeephole(), otherwise written
+    // to output_ at once. Both print the same text.
+    std::vector<MachineInstruction> code_;
+    void emit(std::string_view mnemonic, std::initializer_list<std::string_view> operands = {});
+    void emit(MachineInstruction inst);
+    void emitLabel(std::string_view name);
+    // A directive or blank line, kept as written
+    void emitLine(std::string_view text);
+    
+    // Run `pass` over code_ and print what is left to output_
+    PeepholeStats runPeephole(PeepholeStats (*pass)(std::vector<MachineInstruction>&));
+    
     // Stack management
     int currentStackOffset_;
     
+    // One copy of a parallel move between target operands (register,
+    // stack slot or immediate, as the backend spells them)
+    struct OperandMove {
+        std::string dst;
+        std::string src;
+    };
+    // Order a parallel copy so that no source is overwritten before it is
+    // read. A cycle is broken by parking one value in `scratch`.
+    static std::vector<OperandMove> sequenceMoves(std::vector<OperandMove> moves,
+                                                  const std::string& scratch);
+    
+    // PHIs are lowered to copies on their incoming edges:
+    // (PHI result, incoming value) for the edge from -> to
+    std::vector<std::pair<ValueId, ValueId>> edgeCopies(BlockId from, BlockId to) const;
+    bool hasPhis(BlockId block) const;
+    // Label of the out-of-line block holding the copies of a conditional edge
+    std::string edgeLabel(BlockId from, BlockId to) const;
+    
+    // Vector values never leave the block that defines them (see
+    // optimizer/vectorize.h), so each block numbers its own: a value takes
+    // the lowest of `count` registers free at its definition, never one of
+    // its own operands, and frees it after its last read. Throws
+    // std::runtime_error if the block needs more than `count` at once.
+    static std::unordered_map<ValueId, int> assignVectorRegisters(const IRArena& arena,
+                                                                  const IRBasicBlock& block,
+                                                                  int count);
+    
     // Helper methods
     virtual void emitPrologue(const std::string& funcName) = 0;
     virtual void emitEpilogue(const std::string& funcName) = 0;
-    virtual void emitInstruction(std::shared_ptr<IRInstruction> inst) = 0;
+    virtual void emitInstruction(const IRInstruction& inst) = 0;
     
     virtual std::string getReturnValueRegister() = 0;
     virtual std::string getStackPointerRegister() = 0;
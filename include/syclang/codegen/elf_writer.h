@@ -0,0 +1,34 @@
+#ifndef SYCLANG_CODEGEN_ELF_WRITER_H
+#define SYCLANG_CODEGEN_ELF_WRITER_H
+
+#include "syclang/codegen/object_code.h"
+#include "syclang/ir/ir.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace syclang {
+
+// ELF64 relocatable object (ET_REL): .text, .data, their .rela sections and
+// a symbol table. Symbols the relocations name but the object does not
+// define become undefined globals for the linker.
+std::vector<uint8_t> writeElfObject(const ObjectCode& object, Architecture arch);
+
+// Statically linked ELF64 executable (ET_EXEC) for Linux: text and data in
+// two PT_LOAD segments at 0x400000 with every relocation applied. Unless
+// the object defines _start, a start routine is added that calls main and
+// exits with its result. Throws std::runtime_error on an undefined symbol
+// or a missing main.
+std::vector<uint8_t> writeElfExecutable(const ObjectCode& object, Architecture arch);
+
+// The code and data of an ELF64 relocatable object for `arch`, as a C
+// compiler writes one, or of every member of an ar archive of them, for
+// linking into an executable. Executable sections join the text and the
+// other allocated ones (.data, .rodata, .bss) the data; unwind tables are
+// dropped. Local symbols are renamed "<unit>:<name>" so units cannot
+// clash. Throws std::runtime_error on anything it cannot link.
+ObjectCode readElfObject(const std::vector<uint8_t>& bytes, const std::string& unit, Architecture arch);
+
+} // namespace syclang
+
+#endif // SYCLANG_CODEGEN_ELF_WRITER_H
@@ -0,0 +1,25 @@
+#ifndef SYCLANG_CODEGEN_GRAPH_COLORING_H
+#define SYCLANG_CODEGEN_GRAPH_COLORING_H
+
+#include "syclang/codegen/liveness.h"
+#include "syclang/codegen/register_allocation.h"
+#include <vector>
+
+namespace syclang {
+
+// Chaitin-Briggs graph-coloring allocation.
+//
+// Builds an interference graph from the block live-out sets, merges the
+// two sides of LOAD/STORE copies when the Briggs test says the merged
+// node stays colorable, then simplifies and selects optimistically.
+// Colors are biased toward a move partner's register so uncoalesced
+// copies still tend to disappear. Nodes that cannot be colored get
+// stack slots, which are themselves shared between non-interfering
+// spills.
+RegisterAllocation allocateGraphColoring(const IRArena& arena, const IRFunction& func,
+                                         const FunctionLiveness& liveness,
+                                         const std::vector<AllocatableRegister>& registers);
+
+} // namespace syclang
+
+#endif // SYCLANG_CODEGEN_GRAPH_COLORING_H
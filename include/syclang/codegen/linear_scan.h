@@ -0,0 +1,22 @@
+#ifndef SYCLANG_CODEGEN_LINEAR_SCAN_H
+#define SYCLANG_CODEGEN_LINEAR_SCAN_H
+
+#include "syclang/codegen/liveness.h"
+#include "syclang/codegen/register_allocation.h"
+#include <vector>
+
+namespace syclang {
+
+// Linear-scan allocation (Poletto & Sarkar): walk intervals by start and
+// give each a register none of whose holders it overlaps; intervals keep
+// their lifetime holes, so a loop-carried value can reuse a register in
+// the blocks where another is dead. When no register is free, spill
+// whichever single competing interval ends last. Spill slots are shared
+// the same way. PHI results and inputs are steered into the same
+// location when possible, eliding the copy on the edge.
+RegisterAllocation allocateLinearScan(const FunctionLiveness& liveness,
+                                      const std::vector<AllocatableRegister>& registers);
+
+} // namespace syclang
+
+#endif // SYCLANG_CODEGEN_LINEAR_SCAN_H
@@ -0,0 +1,89 @@
+#ifndef SYCLANG_CODEGEN_LIVENESS_H
+#define SYCLANG_CODEGEN_LIVENESS_H
+
+#include "syclang/ir/ir.h"
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace syclang {
+
+// Liveness of a function's register candidates: every non-global scalar
+// variable (named locals and temporaries). Instructions are numbered 0..n-1
+// in block layout order; a STORE to a variable defines it and a LOAD uses
+// its source, so locals are treated like virtual registers, while a store
+// through a pointer only reads its operands. A PHI
+// defines its result on entry to its block, and each incoming value is
+// read at the end of the predecessor it arrives from, where the backend
+// places the copy.
+class FunctionLiveness {
+public:
+    struct Range {
+        uint32_t from; // Inclusive positions
+        uint32_t to;
+    };
+    struct Interval {
+        ValueId value;
+        uint32_t start;     // First live position (definition or block entry)
+        uint32_t end;       // Last live position (use or block exit)
+        uint32_t uses;      // Reads of the value (spill weight)
+        bool crossesCall;   // Live across a CALL (from < call < to of a range, or
+                            // from <= call for a range live on block entry)
+        bool definedAtStart; // Written by the instruction at `start` (not live on entry)
+        std::vector<Range> ranges; // Ascending and disjoint; the value is dead in the gaps
+    };
+
+    // Whether two values are ever live at once and so need different
+    // locations. A value last read by the instruction that defines the
+    // other does not conflict with it: operands are read before the
+    // result is written.
+    static bool overlaps(const Interval& a, const Interval& b);
+
+    FunctionLiveness(const IRArena& arena, const IRFunction& func);
+
+    // Intervals of values that are read at least once, sorted by start
+    const std::vector<Interval>& intervals() const { return intervals_; }
+
+    // Interval of a value, or nullptr if it is never read
+    const Interval* interval(ValueId value) const {
+        auto it = intervalIndex_.find(value);
+        return it == intervalIndex_.end() ? nullptr : &intervals_[it->second];
+    }
+
+    // Positions of CALL instructions, ascending
+    const std::vector<uint32_t>& callPositions() const { return calls_; }
+
+    // (PHI result, incoming value) pairs: copies that vanish when both
+    // sides share a location
+    const std::vector<std::pair<ValueId, ValueId>>& phiCopies() const { return phiCopies_; }
+
+    size_t blockCount() const { return blockStarts_.size(); }
+    uint32_t blockStart(size_t block) const { return blockStarts_[block]; }
+    uint32_t instructionCount() const { return instructionCount_; }
+
+    // Candidates live on exit from a block (index into IRFunction::blocks)
+    std::vector<ValueId> liveOut(size_t block) const;
+
+    bool isCandidate(ValueId value) const { return localIndex_.count(value) != 0; }
+
+    // The candidate an instruction writes (INVALID_ID if none) and the
+    // values it reads. These define what "def" and "use" mean above.
+    static ValueId definedValue(const IRArena& arena, const IRInstruction& inst);
+    static void collectUses(const IRArena& arena, const IRInstruction& inst,
+                            std::vector<ValueId>& uses);
+
+private:
+    uint32_t instructionCount_;
+    std::vector<uint32_t> blockStarts_;
+    std::vector<uint32_t> calls_;
+    std::vector<std::pair<ValueId, ValueId>> phiCopies_;
+    std::vector<ValueId> locals_;
+    std::unordered_map<ValueId, uint32_t> localIndex_;
+    std::vector<std::vector<uint64_t>> liveOut_; // Bitsets over locals_
+    std::vector<Interval> intervals_;
+    std::unordered_map<ValueId, size_t> intervalIndex_;
+};
+
+} // namespace syclang
+
+#endif // SYCLANG_CODEGEN_LIVENESS_H
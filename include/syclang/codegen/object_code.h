@@ -0,0 +1,77 @@
+#ifndef SYCLANG_CODEGEN_OBJECT_CODE_H
+#define SYCLANG_CODEGEN_OBJECT_CODE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace syclang {
+
+// Machine code assembled in process, before any container (ELF, PE, a
+// flat image) is wrapped around it
+enum class Section {
+    TEXT,
+    DATA
+};
+
+// S is the symbol's address, A the addend, P the address of the field
+enum class RelocationType {
+    // x86-64
+    PC32,               // 32-bit S + A - P: rip-relative operands
+    PLT32,              // 32-bit S + A - P of a call target
+    // AArch64
+    CALL26,             // bl: (S + A - P) / 4 in the low 26 bits
+    JUMP26,             // b to a symbol, encoded as CALL26
+    ADR_PREL_PG_HI21,   // adrp: 4 KiB page of S + A minus that of P
+    ADD_ABS_LO12_NC,    // add: bits 0-11 of S + A
+    LDST64_ABS_LO12_NC, // 64-bit ldr/str: bits 3-11 of S + A
+    // Data
+    ABS64               // 64-bit S + A
+};
+
+struct ObjectSymbol {
+    std::string name;
+    Section section;
+    uint64_t offset;
+    uint64_t size;
+    bool global;
+};
+
+struct Relocation {
+    Section section;  // Section holding the field to patch
+    uint64_t offset;  // Offset of the field in that section
+    std::string symbol;
+    RelocationType type;
+    int64_t addend;
+};
+
+struct ObjectCode {
+    std::vector<uint8_t> text;
+    std::vector<uint8_t> data;
+    std::vector<ObjectSymbol> symbols; // Defined symbols only
+    std::vector<Relocation> relocations;
+
+    // Lay `other` out after this object's sections, each padded to `alignment`
+    void append(const ObjectCode& other, size_t alignment = 1);
+    // Zero-initialised data symbol
+    void defineData(const std::string& name, size_t size, size_t alignment);
+    const ObjectSymbol* findSymbol(const std::string& name) const;
+    // Extend each symbol to the next one in its section, or to its end
+    void sizeSymbols();
+};
+
+// Patch the field at `field` for a symbol value S + A of `value` and a
+// field address P of `place`. Throws std::runtime_error when the result
+// does not fit the field.
+void applyRelocation(uint8_t* field, RelocationType type, uint64_t value, uint64_t place);
+
+// Text, then data at the next 16-byte boundary, with every relocation
+// applied. References are PC-relative, so the image runs at any address
+// (any 4 KiB-aligned one on AArch64, whose adrp counts pages). Throws
+// std::runtime_error on a symbol the object does not define.
+std::vector<uint8_t> linkFlatImage(const ObjectCode& object);
+
+} // namespace syclang
+
+#endif // SYCLANG_CODEGEN_OBJECT_CODE_H
@@ -0,0 +1,107 @@
+#ifndef SYCLANG_CODEGEN_OUTPUT_BUFFER_H
+#define SYCLANG_CODEGEN_OUTPUT_BUFFER_H
+
+#include <concepts>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace syclang {
+
+// Text a code generator emits, kept as a list of pages.
+//
+// Appending never moves what is already written: a full page is followed
+// by a new one (doubling from MIN_PAGE_SIZE up to PAGE_SIZE), instead of a
+// string that reallocates and copies itself as it grows. Pieces are
+// streamed in with <<, which formats integers in place rather than through
+// std::to_string temporaries. Buffers are joined by handing over pages.
+//
+// A buffer attached to a file descriptor writes its pages out as soon as
+// the last one fills and reuses it, so its memory stays at about one page
+// however much passes through.
+class OutputBuffer {
+public:
+    static constexpr size_t MIN_PAGE_SIZE = 1024;
+    static constexpr size_t PAGE_SIZE = 64 * 1024;
+
+    OutputBuffer() = default;
+    OutputBuffer(OutputBuffer&&) = default;
+    OutputBuffer& operator=(OutputBuffer&&) = default;
+    OutputBuffer(const OutputBuffer&) = delete;
+    OutputBuffer& operator=(const OutputBuffer&) = delete;
+
+    void append(std::string_view text) {
+        if (!pages_.empty() && text.size() <= pages_.back().capacity - pages_.back().used) {
+            Page& page = pages_.back();
+            std::memcpy(page.data.get() + page.used, text.data(), text.size());
+            page.used += text.size();
+            held_ += text.size();
+            return;
+        }
+        appendAcrossPages(text);
+    }
+    void append(char c) { append(std::string_view(&c, 1)); }
+    // Take over `other`'s pages, leaving it empty. Small buffers are
+    // copied instead, so joining many of them leaves no half-empty pages.
+    void append(OutputBuffer&& other);
+
+    OutputBuffer& operator<<(std::string_view text) { append(text); return *this; }
+    OutputBuffer& operator<<(const char* text) { append(std::string_view(text)); return *this; }
+    OutputBuffer& operator<<(const std::string& text) { append(std::string_view(text)); return *this; }
+    OutputBuffer& operator<<(char c) { append(c); return *this; }
+    template <std::integral T>
+        requires(!std::same_as<T, char> && !std::same_as<T, bool>)
+    OutputBuffer& operator<<(T value) {
+        if constexpr (std::is_signed_v<T>) {
+            auto magnitude = static_cast<unsigned long long>(value);
+            appendDecimal(value < 0 ? 0 - magnitude : magnitude, value < 0);
+        } else {
+            appendDecimal(value, false);
+        }
+        return *this;
+    }
+
+    // Bytes written, including those already flushed to the file
+    size_t size() const { return flushed_ + held_; }
+    bool empty() const { return size() == 0; }
+    void clear();
+
+    // Everything not yet flushed, as one string
+    std::string str() const;
+    // Write every held page to `fd`; false on an I/O error
+    bool writeTo(int fd) const;
+
+    // From now on, write full pages to `fd` and recycle them. flush()
+    // writes the rest; false once any write has failed.
+    void setFile(int fd);
+    int file() const { return fd_; }
+    bool flush();
+
+private:
+    struct Page {
+        std::unique_ptr<char[]> data;
+        size_t used = 0;
+        size_t capacity = 0;
+    };
+
+    std::vector<Page> pages_;
+    size_t held_ = 0;       // Bytes in pages_
+    size_t flushed_ = 0;    // Bytes already written to fd_
+    int fd_ = -1;
+    bool failed_ = false;
+
+    // Free space at the end of the last page, adding a page (or, with a
+    // file attached, flushing the full one) when there is none
+    char* reserve(size_t& available);
+    void appendAcrossPages(std::string_view text);
+    void writePages();
+    void appendDecimal(unsigned long long magnitude, bool negative);
+};
+
+} // namespace syclang
+
+#endif // SYCLANG_CODEGEN_OUTPUT_BUFFER_H
@@ -0,0 +1,23 @@
+#ifndef SYCLANG_CODEGEN_PE_WRITER_H
+#define SYCLANG_CODEGEN_PE_WRITER_H
+
+#include "syclang/codegen/object_code.h"
+#include "syclang/ir/ir.h"
+#include <cstdint>
+#include <vector>
+
+namespace syclang {
+
+// PE32+ image with every relocation applied: a Windows console program
+// entered at main (OutputFormat::PE) or an EFI application entered at
+// efi_main (OutputFormat::EFI). Text, data and a .reloc section of DIR64
+// fixups for absolute addresses each start on a 4 KiB page. On x64 the
+// entry point is a thunk from the Microsoft calling convention the loader
+// uses to the System V one the code generator emits. Headers carry no
+// timestamp, so the same code always gives the same bytes. Throws
+// std::runtime_error on an undefined symbol or a missing entry function.
+std::vector<uint8_t> writePeImage(const ObjectCode& object, Architecture arch, OutputFormat format);
+
+} // namespace syclang
+
+#endif // SYCLANG_CODEGEN_PE_WRITER_H
@@ -0,0 +1,75 @@
+#ifndef SYCLANG_CODEGEN_PEEPHOLE_H
+#define SYCLANG_CODEGEN_PEEPHOLE_H
+
+#include "syclang/codegen/output_buffer.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace syclang {
+
+// One line of a function's assembly, decoded for machine-level rewriting
+struct MachineInstruction {
+    enum class Kind {
+        INSTRUCTION,
+        LABEL,
+        OTHER // Directives and blank lines, kept as written
+    };
+
+    Kind kind = Kind::INSTRUCTION;
+    std::string mnemonic;              // Label name for LABEL, the line for OTHER
+    std::vector<std::string> operands; // Split at commas outside brackets
+    bool removed = false;
+
+    bool isInstruction() const { return kind == Kind::INSTRUCTION && !removed; }
+};
+
+// Split assembly text as the backends write it (one statement per line,
+// operands separated by commas) into instructions
+std::vector<MachineInstruction> decodeMachineCode(std::string_view assembly);
+// Print the instructions that were not removed, one per line
+void printMachineCode(const std::vector<MachineInstruction>& code, OutputBuffer& out);
+
+// What a peephole pass did to one function (or, summed, to a module)
+struct PeepholeStats {
+    size_t instructions = 0;     // Before the pass
+    size_t removed = 0;          // Instructions deleted
+    size_t redundantMoves = 0;   // Copies and identity operations deleted, or absorbed by
+                                 // a retargeted instruction
+    size_t foldedImmediates = 0; // Constants moved into the instruction that reads them
+    size_t memoryCombined = 0;   // Load-op-store merged, stored values forwarded to loads
+    size_t shorterForms = 0;     // xor zeroing, lea, test, shifted and fused operands
+    size_t deadWrites = 0;       // Results nothing reads
+
+    PeepholeStats& operator+=(const PeepholeStats& other);
+    std::string format() const;
+};
+
+// How one instruction touches a target's registers, as bitmasks (the
+// target numbers its registers and flags)
+struct RegisterEffects {
+    uint64_t uses = 0;
+    uint64_t defs = 0;        // Registers written; partly written ones are also in `uses`
+    bool branches = false;    // May jump to `target`
+    bool fallsThrough = true; // May continue with the next instruction
+    bool pure = false;        // Writes nothing but `defs`: no memory, stack or control flow
+    std::string target;
+};
+
+// Registers live after each instruction, by backward dataflow over the
+// function's blocks (split at labels and branches). `effects` has one
+// entry per element of `code`; entries of labels, other lines and removed
+// instructions are ignored. A branch to a label outside the function, or
+// running off its end, leaves `unknownLive` live.
+std::vector<uint64_t> liveAfter(const std::vector<MachineInstruction>& code,
+                                const std::vector<RegisterEffects>& effects, uint64_t unknownLive);
+
+// Remove pure instructions whose results are all dead; returns how many
+size_t removeDeadWrites(std::vector<MachineInstruction>& code,
+                        const std::vector<RegisterEffects>& effects, const std::vector<uint64_t>& live);
+
+} // namespace syclang
+
+#endif // SYCLANG_CODEGEN_PEEPHOLE_H
@@ -0,0 +1,45 @@
+#ifndef SYCLANG_CODEGEN_REGISTER_ALLOCATION_H
+#define SYCLANG_CODEGEN_REGISTER_ALLOCATION_H
+
+#include "syclang/ir/ir.h"
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace syclang {
+
+// Where a value lives for the whole function
+struct ValueLocation {
+    enum class Kind : uint8_t { NONE, REGISTER, STACK };
+    Kind kind = Kind::NONE;
+    int index = -1; // Register number or spill slot
+
+    bool operator==(const ValueLocation& other) const {
+        return kind == other.kind && index == other.index;
+    }
+};
+
+// Output of a register allocator, shared by all backends
+struct RegisterAllocation {
+    std::unordered_map<ValueId, ValueLocation> locations;
+    uint32_t spillSlots = 0;        // 8-byte stack slots needed
+    uint32_t spilledValues = 0;
+    uint32_t coalescedMoves = 0;    // Copies whose source and destination share a location
+    std::vector<int> calleeSavedUsed; // Ascending register numbers
+
+    ValueLocation locate(ValueId value) const {
+        auto it = locations.find(value);
+        return it == locations.end() ? ValueLocation{} : it->second;
+    }
+};
+
+// A register the allocator may hand out. Caller-saved registers are
+// preferred; values live across a call only get callee-saved ones.
+struct AllocatableRegister {
+    int number;
+    bool callerSave;
+};
+
+} // namespace syclang
+
+#endif // SYCLANG_CODEGEN_REGISTER_ALLOCATION_H
@@ -0,0 +1,19 @@
+#ifndef SYCLANG_CODEGEN_X64_X64_ASSEMBLER_H
+#define SYCLANG_CODEGEN_X64_X64_ASSEMBLER_H
+
+#include "syclang/codegen/object_code.h"
+#include <string_view>
+
+namespace syclang {
+
+// In-process assembler for the Intel-syntax subset X64CodeGenerator
+// emits: instructions, labels, .global, .section .text/.data and .zero.
+// Instructions get the encodings GNU as picks, so the bytes match an
+// assembled .s file. Branches to labels in the same text are resolved
+// here, as rel8 where they reach; calls and rip-relative symbol operands
+// become relocations. Throws std::runtime_error on anything else.
+ObjectCode assembleX64(std::string_view assembly);
+
+} // namespace syclang
+
+#endif // SYCLANG_CODEGEN_X64_X64_ASSEMBLER_H
@@ -2,6 +2,7 @@
 #define SYCLANG_CODEGEN_X64_X64_CODEGEN_H
 
 #include "syclang/codegen/codegen_base.h"
+#include "syclang/codegen/linear_scan.h"
 #include <string>
 
 namespace syclang {
@@ -9,30 +10,61 @@ namespace syclang {
 class X64CodeGenerator : public CodeGenerator {
 public:
     X64CodeGenerator();
-    
+
     void generate(std::shared_ptr<IRModule> module) override;
-    std::string getOutput() const override { return output_; }
-    
+    bool canEmitObjectCode() const override { return true; }
+
 private:
-    std::string output_;
-    
+    // Per-function state while emitting
+    const FunctionLiveness* liveness_ = nullptr;
+    RegisterAllocation allocation_;
+    std::vector<int> savedRegisters_; // Callee-saved registers pushed in the prologue
+    int frameSize_ = 0;
+    std::string nextBlock_;           // Label laid out after the current block
+    BlockId currentBlock_ = INVALID_ID;
+    std::vector<std::pair<BlockId, BlockId>> edgeBlocks_; // Conditional edges with PHI copies
+    std::unordered_map<ValueId, int> vectorRegisters_; // xmm/ymm numbers in the current block
+    bool wideVectors_ = false;        // Function uses ymm registers (AVX2)
+
+    void emitFunction(const IRFunction& func);
+    void emitArguments(const IRFunction& func);
     void emitPrologue(const std::string& funcName) override;
     void emitEpilogue(const std::string& funcName) override;
-    void emitInstruction(std::shared_ptr<IRInstruction> inst) override;
-    
+    void emitInstruction(const IRInstruction& inst) override;
+
     std::string getReturnValueRegister() override { return "rax"; }
     std::string getStackPointerRegister() override { return "rsp"; }
     std::string getFramePointerRegister() override { return "rbp"; }
-    
+
     // x64 specific
-    std::string valueToOperand(std::shared_ptr<IRValue> value);
-    std::string emitBinaryOp(Opcode op, std::shared_ptr<IRValue> left, 
-                            std::shared_ptr<IRValue> right);
-    std::string emitUnaryOp(Opcode op, std::shared_ptr<IRValue> operand);
-    std::string emitComparison(Opcode op);
-    
+    std::string valueToOperand(ValueId value);
+    bool isRegister(ValueId value) const;
+    bool isMemory(ValueId value) const;
+    bool isImm32(ValueId value) const;
+    bool isDead(ValueId value) const;
+    void emitMove(const std::string& reg, ValueId value);
+    void emitCopy(ValueId dst, ValueId src);
+    void emitResult(ValueId dst, const std::string& reg);
+    void emitBinaryOp(const char* mnemonic, ValueId dst, ValueId left, ValueId right);
+    void emitShift(const char* mnemonic, ValueId dst, ValueId left, ValueId right);
+    void emitDivide(ValueId dst, ValueId left, ValueId right, bool remainder);
+    void emitCompare(ValueId left, ValueId right);
+    std::string elementAddress(ValueId base, ValueId index, size_t scale);
+    void emitIndexedLoad(const IRInstruction& inst);
+    void emitIndexedStore(const IRInstruction& inst);
+    void emitTruncate(const IRInstruction& inst);
+    std::string vectorRegister(ValueId value) const;
+    void emitVectorInstruction(const IRInstruction& inst);
+    void emitBranch(const char* condition, const char* inverse,
+                    const std::string& onTrue, const std::string& onFalse);
+    std::string branchTarget(BlockId to);
+    std::vector<OperandMove> edgeMoves(BlockId from, BlockId to);
+    void emitEdgeCopies(BlockId from, BlockId to);
+    void emitOperandMove(const std::string& dst, const std::string& src);
+
     // x64 registers
     void initRegisters();
+    std::vector<AllocatableRegister> allocatableRegisters() const;
 };
 
 } // namespace syclang
@@ -0,0 +1,22 @@
+#ifndef SYCLANG_CODEGEN_X64_X64_PEEPHOLE_H
+#define SYCLANG_CODEGEN_X64_X64_PEEPHOLE_H
+
+#include "syclang/codegen/peephole.h"
+#include <vector>
+
+namespace syclang {
+
+// Rewrite one function's instructions, as X64CodeGenerator emits them, in
+// place: delete copies to self and swapped copies back, turn push/pop
+// pairs into moves, rename a register through a chain instead of copying
+// it, fold constants into the instruction that reads them, merge a load,
+// an operation and a store into one memory operation, forward stored
+// values to loads of the same slot, drop results nothing reads, and pick
+// shorter encodings (xor zeroing, 32-bit immediates, lea for add and
+// shift-add, test for comparisons with zero). Register and flag liveness
+// across the function's branches decides which of these are safe.
+PeepholeStats peepholeX64(std::vector<MachineInstruction>& code);
+
+} // namespace syclang
+
+#endif // SYCLANG_CODEGEN_X64_X64_PEEPHOLE_H
@@ -0,0 +1,54 @@
+#ifndef SYCLANG_COMPILE_CACHE_H
+#define SYCLANG_COMPILE_CACHE_H
+
+#include <atomic>
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace syclang {
+
+// 128-bit MurmurHash3 of `bytes` as 32 hex digits. Not cryptographic:
+// good for telling contents apart, not for resisting forgery.
+std::string hashContent(std::string_view bytes);
+
+// Compiler outputs on disk, keyed by a hash of everything that went into
+// them (see keyFor), so an unchanged module costs a file read instead of
+// a compilation. The driver also stores each module's optimized binary IR
+// under a key of only the options that shape it, so a change to code
+// generation alone (format, -c, link inputs) skips parsing and optimizing.
+//
+// Entries live at <directory>/<2 hex digits>/<30 hex digits>. Each is
+// written to a temporary file and renamed into place, so concurrent
+// compilers sharing a directory never see a partial entry, and a
+// truncated or damaged one reads as a miss. The cache is best-effort:
+// I/O errors lose entries, never compilations. Nothing is ever evicted;
+// delete the directory to reclaim the space.
+class CompileCache {
+public:
+    explicit CompileCache(std::string directory);
+
+    // Key for `source` compiled with `options`, a canonical string of every
+    // setting that changes the output. The compiler's own identity (a hash
+    // of its executable) is mixed in, so a rebuilt compiler starts afresh.
+    static std::string keyFor(std::string_view source, std::string_view options);
+
+    std::optional<std::string> lookup(const std::string& key);
+    bool store(const std::string& key, std::string_view output);
+
+    // Lookups of either kind of entry
+    size_t hits() const { return hits_.load(); }
+    size_t misses() const { return misses_.load(); }
+
+private:
+    std::string pathFor(const std::string& key) const;
+
+    std::string directory_;
+    std::atomic<size_t> hits_{0};
+    std::atomic<size_t> misses_{0};
+};
+
+} // namespace syclang
+
+#endif // SYCLANG_COMPILE_CACHE_H
@@ -0,0 +1,72 @@
+#ifndef SYCLANG_IR_BINARY_IR_H
+#define SYCLANG_IR_BINARY_IR_H
+
+#include "syclang/ir/ir.h"
+#include "syclang/lexer/source_buffer.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace syclang {
+
+// Readers reject every other version
+constexpr uint32_t BINARY_IR_VERSION = 1;
+
+// Compact encoding of a module, for handing IR from one compiler run to
+// the next (parse once, then optimize or generate code as separate steps).
+//
+// A fixed header leads to a string table (every name, stored once), a
+// function index and the module's globals. Each function is a
+// self-contained record of LEB128 varints: its own value table (constants
+// and symbols by content, variables by name), then its blocks and
+// instructions referring to values and blocks by position in the record.
+// Any function can be decoded alone, in any order.
+std::string writeBinaryIR(const IRModule& module);
+
+// True when `bytes` start like writeBinaryIR output
+bool isBinaryIR(std::string_view bytes);
+
+// A binary IR file, memory-mapped through SourceBuffer and decoded lazily:
+// open() checks the header and reads the string table and index, and
+// functions are decoded only when loaded. Throws std::runtime_error when a
+// record turns out to be damaged.
+class BinaryIRReader {
+public:
+    static std::unique_ptr<BinaryIRReader> open(const std::string& path, std::string& error);
+    static std::unique_ptr<BinaryIRReader> open(std::unique_ptr<SourceBuffer> buffer, std::string& error);
+
+    Architecture targetArch() const { return arch_; }
+    OutputFormat outputFormat() const { return format_; }
+    size_t functionCount() const { return index_.size(); }
+    std::string_view functionName(size_t function) const { return strings_[index_[function].name]; }
+
+    // The module's name, target and globals, without functions
+    std::shared_ptr<IRModule> createModule() const;
+    // Decode one function into a module from createModule() and append it
+    std::shared_ptr<IRFunction> loadFunction(size_t function, IRModule& module) const;
+    // createModule() plus every function, in their original order
+    std::shared_ptr<IRModule> load() const;
+
+private:
+    struct IndexEntry {
+        uint64_t offset;
+        uint32_t size;
+        uint32_t name;
+    };
+
+    BinaryIRReader() = default;
+
+    std::unique_ptr<SourceBuffer> buffer_;
+    Architecture arch_ = Architecture::X64;
+    OutputFormat format_ = OutputFormat::ELF;
+    std::vector<std::string_view> strings_;
+    std::vector<IndexEntry> index_;
+    uint64_t moduleOffset_ = 0;
+    uint64_t moduleEnd_ = 0;
+};
+
+} // namespace syclang
+
+#endif // SYCLANG_IR_BINARY_IR_H
@@ -0,0 +1,49 @@
+#ifndef SYCLANG_IR_CALL_GRAPH_H
+#define SYCLANG_IR_CALL_GRAPH_H
+
+#include "syclang/ir/ir.h"
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace syclang {
+
+// Direct calls between the functions of a module, one node per entry of
+// IRModule::functions. A call whose symbol names no function of the
+// module, and an indirect call, has callee -1. Strongly connected
+// components (Tarjan) come callees first, so walking them in order visits
+// every function after everything it calls outside its own cycle.
+class CallGraph {
+public:
+    struct CallSite {
+        InstId call;
+        BlockId block;
+        int callee; // Index into IRModule::functions, -1 if external
+    };
+    struct Node {
+        std::vector<CallSite> calls;  // In block layout order
+        std::vector<int> callers;     // One entry per calling function
+        int component = -1;           // Index into components()
+    };
+
+    explicit CallGraph(const IRModule& module);
+
+    const std::vector<Node>& nodes() const { return nodes_; }
+    // Index of the function called `name`, -1 if there is none
+    int find(const std::string& name) const;
+
+    // Bottom-up: each component before any component calling into it
+    const std::vector<std::vector<int>>& components() const { return components_; }
+    // Part of a cycle, counting a function that calls itself
+    bool isRecursive(int node) const;
+
+private:
+    std::vector<Node> nodes_;
+    std::vector<std::vector<int>> components_;
+    std::unordered_map<std::string, int> byName_;
+    std::vector<bool> selfCalls_;
+};
+
+} // namespace syclang
+
+#endif // SYCLANG_IR_CALL_GRAPH_H
@@ -0,0 +1,59 @@
+#ifndef SYCLANG_IR_DOMINATORS_H
+#define SYCLANG_IR_DOMINATORS_H
+
+#include "syclang/ir/ir.h"
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace syclang {
+
+// Control-flow graph and dominator tree of one function, computed with
+// the iterative algorithm of Cooper, Harvey & Kennedy over reverse
+// postorder. Successors come from BR/CONDBR targets; a block without a
+// terminator falls through to the next one in layout order. Blocks that
+// cannot be reached from the entry block have no dominator information.
+class DominatorTree {
+public:
+    DominatorTree(const IRArena& arena, const IRFunction& func);
+
+    // Reachable blocks, entry first, in reverse postorder
+    const std::vector<BlockId>& reversePostorder() const { return rpo_; }
+    bool isReachable(BlockId block) const;
+
+    // CFG edges; a block appears once per edge (a CONDBR whose targets
+    // coincide contributes two)
+    const std::vector<BlockId>& successors(BlockId block) const;
+    const std::vector<BlockId>& predecessors(BlockId block) const;
+
+    // Immediate dominator (INVALID_ID for the entry block)
+    BlockId idom(BlockId block) const;
+    const std::vector<BlockId>& children(BlockId block) const;
+    const std::vector<BlockId>& frontier(BlockId block) const;
+
+    // Whether every path from the entry to `b` passes through `a`
+    bool dominates(BlockId a, BlockId b) const;
+
+private:
+    struct Node {
+        std::vector<BlockId> successors;
+        std::vector<BlockId> predecessors;
+        std::vector<BlockId> children;
+        std::vector<BlockId> frontier;
+        BlockId idom = INVALID_ID;
+        uint32_t rpoIndex = UNREACHED;
+        uint32_t enter = 0; // Preorder interval in the dominator tree
+        uint32_t exit = 0;
+    };
+    static constexpr uint32_t UNREACHED = 0xFFFFFFFFu;
+
+    std::vector<Node> nodes_; // Parallel to IRFunction::blocks
+    std::unordered_map<BlockId, uint32_t> index_;
+    std::vector<BlockId> rpo_;
+
+    const Node& node(BlockId block) const { return nodes_[index_.at(block)]; }
+};
+
+} // namespace syclang
+
+#endif // SYCLANG_IR_DOMINATORS_H
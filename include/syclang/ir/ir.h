@@ -1,10 +1,13 @@
 #ifndef SYCLANG_IR_IR_H
 #define SYCLANG_IR_IR_H
 
+#include "syclang/ir/slab.h"
 #include <string>
 #include <vector>
 #include <memory>
 #include <cstdint>
+#include <span>
+#include <unordered_map>
 
 namespace syclang {
 
@@ -22,67 +25,70 @@ enum class OutputFormat {
     RAW
 };
 
-// IR Value types
+// IR Value types. The V types are 128- and 256-bit SIMD vectors named by
+// lane count and lane type; integer lanes carry no signedness.
 enum class IRType {
     I8, I16, I32, I64,
     U8, U16, U32, U64,
     F32, F64,
     BOOL, VOID,
-    POINTER
+    POINTER,
+    V16I8, V8I16, V4I32, V2I64, V4F32,
+    V32I8, V16I16, V8I32, V4I64, V8F32
 };
 
-// IR Value
+// Compact handles into an IRModule's arena
+using ValueId = uint32_t;
+using InstId = uint32_t;
+using BlockId = uint32_t;
+constexpr uint32_t INVALID_ID = 0xFFFFFFFFu;
+
+size_t getTypeSize(IRType type);
+
+inline bool isVectorType(IRType type) { return type >= IRType::V16I8; }
+// Vector of `bytes` total width with lanes the size of `element` (F32
+// lanes stay F32, other scalars map to I8..I64); VOID if there is none
+IRType vectorType(IRType element, size_t bytes);
+// Lane type of a vector (I8, I16, I32, I64 or F32)
+IRType vectorElementType(IRType type);
+inline size_t vectorLanes(IRType type) {
+    return getTypeSize(type) / getTypeSize(vectorElementType(type));
+}
+
+// IR Value: either a constant or a variable, stored by value in the arena
 class IRValue {
 public:
-    IRValue() : type_(IRType::VOID) {}
-    explicit IRValue(IRType type) : type_(type) {}
+    enum class Kind : uint8_t { CONSTANT, VARIABLE };
+
+    IRValue() : kind(Kind::VARIABLE), isGlobal(false), registerNum(-1), offset(0),
+                type_(IRType::VOID) { value_.uintValue = 0; }
     
     IRType getType() const { return type_; }
-    size_t getSize() const;
+    void setType(IRType type) { type_ = type; }
+    size_t getSize() const { return getTypeSize(type_); }
     
-    virtual std::string toString() const = 0;
-    virtual ~IRValue() = default;
-
-protected:
-    IRType type_;
-};
-
-// Constants
-class IRConstant : public IRValue {
-public:
+    bool isConstant() const { return kind == Kind::CONSTANT; }
+    bool isVariable() const { return kind == Kind::VARIABLE; }
+    
+    std::string toString() const;
+    
+    Kind kind;
+    
+    // Constants
     union {
         int64_t intValue;
         uint64_t uintValue;
         double floatValue;
     } value_;
     
-    IRConstant() : IRValue() {}
-    explicit IRConstant(IRType type) : IRValue(type) {}
-    
-    static std::shared_ptr<IRConstant> createI32(int32_t value);
-    static std::shared_ptr<IRConstant> createI64(int64_t value);
-    static std::shared_ptr<IRConstant> createU32(uint32_t value);
-    static std::shared_ptr<IRConstant> createU64(uint64_t value);
-    static std::shared_ptr<IRConstant> createF64(double value);
-    static std::shared_ptr<IRConstant> createBool(bool value);
-    
-    std::string toString() const override;
-};
-
-// Variables
-class IRVariable : public IRValue {
-public:
+    // Variables
     std::string name;
-    int registerNum;
     bool isGlobal;
+    int registerNum;
     int offset; // Stack offset for locals
-    
-    IRVariable() : IRValue() {}
-    explicit IRVariable(IRType type) : IRValue(type) {}
-    
-    static std::shared_ptr<IRVariable> create(IRType type, const std::string& name);
-    
-    std::string toString() const override;
+
+protected:
+    IRType type_;
 };
 
 // Instructions
@@ -111,41 +117,158 @@ enum class Opcode {
     TRUNC, ZEXT, SEXT,
     FPTOUI, FPTOSI,
     UITOFP, SITOFP,
-    BITCAST
+    BITCAST,
+    
+    // Vectors: SPLAT copies a scalar into every lane. Arithmetic, LOAD and
+    // STORE work lane-wise when their result or value is a vector.
+    SPLAT
 };
 
 class IRInstruction {
 public:
-    IRInstruction(Opcode op) : opcode(op) {}
+    IRInstruction() : opcode(Opcode::RET) {}
+    explicit IRInstruction(Opcode op) : opcode(op) {}
     
     Opcode opcode;
-    std::shared_ptr<IRValue> result;
-    std::vector<std::shared_ptr<IRValue>> operands;
-    std::string label;
+    ValueId result = INVALID_ID;
     
-    std::string toString() const;
+    // Operands live in the arena's operand slab. A PHI's operands are its
+    // incoming values, one per predecessor edge (see IRArena::setIncoming).
+    uint32_t operandBegin = 0;
+    uint32_t operandCount = 0;
+    
+    // Branch targets: BR uses targets[0]; CONDBR branches to targets[0]
+    // when the condition is true and targets[1] otherwise
+    BlockId targets[2] = {INVALID_ID, INVALID_ID};
+    
+    // CALL: the function's symbol (IRArena::createSymbol), or INVALID_ID
+    // for an indirect call
+    ValueId callee = INVALID_ID;
+    
+    bool isTerminator() const {
+        return opcode == Opcode::BR || opcode == Opcode::CONDBR || opcode == Opcode::RET;
+    }
 };
 
 // Basic block
 class IRBasicBlock {
 public:
     std::string name;
-    std::vector<std::shared_ptr<IRInstruction>> instructions;
-    std::shared_ptr<IRBasicBlock> nextBlock;
+    std::vector<InstId> instructions;
+};
+
+// Owns every value, instruction and block of a module in contiguous slabs.
+// Nodes are referenced by 32-bit ids and are never freed individually.
+class IRArena {
+public:
+    IRArena() = default;
+    IRArena(const IRArena&) = delete;
+    IRArena& operator=(const IRArena&) = delete;
+    
+    // Constants are interned: equal (type, bits) pairs share one id
+    ValueId createConstant(IRType type, uint64_t bits);
+    ValueId createI32(int32_t value);
+    ValueId createI64(int64_t value);
+    ValueId createU32(uint32_t value);
+    ValueId createU64(uint64_t value);
+    ValueId createF64(double value);
+    ValueId createBool(bool value);
+    
+    ValueId createVariable(IRType type, const std::string& name);
+    
+    // Global naming a function; interned like constants
+    ValueId createSymbol(const std::string& name);
+    
+    InstId createInstruction(Opcode op, std::initializer_list<ValueId> operands = {},
+                             ValueId result = INVALID_ID);
+    InstId createInstruction(Opcode op, std::span<const ValueId> operands,
+                             ValueId result = INVALID_ID);
+    
+    BlockId createBlock(const std::string& name);
+    
+    IRValue& value(ValueId id) { return values_[id]; }
+    const IRValue& value(ValueId id) const { return values_[id]; }
+    IRInstruction& instruction(InstId id) { return instructions_[id]; }
+    const IRInstruction& instruction(InstId id) const { return instructions_[id]; }
+    IRBasicBlock& block(BlockId id) { return blocks_[id]; }
+    const IRBasicBlock& block(BlockId id) const { return blocks_[id]; }
+    
+    std::span<ValueId> operands(const IRInstruction& inst) {
+        return {operands_.data(inst.operandBegin), inst.operandCount};
+    }
+    std::span<const ValueId> operands(const IRInstruction& inst) const {
+        return {operands_.data(inst.operandBegin), inst.operandCount};
+    }
+    
+    // Replace the operand list of an instruction (reuses storage when it fits)
+    void setOperands(IRInstruction& inst, std::span<const ValueId> operands);
+    
+    // PHI incoming edges: operands(inst)[i] arrives from incomingBlocks(inst)[i].
+    // The blocks follow the values in the operand slab, so PHIs must be
+    // resized through setIncoming rather than setOperands.
+    void setIncoming(IRInstruction& inst, std::span<const ValueId> values,
+                     std::span<const BlockId> blocks);
+    std::span<const BlockId> incomingBlocks(const IRInstruction& inst) const {
+        return {operands_.data(inst.operandBegin + inst.operandCount), inst.operandCount};
+    }
+    
+    std::string toString(const IRInstruction& inst) const;
+    
+    struct Stats {
+        uint32_t values;
+        uint32_t constants;
+        uint32_t instructions;
+        uint32_t blocks;
+        uint32_t operands;
+        size_t bytes;     // Chunks allocated
+        size_t usedBytes; // Slots handed out, chunk-tail padding included
+    };
+    Stats getStats() const;
+
+private:
+    Slab<IRValue> values_;
+    Slab<IRInstruction> instructions_;
+    Slab<IRBasicBlock, 8> blocks_;
+    Slab<ValueId> operands_;
+    
+    struct ConstantKey {
+        IRType type;
+        uint64_t bits;
+        bool operator==(const ConstantKey& other) const {
+            return type == other.type && bits == other.bits;
+        }
+    };
+    struct ConstantKeyHash {
+        size_t operator()(const ConstantKey& key) const {
+            return std::hash<uint64_t>()(key.bits * 31 + static_cast<uint64_t>(key.type));
+        }
+    };
+    std::unordered_map<ConstantKey, ValueId, ConstantKeyHash> constants_;
+    std::unordered_map<std::string, ValueId> symbols_;
+    uint32_t constantCount_ = 0;
+};
+
+// Source attribute steering the inliner: #[inline] or #[noinline]
+enum class InlineHint : uint8_t {
+    DEFAULT,
+    ALWAYS,
+    NEVER
 };
 
 // Function
 class IRFunction {
 public:
     std::string name;
-    IRType returnType;
+    IRType returnType = IRType::VOID;
     std::vector<std::pair<IRType, std::string>> parameters;
-    std::vector<std::shared_ptr<IRBasicBlock>> blocks;
-    int stackSize;
-    bool isVariadic;
+    std::vector<ValueId> arguments; // Values the parameters arrive in
+    std::vector<BlockId> blocks;
+    int stackSize = 0;
+    bool isVariadic = false;
+    InlineHint inlineHint = InlineHint::DEFAULT;
     
-    void addBlock(std::shared_ptr<IRBasicBlock> block);
-    std::shared_ptr<IRBasicBlock> getCurrentBlock();
+    void addBlock(BlockId block);
+    BlockId getCurrentBlock() const;
 };
 
 // Module
@@ -153,12 +276,13 @@ class IRModule {
 public:
     std::string name;
     std::vector<std::shared_ptr<IRFunction>> functions;
-    std::vector<std::shared_ptr<IRVariable>> globalVariables;
-    Architecture targetArch;
-    OutputFormat outputFormat;
+    std::vector<ValueId> globalVariables;
+    Architecture targetArch = Architecture::X64;
+    OutputFormat outputFormat = OutputFormat::ELF;
+    IRArena arena;
     
     void addFunction(std::shared_ptr<IRFunction> func);
-    void addGlobalVariable(std::shared_ptr<IRVariable> var);
+    void addGlobalVariable(ValueId var);
     
     std::string dump() const;
 };
@@ -18,10 +18,12 @@ public:
     
 private:
     Architecture arch_;
+    std::shared_ptr<IRModule> module_;
     std::shared_ptr<IRFunction> currentFunction_;
-    std::shared_ptr<IRBasicBlock> currentBlock_;
+    BlockId currentBlock_;
     std::map<std::string, std::shared_ptr<IRFunction>> functions_;
-    std::map<std::string, std::shared_ptr<IRVariable>> variables_;
+    std::map<std::string, ValueId> variables_;
+    std::map<std::string, IRType> elementTypes_; // Pointee type of pointer variables
     std::map<std::string, std::shared_ptr<StructDecl>> structs_;
     
     int labelCounter_;
@@ -40,21 +42,33 @@ private:
     void generateWhile(std::shared_ptr<WhileStmt> whileStmt);
     void generateFor(std::shared_ptr<ForStmt> forStmt);
     
-    // Expression generation
-    std::shared_ptr<IRValue> generateExpression(std::shared_ptr<Expression> expr);
-    std::shared_ptr<IRValue> generateLiteral(std::shared_ptr<LiteralExpr> lit);
-    std::shared_ptr<IRValue> generateIdentifier(std::shared_ptr<IdentifierExpr> ident);
-    std::shared_ptr<IRValue> generateBinary(std::shared_ptr<BinaryExpr> binary);
-    std::shared_ptr<IRValue> generateUnary(std::shared_ptr<UnaryExpr> unary);
-    std::shared_ptr<IRValue> generateCall(std::shared_ptr<CallExpr> call);
-    std::shared_ptr<IRValue> generateCast(std::shared_ptr<CastExpr> cast);
-    std::shared_ptr<IRValue> generateIndex(std::shared_ptr<IndexExpr> index);
-    std::shared_ptr<IRValue> generateMemberAccess(std::shared_ptr<MemberAccessExpr> access);
-    std::shared_ptr<IRValue> generateAsm(std::shared_ptr<AsmExpr> asmExpr);
+    // Expression generation (INVALID_ID when no value is produced)
+    ValueId generateExpression(std::shared_ptr<Expression> expr);
+    ValueId generateLiteral(std::shared_ptr<LiteralExpr> lit);
+    ValueId generateIdentifier(std::shared_ptr<IdentifierExpr> ident);
+    ValueId generateBinary(std::shared_ptr<BinaryExpr> binary);
+    ValueId generateAssignment(std::shared_ptr<BinaryExpr> assign);
+    ValueId generateUnary(std::shared_ptr<UnaryExpr> unary);
+    ValueId generateCall(std::shared_ptr<CallExpr> call);
+    ValueId generateCast(std::shared_ptr<CastExpr> cast);
+    ValueId generateIndex(std::shared_ptr<IndexExpr> index);
+    ValueId generateIndexAssignment(std::shared_ptr<IndexExpr> target,
+                                    std::shared_ptr<BinaryExpr> assign);
+    IRType elementType(std::shared_ptr<Expression> base) const;
+    ValueId generateMemberAccess(std::shared_ptr<MemberAccessExpr> access);
+    ValueId generateAsm(std::shared_ptr<AsmExpr> asmExpr);
     
     // Helper functions
-    std::shared_ptr<IRVariable> newTemp();
+    ValueId newTemp(IRType type = IRType::I64);
+    void notePointer(const std::string& name, std::shared_ptr<Type> type);
     std::string newLabel(const std::string& prefix);
+    BlockId newBlock(const std::string& prefix);
+    void startBlock(BlockId block);
+    InstId emit(Opcode op, std::initializer_list<ValueId> operands = {},
+                ValueId result = INVALID_ID);
+    void emitBranch(BlockId target);
+    void emitCondBranch(ValueId condition, BlockId ifTrue, BlockId ifFalse);
+    bool isTerminated() const;
 };
 
 } // namespace syclang
@@ -0,0 +1,40 @@
+#ifndef SYCLANG_IR_LOOP_INFO_H
+#define SYCLANG_IR_LOOP_INFO_H
+
+#include "syclang/ir/dominators.h"
+#include <unordered_set>
+#include <vector>
+
+namespace syclang {
+
+// Natural loops of one function. An edge t -> h is a back edge when h
+// dominates t; the loop of h is h plus every block that reaches one of
+// its back edges without passing through h. Back edges sharing a header
+// form one loop.
+class LoopInfo {
+public:
+    struct Loop {
+        BlockId header;
+        std::vector<BlockId> blocks;  // Header first, the rest in layout order
+        std::vector<BlockId> latches; // Sources of the back edges
+        std::vector<BlockId> exits;   // Blocks outside the loop it branches to
+        BlockId preheader = INVALID_ID; // Sole outside predecessor, if it only enters the loop
+        int parent = -1;              // Index of the innermost enclosing loop
+        unsigned depth = 1;           // 1 for outermost loops
+        std::unordered_set<BlockId> members;
+
+        bool contains(BlockId block) const { return members.count(block) != 0; }
+    };
+
+    LoopInfo(const IRFunction& func, const DominatorTree& dom);
+
+    // Innermost loops first, so a loop comes before any loop containing it
+    const std::vector<Loop>& loops() const { return loops_; }
+
+private:
+    std::vector<Loop> loops_;
+};
+
+} // namespace syclang
+
+#endif // SYCLANG_IR_LOOP_INFO_H
@@ -0,0 +1,25 @@
+#ifndef SYCLANG_IR_MEM2REG_H
+#define SYCLANG_IR_MEM2REG_H
+
+#include "syclang/ir/ir.h"
+#include <cstddef>
+
+namespace syclang {
+
+// Promote stack variables to SSA values ("mem2reg"). A variable qualifies
+// when an ALLOCA defines it, it is not global, and it is only ever the
+// single operand of a LOAD or the destination of a STORE. PHIs go at the
+// iterated dominance frontier of the blocks that store to it (only for
+// variables read in a block before being written there), then a walk of
+// the dominator tree rewrites each LOAD to the reaching stored value and
+// deletes the LOADs, STOREs and ALLOCAs. A read with no reaching store
+// becomes the constant 0. PHIs left dead or with a single distinct input
+// are removed again.
+//
+// Unreachable blocks and instructions after a block's terminator are
+// dropped first. Returns the number of variables promoted.
+size_t promoteMemoryToRegisters(IRArena& arena, IRFunction& func);
+
+} // namespace syclang
+
+#endif // SYCLANG_IR_MEM2REG_H
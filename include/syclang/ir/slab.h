@@ -0,0 +1,80 @@
+#ifndef SYCLANG_IR_SLAB_H
+#define SYCLANG_IR_SLAB_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+namespace syclang {
+
+// Chunked storage addressed by 32-bit index.
+//
+// Elements live in fixed-size chunks that are never moved, so references
+// stay valid while the slab grows. Ranges handed out by allocate() are
+// contiguous: a range that fits a chunk never straddles a boundary, and a
+// longer one gets a run of consecutive chunks carved from one array.
+template <typename T, unsigned ChunkBits = 12>
+class Slab {
+public:
+    static constexpr uint32_t CHUNK_SIZE = 1u << ChunkBits;
+
+    Slab() : size_(0) {}
+    Slab(const Slab&) = delete;
+    Slab& operator=(const Slab&) = delete;
+    Slab(Slab&&) = default;
+    Slab& operator=(Slab&&) = default;
+
+    // Append one element and return its index
+    uint32_t add(T value) {
+        uint32_t id = allocate(1);
+        (*this)[id] = std::move(value);
+        return id;
+    }
+
+    // Reserve `count` contiguous default-constructed elements
+    uint32_t allocate(uint32_t count) {
+        uint32_t offset = size_ & (CHUNK_SIZE - 1);
+        if (size_ == chunks_.size() * CHUNK_SIZE || offset + count > CHUNK_SIZE) {
+            // Start fresh chunks; the tail of the previous one stays unused
+            size_ = static_cast<uint32_t>(chunks_.size() * CHUNK_SIZE);
+            size_t run = count > CHUNK_SIZE ? (static_cast<size_t>(count) + CHUNK_SIZE - 1) / CHUNK_SIZE : 1;
+            if ((chunks_.size() + run) * CHUNK_SIZE > UINT32_MAX) {
+                throw std::length_error("IR slab exceeds 32-bit indices");
+            }
+            storage_.push_back(std::make_unique<T[]>(run * CHUNK_SIZE));
+            for (size_t c = 0; c < run; ++c) {
+                chunks_.push_back(storage_.back().get() + c * CHUNK_SIZE);
+            }
+        }
+        uint32_t id = size_;
+        size_ += count;
+        return id;
+    }
+
+    T& operator[](uint32_t id) {
+        return chunks_[id >> ChunkBits][id & (CHUNK_SIZE - 1)];
+    }
+
+    const T& operator[](uint32_t id) const {
+        return chunks_[id >> ChunkBits][id & (CHUNK_SIZE - 1)];
+    }
+
+    T* data(uint32_t id) { return &(*this)[id]; }
+    const T* data(uint32_t id) const { return &(*this)[id]; }
+
+    // Number of index slots handed out (including chunk-tail padding)
+    uint32_t size() const { return size_; }
+    size_t chunkCount() const { return chunks_.size(); }
+    size_t capacityBytes() const { return chunks_.size() * CHUNK_SIZE * sizeof(T); }
+
+private:
+    std::vector<std::unique_ptr<T[]>> storage_; // One array per allocation of chunks
+    std::vector<T*> chunks_;                    // Start of every chunk, in index order
+    uint32_t size_;
+};
+
+} // namespace syclang
+
+#endif // SYCLANG_IR_SLAB_H
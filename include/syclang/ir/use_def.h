@@ -0,0 +1,54 @@
+#ifndef SYCLANG_IR_USE_DEF_H
+#define SYCLANG_IR_USE_DEF_H
+
+#include "syclang/ir/ir.h"
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+namespace syclang {
+
+// Use-def and def-use chains of one function in SSA form. Each value
+// produced as an instruction result maps to that instruction, and each
+// value maps to the instructions reading it (once per operand slot, PHI
+// inputs included). Memory is not tracked: a STORE does not define the
+// variable it writes.
+class UseDefChains {
+public:
+    UseDefChains(const IRArena& arena, const IRFunction& func);
+
+    // Instruction whose result is `value`; INVALID_ID for constants,
+    // globals, arguments and values defined outside the function
+    InstId definition(ValueId value) const;
+
+    // Instructions reading `value`
+    std::span<const InstId> users(ValueId value) const;
+    bool isUsed(ValueId value) const { return !users(value).empty(); }
+
+    // Block holding an instruction of this function
+    BlockId blockOf(InstId inst) const;
+
+    // Rewrite every operand reading `from` to read `to` instead
+    void replaceAllUses(IRArena& arena, ValueId from, ValueId to);
+
+    // Record an instruction added to `block`, after its operands are set
+    void insert(const IRArena& arena, InstId inst, BlockId block);
+
+    // Forget an instruction removed from its block: it no longer reads
+    // its operands or defines its result
+    void erase(const IRArena& arena, InstId inst);
+
+private:
+    struct Entry {
+        InstId definition = INVALID_ID;
+        std::vector<InstId> users;
+    };
+    std::unordered_map<ValueId, Entry> values_;
+    std::unordered_map<InstId, BlockId> blocks_;
+
+    Entry& entry(ValueId value) { return values_[value]; }
+};
+
+} // namespace syclang
+
+#endif // SYCLANG_IR_USE_DEF_H
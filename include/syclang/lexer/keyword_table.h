@@ -0,0 +1,130 @@
+#ifndef SYCLANG_LEXER_KEYWORD_TABLE_H
+#define SYCLANG_LEXER_KEYWORD_TABLE_H
+
+#include "syclang/lexer/token.h"
+#include <cstddef>
+#include <string_view>
+
+namespace syclang {
+
+struct KeywordEntry {
+    std::string_view text;
+    TokenType type;
+};
+
+// Every reserved word recognized by the lexer: English keywords first,
+// then the Chinese aliases (UTF-8). ChineseKeywordMap is built from the
+// non-ASCII entries of this table.
+inline constexpr KeywordEntry KEYWORDS[] = {
+    // English keywords
+    {"fn", TokenType::KW_FN},
+    {"let", TokenType::KW_LET},
+    {"mut", TokenType::KW_MUT},
+    {"if", TokenType::KW_IF},
+    {"else", TokenType::KW_ELSE},
+    {"while", TokenType::KW_WHILE},
+    {"for", TokenType::KW_FOR},
+    {"return", TokenType::KW_RETURN},
+    {"struct", TokenType::KW_STRUCT},
+    {"enum", TokenType::KW_ENUM},
+    {"union", TokenType::KW_UNION},
+    {"extern", TokenType::KW_EXTERN},
+    {"true", TokenType::KW_TRUE},
+    {"false", TokenType::KW_FALSE},
+    {"null", TokenType::KW_NULL},
+    {"asm", TokenType::KW_ASM},
+    {"volatile", TokenType::KW_VOLATILE},
+    {"i8", TokenType::TYPE_I8},
+    {"i16", TokenType::TYPE_I16},
+    {"i32", TokenType::TYPE_I32},
+    {"i64", TokenType::TYPE_I64},
+    {"u8", TokenType::TYPE_U8},
+    {"u16", TokenType::TYPE_U16},
+    {"u32", TokenType::TYPE_U32},
+    {"u64", TokenType::TYPE_U64},
+    {"f32", TokenType::TYPE_F32},
+    {"f64", TokenType::TYPE_F64},
+    {"bool", TokenType::TYPE_BOOL},
+    {"void", TokenType::TYPE_VOID},
+
+    // 函数相关
+    {"计算", TokenType::KW_FN},
+    {"函数", TokenType::KW_FN},
+    {"功能", TokenType::KW_FN},
+
+    // 控制流
+    {"如果", TokenType::KW_IF},
+    {"若", TokenType::KW_IF},
+    {"否则", TokenType::KW_ELSE},
+    {"其它", TokenType::KW_ELSE},
+
+    // 循环
+    {"循环", TokenType::KW_WHILE},
+    {"当", TokenType::KW_WHILE},
+    {"遍历", TokenType::KW_FOR},
+    {"针对", TokenType::KW_FOR},
+
+    // 返回
+    {"返回", TokenType::KW_RETURN},
+    {"回传", TokenType::KW_RETURN},
+
+    // 变量
+    {"变量", TokenType::KW_LET},
+    {"设", TokenType::KW_LET},
+    {"可变", TokenType::KW_MUT},
+    {"常量", TokenType::KW_CONST},
+
+    // 结构
+    {"结构", TokenType::KW_STRUCT},
+    {"类", TokenType::KW_STRUCT},
+    {"枚举", TokenType::KW_ENUM},
+    {"联合", TokenType::KW_UNION},
+
+    // 特性
+    {"特性", TokenType::KW_TRAIT},
+    {"接口", TokenType::KW_TRAIT},
+    {"实现", TokenType::KW_IMPL},
+
+    // 布尔值
+    {"真", TokenType::KW_TRUE},
+    {"假", TokenType::KW_FALSE},
+    {"空", TokenType::KW_NULL},
+
+    // 异步
+    {"异步", TokenType::KW_ASYNC},
+    {"等待", TokenType::KW_AWAIT},
+
+    // 模式匹配
+    {"匹配", TokenType::KW_MATCH},
+    {"模式", TokenType::KW_MATCH},
+
+    // 类型
+    {"整数", TokenType::TYPE_I32},
+    {"浮点", TokenType::TYPE_F64},
+    {"字符", TokenType::TYPE_CHAR},
+    {"字符串", TokenType::TYPE_STRING},
+    {"布尔", TokenType::TYPE_BOOL},
+    {"无值", TokenType::TYPE_VOID},
+
+    // 操作符
+    {"加", TokenType::PLUS},
+    {"减", TokenType::MINUS},
+    {"乘", TokenType::STAR},
+    {"除", TokenType::SLASH},
+    {"模", TokenType::PERCENT},
+};
+
+inline constexpr size_t KEYWORD_COUNT = sizeof(KEYWORDS) / sizeof(KEYWORDS[0]);
+
+// Look up a word in the keyword table (compile-time perfect hash).
+// Returns TokenType::IDENTIFIER when the word is not reserved.
+TokenType lookupKeyword(std::string_view word);
+
+// True for table entries spelled in non-ASCII (Chinese) characters
+constexpr bool isChineseSpelling(std::string_view word) {
+    return !word.empty() && static_cast<unsigned char>(word[0]) >= 0x80;
+}
+
+} // namespace syclang
+
+#endif // SYCLANG_LEXER_KEYWORD_TABLE_H
@@ -2,17 +2,22 @@
 #define SYCLANG_LEXER_LEXER_H
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include "token.h"
+#include "token_stream.h"
+#include "source_buffer.h"
 
 namespace syclang {
 
 class Lexer {
 public:
-    explicit Lexer(const std::string& source);
+    // `source` must outlive the lexer and every token it returns
+    explicit Lexer(std::string_view source);
+    explicit Lexer(const SourceBuffer& buffer);
     
-    // Tokenize the entire source
-    std::vector<Token> tokenize();
+    // Tokenize the entire source (ends with an EOF_TOKEN entry)
+    TokenStream tokenize();
     
     // Get next token
     Token nextToken();
@@ -21,20 +26,24 @@ public:
     Token peekToken(size_t offset = 0);
     
 private:
-    const std::string& source_;
+    std::string_view source_;
     size_t position_;
     size_t line_;
     size_t column_;
     
     char peek(size_t offset = 0);
     char advance();
+    void advanceTo(size_t newPos);
     void skipWhitespace();
     void skipComment();
+    bool isIdentifierStart(size_t pos) const;
+    bool isIdentifierPart(size_t pos) const;
     
     Token scanNumber();
     Token scanString();
     Token scanIdentifier();
     Token scanSymbol();
+    Token makeToken(TokenType type, size_t start) const;
 };
 
 } // namespace syclang
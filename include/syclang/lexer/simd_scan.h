@@ -0,0 +1,50 @@
+#ifndef SYCLANG_LEXER_SIMD_SCAN_H
+#define SYCLANG_LEXER_SIMD_SCAN_H
+
+#include <cstddef>
+
+namespace syclang {
+
+// Instruction set used by the lexer's bulk scanning kernels
+enum class ScanIsa {
+    SCALAR,
+    SSE2,
+    AVX2
+};
+
+// Bulk scanning primitives used by the lexer. Each kernel takes a
+// [begin, end) byte range and returns a pointer into it (end when the
+// searched-for byte is not found).
+struct ScanKernels {
+    ScanIsa isa;
+    const char* name;
+
+    // First byte that is not ' ', '\t', '\n', '\v', '\f' or '\r'
+    const char* (*skipWhitespace)(const char* begin, const char* end);
+
+    // First byte that is not [A-Za-z0-9_]
+    const char* (*skipIdentifierChars)(const char* begin, const char* end);
+
+    // First occurrence of `c`
+    const char* (*findByte)(const char* begin, const char* end, char c);
+
+    // First '*' that is immediately followed by '/'
+    const char* (*findBlockCommentEnd)(const char* begin, const char* end);
+
+    // Number of '\n' bytes in the range
+    size_t (*countNewlines)(const char* begin, const char* end);
+};
+
+// Kernels for a specific instruction set, or nullptr when the running
+// CPU (or this build) does not support it
+const ScanKernels* getScanKernels(ScanIsa isa);
+
+// Kernels the lexer uses: the widest supported set, detected once at
+// startup. setActiveScanIsa() overrides the choice (for tests and
+// benchmarks; not thread-safe) and returns false if unsupported.
+const ScanKernels& activeScanKernels();
+bool setActiveScanIsa(ScanIsa isa);
+
+} // namespace syclang
+
+#endif // SYCLANG_LEXER_SIMD_SCAN_H
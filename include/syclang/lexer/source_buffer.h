@@ -0,0 +1,53 @@
+#ifndef SYCLANG_LEXER_SOURCE_BUFFER_H
+#define SYCLANG_LEXER_SOURCE_BUFFER_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace syclang {
+
+// Read-only contents of one source file.
+//
+// Regular files are memory-mapped, so loading costs one mapping and no
+// copy; the lexer scans the mapping directly and tokens are slices of it.
+// The buffer must outlive every token (and AST node holding a token value)
+// produced from it. Pipes, empty files and platforms without mmap fall
+// back to an owned copy.
+class SourceBuffer {
+public:
+    ~SourceBuffer();
+    SourceBuffer(const SourceBuffer&) = delete;
+    SourceBuffer& operator=(const SourceBuffer&) = delete;
+
+    // Largest source the front end can address: token streams store
+    // offsets, lengths, lines and columns in 32 bits
+    static constexpr size_t MAX_SIZE = UINT32_MAX;
+
+    // Map (or read) `path`. Returns nullptr and sets `error` on failure,
+    // including for files larger than MAX_SIZE.
+    static std::unique_ptr<SourceBuffer> open(const std::string& path, std::string& error);
+
+    // Buffer owning an in-memory copy (tests, generated sources)
+    static std::unique_ptr<SourceBuffer> fromString(std::string name, std::string contents);
+
+    std::string_view text() const { return std::string_view(data_, size_); }
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+    const std::string& name() const { return name_; }
+    bool isMapped() const { return mapped_; }
+
+private:
+    SourceBuffer() : data_(nullptr), size_(0), mapped_(false) {}
+
+    std::string name_;
+    const char* data_;
+    size_t size_;
+    bool mapped_;
+    std::string owned_; // Backing storage when not mapped
+};
+
+} // namespace syclang
+
+#endif // SYCLANG_LEXER_SOURCE_BUFFER_H
@@ -2,6 +2,7 @@
 #define SYCLANG_LEXER_TOKEN_H
 
 #include <string>
+#include <string_view>
 
 namespace syclang {
 
@@ -78,11 +79,13 @@ class Token {
 public:
     Token() : type_(TokenType::UNKNOWN), line_(0), column_(0) {}
     
-    Token(TokenType type, std::string value, size_t line, size_t column)
-        : type_(type), value_(std::move(value)), line_(line), column_(column) {}
+    // `value` must outlive the token: it is a slice of the source buffer
+    // (or a string literal for fixed-spelling tokens)
+    Token(TokenType type, std::string_view value, size_t line, size_t column)
+        : type_(type), value_(value), line_(line), column_(column) {}
     
     TokenType type() const { return type_; }
-    const std::string& value() const { return value_; }
+    std::string_view value() const { return value_; }
     size_t line() const { return line_; }
     size_t column() const { return column_; }
     
@@ -99,7 +102,7 @@ public:
 
 private:
     TokenType type_;
-    std::string value_;
+    std::string_view value_;
     size_t line_;
     size_t column_;
     std::string chineseDescription_; // 中文描述注释
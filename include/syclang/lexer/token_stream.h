@@ -0,0 +1,78 @@
+#ifndef SYCLANG_LEXER_TOKEN_STREAM_H
+#define SYCLANG_LEXER_TOKEN_STREAM_H
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+#include "token.h"
+
+namespace syclang {
+
+static_assert(static_cast<unsigned>(TokenType::UNKNOWN) <= 0xFF,
+              "TokenType must fit in one byte of the token stream");
+
+// Output of Lexer::tokenize(), stored as a structure of arrays.
+//
+// Each token is a kind byte, a source offset/length and a packed
+// line/column pair (17 bytes, versus ~80 for a Token). Values are
+// materialized lazily as slices of the source, which must outlive the
+// stream. The last token is always EOF_TOKEN.
+class TokenStream {
+public:
+    explicit TokenStream(std::string_view source) : source_(source) {}
+
+    void reserve(size_t count) {
+        kinds_.reserve(count);
+        spans_.reserve(count);
+        locations_.reserve(count);
+    }
+
+    void push(TokenType type, uint32_t offset, uint32_t length, uint32_t line, uint32_t column) {
+        kinds_.push_back(static_cast<uint8_t>(type));
+        spans_.push_back({offset, length});
+        locations_.push_back(static_cast<uint64_t>(line) << 32 | column);
+    }
+
+    size_t size() const { return kinds_.size(); }
+    bool empty() const { return kinds_.empty(); }
+
+    TokenType type(size_t index) const { return static_cast<TokenType>(kinds_[index]); }
+    bool is(size_t index, TokenType type) const { return kinds_[index] == static_cast<uint8_t>(type); }
+
+    std::string_view value(size_t index) const {
+        return source_.substr(spans_[index].offset, spans_[index].length);
+    }
+
+    uint32_t offset(size_t index) const { return spans_[index].offset; }
+    uint32_t line(size_t index) const { return static_cast<uint32_t>(locations_[index] >> 32); }
+    uint32_t column(size_t index) const { return static_cast<uint32_t>(locations_[index]); }
+
+    // Standalone Token for one entry (diagnostics, tests)
+    Token token(size_t index) const {
+        return Token(type(index), value(index), line(index), column(index));
+    }
+    Token operator[](size_t index) const { return token(index); }
+
+    std::string_view source() const { return source_; }
+
+    // Bytes held by the stream's arrays
+    size_t memoryUsage() const {
+        return kinds_.capacity() * sizeof(uint8_t) + spans_.capacity() * sizeof(Span) +
+               locations_.capacity() * sizeof(uint64_t);
+    }
+
+private:
+    struct Span {
+        uint32_t offset;
+        uint32_t length;
+    };
+
+    std::string_view source_;
+    std::vector<uint8_t> kinds_;
+    std::vector<Span> spans_;
+    std::vector<uint64_t> locations_; // line << 32 | column
+};
+
+} // namespace syclang
+
+#endif // SYCLANG_LEXER_TOKEN_STREAM_H
@@ -0,0 +1,18 @@
+#ifndef SYCLANG_OPTIMIZER_DEAD_CODE_H
+#define SYCLANG_OPTIMIZER_DEAD_CODE_H
+
+#include "syclang/ir/ir.h"
+#include <cstddef>
+
+namespace syclang {
+
+// Aggressive dead code elimination. Instructions with side effects are
+// the roots: STORE, CALL and terminators. Everything a live instruction
+// reads through the use-def chains is live in turn (a worklist, so each
+// instruction is visited once); the rest is deleted in a single sweep.
+// Returns the number of instructions removed.
+size_t eliminateDeadCode(IRArena& arena, IRFunction& func);
+
+} // namespace syclang
+
+#endif // SYCLANG_OPTIMIZER_DEAD_CODE_H
@@ -0,0 +1,25 @@
+#ifndef SYCLANG_OPTIMIZER_GVN_H
+#define SYCLANG_OPTIMIZER_GVN_H
+
+#include "syclang/ir/dominators.h"
+#include "syclang/ir/ir.h"
+#include <cstddef>
+
+namespace syclang {
+
+// Dominator-scoped global value numbering. Pure instructions (arithmetic,
+// bitwise, comparisons and conversions) are keyed by opcode, result type
+// and operand ids in a hash table; walking the dominator tree, an
+// instruction whose key is already available from a dominating block is
+// replaced by the earlier result. Operands of commutative operations are
+// put in id order and GT/GE are rewritten as LT/LE with swapped operands,
+// so `a + b` matches `b + a` and `a < b` matches `b > a`. Each
+// instruction is hashed once. Returns the number of instructions removed.
+size_t numberValues(IRArena& arena, IRFunction& func);
+// Same, with the function's dominator tree already at hand; GVN only
+// deletes instructions, so the tree stays valid afterwards
+size_t numberValues(IRArena& arena, IRFunction& func, const DominatorTree& dom);
+
+} // namespace syclang
+
+#endif // SYCLANG_OPTIMIZER_GVN_H
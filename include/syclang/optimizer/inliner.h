@@ -0,0 +1,35 @@
+#ifndef SYCLANG_OPTIMIZER_INLINER_H
+#define SYCLANG_OPTIMIZER_INLINER_H
+
+#include "syclang/ir/call_graph.h"
+#include "syclang/ir/ir.h"
+#include <cstddef>
+
+namespace syclang {
+
+struct InlineOptions {
+    int threshold = 12;            // Largest cost inlined without #[inline]
+    int hotBonus = 12;             // Extra allowance for calls inside loops
+    size_t maxCallerSize = 2000;   // Callers stop growing past this many instructions
+};
+
+// Bottom-up inlining over the call graph: callees are finished before
+// their callers, so a body is copied with its own calls already inlined.
+// Functions on a cycle of the call graph are never inlined.
+//
+// A call site's cost is the callee's size (instructions other than PHI,
+// ALLOCA, BR and RET) minus what the call itself costs: 5 for the call,
+// prologue and epilogue, 1 per argument moved, and 2 more per constant
+// argument that constant propagation can then fold. #[inline] inlines
+// regardless of cost and #[noinline] never; other calls are inlined when
+// the cost is at most the threshold (plus hotBonus inside a loop) and the
+// caller stays within maxCallerSize. Calls copied in from a callee are
+// not considered again. Returns the number of calls inlined.
+size_t inlineFunctions(IRModule& module, const InlineOptions& options = {});
+// Same, with the module's call graph already built. The graph describes
+// the module as it was, so it is stale once anything was inlined.
+size_t inlineFunctions(IRModule& module, const CallGraph& graph, const InlineOptions& options = {});
+
+} // namespace syclang
+
+#endif // SYCLANG_OPTIMIZER_INLINER_H
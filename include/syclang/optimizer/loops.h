@@ -0,0 +1,65 @@
+#ifndef SYCLANG_OPTIMIZER_LOOPS_H
+#define SYCLANG_OPTIMIZER_LOOPS_H
+
+#include "syclang/ir/ir.h"
+#include "syclang/ir/loop_info.h"
+#include "syclang/optimizer/vectorize.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace syclang {
+
+struct LoopOptions {
+    unsigned unrollFactor = 4;     // Body copies per trip of a counted loop (1 disables)
+    unsigned maxUnrolledSize = 64; // Instructions unrolling may add to one loop
+    bool hoistInvariants = true;
+    bool reduceStrength = true;
+    VectorIsa vectorIsa = VectorIsa::NONE; // Vectorize counted loops first (see vectorize.h)
+};
+
+// What happened to one loop. Cycle estimates are static: the summed
+// latencies of the loop's instructions for one iteration of the source
+// loop (after unrolling, the unrolled body divided by the factor).
+struct LoopReport {
+    std::string function;
+    std::string header;
+    unsigned depth = 1;
+    int64_t tripCount = -1; // -1 when not a known constant
+    size_t hoisted = 0;
+    size_t reduced = 0;
+    unsigned unrollFactor = 1;
+    double cyclesBefore = 0;
+    double cyclesAfter = 0;
+    unsigned vectorLanes = 1;  // Elements per trip of the vector loop put in front
+    std::string vectorNote;    // Vectorizer outcome for innermost loops
+};
+
+// Rough latency in cycles of the code the backends emit for an opcode
+double instructionLatency(Opcode op);
+
+// Loop optimizations over the natural loops of a function, innermost
+// first. Each needs a preheader (a sole outside predecessor that only
+// branches into the loop), which loops built by IRGenerator always have.
+//
+// - Invariant code motion: pure instructions whose operands are all
+//   defined outside the loop move to the preheader. Divisions only move
+//   when their divisor is a constant other than 0 and -1, so nothing that
+//   could trap is speculated.
+// - Strength reduction: for a basic induction variable i (a header PHI
+//   stepped by an invariant amount on the single latch), each i * k with
+//   k invariant becomes a new induction variable stepped by step * k.
+// - Unrolling: an innermost loop whose blocks form a straight chain
+//   header -> body... -> header, tested on a PHI against a constant with
+//   constant start and step, has its trip count computed by stepping the
+//   PHI; the body is then copied up to unrollFactor times, with the factor
+//   chosen to divide the trip count so the copies need no exit test.
+std::vector<LoopReport> optimizeLoops(IRArena& arena, IRFunction& func,
+                                      const LoopOptions& options = {});
+// Same, starting from the function's current loops
+std::vector<LoopReport> optimizeLoops(IRArena& arena, IRFunction& func, const LoopInfo& loops,
+                                      const LoopOptions& options = {});
+
+} // namespace syclang
+
+#endif // SYCLANG_OPTIMIZER_LOOPS_H
@@ -2,29 +2,68 @@
 #define SYCLANG_OPTIMIZER_OPTIMIZER_H
 
 #include "syclang/ir/ir.h"
+#include "syclang/optimizer/inliner.h"
+#include "syclang/optimizer/loops.h"
+#include "syclang/optimizer/pass_manager.h"
 #include <memory>
 #include <set>
 #include <map>
+#include <string>
 
 namespace syclang {
 
+// The standard passes, registered with a PassManager:
+//   inline  bottom-up inlining (module)      sccp   constant propagation
+//   gvn     value numbering                  loops  vectorize, LICM, strength
+//   dce     dead code elimination                   reduction and unrolling
+// -O1 runs sccp,dce and -O2 inline,sccp,gvn,loops,dce, unless an explicit
+// pipeline was set.
 class Optimizer {
 public:
     Optimizer();
+    Optimizer(const Optimizer&) = delete;
+    Optimizer& operator=(const Optimizer&) = delete;
     
     void setOptimizationLevel(int level) { optimizationLevel_ = level; }
+    void setLoopOptions(const LoopOptions& options) { loopOptions_ = options; }
+    void setInlineOptions(const InlineOptions& options) { inlineOptions_ = options; }
+    // Comma-separated pass names replacing the -O pipeline; throws
+    // std::runtime_error naming an unknown pass
+    void setPipeline(const std::string& pipeline);
+    static std::string pipelineForLevel(int level);
     
-    // Run all optimizations
+    // Run the pipeline
     void optimize(std::shared_ptr<IRModule> module);
     
+    PassManager& getPassManager() { return passManager_; }
+    const std::vector<PassTiming>& getPassTimings() const { return passManager_.getTimings(); }
+    std::string formatPassTimings() const { return passManager_.formatTimings(); }
+    
+    // Work done by the passes so far
+    struct Stats {
+        size_t deadInstructions = 0;
+        size_t foldedConstants = 0;
+        size_t foldedBranches = 0;
+        size_t unreachableBlocks = 0;
+        size_t redundantInstructions = 0;
+        size_t inlinedCalls = 0;
+    };
+    const Stats& getStats() const { return stats_; }
+    
+    // One entry per loop, innermost first within each function
+    const std::vector<LoopReport>& getLoopReports() const { return loopReports_; }
+    std::string formatLoopReport() const;
+    
 private:
     int optimizationLevel_;
+    bool explicitPipeline_ = false;
+    Stats stats_;
+    LoopOptions loopOptions_;
+    InlineOptions inlineOptions_;
+    std::vector<LoopReport> loopReports_;
+    PassManager passManager_;
     
-    // Individual optimizations
-    void eliminateDeadCode(std::shared_ptr<IRModule> module);
-    void foldConstants(std::shared_ptr<IRModule> module);
-    void eliminateCommonSubexpressions(std::shared_ptr<IRModule> module);
-    void optimizeLoops(std::shared_ptr<IRModule> module);
+    void registerPasses();
 };
 
 } // namespace syclang
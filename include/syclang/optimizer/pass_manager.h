@@ -0,0 +1,144 @@
+#ifndef SYCLANG_OPTIMIZER_PASS_MANAGER_H
+#define SYCLANG_OPTIMIZER_PASS_MANAGER_H
+
+#include "syclang/ir/call_graph.h"
+#include "syclang/ir/dominators.h"
+#include "syclang/ir/ir.h"
+#include "syclang/ir/loop_info.h"
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace syclang {
+
+enum class Analysis : uint8_t {
+    DOMINATORS,
+    LOOPS,      // Needs DOMINATORS
+    CALL_GRAPH, // Module-wide
+    COUNT
+};
+
+const char* analysisName(Analysis analysis);
+
+// What a pass left valid. A pass that keeps the CFG and every CALL where
+// it was preserves everything; dropping DOMINATORS drops LOOPS with it.
+class PreservedAnalyses {
+public:
+    static PreservedAnalyses all() { return PreservedAnalyses(ALL); }
+    static PreservedAnalyses none() { return PreservedAnalyses(0); }
+
+    bool preserves(Analysis analysis) const { return (mask_ & bit(analysis)) != 0; }
+    PreservedAnalyses& abandon(Analysis analysis) {
+        mask_ &= ~bit(analysis);
+        return *this;
+    }
+
+private:
+    static constexpr uint32_t ALL = (1u << static_cast<unsigned>(Analysis::COUNT)) - 1;
+    static uint32_t bit(Analysis analysis) { return 1u << static_cast<unsigned>(analysis); }
+    explicit PreservedAnalyses(uint32_t mask) : mask_(mask) {}
+
+    uint32_t mask_;
+};
+
+// Analysis results for one module, computed on first request and kept
+// until a pass invalidates them
+class AnalysisManager {
+public:
+    explicit AnalysisManager(const IRModule& module) : module_(module) {}
+
+    const DominatorTree& dominators(const IRFunction& func);
+    const LoopInfo& loops(const IRFunction& func);
+    const CallGraph& callGraph();
+    // Compute `analysis` unless it is still valid, which counts as reuse.
+    // `func` is null outside a function, where only module-wide analyses
+    // apply.
+    void require(Analysis analysis, const IRFunction* func);
+
+    void invalidate(const IRFunction& func, const PreservedAnalyses& preserved);
+    void invalidateModule(const PreservedAnalyses& preserved);
+
+    // Per analysis kind
+    struct Stats {
+        size_t computed = 0;
+        size_t reused = 0;
+        double seconds = 0;
+    };
+    const Stats& getStats(Analysis analysis) const {
+        return stats_[static_cast<size_t>(analysis)];
+    }
+
+private:
+    struct FunctionResults {
+        std::unique_ptr<DominatorTree> dominators;
+        std::unique_ptr<LoopInfo> loops;
+    };
+
+    const IRModule& module_;
+    std::unordered_map<const IRFunction*, FunctionResults> functions_;
+    std::unique_ptr<CallGraph> callGraph_;
+    Stats stats_[static_cast<size_t>(Analysis::COUNT)];
+
+    Stats& stats(Analysis analysis) { return stats_[static_cast<size_t>(analysis)]; }
+};
+
+// A named transformation. Exactly one of runOnModule / runOnFunction is
+// set; a function pass runs over every function with a body, in module
+// order. Analyses listed in `required` are computed before the pass runs
+// on a function (or on the module), so their cost shows up under the
+// analysis rather than the pass.
+struct PassInfo {
+    std::string name;
+    std::string description;
+    std::vector<Analysis> required;
+    std::function<PreservedAnalyses(IRModule&, AnalysisManager&)> runOnModule;
+    std::function<PreservedAnalyses(IRArena&, IRFunction&, AnalysisManager&)> runOnFunction;
+};
+
+// One run of one pass in the pipeline
+struct PassTiming {
+    std::string name;
+    double seconds = 0;            // Excluding analyses computed meanwhile
+    size_t instructionsBefore = 0; // Whole module
+    size_t instructionsAfter = 0;
+    size_t arenaBytesBefore = 0;   // IRArena::Stats::usedBytes
+    size_t arenaBytesAfter = 0;
+};
+
+// Registry of passes and the pipeline built from it. Names are unique;
+// registering a name twice, or building a pipeline from an unknown
+// name, throws std::runtime_error.
+class PassManager {
+public:
+    void registerPass(PassInfo info);
+    const PassInfo* find(const std::string& name) const;
+    const std::vector<PassInfo>& passes() const { return passes_; }
+
+    // Comma-separated names, e.g. "inline,sccp,dce"; a pass may repeat
+    void setPipeline(const std::string& pipeline);
+    void setPipeline(const std::vector<std::string>& names);
+    const std::vector<std::string>& pipeline() const { return pipeline_; }
+
+    void run(IRModule& module);
+
+    // One entry per pipeline position, accumulated over run() calls
+    const std::vector<PassTiming>& getTimings() const { return timings_; }
+    const AnalysisManager::Stats& getAnalysisStats(Analysis analysis) const {
+        return analysisStats_[static_cast<size_t>(analysis)];
+    }
+    std::string formatTimings() const;
+
+private:
+    std::vector<PassInfo> passes_;
+    std::unordered_map<std::string, size_t> byName_;
+    std::vector<std::string> pipeline_;
+    std::vector<PassTiming> timings_;
+    AnalysisManager::Stats analysisStats_[static_cast<size_t>(Analysis::COUNT)];
+};
+
+} // namespace syclang
+
+#endif // SYCLANG_OPTIMIZER_PASS_MANAGER_H
@@ -0,0 +1,38 @@
+#ifndef SYCLANG_OPTIMIZER_SCCP_H
+#define SYCLANG_OPTIMIZER_SCCP_H
+
+#include "syclang/ir/ir.h"
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+namespace syclang {
+
+// Sparse conditional constant propagation (Wegman & Zadeck). Values start
+// unknown and only ever move down to a constant, then to "varies"; CFG
+// edges start dead and become executable as branches are evaluated, so a
+// PHI only meets the inputs of edges that can actually run. Afterwards
+// constant results replace their uses and are deleted, branches on
+// constants become unconditional, PHIs drop the inputs of dead edges and
+// unreachable blocks are removed. Operations that would trap or are
+// undefined (division by zero, overflowing signed division, out-of-range
+// float conversions) are left alone.
+struct ConstantPropagationStats {
+    size_t folded = 0;         // Instructions replaced by a constant
+    size_t branches = 0;       // CONDBRs made unconditional
+    size_t removedBlocks = 0;  // Unreachable blocks deleted
+};
+
+ConstantPropagationStats propagateConstants(IRArena& arena, IRFunction& func);
+
+// Fold one operation on constant bit patterns. Integers are held
+// sign- or zero-extended to 64 bits according to their type and wrap at
+// the type's width; F64 (and F32, rounded to float) constants hold the
+// bits of a double. Comparisons take signedness from `operandType`, SHR
+// is a logical shift. Returns nothing when the operation does not fold.
+std::optional<uint64_t> foldOperation(Opcode op, IRType resultType, IRType operandType,
+                                      uint64_t left, uint64_t right = 0);
+
+} // namespace syclang
+
+#endif // SYCLANG_OPTIMIZER_SCCP_H
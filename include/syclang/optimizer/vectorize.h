@@ -0,0 +1,60 @@
+#ifndef SYCLANG_OPTIMIZER_VECTORIZE_H
+#define SYCLANG_OPTIMIZER_VECTORIZE_H
+
+#include "syclang/ir/ir.h"
+#include <cstddef>
+#include <vector>
+
+namespace syclang {
+
+// SIMD instruction sets the backends can lower vector IR to
+enum class VectorIsa {
+    NONE,
+    SSE2,  // x64, 128-bit xmm
+    AVX2,  // x64, 256-bit ymm
+    NEON   // ARM64, 128-bit q registers
+};
+
+const char* vectorIsaName(VectorIsa isa);
+size_t vectorRegisterBytes(VectorIsa isa);
+int vectorRegisterCount(VectorIsa isa);
+// Baseline every CPU of the architecture has (SSE2 on x64, NEON on ARM64)
+VectorIsa defaultVectorIsa(Architecture arch);
+
+// Outcome for one innermost loop
+struct LoopVectorization {
+    BlockId header = INVALID_ID;
+    BlockId vectorHeader = INVALID_ID; // Header of the new vector loop, if any
+    unsigned lanes = 1;
+    double scalarCycles = 0;   // Estimated cycles per element before
+    double vectorCycles = 0;   // and in the vector loop
+    const char* reason = "";   // Why the loop was (not) vectorized
+};
+
+// Loop vectorization of counted loops with unit-stride accesses:
+//
+//     i = phi [init, preheader], [i + 1, latch]
+//     while (i < n) { d[i] = a[i] op b[i] ...; }
+//
+// The loop must be innermost and a straight chain of blocks whose header
+// only holds the induction variable, its test against an invariant bound
+// and the branch; the body may only load and store base[i] through
+// invariant bases of one element width and combine the loaded values
+// with wrapping integer arithmetic (no reductions, no calls, no other
+// uses of i). A vector loop processing one register of elements per trip
+// is put in front of the original, which stays as the remainder loop:
+//
+//     [.vcheck] -> .vec: vi = phi; if (vi + lanes - 1 < n) .vbody else .vexit
+//     .vbody: vector body; vi += lanes -> .vec
+//     .vexit: -> original header, starting at vi
+//
+// When stored bases may overlap another base within one vector, .vcheck
+// tests their distances at run time and sends the whole loop down the
+// scalar path. A cost model built on instructionLatency() and a register
+// pressure estimate keep the scalar loop when the vector one would not
+// be faster; the vector loop assumes i + lanes - 1 does not overflow.
+std::vector<LoopVectorization> vectorizeLoops(IRArena& arena, IRFunction& func, VectorIsa isa);
+
+} // namespace syclang
+
+#endif // SYCLANG_OPTIMIZER_VECTORIZE_H
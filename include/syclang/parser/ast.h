@@ -199,6 +199,7 @@ public:
     std::shared_ptr<BlockStmt> body;
     bool isExtern;
     bool isVariadic;
+    std::vector<std::string> attributes; // #[name, ...] before `fn`
     
     void accept(ASTVisitor& visitor) override;
 };
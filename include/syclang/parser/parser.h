@@ -2,16 +2,19 @@
 #define SYCLANG_PARSER_PARSER_H
 
 #include <memory>
+#include <string_view>
 #include <vector>
 #include "syclang/lexer/lexer.h"
 #include "syclang/lexer/token.h"
+#include "syclang/lexer/token_stream.h"
 #include "syclang/parser/ast.h"
 
 namespace syclang {
 
 class Parser {
 public:
-    explicit Parser(const std::vector<Token>& tokens);
+    // `tokens` (and the source it slices) must outlive the parser
+    explicit Parser(const TokenStream& tokens);
     
     // Parse entire program
     std::shared_ptr<Program> parse();
@@ -20,13 +23,16 @@ public:
     const std::vector<std::string>& getErrors() const { return errors_; }
     
 private:
-    const std::vector<Token>& tokens_;
+    const TokenStream& tokens_;
     size_t position_;
     std::vector<std::string> errors_;
     
-    // Token operations
-    Token current() const;
-    Token peek(size_t offset = 0) const;
+    // Token operations (read straight from the stream, nothing is copied)
+    TokenType current() const;
+    TokenType peek(size_t offset = 0) const;
+    std::string_view currentValue() const;
+    std::string_view previousValue() const;
+    bool check(TokenType type) const;
     bool advance();
     bool match(TokenType type);
     bool consume(TokenType type, const std::string& message);
@@ -0,0 +1,88 @@
+#ifndef SYCLANG_THREAD_POOL_H
+#define SYCLANG_THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace syclang {
+
+// Work-stealing thread pool.
+//
+// Every worker owns a deque: it pushes and pops its own tasks at the back
+// and steals from the front of other workers' deques when it runs dry.
+// A pool created with concurrency N starts N - 1 workers; the thread
+// that waits on a TaskGroup runs tasks as well, so N threads do work and
+// a concurrency of 1 runs everything on the caller.
+class ThreadPool {
+public:
+    // concurrency 0 = std::thread::hardware_concurrency()
+    explicit ThreadPool(unsigned concurrency = 0);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    unsigned concurrency() const { return static_cast<unsigned>(workers_.size()) + 1; }
+
+    // Queue a task. Tasks submitted from a worker go to that worker's deque.
+    void submit(std::function<void()> task);
+
+    // Run one queued task on the calling thread; false if none was found
+    bool runPendingTask();
+
+    // Resolve a --jobs style value (0 = all cores)
+    static unsigned defaultConcurrency(unsigned requested = 0);
+
+private:
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    void workerLoop(unsigned index);
+    bool takeTask(unsigned home, std::function<void()>& task);
+
+    std::vector<std::unique_ptr<WorkQueue>> queues_;
+    std::vector<std::thread> workers_;
+    std::atomic<size_t> pending_;
+    std::atomic<unsigned> nextQueue_;
+
+    std::mutex sleepMutex_;
+    std::condition_variable wake_;
+    bool stopping_;
+};
+
+// Set of tasks that can be waited on together. wait() helps run queued
+// tasks instead of blocking, so groups may be nested inside pool tasks.
+// The first exception thrown by a task is rethrown from wait().
+class TaskGroup {
+public:
+    explicit TaskGroup(ThreadPool& pool) : pool_(pool), outstanding_(0) {}
+    ~TaskGroup();
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    void run(std::function<void()> task);
+    void wait();
+
+private:
+    ThreadPool& pool_;
+    std::atomic<size_t> outstanding_;
+    std::mutex mutex_;
+    std::condition_variable done_;
+    std::exception_ptr error_;
+};
+
+// Call body(i) for every i in [0, count) on the pool and wait for all
+void parallelFor(ThreadPool& pool, size_t count, const std::function<void(size_t)>& body);
+
+} // namespace syclang
+
+#endif // SYCLANG_THREAD_POOL_H
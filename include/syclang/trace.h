@@ -0,0 +1,78 @@
+#ifndef SYCLANG_TRACE_H
+#define SYCLANG_TRACE_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace syclang {
+
+// Compile-time profile in the Chrome trace event format, for
+// chrome://tracing or ui.perfetto.dev.
+//
+// Recording is off until start(); a TraceScope then costs one relaxed
+// atomic load. Once on, every thread appends complete ("X") events to a
+// buffer of its own, so recording takes no lock, and the buffers are
+// merged when the trace is written. start() and the writers must not run
+// while other threads are recording.
+class Trace {
+public:
+    // Drop earlier events and measure time from now
+    static void start();
+    static void stop();
+    static bool enabled() { return enabled_.load(std::memory_order_relaxed); }
+
+    // {"traceEvents": [...]}, timestamps in microseconds since start()
+    static std::string toJson();
+    static bool writeJson(const std::string& path, std::string& error);
+    static size_t eventCount();
+
+    // Nanoseconds since start()
+    static uint64_t now();
+    static void record(std::string name, const char* category, std::string detail,
+                       uint64_t start, uint64_t end);
+
+private:
+    static std::atomic<bool> enabled_;
+};
+
+// Records the time between construction and destruction as one event.
+// `detail` (a file or function name, say) shows among the event's args.
+class TraceScope {
+public:
+    TraceScope(const char* name, const char* category, const std::string& detail = EMPTY)
+        : active_(Trace::enabled()) {
+        if (active_) begin(name, category, detail);
+    }
+    TraceScope(const std::string& name, const char* category, const std::string& detail = EMPTY)
+        : active_(Trace::enabled()) {
+        if (active_) begin(name.c_str(), category, detail);
+    }
+    ~TraceScope() {
+        if (active_) {
+            Trace::record(std::move(name_), category_, std::move(detail_), start_, Trace::now());
+        }
+    }
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    static inline const std::string EMPTY;
+
+    void begin(const char* name, const char* category, const std::string& detail) {
+        name_ = name;
+        category_ = category;
+        detail_ = detail;
+        start_ = Trace::now();
+    }
+
+    bool active_;
+    std::string name_;
+    const char* category_ = "";
+    std::string detail_;
+    uint64_t start_ = 0;
+};
+
+} // namespace syclang
+
+#endif // SYCLANG_TRACE_H
@@ -31,7 +31,7 @@ void print_string(const char* str) {
         "mov %1, %%rdx\n"
         "syscall"
         :
-        : "r"(str), "r"(len)
+        : "r"(str), "r"((long)len)
         : "rax", "rdi", "rsi", "rdx"
     );
 }
@@ -0,0 +1,901 @@
+#include "syclang/codegen/arm64/arm64_assembler.h"
+#include <charconv>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace syclang {
+
+namespace {
+
+struct Operand {
+    enum class Kind { REGISTER, VECTOR, IMMEDIATE, SHIFT, MEMORY, LO12, SYMBOL } kind = Kind::IMMEDIATE;
+    int reg = 0;             // 0-31; memory: the base register
+    int size = 8;            // Register bytes: 4 (w), 8 (x) or 16 (q)
+    bool sp = false;         // Register 31 is sp/wsp rather than xzr/wzr
+    int lane = 0;            // Vector: log2 of the lane bytes
+    bool full = true;        // Vector: all 128 bits rather than the low 64
+    int64_t imm = 0;         // Immediate, shift amount or memory offset
+    int shift = 0;           // Shift: 0 lsl, 1 lsr, 2 asr, 3 ror
+    int index = -1;          // Memory: index register
+    int indexShift = -1;     // Memory: lsl applied to the index, -1 when absent
+    bool writeback = false;  // Memory: pre-indexed, [base, #imm]!
+    std::string_view symbol; // Symbol, branch target or :lo12: symbol
+    std::string_view text;   // As written
+
+    bool isGeneral() const { return kind == Kind::REGISTER && size <= 8; }
+    bool isVector() const { return kind == Kind::VECTOR; }
+    bool isZero() const { return reg == 31 && !sp; }
+};
+
+const std::unordered_map<std::string_view, int>& conditionTable() {
+    static const std::unordered_map<std::string_view, int> table = {
+        {"eq", 0}, {"ne", 1}, {"cs", 2}, {"hs", 2}, {"cc", 3}, {"lo", 3}, {"mi", 4}, {"pl", 5},
+        {"vs", 6}, {"vc", 7}, {"hi", 8}, {"ls", 9}, {"ge", 10}, {"lt", 11}, {"gt", 12}, {"le", 13},
+        {"al", 14}};
+    return table;
+}
+
+// Loads and stores of one register: size (log2 bytes) and opc fields for
+// an x or w general register, or a q vector register
+struct LoadStore {
+    int size;
+    int opcX;
+    int opcW; // -1 when the w form does not exist
+    int opcQ; // -1 when the q form does not exist
+};
+
+const std::unordered_map<std::string_view, LoadStore>& loadStoreTable() {
+    static const std::unordered_map<std::string_view, LoadStore> table = {
+        {"ldr", {3, 1, 1, 3}}, {"str", {3, 0, 0, 2}}, {"ldrb", {0, -1, 1, -1}}, {"strb", {0, -1, 0, -1}},
+        {"ldrh", {1, -1, 1, -1}}, {"strh", {1, -1, 0, -1}}, {"ldrsb", {0, 2, 3, -1}},
+        {"ldrsh", {1, 2, 3, -1}}, {"ldrsw", {2, 2, -1, -1}}};
+    return table;
+}
+
+bool fits(int64_t value, int bits) {
+    return value >= -(int64_t(1) << (bits - 1)) && value < (int64_t(1) << (bits - 1));
+}
+
+std::string_view trim(std::string_view text) {
+    size_t first = text.find_first_not_of(" \t\r");
+    if (first == std::string_view::npos) return {};
+    size_t last = text.find_last_not_of(" \t\r");
+    return text.substr(first, last - first + 1);
+}
+
+bool parseInteger(std::string_view text, int64_t& value) {
+    bool negative = !text.empty() && text[0] == '-';
+    if (negative) text.remove_prefix(1);
+    int base = 10;
+    if (text.size() > 2 && text[0] == '0' && (text[1] == 'x' || text[1] == 'X')) {
+        text.remove_prefix(2);
+        base = 16;
+    }
+    if (text.empty()) return false;
+    uint64_t magnitude = 0;
+    auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), magnitude, base);
+    if (error != std::errc() || end != text.data() + text.size()) return false;
+    value = static_cast<int64_t>(negative ? 0 - magnitude : magnitude);
+    return true;
+}
+
+// A logical immediate: a rotated run of ones, repeated in 2, 4, ..., 64
+// bit elements. False when `value` has no such encoding.
+bool encodeBitmask(uint64_t value, int width, uint32_t& n, uint32_t& immr, uint32_t& imms) {
+    if (width == 32) value = (value & 0xFFFFFFFFu) | value << 32;
+    if (value == 0 || value == ~uint64_t(0)) return false;
+    int size = 64;
+    while (size > 2) {
+        int half = size / 2;
+        uint64_t mask = (uint64_t(1) << half) - 1;
+        if ((value & mask) != (value >> half & mask)) break;
+        size = half;
+    }
+    uint64_t mask = size == 64 ? ~uint64_t(0) : (uint64_t(1) << size) - 1;
+    uint64_t element = value & mask;
+    int ones = 0;
+    for (uint64_t bits = element; bits; bits &= bits - 1) ++ones;
+    uint64_t run = ones == 64 ? ~uint64_t(0) : (uint64_t(1) << ones) - 1;
+    for (int rotation = 0; rotation < size; ++rotation) {
+        uint64_t rotated = rotation == 0 ? run : (run >> rotation | run << (size - rotation)) & mask;
+        if (rotated == element) {
+            n = size == 64 ? 1 : 0;
+            immr = static_cast<uint32_t>(rotation);
+            imms = static_cast<uint32_t>((~(size - 1) << 1 | (ones - 1)) & 0x3F);
+            return true;
+        }
+    }
+    return false;
+}
+
+enum class BranchKind { IMM26, IMM19 };
+
+struct Branch {
+    size_t position;
+    BranchKind kind;
+    std::string_view label;
+    bool call;
+};
+
+struct Definition {
+    std::string_view name;
+    Section section;
+    size_t position;
+};
+
+class Assembler {
+public:
+    ObjectCode run(std::string_view assembly);
+
+private:
+    std::string_view line_;
+    Section section_ = Section::TEXT;
+    std::vector<uint8_t> text_;
+    std::vector<uint8_t> data_;
+    std::vector<Branch> branches_;
+    std::vector<Definition> definitions_;
+    std::unordered_map<std::string_view, size_t> textLabels_;
+    std::unordered_set<std::string_view> globals_;
+    std::vector<Relocation> relocations_;
+
+    [[noreturn]] void fail(const std::string& reason) const {
+        throw std::runtime_error("ARM64 assembler: cannot assemble '" + std::string(line_) + "': " + reason);
+    }
+
+    std::vector<uint8_t>& out() { return section_ == Section::TEXT ? text_ : data_; }
+    void word(uint32_t value) {
+        for (int i = 0; i < 4; ++i) text_.push_back(static_cast<uint8_t>(value >> (8 * i)));
+    }
+    void relocate(std::string_view symbol, RelocationType type) {
+        relocations_.push_back({Section::TEXT, text_.size(), std::string(symbol), type, 0});
+    }
+
+    void statement(std::string_view line);
+    void directive(std::string_view line);
+    Operand parseOperand(std::string_view text);
+    void parseAddress(std::string_view text, Operand& op);
+
+    uint32_t general(const Operand& op, bool allowSp = false) const;
+    int widthOf(const Operand& d, const Operand& n) const;
+
+    void instruction(std::string_view mnemonic, Operand* ops, size_t count);
+    bool integerInstruction(std::string_view mnemonic, Operand* ops, size_t count);
+    bool branchInstruction(std::string_view mnemonic, Operand* ops, size_t count);
+    bool memoryInstruction(std::string_view mnemonic, Operand* ops, size_t count);
+    bool vectorInstruction(std::string_view mnemonic, Operand* ops, size_t count);
+    void addSub(bool sub, bool setFlags, const Operand& d, const Operand& n, const Operand& m, const Operand* shift);
+    void logical(int opc, bool invert, const Operand& d, const Operand& n, const Operand& m, const Operand* shift);
+    void moveImmediate(const Operand& d, int64_t value);
+    void bitfield(bool sign, const Operand& d, const Operand& n, uint32_t immr, uint32_t imms);
+};
+
+void Assembler::statement(std::string_view line) {
+    line_ = line;
+    if (line.empty()) return;
+    if (line[0] == '.') {
+        directive(line);
+        return;
+    }
+    if (line.back() == ':') {
+        std::string_view name = line.substr(0, line.size() - 1);
+        size_t at = out().size();
+        if (section_ == Section::TEXT && !textLabels_.emplace(name, at).second) {
+            fail("label defined twice");
+        }
+        definitions_.push_back({name, section_, at});
+        return;
+    }
+
+    size_t space = line.find_first_of(" \t");
+    std::string_view mnemonic = line.substr(0, space);
+    Operand ops[5];
+    size_t count = 0;
+    if (space != std::string_view::npos) {
+        // Commas inside [] separate address parts, not operands
+        std::string_view rest = trim(line.substr(space + 1));
+        size_t start = 0;
+        int depth = 0;
+        for (size_t i = 0; i <= rest.size(); ++i) {
+            if (i < rest.size() && rest[i] == '[') ++depth;
+            if (i < rest.size() && rest[i] == ']') --depth;
+            if (i == rest.size() || (rest[i] == ',' && depth == 0)) {
+                if (count == 5) fail("too many operands");
+                ops[count++] = parseOperand(trim(rest.substr(start, i - start)));
+                start = i + 1;
+            }
+        }
+    }
+    if (section_ != Section::TEXT) fail("instruction outside .text");
+    instruction(mnemonic, ops, count);
+}
+
+void Assembler::directive(std::string_view line) {
+    size_t space = line.find_first_of(" \t");
+    std::string_view name = line.substr(0, space);
+    std::string_view argument = space == std::string_view::npos ? std::string_view() : trim(line.substr(space));
+    if (name == ".section" || name == ".text" || name == ".data") {
+        std::string_view target = name == ".section" ? argument : name;
+        if (target == ".text") {
+            section_ = Section::TEXT;
+        } else if (target == ".data") {
+            section_ = Section::DATA;
+        } else {
+            fail("unknown section");
+        }
+    } else if (name == ".global" || name == ".globl") {
+        globals_.insert(argument);
+    } else if (name == ".quad") {
+        int64_t value = 0;
+        if (!parseInteger(argument, value)) fail("bad value");
+        for (int i = 0; i < 8; ++i) out().push_back(static_cast<uint8_t>(static_cast<uint64_t>(value) >> (8 * i)));
+    } else if (name == ".zero") {
+        int64_t size = 0;
+        if (!parseInteger(argument, size) || size < 0) fail("bad size");
+        out().resize(out().size() + static_cast<size_t>(size));
+    } else {
+        fail("unknown directive");
+    }
+}
+
+Operand Assembler::parseOperand(std::string_view text) {
+    Operand op;
+    op.text = text;
+    if (text.empty()) fail("empty operand");
+    if (text[0] == '[') {
+        op.kind = Operand::Kind::MEMORY;
+        if (text.back() == '!') {
+            op.writeback = true;
+            text.remove_suffix(1);
+        }
+        if (text.back() != ']') fail("unterminated address");
+        parseAddress(text.substr(1, text.size() - 2), op);
+        return op;
+    }
+    if (text[0] == '#') {
+        if (!parseInteger(text.substr(1), op.imm)) fail("bad immediate");
+        return op;
+    }
+    if (text.substr(0, 6) == ":lo12:") {
+        op.kind = Operand::Kind::LO12;
+        op.symbol = text.substr(6);
+        return op;
+    }
+
+    static const std::string_view SHIFTS[] = {"lsl", "lsr", "asr", "ror"};
+    for (int s = 0; s < 4; ++s) {
+        if (text.size() > 4 && text.substr(0, 3) == SHIFTS[s] && (text[3] == ' ' || text[3] == '\t')) {
+            std::string_view amount = trim(text.substr(4));
+            op.kind = Operand::Kind::SHIFT;
+            op.shift = s;
+            if (amount.empty() || amount[0] != '#' || !parseInteger(amount.substr(1), op.imm)) {
+                fail("bad shift amount");
+            }
+            return op;
+        }
+    }
+
+    op.kind = Operand::Kind::REGISTER;
+    if (text == "sp" || text == "wsp") {
+        op.reg = 31;
+        op.size = text == "sp" ? 8 : 4;
+        op.sp = true;
+        return op;
+    }
+    if (text == "xzr" || text == "wzr") {
+        op.reg = 31;
+        op.size = text == "xzr" ? 8 : 4;
+        return op;
+    }
+    if (text == "fp" || text == "lr") {
+        op.reg = text == "fp" ? 29 : 30;
+        return op;
+    }
+    char prefix = text[0];
+    std::string_view number = text.substr(1);
+    std::string_view arrangement;
+    if (prefix == 'v') {
+        size_t dot = number.find('.');
+        arrangement = dot == std::string_view::npos ? std::string_view() : number.substr(dot + 1);
+        number = dot == std::string_view::npos ? std::string_view() : number.substr(0, dot);
+    }
+    int64_t value = 0;
+    if ((prefix == 'x' || prefix == 'w' || prefix == 'q' || prefix == 'v') && parseInteger(number, value) &&
+        number[0] != '-' && value <= (prefix == 'x' || prefix == 'w' ? 30 : 31)) {
+        op.reg = static_cast<int>(value);
+        op.size = prefix == 'w' ? 4 : prefix == 'x' ? 8 : 16;
+        if (prefix == 'v') {
+            static const std::unordered_map<std::string_view, std::pair<int, bool>> ARRANGEMENTS = {
+                {"8b", {0, false}}, {"16b", {0, true}}, {"4h", {1, false}}, {"8h", {1, true}},
+                {"2s", {2, false}}, {"4s", {2, true}}, {"1d", {3, false}}, {"2d", {3, true}}};
+            auto it = ARRANGEMENTS.find(arrangement);
+            if (it == ARRANGEMENTS.end()) fail("bad arrangement");
+            op.kind = Operand::Kind::VECTOR;
+            op.lane = it->second.first;
+            op.full = it->second.second;
+        }
+        return op;
+    }
+    op.kind = Operand::Kind::SYMBOL;
+    op.symbol = text;
+    return op;
+}
+
+// [base], [base, #imm], [base, index{, lsl #n}] or [base, :lo12:symbol]
+void Assembler::parseAddress(std::string_view text, Operand& op) {
+    std::vector<std::string_view> parts;
+    while (true) {
+        size_t comma = text.find(',');
+        parts.push_back(trim(text.substr(0, comma)));
+        if (comma == std::string_view::npos) break;
+        text = text.substr(comma + 1);
+    }
+    if (parts.size() > 3) fail("bad address");
+    Operand base = parseOperand(parts[0]);
+    if (!base.isGeneral() || base.size != 8 || base.isZero()) fail("bad base register");
+    op.reg = base.reg;
+    if (parts.size() == 1) return;
+
+    Operand offset = parseOperand(parts[1]);
+    if (offset.kind == Operand::Kind::IMMEDIATE && parts.size() == 2) {
+        op.imm = offset.imm;
+    } else if (offset.kind == Operand::Kind::LO12 && parts.size() == 2) {
+        op.symbol = offset.symbol;
+    } else if (offset.isGeneral() && offset.size == 8 && !offset.sp) {
+        op.index = offset.reg;
+        if (parts.size() == 3) {
+            Operand shift = parseOperand(parts[2]);
+            if (shift.kind != Operand::Kind::SHIFT || shift.shift != 0) fail("bad index shift");
+            op.indexShift = static_cast<int>(shift.imm);
+        }
+    } else {
+        fail("bad address");
+    }
+    if (op.writeback && (op.index >= 0 || !op.symbol.empty())) fail("bad writeback");
+}
+
+// The register field of a general register operand; sp only where the
+// encoding reads register 31 as sp
+uint32_t Assembler::general(const Operand& op, bool allowSp) const {
+    if (!op.isGeneral()) fail("expected a general register");
+    if (op.sp && !allowSp) fail("sp not allowed here");
+    return static_cast<uint32_t>(op.reg);
+}
+
+int Assembler::widthOf(const Operand& d, const Operand& n) const {
+    if (!d.isGeneral() || !n.isGeneral() || d.size != n.size) fail("operand sizes differ");
+    return d.size * 8;
+}
+
+void Assembler::instruction(std::string_view mnemonic, Operand* ops, size_t count) {
+    if (count > 0 && ops[0].isVector()) {
+        if (vectorInstruction(mnemonic, ops, count)) return;
+    } else if (integerInstruction(mnemonic, ops, count) || branchInstruction(mnemonic, ops, count) ||
+               memoryInstruction(mnemonic, ops, count)) {
+        return;
+    }
+    fail("unknown instruction");
+}
+
+void Assembler::addSub(bool sub, bool setFlags, const Operand& d, const Operand& n, const Operand& m,
+                       const Operand* shift) {
+    int width = widthOf(d, n);
+    uint32_t sf = width == 64 ? 1u << 31 : 0;
+    uint32_t rd = general(d, !setFlags);
+    if (m.kind == Operand::Kind::IMMEDIATE) {
+        uint32_t rn = general(n, true);
+        int64_t value = m.imm;
+        if (shift) {
+            if (shift->shift != 0 || (shift->imm != 0 && shift->imm != 12)) fail("bad shift");
+            value <<= shift->imm;
+        }
+        // add #-n is sub #n, as the assemblers rewrite it
+        if (value < 0) {
+            value = -value;
+            sub = !sub;
+        }
+        uint32_t sh = 0;
+        if (value > 0xFFF) {
+            if ((value & 0xFFF) || value >> 24) fail("immediate out of range");
+            value >>= 12;
+            sh = 1;
+        }
+        word(sf | sub << 30 | setFlags << 29 | 0x11000000 | sh << 22 | static_cast<uint32_t>(value) << 10 |
+             rn << 5 | rd);
+    } else if (m.kind == Operand::Kind::LO12) {
+        if (sub || setFlags || width != 64 || shift) fail("bad :lo12: operand");
+        relocate(m.symbol, RelocationType::ADD_ABS_LO12_NC);
+        word(0x91000000 | general(n, true) << 5 | rd);
+    } else if (d.sp || n.sp) {
+        // Register 31 means sp only in the extended-register form
+        if (!m.isGeneral() || m.size != d.size) fail("bad operands");
+        uint32_t amount = 0;
+        if (shift) {
+            if (shift->shift != 0 || shift->imm < 0 || shift->imm > 4) fail("bad shift");
+            amount = static_cast<uint32_t>(shift->imm);
+        }
+        uint32_t option = width == 64 ? 3 : 2; // uxtx, uxtw: plain lsl
+        word(sf | sub << 30 | setFlags << 29 | 0x0B200000 | general(m) << 16 | option << 13 | amount << 10 |
+             general(n, true) << 5 | rd);
+    } else {
+        if (!m.isGeneral() || m.size != d.size) fail("bad operands");
+        uint32_t type = 0, amount = 0;
+        if (shift) {
+            if (shift->shift == 3 || shift->imm < 0 || shift->imm >= width) fail("bad shift");
+            type = static_cast<uint32_t>(shift->shift);
+            amount = static_cast<uint32_t>(shift->imm);
+        }
+        word(sf | sub << 30 | setFlags << 29 | 0x0B000000 | type << 22 | general(m) << 16 | amount << 10 |
+             general(n) << 5 | rd);
+    }
+}
+
+void Assembler::logical(int opc, bool invert, const Operand& d, const Operand& n, const Operand& m,
+                        const Operand* shift) {
+    int width = widthOf(d, n);
+    uint32_t sf = width == 64 ? 1u << 31 : 0;
+    if (m.kind == Operand::Kind::IMMEDIATE) {
+        uint32_t bitN = 0, immr = 0, imms = 0;
+        if (invert || shift || !encodeBitmask(static_cast<uint64_t>(m.imm), width, bitN, immr, imms)) {
+            fail("immediate cannot be encoded");
+        }
+        word(sf | static_cast<uint32_t>(opc) << 29 | 0x12000000 | bitN << 22 | immr << 16 | imms << 10 |
+             general(n) << 5 | general(d, opc != 3));
+        return;
+    }
+    if (!m.isGeneral() || m.size != d.size) fail("bad operands");
+    uint32_t type = 0, amount = 0;
+    if (shift) {
+        if (shift->imm < 0 || shift->imm >= width) fail("bad shift");
+        type = static_cast<uint32_t>(shift->shift);
+        amount = static_cast<uint32_t>(shift->imm);
+    }
+    word(sf | static_cast<uint32_t>(opc) << 29 | 0x0A000000 | type << 22 | invert << 21 | general(m) << 16 |
+         amount << 10 | general(n) << 5 | general(d));
+}
+
+// movz when one halfword is set, movn when one is clear, else orr with a
+// logical immediate: the order both assemblers try
+void Assembler::moveImmediate(const Operand& d, int64_t value) {
+    int width = d.size * 8;
+    uint32_t sf = width == 64 ? 1u << 31 : 0;
+    uint64_t mask = width == 64 ? ~uint64_t(0) : 0xFFFFFFFFu;
+    if (width == 32 && (value < INT32_MIN || value > UINT32_MAX)) fail("immediate out of range");
+    uint64_t bits = static_cast<uint64_t>(value) & mask;
+    uint32_t rd = general(d);
+    for (int inverted = 0; inverted < 2; ++inverted) {
+        uint64_t target = inverted ? ~bits & mask : bits;
+        for (int hw = 0; hw < width / 16; ++hw) {
+            if ((target & ~(uint64_t(0xFFFF) << (16 * hw))) == 0) {
+                uint32_t opc = inverted ? 0 : 2;
+                word(sf | opc << 29 | 0x12800000 | static_cast<uint32_t>(hw) << 21 |
+                     static_cast<uint32_t>(target >> (16 * hw) & 0xFFFF) << 5 | rd);
+                return;
+            }
+        }
+    }
+    uint32_t bitN = 0, immr = 0, imms = 0;
+    if (!encodeBitmask(bits, width, bitN, immr, imms)) fail("immediate cannot be moved in one instruction");
+    word(sf | 1u << 29 | 0x12000000 | bitN << 22 | immr << 16 | imms << 10 | 31 << 5 | rd);
+}
+
+void Assembler::bitfield(bool sign, const Operand& d, const Operand& n, uint32_t immr, uint32_t imms) {
+    uint32_t sf = d.size == 8 ? 1u << 31 | 1u << 22 : 0;
+    word(sf | (sign ? 0x13000000u : 0x53000000u) | immr << 16 | imms << 10 | general(n) << 5 | general(d));
+}
+
+bool Assembler::integerInstruction(std::string_view mnemonic, Operand* ops, size_t count) {
+    auto expect = [&](size_t low, size_t high) {
+        if (count < low || count > high) fail("wrong number of operands");
+    };
+    auto shiftOperand = [&](size_t i) -> const Operand* {
+        if (count <= i) return nullptr;
+        if (ops[i].kind != Operand::Kind::SHIFT) fail("expected a shift");
+        return &ops[i];
+    };
+    auto zeroLike = [](const Operand& op) {
+        Operand zero;
+        zero.kind = Operand::Kind::REGISTER;
+        zero.reg = 31;
+        zero.size = op.size;
+        return zero;
+    };
+    auto condition = [&](const Operand& op) {
+        auto it = conditionTable().find(op.symbol);
+        if (op.kind != Operand::Kind::SYMBOL || it == conditionTable().end()) fail("bad condition");
+        return static_cast<uint32_t>(it->second);
+    };
+
+    static const std::unordered_map<std::string_view, std::pair<bool, bool>> ADD_SUB = {
+        {"add", {false, false}}, {"adds", {false, true}}, {"sub", {true, false}}, {"subs", {true, true}}};
+    if (auto it = ADD_SUB.find(mnemonic); it != ADD_SUB.end()) {
+        expect(3, 4);
+        addSub(it->second.first, it->second.second, ops[0], ops[1], ops[2], shiftOperand(3));
+        return true;
+    }
+    if (mnemonic == "cmp" || mnemonic == "cmn") {
+        expect(2, 3);
+        addSub(mnemonic == "cmp", true, zeroLike(ops[0]), ops[0], ops[1], shiftOperand(2));
+        return true;
+    }
+    if (mnemonic == "neg" || mnemonic == "negs") {
+        expect(2, 3);
+        addSub(true, mnemonic == "negs", ops[0], zeroLike(ops[0]), ops[1], shiftOperand(2));
+        return true;
+    }
+
+    static const std::unordered_map<std::string_view, std::pair<int, bool>> LOGICAL = {
+        {"and", {0, false}}, {"orr", {1, false}}, {"eor", {2, false}}, {"ands", {3, false}},
+        {"bic", {0, true}}, {"orn", {1, true}}, {"eon", {2, true}}, {"bics", {3, true}}};
+    if (auto it = LOGICAL.find(mnemonic); it != LOGICAL.end()) {
+        expect(3, 4);
+        logical(it->second.first, it->second.second, ops[0], ops[1], ops[2], shiftOperand(3));
+        return true;
+    }
+    if (mnemonic == "tst") {
+        expect(2, 3);
+        logical(3, false, zeroLike(ops[0]), ops[0], ops[1], shiftOperand(2));
+        return true;
+    }
+    if (mnemonic == "mvn") {
+        expect(2, 3);
+        logical(1, true, ops[0], zeroLike(ops[0]), ops[1], shiftOperand(2));
+        return true;
+    }
+    if (mnemonic == "mov") {
+        expect(2, 2);
+        if (ops[1].kind == Operand::Kind::IMMEDIATE) {
+            moveImmediate(ops[0], ops[1].imm);
+        } else if (ops[0].sp || ops[1].sp) {
+            Operand zero;
+            addSub(false, false, ops[0], ops[1], zero, nullptr);
+        } else {
+            logical(1, false, ops[0], zeroLike(ops[0]), ops[1], nullptr);
+        }
+        return true;
+    }
+
+    static const std::unordered_map<std::string_view, uint32_t> MOVE_WIDE = {
+        {"movn", 0}, {"movz", 2}, {"movk", 3}};
+    if (auto it = MOVE_WIDE.find(mnemonic); it != MOVE_WIDE.end()) {
+        expect(2, 3);
+        const Operand* shift = shiftOperand(2);
+        int64_t amount = shift ? shift->imm : 0;
+        if (ops[1].kind != Operand::Kind::IMMEDIATE || ops[1].imm < 0 || ops[1].imm > 0xFFFF ||
+            (shift && shift->shift != 0) || amount % 16 || amount < 0 || amount >= ops[0].size * 8) {
+            fail("bad operands");
+        }
+        uint32_t sf = ops[0].size == 8 ? 1u << 31 : 0;
+        word(sf | it->second << 29 | 0x12800000 | static_cast<uint32_t>(amount / 16) << 21 |
+             static_cast<uint32_t>(ops[1].imm) << 5 | general(ops[0]));
+        return true;
+    }
+
+    static const std::unordered_map<std::string_view, std::pair<bool, bool>> MULTIPLY = {
+        {"madd", {false, true}}, {"msub", {true, true}}, {"mul", {false, false}}, {"mneg", {true, false}}};
+    if (auto it = MULTIPLY.find(mnemonic); it != MULTIPLY.end()) {
+        auto [subtract, accumulate] = it->second;
+        expect(accumulate ? 4 : 3, accumulate ? 4 : 3);
+        int width = widthOf(ops[0], ops[1]);
+        widthOf(ops[0], ops[2]);
+        uint32_t ra = accumulate ? general(ops[3]) : 31;
+        word((width == 64 ? 1u << 31 : 0) | 0x1B000000 | general(ops[2]) << 16 | subtract << 15 | ra << 10 |
+             general(ops[1]) << 5 | general(ops[0]));
+        return true;
+    }
+
+    // Data-processing (2 source): divides and shifts by a register
+    static const std::unordered_map<std::string_view, uint32_t> TWO_SOURCE = {
+        {"udiv", 2}, {"sdiv", 3}, {"lslv", 8}, {"lsrv", 9}, {"asrv", 10}, {"rorv", 11},
+        {"lsl", 8}, {"lsr", 9}, {"asr", 10}, {"ror", 11}};
+    if (auto it = TWO_SOURCE.find(mnemonic); it != TWO_SOURCE.end()) {
+        expect(3, 3);
+        int width = widthOf(ops[0], ops[1]);
+        if (ops[2].kind == Operand::Kind::IMMEDIATE && it->second >= 8 && mnemonic.size() == 3) {
+            int64_t amount = ops[2].imm;
+            if (amount < 0 || amount >= width || it->second == 11) fail("bad shift amount");
+            uint32_t s = static_cast<uint32_t>(amount);
+            uint32_t last = static_cast<uint32_t>(width - 1);
+            if (it->second == 8) {
+                bitfield(false, ops[0], ops[1], (width - s) % width, last - s);
+            } else {
+                bitfield(it->second == 10, ops[0], ops[1], s, last);
+            }
+            return true;
+        }
+        widthOf(ops[0], ops[2]);
+        word((width == 64 ? 1u << 31 : 0) | 0x1AC00000 | general(ops[2]) << 16 | it->second << 10 |
+             general(ops[1]) << 5 | general(ops[0]));
+        return true;
+    }
+
+    static const std::unordered_map<std::string_view, std::pair<bool, uint32_t>> EXTENDS = {
+        {"sxtb", {true, 7}}, {"sxth", {true, 15}}, {"sxtw", {true, 31}}, {"uxtb", {false, 7}},
+        {"uxth", {false, 15}}};
+    if (auto it = EXTENDS.find(mnemonic); it != EXTENDS.end()) {
+        expect(2, 2);
+        if (!ops[1].isGeneral() || ops[1].size != 4 || (!it->second.first && ops[0].size != 4)) {
+            fail("bad operands");
+        }
+        bitfield(it->second.first, ops[0], ops[1], 0, it->second.second);
+        return true;
+    }
+
+    // Conditional select: op bit 30, o2 bit 10
+    static const std::unordered_map<std::string_view, std::pair<uint32_t, uint32_t>> SELECT = {
+        {"csel", {0, 0}}, {"csinc", {0, 1}}, {"csinv", {1, 0}}, {"csneg", {1, 1}}};
+    auto select = [&](std::pair<uint32_t, uint32_t> op, const Operand& d, const Operand& n, const Operand& m,
+                      uint32_t cond) {
+        int width = widthOf(d, n);
+        widthOf(d, m);
+        word((width == 64 ? 1u << 31 : 0) | op.first << 30 | 0x1A800000 | general(m) << 16 | cond << 12 |
+             op.second << 10 | general(n) << 5 | general(d));
+    };
+    if (auto it = SELECT.find(mnemonic); it != SELECT.end()) {
+        expect(4, 4);
+        select(it->second, ops[0], ops[1], ops[2], condition(ops[3]));
+        return true;
+    }
+    if (mnemonic == "cset" || mnemonic == "csetm") {
+        expect(2, 2);
+        uint32_t cond = condition(ops[1]);
+        if (cond >= 14) fail("bad condition");
+        Operand zero = zeroLike(ops[0]);
+        select(mnemonic == "cset" ? SELECT.at("csinc") : SELECT.at("csinv"), ops[0], zero, zero, cond ^ 1);
+        return true;
+    }
+
+    if (mnemonic == "adrp") {
+        expect(2, 2);
+        bool named = ops[1].kind == Operand::Kind::SYMBOL || ops[1].kind == Operand::Kind::REGISTER;
+        if (!named || ops[0].size != 8) fail("bad operands");
+        relocate(ops[1].text, RelocationType::ADR_PREL_PG_HI21);
+        word(0x90000000 | general(ops[0]));
+        return true;
+    }
+    if (mnemonic == "nop") {
+        expect(0, 0);
+        word(0xD503201F);
+        return true;
+    }
+    if (mnemonic == "svc" || mnemonic == "brk") {
+        expect(1, 1);
+        if (ops[0].kind != Operand::Kind::IMMEDIATE || ops[0].imm < 0 || ops[0].imm > 0xFFFF) fail("bad operand");
+        word((mnemonic == "svc" ? 0xD4000001u : 0xD4200000u) | static_cast<uint32_t>(ops[0].imm) << 5);
+        return true;
+    }
+    return false;
+}
+
+bool Assembler::branchInstruction(std::string_view mnemonic, Operand* ops, size_t count) {
+    static const std::unordered_map<std::string_view, uint32_t> REGISTER_BRANCHES = {
+        {"br", 0xD61F0000}, {"blr", 0xD63F0000}, {"ret", 0xD65F0000}};
+    if (auto it = REGISTER_BRANCHES.find(mnemonic); it != REGISTER_BRANCHES.end()) {
+        if (count > 1 || (count == 0 && mnemonic != "ret")) fail("wrong number of operands");
+        uint32_t rn = count ? general(ops[0]) : 30;
+        if (count && ops[0].size != 8) fail("bad operand");
+        word(it->second | rn << 5);
+        return true;
+    }
+
+    // A label may share its spelling with a register
+    auto target = [&](size_t i) {
+        bool named = ops[i].kind == Operand::Kind::SYMBOL || ops[i].kind == Operand::Kind::REGISTER;
+        if (count != i + 1 || !named) fail("expected a label");
+        return ops[i].text;
+    };
+    if (mnemonic == "b" || mnemonic == "bl") {
+        branches_.push_back({text_.size(), BranchKind::IMM26, target(0), mnemonic == "bl"});
+        word(mnemonic == "bl" ? 0x94000000 : 0x14000000);
+        return true;
+    }
+    if (mnemonic.substr(0, 2) == "b.") {
+        auto it = conditionTable().find(mnemonic.substr(2));
+        if (it == conditionTable().end()) return false;
+        branches_.push_back({text_.size(), BranchKind::IMM19, target(0), false});
+        word(0x54000000 | static_cast<uint32_t>(it->second));
+        return true;
+    }
+    if (mnemonic == "cbz" || mnemonic == "cbnz") {
+        if (count != 2) fail("wrong number of operands");
+        uint32_t sf = ops[0].size == 8 ? 1u << 31 : 0;
+        uint32_t rt = general(ops[0]);
+        branches_.push_back({text_.size(), BranchKind::IMM19, target(1), false});
+        word(sf | (mnemonic == "cbz" ? 0x34000000u : 0x35000000u) | rt);
+        return true;
+    }
+    return false;
+}
+
+bool Assembler::memoryInstruction(std::string_view mnemonic, Operand* ops, size_t count) {
+    if (mnemonic == "ldp" || mnemonic == "stp") {
+        // [base, #imm], [base, #imm]! or [base], #imm
+        if (count < 3 || count > 4 || ops[2].kind != Operand::Kind::MEMORY || ops[2].index >= 0 ||
+            !ops[2].symbol.empty() || ops[0].size != ops[1].size) {
+            fail("bad operands");
+        }
+        const Operand& address = ops[2];
+        bool post = count == 4;
+        if (post && (ops[3].kind != Operand::Kind::IMMEDIATE || address.writeback || address.imm)) {
+            fail("bad post-index");
+        }
+        int64_t offset = post ? ops[3].imm : address.imm;
+        int scale = ops[0].size == 8 ? 8 : 4;
+        if (offset % scale || !fits(offset / scale, 7)) fail("offset out of range");
+        uint32_t mode = post ? 1 : address.writeback ? 3 : 2;
+        uint32_t opc = ops[0].size == 8 ? 2 : 0;
+        uint32_t load = mnemonic == "ldp" ? 1 : 0;
+        word(opc << 30 | 0x28000000 | mode << 23 | load << 22 | static_cast<uint32_t>(offset / scale & 0x7F) << 15 |
+             general(ops[1]) << 10 | static_cast<uint32_t>(address.reg) << 5 | general(ops[0]));
+        return true;
+    }
+
+    auto it = loadStoreTable().find(mnemonic);
+    if (it == loadStoreTable().end()) return false;
+    if (count < 2 || count > 3 || ops[1].kind != Operand::Kind::MEMORY) fail("bad operands");
+    const LoadStore& form = it->second;
+    const Operand& t = ops[0];
+    const Operand& address = ops[1];
+    int opc = t.kind == Operand::Kind::REGISTER && t.size == 16 ? form.opcQ : t.size == 8 ? form.opcX : form.opcW;
+    if (opc < 0 || t.isVector() || t.sp) fail("bad register");
+    bool vector = t.size == 16;
+    // ldr and str move a whole register, so its width sets the access size
+    int size = mnemonic.size() == 3 && t.size == 4 ? 2 : form.size;
+    int scale = vector ? 4 : size;
+    uint32_t base = static_cast<uint32_t>(vector ? 0 : size) << 30 | 0x38000000 | vector << 26 |
+                    static_cast<uint32_t>(opc) << 22 | static_cast<uint32_t>(address.reg) << 5 |
+                    static_cast<uint32_t>(t.reg);
+
+    bool post = count == 3;
+    if (post || address.writeback) {
+        if (post && (ops[2].kind != Operand::Kind::IMMEDIATE || address.imm)) fail("bad post-index");
+        int64_t offset = post ? ops[2].imm : address.imm;
+        if (!fits(offset, 9) || address.index >= 0 || !address.symbol.empty()) fail("bad address");
+        word(base | static_cast<uint32_t>(offset & 0x1FF) << 12 | (post ? 1u : 3u) << 10);
+    } else if (address.index >= 0) {
+        uint32_t shifted = 0;
+        if (address.indexShift > 0) {
+            if (address.indexShift != scale) fail("index shift must match the access size");
+            shifted = 1;
+        } else if (address.indexShift == 0) {
+            shifted = scale == 0 ? 1 : 0;
+        }
+        word(base | 0x00200800 | static_cast<uint32_t>(address.index) << 16 | 3u << 13 | shifted << 12);
+    } else if (!address.symbol.empty()) {
+        if (scale != 3) fail("unsupported :lo12: access size");
+        relocate(address.symbol, RelocationType::LDST64_ABS_LO12_NC);
+        word(base | 0x01000000);
+    } else if (address.imm >= 0 && address.imm % (int64_t(1) << scale) == 0 && (address.imm >> scale) < 4096) {
+        word(base | 0x01000000 | static_cast<uint32_t>(address.imm >> scale) << 10);
+    } else if (fits(address.imm, 9)) {
+        // Negative or unaligned offsets take the unscaled (ldur/stur) form
+        word(base | static_cast<uint32_t>(address.imm & 0x1FF) << 12);
+    } else {
+        fail("offset out of range");
+    }
+    return true;
+}
+
+bool Assembler::vectorInstruction(std::string_view mnemonic, Operand* ops, size_t count) {
+    const Operand& d = ops[0];
+    uint32_t q = d.full ? 1u << 30 : 0;
+    auto sameShape = [&](const Operand& op) {
+        if (!op.isVector() || op.lane != d.lane || op.full != d.full) fail("arrangements differ");
+        return static_cast<uint32_t>(op.reg);
+    };
+    auto bytes = [&] {
+        if (d.lane != 0) fail("expected a byte arrangement");
+    };
+
+    // Three registers of one arrangement: base opcode, whether the lane
+    // size goes in bits 22-23, and whether 2d is allowed
+    struct ThreeSame {
+        uint32_t opcode;
+        bool sized;
+        bool doubles;
+    };
+    static const std::unordered_map<std::string_view, ThreeSame> THREE_SAME = {
+        {"add", {0x0E208400, true, true}}, {"sub", {0x2E208400, true, true}}, {"mul", {0x0E209C00, true, false}},
+        {"and", {0x0E201C00, false, false}}, {"orr", {0x0EA01C00, false, false}},
+        {"eor", {0x2E201C00, false, false}}, {"bic", {0x0E601C00, false, false}}};
+    if (auto it = THREE_SAME.find(mnemonic); it != THREE_SAME.end()) {
+        if (count != 3) fail("wrong number of operands");
+        const ThreeSame& op = it->second;
+        if (!op.sized) bytes();
+        if (d.lane == 3 && !op.doubles) fail("bad arrangement");
+        uint32_t size = op.sized ? static_cast<uint32_t>(d.lane) << 22 : 0;
+        word(q | op.opcode | size | sameShape(ops[2]) << 16 | sameShape(ops[1]) << 5 | static_cast<uint32_t>(d.reg));
+        return true;
+    }
+    if (mnemonic == "neg" || mnemonic == "mvn" || mnemonic == "not" || mnemonic == "mov") {
+        if (count != 2) fail("wrong number of operands");
+        uint32_t rn = sameShape(ops[1]);
+        if (mnemonic == "neg") {
+            if (!d.full && d.lane == 3) fail("bad arrangement");
+            word(q | 0x2E20B800 | static_cast<uint32_t>(d.lane) << 22 | rn << 5 | static_cast<uint32_t>(d.reg));
+        } else if (mnemonic == "mov") {
+            bytes();
+            word(q | 0x0EA01C00 | rn << 16 | rn << 5 | static_cast<uint32_t>(d.reg));
+        } else {
+            bytes();
+            word(q | 0x2E205800 | rn << 5 | static_cast<uint32_t>(d.reg));
+        }
+        return true;
+    }
+    if (mnemonic == "dup") {
+        if (count != 2 || !ops[1].isGeneral() || ops[1].sp || (ops[1].size == 8) != (d.lane == 3)) {
+            fail("bad operands");
+        }
+        word(q | 0x0E000C00 | 1u << (16 + d.lane) | general(ops[1]) << 5 | static_cast<uint32_t>(d.reg));
+        return true;
+    }
+    if (mnemonic == "shl" || mnemonic == "ushr" || mnemonic == "sshr") {
+        if (count != 3 || ops[2].kind != Operand::Kind::IMMEDIATE) fail("bad operands");
+        int64_t bits = 8 << d.lane;
+        int64_t amount = ops[2].imm;
+        bool left = mnemonic == "shl";
+        if (left ? amount < 0 || amount >= bits : amount < 1 || amount > bits) fail("bad shift amount");
+        uint32_t field = static_cast<uint32_t>(left ? bits + amount : 2 * bits - amount);
+        uint32_t opcode = left ? 0x0F005400 : mnemonic == "ushr" ? 0x2F000400 : 0x0F000400;
+        word(q | opcode | field << 16 | sameShape(ops[1]) << 5 | static_cast<uint32_t>(d.reg));
+        return true;
+    }
+    return false;
+}
+
+ObjectCode Assembler::run(std::string_view assembly) {
+    while (!assembly.empty()) {
+        size_t newline = assembly.find('\n');
+        std::string_view line = assembly.substr(0, newline);
+        line = trim(line.substr(0, line.find("//")));
+        statement(line);
+        if (newline == std::string_view::npos) break;
+        assembly = assembly.substr(newline + 1);
+    }
+    line_ = {};
+
+    // Branches within the text are resolved here; bl and b to a global or
+    // undefined symbol are left to the linker
+    for (const Branch& b : branches_) {
+        auto it = textLabels_.find(b.label);
+        bool local = it != textLabels_.end() && !globals_.count(b.label);
+        if (!local && b.kind == BranchKind::IMM26) {
+            RelocationType type = b.call ? RelocationType::CALL26 : RelocationType::JUMP26;
+            relocations_.push_back({Section::TEXT, b.position, std::string(b.label), type, 0});
+            continue;
+        }
+        if (it == textLabels_.end()) {
+            throw std::runtime_error("ARM64 assembler: undefined label '" + std::string(b.label) + "'");
+        }
+        int64_t distance = (static_cast<int64_t>(it->second) - static_cast<int64_t>(b.position)) / 4;
+        uint32_t field = b.kind == BranchKind::IMM26 ? static_cast<uint32_t>(distance & 0x3FFFFFF)
+                                                     : static_cast<uint32_t>(distance & 0x7FFFF) << 5;
+        if (!fits(distance, b.kind == BranchKind::IMM26 ? 26 : 19)) {
+            throw std::runtime_error("ARM64 assembler: branch to '" + std::string(b.label) + "' out of range");
+        }
+        for (int i = 0; i < 4; ++i) text_[b.position + i] |= static_cast<uint8_t>(field >> (8 * i));
+    }
+
+    ObjectCode object;
+    object.text = std::move(text_);
+    object.data = std::move(data_);
+    for (const auto& def : definitions_) {
+        if (globals_.count(def.name)) {
+            object.symbols.push_back({std::string(def.name), def.section, def.position, 0, true});
+        }
+    }
+    object.sizeSymbols();
+    object.relocations = std::move(relocations_);
+    return object;
+}
+
+} // namespace
+
+ObjectCode assembleArm64(std::string_view assembly) {
+    Assembler assembler;
+    return assembler.run(assembly);
+}
+
+} // namespace syclang
@@ -1,8 +1,73 @@
 #include "syclang/codegen/arm64/arm64_codegen.h"
+#include "syclang/codegen/arm64/arm64_assembler.h"
+#include "syclang/codegen/arm64/arm64_peephole.h"
+#include "syclang/codegen/graph_coloring.h"
+#include "syclang/thread_pool.h"
+#include "syclang/trace.h"
+#include <algorithm>
 #include <sstream>
 
 namespace syclang {
 
+namespace {
+
+// Registers kept out of allocation: x0-x7 carry arguments and results,
+// x9/x10 hold spilled or constant operands, x16/x17 are scratch for
+// immediates and remainders, x18 is the platform register and x29/x30
+// are the frame pointer and link register
+bool isReservedRegister(int number) {
+    return number <= 7 || number == 9 || number == 10 || (number >= 16 && number <= 18) ||
+           number >= 29;
+}
+
+bool isComparison(Opcode op) {
+    return op == Opcode::EQ || op == Opcode::NE || op == Opcode::LT ||
+           op == Opcode::GT || op == Opcode::LE || op == Opcode::GE;
+}
+
+// Condition code for a comparison and for its negation
+const char* conditionCode(Opcode op, bool negate) {
+    switch (op) {
+        case Opcode::EQ: return negate ? "ne" : "eq";
+        case Opcode::NE: return negate ? "eq" : "ne";
+        case Opcode::LT: return negate ? "ge" : "lt";
+        case Opcode::GT: return negate ? "le" : "gt";
+        case Opcode::LE: return negate ? "gt" : "le";
+        case Opcode::GE: return negate ? "lt" : "ge";
+        default: return negate ? "eq" : "ne";
+    }
+}
+
+// The 32-bit view of a 64-bit register name (x9 -> w9, xzr -> wzr)
+std::string wordRegister(const std::string& reg) {
+    return "w" + reg.substr(1);
+}
+
+unsigned log2Size(size_t bytes) {
+    return bytes == 1 ? 0 : bytes == 2 ? 1 : bytes == 4 ? 2 : 3;
+}
+
+// [base, index, lsl #shift], the element address of a load or store
+std::string indexedAddress(const std::string& base, const std::string& index, unsigned shift) {
+    if (shift == 0) return "[" + base + ", " + index + "]";
+    return "[" + base + ", " + index + ", lsl #" + std::to_string(shift) + "]";
+}
+
+// Vector arrangement specifier for a lane size
+const char* arrangement(size_t bytes) {
+    switch (bytes) {
+        case 1: return "16b";
+        case 2: return "8h";
+        case 4: return "4s";
+        default: return "2d";
+    }
+}
+
+// v8-v15 are callee-saved (low halves), so vectors use v0-v7 and v16-v31
+constexpr int VECTOR_REGISTERS = 24;
+
+} // namespace
+
 ARM64CodeGenerator::ARM64CodeGenerator() {
     arch_ = Architecture::ARM64;
     currentStackOffset_ = 0;
@@ -25,291 +90,730 @@ void ARM64CodeGenerator::initRegisters() {
     };
 }
 
+std::vector<AllocatableRegister> ARM64CodeGenerator::allocatableRegisters() const {
+    std::vector<AllocatableRegister> result;
+    for (size_t i = 0; i < registers_.size(); ++i) {
+        if (!isReservedRegister(static_cast<int>(i))) {
+            result.push_back({static_cast<int>(i), registers_[i].isCallerSave});
+        }
+    }
+    return result;
+}
+
 void ARM64CodeGenerator::generate(std::shared_ptr<IRModule> module) {
+    TraceScope trace("codegen", "codegen");
     output_.clear();
+    module_ = module;
+    const IRArena& arena = module->arena;
+    
+    // Functions are independent: each one is emitted by its own worker
+    // generator into a private buffer (the arena is only read), and the
+    // buffers are joined in module order so output is deterministic.
+    // Functions are emitted in batches and each batch is joined before
+    // the next starts, so with an output file attached only a batch's
+    // text is held at once. With the peephole pass on, the worker
+    // collects its function's instructions, rewrites them and only then
+    // prints them. For machine code the worker then assembles that text
+    // right away, so the module's assembly is never built.
+    if (!emitObjectCode_) {
+        output_ << "// ARM64 Assembly Generated by SysLang\n";
+        output_ << ".section .text\n\n";
+    }
+    std::vector<OutputBuffer> functionText(module->functions.size());
+    std::vector<ObjectCode> functionCode(emitObjectCode_ ? module->functions.size() : 0);
+    std::vector<std::vector<AllocationStats>> functionStats(module->functions.size());
+    std::vector<PeepholeStats> functionPeephole(module->functions.size());
+    auto emitOne = [&](size_t index) {
+        ARM64CodeGenerator worker;
+        worker.module_ = module;
+        worker.peephole_ = peephole_;
+        worker.emitFunction(*module->functions[index]);
+        if (peephole_) {
+            TraceScope peephole("peephole", "codegen", module->functions[index]->name);
+            functionPeephole[index] = worker.runPeephole(peepholeArm64);
+        }
+        if (emitObjectCode_) {
+            TraceScope assemble("assemble", "codegen", module->functions[index]->name);
+            functionCode[index] = assembleArm64(worker.output_.str());
+        } else {
+            functionText[index] = std::move(worker.output_);
+        }
+        functionStats[index] = std::move(worker.allocationStats_);
+    };
+    size_t batch = pool_ ? std::max<size_t>(64, pool_->concurrency() * 16) : 1;
+    for (size_t first = 0; first < functionText.size(); first += batch) {
+        size_t count = std::min(batch, functionText.size() - first);
+        if (pool_) {
+            parallelFor(*pool_, count, [&](size_t i) { emitOne(first + i); });
+        } else {
+            emitOne(first);
+        }
+        for (size_t i = first; i < first + count; ++i) {
+            output_.append(std::move(functionText[i]));
+        }
+    }
     
-    output_ += "// ARM64 Assembly Generated by SysLang\n";
-    output_ += ".section .text\n\n";
+    allocationStats_.clear();
+    for (auto& stats : functionStats) {
+        allocationStats_.insert(allocationStats_.end(), stats.begin(), stats.end());
+    }
+    peepholeStats_ = PeepholeStats();
+    for (const auto& stats : functionPeephole) {
+        peepholeStats_ += stats;
+    }
     
-    // Generate functions
-    for (const auto& func : module->functions) {
-        output_ += ".global " + func->name + "\n";
-        output_ += func->name + ":\n";
-        
-        emitPrologue(func->name);
+    object_ = ObjectCode();
+    if (emitObjectCode_) {
+        for (const auto& code : functionCode) {
+            object_.append(code);
+        }
+        for (ValueId varId : module->globalVariables) {
+            object_.defineData(arena.value(varId).name, 8, 8);
+        }
+        return;
+    }
+    
+    output_ << ".section .data\n\n";
+    
+    // Generate global variables
+    for (ValueId varId : module->globalVariables) {
+        const IRValue& var = arena.value(varId);
+        output_ << ".global " << var.name << "\n";
+        output_ << var.name << ":\n";
+        output_ << "    .quad 0\n\n";
+    }
+}
+
+void ARM64CodeGenerator::emitFunction(const IRFunction& func) {
+    // Extern declarations have no body to emit
+    if (func.blocks.empty()) return;
+    TraceScope trace("codegen function", "codegen", func.name);
+    
+    const IRArena& arena = module_->arena;
+    FunctionLiveness liveness(arena, func);
+    {
+        TraceScope allocation("register allocation", "codegen", func.name);
+        allocation_ = allocateGraphColoring(arena, func, liveness, allocatableRegisters());
+    }
+    recordAllocation(func.name, allocation_);
+    
+    // Room for the largest stack-passed argument list of any call
+    outgoingSlots_ = 0;
+    for (BlockId blockId : func.blocks) {
+        for (InstId instId : arena.block(blockId).instructions) {
+            const IRInstruction& inst = arena.instruction(instId);
+            if (inst.opcode == Opcode::CALL) {
+                outgoingSlots_ = std::max(outgoingSlots_, static_cast<int>(arena.operands(inst).size()) - 8);
+            }
+        }
+    }
+    
+    emitLine(".global " + func.name);
+    emitLabel(func.name);
+    
+    emitPrologue(func.name);
+    emitArguments(func);
+    
+    // Generate basic blocks
+    edgeBlocks_.clear();
+    for (size_t b = 0; b < func.blocks.size(); ++b) {
+        const IRBasicBlock& block = arena.block(func.blocks[b]);
+        currentBlock_ = func.blocks[b];
+        vectorRegisters_ = assignVectorRegisters(arena, block, VECTOR_REGISTERS);
+        nextBlock_ = b + 1 < func.blocks.size() ? arena.block(func.blocks[b + 1]).name : "";
+        if (block.name != "entry") {
+            emitLabel(block.name);
+        }
         
-        // Generate basic blocks
-        for (const auto& block : func->blocks) {
-            if (block->name != "entry") {
-                output_ += block->name + ":\n";
+        const auto& insts = block.instructions;
+        for (size_t i = 0; i < insts.size(); ++i) {
+            const IRInstruction& inst = arena.instruction(insts[i]);
+            
+            // A comparison read only by the branch after it becomes cmp + b.cond
+            if (isComparison(inst.opcode) && i + 1 < insts.size()) {
+                const IRInstruction& next = arena.instruction(insts[i + 1]);
+                auto interval = liveness.interval(inst.result);
+                if (next.opcode == Opcode::CONDBR && interval && interval->uses == 1 &&
+                    arena.operands(next)[0] == inst.result) {
+                    auto ops = arena.operands(inst);
+                    emitCompare(ops[0], ops[1]);
+                    emitBranch(conditionCode(inst.opcode, false), conditionCode(inst.opcode, true),
+                               branchTarget(next.targets[0]), branchTarget(next.targets[1]));
+                    break;
+                }
             }
             
-            for (const auto& inst : block->instructions) {
-                emitInstruction(inst);
+            emitInstruction(inst);
+            if (inst.isTerminator()) {
+                break; // Anything after a terminator is unreachable
             }
         }
-        
-        emitEpilogue(func->name);
-        output_ += "\n";
     }
     
-    output_ += ".section .data\n\n";
+    // Copies for conditional edges into PHIs, placed after the body so
+    // no block falls through into them
+    for (size_t e = 0; e < edgeBlocks_.size(); ++e) {
+        auto [from, to] = edgeBlocks_[e];
+        emitLabel(edgeLabel(from, to));
+        emitEdgeCopies(from, to);
+        emit("b", {arena.block(to).name});
+    }
     
-    // Generate global variables
-    for (const auto& var : module->globalVariables) {
-        output_ += ".global " + var->name + "\n";
-        output_ += var->name + ":\n";
-        output_ += "    .quad 0\n\n";
+    emitLine("");
+}
+
+void ARM64CodeGenerator::emitArguments(const IRFunction& func) {
+    // x0-x7 are never allocated, but route through the parallel copy
+    // anyway so stack-passed arguments share the same path
+    std::vector<OperandMove> moves;
+    for (size_t i = 0; i < func.arguments.size(); ++i) {
+        if (isDead(func.arguments[i])) continue;
+        std::string source = i < 8 ? "x" + std::to_string(i)
+                                   : "[x29, #" + std::to_string(16 + 8 * (i - 8)) + "]";
+        moves.push_back({valueToOperand(func.arguments[i]), source});
+    }
+    for (const auto& move : sequenceMoves(std::move(moves), "x10")) {
+        emitOperandMove(move.dst, move.src);
     }
 }
 
 void ARM64CodeGenerator::emitPrologue(const std::string& funcName) {
-    output_ += "    stp x29, x30, [sp, #-16]!\n";
-    output_ += "    mov x29, sp\n";
-    if (currentStackOffset_ > 0) {
-        output_ += "    sub sp, sp, #" + std::to_string(currentStackOffset_) + "\n";
+    savedRegisters_ = allocation_.calleeSavedUsed;
+    
+    // Outgoing arguments sit at the bottom of the frame, spill slots above
+    // them and saved registers above those; sp stays 16-byte aligned
+    frameSize_ = (outgoingSlots_ + static_cast<int>(allocation_.spillSlots + savedRegisters_.size())) * 8;
+    frameSize_ = (frameSize_ + 15) & ~15;
+    
+    emit("stp", {"x29", "x30", "[sp, #-16]!"});
+    emit("mov", {"x29", "sp"});
+    if (frameSize_ > 4095) {
+        emitLoadImmediate("x16", frameSize_);
+        emit("sub", {"sp", "sp", "x16"});
+    } else if (frameSize_ > 0) {
+        emit("sub", {"sp", "sp", "#" + std::to_string(frameSize_)});
+    }
+    for (size_t i = 0; i < savedRegisters_.size(); ++i) {
+        emit("str", {registers_[savedRegisters_[i]].name,
+                     slotAddress(static_cast<int>(allocation_.spillSlots + i))});
     }
 }
 
 void ARM64CodeGenerator::emitEpilogue(const std::string& funcName) {
-    if (currentStackOffset_ > 0) {
-        output_ += "    add sp, sp, #" + std::to_string(currentStackOffset_) + "\n";
+    for (size_t i = 0; i < savedRegisters_.size(); ++i) {
+        emit("ldr", {registers_[savedRegisters_[i]].name,
+                     slotAddress(static_cast<int>(allocation_.spillSlots + i))});
+    }
+    if (frameSize_ > 0) {
+        emit("mov", {"sp", "x29"});
     }
-    output_ += "    ldp x29, x30, [sp], #16\n";
-    output_ += "    ret\n";
+    emit("ldp", {"x29", "x30", "[sp]", "#16"});
+    emit("ret");
 }
 
-void ARM64CodeGenerator::emitInstruction(std::shared_ptr<IRInstruction> inst) {
-    switch (inst->opcode) {
+void ARM64CodeGenerator::emitInstruction(const IRInstruction& inst) {
+    const IRArena& arena = module_->arena;
+    auto ops = arena.operands(inst);
+    if (inst.result != INVALID_ID && isVectorType(arena.value(inst.result).getType())) {
+        emitVectorInstruction(inst);
+        return;
+    }
+    
+    switch (inst.opcode) {
         case Opcode::RET: {
-            if (inst->operands.size() > 0) {
-                output_ += "    mov x0, " + valueToOperand(inst->operands[0]) + "\n";
-            }
-            break;
-        }
-        case Opcode::ADD: {
-            output_ += "    mov x0, " + valueToOperand(inst->operands[0]) + "\n";
-            output_ += "    add x0, x0, " + valueToOperand(inst->operands[1]) + "\n";
-            if (inst->result) {
-                output_ += "    mov " + valueToOperand(inst->result) + ", x0\n";
+            if (ops.size() > 0) {
+                emitMoveTo("x0", ops[0]);
             }
+            emitEpilogue("");
             break;
         }
-        case Opcode::SUB: {
-            output_ += "    mov x0, " + valueToOperand(inst->operands[0]) + "\n";
-            output_ += "    sub x0, x0, " + valueToOperand(inst->operands[1]) + "\n";
-            if (inst->result) {
-                output_ += "    mov " + valueToOperand(inst->result) + ", x0\n";
+        case Opcode::ADD: emitBinaryOp("add", inst.result, ops[0], ops[1], true); break;
+        case Opcode::SUB: emitBinaryOp("sub", inst.result, ops[0], ops[1], true); break;
+        case Opcode::MUL: emitBinaryOp("mul", inst.result, ops[0], ops[1], false); break;
+        case Opcode::DIV: emitBinaryOp("sdiv", inst.result, ops[0], ops[1], false); break;
+        case Opcode::AND: emitBinaryOp("and", inst.result, ops[0], ops[1], false); break;
+        case Opcode::OR: emitBinaryOp("orr", inst.result, ops[0], ops[1], false); break;
+        case Opcode::XOR: emitBinaryOp("eor", inst.result, ops[0], ops[1], false); break;
+        case Opcode::SHL:
+        case Opcode::SHR: {
+            if (isDead(inst.result)) break;
+            const char* mnemonic = inst.opcode == Opcode::SHL ? "lsl" : "lsr";
+            const IRValue& amount = arena.value(ops[1]);
+            if (amount.isConstant()) {
+                std::string a = sourceRegister(ops[0], "x9");
+                std::string d = resultRegister(inst.result, "x9");
+                emit(mnemonic, {d, a, "#" + std::to_string(amount.value_.intValue & 63)});
+                emitWriteBack(inst.result, d);
+            } else {
+                emitBinaryOp(mnemonic, inst.result, ops[0], ops[1], false);
             }
             break;
         }
-        case Opcode::MUL: {
-            output_ += "    mov x0, " + valueToOperand(inst->operands[0]) + "\n";
-            output_ += "    mul x0, x0, " + valueToOperand(inst->operands[1]) + "\n";
-            if (inst->result) {
-                output_ += "    mov " + valueToOperand(inst->result) + ", x0\n";
-            }
+        case Opcode::MOD: {
+            if (isDead(inst.result)) break;
+            std::string a = sourceRegister(ops[0], "x9");
+            std::string b = sourceRegister(ops[1], "x10");
+            std::string d = resultRegister(inst.result, "x9");
+            emit("sdiv", {"x16", a, b});
+            emit("msub", {d, "x16", b, a});
+            emitWriteBack(inst.result, d);
             break;
         }
-        case Opcode::DIV: {
-            output_ += "    mov x0, " + valueToOperand(inst->operands[0]) + "\n";
-            output_ += "    sdiv x0, x0, " + valueToOperand(inst->operands[1]) + "\n";
-            if (inst->result) {
-                output_ += "    mov " + valueToOperand(inst->result) + ", x0\n";
-            }
+        case Opcode::NEG:
+        case Opcode::BIT_NOT: {
+            if (isDead(inst.result)) break;
+            std::string a = sourceRegister(ops[0], "x9");
+            std::string d = resultRegister(inst.result, "x9");
+            emit(inst.opcode == Opcode::NEG ? "neg" : "mvn", {d, a});
+            emitWriteBack(inst.result, d);
             break;
         }
-        case Opcode::AND: {
-            output_ += "    mov x0, " + valueToOperand(inst->operands[0]) + "\n";
-            output_ += "    and x0, x0, " + valueToOperand(inst->operands[1]) + "\n";
-            if (inst->result) {
-                output_ += "    mov " + valueToOperand(inst->result) + ", x0\n";
-            }
+        case Opcode::NOT: {
+            if (isDead(inst.result)) break;
+            emitCompare(ops[0], INVALID_ID);
+            std::string d = resultRegister(inst.result, "x9");
+            emit("cset", {d, "eq"});
+            emitWriteBack(inst.result, d);
             break;
         }
-        case Opcode::OR: {
-            output_ += "    mov x0, " + valueToOperand(inst->operands[0]) + "\n";
-            output_ += "    orr x0, x0, " + valueToOperand(inst->operands[1]) + "\n";
-            if (inst->result) {
-                output_ += "    mov " + valueToOperand(inst->result) + ", x0\n";
-            }
+        case Opcode::EQ:
+        case Opcode::NE:
+        case Opcode::LT:
+        case Opcode::GT:
+        case Opcode::LE:
+        case Opcode::GE: {
+            if (isDead(inst.result)) break;
+            emitCompare(ops[0], ops[1]);
+            std::string d = resultRegister(inst.result, "x9");
+            emit("cset", {d, conditionCode(inst.opcode, false)});
+            emitWriteBack(inst.result, d);
             break;
         }
-        case Opcode::XOR: {
-            output_ += "    mov x0, " + valueToOperand(inst->operands[0]) + "\n";
-            output_ += "    eor x0, x0, " + valueToOperand(inst->operands[1]) + "\n";
-            if (inst->result) {
-                output_ += "    mov " + valueToOperand(inst->result) + ", x0\n";
+        case Opcode::LOAD: {
+            if (ops.size() == 2) {
+                emitIndexedLoad(inst);
+            } else if (arena.value(ops[0]).isVariable()) {
+                emitCopy(inst.result, ops[0]);
             }
             break;
         }
-        case Opcode::SHL: {
-            output_ += "    mov x0, " + valueToOperand(inst->operands[0]) + "\n";
-            output_ += "    lsl x0, x0, " + valueToOperand(inst->operands[1]) + "\n";
-            if (inst->result) {
-                output_ += "    mov " + valueToOperand(inst->result) + ", x0\n";
+        case Opcode::STORE: {
+            if (ops.size() == 3) {
+                emitIndexedStore(inst);
+            } else if (arena.value(ops[1]).isVariable()) {
+                emitCopy(ops[1], ops[0]);
             }
             break;
         }
-        case Opcode::SHR: {
-            output_ += "    mov x0, " + valueToOperand(inst->operands[0]) + "\n";
-            output_ += "    lsr x0, x0, " + valueToOperand(inst->operands[1]) + "\n";
-            if (inst->result) {
-                output_ += "    mov " + valueToOperand(inst->result) + ", x0\n";
-            }
+        case Opcode::TRUNC: emitTruncate(inst); break;
+        case Opcode::ALLOCA: {
+            // Locals live in registers or spill slots chosen by the allocator
             break;
         }
-        case Opcode::NEG: {
-            output_ += "    mov x0, " + valueToOperand(inst->operands[0]) + "\n";
-            output_ += "    neg x0, x0\n";
-            if (inst->result) {
-                output_ += "    mov " + valueToOperand(inst->result) + ", x0\n";
+        case Opcode::CALL: {
+            // Arguments past the eighth go in the outgoing area, where the
+            // callee finds them above its frame record
+            for (size_t i = 8; i < ops.size(); ++i) {
+                std::string source = sourceRegister(ops[i], "x9");
+                emit("str", {source, "[sp, #" + std::to_string(8 * (i - 8)) + "]"});
             }
-            break;
-        }
-        case Opcode::NOT: {
-            output_ += "    mov x0, " + valueToOperand(inst->operands[0]) + "\n";
-            output_ += "    cmp x0, #0\n";
-            output_ += "    cset x0, eq\n";
-            if (inst->result) {
-                output_ += "    mov " + valueToOperand(inst->result) + ", x0\n";
+            // Argument registers are never allocated, so the moves cannot
+            // overwrite each other's sources
+            size_t count = std::min<size_t>(ops.size(), 8);
+            for (size_t i = 0; i < count; ++i) {
+                emitMoveTo("x" + std::to_string(i), ops[i]);
             }
-            break;
-        }
-        case Opcode::BIT_NOT: {
-            output_ += "    mov x0, " + valueToOperand(inst->operands[0]) + "\n";
-            output_ += "    mvn x0, x0\n";
-            if (inst->result) {
-                output_ += "    mov " + valueToOperand(inst->result) + ", x0\n";
+            emit("bl", {inst.callee != INVALID_ID ? arena.value(inst.callee).name
+                                                  : std::string("external_function")});
+            if (!isDead(inst.result)) {
+                emitWriteBack(inst.result, "x0");
             }
             break;
         }
-        case Opcode::EQ: {
-            output_ += "    mov x0, " + valueToOperand(inst->operands[0]) + "\n";
-            output_ += "    cmp x0, " + valueToOperand(inst->operands[1]) + "\n";
-            output_ += "    cset x0, eq\n";
-            if (inst->result) {
-                output_ += "    mov " + valueToOperand(inst->result) + ", x0\n";
+        case Opcode::BR:
+        case Opcode::CONDBR: {
+            BlockId target = inst.targets[0];
+            if (inst.opcode == Opcode::CONDBR) {
+                const IRValue& cond = arena.value(ops[0]);
+                if (!cond.isConstant()) {
+                    std::string onTrue = branchTarget(inst.targets[0]);
+                    std::string onFalse = branchTarget(inst.targets[1]);
+                    std::string c = sourceRegister(ops[0], "x9");
+                    if (onFalse == nextBlock_) {
+                        emit("cbnz", {c, onTrue});
+                        break;
+                    }
+                    emit("cbz", {c, onFalse});
+                    if (onTrue != nextBlock_) {
+                        emit("b", {onTrue});
+                    }
+                    break;
+                }
+                target = cond.value_.intValue != 0 ? inst.targets[0] : inst.targets[1];
             }
-            break;
-        }
-        case Opcode::NE: {
-            output_ += "    mov x0, " + valueToOperand(inst->operands[0]) + "\n";
-            output_ += "    cmp x0, " + valueToOperand(inst->operands[1]) + "\n";
-            output_ += "    cset x0, ne\n";
-            if (inst->result) {
-                output_ += "    mov " + valueToOperand(inst->result) + ", x0\n";
+            emitEdgeCopies(currentBlock_, target);
+            const std::string& label = arena.block(target).name;
+            if (label != nextBlock_) {
+                emit("b", {label});
             }
             break;
         }
-        case Opcode::LT: {
-            output_ += "    mov x0, " + valueToOperand(inst->operands[0]) + "\n";
-            output_ += "    cmp x0, " + valueToOperand(inst->operands[1]) + "\n";
-            output_ += "    cset x0, lt\n";
-            if (inst->result) {
-                output_ += "    mov " + valueToOperand(inst->result) + ", x0\n";
-            }
+        case Opcode::PHI: {
+            // Copied on the incoming edges
             break;
         }
-        case Opcode::GT: {
-            output_ += "    mov x0, " + valueToOperand(inst->operands[0]) + "\n";
-            output_ += "    cmp x0, " + valueToOperand(inst->operands[1]) + "\n";
-            output_ += "    cset x0, gt\n";
-            if (inst->result) {
-                output_ += "    mov " + valueToOperand(inst->result) + ", x0\n";
-            }
+        default:
             break;
+    }
+}
+
+std::string ARM64CodeGenerator::valueToOperand(ValueId value) {
+    const IRValue& val = module_->arena.value(value);
+    if (val.isConstant()) {
+        return "#" + std::to_string(val.value_.intValue);
+    }
+    
+    ValueLocation loc = allocation_.locate(value);
+    if (loc.kind == ValueLocation::Kind::REGISTER) {
+        return registers_[loc.index].name;
+    }
+    if (loc.kind == ValueLocation::Kind::STACK) {
+        return slotAddress(loc.index);
+    }
+    return "xzr"; // Read but never written: any value will do
+}
+
+std::string ARM64CodeGenerator::slotAddress(int slot) const {
+    return "[sp, #" + std::to_string((outgoingSlots_ + slot) * 8) + "]";
+}
+
+bool ARM64CodeGenerator::isDead(ValueId value) const {
+    if (value == INVALID_ID) return true;
+    const IRValue& val = module_->arena.value(value);
+    return !val.isGlobal && allocation_.locate(value).kind == ValueLocation::Kind::NONE;
+}
+
+void ARM64CodeGenerator::emitLoadImmediate(const std::string& reg, int64_t value) {
+    if (value >= -65536 && value <= 65535) {
+        emit("mov", {reg, "#" + std::to_string(value)});
+        return;
+    }
+    // movz the lowest non-zero halfword, movk the rest
+    uint64_t bits = static_cast<uint64_t>(value);
+    bool first = true;
+    for (int shift = 0; shift < 64; shift += 16) {
+        uint64_t half = (bits >> shift) & 0xFFFF;
+        if (half == 0) continue;
+        emit(first ? "movz" : "movk", {reg, "#" + std::to_string(half), "lsl #" + std::to_string(shift)});
+        first = false;
+    }
+}
+
+void ARM64CodeGenerator::emitMoveTo(const std::string& reg, ValueId value) {
+    const IRValue& val = module_->arena.value(value);
+    if (val.isConstant()) {
+        emitLoadImmediate(reg, val.value_.intValue);
+    } else if (val.isGlobal) {
+        emit("adrp", {reg, val.name});
+        emit("ldr", {reg, "[" + reg + ", :lo12:" + val.name + "]"});
+    } else if (allocation_.locate(value).kind == ValueLocation::Kind::STACK) {
+        emit("ldr", {reg, valueToOperand(value)});
+    } else {
+        std::string source = valueToOperand(value);
+        if (source != reg) {
+            emit("mov", {reg, source});
         }
-        case Opcode::LE: {
-            output_ += "    mov x0, " + valueToOperand(inst->operands[0]) + "\n";
-            output_ += "    cmp x0, " + valueToOperand(inst->operands[1]) + "\n";
-            output_ += "    cset x0, le\n";
-            if (inst->result) {
-                output_ += "    mov " + valueToOperand(inst->result) + ", x0\n";
-            }
-            break;
+    }
+}
+
+std::string ARM64CodeGenerator::sourceRegister(ValueId value, const char* scratch) {
+    if (allocation_.locate(value).kind == ValueLocation::Kind::REGISTER) {
+        return valueToOperand(value);
+    }
+    emitMoveTo(scratch, value);
+    return scratch;
+}
+
+std::string ARM64CodeGenerator::resultRegister(ValueId value, const char* scratch) {
+    if (allocation_.locate(value).kind == ValueLocation::Kind::REGISTER) {
+        return valueToOperand(value);
+    }
+    return scratch;
+}
+
+void ARM64CodeGenerator::emitWriteBack(ValueId dst, const std::string& reg) {
+    const IRValue& val = module_->arena.value(dst);
+    if (val.isGlobal) {
+        emit("adrp", {"x17", val.name});
+        emit("str", {reg, "[x17, :lo12:" + val.name + "]"});
+        return;
+    }
+    ValueLocation loc = allocation_.locate(dst);
+    if (loc.kind == ValueLocation::Kind::STACK) {
+        emit("str", {reg, slotAddress(loc.index)});
+    } else if (loc.kind == ValueLocation::Kind::REGISTER && registers_[loc.index].name != reg) {
+        emit("mov", {registers_[loc.index].name, reg});
+    }
+}
+
+void ARM64CodeGenerator::emitCopy(ValueId dst, ValueId src) {
+    if (isDead(dst)) return;
+    if (allocation_.locate(dst).kind == ValueLocation::Kind::REGISTER) {
+        emitMoveTo(valueToOperand(dst), src);
+        return;
+    }
+    const IRValue& source = module_->arena.value(src);
+    if (source.isConstant() && source.value_.intValue == 0) {
+        emitWriteBack(dst, "xzr");
+        return;
+    }
+    if (allocation_.locate(src) == allocation_.locate(dst) && !source.isGlobal &&
+        !module_->arena.value(dst).isGlobal) {
+        return; // Coalesced into the same slot
+    }
+    emitWriteBack(dst, sourceRegister(src, "x9"));
+}
+
+void ARM64CodeGenerator::emitBinaryOp(const char* mnemonic, ValueId dst, ValueId left,
+                                      ValueId right, bool allowImmediate) {
+    if (isDead(dst)) return;
+    
+    // Three-operand form: the destination may share a register with an
+    // operand whose live range ends here
+    std::string a = sourceRegister(left, "x9");
+    std::string b;
+    const IRValue& rhs = module_->arena.value(right);
+    if (allowImmediate && rhs.isConstant() && rhs.value_.intValue >= 0 &&
+        rhs.value_.intValue <= 4095) {
+        b = "#" + std::to_string(rhs.value_.intValue);
+    } else {
+        b = sourceRegister(right, "x10");
+    }
+    std::string d = resultRegister(dst, "x9");
+    emit(mnemonic, {d, a, b});
+    emitWriteBack(dst, d);
+}
+
+void ARM64CodeGenerator::emitCompare(ValueId left, ValueId right) {
+    std::string a = sourceRegister(left, "x9");
+    std::string b = "#0";
+    if (right != INVALID_ID) {
+        const IRValue& rhs = module_->arena.value(right);
+        if (rhs.isConstant() && rhs.value_.intValue >= 0 && rhs.value_.intValue <= 4095) {
+            b = "#" + std::to_string(rhs.value_.intValue);
+        } else {
+            b = sourceRegister(right, "x10");
         }
-        case Opcode::GE: {
-            output_ += "    mov x0, " + valueToOperand(inst->operands[0]) + "\n";
-            output_ += "    cmp x0, " + valueToOperand(inst->operands[1]) + "\n";
-            output_ += "    cset x0, ge\n";
-            if (inst->result) {
-                output_ += "    mov " + valueToOperand(inst->result) + ", x0\n";
-            }
+    }
+    emit("cmp", {a, b});
+}
+
+void ARM64CodeGenerator::emitIndexedLoad(const IRInstruction& inst) {
+    if (isDead(inst.result)) return;
+    auto ops = module_->arena.operands(inst);
+    IRType type = module_->arena.value(inst.result).getType();
+    std::string base = sourceRegister(ops[0], "x9");
+    std::string index = sourceRegister(ops[1], "x10");
+    std::string d = resultRegister(inst.result, "x9");
+    
+    // Narrow elements are sign- or zero-extended to 64 bits by type
+    const char* load = "ldr";
+    std::string target = d;
+    switch (type) {
+        case IRType::I8: load = "ldrsb"; break;
+        case IRType::U8:
+        case IRType::BOOL: load = "ldrb"; target = wordRegister(d); break;
+        case IRType::I16: load = "ldrsh"; break;
+        case IRType::U16: load = "ldrh"; target = wordRegister(d); break;
+        case IRType::I32: load = "ldrsw"; break;
+        case IRType::U32:
+        case IRType::F32: target = wordRegister(d); break;
+        default: break;
+    }
+    emit(load, {target, indexedAddress(base, index, log2Size(std::max<size_t>(getTypeSize(type), 1)))});
+    emitWriteBack(inst.result, d);
+}
+
+void ARM64CodeGenerator::emitIndexedStore(const IRInstruction& inst) {
+    const IRArena& arena = module_->arena;
+    auto ops = arena.operands(inst);
+    const IRValue& value = arena.value(ops[0]);
+    if (isVectorType(value.getType())) {
+        std::string address = vectorAddress(ops[1], ops[2], getTypeSize(vectorElementType(value.getType())));
+        emit("str", {"q" + vectorRegister(ops[0]).substr(1), address});
+        return;
+    }
+    
+    size_t bytes = getTypeSize(value.getType()) ? getTypeSize(value.getType()) : 8;
+    std::string source = value.isConstant() && value.value_.intValue == 0
+                             ? std::string("xzr")
+                             : sourceRegister(ops[0], "x17");
+    std::string base = sourceRegister(ops[1], "x9");
+    std::string index = sourceRegister(ops[2], "x10");
+    const char* store = bytes == 1 ? "strb" : bytes == 2 ? "strh" : "str";
+    emit(store, {bytes < 8 ? wordRegister(source) : source, indexedAddress(base, index, log2Size(bytes))});
+}
+
+void ARM64CodeGenerator::emitTruncate(const IRInstruction& inst) {
+    if (isDead(inst.result)) return;
+    auto ops = module_->arena.operands(inst);
+    std::string a = sourceRegister(ops[0], "x9");
+    std::string d = resultRegister(inst.result, "x9");
+    switch (module_->arena.value(inst.result).getType()) {
+        case IRType::U8:
+        case IRType::BOOL: emit("and", {d, a, "#0xff"}); break;
+        case IRType::U16: emit("and", {d, a, "#0xffff"}); break;
+        case IRType::U32:
+        case IRType::F32: emit("mov", {wordRegister(d), wordRegister(a)}); break;
+        case IRType::I8: emit("sxtb", {d, wordRegister(a)}); break;
+        case IRType::I16: emit("sxth", {d, wordRegister(a)}); break;
+        case IRType::I32: emit("sxtw", {d, wordRegister(a)}); break;
+        default:
+            if (d != a) emit("mov", {d, a});
             break;
+    }
+    emitWriteBack(inst.result, d);
+}
+
+std::string ARM64CodeGenerator::vectorAddress(ValueId base, ValueId index, size_t scale) {
+    std::string b = sourceRegister(base, "x9");
+    std::string i = sourceRegister(index, "x10");
+    if (log2Size(scale)) {
+        emit("add", {"x16", b, i, "lsl #" + std::to_string(log2Size(scale))});
+    } else {
+        emit("add", {"x16", b, i});
+    }
+    return "[x16]";
+}
+
+std::string ARM64CodeGenerator::vectorRegister(ValueId value) const {
+    auto it = vectorRegisters_.find(value);
+    int index = it == vectorRegisters_.end() ? 0 : it->second;
+    return "v" + std::to_string(index < 8 ? index : index + 8);
+}
+
+void ARM64CodeGenerator::emitVectorInstruction(const IRInstruction& inst) {
+    const IRArena& arena = module_->arena;
+    auto ops = arena.operands(inst);
+    IRType type = arena.value(inst.result).getType();
+    size_t lane = getTypeSize(vectorElementType(type));
+    std::string d = vectorRegister(inst.result);
+    std::string arr = std::string(".") + arrangement(lane);
+    auto emitOp = [&](const char* mnemonic, const std::string& spec) {
+        if (ops.size() > 1) {
+            emit(mnemonic, {d + spec, vectorRegister(ops[0]) + spec, vectorRegister(ops[1]) + spec});
+        } else {
+            emit(mnemonic, {d + spec, vectorRegister(ops[0]) + spec});
         }
+    };
+    
+    switch (inst.opcode) {
         case Opcode::LOAD: {
-            auto var = std::dynamic_pointer_cast<IRVariable>(inst->operands[0]);
-            if (var) {
-                output_ += "    ldr x0, [x29, #" + std::to_string(16 + var->offset) + "]\n";
-                if (inst->result) {
-                    output_ += "    mov " + valueToOperand(inst->result) + ", x0\n";
-                }
-            }
+            std::string address = vectorAddress(ops[0], ops[1], lane);
+            emit("ldr", {"q" + d.substr(1), address});
             break;
         }
-        case Opcode::STORE: {
-            auto var = std::dynamic_pointer_cast<IRVariable>(inst->operands[1]);
-            if (var) {
-                output_ += "    mov x0, " + valueToOperand(inst->operands[0]) + "\n";
-                output_ += "    str x0, [x29, #" + std::to_string(16 + var->offset) + "]\n";
-            }
+        case Opcode::SPLAT: {
+            std::string a = sourceRegister(ops[0], "x9");
+            emit("dup", {d + arr, lane < 8 ? wordRegister(a) : a});
             break;
         }
-        case Opcode::ALLOCA: {
-            // Stack allocation is handled in prologue
-            break;
-        }
-        case Opcode::CALL: {
-            // Simplified call handling
-            output_ += "    bl external_function\n";
-            break;
-        }
-        case Opcode::BR: {
-            output_ += "    b " + inst->label + "\n";
-            break;
-        }
-        case Opcode::CONDBR: {
-            output_ += "    cbz x0, false_branch\n";
-            output_ += "    b true_branch\n";
+        case Opcode::ADD: emitOp("add", arr); break;
+        case Opcode::SUB: emitOp("sub", arr); break;
+        case Opcode::MUL: emitOp("mul", arr); break;
+        case Opcode::AND: emitOp("and", ".16b"); break;
+        case Opcode::OR: emitOp("orr", ".16b"); break;
+        case Opcode::XOR: emitOp("eor", ".16b"); break;
+        case Opcode::SHL:
+        case Opcode::SHR: {
+            int64_t count = arena.value(ops[1]).value_.intValue & 63;
+            std::string a = vectorRegister(ops[0]);
+            if (count == 0) {
+                emit("orr", {d + ".16b", a + ".16b", a + ".16b"});
+            } else {
+                emit(inst.opcode == Opcode::SHL ? "shl" : "ushr", {d + arr, a + arr, "#" + std::to_string(count)});
+            }
             break;
         }
+        case Opcode::NEG: emitOp("neg", arr); break;
+        case Opcode::BIT_NOT: emitOp("mvn", ".16b"); break;
         default:
             break;
     }
 }
 
-std::string ARM64CodeGenerator::valueToOperand(std::shared_ptr<IRValue> value) {
-    auto constant = std::dynamic_pointer_cast<IRConstant>(value);
-    if (constant) {
-        return "#" + constant->toString();
+std::string ARM64CodeGenerator::branchTarget(BlockId to) {
+    // Edges whose copies all coalesced need no block of their own
+    if (!hasPhis(to) || edgeMoves(currentBlock_, to).empty()) {
+        return module_->arena.block(to).name;
     }
-    
-    auto var = std::dynamic_pointer_cast<IRVariable>(value);
-    if (var) {
-        if (var->isGlobal) {
-            return var->name;
+    std::pair<BlockId, BlockId> edge{currentBlock_, to};
+    if (std::find(edgeBlocks_.begin(), edgeBlocks_.end(), edge) == edgeBlocks_.end()) {
+        edgeBlocks_.push_back(edge);
+    }
+    return edgeLabel(currentBlock_, to);
+}
+
+std::vector<CodeGenerator::OperandMove> ARM64CodeGenerator::edgeMoves(BlockId from, BlockId to) {
+    std::vector<OperandMove> moves;
+    for (auto [result, incoming] : edgeCopies(from, to)) {
+        std::string dst = isDead(result) ? "" : valueToOperand(result);
+        std::string src = valueToOperand(incoming);
+        if (!dst.empty() && dst != src) {
+            moves.push_back({dst, src});
         }
-        return "[x29, #" + std::to_string(16 + var->offset) + "]";
     }
-    
-    return "x0"; // Default
+    return moves;
 }
 
-std::string ARM64CodeGenerator::emitBinaryOp(Opcode op, std::shared_ptr<IRValue> left,
-                                            std::shared_ptr<IRValue> right) {
-    // Handled in emitInstruction
-    return "";
+void ARM64CodeGenerator::emitEdgeCopies(BlockId from, BlockId to) {
+    for (const auto& move : sequenceMoves(edgeMoves(from, to), "x10")) {
+        emitOperandMove(move.dst, move.src);
+    }
 }
 
-std::string ARM64CodeGenerator::emitUnaryOp(Opcode op, std::shared_ptr<IRValue> operand) {
-    // Handled in emitInstruction
-    return "";
+void ARM64CodeGenerator::emitOperandMove(const std::string& dst, const std::string& src) {
+    if (dst == src) return;
+    bool toMemory = dst[0] == '[';
+    if (src[0] == '#') {
+        int64_t value = std::stoll(src.substr(1));
+        if (!toMemory) {
+            emitLoadImmediate(dst, value);
+        } else if (value == 0) {
+            emit("str", {"xzr", dst});
+        } else {
+            emitLoadImmediate("x9", value);
+            emit("str", {"x9", dst});
+        }
+        return;
+    }
+    if (src[0] == '[') {
+        if (!toMemory) {
+            emit("ldr", {dst, src});
+            return;
+        }
+        emit("ldr", {"x9", src});
+        emit("str", {"x9", dst});
+        return;
+    }
+    if (toMemory) {
+        emit("str", {src, dst});
+    } else {
+        emit("mov", {dst, src});
+    }
 }
 
-std::string ARM64CodeGenerator::emitComparison(Opcode op) {
-    // Handled in emitInstruction
-    return "";
+void ARM64CodeGenerator::emitBranch(const char* condition, const char* inverse,
+                                    const std::string& onTrue, const std::string& onFalse) {
+    // Fall through to whichever successor is laid out next
+    if (onFalse == nextBlock_) {
+        emit(std::string("b.") + condition, {onTrue});
+        return;
+    }
+    emit(std::string("b.") + inverse, {onFalse});
+    if (onTrue != nextBlock_) {
+        emit("b", {onTrue});
+    }
 }
 
 } // namespace syclang
@@ -0,0 +1,765 @@
+#include "syclang/codegen/arm64/arm64_peephole.h"
+#include <algorithm>
+#include <bit>
+#include <cctype>
+#include <charconv>
+#include <cstdint>
+#include <initializer_list>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace syclang {
+
+namespace {
+
+// Liveness bits: x0-x30 by number, sp, then the NZCV flags. xzr is no
+// register: it reads as zero and discards writes.
+constexpr int FP = 29, LR = 30, SP = 31;
+constexpr int FLAGS = 32;
+constexpr int ZERO = -2;
+constexpr uint64_t ALL = (uint64_t{1} << 33) - 1;
+
+constexpr uint64_t bit(int number) {
+    return uint64_t{1} << number;
+}
+
+constexpr uint64_t range(int first, int last) {
+    return ((uint64_t{1} << (last + 1)) - 1) & ~((uint64_t{1} << first) - 1);
+}
+
+// AAPCS64: argument registers, what a call may change and what a return
+// hands back to the caller
+constexpr uint64_t ARGUMENTS = range(0, 7);
+constexpr uint64_t CALL_CLOBBERED = range(0, 18) | bit(LR) | bit(FLAGS);
+constexpr uint64_t RETURN_LIVE = bit(0) | range(19, 30) | bit(SP);
+
+// Windows that rename, fold or forward across instructions look this far
+// ahead
+constexpr int WINDOW = 32;
+constexpr int MAX_ROUNDS = 8;
+
+struct Register {
+    int number = -1; // ZERO for xzr/wzr
+    int bytes = 0;
+};
+
+Register findRegister(std::string_view name) {
+    if (name == "sp") return {SP, 8};
+    if (name == "wsp") return {SP, 4};
+    if (name == "xzr") return {ZERO, 8};
+    if (name == "wzr") return {ZERO, 4};
+    if (name.size() < 2 || name.size() > 3 || (name[0] != 'x' && name[0] != 'w')) return {};
+    int number = 0;
+    auto [end, error] = std::from_chars(name.data() + 1, name.data() + name.size(), number);
+    if (error != std::errc() || end != name.data() + name.size() || number > 30 ||
+        (name.size() == 3 && name[1] == '0')) {
+        return {};
+    }
+    return {number, name[0] == 'x' ? 8 : 4};
+}
+
+// Number of a 64-bit general register (x0-x30), or -1
+int fullRegister(std::string_view operand) {
+    Register reg = findRegister(operand);
+    return reg.bytes == 8 && reg.number >= 0 && reg.number != SP ? reg.number : -1;
+}
+
+bool isMemory(std::string_view operand) {
+    return !operand.empty() && operand[0] == '[';
+}
+
+// v0.2d, q0, d0, s0: registers outside the integer file
+bool isVector(std::string_view operand) {
+    return operand.size() >= 2 && std::string_view("vqdshb").find(operand[0]) != std::string_view::npos &&
+           std::isdigit(static_cast<unsigned char>(operand[1]));
+}
+
+std::optional<int64_t> immediate(std::string_view operand) {
+    if (operand.size() < 2 || operand[0] != '#') return std::nullopt;
+    operand.remove_prefix(1);
+    bool negative = operand[0] == '-';
+    if (negative) operand.remove_prefix(1);
+    int base = 10;
+    if (operand.substr(0, 2) == "0x") {
+        base = 16;
+        operand.remove_prefix(2);
+    }
+    uint64_t value = 0;
+    auto [end, error] = std::from_chars(operand.data(), operand.data() + operand.size(), value, base);
+    if (operand.empty() || error != std::errc() || end != operand.data() + operand.size()) return std::nullopt;
+    return negative ? static_cast<int64_t>(0 - value) : static_cast<int64_t>(value);
+}
+
+std::string immediateText(int64_t value) {
+    return "#" + std::to_string(value);
+}
+
+// Call f(offset, length, register) for each register an operand names:
+// the operand itself, or an address's base and index (":lo12:symbol"
+// names a symbol)
+template <typename F>
+void forEachRegister(std::string_view operand, F&& f) {
+    if (!isMemory(operand)) {
+        Register reg = findRegister(operand);
+        if (reg.number >= 0) f(0, operand.size(), reg);
+        return;
+    }
+    for (size_t i = 1; i < operand.size();) {
+        if (!std::isalnum(static_cast<unsigned char>(operand[i])) && operand[i] != '_') {
+            ++i;
+            continue;
+        }
+        size_t end = i;
+        while (end < operand.size() &&
+               (std::isalnum(static_cast<unsigned char>(operand[end])) || operand[end] == '_' ||
+                operand[end] == '.')) {
+            ++end;
+        }
+        Register reg = findRegister(operand.substr(i, end - i));
+        if (reg.number >= 0 && operand[i - 1] != ':') f(i, end - i, reg);
+        i = end;
+    }
+}
+
+uint64_t registersIn(std::string_view operand) {
+    uint64_t mask = 0;
+    forEachRegister(operand, [&](size_t, size_t, Register reg) { mask |= bit(reg.number); });
+    return mask;
+}
+
+uint64_t mentioned(const MachineInstruction& inst) {
+    uint64_t mask = 0;
+    for (const std::string& operand : inst.operands) mask |= registersIn(operand);
+    return mask;
+}
+
+// Rename register `from` to `to` wherever `inst` names it, keeping the
+// x or w view
+void renameRegister(MachineInstruction& inst, int from, int to) {
+    for (std::string& operand : inst.operands) {
+        std::string renamed;
+        size_t copied = 0;
+        forEachRegister(operand, [&](size_t offset, size_t length, Register reg) {
+            if (reg.number != from) return;
+            renamed.append(operand, copied, offset - copied);
+            renamed += (reg.bytes == 8 ? "x" : "w") + std::to_string(to);
+            copied = offset + length;
+        });
+        if (copied > 0) {
+            renamed.append(operand, copied, std::string::npos);
+            operand = std::move(renamed);
+        }
+    }
+}
+
+// A value the logical instructions take as an immediate: a rotated run of
+// ones repeated in 2, 4, .. 64-bit elements
+bool isBitmaskImmediate(uint64_t value) {
+    if (value == 0 || value == ~uint64_t{0}) return false;
+    for (unsigned size = 2; size <= 64; size *= 2) {
+        uint64_t mask = size == 64 ? ~uint64_t{0} : (uint64_t{1} << size) - 1;
+        uint64_t element = value & mask;
+        bool repeats = true;
+        for (unsigned shift = size; shift < 64 && repeats; shift += size) {
+            repeats = ((value >> shift) & mask) == element;
+        }
+        if (!repeats) continue;
+        uint64_t rotated = ((element >> 1) | (element << (size - 1))) & mask;
+        return std::popcount(element ^ rotated) == 2;
+    }
+    return false;
+}
+
+bool isAddSub(std::string_view mnemonic) {
+    return mnemonic == "add" || mnemonic == "sub";
+}
+
+bool isLogical(std::string_view mnemonic) {
+    return mnemonic == "and" || mnemonic == "orr" || mnemonic == "eor";
+}
+
+bool isLoad(std::string_view mnemonic) {
+    return mnemonic == "ldr" || mnemonic == "ldrb" || mnemonic == "ldrh" || mnemonic == "ldrsb" ||
+           mnemonic == "ldrsh" || mnemonic == "ldrsw" || mnemonic == "ldur";
+}
+
+bool isStore(std::string_view mnemonic) {
+    return mnemonic == "str" || mnemonic == "strb" || mnemonic == "strh" || mnemonic == "stur";
+}
+
+// Instructions computing their first operand from the rest
+bool isDataProcessing(std::string_view m) {
+    return isAddSub(m) || isLogical(m) || m == "adds" || m == "subs" || m == "ands" || m == "bic" ||
+           m == "bics" || m == "orn" || m == "eon" || m == "mul" || m == "mneg" || m == "smulh" ||
+           m == "umulh" || m == "sdiv" || m == "udiv" || m == "lsl" || m == "lsr" || m == "asr" ||
+           m == "ror" || m == "lslv" || m == "lsrv" || m == "asrv" || m == "rorv" || m == "madd" ||
+           m == "msub" || m == "mov" || m == "mvn" || m == "neg" || m == "negs" || m == "sxtb" ||
+           m == "sxth" || m == "sxtw" || m == "uxtb" || m == "uxth" || m == "clz" || m == "cls" ||
+           m == "rbit" || m == "movz" || m == "movn" || m == "adrp";
+}
+
+bool setsFlags(std::string_view m) {
+    return m == "adds" || m == "subs" || m == "ands" || m == "bics" || m == "negs";
+}
+
+// Registers and flags `inst` reads and writes. `known` is false for
+// instructions outside the modelled subset (vector code), which are
+// assumed to read everything.
+RegisterEffects effectsOf(const MachineInstruction& inst, bool& known) {
+    RegisterEffects e;
+    known = true;
+    const std::string& m = inst.mnemonic;
+    const std::vector<std::string>& ops = inst.operands;
+    size_t count = ops.size();
+    auto unknown = [&] {
+        known = false;
+        e = RegisterEffects();
+        e.uses = ALL;
+    };
+    auto destination = [&](const std::string& operand) {
+        Register reg = findRegister(operand);
+        if (reg.number == ZERO) return;
+        if (reg.number < 0) {
+            unknown();
+            return;
+        }
+        e.defs |= bit(reg.number);
+    };
+    // Pre-index ([base, #n]!) and post-index ([base], #n) addresses write
+    // the base back
+    auto address = [&](size_t index) {
+        const std::string& operand = ops[index];
+        e.uses |= registersIn(operand);
+        if (operand.back() == '!' || index + 1 < count) {
+            size_t end = operand.find_first_of(",]");
+            e.defs |= registersIn("[" + operand.substr(1, end - 1) + "]");
+        }
+    };
+
+    for (const std::string& operand : ops) {
+        if (isVector(operand)) {
+            unknown();
+            return e;
+        }
+    }
+    if (isDataProcessing(m) && count >= 2) {
+        e.pure = true;
+        for (size_t i = 1; i < count; ++i) e.uses |= registersIn(ops[i]);
+        destination(ops[0]);
+        if (setsFlags(m)) e.defs |= bit(FLAGS);
+    } else if (m == "movk" && count >= 2) {
+        e.pure = true;
+        e.uses |= registersIn(ops[0]);
+        destination(ops[0]);
+    } else if ((m == "cmp" || m == "cmn" || m == "tst") && count >= 2) {
+        e.pure = true;
+        for (const std::string& operand : ops) e.uses |= registersIn(operand);
+        e.defs |= bit(FLAGS);
+    } else if ((m == "cset" || m == "csetm") && count == 2) {
+        e.pure = true;
+        e.uses |= bit(FLAGS);
+        destination(ops[0]);
+    } else if ((m == "csel" || m == "csinc" || m == "csinv" || m == "csneg") && count == 4) {
+        e.pure = true;
+        e.uses |= bit(FLAGS) | registersIn(ops[1]) | registersIn(ops[2]);
+        destination(ops[0]);
+    } else if (isLoad(m) && (count == 2 || count == 3) && isMemory(ops[1])) {
+        e.pure = true;
+        address(1);
+        destination(ops[0]);
+    } else if (isStore(m) && (count == 2 || count == 3) && isMemory(ops[1])) {
+        if (findRegister(ops[0]).number == -1) {
+            unknown();
+        } else {
+            e.uses |= registersIn(ops[0]);
+            address(1);
+        }
+    } else if (m == "ldp" && (count == 3 || count == 4) && isMemory(ops[2])) {
+        e.pure = true;
+        address(2);
+        destination(ops[0]);
+        destination(ops[1]);
+    } else if (m == "stp" && (count == 3 || count == 4) && isMemory(ops[2])) {
+        if (findRegister(ops[0]).number == -1 || findRegister(ops[1]).number == -1) {
+            unknown();
+        } else {
+            e.uses |= registersIn(ops[0]) | registersIn(ops[1]);
+            address(2);
+        }
+    } else if (m == "b" && count == 1) {
+        e.branches = true;
+        e.fallsThrough = false;
+        e.target = ops[0];
+    } else if (m.size() > 2 && m.compare(0, 2, "b.") == 0 && count == 1) {
+        e.uses |= bit(FLAGS);
+        e.branches = true;
+        e.target = ops[0];
+    } else if ((m == "cbz" || m == "cbnz") && count == 2) {
+        e.uses |= registersIn(ops[0]);
+        e.branches = true;
+        e.target = ops[1];
+    } else if ((m == "tbz" || m == "tbnz") && count == 3) {
+        e.uses |= registersIn(ops[0]);
+        e.branches = true;
+        e.target = ops[2];
+    } else if ((m == "bl" || m == "blr") && count == 1) {
+        e.uses |= ARGUMENTS | bit(SP) | (m == "blr" ? registersIn(ops[0]) : 0);
+        e.defs |= CALL_CLOBBERED;
+    } else if (m == "ret" && count <= 1) {
+        e.uses |= RETURN_LIVE | (count ? registersIn(ops[0]) : 0);
+        e.fallsThrough = false;
+    } else if (m == "nop" && count == 0) {
+        e.pure = true;
+    } else {
+        unknown();
+    }
+    // Neither the stack and frame pointers nor the link register are
+    // ever dead: the frame record and return address hang off them
+    if (e.defs & (bit(SP) | bit(FP) | bit(LR))) e.pure = false;
+    return e;
+}
+
+MachineInstruction makeInstruction(std::string mnemonic, std::initializer_list<std::string> operands) {
+    MachineInstruction inst;
+    inst.mnemonic = std::move(mnemonic);
+    inst.operands = operands;
+    return inst;
+}
+
+class Arm64Peephole {
+public:
+    explicit Arm64Peephole(std::vector<MachineInstruction>& code) : code_(code) {}
+
+    PeepholeStats run() {
+        size_t before = countInstructions();
+        stats_.instructions = before;
+
+        // As on x64: rewrites run to a fixed point, each sweep on the
+        // liveness computed before it (no rewrite reads a register that
+        // was not read before, so the facts stay safe outside the windows
+        // already rewritten, which a sweep never revisits)
+        for (int round = 0; round < MAX_ROUNDS; ++round) {
+            analyze();
+            size_t dead = removeDeadWrites(code_, effects_, live_);
+            stats_.deadWrites += dead;
+            bool changed = sweep(&Arm64Peephole::simplify) || dead > 0;
+            if (!changed) break;
+        }
+        analyze();
+        sweep(&Arm64Peephole::fuse);
+
+        stats_.removed = before - countInstructions();
+        return stats_;
+    }
+
+private:
+    static constexpr size_t NONE = static_cast<size_t>(-1);
+
+    std::vector<MachineInstruction>& code_;
+    std::vector<RegisterEffects> effects_;
+    std::vector<char> known_;
+    std::vector<uint64_t> named_; // Registers the operands name
+    std::vector<uint64_t> live_;
+    std::vector<char> stale_; // Rewritten since analyze() last saw them
+    PeepholeStats stats_;
+
+    size_t countInstructions() const {
+        size_t count = 0;
+        for (const MachineInstruction& inst : code_) count += inst.isInstruction();
+        return count;
+    }
+
+    // Effects of the instructions rewritten since the last call (all of
+    // them the first time), then liveness over the whole function
+    void analyze() {
+        if (stale_.size() != code_.size()) {
+            stale_.assign(code_.size(), 1);
+            effects_.assign(code_.size(), RegisterEffects());
+            known_.assign(code_.size(), 0);
+            named_.assign(code_.size(), 0);
+        }
+        for (size_t i = 0; i < code_.size(); ++i) {
+            if (!stale_[i]) continue;
+            stale_[i] = 0;
+            bool known = false;
+            effects_[i] = code_[i].isInstruction() ? effectsOf(code_[i], known) : RegisterEffects();
+            known_[i] = known;
+            named_[i] = code_[i].isInstruction() ? mentioned(code_[i]) : 0;
+        }
+        live_ = liveAfter(code_, effects_, ALL);
+    }
+
+    bool sweep(size_t (Arm64Peephole::*rule)(size_t)) {
+        bool changed = false;
+        for (size_t i = 0; i < code_.size(); ++i) {
+            if (!code_[i].isInstruction()) continue;
+            size_t end = (this->*rule)(i);
+            if (end != NONE) {
+                changed = true;
+                std::fill(stale_.begin() + i, stale_.begin() + end + 1, 1);
+                i = end;
+            }
+        }
+        return changed;
+    }
+
+    size_t next(size_t i) const {
+        size_t j = i + 1;
+        while (j < code_.size() && code_[j].kind == MachineInstruction::Kind::INSTRUCTION &&
+               code_[j].removed) {
+            ++j;
+        }
+        return j;
+    }
+
+    bool straight(size_t j) const {
+        return j < code_.size() && code_[j].isInstruction() && known_[j] && !effects_[j].branches &&
+               effects_[j].fallsThrough;
+    }
+
+    bool deadAfter(size_t i, int reg) const {
+        return (live_[i] & bit(reg)) == 0;
+    }
+
+    uint64_t touched(size_t j) const {
+        return effects_[j].uses | effects_[j].defs | named_[j];
+    }
+
+    // Registers instruction j reads or writes without naming them
+    uint64_t implicit(size_t j) const {
+        return (effects_[j].uses | effects_[j].defs) & ~named_[j];
+    }
+
+    // The next instruction after i that touches `reg`, if everything
+    // before it is straight-line code; NONE otherwise
+    size_t nextTouching(size_t i, int reg) const {
+        size_t k = next(i);
+        for (int steps = 0; steps < WINDOW && straight(k); ++steps, k = next(k)) {
+            if (touched(k) & bit(reg)) return k;
+        }
+        return NONE;
+    }
+
+    // Nothing in (i, k) writes any of `registers`
+    bool unchangedBetween(size_t i, size_t k, uint64_t registers) const {
+        for (size_t j = next(i); j < k; j = next(j)) {
+            if (effects_[j].defs & registers) return false;
+        }
+        return true;
+    }
+
+    void remove(size_t i) {
+        code_[i].removed = true;
+    }
+
+    size_t simplify(size_t i) {
+        for (auto rule : {&Arm64Peephole::selfMove, &Arm64Peephole::repeatedMove, &Arm64Peephole::identity,
+                          &Arm64Peephole::forwardStore, &Arm64Peephole::reloadedStore,
+                          &Arm64Peephole::foldImmediate, &Arm64Peephole::coalesceBackward,
+                          &Arm64Peephole::coalesceForward}) {
+            size_t end = (this->*rule)(i);
+            if (end != NONE) return end;
+        }
+        return NONE;
+    }
+
+    size_t fuse(size_t i) {
+        for (auto rule : {&Arm64Peephole::shiftedOperand, &Arm64Peephole::multiplyAdd,
+                          &Arm64Peephole::compareBranch}) {
+            size_t end = (this->*rule)(i);
+            if (end != NONE) return end;
+        }
+        return NONE;
+    }
+
+    bool isCopy(size_t i) const {
+        const MachineInstruction& inst = code_[i];
+        return inst.mnemonic == "mov" && inst.operands.size() == 2 && fullRegister(inst.operands[0]) >= 0 &&
+               fullRegister(inst.operands[1]) >= 0;
+    }
+
+    // mov x, x
+    size_t selfMove(size_t i) {
+        if (!isCopy(i) || code_[i].operands[0] != code_[i].operands[1]) return NONE;
+        remove(i);
+        ++stats_.redundantMoves;
+        return i;
+    }
+
+    // mov a, b then mov b, a or mov a, b again: the second copies nothing
+    size_t repeatedMove(size_t i) {
+        if (!isCopy(i)) return NONE;
+        size_t j = next(i);
+        if (j >= code_.size() || !code_[j].isInstruction() || !isCopy(j)) return NONE;
+        const auto& first = code_[i].operands;
+        const auto& second = code_[j].operands;
+        if (second != first && !(second[0] == first[1] && second[1] == first[0])) return NONE;
+        remove(j);
+        ++stats_.redundantMoves;
+        return j;
+    }
+
+    // add/sub/orr/eor x, x, #0 and shifts of x by #0
+    size_t identity(size_t i) {
+        const MachineInstruction& inst = code_[i];
+        const auto& ops = inst.operands;
+        if (ops.size() != 3 || fullRegister(ops[0]) < 0 || ops[0] != ops[1]) return NONE;
+        auto value = immediate(ops[2]);
+        bool noop = value && *value == 0 &&
+                    (isAddSub(inst.mnemonic) || inst.mnemonic == "orr" || inst.mnemonic == "eor" ||
+                     inst.mnemonic == "lsl" || inst.mnemonic == "lsr" || inst.mnemonic == "asr");
+        if (!noop) return NONE;
+        remove(i);
+        ++stats_.redundantMoves;
+        return i;
+    }
+
+    // A 64-bit load or store of a plain address (no writeback)
+    bool isSlotAccess(size_t i, std::string_view mnemonic) const {
+        const auto& ops = code_[i].operands;
+        return code_[i].mnemonic == mnemonic && ops.size() == 2 && isMemory(ops[1]) && ops[1].back() == ']' &&
+               findRegister(ops[0]).bytes == 8 && findRegister(ops[0]).number != SP;
+    }
+
+    // Scan from a memory access at i for the next access of the same
+    // address that satisfies `match`, across instructions that write no
+    // memory and none of `kept`
+    template <typename F>
+    size_t sameSlot(size_t i, uint64_t kept, F&& match) const {
+        const std::string& slot = code_[i].operands[1];
+        size_t k = next(i);
+        for (int steps = 0; steps < WINDOW && straight(k); ++steps, k = next(k)) {
+            if (code_[k].operands.size() >= 2 && code_[k].operands[1] == slot && match(k)) return k;
+            if (!effects_[k].pure || (effects_[k].defs & kept)) return NONE;
+        }
+        return NONE;
+    }
+
+    // str r, [m] ... ldr t, [m]: the load reads r
+    size_t forwardStore(size_t i) {
+        if (!isSlotAccess(i, "str")) return NONE;
+        const std::string& value = code_[i].operands[0];
+        uint64_t kept = registersIn(value) | registersIn(code_[i].operands[1]);
+        size_t k = sameSlot(i, kept, [&](size_t j) {
+            return isSlotAccess(j, "ldr") && fullRegister(code_[j].operands[0]) >= 0;
+        });
+        if (k == NONE) return NONE;
+        if (code_[k].operands[0] == value) {
+            remove(k);
+        } else {
+            code_[k] = makeInstruction("mov", {code_[k].operands[0], value == "xzr" ? "#0" : value});
+        }
+        ++stats_.memoryCombined;
+        return k;
+    }
+
+    // ldr t, [m] ... str t, [m]: the store writes back what is there
+    size_t reloadedStore(size_t i) {
+        if (!isSlotAccess(i, "ldr")) return NONE;
+        int t = fullRegister(code_[i].operands[0]);
+        const std::string& slot = code_[i].operands[1];
+        if (t < 0 || (registersIn(slot) & bit(t))) return NONE;
+        uint64_t kept = bit(t) | registersIn(slot);
+        size_t k = sameSlot(i, kept, [&](size_t j) {
+            return isSlotAccess(j, "str") && code_[j].operands[0] == code_[i].operands[0];
+        });
+        if (k == NONE) return NONE;
+        remove(k);
+        ++stats_.memoryCombined;
+        return k;
+    }
+
+    // mov t, #imm then the next instruction touching t reads it and t
+    // dies there: the constant goes in its place
+    size_t foldImmediate(size_t i) {
+        const MachineInstruction& load = code_[i];
+        if (load.mnemonic != "mov" || load.operands.size() != 2) return NONE;
+        int t = fullRegister(load.operands[0]);
+        auto value = immediate(load.operands[1]);
+        if (t < 0 || !value) return NONE;
+        size_t k = nextTouching(i, t);
+        if (k == NONE || !deadAfter(k, t) || (effects_[k].defs & bit(t)) || (implicit(k) & bit(t))) {
+            return NONE;
+        }
+        MachineInstruction& user = code_[k];
+        std::vector<std::string> ops = user.operands;
+        const std::string& reg = load.operands[0];
+        const std::string& m = user.mnemonic;
+        int64_t v = *value;
+        auto readsOnly = [&](size_t o) {
+            for (size_t other = 0; other < ops.size(); ++other) {
+                if (other != o && (registersIn(ops[other]) & bit(t))) return false;
+            }
+            return ops[o] == reg;
+        };
+        bool commutes = m == "add" || isLogical(m) || m == "mul";
+        if (ops.size() == 3 && commutes && readsOnly(1) && !readsOnly(2)) {
+            std::swap(ops[1], ops[2]);
+        }
+        // The first source must stay a register (not a folded constant)
+        if (ops.size() == 3 && (findRegister(ops[1]).number < 0 || findRegister(ops[1]).number == SP)) {
+            return NONE;
+        }
+        if (ops.size() == 3 && isAddSub(m) && readsOnly(2) && v > -4096 && v < 4096) {
+            bool flip = v < 0;
+            user = makeInstruction(flip ? (m == "add" ? "sub" : "add") : m,
+                                   {ops[0], ops[1], immediateText(flip ? -v : v)});
+        } else if (ops.size() == 2 && m == "cmp" && readsOnly(1) && v > -4096 && v < 4096) {
+            user = makeInstruction(v < 0 ? "cmn" : "cmp", {ops[0], immediateText(v < 0 ? -v : v)});
+        } else if (ops.size() == 3 && isLogical(m) && readsOnly(2) && fullRegister(ops[0]) >= 0 &&
+                   isBitmaskImmediate(static_cast<uint64_t>(v))) {
+            user = makeInstruction(m, {ops[0], ops[1], immediateText(v)});
+        } else if (ops.size() == 3 && m == "mul" && readsOnly(2) && v > 1 &&
+                   std::has_single_bit(static_cast<uint64_t>(v))) {
+            user = makeInstruction("lsl", {ops[0], ops[1], immediateText(std::countr_zero(static_cast<uint64_t>(v)))});
+        } else if (ops.size() == 3 && m == "mul" && readsOnly(2) && v > 2 &&
+                   std::has_single_bit(static_cast<uint64_t>(v - 1)) && fullRegister(ops[1]) >= 0) {
+            int shift = std::countr_zero(static_cast<uint64_t>(v - 1));
+            user = makeInstruction("add", {ops[0], ops[1], ops[1], "lsl " + immediateText(shift)});
+        } else if (ops.size() == 2 && m == "str" && v == 0 && readsOnly(0) && isMemory(ops[1])) {
+            user.operands[0] = "xzr";
+        } else if (ops.size() == 2 && m == "mov" && readsOnly(1) && fullRegister(ops[0]) >= 0) {
+            user.operands[1] = load.operands[1];
+        } else {
+            return NONE;
+        }
+        remove(i);
+        ++stats_.foldedImmediates;
+        return k;
+    }
+
+    // An instruction computing t, then mov y, t where t dies: compute
+    // into y. Nothing between may touch t or y; the sources still read
+    // the old t, which nothing else changes.
+    size_t coalesceBackward(size_t i) {
+        const MachineInstruction& def = code_[i];
+        if (!effects_[i].pure || def.operands.empty() || def.mnemonic == "movk" || def.mnemonic == "ldp") {
+            return NONE;
+        }
+        Register t = findRegister(def.operands[0]);
+        if (t.number < 0 || t.number == SP || (effects_[i].defs & ~bit(FLAGS)) != bit(t.number)) return NONE;
+        size_t k = nextTouching(i, t.number);
+        if (k == NONE || !isCopy(k) || fullRegister(code_[k].operands[1]) != t.number || !deadAfter(k, t.number)) {
+            return NONE;
+        }
+        int y = fullRegister(code_[k].operands[0]);
+        if (y == t.number) return NONE;
+        for (size_t j = next(i); j < k; j = next(j)) {
+            if (touched(j) & bit(y)) return NONE;
+        }
+        code_[i].operands[0] = (t.bytes == 8 ? "x" : "w") + std::to_string(y);
+        remove(k);
+        ++stats_.redundantMoves;
+        return k;
+    }
+
+    // mov t, x where x dies: use x in t's place until t dies. The last
+    // instruction may write x, as long as it does not read it.
+    size_t coalesceForward(size_t i) {
+        if (!isCopy(i)) return NONE;
+        int t = fullRegister(code_[i].operands[0]);
+        int x = fullRegister(code_[i].operands[1]);
+        if (t == x || t == FP || x == FP || t == LR || x == LR || !deadAfter(i, x)) return NONE;
+        size_t k = next(i);
+        for (int steps = 0; steps < WINDOW && straight(k); ++steps, k = next(k)) {
+            if (implicit(k) & (bit(t) | bit(x))) return NONE;
+            bool last = deadAfter(k, t);
+            const RegisterEffects& e = effects_[k];
+            bool clash = last ? (e.uses & bit(x)) || ((e.defs & bit(x)) && (e.defs & bit(t)))
+                              : (touched(k) & bit(x)) != 0;
+            if (clash) return NONE;
+            if (last) {
+                for (size_t j = next(i); j <= k; j = next(j)) renameRegister(code_[j], t, x);
+                remove(i);
+                ++stats_.redundantMoves;
+                return k;
+            }
+        }
+        return NONE;
+    }
+
+    // lsl t, a, #k then add/sub/cmp reading t last, where t dies:
+    // add d, b, a, lsl #k
+    size_t shiftedOperand(size_t i) {
+        const MachineInstruction& shift = code_[i];
+        if (shift.mnemonic != "lsl" || shift.operands.size() != 3) return NONE;
+        int t = fullRegister(shift.operands[0]);
+        int a = fullRegister(shift.operands[1]);
+        auto amount = immediate(shift.operands[2]);
+        if (t < 0 || a < 0 || a == t || !amount || *amount < 1 || *amount > 63) return NONE;
+        size_t k = nextTouching(i, t);
+        if (k == NONE || !deadAfter(k, t) || !unchangedBetween(i, k, bit(a))) return NONE;
+        MachineInstruction& user = code_[k];
+        std::vector<std::string> ops = user.operands;
+        const std::string& reg = shift.operands[0];
+        std::string shifted = "lsl " + immediateText(*amount);
+        if (user.mnemonic == "add" && ops.size() == 3 && ops[1] == reg && ops[2] != reg) {
+            std::swap(ops[1], ops[2]);
+        }
+        if (isAddSub(user.mnemonic) && ops.size() == 3 && ops[2] == reg && ops[1] != reg &&
+            fullRegister(ops[0]) >= 0 && fullRegister(ops[1]) >= 0) {
+            user = makeInstruction(user.mnemonic, {ops[0], ops[1], shift.operands[1], shifted});
+        } else if (user.mnemonic == "cmp" && ops.size() == 2 && ops[1] == reg && ops[0] != reg &&
+                   fullRegister(ops[0]) >= 0) {
+            user = makeInstruction("cmp", {ops[0], shift.operands[1], shifted});
+        } else {
+            return NONE;
+        }
+        remove(i);
+        ++stats_.shorterForms;
+        return k;
+    }
+
+    // mul t, a, b then add d, t, c or sub d, c, t where t dies: madd/msub
+    size_t multiplyAdd(size_t i) {
+        const MachineInstruction& mul = code_[i];
+        if (mul.mnemonic != "mul" || mul.operands.size() != 3) return NONE;
+        int t = fullRegister(mul.operands[0]);
+        int a = fullRegister(mul.operands[1]);
+        int b = fullRegister(mul.operands[2]);
+        if (t < 0 || a < 0 || b < 0 || a == t || b == t) return NONE;
+        size_t k = nextTouching(i, t);
+        if (k == NONE || !deadAfter(k, t) || !unchangedBetween(i, k, bit(a) | bit(b))) return NONE;
+        MachineInstruction& user = code_[k];
+        std::vector<std::string> ops = user.operands;
+        const std::string& reg = mul.operands[0];
+        if (!isAddSub(user.mnemonic) || ops.size() != 3 || fullRegister(ops[0]) < 0) return NONE;
+        if (user.mnemonic == "add" && ops[2] == reg && ops[1] != reg) {
+            std::swap(ops[1], ops[2]);
+        }
+        std::string accumulator = user.mnemonic == "add" ? ops[2] : ops[1];
+        bool product = user.mnemonic == "add" ? ops[1] == reg : ops[2] == reg;
+        if (!product || accumulator == reg || fullRegister(accumulator) < 0) return NONE;
+        user = makeInstruction(user.mnemonic == "add" ? "madd" : "msub",
+                               {ops[0], mul.operands[1], mul.operands[2], accumulator});
+        remove(i);
+        ++stats_.shorterForms;
+        return k;
+    }
+
+    // cmp x, #0; b.eq/b.ne label -> cbz/cbnz x, label
+    size_t compareBranch(size_t i) {
+        const MachineInstruction& cmp = code_[i];
+        if (cmp.mnemonic != "cmp" || cmp.operands.size() != 2 || cmp.operands[1] != "#0" ||
+            findRegister(cmp.operands[0]).number < 0 || findRegister(cmp.operands[0]).number == SP) {
+            return NONE;
+        }
+        size_t j = next(i);
+        if (j >= code_.size() || !code_[j].isInstruction() || (live_[j] & bit(FLAGS))) return NONE;
+        MachineInstruction& branch = code_[j];
+        if ((branch.mnemonic != "b.eq" && branch.mnemonic != "b.ne") || branch.operands.size() != 1) return NONE;
+        branch = makeInstruction(branch.mnemonic == "b.eq" ? "cbz" : "cbnz", {cmp.operands[0], branch.operands[0]});
+        remove(i);
+        ++stats_.shorterForms;
+        return j;
+    }
+};
+
+} // namespace
+
+PeepholeStats peepholeArm64(std::vector<MachineInstruction>& code) {
+    return Arm64Peephole(code).run();
+}
+
+} // namespace syclang
@@ -1,7 +1,195 @@
 #include "syclang/codegen/codegen_base.h"
+#include <algorithm>
+#include <cstdio>
+#include <set>
+#include <stdexcept>
 
 namespace syclang {
 
-// Base code generator implementation is mostly virtual
+void CodeGenerator::recordAllocation(const std::string& function,
+                                     const RegisterAllocation& allocation) {
+    std::set<int> registers;
+    for (const auto& entry : allocation.locations) {
+        if (entry.second.kind == ValueLocation::Kind::REGISTER) {
+            registers.insert(entry.second.index);
+        }
+    }
+    allocationStats_.push_back({function,
+                                static_cast<uint32_t>(allocation.locations.size()),
+                                static_cast<uint32_t>(registers.size()),
+                                allocation.spilledValues,
+                                allocation.coalescedMoves,
+                                static_cast<uint32_t>(allocation.calleeSavedUsed.size())});
+}
+
+void CodeGenerator::emit(std::string_view mnemonic, std::initializer_list<std::string_view> operands) {
+    if (peephole_) {
+        MachineInstruction& inst = code_.emplace_back();
+        inst.mnemonic = mnemonic;
+        inst.operands.assign(operands.begin(), operands.end());
+        return;
+    }
+    output_ << "    " << mnemonic;
+    const char* separator = " ";
+    for (std::string_view operand : operands) {
+        output_ << separator << operand;
+        separator = ", ";
+    }
+    output_ << "\n";
+}
+
+void CodeGenerator::emit(MachineInstruction inst) {
+    if (peephole_) {
+        code_.push_back(std::move(inst));
+        return;
+    }
+    output_ << "    " << inst.mnemonic;
+    for (size_t i = 0; i < inst.operands.size(); ++i) {
+        output_ << (i == 0 ? " " : ", ") << inst.operands[i];
+    }
+    output_ << "\n";
+}
+
+void CodeGenerator::emitLabel(std::string_view name) {
+    if (peephole_) {
+        MachineInstruction& inst = code_.emplace_back();
+        inst.kind = MachineInstruction::Kind::LABEL;
+        inst.mnemonic = name;
+        return;
+    }
+    output_ << name << ":\n";
+}
+
+void CodeGenerator::emitLine(std::string_view text) {
+    if (peephole_) {
+        MachineInstruction& inst = code_.emplace_back();
+        inst.kind = MachineInstruction::Kind::OTHER;
+        inst.mnemonic = text;
+        return;
+    }
+    output_ << text << "\n";
+}
+
+PeepholeStats CodeGenerator::runPeephole(PeepholeStats (*pass)(std::vector<MachineInstruction>&)) {
+    PeepholeStats stats = pass(code_);
+    printMachineCode(code_, output_);
+    code_.clear();
+    return stats;
+}
+
+std::vector<CodeGenerator::OperandMove> CodeGenerator::sequenceMoves(
+    std::vector<OperandMove> moves, const std::string& scratch) {
+    std::erase_if(moves, [](const OperandMove& move) { return move.dst == move.src; });
+    std::vector<OperandMove> ordered;
+    ordered.reserve(moves.size() + 1);
+    while (!moves.empty()) {
+        // Emit any move whose destination no pending move still reads
+        bool progress = false;
+        for (size_t i = 0; i < moves.size(); ++i) {
+            bool read = false;
+            for (size_t j = 0; j < moves.size() && !read; ++j) {
+                read = j != i && moves[j].src == moves[i].dst;
+            }
+            if (!read) {
+                ordered.push_back(moves[i]);
+                moves.erase(moves.begin() + i);
+                progress = true;
+                break;
+            }
+        }
+        if (progress) continue;
+        
+        // Only cycles remain: save one destination and read it from scratch
+        std::string saved = moves.front().dst;
+        ordered.push_back({scratch, saved});
+        for (auto& move : moves) {
+            if (move.src == saved) move.src = scratch;
+        }
+    }
+    return ordered;
+}
+
+std::vector<std::pair<ValueId, ValueId>> CodeGenerator::edgeCopies(BlockId from, BlockId to) const {
+    const IRArena& arena = module_->arena;
+    std::vector<std::pair<ValueId, ValueId>> copies;
+    for (InstId instId : arena.block(to).instructions) {
+        const IRInstruction& inst = arena.instruction(instId);
+        if (inst.opcode != Opcode::PHI) break;
+        auto values = arena.operands(inst);
+        auto blocks = arena.incomingBlocks(inst);
+        for (size_t i = 0; i < values.size(); ++i) {
+            if (blocks[i] == from) {
+                copies.push_back({inst.result, values[i]});
+                break;
+            }
+        }
+    }
+    return copies;
+}
+
+bool CodeGenerator::hasPhis(BlockId block) const {
+    const IRArena& arena = module_->arena;
+    const auto& insts = arena.block(block).instructions;
+    return !insts.empty() && arena.instruction(insts.front()).opcode == Opcode::PHI;
+}
+
+std::string CodeGenerator::edgeLabel(BlockId from, BlockId to) const {
+    const IRArena& arena = module_->arena;
+    return arena.block(to).name + ".from." + arena.block(from).name;
+}
+
+std::unordered_map<ValueId, int> CodeGenerator::assignVectorRegisters(const IRArena& arena,
+                                                                     const IRBasicBlock& block,
+                                                                     int count) {
+    std::unordered_map<ValueId, int> assigned;
+    std::unordered_map<ValueId, size_t> lastRead;
+    const auto& insts = block.instructions;
+    bool any = false;
+    for (size_t i = 0; i < insts.size(); ++i) {
+        const IRInstruction& inst = arena.instruction(insts[i]);
+        any = any || (inst.result != INVALID_ID && isVectorType(arena.value(inst.result).getType()));
+        for (ValueId op : arena.operands(inst)) {
+            if (isVectorType(arena.value(op).getType())) lastRead[op] = i;
+        }
+    }
+    if (!any) return assigned;
+    
+    std::vector<bool> busy(count, false);
+    for (size_t i = 0; i < insts.size(); ++i) {
+        const IRInstruction& inst = arena.instruction(insts[i]);
+        if (inst.result != INVALID_ID && isVectorType(arena.value(inst.result).getType())) {
+            auto free = std::find(busy.begin(), busy.end(), false);
+            if (free == busy.end()) {
+                throw std::runtime_error("Block " + block.name + " needs more than " +
+                                         std::to_string(count) + " vector registers");
+            }
+            int reg = static_cast<int>(free - busy.begin());
+            assigned[inst.result] = reg;
+            busy[reg] = lastRead.count(inst.result) != 0; // An unread result frees at once
+        }
+        for (ValueId op : arena.operands(inst)) {
+            auto read = lastRead.find(op);
+            if (read != lastRead.end() && read->second == i && assigned.count(op)) {
+                busy[assigned[op]] = false;
+            }
+        }
+    }
+    return assigned;
+}
+
+std::string CodeGenerator::formatAllocationStats() const {
+    std::string text = "Register allocation:\n";
+    char line[160];
+    std::snprintf(line, sizeof(line), "  %-24s %7s %9s %8s %10s %12s\n", "function", "values",
+                  "registers", "spilled", "coalesced", "callee-saved");
+    text += line;
+    for (const auto& stats : allocationStats_) {
+        std::snprintf(line, sizeof(line), "  %-24s %7u %9u %8u %10u %12u\n",
+                      stats.function.c_str(), stats.values, stats.registers, stats.spilled,
+                      stats.coalescedMoves, stats.calleeSaved);
+        text += line;
+    }
+    return text;
+}
 
 } // namespace syclang
@@ -0,0 +1,532 @@
+#include "syclang/codegen/elf_writer.h"
+#include "syclang/codegen/arm64/arm64_assembler.h"
+#include "syclang/codegen/x64/x64_assembler.h"
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace syclang {
+
+namespace {
+
+constexpr uint64_t IMAGE_BASE = 0x400000;
+constexpr size_t HEADER_SIZE = 64;
+constexpr size_t PROGRAM_HEADER_SIZE = 56;
+constexpr size_t SECTION_HEADER_SIZE = 64;
+constexpr size_t SYMBOL_SIZE = 24;
+constexpr size_t RELA_SIZE = 24;
+
+constexpr uint16_t ET_REL = 1;
+constexpr uint16_t ET_EXEC = 2;
+constexpr uint16_t EM_X86_64 = 62;
+constexpr uint16_t EM_AARCH64 = 183;
+
+constexpr uint32_t SHT_PROGBITS = 1;
+constexpr uint32_t SHT_SYMTAB = 2;
+constexpr uint32_t SHT_STRTAB = 3;
+constexpr uint32_t SHT_RELA = 4;
+constexpr uint32_t SHT_NOBITS = 8;
+constexpr uint32_t SHT_REL = 9;
+constexpr uint64_t SHF_WRITE = 0x1;
+constexpr uint64_t SHF_ALLOC = 0x2;
+constexpr uint64_t SHF_EXECINSTR = 0x4;
+constexpr uint64_t SHF_INFO_LINK = 0x40;
+
+constexpr uint8_t STB_LOCAL = 0;
+constexpr uint8_t STB_GLOBAL = 1;
+constexpr uint8_t STT_NOTYPE = 0;
+constexpr uint8_t STT_OBJECT = 1;
+constexpr uint8_t STT_FUNC = 2;
+constexpr uint8_t STT_SECTION = 3;
+constexpr uint8_t STT_FILE = 4;
+constexpr uint16_t SHN_UNDEF = 0;
+constexpr uint16_t SHN_LORESERVE = 0xFF00;
+constexpr uint16_t SHN_COMMON = 0xFFF2;
+
+constexpr uint32_t PT_LOAD = 1;
+constexpr uint32_t PT_GNU_STACK = 0x6474E551;
+constexpr uint32_t PF_X = 1;
+constexpr uint32_t PF_W = 2;
+constexpr uint32_t PF_R = 4;
+
+// ELF relocation numbers, by RelocationType
+struct RelocationNumbers {
+    RelocationType type;
+    uint32_t x64;   // 0: none on x86-64
+    uint32_t arm64; // 0: none on AArch64
+};
+
+constexpr RelocationNumbers RELOCATION_NUMBERS[] = {
+    {RelocationType::PC32, 2, 0},
+    {RelocationType::PLT32, 4, 0},
+    {RelocationType::CALL26, 0, 283},
+    {RelocationType::JUMP26, 0, 282},
+    {RelocationType::ADR_PREL_PG_HI21, 0, 275},
+    {RelocationType::ADD_ABS_LO12_NC, 0, 277},
+    {RelocationType::LDST64_ABS_LO12_NC, 0, 286},
+    {RelocationType::ABS64, 1, 257}};
+
+uint32_t elfRelocation(RelocationType type, Architecture arch) {
+    for (const auto& entry : RELOCATION_NUMBERS) {
+        uint32_t number = arch == Architecture::X64 ? entry.x64 : entry.arm64;
+        if (entry.type == type && number) return number;
+    }
+    throw std::runtime_error("Relocation type has no ELF equivalent on this architecture");
+}
+
+uint16_t machineOf(Architecture arch) { return arch == Architecture::X64 ? EM_X86_64 : EM_AARCH64; }
+
+template <typename T>
+void put(std::vector<uint8_t>& out, T value) {
+    for (size_t i = 0; i < sizeof(T); ++i) out.push_back(static_cast<uint8_t>(static_cast<uint64_t>(value) >> (8 * i)));
+}
+
+template <typename T>
+void putAt(std::vector<uint8_t>& out, size_t at, T value) {
+    for (size_t i = 0; i < sizeof(T); ++i) out[at + i] = static_cast<uint8_t>(static_cast<uint64_t>(value) >> (8 * i));
+}
+
+uint64_t alignUp(uint64_t value, uint64_t alignment) { return (value + alignment - 1) / alignment * alignment; }
+
+struct StringTable {
+    std::vector<uint8_t> bytes{0};
+
+    uint32_t add(const std::string& name) {
+        if (name.empty()) return 0;
+        uint32_t at = static_cast<uint32_t>(bytes.size());
+        bytes.insert(bytes.end(), name.begin(), name.end());
+        bytes.push_back(0);
+        return at;
+    }
+};
+
+struct SectionHeader {
+    uint32_t name = 0;
+    uint32_t type = 0;
+    uint64_t flags = 0;
+    uint64_t address = 0;
+    uint64_t offset = 0;
+    uint64_t size = 0;
+    uint32_t link = 0;
+    uint32_t info = 0;
+    uint64_t alignment = 0;
+    uint64_t entrySize = 0;
+};
+
+// Lays sections out one after another behind the ELF and program headers,
+// then appends the section header table
+class ElfBuilder {
+public:
+    explicit ElfBuilder(size_t headerBytes) : file_(headerBytes, 0), headers_(1) {}
+
+    uint32_t add(const std::string& name, SectionHeader header, const std::vector<uint8_t>& contents) {
+        file_.resize(alignUp(file_.size(), header.alignment ? header.alignment : 1));
+        header.name = names_.add(name);
+        header.offset = file_.size();
+        header.size = contents.size();
+        file_.insert(file_.end(), contents.begin(), contents.end());
+        headers_.push_back(header);
+        return static_cast<uint32_t>(headers_.size() - 1);
+    }
+    uint32_t next() const { return static_cast<uint32_t>(headers_.size()); }
+    std::vector<uint8_t>& file() { return file_; }
+
+    std::vector<uint8_t> finish(uint16_t type, Architecture arch, uint64_t entry, uint16_t programHeaders) {
+        uint32_t names = add(".shstrtab", {0, SHT_STRTAB, 0, 0, 0, 0, 0, 0, 1, 0}, names_.bytes);
+        file_.resize(alignUp(file_.size(), 8));
+        uint64_t sectionHeaders = file_.size();
+        for (const auto& h : headers_) {
+            put(file_, h.name);
+            put(file_, h.type);
+            put(file_, h.flags);
+            put(file_, h.address);
+            put(file_, h.offset);
+            put(file_, h.size);
+            put(file_, h.link);
+            put(file_, h.info);
+            put(file_, h.alignment);
+            put(file_, h.entrySize);
+        }
+
+        static const uint8_t IDENT[16] = {0x7F, 'E', 'L', 'F', 2, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+        std::copy(IDENT, IDENT + 16, file_.begin());
+        putAt<uint16_t>(file_, 16, type);
+        putAt<uint16_t>(file_, 18, machineOf(arch));
+        putAt<uint32_t>(file_, 20, 1);
+        putAt<uint64_t>(file_, 24, entry);
+        putAt<uint64_t>(file_, 32, programHeaders ? HEADER_SIZE : 0);
+        putAt<uint64_t>(file_, 40, sectionHeaders);
+        putAt<uint32_t>(file_, 48, 0);
+        putAt<uint16_t>(file_, 52, HEADER_SIZE);
+        putAt<uint16_t>(file_, 54, programHeaders ? PROGRAM_HEADER_SIZE : 0);
+        putAt<uint16_t>(file_, 56, programHeaders);
+        putAt<uint16_t>(file_, 58, SECTION_HEADER_SIZE);
+        putAt<uint16_t>(file_, 60, static_cast<uint16_t>(headers_.size()));
+        putAt<uint16_t>(file_, 62, static_cast<uint16_t>(names));
+        return std::move(file_);
+    }
+
+private:
+    std::vector<uint8_t> file_;
+    std::vector<SectionHeader> headers_; // [0] is the null section
+    StringTable names_;
+};
+
+// .symtab contents: the null symbol, locals, then globals (ELF requires
+// locals first), and for an object the undefined symbols relocations name
+struct SymbolTable {
+    std::vector<uint8_t> bytes;
+    StringTable names;
+    uint32_t firstGlobal = 0;
+    std::unordered_map<std::string, uint32_t> index;
+
+    void add(const std::string& name, uint8_t info, uint16_t section, uint64_t value, uint64_t size) {
+        index.emplace(name, static_cast<uint32_t>(bytes.size() / SYMBOL_SIZE));
+        put<uint32_t>(bytes, names.add(name));
+        put<uint8_t>(bytes, info);
+        put<uint8_t>(bytes, 0);
+        put<uint16_t>(bytes, section);
+        put<uint64_t>(bytes, value);
+        put<uint64_t>(bytes, size);
+    }
+};
+
+SymbolTable buildSymbolTable(const ObjectCode& object, uint16_t textIndex, uint16_t dataIndex,
+                             uint64_t textAddress, uint64_t dataAddress, bool addUndefined) {
+    SymbolTable table;
+    table.add("", 0, SHN_UNDEF, 0, 0);
+    auto define = [&](const ObjectSymbol& symbol) {
+        bool text = symbol.section == Section::TEXT;
+        uint8_t kind = !symbol.global ? STT_NOTYPE : text ? STT_FUNC : STT_OBJECT;
+        uint8_t binding = symbol.global ? STB_GLOBAL : STB_LOCAL;
+        table.add(symbol.name, static_cast<uint8_t>(binding << 4 | kind), text ? textIndex : dataIndex,
+                  (text ? textAddress : dataAddress) + symbol.offset, symbol.size);
+    };
+    for (const auto& symbol : object.symbols) {
+        if (!symbol.global) define(symbol);
+    }
+    table.firstGlobal = static_cast<uint32_t>(table.bytes.size() / SYMBOL_SIZE);
+    for (const auto& symbol : object.symbols) {
+        if (symbol.global) define(symbol);
+    }
+    if (addUndefined) {
+        for (const auto& relocation : object.relocations) {
+            if (!table.index.count(relocation.symbol)) {
+                table.add(relocation.symbol, STB_GLOBAL << 4 | STT_NOTYPE, SHN_UNDEF, 0, 0);
+            }
+        }
+    }
+    return table;
+}
+
+// _start for a Linux process: call main, then exit with its result
+ObjectCode startRoutine(Architecture arch) {
+    if (arch == Architecture::X64) {
+        return assembleX64(".intel_syntax noprefix\n"
+                           ".global _start\n"
+                           "_start:\n"
+                           "    xor ebp, ebp\n"
+                           "    call main\n"
+                           "    mov rdi, rax\n"
+                           "    mov eax, 60\n"
+                           "    syscall\n");
+    }
+    return assembleArm64(".global _start\n"
+                         "_start:\n"
+                         "    mov x29, #0\n"
+                         "    mov x30, #0\n"
+                         "    bl main\n"
+                         "    mov x8, #93\n"
+                         "    svc #0\n");
+}
+
+} // namespace
+
+std::vector<uint8_t> writeElfObject(const ObjectCode& object, Architecture arch) {
+    ElfBuilder elf(HEADER_SIZE);
+    uint32_t text = elf.add(".text", {0, SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR, 0, 0, 0, 0, 0, 16, 0},
+                            object.text);
+    uint32_t data = elf.add(".data", {0, SHT_PROGBITS, SHF_ALLOC | SHF_WRITE, 0, 0, 0, 0, 0, 16, 0}, object.data);
+    SymbolTable symbols = buildSymbolTable(object, static_cast<uint16_t>(text), static_cast<uint16_t>(data), 0, 0,
+                                           true);
+
+    // Relocation sections come before .symtab, whose index they link to
+    std::vector<uint8_t> rela[2];
+    for (const auto& relocation : object.relocations) {
+        auto& out = rela[relocation.section == Section::TEXT ? 0 : 1];
+        uint64_t symbol = symbols.index.at(relocation.symbol);
+        put<uint64_t>(out, relocation.offset);
+        put<uint64_t>(out, symbol << 32 | elfRelocation(relocation.type, arch));
+        put<int64_t>(out, relocation.addend);
+    }
+    uint32_t symtab = elf.next() + (rela[0].empty() ? 0 : 1) + (rela[1].empty() ? 0 : 1);
+    const char* const RELA_NAMES[2] = {".rela.text", ".rela.data"};
+    for (int i = 0; i < 2; ++i) {
+        if (rela[i].empty()) continue;
+        elf.add(RELA_NAMES[i],
+                {0, SHT_RELA, SHF_INFO_LINK, 0, 0, 0, symtab, i == 0 ? text : data, 8, RELA_SIZE}, rela[i]);
+    }
+    elf.add(".symtab", {0, SHT_SYMTAB, 0, 0, 0, 0, symtab + 1, symbols.firstGlobal, 8, SYMBOL_SIZE},
+            symbols.bytes);
+    elf.add(".strtab", {0, SHT_STRTAB, 0, 0, 0, 0, 0, 0, 1, 0}, symbols.names.bytes);
+    // An empty .note.GNU-stack asks the linker for a non-executable stack
+    elf.add(".note.GNU-stack", {0, SHT_PROGBITS, 0, 0, 0, 0, 0, 0, 1, 0}, {});
+    return elf.finish(ET_REL, arch, 0, 0);
+}
+
+std::vector<uint8_t> writeElfExecutable(const ObjectCode& input, Architecture arch) {
+    ObjectCode object = input;
+    if (!object.findSymbol("_start")) {
+        const ObjectSymbol* main = object.findSymbol("main");
+        if (!main || main->section != Section::TEXT) {
+            throw std::runtime_error("No 'main' function to start the program with");
+        }
+        object.append(startRoutine(arch), 16);
+    }
+
+    // The first segment maps the headers and text, the second the data.
+    // Data starts on a fresh page in memory but shares the file page the
+    // text ends in: a segment's address only has to match its file offset
+    // modulo the page size (64 KiB covers every AArch64 kernel).
+    uint64_t pageSize = arch == Architecture::X64 ? 0x1000 : 0x10000;
+    bool hasData = !object.data.empty();
+    uint16_t programHeaders = hasData ? 3 : 2;
+    uint64_t textOffset = alignUp(HEADER_SIZE + programHeaders * PROGRAM_HEADER_SIZE, 16);
+    uint64_t textEnd = textOffset + object.text.size();
+    uint64_t dataOffset = alignUp(textEnd, 16);
+    uint64_t textAddress = IMAGE_BASE + textOffset;
+    uint64_t dataAddress = alignUp(IMAGE_BASE + textEnd, pageSize) + dataOffset % pageSize;
+
+    std::unordered_map<std::string, uint64_t> addresses;
+    for (const auto& symbol : object.symbols) {
+        addresses.emplace(symbol.name, (symbol.section == Section::TEXT ? textAddress : dataAddress) + symbol.offset);
+    }
+    for (const auto& relocation : object.relocations) {
+        auto it = addresses.find(relocation.symbol);
+        if (it == addresses.end()) {
+            throw std::runtime_error("Undefined symbol '" + relocation.symbol + "'");
+        }
+        bool text = relocation.section == Section::TEXT;
+        std::vector<uint8_t>& contents = text ? object.text : object.data;
+        uint64_t place = (text ? textAddress : dataAddress) + relocation.offset;
+        try {
+            applyRelocation(contents.data() + relocation.offset, relocation.type, it->second + relocation.addend,
+                            place);
+        } catch (const std::runtime_error& e) {
+            throw std::runtime_error("Relocation against '" + relocation.symbol + "' " + e.what());
+        }
+    }
+
+    ElfBuilder elf(HEADER_SIZE + programHeaders * PROGRAM_HEADER_SIZE);
+    uint32_t text = elf.add(".text", {0, SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR, textAddress, 0, 0, 0, 0, 16, 0},
+                            object.text);
+    uint32_t data = 0;
+    if (hasData) {
+        data = elf.add(".data", {0, SHT_PROGBITS, SHF_ALLOC | SHF_WRITE, dataAddress, 0, 0, 0, 0, 16, 0},
+                       object.data);
+    }
+    SymbolTable symbols = buildSymbolTable(object, static_cast<uint16_t>(text), static_cast<uint16_t>(data),
+                                           textAddress, dataAddress, false);
+    elf.add(".symtab", {0, SHT_SYMTAB, 0, 0, 0, 0, elf.next() + 1, symbols.firstGlobal, 8, SYMBOL_SIZE},
+            symbols.bytes);
+    elf.add(".strtab", {0, SHT_STRTAB, 0, 0, 0, 0, 0, 0, 1, 0}, symbols.names.bytes);
+
+    std::vector<uint8_t>& file = elf.file();
+    auto programHeader = [&](size_t i, uint32_t type, uint32_t flags, uint64_t offset, uint64_t address,
+                             uint64_t size, uint64_t alignment) {
+        size_t at = HEADER_SIZE + i * PROGRAM_HEADER_SIZE;
+        putAt<uint32_t>(file, at, type);
+        putAt<uint32_t>(file, at + 4, flags);
+        putAt<uint64_t>(file, at + 8, offset);
+        putAt<uint64_t>(file, at + 16, address);
+        putAt<uint64_t>(file, at + 24, address);
+        putAt<uint64_t>(file, at + 32, size);
+        putAt<uint64_t>(file, at + 40, size);
+        putAt<uint64_t>(file, at + 48, alignment);
+    };
+    programHeader(0, PT_LOAD, PF_R | PF_X, 0, IMAGE_BASE, textEnd, pageSize);
+    if (hasData) {
+        programHeader(1, PT_LOAD, PF_R | PF_W, dataOffset, dataAddress, object.data.size(), pageSize);
+    }
+    programHeader(programHeaders - 1, PT_GNU_STACK, PF_R | PF_W, 0, 0, 0, 16);
+
+    uint64_t entry = addresses.at("_start");
+    return elf.finish(ET_EXEC, arch, entry, programHeaders);
+}
+
+namespace {
+
+template <typename T>
+T get(const std::vector<uint8_t>& bytes, uint64_t at) {
+    if (at + sizeof(T) > bytes.size()) throw std::runtime_error("truncated");
+    uint64_t value = 0;
+    for (size_t i = 0; i < sizeof(T); ++i) value |= static_cast<uint64_t>(bytes[at + i]) << (8 * i);
+    return static_cast<T>(value);
+}
+
+ObjectCode readObject(const std::vector<uint8_t>& bytes, const std::string& unit, Architecture arch) {
+    auto fail = [&](const std::string& reason) -> std::runtime_error {
+        return std::runtime_error("Cannot link '" + unit + "': " + reason);
+    };
+    static const uint8_t IDENT[7] = {0x7F, 'E', 'L', 'F', 2, 1, 1};
+    if (bytes.size() < HEADER_SIZE || !std::equal(IDENT, IDENT + 7, bytes.begin())) {
+        throw fail("not a 64-bit little-endian ELF file");
+    }
+    if (get<uint16_t>(bytes, 16) != ET_REL) throw fail("not a relocatable object");
+    if (get<uint16_t>(bytes, 18) != machineOf(arch)) throw fail("built for another architecture");
+
+    uint64_t sectionHeaders = get<uint64_t>(bytes, 40);
+    uint16_t sectionCount = get<uint16_t>(bytes, 60);
+    uint16_t namesIndex = get<uint16_t>(bytes, 62);
+    std::vector<SectionHeader> sections(sectionCount);
+    for (uint16_t i = 0; i < sectionCount; ++i) {
+        uint64_t at = sectionHeaders + i * SECTION_HEADER_SIZE;
+        SectionHeader& h = sections[i];
+        h.name = get<uint32_t>(bytes, at);
+        h.type = get<uint32_t>(bytes, at + 4);
+        h.flags = get<uint64_t>(bytes, at + 8);
+        h.offset = get<uint64_t>(bytes, at + 24);
+        h.size = get<uint64_t>(bytes, at + 32);
+        h.link = get<uint32_t>(bytes, at + 40);
+        h.info = get<uint32_t>(bytes, at + 44);
+        h.alignment = get<uint64_t>(bytes, at + 48);
+        if (h.type != SHT_NOBITS && h.offset + h.size > bytes.size()) throw fail("truncated");
+    }
+    auto string = [&](const SectionHeader& table, uint32_t offset) {
+        std::string name;
+        for (uint64_t at = table.offset + offset; at < table.offset + table.size && bytes[at]; ++at) {
+            name.push_back(static_cast<char>(bytes[at]));
+        }
+        return name;
+    };
+    if (namesIndex >= sectionCount) throw fail("no section names");
+    auto sectionName = [&](uint16_t i) { return string(sections[namesIndex], sections[i].name); };
+
+    // Place every allocated section in the text or the data
+    ObjectCode object;
+    struct Placement {
+        bool kept = false;
+        Section section = Section::TEXT;
+        uint64_t offset = 0;
+    };
+    std::vector<Placement> placements(sectionCount);
+    for (uint16_t i = 0; i < sectionCount; ++i) {
+        const SectionHeader& h = sections[i];
+        std::string name = sectionName(i);
+        if (!(h.flags & SHF_ALLOC) || name == ".eh_frame" || name.rfind(".note", 0) == 0) continue;
+        if (h.type != SHT_PROGBITS && h.type != SHT_NOBITS) throw fail("unsupported section " + name);
+        if (h.alignment > 16) throw fail("section " + name + " needs more than 16-byte alignment");
+        Placement& place = placements[i];
+        place.kept = true;
+        place.section = h.flags & SHF_EXECINSTR ? Section::TEXT : Section::DATA;
+        std::vector<uint8_t>& out = place.section == Section::TEXT ? object.text : object.data;
+        out.resize(alignUp(out.size(), h.alignment ? h.alignment : 1));
+        place.offset = out.size();
+        if (h.type == SHT_NOBITS) {
+            out.resize(out.size() + h.size);
+        } else {
+            out.insert(out.end(), bytes.begin() + h.offset, bytes.begin() + h.offset + h.size);
+        }
+    }
+
+    // Symbols, named as the relocations will refer to them
+    std::vector<std::string> symbolNames;
+    for (uint16_t s = 0; s < sectionCount; ++s) {
+        const SectionHeader& symtab = sections[s];
+        if (symtab.type != SHT_SYMTAB) continue;
+        if (symtab.link >= sectionCount) throw fail("bad symbol table");
+        for (uint64_t i = 0; i < symtab.size / SYMBOL_SIZE; ++i) {
+            uint64_t at = symtab.offset + i * SYMBOL_SIZE;
+            std::string name = string(sections[symtab.link], get<uint32_t>(bytes, at));
+            uint8_t info = get<uint8_t>(bytes, at + 4);
+            uint16_t index = get<uint16_t>(bytes, at + 6);
+            uint64_t value = get<uint64_t>(bytes, at + 8);
+            uint64_t size = get<uint64_t>(bytes, at + 16);
+            uint8_t kind = info & 0xF;
+            bool local = info >> 4 == STB_LOCAL;
+
+            if (i == 0 || kind == STT_FILE) {
+                symbolNames.push_back({});
+                continue;
+            }
+            if (index == SHN_COMMON) throw fail("common symbol '" + name + "' (compile with -fno-common)");
+            if (index == SHN_UNDEF) {
+                symbolNames.push_back(name);
+                continue;
+            }
+            if (index >= SHN_LORESERVE || index >= sectionCount) throw fail("unsupported symbol '" + name + "'");
+            if (kind == STT_SECTION) name = sectionName(index);
+            if (local) name = unit + ":" + name;
+            symbolNames.push_back(name);
+            const Placement& place = placements[index];
+            if (place.kept) {
+                object.symbols.push_back({name, place.section, place.offset + value, size, !local});
+            }
+        }
+        break;
+    }
+
+    for (uint16_t s = 0; s < sectionCount; ++s) {
+        const SectionHeader& h = sections[s];
+        if (h.type == SHT_REL) throw fail("REL relocations are not supported");
+        if (h.type != SHT_RELA || h.info >= sectionCount || !placements[h.info].kept) continue;
+        const Placement& place = placements[h.info];
+        for (uint64_t at = h.offset; at + RELA_SIZE <= h.offset + h.size; at += RELA_SIZE) {
+            uint64_t info = get<uint64_t>(bytes, at + 8);
+            uint32_t number = static_cast<uint32_t>(info);
+            uint64_t symbol = info >> 32;
+            if (symbol == 0 || symbol >= symbolNames.size() || symbolNames[symbol].empty()) {
+                throw fail("relocation without a symbol");
+            }
+            const RelocationNumbers* match = nullptr;
+            for (const auto& entry : RELOCATION_NUMBERS) {
+                if ((arch == Architecture::X64 ? entry.x64 : entry.arm64) == number) match = &entry;
+            }
+            if (!match) throw fail("unsupported relocation type " + std::to_string(number));
+            object.relocations.push_back({place.section, place.offset + get<uint64_t>(bytes, at),
+                                          symbolNames[symbol], match->type, get<int64_t>(bytes, at + 16)});
+        }
+    }
+    return object;
+}
+
+} // namespace
+
+ObjectCode readElfObject(const std::vector<uint8_t>& bytes, const std::string& unit, Architecture arch) {
+    static const std::string ARCHIVE_MAGIC = "!<arch>\n";
+    if (bytes.size() < ARCHIVE_MAGIC.size() || !std::equal(ARCHIVE_MAGIC.begin(), ARCHIVE_MAGIC.end(), bytes.begin())) {
+        return readObject(bytes, unit, arch);
+    }
+
+    // ar: 60-byte member headers, each member padded to an even size.
+    // "/" holds the symbol index and "//" the long names; every other
+    // member is an object and is linked whole.
+    ObjectCode archive;
+    std::string longNames;
+    for (size_t at = ARCHIVE_MAGIC.size(); at + 60 <= bytes.size();) {
+        std::string header(bytes.begin() + at, bytes.begin() + at + 60);
+        std::string name = header.substr(0, 16);
+        name.erase(name.find_last_not_of(' ') + 1);
+        size_t size = std::stoul(header.substr(48, 10));
+        size_t begin = at + 60;
+        if (begin + size > bytes.size()) throw std::runtime_error("Cannot link '" + unit + "': truncated archive");
+        at = begin + size + (size & 1);
+
+        if (name == "/" || name == "/SYM64/") continue;
+        if (name == "//") {
+            longNames.assign(bytes.begin() + begin, bytes.begin() + begin + size);
+            continue;
+        }
+        if (name.size() > 1 && name[0] == '/') {
+            size_t offset = std::stoul(name.substr(1));
+            name = longNames.substr(offset, longNames.find('/', offset) - offset);
+        } else if (!name.empty() && name.back() == '/') {
+            name.pop_back();
+        }
+        std::vector<uint8_t> member(bytes.begin() + begin, bytes.begin() + begin + size);
+        archive.append(readObject(member, unit + "(" + name + ")", arch), 16);
+    }
+    return archive;
+}
+
+} // namespace syclang
@@ -0,0 +1,411 @@
+#include "syclang/codegen/graph_coloring.h"
+#include <algorithm>
+
+namespace syclang {
+
+namespace {
+
+constexpr uint32_t NO_NODE = 0xFFFFFFFFu;
+
+// Set of node ids with O(1) insert, erase and iteration
+class SparseSet {
+public:
+    explicit SparseSet(size_t capacity) : index_(capacity, NO_NODE) {}
+
+    void insert(uint32_t node) {
+        if (index_[node] == NO_NODE) {
+            index_[node] = static_cast<uint32_t>(dense_.size());
+            dense_.push_back(node);
+        }
+    }
+    void erase(uint32_t node) {
+        uint32_t at = index_[node];
+        if (at == NO_NODE) return;
+        uint32_t last = dense_.back();
+        dense_[at] = last;
+        index_[last] = at;
+        dense_.pop_back();
+        index_[node] = NO_NODE;
+    }
+    void clear() {
+        for (uint32_t node : dense_) index_[node] = NO_NODE;
+        dense_.clear();
+    }
+    const std::vector<uint32_t>& items() const { return dense_; }
+
+private:
+    std::vector<uint32_t> index_;
+    std::vector<uint32_t> dense_;
+};
+
+// Interference edges as an open-addressing hash set of node pairs, so
+// membership tests and inserts never allocate per edge
+class EdgeSet {
+public:
+    explicit EdgeSet(size_t expected) {
+        size_t capacity = 64;
+        while (capacity < expected * 2) capacity <<= 1;
+        slots_.assign(capacity, EMPTY);
+    }
+
+    bool contains(uint32_t a, uint32_t b) const {
+        uint64_t key = makeKey(a, b);
+        size_t mask = slots_.size() - 1;
+        for (size_t i = hash(key) & mask;; i = (i + 1) & mask) {
+            if (slots_[i] == key) return true;
+            if (slots_[i] == EMPTY) return false;
+        }
+    }
+
+    // False if the edge was already present
+    bool insert(uint32_t a, uint32_t b) {
+        if ((size_ + 1) * 2 > slots_.size()) grow();
+        uint64_t key = makeKey(a, b);
+        size_t mask = slots_.size() - 1;
+        for (size_t i = hash(key) & mask;; i = (i + 1) & mask) {
+            if (slots_[i] == key) return false;
+            if (slots_[i] == EMPTY) {
+                slots_[i] = key;
+                ++size_;
+                return true;
+            }
+        }
+    }
+
+private:
+    static constexpr uint64_t EMPTY = ~uint64_t(0);
+
+    static uint64_t makeKey(uint32_t a, uint32_t b) {
+        return a < b ? (uint64_t(a) << 32 | b) : (uint64_t(b) << 32 | a);
+    }
+    static size_t hash(uint64_t key) {
+        uint64_t mixed = key * 0x9E3779B97F4A7C15ull;
+        return static_cast<size_t>(mixed ^ (mixed >> 32));
+    }
+    void grow() {
+        std::vector<uint64_t> old(slots_.size() * 2, EMPTY);
+        old.swap(slots_);
+        size_ = 0;
+        for (uint64_t key : old) {
+            if (key != EMPTY) insert(static_cast<uint32_t>(key >> 32), static_cast<uint32_t>(key));
+        }
+    }
+
+    std::vector<uint64_t> slots_;
+    size_t size_ = 0;
+};
+
+class InterferenceGraph {
+public:
+    InterferenceGraph(const IRArena& arena, const IRFunction& func,
+                      const FunctionLiveness& liveness);
+
+    size_t size() const { return adjacency_.size(); }
+    uint32_t node(ValueId value) const {
+        auto interval = liveness_.interval(value);
+        return interval ? static_cast<uint32_t>(interval - liveness_.intervals().data()) : NO_NODE;
+    }
+
+    bool interferes(uint32_t a, uint32_t b) const { return edges_.contains(a, b); }
+    void addEdge(uint32_t a, uint32_t b) {
+        if (a != b && edges_.insert(a, b)) {
+            adjacency_[a].push_back(b);
+            adjacency_[b].push_back(a);
+        }
+    }
+
+    // Merge b's edges into a. Edges still naming b are left in the set;
+    // b is never looked up again.
+    void merge(uint32_t a, uint32_t b) {
+        std::vector<uint32_t> absorbed;
+        absorbed.swap(adjacency_[b]);
+        for (uint32_t n : absorbed) {
+            auto& list = adjacency_[n];
+            list.erase(std::find(list.begin(), list.end(), b));
+            addEdge(a, n);
+        }
+    }
+
+    std::vector<std::vector<uint32_t>> adjacency_;
+    std::vector<std::pair<uint32_t, uint32_t>> moves_;
+    std::vector<bool> crossesCall_;
+
+private:
+    EdgeSet edges_;
+
+    const FunctionLiveness& liveness_;
+};
+
+InterferenceGraph::InterferenceGraph(const IRArena& arena, const IRFunction& func,
+                                     const FunctionLiveness& liveness)
+    : edges_(liveness.intervals().size() * 8), liveness_(liveness) {
+    size_t count = liveness.intervals().size();
+    adjacency_.resize(count);
+    crossesCall_.assign(count, false);
+
+    SparseSet live(count);
+    std::vector<ValueId> uses;
+    std::vector<const IRInstruction*> body;
+    for (size_t b = 0; b < func.blocks.size(); ++b) {
+        // Instructions after a terminator are never emitted
+        body.clear();
+        for (InstId instId : arena.block(func.blocks[b]).instructions) {
+            body.push_back(&arena.instruction(instId));
+            if (body.back()->isTerminator()) break;
+        }
+
+        live.clear();
+        for (ValueId value : liveness.liveOut(b)) {
+            uint32_t n = node(value);
+            if (n != NO_NODE) live.insert(n);
+        }
+
+        for (auto it = body.rbegin(); it != body.rend(); ++it) {
+            const IRInstruction& inst = **it;
+            uint32_t def = node(FunctionLiveness::definedValue(arena, inst));
+            FunctionLiveness::collectUses(arena, inst, uses);
+
+            // A copy's destination may share its source's register
+            bool isCopy = (inst.opcode == Opcode::LOAD || inst.opcode == Opcode::STORE) &&
+                          uses.size() == 1 && def != NO_NODE && node(uses[0]) != NO_NODE;
+            uint32_t source = isCopy ? node(uses[0]) : NO_NODE;
+            if (isCopy) {
+                moves_.push_back({def, source});
+                live.erase(source);
+            }
+            // So is each PHI input, copied on its incoming edge
+            if (inst.opcode == Opcode::PHI && def != NO_NODE) {
+                for (ValueId incoming : arena.operands(inst)) {
+                    uint32_t n = node(incoming);
+                    if (n != NO_NODE) moves_.push_back({def, n});
+                }
+            }
+
+            if (inst.opcode == Opcode::CALL) {
+                for (uint32_t n : live.items()) {
+                    if (n != def) crossesCall_[n] = true;
+                }
+            }
+            if (def != NO_NODE) {
+                for (uint32_t n : live.items()) {
+                    addEdge(def, n);
+                }
+                live.erase(def);
+            }
+            for (ValueId use : uses) {
+                uint32_t n = node(use);
+                if (n != NO_NODE) live.insert(n);
+            }
+        }
+
+        // Whatever is live into the entry block (the arguments) is
+        // written all at once by the prologue
+        if (b == 0) {
+            const auto& entryLive = live.items();
+            for (size_t i = 0; i < entryLive.size(); ++i) {
+                for (size_t j = i + 1; j < entryLive.size(); ++j) {
+                    addEdge(entryLive[i], entryLive[j]);
+                }
+            }
+        }
+    }
+}
+
+} // namespace
+
+RegisterAllocation allocateGraphColoring(const IRArena& arena, const IRFunction& func,
+                                         const FunctionLiveness& liveness,
+                                         const std::vector<AllocatableRegister>& registers) {
+    RegisterAllocation result;
+    InterferenceGraph graph(arena, func, liveness);
+    const auto& intervals = liveness.intervals();
+    size_t count = graph.size();
+    auto& adjacency = graph.adjacency_;
+    auto& crossesCall = graph.crossesCall_;
+
+    size_t calleeSavedCount = 0;
+    for (const auto& reg : registers) {
+        calleeSavedCount += !reg.callerSave;
+    }
+    auto colorsFor = [&](uint32_t n) {
+        return crossesCall[n] ? calleeSavedCount : registers.size();
+    };
+
+    // Spill cost: reads per unit of interference
+    std::vector<double> weight(count);
+    for (size_t n = 0; n < count; ++n) {
+        weight[n] = intervals[n].uses;
+    }
+
+    // Conservative coalescing. Nodes merge into a representative; the
+    // adjacency sets only ever name representatives.
+    std::vector<uint32_t> alias(count);
+    for (size_t n = 0; n < count; ++n) alias[n] = static_cast<uint32_t>(n);
+    auto find = [&](uint32_t n) {
+        while (alias[n] != n) {
+            alias[n] = alias[alias[n]];
+            n = alias[n];
+        }
+        return n;
+    };
+
+    // One pass over the copies: later moves already see earlier merges,
+    // and retrying the ones that failed Briggs rarely pays for itself
+    for (const auto& move : graph.moves_) {
+        uint32_t a = find(move.first);
+        uint32_t b = find(move.second);
+        if (a == b || graph.interferes(a, b)) continue;
+
+        // Briggs: fewer than K significant-degree neighbors after merging
+        size_t k = crossesCall[a] || crossesCall[b] ? calleeSavedCount : registers.size();
+        size_t significant = 0;
+        for (uint32_t n : adjacency[a]) {
+            significant += adjacency[n].size() >= colorsFor(n);
+        }
+        for (uint32_t n : adjacency[b]) {
+            significant += !graph.interferes(a, n) && adjacency[n].size() >= colorsFor(n);
+        }
+        if (significant >= k) continue;
+
+        graph.merge(a, b);
+        alias[b] = a;
+        crossesCall[a] = crossesCall[a] || crossesCall[b];
+        weight[a] += weight[b];
+    }
+
+    // Simplify: peel off nodes with fewer neighbors than colors; when
+    // none is left, push the cheapest node optimistically
+    std::vector<size_t> degree(count);
+    std::vector<bool> removed(count, true);
+    std::vector<uint32_t> lowDegree;
+    size_t remaining = 0;
+    for (uint32_t n = 0; n < count; ++n) {
+        if (find(n) != n) continue;
+        removed[n] = false;
+        degree[n] = adjacency[n].size();
+        ++remaining;
+        if (degree[n] < colorsFor(n)) lowDegree.push_back(n);
+    }
+
+    std::vector<uint32_t> stack;
+    stack.reserve(remaining);
+    auto removeNode = [&](uint32_t n) {
+        removed[n] = true;
+        --remaining;
+        stack.push_back(n);
+        for (uint32_t m : adjacency[n]) {
+            if (!removed[m] && degree[m]-- == colorsFor(m)) {
+                lowDegree.push_back(m);
+            }
+        }
+    };
+    while (remaining > 0) {
+        if (!lowDegree.empty()) {
+            uint32_t n = lowDegree.back();
+            lowDegree.pop_back();
+            if (!removed[n]) removeNode(n);
+            continue;
+        }
+        uint32_t candidate = NO_NODE;
+        double best = 0;
+        for (uint32_t n = 0; n < count; ++n) {
+            if (removed[n]) continue;
+            double cost = weight[n] / static_cast<double>(degree[n] + 1);
+            if (candidate == NO_NODE || cost < best) {
+                candidate = n;
+                best = cost;
+            }
+        }
+        removeNode(candidate);
+    }
+
+    // Move partners of every representative, for biased coloring
+    std::vector<std::vector<uint32_t>> partners(count);
+    for (const auto& move : graph.moves_) {
+        uint32_t a = find(move.first);
+        uint32_t b = find(move.second);
+        if (a != b) {
+            partners[a].push_back(b);
+            partners[b].push_back(a);
+        }
+    }
+
+    // Select: pop and take a free register, preferring a partner's
+    // register, then caller-saved, then callee-saved
+    constexpr int UNCOLORED = -1;
+    std::vector<int> color(count, UNCOLORED); // Index into `registers`
+    std::vector<int> slot(count, UNCOLORED);
+    std::vector<bool> taken(registers.size());
+    std::vector<bool> calleeSavedUsed(registers.size(), false);
+    std::vector<uint32_t> spilled;
+    for (auto it = stack.rbegin(); it != stack.rend(); ++it) {
+        uint32_t n = *it;
+        std::fill(taken.begin(), taken.end(), false);
+        for (uint32_t m : adjacency[n]) {
+            if (color[m] != UNCOLORED) taken[color[m]] = true;
+        }
+        auto usable = [&](int r) {
+            return !taken[r] && (!crossesCall[n] || !registers[r].callerSave);
+        };
+
+        int chosen = UNCOLORED;
+        for (uint32_t partner : partners[n]) {
+            if (color[partner] != UNCOLORED && usable(color[partner])) {
+                chosen = color[partner];
+                break;
+            }
+        }
+        for (int pass = 0; pass < 2 && chosen == UNCOLORED; ++pass) {
+            for (size_t r = 0; r < registers.size(); ++r) {
+                if (usable(static_cast<int>(r)) && registers[r].callerSave == (pass == 0)) {
+                    chosen = static_cast<int>(r);
+                    break;
+                }
+            }
+        }
+        if (chosen == UNCOLORED) {
+            spilled.push_back(n);
+            continue;
+        }
+        color[n] = chosen;
+        if (!registers[chosen].callerSave) calleeSavedUsed[chosen] = true;
+    }
+
+    // Spilled nodes that do not interfere share a slot
+    for (uint32_t n : spilled) {
+        std::vector<bool> slotTaken(result.spillSlots, false);
+        for (uint32_t m : adjacency[n]) {
+            if (slot[m] != UNCOLORED) slotTaken[slot[m]] = true;
+        }
+        int chosen = 0;
+        while (chosen < static_cast<int>(slotTaken.size()) && slotTaken[chosen]) ++chosen;
+        slot[n] = chosen;
+        result.spillSlots = std::max<uint32_t>(result.spillSlots, chosen + 1);
+        ++result.spilledValues;
+    }
+
+    for (uint32_t n = 0; n < count; ++n) {
+        uint32_t rep = find(n);
+        ValueLocation loc;
+        if (color[rep] != UNCOLORED) {
+            loc = {ValueLocation::Kind::REGISTER, registers[color[rep]].number};
+        } else {
+            loc = {ValueLocation::Kind::STACK, slot[rep]};
+        }
+        result.locations[intervals[n].value] = loc;
+    }
+    for (const auto& move : graph.moves_) {
+        uint32_t a = find(move.first);
+        uint32_t b = find(move.second);
+        if (a == b || (color[a] != UNCOLORED && color[a] == color[b])) {
+            ++result.coalescedMoves;
+        }
+    }
+    for (size_t r = 0; r < registers.size(); ++r) {
+        if (calleeSavedUsed[r]) result.calleeSavedUsed.push_back(registers[r].number);
+    }
+    std::sort(result.calleeSavedUsed.begin(), result.calleeSavedUsed.end());
+    return result;
+}
+
+} // namespace syclang
@@ -0,0 +1,148 @@
+#include "syclang/codegen/linear_scan.h"
+#include <algorithm>
+#include <unordered_map>
+
+namespace syclang {
+
+RegisterAllocation allocateLinearScan(const FunctionLiveness& liveness,
+                                      const std::vector<AllocatableRegister>& registers) {
+    RegisterAllocation result;
+    const auto& intervals = liveness.intervals();
+
+    // Intervals currently assigned to each register and each spill slot.
+    // Intervals have holes, so a location is free for a new interval when
+    // none of its holders overlaps it, not just when they have all ended.
+    std::vector<std::vector<size_t>> registerHolders(registers.size());
+    std::vector<std::vector<size_t>> slotHolders;
+    std::vector<bool> calleeSavedUsed(registers.size(), false);
+
+    // PHI results and their inputs prefer each other's location, so the
+    // copy on the edge disappears
+    std::unordered_map<ValueId, std::vector<ValueId>> partners;
+    for (const auto& [result, incoming] : liveness.phiCopies()) {
+        partners[result].push_back(incoming);
+        partners[incoming].push_back(result);
+    }
+    std::unordered_map<int, size_t> registerIndex;
+    for (size_t r = 0; r < registers.size(); ++r) {
+        registerIndex[registers[r].number] = r;
+    }
+
+    auto conflicts = [&](const std::vector<size_t>& holders, size_t interval) {
+        size_t count = 0;
+        for (size_t held : holders) {
+            if (FunctionLiveness::overlaps(intervals[held], intervals[interval])) ++count;
+        }
+        return count;
+    };
+    auto assignRegister = [&](size_t interval, size_t reg) {
+        registerHolders[reg].push_back(interval);
+        if (!registers[reg].callerSave) {
+            calleeSavedUsed[reg] = true;
+        }
+        result.locations[intervals[interval].value] = {ValueLocation::Kind::REGISTER,
+                                                       registers[reg].number};
+    };
+    auto assignSlot = [&](size_t interval) {
+        // Likewise a partner's slot avoids a memory-to-memory copy
+        int slot = -1;
+        auto partner = partners.find(intervals[interval].value);
+        if (partner != partners.end()) {
+            for (ValueId other : partner->second) {
+                ValueLocation loc = result.locate(other);
+                if (loc.kind == ValueLocation::Kind::STACK &&
+                    conflicts(slotHolders[loc.index], interval) == 0) {
+                    slot = loc.index;
+                    break;
+                }
+            }
+        }
+        for (size_t s = 0; s < slotHolders.size() && slot < 0; ++s) {
+            if (conflicts(slotHolders[s], interval) == 0) {
+                slot = static_cast<int>(s);
+            }
+        }
+        if (slot < 0) {
+            slot = static_cast<int>(result.spillSlots++);
+            slotHolders.emplace_back();
+        }
+        slotHolders[slot].push_back(interval);
+        result.locations[intervals[interval].value] = {ValueLocation::Kind::STACK, slot};
+        ++result.spilledValues;
+    };
+
+    for (size_t i = 0; i < intervals.size(); ++i) {
+        const auto& current = intervals[i];
+
+        // Intervals that ended before this one starts can never conflict
+        // with it or anything after it. Slot holders stay: a victim spilled
+        // below started earlier and may overlap any of them
+        for (auto& holders : registerHolders) {
+            std::erase_if(holders, [&](size_t held) { return intervals[held].end < current.start; });
+        }
+
+        auto usable = [&](size_t r) { return !current.crossesCall || !registers[r].callerSave; };
+
+        // A free partner register first, then caller-saved so short-lived
+        // temporaries cost no save/restore
+        int chosen = -1;
+        auto partner = partners.find(current.value);
+        if (partner != partners.end()) {
+            for (ValueId other : partner->second) {
+                ValueLocation loc = result.locate(other);
+                if (loc.kind != ValueLocation::Kind::REGISTER) continue;
+                size_t r = registerIndex[loc.index];
+                if (usable(r) && conflicts(registerHolders[r], i) == 0) {
+                    chosen = static_cast<int>(r);
+                    break;
+                }
+            }
+        }
+        for (int pass = 0; pass < 2 && chosen < 0; ++pass) {
+            bool wantCallerSave = pass == 0;
+            for (size_t r = 0; r < registers.size(); ++r) {
+                if (registers[r].callerSave == wantCallerSave && usable(r) &&
+                    conflicts(registerHolders[r], i) == 0) {
+                    chosen = static_cast<int>(r);
+                    break;
+                }
+            }
+        }
+        if (chosen >= 0) {
+            assignRegister(i, chosen);
+            continue;
+        }
+
+        // No register: spill the single conflicting interval that ends
+        // last, or this one if it ends later still
+        size_t victimRegister = registers.size();
+        size_t victim = 0;
+        for (size_t r = 0; r < registers.size(); ++r) {
+            if (!usable(r) || conflicts(registerHolders[r], i) != 1) continue;
+            for (size_t held : registerHolders[r]) {
+                if (!FunctionLiveness::overlaps(intervals[held], current)) continue;
+                if (victimRegister == registers.size() || intervals[held].end > intervals[victim].end) {
+                    victimRegister = r;
+                    victim = held;
+                }
+            }
+        }
+        if (victimRegister < registers.size() && intervals[victim].end > current.end) {
+            std::erase(registerHolders[victimRegister], victim);
+            assignSlot(victim);
+            assignRegister(i, victimRegister);
+        } else {
+            assignSlot(i);
+        }
+    }
+
+    for (size_t r = 0; r < registers.size(); ++r) {
+        if (calleeSavedUsed[r]) {
+            result.calleeSavedUsed.push_back(registers[r].number);
+        }
+    }
+    std::sort(result.calleeSavedUsed.begin(), result.calleeSavedUsed.end());
+    return result;
+}
+
+} // namespace syclang
@@ -0,0 +1,331 @@
+#include "syclang/codegen/liveness.h"
+#include <algorithm>
+
+namespace syclang {
+
+ValueId FunctionLiveness::definedValue(const IRArena& arena, const IRInstruction& inst) {
+    switch (inst.opcode) {
+        case Opcode::ALLOCA:
+            return INVALID_ID;
+        case Opcode::STORE: {
+            // A store through a pointer (value, base, index) writes memory
+            auto ops = arena.operands(inst);
+            return ops.size() == 2 ? ops[1] : INVALID_ID;
+        }
+        default:
+            return inst.result;
+    }
+}
+
+void FunctionLiveness::collectUses(const IRArena& arena, const IRInstruction& inst,
+                                   std::vector<ValueId>& uses) {
+    uses.clear();
+    auto ops = arena.operands(inst);
+    if (inst.opcode == Opcode::PHI) {
+        // Incoming values are read on the edges, not at the PHI itself
+        return;
+    }
+    if (inst.opcode == Opcode::STORE && ops.size() <= 2) {
+        // The destination of a store is written, not read
+        if (!ops.empty()) {
+            uses.push_back(ops[0]);
+        }
+        return;
+    }
+    uses.assign(ops.begin(), ops.end());
+}
+
+namespace {
+
+inline void setBit(std::vector<uint64_t>& bits, uint32_t index) {
+    bits[index >> 6] |= uint64_t(1) << (index & 63);
+}
+
+inline bool testBit(const std::vector<uint64_t>& bits, uint32_t index) {
+    return (bits[index >> 6] >> (index & 63)) & 1;
+}
+
+} // namespace
+
+FunctionLiveness::FunctionLiveness(const IRArena& arena, const IRFunction& func)
+    : instructionCount_(0) {
+    size_t blockCount = func.blocks.size();
+    std::unordered_map<BlockId, size_t> blockIndex;
+    blockIndex.reserve(blockCount);
+    for (size_t b = 0; b < blockCount; ++b) {
+        blockIndex[func.blocks[b]] = b;
+    }
+
+    // Number instructions and collect the candidates
+    auto noteCandidate = [&](ValueId id) {
+        if (id == INVALID_ID || localIndex_.count(id)) {
+            return;
+        }
+        // Vector values stay inside one block and get vector registers
+        // from the backend instead
+        const IRValue& value = arena.value(id);
+        if (value.isVariable() && !value.isGlobal && !isVectorType(value.getType())) {
+            localIndex_[id] = static_cast<uint32_t>(locals_.size());
+            locals_.push_back(id);
+        }
+    };
+
+    std::vector<ValueId> uses;
+    blockStarts_.resize(blockCount);
+    for (size_t b = 0; b < blockCount; ++b) {
+        blockStarts_[b] = instructionCount_;
+        for (InstId instId : arena.block(func.blocks[b]).instructions) {
+            const IRInstruction& inst = arena.instruction(instId);
+            if (inst.opcode == Opcode::CALL) {
+                calls_.push_back(instructionCount_);
+            }
+            noteCandidate(definedValue(arena, inst));
+            collectUses(arena, inst, uses);
+            for (ValueId use : uses) {
+                noteCandidate(use);
+            }
+            if (inst.opcode == Opcode::PHI) {
+                for (ValueId incoming : arena.operands(inst)) {
+                    noteCandidate(incoming);
+                }
+            }
+            ++instructionCount_;
+        }
+    }
+
+    // Per-block upward-exposed uses and definitions
+    size_t words = (locals_.size() + 63) / 64;
+    std::vector<std::vector<uint64_t>> gen(blockCount, std::vector<uint64_t>(words));
+    std::vector<std::vector<uint64_t>> kill(blockCount, std::vector<uint64_t>(words));
+    std::vector<std::vector<size_t>> successors(blockCount);
+    // PHI inputs, live out of the predecessor they arrive from
+    std::vector<std::vector<uint64_t>> phiOut(blockCount, std::vector<uint64_t>(words));
+
+    for (size_t b = 0; b < blockCount; ++b) {
+        bool terminated = false;
+        for (InstId instId : arena.block(func.blocks[b]).instructions) {
+            const IRInstruction& inst = arena.instruction(instId);
+            collectUses(arena, inst, uses);
+            for (ValueId use : uses) {
+                auto it = localIndex_.find(use);
+                if (it != localIndex_.end() && !testBit(kill[b], it->second)) {
+                    setBit(gen[b], it->second);
+                }
+            }
+            auto def = localIndex_.find(definedValue(arena, inst));
+            if (def != localIndex_.end()) {
+                setBit(kill[b], def->second);
+            }
+            if (inst.opcode == Opcode::PHI) {
+                auto values = arena.operands(inst);
+                auto from = arena.incomingBlocks(inst);
+                for (size_t i = 0; i < values.size(); ++i) {
+                    auto local = localIndex_.find(values[i]);
+                    auto pred = blockIndex.find(from[i]);
+                    if (local != localIndex_.end() && pred != blockIndex.end()) {
+                        setBit(phiOut[pred->second], local->second);
+                    }
+                }
+            }
+
+            int targetCount = inst.opcode == Opcode::BR ? 1 : inst.opcode == Opcode::CONDBR ? 2 : 0;
+            for (int t = 0; t < targetCount; ++t) {
+                auto target = blockIndex.find(inst.targets[t]);
+                if (target != blockIndex.end()) {
+                    successors[b].push_back(target->second);
+                }
+            }
+            if (inst.isTerminator()) {
+                terminated = true;
+                break;
+            }
+        }
+        // A block without a terminator falls through to the next one
+        if (!terminated && b + 1 < blockCount) {
+            successors[b].push_back(b + 1);
+        }
+    }
+
+    // Backward dataflow: in = gen | (out & ~kill), out = union of successor
+    // ins plus the block's PHI inputs
+    std::vector<std::vector<uint64_t>> liveIn(blockCount, std::vector<uint64_t>(words));
+    liveOut_ = std::move(phiOut);
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t b = blockCount; b-- > 0;) {
+            for (size_t succ : successors[b]) {
+                for (size_t w = 0; w < words; ++w) {
+                    liveOut_[b][w] |= liveIn[succ][w];
+                }
+            }
+            for (size_t w = 0; w < words; ++w) {
+                uint64_t in = gen[b][w] | (liveOut_[b][w] & ~kill[b][w]);
+                if (in != liveIn[b][w]) {
+                    liveIn[b][w] = in;
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    // Within each block a value is live from its definition (or the block
+    // entry, if live in) to its last read (or the block exit, if live out).
+    // These per-block pieces, joined where they touch, form the interval;
+    // the gaps between them are holes where the location is free.
+    constexpr uint32_t NONE = 0xFFFFFFFFu;
+    std::vector<std::vector<Range>> ranges(locals_.size());
+    std::vector<uint32_t> useCount(locals_.size(), 0);
+    std::vector<uint32_t> firstDef(locals_.size(), NONE);
+    std::vector<uint32_t> lastUse(locals_.size(), NONE);
+    std::vector<bool> defined(locals_.size(), false); // First piece starts at a definition
+    std::vector<uint32_t> touched;
+    auto touch = [&](uint32_t local) {
+        if (firstDef[local] == NONE && lastUse[local] == NONE) touched.push_back(local);
+    };
+    auto addRange = [&](uint32_t local, uint32_t from, uint32_t to) {
+        auto& pieces = ranges[local];
+        if (pieces.empty()) {
+            defined[local] = firstDef[local] == from;
+        }
+        if (!pieces.empty() && pieces.back().to + 1 >= from) {
+            pieces.back().to = std::max(pieces.back().to, to);
+        } else {
+            pieces.push_back({from, to});
+        }
+    };
+
+    auto lastPosition = [&](size_t b) {
+        uint32_t first = blockStarts_[b];
+        uint32_t last = (b + 1 < blockCount ? blockStarts_[b + 1] : instructionCount_);
+        return last > first ? last - 1 : first;
+    };
+    // PHI inputs are read at the end of their predecessor, which may be
+    // laid out after the PHI's block: collect them per predecessor first
+    std::vector<std::vector<uint32_t>> phiReads(blockCount);
+    for (size_t b = 0; b < blockCount; ++b) {
+        for (InstId instId : arena.block(func.blocks[b]).instructions) {
+            const IRInstruction& inst = arena.instruction(instId);
+            if (inst.opcode != Opcode::PHI) continue;
+            auto values = arena.operands(inst);
+            auto from = arena.incomingBlocks(inst);
+            for (size_t i = 0; i < values.size(); ++i) {
+                auto local = localIndex_.find(values[i]);
+                auto pred = blockIndex.find(from[i]);
+                if (local != localIndex_.end() && pred != blockIndex.end()) {
+                    phiReads[pred->second].push_back(local->second);
+                    ++useCount[local->second];
+                    phiCopies_.push_back({inst.result, values[i]});
+                }
+            }
+        }
+    }
+
+    uint32_t position = 0;
+    for (size_t b = 0; b < blockCount; ++b) {
+        uint32_t first = blockStarts_[b];
+        uint32_t last = lastPosition(b);
+        for (InstId instId : arena.block(func.blocks[b]).instructions) {
+            const IRInstruction& inst = arena.instruction(instId);
+            collectUses(arena, inst, uses);
+            for (ValueId use : uses) {
+                auto it = localIndex_.find(use);
+                if (it != localIndex_.end()) {
+                    touch(it->second);
+                    lastUse[it->second] = position;
+                    ++useCount[it->second];
+                }
+            }
+            auto def = localIndex_.find(definedValue(arena, inst));
+            if (def != localIndex_.end()) {
+                touch(def->second);
+                firstDef[def->second] = std::min(firstDef[def->second], position);
+            }
+            ++position;
+        }
+        for (uint32_t local : phiReads[b]) {
+            touch(local);
+            lastUse[local] = last;
+        }
+
+        for (uint32_t local = 0; local < locals_.size(); ++local) {
+            bool in = testBit(liveIn[b], local);
+            bool out = testBit(liveOut_[b], local);
+            if (!in && !out && firstDef[local] == NONE && lastUse[local] == NONE) continue;
+            uint32_t from = in ? first : std::min(firstDef[local], lastUse[local]);
+            uint32_t to = out ? last : (lastUse[local] != NONE ? lastUse[local] : firstDef[local]);
+            addRange(local, from, std::max(from, to));
+        }
+        for (uint32_t local : touched) {
+            firstDef[local] = NONE;
+            lastUse[local] = NONE;
+        }
+        touched.clear();
+    }
+
+    for (uint32_t local = 0; local < locals_.size(); ++local) {
+        if (useCount[local] == 0) {
+            continue; // Never read: needs no location
+        }
+        Interval interval{locals_[local], ranges[local].front().from, ranges[local].back().to,
+                          useCount[local], false, defined[local], std::move(ranges[local])};
+        for (const Range& range : interval.ranges) {
+            // A piece opened by the value's definition starts after the
+            // instruction there; one live into its block is live across a
+            // call that opens the block, too
+            bool atDefinition = &range == &interval.ranges.front() && interval.definedAtStart;
+            auto call = atDefinition ? std::upper_bound(calls_.begin(), calls_.end(), range.from)
+                                     : std::lower_bound(calls_.begin(), calls_.end(), range.from);
+            if (call != calls_.end() && *call < range.to) {
+                interval.crossesCall = true;
+                break;
+            }
+        }
+        intervals_.push_back(std::move(interval));
+    }
+    std::sort(intervals_.begin(), intervals_.end(), [](const Interval& a, const Interval& b) {
+        return a.start != b.start ? a.start < b.start : a.value < b.value;
+    });
+    intervalIndex_.reserve(intervals_.size());
+    for (size_t i = 0; i < intervals_.size(); ++i) {
+        intervalIndex_[intervals_[i].value] = i;
+    }
+}
+
+bool FunctionLiveness::overlaps(const Interval& a, const Interval& b) {
+    if (a.end < b.start || b.end < a.start) return false;
+    size_t i = 0;
+    size_t j = 0;
+    while (i < a.ranges.size() && j < b.ranges.size()) {
+        const Range& x = a.ranges[i];
+        const Range& y = b.ranges[j];
+        uint32_t from = std::max(x.from, y.from);
+        uint32_t to = std::min(x.to, y.to);
+        if (from < to) return true;
+        if (from == to) {
+            // Touching at one position only: fine if that is where one is
+            // defined and the other last read
+            bool aDefinedHere = i == 0 && a.definedAtStart && x.from == from && y.to == from;
+            bool bDefinedHere = j == 0 && b.definedAtStart && y.from == from && x.to == from;
+            if (!aDefinedHere && !bDefinedHere) return true;
+        }
+        if (x.to < y.to) {
+            ++i;
+        } else {
+            ++j;
+        }
+    }
+    return false;
+}
+
+std::vector<ValueId> FunctionLiveness::liveOut(size_t block) const {
+    std::vector<ValueId> result;
+    for (uint32_t local = 0; local < locals_.size(); ++local) {
+        if (testBit(liveOut_[block], local)) {
+            result.push_back(locals_[local]);
+        }
+    }
+    return result;
+}
+
+} // namespace syclang
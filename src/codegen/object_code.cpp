@@ -0,0 +1,130 @@
+#include "syclang/codegen/object_code.h"
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace syclang {
+
+void ObjectCode::append(const ObjectCode& other, size_t alignment) {
+    text.resize((text.size() + alignment - 1) / alignment * alignment);
+    data.resize((data.size() + alignment - 1) / alignment * alignment);
+    uint64_t textBase = text.size();
+    uint64_t dataBase = data.size();
+    auto base = [&](Section section) { return section == Section::TEXT ? textBase : dataBase; };
+
+    text.insert(text.end(), other.text.begin(), other.text.end());
+    data.insert(data.end(), other.data.begin(), other.data.end());
+    for (ObjectSymbol symbol : other.symbols) {
+        symbol.offset += base(symbol.section);
+        symbols.push_back(std::move(symbol));
+    }
+    for (Relocation relocation : other.relocations) {
+        relocation.offset += base(relocation.section);
+        relocations.push_back(std::move(relocation));
+    }
+}
+
+void ObjectCode::defineData(const std::string& name, size_t size, size_t alignment) {
+    data.resize((data.size() + alignment - 1) / alignment * alignment);
+    symbols.push_back({name, Section::DATA, data.size(), size, true});
+    data.resize(data.size() + size);
+}
+
+const ObjectSymbol* ObjectCode::findSymbol(const std::string& name) const {
+    for (const auto& symbol : symbols) {
+        if (symbol.name == name) return &symbol;
+    }
+    return nullptr;
+}
+
+void ObjectCode::sizeSymbols() {
+    std::vector<ObjectSymbol*> ordered;
+    for (auto& symbol : symbols) ordered.push_back(&symbol);
+    std::stable_sort(ordered.begin(), ordered.end(), [](const ObjectSymbol* a, const ObjectSymbol* b) {
+        return a->section != b->section ? a->section < b->section : a->offset < b->offset;
+    });
+    for (size_t i = 0; i < ordered.size(); ++i) {
+        bool last = i + 1 == ordered.size() || ordered[i + 1]->section != ordered[i]->section;
+        uint64_t end = last ? (ordered[i]->section == Section::TEXT ? text.size() : data.size())
+                            : ordered[i + 1]->offset;
+        ordered[i]->size = end - ordered[i]->offset;
+    }
+}
+
+void applyRelocation(uint8_t* field, RelocationType type, uint64_t value, uint64_t place) {
+    auto read32 = [&] {
+        uint32_t word = 0;
+        for (int i = 0; i < 4; ++i) word |= static_cast<uint32_t>(field[i]) << (8 * i);
+        return word;
+    };
+    auto write = [&](uint64_t bits, int bytes) {
+        for (int i = 0; i < bytes; ++i) field[i] = static_cast<uint8_t>(bits >> (8 * i));
+    };
+    auto fits = [](int64_t v, int bits) {
+        return v >= -(int64_t(1) << (bits - 1)) && v < (int64_t(1) << (bits - 1));
+    };
+    int64_t relative = static_cast<int64_t>(value - place);
+
+    switch (type) {
+        case RelocationType::PC32:
+        case RelocationType::PLT32:
+            if (!fits(relative, 32)) throw std::runtime_error("out of range");
+            write(static_cast<uint32_t>(relative), 4);
+            break;
+        case RelocationType::CALL26:
+        case RelocationType::JUMP26:
+            if (relative % 4 != 0 || !fits(relative, 28)) throw std::runtime_error("out of range");
+            write((read32() & 0xFC000000u) | ((relative >> 2) & 0x3FFFFFF), 4);
+            break;
+        case RelocationType::ADR_PREL_PG_HI21: {
+            int64_t pages = static_cast<int64_t>((value >> 12) - (place >> 12));
+            if (!fits(pages, 21)) throw std::runtime_error("out of range");
+            uint32_t low = pages & 3, high = (pages >> 2) & 0x7FFFF;
+            write((read32() & 0x9F00001Fu) | (low << 29) | (high << 5), 4);
+            break;
+        }
+        case RelocationType::ADD_ABS_LO12_NC:
+            write((read32() & 0xFFC003FFu) | ((value & 0xFFF) << 10), 4);
+            break;
+        case RelocationType::LDST64_ABS_LO12_NC:
+            if (value % 8 != 0) throw std::runtime_error("misaligned");
+            write((read32() & 0xFFC003FFu) | (((value & 0xFFF) >> 3) << 10), 4);
+            break;
+        case RelocationType::ABS64:
+            write(value, 8);
+            break;
+    }
+}
+
+std::vector<uint8_t> linkFlatImage(const ObjectCode& object) {
+    uint64_t dataBase = (object.text.size() + 15) / 16 * 16;
+    std::vector<uint8_t> image(dataBase + object.data.size(), 0);
+    std::copy(object.text.begin(), object.text.end(), image.begin());
+    std::copy(object.data.begin(), object.data.end(), image.begin() + dataBase);
+
+    auto base = [&](Section section) { return section == Section::TEXT ? 0 : dataBase; };
+    std::unordered_map<std::string, uint64_t> addresses;
+    for (const auto& symbol : object.symbols) {
+        addresses.emplace(symbol.name, base(symbol.section) + symbol.offset);
+    }
+
+    for (const auto& relocation : object.relocations) {
+        auto it = addresses.find(relocation.symbol);
+        if (it == addresses.end()) {
+            throw std::runtime_error("Undefined symbol '" + relocation.symbol + "'");
+        }
+        if (relocation.type == RelocationType::ABS64) {
+            throw std::runtime_error("Absolute relocation against '" + relocation.symbol +
+                                     "' in a position-independent image");
+        }
+        uint64_t place = base(relocation.section) + relocation.offset;
+        try {
+            applyRelocation(image.data() + place, relocation.type, it->second + relocation.addend, place);
+        } catch (const std::runtime_error& e) {
+            throw std::runtime_error("Relocation against '" + relocation.symbol + "' " + e.what());
+        }
+    }
+    return image;
+}
+
+} // namespace syclang
@@ -0,0 +1,138 @@
+#include "syclang/codegen/output_buffer.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+
+namespace syclang {
+
+namespace {
+
+bool writeAll(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t written = ::write(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+} // namespace
+
+char* OutputBuffer::reserve(size_t& available) {
+    if (pages_.empty() || pages_.back().used == pages_.back().capacity) {
+        if (fd_ >= 0 && !pages_.empty() && pages_.back().capacity == PAGE_SIZE) {
+            writePages();
+        } else {
+            Page page;
+            page.capacity = std::clamp(size(), MIN_PAGE_SIZE, PAGE_SIZE);
+            page.data.reset(new char[page.capacity]);
+            pages_.push_back(std::move(page));
+        }
+    }
+    Page& page = pages_.back();
+    available = page.capacity - page.used;
+    return page.data.get() + page.used;
+}
+
+// Write out every page and keep the largest one for what comes next
+void OutputBuffer::writePages() {
+    for (const Page& page : pages_) {
+        failed_ = failed_ || !writeAll(fd_, page.data.get(), page.used);
+    }
+    flushed_ += held_;
+    held_ = 0;
+    auto largest = std::max_element(pages_.begin(), pages_.end(), [](const Page& a, const Page& b) {
+        return a.capacity < b.capacity;
+    });
+    std::swap(pages_.front(), *largest);
+    pages_.resize(1);
+    pages_.front().used = 0;
+}
+
+void OutputBuffer::appendAcrossPages(std::string_view text) {
+    while (!text.empty()) {
+        size_t available;
+        char* out = reserve(available);
+        size_t n = std::min(available, text.size());
+        std::memcpy(out, text.data(), n);
+        pages_.back().used += n;
+        held_ += n;
+        text.remove_prefix(n);
+    }
+}
+
+void OutputBuffer::append(OutputBuffer&& other) {
+    if (other.held_ < PAGE_SIZE / 4) {
+        for (const Page& page : other.pages_) {
+            append(std::string_view(page.data.get(), page.used));
+        }
+    } else {
+        for (Page& page : other.pages_) {
+            held_ += page.used;
+            pages_.push_back(std::move(page));
+        }
+        if (fd_ >= 0) {
+            writePages();
+        }
+    }
+    failed_ = failed_ || other.failed_;
+    other.pages_.clear();
+    other.held_ = 0;
+}
+
+void OutputBuffer::appendDecimal(unsigned long long magnitude, bool negative) {
+    char digits[24];
+    char* end = digits + sizeof(digits);
+    char* start = end;
+    do {
+        *--start = static_cast<char>('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude != 0);
+    if (negative) {
+        *--start = '-';
+    }
+    append(std::string_view(start, static_cast<size_t>(end - start)));
+}
+
+void OutputBuffer::clear() {
+    pages_.clear();
+    held_ = 0;
+    flushed_ = 0;
+    failed_ = false;
+}
+
+std::string OutputBuffer::str() const {
+    std::string text;
+    text.reserve(held_);
+    for (const Page& page : pages_) {
+        text.append(page.data.get(), page.used);
+    }
+    return text;
+}
+
+bool OutputBuffer::writeTo(int fd) const {
+    for (const Page& page : pages_) {
+        if (!writeAll(fd, page.data.get(), page.used)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void OutputBuffer::setFile(int fd) {
+    fd_ = fd;
+}
+
+bool OutputBuffer::flush() {
+    if (fd_ >= 0 && !pages_.empty()) {
+        writePages();
+    }
+    return !failed_;
+}
+
+} // namespace syclang
@@ -0,0 +1,259 @@
+#include "syclang/codegen/pe_writer.h"
+#include "syclang/codegen/x64/x64_assembler.h"
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace syclang {
+
+namespace {
+
+constexpr uint32_t SECTION_ALIGNMENT = 0x1000;
+constexpr uint32_t FILE_ALIGNMENT = 0x200;
+constexpr uint32_t PE_HEADER_OFFSET = 0x40; // Right after the DOS header
+constexpr size_t COFF_HEADER_SIZE = 20;
+constexpr size_t OPTIONAL_HEADER_SIZE = 240; // PE32+ with 16 data directories
+constexpr size_t SECTION_HEADER_SIZE = 40;
+constexpr uint32_t DATA_DIRECTORIES = 16;
+constexpr size_t BASE_RELOCATION_DIRECTORY = 5;
+
+constexpr uint16_t MACHINE_AMD64 = 0x8664;
+constexpr uint16_t MACHINE_ARM64 = 0xAA64;
+constexpr uint16_t FILE_EXECUTABLE_IMAGE = 0x0002;
+constexpr uint16_t FILE_LARGE_ADDRESS_AWARE = 0x0020;
+constexpr uint16_t PE32_PLUS_MAGIC = 0x20B;
+constexpr uint16_t SUBSYSTEM_WINDOWS_CUI = 3;
+constexpr uint16_t SUBSYSTEM_EFI_APPLICATION = 10;
+constexpr uint16_t DLL_HIGH_ENTROPY_VA = 0x0020;
+constexpr uint16_t DLL_DYNAMIC_BASE = 0x0040;
+constexpr uint16_t DLL_NX_COMPAT = 0x0100;
+constexpr uint16_t DLL_TERMINAL_SERVER_AWARE = 0x8000;
+constexpr uint16_t REL_BASED_ABSOLUTE = 0; // Padding entry
+constexpr uint16_t REL_BASED_DIR64 = 10;
+
+constexpr uint32_t SCN_CNT_CODE = 0x00000020;
+constexpr uint32_t SCN_CNT_INITIALIZED_DATA = 0x00000040;
+constexpr uint32_t SCN_MEM_DISCARDABLE = 0x02000000;
+constexpr uint32_t SCN_MEM_EXECUTE = 0x20000000;
+constexpr uint32_t SCN_MEM_READ = 0x40000000;
+constexpr uint32_t SCN_MEM_WRITE = 0x80000000;
+
+// Windows' default for 64-bit programs. EFI toolchains link at 0 and
+// leave placing the image to the firmware's loader.
+constexpr uint64_t PE_IMAGE_BASE = 0x140000000;
+constexpr uint64_t EFI_IMAGE_BASE = 0;
+
+template <typename T>
+void put(std::vector<uint8_t>& out, T value) {
+    for (size_t i = 0; i < sizeof(T); ++i) out.push_back(static_cast<uint8_t>(static_cast<uint64_t>(value) >> (8 * i)));
+}
+
+template <typename T>
+void putAt(std::vector<uint8_t>& out, size_t at, T value) {
+    for (size_t i = 0; i < sizeof(T); ++i) out[at + i] = static_cast<uint8_t>(static_cast<uint64_t>(value) >> (8 * i));
+}
+
+uint64_t alignUp(uint64_t value, uint64_t alignment) { return (value + alignment - 1) / alignment * alignment; }
+
+struct PeSection {
+    const char* name;
+    uint32_t characteristics;
+    const std::vector<uint8_t>* contents;
+    uint32_t address; // Relative to the image base
+};
+
+// Entered with the Microsoft x64 convention: arguments in rcx and rdx,
+// and rdi, rsi and xmm6-xmm15 preserved for the caller, which the System
+// V code behind `target` does not do
+ObjectCode entryThunk(const std::string& target) {
+    std::string assembly = ".intel_syntax noprefix\n"
+                           ".global _start\n"
+                           "_start:\n"
+                           "    push rdi\n"
+                           "    push rsi\n"
+                           "    sub rsp, 168\n";
+    for (int i = 0; i < 10; ++i) {
+        assembly += "    movdqu xmmword ptr [rsp + " + std::to_string(16 * i) + "], xmm" + std::to_string(6 + i) + "\n";
+    }
+    assembly += "    mov rdi, rcx\n"
+                "    mov rsi, rdx\n"
+                "    call " + target + "\n";
+    for (int i = 0; i < 10; ++i) {
+        assembly += "    movdqu xmm" + std::to_string(6 + i) + ", xmmword ptr [rsp + " + std::to_string(16 * i) + "]\n";
+    }
+    assembly += "    add rsp, 168\n"
+                "    pop rsi\n"
+                "    pop rdi\n"
+                "    ret\n";
+    return assembleX64(assembly);
+}
+
+// One block per 4 KiB page: the page, the block size, then a 16-bit
+// entry per fixup, padded to a 32-bit boundary
+std::vector<uint8_t> baseRelocations(std::vector<uint32_t> fixups) {
+    std::sort(fixups.begin(), fixups.end());
+    std::vector<uint8_t> out;
+    for (size_t i = 0; i < fixups.size();) {
+        uint32_t page = fixups[i] & ~(SECTION_ALIGNMENT - 1);
+        size_t block = out.size();
+        put<uint32_t>(out, page);
+        put<uint32_t>(out, 0);
+        for (; i < fixups.size() && (fixups[i] & ~(SECTION_ALIGNMENT - 1)) == page; ++i) {
+            put<uint16_t>(out, static_cast<uint16_t>(REL_BASED_DIR64 << 12 | (fixups[i] & (SECTION_ALIGNMENT - 1))));
+        }
+        if ((out.size() - block) % 4) {
+            put<uint16_t>(out, REL_BASED_ABSOLUTE);
+        }
+        putAt<uint32_t>(out, block + 4, static_cast<uint32_t>(out.size() - block));
+    }
+    return out;
+}
+
+// 16-bit sum of the file with carries folded back in, plus its length.
+// The checksum field itself must still be zero.
+uint32_t imageChecksum(const std::vector<uint8_t>& file) {
+    uint64_t sum = 0;
+    for (size_t i = 0; i < file.size(); i += 2) {
+        sum += file[i] | (i + 1 < file.size() ? file[i + 1] << 8 : 0);
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    }
+    return static_cast<uint32_t>(sum + file.size());
+}
+
+} // namespace
+
+std::vector<uint8_t> writePeImage(const ObjectCode& input, Architecture arch, OutputFormat format) {
+    bool efi = format == OutputFormat::EFI;
+    std::string entryName = efi ? "efi_main" : "main";
+    ObjectCode object = input;
+    if (!object.findSymbol("_start")) {
+        const ObjectSymbol* entry = object.findSymbol(entryName);
+        if (!entry || entry->section != Section::TEXT) {
+            throw std::runtime_error("No '" + entryName + "' function to enter the image at");
+        }
+        // AArch64 firmware and Windows call with the same convention the
+        // code generator uses
+        if (arch == Architecture::X64) {
+            object.append(entryThunk(entryName), 16);
+        }
+    }
+    if (object.findSymbol("_start")) {
+        entryName = "_start";
+    }
+
+    uint64_t imageBase = efi ? EFI_IMAGE_BASE : PE_IMAGE_BASE;
+    uint32_t textAddress = SECTION_ALIGNMENT;
+    uint32_t dataAddress = static_cast<uint32_t>(alignUp(textAddress + object.text.size(), SECTION_ALIGNMENT));
+    std::unordered_map<std::string, uint32_t> addresses;
+    for (const auto& symbol : object.symbols) {
+        addresses.emplace(symbol.name,
+                          static_cast<uint32_t>((symbol.section == Section::TEXT ? textAddress : dataAddress) +
+                                                symbol.offset));
+    }
+
+    // Everything but absolute addresses is position-independent; those
+    // get a fixup for wherever the loader puts the image
+    std::vector<uint32_t> fixups;
+    for (const auto& relocation : object.relocations) {
+        auto it = addresses.find(relocation.symbol);
+        if (it == addresses.end()) {
+            throw std::runtime_error("Undefined symbol '" + relocation.symbol + "'");
+        }
+        bool text = relocation.section == Section::TEXT;
+        std::vector<uint8_t>& contents = text ? object.text : object.data;
+        uint32_t place = static_cast<uint32_t>((text ? textAddress : dataAddress) + relocation.offset);
+        try {
+            applyRelocation(contents.data() + relocation.offset, relocation.type,
+                            imageBase + it->second + relocation.addend, imageBase + place);
+        } catch (const std::runtime_error& e) {
+            throw std::runtime_error("Relocation against '" + relocation.symbol + "' " + e.what());
+        }
+        if (relocation.type == RelocationType::ABS64) {
+            fixups.push_back(place);
+        }
+    }
+    std::vector<uint8_t> relocations = baseRelocations(std::move(fixups));
+
+    std::vector<PeSection> sections;
+    sections.push_back({".text", SCN_CNT_CODE | SCN_MEM_EXECUTE | SCN_MEM_READ, &object.text, textAddress});
+    uint32_t end = dataAddress;
+    if (!object.data.empty()) {
+        sections.push_back({".data", SCN_CNT_INITIALIZED_DATA | SCN_MEM_READ | SCN_MEM_WRITE, &object.data,
+                            dataAddress});
+        end = static_cast<uint32_t>(alignUp(dataAddress + object.data.size(), SECTION_ALIGNMENT));
+    }
+    uint32_t relocationAddress = end;
+    if (!relocations.empty()) {
+        sections.push_back({".reloc", SCN_CNT_INITIALIZED_DATA | SCN_MEM_DISCARDABLE | SCN_MEM_READ, &relocations,
+                            relocationAddress});
+        end = static_cast<uint32_t>(alignUp(relocationAddress + relocations.size(), SECTION_ALIGNMENT));
+    }
+
+    size_t coffHeader = PE_HEADER_OFFSET + 4;
+    size_t optionalHeader = coffHeader + COFF_HEADER_SIZE;
+    size_t sectionTable = optionalHeader + OPTIONAL_HEADER_SIZE;
+    uint32_t headersSize =
+        static_cast<uint32_t>(alignUp(sectionTable + sections.size() * SECTION_HEADER_SIZE, FILE_ALIGNMENT));
+    std::vector<uint8_t> file(headersSize, 0);
+
+    // The DOS header only has to point at the PE header
+    file[0] = 'M';
+    file[1] = 'Z';
+    putAt<uint32_t>(file, 0x3C, PE_HEADER_OFFSET);
+    file[PE_HEADER_OFFSET] = 'P';
+    file[PE_HEADER_OFFSET + 1] = 'E';
+
+    uint32_t codeSize = 0;
+    uint32_t dataSize = 0;
+    for (size_t i = 0; i < sections.size(); ++i) {
+        const PeSection& section = sections[i];
+        uint32_t rawSize = static_cast<uint32_t>(alignUp(section.contents->size(), FILE_ALIGNMENT));
+        size_t at = sectionTable + i * SECTION_HEADER_SIZE;
+        std::copy(section.name, section.name + std::char_traits<char>::length(section.name), file.begin() + at);
+        putAt<uint32_t>(file, at + 8, static_cast<uint32_t>(section.contents->size()));
+        putAt<uint32_t>(file, at + 12, section.address);
+        putAt<uint32_t>(file, at + 16, rawSize);
+        putAt<uint32_t>(file, at + 20, static_cast<uint32_t>(file.size()));
+        putAt<uint32_t>(file, at + 36, section.characteristics);
+        (section.characteristics & SCN_CNT_CODE ? codeSize : dataSize) += rawSize;
+        file.insert(file.end(), section.contents->begin(), section.contents->end());
+        file.resize(file.size() + rawSize - section.contents->size(), 0);
+    }
+
+    putAt<uint16_t>(file, coffHeader, arch == Architecture::X64 ? MACHINE_AMD64 : MACHINE_ARM64);
+    putAt<uint16_t>(file, coffHeader + 2, static_cast<uint16_t>(sections.size()));
+    // TimeDateStamp (+4), the symbol table (+8) and its size (+12) stay 0
+    putAt<uint16_t>(file, coffHeader + 16, static_cast<uint16_t>(OPTIONAL_HEADER_SIZE));
+    putAt<uint16_t>(file, coffHeader + 18, FILE_EXECUTABLE_IMAGE | FILE_LARGE_ADDRESS_AWARE);
+
+    uint16_t systemVersion = efi ? 0 : 6;
+    putAt<uint16_t>(file, optionalHeader, PE32_PLUS_MAGIC);
+    putAt<uint32_t>(file, optionalHeader + 4, codeSize);
+    putAt<uint32_t>(file, optionalHeader + 8, dataSize);
+    putAt<uint32_t>(file, optionalHeader + 16, addresses.at(entryName));
+    putAt<uint32_t>(file, optionalHeader + 20, textAddress);
+    putAt<uint64_t>(file, optionalHeader + 24, imageBase);
+    putAt<uint32_t>(file, optionalHeader + 32, SECTION_ALIGNMENT);
+    putAt<uint32_t>(file, optionalHeader + 36, FILE_ALIGNMENT);
+    putAt<uint16_t>(file, optionalHeader + 40, systemVersion);
+    putAt<uint16_t>(file, optionalHeader + 48, systemVersion);
+    putAt<uint32_t>(file, optionalHeader + 56, end);
+    putAt<uint32_t>(file, optionalHeader + 60, headersSize);
+    putAt<uint16_t>(file, optionalHeader + 68, efi ? SUBSYSTEM_EFI_APPLICATION : SUBSYSTEM_WINDOWS_CUI);
+    putAt<uint16_t>(file, optionalHeader + 70,
+                    DLL_DYNAMIC_BASE | DLL_NX_COMPAT | (efi ? 0 : DLL_HIGH_ENTROPY_VA | DLL_TERMINAL_SERVER_AWARE));
+    putAt<uint64_t>(file, optionalHeader + 72, 0x100000); // Stack reserve
+    putAt<uint64_t>(file, optionalHeader + 80, 0x1000);   // Stack commit
+    putAt<uint64_t>(file, optionalHeader + 88, 0x100000); // Heap reserve
+    putAt<uint64_t>(file, optionalHeader + 96, 0x1000);   // Heap commit
+    putAt<uint32_t>(file, optionalHeader + 108, DATA_DIRECTORIES);
+    if (!relocations.empty()) {
+        size_t directory = optionalHeader + 112 + BASE_RELOCATION_DIRECTORY * 8;
+        putAt<uint32_t>(file, directory, relocationAddress);
+        putAt<uint32_t>(file, directory + 4, static_cast<uint32_t>(relocations.size()));
+    }
+    putAt<uint32_t>(file, optionalHeader + 64, imageChecksum(file));
+    return file;
+}
+
+} // namespace syclang
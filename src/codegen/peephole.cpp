@@ -0,0 +1,209 @@
+#include "syclang/codegen/peephole.h"
+#include <sstream>
+#include <unordered_map>
+
+namespace syclang {
+
+namespace {
+
+std::string_view trim(std::string_view text) {
+    size_t first = text.find_first_not_of(" \t");
+    if (first == std::string_view::npos) return {};
+    size_t last = text.find_last_not_of(" \t\r");
+    return text.substr(first, last - first + 1);
+}
+
+MachineInstruction decodeLine(std::string_view line) {
+    MachineInstruction inst;
+    std::string_view text = trim(line);
+    bool indented = !line.empty() && (line[0] == ' ' || line[0] == '\t');
+    bool comment = !text.empty() && (text[0] == '#' || text.substr(0, 2) == "//");
+    if (!indented && !comment && !text.empty() && text.back() == ':') {
+        inst.kind = MachineInstruction::Kind::LABEL;
+        inst.mnemonic = text.substr(0, text.size() - 1);
+        return inst;
+    }
+    if (text.empty() || comment || text[0] == '.') {
+        inst.kind = MachineInstruction::Kind::OTHER;
+        inst.mnemonic = line;
+        return inst;
+    }
+    size_t space = text.find_first_of(" \t");
+    inst.mnemonic = text.substr(0, space);
+    if (space == std::string_view::npos) return inst;
+    std::string_view rest = text.substr(space + 1);
+    int depth = 0;
+    size_t start = 0;
+    for (size_t i = 0; i <= rest.size(); ++i) {
+        if (i == rest.size() || (rest[i] == ',' && depth == 0)) {
+            inst.operands.emplace_back(trim(rest.substr(start, i - start)));
+            start = i + 1;
+        } else if (rest[i] == '[') {
+            ++depth;
+        } else if (rest[i] == ']') {
+            --depth;
+        }
+    }
+    return inst;
+}
+
+} // namespace
+
+std::vector<MachineInstruction> decodeMachineCode(std::string_view assembly) {
+    std::vector<MachineInstruction> code;
+    while (!assembly.empty()) {
+        size_t end = assembly.find('\n');
+        std::string_view line = assembly.substr(0, end);
+        code.push_back(decodeLine(line));
+        assembly.remove_prefix(end == std::string_view::npos ? assembly.size() : end + 1);
+    }
+    return code;
+}
+
+void printMachineCode(const std::vector<MachineInstruction>& code, OutputBuffer& out) {
+    for (const MachineInstruction& inst : code) {
+        switch (inst.kind) {
+            case MachineInstruction::Kind::LABEL:
+                out << inst.mnemonic << ":\n";
+                break;
+            case MachineInstruction::Kind::OTHER:
+                out << inst.mnemonic << "\n";
+                break;
+            case MachineInstruction::Kind::INSTRUCTION:
+                if (inst.removed) break;
+                out << "    " << inst.mnemonic;
+                for (size_t i = 0; i < inst.operands.size(); ++i) {
+                    out << (i == 0 ? " " : ", ") << inst.operands[i];
+                }
+                out << "\n";
+                break;
+        }
+    }
+}
+
+PeepholeStats& PeepholeStats::operator+=(const PeepholeStats& other) {
+    instructions += other.instructions;
+    removed += other.removed;
+    redundantMoves += other.redundantMoves;
+    foldedImmediates += other.foldedImmediates;
+    memoryCombined += other.memoryCombined;
+    shorterForms += other.shorterForms;
+    deadWrites += other.deadWrites;
+    return *this;
+}
+
+std::string PeepholeStats::format() const {
+    std::ostringstream out;
+    out << "  Peephole: removed " << removed << " of " << instructions << " instructions ("
+        << redundantMoves << " redundant moves, " << foldedImmediates << " folded immediates, "
+        << memoryCombined << " memory operands combined, " << deadWrites << " dead writes), "
+        << shorterForms << " shorter forms\n";
+    return out.str();
+}
+
+std::vector<uint64_t> liveAfter(const std::vector<MachineInstruction>& code,
+                                const std::vector<RegisterEffects>& effects, uint64_t unknownLive) {
+    // Blocks as [first, last) ranges of `code`
+    struct Block {
+        size_t first = 0, last = 0;
+        uint64_t gen = 0, kill = 0, liveIn = 0, liveOut = 0;
+        std::vector<size_t> successors;
+        bool exits = false; // Branches to a label outside the function
+    };
+    std::vector<Block> blocks;
+    std::unordered_map<std::string_view, size_t> labels;
+    size_t start = 0;
+    auto close = [&](size_t last) {
+        if (last > start) {
+            blocks.emplace_back();
+            blocks.back().first = start;
+            blocks.back().last = last;
+        }
+        start = last;
+    };
+    for (size_t i = 0; i < code.size(); ++i) {
+        if (code[i].kind == MachineInstruction::Kind::LABEL) {
+            close(i);
+            labels[code[i].mnemonic] = blocks.size();
+        } else if (code[i].isInstruction() && (effects[i].branches || !effects[i].fallsThrough)) {
+            close(i + 1);
+        }
+    }
+    close(code.size());
+
+    for (size_t b = 0; b < blocks.size(); ++b) {
+        Block& block = blocks[b];
+        bool fallsThrough = true;
+        for (size_t i = block.last; i-- > block.first;) {
+            if (!code[i].isInstruction()) continue;
+            const RegisterEffects& e = effects[i];
+            block.gen = e.uses | (block.gen & ~e.defs);
+            block.kill |= e.defs;
+        }
+        for (size_t i = block.last; i-- > block.first;) {
+            if (!code[i].isInstruction()) continue;
+            const RegisterEffects& e = effects[i];
+            fallsThrough = e.fallsThrough;
+            if (e.branches) {
+                auto it = labels.find(e.target);
+                if (it == labels.end()) {
+                    block.exits = true;
+                } else {
+                    block.successors.push_back(it->second);
+                }
+            }
+            break;
+        }
+        if (fallsThrough && b + 1 < blocks.size()) {
+            block.successors.push_back(b + 1);
+        } else if (fallsThrough) {
+            block.exits = true; // Runs off the end into whatever follows
+        }
+    }
+
+    // Backward dataflow to a fixed point; visiting blocks last to first
+    // settles straight-line code and loops in a few passes
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t b = blocks.size(); b-- > 0;) {
+            Block& block = blocks[b];
+            uint64_t out = block.exits ? unknownLive : 0;
+            for (size_t s : block.successors) {
+                out |= blocks[s].liveIn;
+            }
+            uint64_t in = block.gen | (out & ~block.kill);
+            if (out != block.liveOut || in != block.liveIn) {
+                block.liveOut = out;
+                block.liveIn = in;
+                changed = true;
+            }
+        }
+    }
+
+    std::vector<uint64_t> live(code.size(), 0);
+    for (const Block& block : blocks) {
+        uint64_t current = block.liveOut;
+        for (size_t i = block.last; i-- > block.first;) {
+            live[i] = current;
+            if (code[i].isInstruction()) {
+                current = effects[i].uses | (current & ~effects[i].defs);
+            }
+        }
+    }
+    return live;
+}
+
+size_t removeDeadWrites(std::vector<MachineInstruction>& code,
+                        const std::vector<RegisterEffects>& effects, const std::vector<uint64_t>& live) {
+    size_t removed = 0;
+    for (size_t i = 0; i < code.size(); ++i) {
+        if (code[i].isInstruction() && effects[i].pure && (effects[i].defs & live[i]) == 0) {
+            code[i].removed = true;
+            ++removed;
+        }
+    }
+    return removed;
+}
+
+} // namespace syclang
@@ -0,0 +1,901 @@
+#include "syclang/codegen/x64/x64_assembler.h"
+#include <charconv>
+#include <initializer_list>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace syclang {
+
+namespace {
+
+struct Register {
+    int number; // Encoding order: rax, rcx, rdx, rbx, rsp, rbp, rsi, rdi, r8-r15
+    int size;   // Bytes: 1, 2, 4 or 8; 16 for xmm, 32 for ymm
+};
+
+const std::unordered_map<std::string_view, Register>& registerTable() {
+    static const std::unordered_map<std::string_view, Register> table = [] {
+        static const char* const gpr[4][16] = {
+            {"rax", "rcx", "rdx", "rbx", "rsp", "rbp", "rsi", "rdi",
+             "r8", "r9", "r10", "r11", "r12", "r13", "r14", "r15"},
+            {"eax", "ecx", "edx", "ebx", "esp", "ebp", "esi", "edi",
+             "r8d", "r9d", "r10d", "r11d", "r12d", "r13d", "r14d", "r15d"},
+            {"ax", "cx", "dx", "bx", "sp", "bp", "si", "di",
+             "r8w", "r9w", "r10w", "r11w", "r12w", "r13w", "r14w", "r15w"},
+            {"al", "cl", "dl", "bl", "spl", "bpl", "sil", "dil",
+             "r8b", "r9b", "r10b", "r11b", "r12b", "r13b", "r14b", "r15b"}};
+        static const char* const vector[2][16] = {
+            {"xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5", "xmm6", "xmm7",
+             "xmm8", "xmm9", "xmm10", "xmm11", "xmm12", "xmm13", "xmm14", "xmm15"},
+            {"ymm0", "ymm1", "ymm2", "ymm3", "ymm4", "ymm5", "ymm6", "ymm7",
+             "ymm8", "ymm9", "ymm10", "ymm11", "ymm12", "ymm13", "ymm14", "ymm15"}};
+        const int sizes[4] = {8, 4, 2, 1};
+        std::unordered_map<std::string_view, Register> names;
+        for (int n = 0; n < 16; ++n) {
+            for (int s = 0; s < 4; ++s) names.emplace(gpr[s][n], Register{n, sizes[s]});
+            names.emplace(vector[0][n], Register{n, 16});
+            names.emplace(vector[1][n], Register{n, 32});
+        }
+        return names;
+    }();
+    return table;
+}
+
+const std::unordered_map<std::string_view, int>& conditionTable() {
+    static const std::unordered_map<std::string_view, int> table = {
+        {"o", 0}, {"no", 1}, {"b", 2}, {"c", 2}, {"nae", 2}, {"ae", 3}, {"nb", 3}, {"nc", 3},
+        {"e", 4}, {"z", 4}, {"ne", 5}, {"nz", 5}, {"be", 6}, {"na", 6}, {"a", 7}, {"nbe", 7},
+        {"s", 8}, {"ns", 9}, {"p", 10}, {"pe", 10}, {"np", 11}, {"po", 11},
+        {"l", 12}, {"nge", 12}, {"ge", 13}, {"nl", 13}, {"le", 14}, {"ng", 14}, {"g", 15}, {"nle", 15}};
+    return table;
+}
+
+// ALU operations sharing the 00-3F opcode block, by their /digit
+const std::unordered_map<std::string_view, int>& aluTable() {
+    static const std::unordered_map<std::string_view, int> table = {
+        {"add", 0}, {"or", 1}, {"adc", 2}, {"sbb", 3}, {"and", 4}, {"sub", 5}, {"xor", 6}, {"cmp", 7}};
+    return table;
+}
+
+// Packed-integer operations of the form xmm, xmm/m128; the AVX forms
+// take a "v" prefix and a second source
+struct PackedOp {
+    uint8_t prefix; // Mandatory prefix (66, F2, F3) or 0
+    int map;        // 1: 0F, 2: 0F 38
+    uint8_t opcode;
+};
+
+const std::unordered_map<std::string_view, PackedOp>& packedTable() {
+    static const std::unordered_map<std::string_view, PackedOp> table = {
+        {"paddb", {0x66, 1, 0xFC}}, {"paddw", {0x66, 1, 0xFD}}, {"paddd", {0x66, 1, 0xFE}},
+        {"paddq", {0x66, 1, 0xD4}}, {"psubb", {0x66, 1, 0xF8}}, {"psubw", {0x66, 1, 0xF9}},
+        {"psubd", {0x66, 1, 0xFA}}, {"psubq", {0x66, 1, 0xFB}}, {"pmullw", {0x66, 1, 0xD5}},
+        {"pmulld", {0x66, 2, 0x40}}, {"pand", {0x66, 1, 0xDB}}, {"pandn", {0x66, 1, 0xDF}},
+        {"por", {0x66, 1, 0xEB}}, {"pxor", {0x66, 1, 0xEF}}, {"pcmpeqb", {0x66, 1, 0x74}},
+        {"pcmpeqw", {0x66, 1, 0x75}}, {"pcmpeqd", {0x66, 1, 0x76}},
+        {"punpcklbw", {0x66, 1, 0x60}}, {"punpcklwd", {0x66, 1, 0x61}},
+        {"punpckldq", {0x66, 1, 0x62}}, {"punpcklqdq", {0x66, 1, 0x6C}}};
+    return table;
+}
+
+// Packed shifts by an immediate: opcode and /digit
+const std::unordered_map<std::string_view, std::pair<uint8_t, int>>& packedShiftTable() {
+    static const std::unordered_map<std::string_view, std::pair<uint8_t, int>> table = {
+        {"psllw", {0x71, 6}}, {"pslld", {0x72, 6}}, {"psllq", {0x73, 6}},
+        {"psrlw", {0x71, 2}}, {"psrld", {0x72, 2}}, {"psrlq", {0x73, 2}},
+        {"psraw", {0x71, 4}}, {"psrad", {0x72, 4}}};
+    return table;
+}
+
+struct Operand {
+    enum class Kind { REGISTER, IMMEDIATE, MEMORY, SYMBOL } kind = Kind::IMMEDIATE;
+    Register reg{0, 0};
+    int64_t imm = 0;
+    int size = 0;     // Memory: bytes its "ptr" names, 0 when unsized
+    int base = -1;
+    int index = -1;
+    int scale = 1;
+    int64_t disp = 0;
+    bool rip = false;
+    std::string_view symbol; // rip-relative symbol, or a branch or call target
+
+    bool isRegister() const { return kind == Kind::REGISTER; }
+    bool isGeneral() const { return kind == Kind::REGISTER && reg.size <= 8; }
+    bool isVector() const { return kind == Kind::REGISTER && reg.size >= 16; }
+    bool isMemory() const { return kind == Kind::MEMORY; }
+    bool isImmediate() const { return kind == Kind::IMMEDIATE; }
+    int bytes() const { return kind == Kind::REGISTER ? reg.size : size; }
+    // spl, bpl, sil and dil need a REX prefix, even an empty one
+    bool needsRex() const { return isGeneral() && reg.size == 1 && reg.number >= 4 && reg.number < 8; }
+};
+
+bool fitsInt8(int64_t value) { return value >= -128 && value <= 127; }
+bool fitsInt32(int64_t value) { return value >= INT32_MIN && value <= INT32_MAX; }
+
+std::string_view trim(std::string_view text) {
+    size_t first = text.find_first_not_of(" \t\r");
+    if (first == std::string_view::npos) return {};
+    size_t last = text.find_last_not_of(" \t\r");
+    return text.substr(first, last - first + 1);
+}
+
+bool parseInteger(std::string_view text, int64_t& value) {
+    if (text.empty()) return false;
+    auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+    return error == std::errc() && end == text.data() + text.size();
+}
+
+const Register* findRegister(std::string_view name) {
+    const auto& table = registerTable();
+    auto it = table.find(name);
+    return it == table.end() ? nullptr : &it->second;
+}
+
+// A position in the text. Branches are sized only once every label is
+// known, so positions count the bytes before them without the branches.
+struct Mark {
+    size_t position;
+    size_t branches; // Branches emitted before this position
+};
+
+struct Branch {
+    Mark at;
+    int condition; // Condition code, or -1 for jmp
+    std::string_view label;
+    bool wide = false;
+};
+
+struct Definition {
+    std::string_view name;
+    Section section;
+    Mark mark;
+};
+
+struct PendingRelocation {
+    Section section;
+    Mark mark;
+    std::string_view symbol;
+    RelocationType type;
+    int64_t addend;
+};
+
+class Assembler {
+public:
+    ObjectCode run(std::string_view assembly);
+
+private:
+    std::string_view line_;
+    Section section_ = Section::TEXT;
+    std::vector<uint8_t> text_;
+    std::vector<uint8_t> data_;
+    std::vector<Branch> branches_;
+    std::vector<Definition> definitions_;
+    std::unordered_map<std::string_view, Mark> textLabels_;
+    std::unordered_set<std::string_view> globals_;
+    std::vector<PendingRelocation> relocations_;
+
+    [[noreturn]] void fail(const std::string& reason) const {
+        throw std::runtime_error("x64 assembler: cannot assemble '" + std::string(line_) + "': " + reason);
+    }
+
+    std::vector<uint8_t>& out() { return section_ == Section::TEXT ? text_ : data_; }
+    Mark mark() { return {out().size(), section_ == Section::TEXT ? branches_.size() : 0}; }
+    void byte(uint8_t value) { out().push_back(value); }
+    void immediate(int64_t value, int bytes) {
+        for (int i = 0; i < bytes; ++i) byte(static_cast<uint8_t>(static_cast<uint64_t>(value) >> (8 * i)));
+    }
+    void relocate(std::string_view symbol, RelocationType type, int64_t addend) {
+        relocations_.push_back({section_, mark(), symbol, type, addend});
+    }
+
+    void statement(std::string_view line);
+    void directive(std::string_view line);
+    Operand parseOperand(std::string_view text);
+    void parseAddress(std::string_view text, Operand& op);
+
+    void rex(bool w, int reg, const Operand& rm, bool force);
+    void vex(int pp, int map, bool w, bool wide, int reg, int vvvv, const Operand& rm);
+    void modrm(int reg, const Operand& rm, int immediateBytes);
+    void encode(uint8_t prefix, bool w, std::initializer_list<uint8_t> opcode, int reg,
+                const Operand& rm, int immediateBytes = 0, bool forceRex = false);
+
+    void instruction(std::string_view mnemonic, Operand* ops, size_t count);
+    bool integerInstruction(std::string_view mnemonic, Operand* ops, size_t count);
+    bool vectorInstruction(std::string_view mnemonic, Operand* ops, size_t count);
+    void alu(int operation, Operand& dst, const Operand& src);
+    void move(Operand& dst, const Operand& src);
+
+    std::vector<uint8_t> layoutText(std::vector<size_t>& shift);
+};
+
+void Assembler::statement(std::string_view line) {
+    line_ = line;
+    if (line.empty() || line[0] == '#') return;
+    if (line[0] == '.') {
+        directive(line);
+        return;
+    }
+    if (line.back() == ':') {
+        std::string_view name = line.substr(0, line.size() - 1);
+        Mark at = mark();
+        if (section_ == Section::TEXT && !textLabels_.emplace(name, at).second) {
+            fail("label defined twice");
+        }
+        definitions_.push_back({name, section_, at});
+        return;
+    }
+
+    size_t space = line.find_first_of(" \t");
+    std::string_view mnemonic = line.substr(0, space);
+    Operand ops[4];
+    size_t count = 0;
+    if (space != std::string_view::npos) {
+        std::string_view rest = line.substr(space + 1);
+        while (!rest.empty()) {
+            if (count == 4) fail("too many operands");
+            size_t comma = rest.find(',');
+            ops[count++] = parseOperand(trim(rest.substr(0, comma)));
+            if (comma == std::string_view::npos) break;
+            rest = rest.substr(comma + 1);
+        }
+    }
+    if (section_ != Section::TEXT) fail("instruction outside .text");
+    instruction(mnemonic, ops, count);
+}
+
+void Assembler::directive(std::string_view line) {
+    size_t space = line.find_first_of(" \t");
+    std::string_view name = line.substr(0, space);
+    std::string_view argument = space == std::string_view::npos ? std::string_view() : trim(line.substr(space));
+    if (name == ".intel_syntax") return;
+    if (name == ".section" || name == ".text" || name == ".data") {
+        std::string_view target = name == ".section" ? argument : name;
+        if (target == ".text") {
+            section_ = Section::TEXT;
+        } else if (target == ".data") {
+            section_ = Section::DATA;
+        } else {
+            fail("unknown section");
+        }
+    } else if (name == ".global" || name == ".globl") {
+        globals_.insert(argument);
+    } else if (name == ".zero") {
+        int64_t size = 0;
+        if (!parseInteger(argument, size) || size < 0) fail("bad size");
+        if (section_ == Section::DATA) {
+            data_.resize(data_.size() + static_cast<size_t>(size));
+        } else {
+            for (int64_t i = 0; i < size; ++i) byte(0);
+        }
+    } else {
+        fail("unknown directive");
+    }
+}
+
+Operand Assembler::parseOperand(std::string_view text) {
+    static const std::pair<std::string_view, int> SIZES[] = {
+        {"byte ptr ", 1}, {"word ptr ", 2}, {"dword ptr ", 4}, {"qword ptr ", 8},
+        {"xmmword ptr ", 16}, {"ymmword ptr ", 32}};
+    Operand op;
+    for (const auto& [prefix, size] : SIZES) {
+        if (text.substr(0, prefix.size()) == prefix) {
+            op.size = size;
+            text = trim(text.substr(prefix.size()));
+            break;
+        }
+    }
+    if (!text.empty() && text[0] == '[') {
+        if (text.back() != ']') fail("unterminated address");
+        op.kind = Operand::Kind::MEMORY;
+        parseAddress(text.substr(1, text.size() - 2), op);
+        return op;
+    }
+    if (op.size) fail("size given for a non-memory operand");
+    if (const Register* reg = findRegister(text)) {
+        op.kind = Operand::Kind::REGISTER;
+        op.reg = *reg;
+    } else if (parseInteger(text, op.imm)) {
+        op.kind = Operand::Kind::IMMEDIATE;
+    } else if (!text.empty()) {
+        op.kind = Operand::Kind::SYMBOL;
+        op.symbol = text;
+    } else {
+        fail("empty operand");
+    }
+    return op;
+}
+
+// base + index*scale + displacement, or rip + symbol
+void Assembler::parseAddress(std::string_view text, Operand& op) {
+    int sign = 1;
+    size_t i = 0;
+    while (i < text.size()) {
+        char c = text[i];
+        if (c == ' ' || c == '\t') {
+            ++i;
+            continue;
+        }
+        if (c == '+' || c == '-') {
+            sign = c == '-' ? -1 : 1;
+            ++i;
+            continue;
+        }
+        size_t end = text.find_first_of(" \t+-", i);
+        std::string_view term = text.substr(i, end == std::string_view::npos ? std::string_view::npos : end - i);
+        i = end == std::string_view::npos ? text.size() : end;
+
+        int64_t value = 0;
+        size_t star = term.find('*');
+        if (star != std::string_view::npos) {
+            const Register* reg = findRegister(term.substr(0, star));
+            int64_t scale = 0;
+            if (!reg || reg->size != 8 || !parseInteger(term.substr(star + 1), scale) ||
+                (scale != 1 && scale != 2 && scale != 4 && scale != 8) || op.index >= 0 || sign < 0) {
+                fail("bad index");
+            }
+            op.index = reg->number;
+            op.scale = static_cast<int>(scale);
+        } else if (term == "rip") {
+            op.rip = true;
+        } else if (const Register* reg = findRegister(term)) {
+            if (reg->size != 8 || sign < 0) fail("bad address register");
+            if (op.base < 0) {
+                op.base = reg->number;
+            } else if (op.index < 0) {
+                op.index = reg->number;
+            } else {
+                fail("too many address registers");
+            }
+        } else if (parseInteger(term, value)) {
+            op.disp += sign * value;
+        } else {
+            if (!op.symbol.empty() || sign < 0) fail("bad symbol reference");
+            op.symbol = term;
+        }
+        sign = 1;
+    }
+    if (op.rip ? op.base >= 0 || op.index >= 0 : op.base < 0 || !op.symbol.empty()) {
+        fail("unsupported addressing mode");
+    }
+    if (op.index == 4) fail("rsp cannot be an index");
+    if (!fitsInt32(op.disp)) fail("displacement out of range");
+}
+
+void Assembler::rex(bool w, int reg, const Operand& rm, bool force) {
+    int r = reg >> 3 & 1;
+    int x = 0;
+    int b = 0;
+    if (rm.isRegister()) {
+        b = rm.reg.number >> 3 & 1;
+    } else if (rm.isMemory()) {
+        x = rm.index >= 0 ? rm.index >> 3 & 1 : 0;
+        b = rm.base >= 0 ? rm.base >> 3 & 1 : 0;
+    }
+    if (w || r || x || b || force) {
+        byte(static_cast<uint8_t>(0x40 | w << 3 | r << 2 | x << 1 | b));
+    }
+}
+
+// The two-byte form when the map is 0F and no W, X or B bit is needed,
+// as GNU as chooses
+void Assembler::vex(int pp, int map, bool w, bool wide, int reg, int vvvv, const Operand& rm) {
+    int r = reg >> 3 & 1;
+    int x = rm.isMemory() && rm.index >= 0 ? rm.index >> 3 & 1 : 0;
+    int b = rm.isRegister() ? rm.reg.number >> 3 & 1 : rm.isMemory() && rm.base >= 0 ? rm.base >> 3 & 1 : 0;
+    int tail = (~vvvv & 15) << 3 | (wide ? 4 : 0) | pp;
+    if (map == 1 && !w && !x && !b) {
+        byte(0xC5);
+        byte(static_cast<uint8_t>((!r) << 7 | tail));
+        return;
+    }
+    byte(0xC4);
+    byte(static_cast<uint8_t>((!r) << 7 | (!x) << 6 | (!b) << 5 | map));
+    byte(static_cast<uint8_t>(w << 7 | tail));
+}
+
+void Assembler::modrm(int reg, const Operand& rm, int immediateBytes) {
+    int field = (reg & 7) << 3;
+    if (rm.isRegister()) {
+        byte(static_cast<uint8_t>(0xC0 | field | (rm.reg.number & 7)));
+        return;
+    }
+    if (!rm.isMemory()) fail("expected a register or memory operand");
+    if (rm.rip) {
+        byte(static_cast<uint8_t>(0x05 | field));
+        if (rm.symbol.empty()) {
+            immediate(rm.disp, 4);
+            return;
+        }
+        // The field is 4 bytes before the end of the instruction, less
+        // any immediate that follows it
+        relocate(rm.symbol, RelocationType::PC32, rm.disp - 4 - immediateBytes);
+        immediate(0, 4);
+        return;
+    }
+    bool sib = rm.index >= 0 || (rm.base & 7) == 4;
+    int mod = rm.disp == 0 && (rm.base & 7) != 5 ? 0 : fitsInt8(rm.disp) ? 1 : 2;
+    byte(static_cast<uint8_t>(mod << 6 | field | (sib ? 4 : rm.base & 7)));
+    if (sib) {
+        int scale = rm.scale == 8 ? 3 : rm.scale == 4 ? 2 : rm.scale == 2 ? 1 : 0;
+        int index = rm.index >= 0 ? rm.index & 7 : 4;
+        byte(static_cast<uint8_t>(scale << 6 | index << 3 | (rm.base & 7)));
+    }
+    immediate(rm.disp, mod == 1 ? 1 : mod == 2 ? 4 : 0);
+}
+
+void Assembler::encode(uint8_t prefix, bool w, std::initializer_list<uint8_t> opcode, int reg,
+                       const Operand& rm, int immediateBytes, bool forceRex) {
+    if (prefix) byte(prefix);
+    rex(w, reg, rm, forceRex || rm.needsRex());
+    for (uint8_t value : opcode) byte(value);
+    modrm(reg, rm, immediateBytes);
+}
+
+void Assembler::instruction(std::string_view mnemonic, Operand* ops, size_t count) {
+    if (integerInstruction(mnemonic, ops, count)) return;
+    if (vectorInstruction(mnemonic, ops, count)) return;
+    fail("unknown instruction");
+}
+
+void Assembler::alu(int operation, Operand& dst, const Operand& src) {
+    int size = dst.bytes() ? dst.bytes() : src.bytes();
+    if (!size || size > 8) fail("operand size");
+    uint8_t prefix = size == 2 ? 0x66 : 0;
+    bool w = size == 8;
+    int wordOp = size == 1 ? 0 : 1;
+    if (src.isImmediate()) {
+        if (size == 8 && !fitsInt32(src.imm)) fail("immediate out of range");
+        int immBytes = size == 2 ? 2 : 4;
+        if (size == 1) {
+            encode(prefix, w, {0x80}, operation, dst, 1);
+            immediate(src.imm, 1);
+        } else if (fitsInt8(src.imm)) {
+            encode(prefix, w, {0x83}, operation, dst, 1);
+            immediate(src.imm, 1);
+        } else if (dst.isGeneral() && dst.reg.number == 0) {
+            // Accumulator short form
+            if (prefix) byte(prefix);
+            rex(w, 0, dst, false);
+            byte(static_cast<uint8_t>(operation << 3 | 5));
+            immediate(src.imm, immBytes);
+        } else {
+            encode(prefix, w, {0x81}, operation, dst, immBytes);
+            immediate(src.imm, immBytes);
+        }
+    } else if (src.isGeneral()) {
+        if (dst.isRegister() && dst.bytes() != src.bytes()) fail("operand sizes differ");
+        encode(prefix, w, {static_cast<uint8_t>(operation << 3 | wordOp)}, src.reg.number, dst, 0,
+               src.needsRex());
+    } else if (dst.isGeneral() && src.isMemory()) {
+        encode(prefix, w, {static_cast<uint8_t>(operation << 3 | 2 | wordOp)}, dst.reg.number, src);
+    } else {
+        fail("bad operands");
+    }
+}
+
+void Assembler::move(Operand& dst, const Operand& src) {
+    int size = dst.bytes() ? dst.bytes() : src.bytes();
+    if (!size || size > 8) fail("operand size");
+    uint8_t prefix = size == 2 ? 0x66 : 0;
+    bool w = size == 8;
+    if (src.isGeneral()) {
+        if (dst.isRegister() && dst.bytes() != src.bytes()) fail("operand sizes differ");
+        encode(prefix, w, {static_cast<uint8_t>(size == 1 ? 0x88 : 0x89)}, src.reg.number, dst, 0,
+               src.needsRex());
+    } else if (dst.isGeneral() && src.isMemory()) {
+        encode(prefix, w, {static_cast<uint8_t>(size == 1 ? 0x8A : 0x8B)}, dst.reg.number, src);
+    } else if (dst.isGeneral() && src.isImmediate()) {
+        if (size == 8 && fitsInt32(src.imm)) {
+            encode(0, true, {0xC7}, 0, dst, 4);
+            immediate(src.imm, 4);
+            return;
+        }
+        // B8+r with an immediate as wide as the register (movabs for 64 bits)
+        if (prefix) byte(prefix);
+        rex(w, 0, dst, dst.needsRex());
+        byte(static_cast<uint8_t>((size == 1 ? 0xB0 : 0xB8) | (dst.reg.number & 7)));
+        immediate(src.imm, size);
+    } else if (dst.isMemory() && src.isImmediate()) {
+        if (size == 8 && !fitsInt32(src.imm)) fail("immediate out of range");
+        int immBytes = size == 8 ? 4 : size;
+        encode(prefix, w, {static_cast<uint8_t>(size == 1 ? 0xC6 : 0xC7)}, 0, dst, immBytes);
+        immediate(src.imm, immBytes);
+    } else {
+        fail("bad operands");
+    }
+}
+
+bool Assembler::integerInstruction(std::string_view mnemonic, Operand* ops, size_t count) {
+    auto expect = [&](size_t n) {
+        if (count != n) fail("expected " + std::to_string(n) + " operands");
+    };
+    auto sizeOf = [&](const Operand& op) {
+        int size = op.bytes();
+        if (!size || size > 8) fail("operand size");
+        return size;
+    };
+
+    static const std::unordered_map<std::string_view, std::vector<uint8_t>> NO_OPERANDS = {
+        {"ret", {0xC3}}, {"leave", {0xC9}}, {"cqo", {0x48, 0x99}}, {"cdq", {0x99}},
+        {"nop", {0x90}}, {"int3", {0xCC}}, {"ud2", {0x0F, 0x0B}}, {"syscall", {0x0F, 0x05}},
+        {"vzeroupper", {0xC5, 0xF8, 0x77}}};
+    if (auto it = NO_OPERANDS.find(mnemonic); it != NO_OPERANDS.end()) {
+        expect(0);
+        for (uint8_t value : it->second) byte(value);
+        return true;
+    }
+
+    if (auto it = aluTable().find(mnemonic); it != aluTable().end()) {
+        expect(2);
+        alu(it->second, ops[0], ops[1]);
+        return true;
+    }
+    if (mnemonic == "mov") {
+        expect(2);
+        move(ops[0], ops[1]);
+        return true;
+    }
+    if (mnemonic == "test") {
+        expect(2);
+        if (!ops[1].isGeneral() || (ops[0].isRegister() && ops[0].bytes() != ops[1].bytes())) {
+            fail("bad operands");
+        }
+        int size = ops[1].bytes();
+        encode(size == 2 ? 0x66 : 0, size == 8, {static_cast<uint8_t>(size == 1 ? 0x84 : 0x85)},
+               ops[1].reg.number, ops[0], 0, ops[1].needsRex());
+        return true;
+    }
+    if (mnemonic == "push" || mnemonic == "pop") {
+        expect(1);
+        bool push = mnemonic == "push";
+        if (ops[0].isGeneral()) {
+            if (ops[0].reg.size != 8) fail("operand size");
+            if (ops[0].reg.number >= 8) byte(0x41);
+            byte(static_cast<uint8_t>((push ? 0x50 : 0x58) | (ops[0].reg.number & 7)));
+        } else if (push && ops[0].isImmediate()) {
+            if (!fitsInt32(ops[0].imm)) fail("immediate out of range");
+            byte(fitsInt8(ops[0].imm) ? 0x6A : 0x68);
+            immediate(ops[0].imm, fitsInt8(ops[0].imm) ? 1 : 4);
+        } else if (ops[0].isMemory()) {
+            if (push) {
+                encode(0, false, {0xFF}, 6, ops[0]);
+            } else {
+                encode(0, false, {0x8F}, 0, ops[0]);
+            }
+        } else {
+            fail("bad operand");
+        }
+        return true;
+    }
+    if (mnemonic == "lea") {
+        expect(2);
+        if (!ops[0].isGeneral() || !ops[1].isMemory()) fail("bad operands");
+        int size = sizeOf(ops[0]);
+        encode(size == 2 ? 0x66 : 0, size == 8, {0x8D}, ops[0].reg.number, ops[1]);
+        return true;
+    }
+    if (mnemonic == "movsx" || mnemonic == "movzx") {
+        expect(2);
+        int from = sizeOf(ops[1]);
+        if (!ops[0].isGeneral() || from > 2) fail("bad operands");
+        int size = sizeOf(ops[0]);
+        uint8_t opcode = static_cast<uint8_t>((mnemonic == "movsx" ? 0xBE : 0xB6) + (from == 2 ? 1 : 0));
+        encode(size == 2 ? 0x66 : 0, size == 8, {0x0F, opcode}, ops[0].reg.number, ops[1]);
+        return true;
+    }
+    if (mnemonic == "movsxd") {
+        expect(2);
+        if (!ops[0].isGeneral() || sizeOf(ops[0]) != 8 || sizeOf(ops[1]) != 4) fail("bad operands");
+        encode(0, true, {0x63}, ops[0].reg.number, ops[1]);
+        return true;
+    }
+    if (mnemonic == "imul" && count >= 2) {
+        // imul r, r/m and imul r, r/m, imm (imul r, imm means imul r, r, imm)
+        const Operand* factor = count == 3 ? &ops[2] : ops[1].isImmediate() ? &ops[1] : nullptr;
+        const Operand& source = count == 2 && factor ? ops[0] : ops[1];
+        if (!ops[0].isGeneral()) fail("bad operands");
+        int size = sizeOf(ops[0]);
+        uint8_t prefix = size == 2 ? 0x66 : 0;
+        if (!factor) {
+            encode(prefix, size == 8, {0x0F, 0xAF}, ops[0].reg.number, source);
+        } else if (!factor->isImmediate() || !fitsInt32(factor->imm)) {
+            fail("bad operands");
+        } else if (fitsInt8(factor->imm)) {
+            encode(prefix, size == 8, {0x6B}, ops[0].reg.number, source, 1);
+            immediate(factor->imm, 1);
+        } else {
+            int immBytes = size == 2 ? 2 : 4;
+            encode(prefix, size == 8, {0x69}, ops[0].reg.number, source, immBytes);
+            immediate(factor->imm, immBytes);
+        }
+        return true;
+    }
+
+    static const std::unordered_map<std::string_view, int> UNARY = {
+        {"not", 2}, {"neg", 3}, {"mul", 4}, {"imul", 5}, {"div", 6}, {"idiv", 7}};
+    if (auto it = UNARY.find(mnemonic); it != UNARY.end()) {
+        expect(1);
+        int size = sizeOf(ops[0]);
+        encode(size == 2 ? 0x66 : 0, size == 8, {static_cast<uint8_t>(size == 1 ? 0xF6 : 0xF7)}, it->second,
+               ops[0]);
+        return true;
+    }
+
+    static const std::unordered_map<std::string_view, int> SHIFTS = {
+        {"rol", 0}, {"ror", 1}, {"shl", 4}, {"sal", 4}, {"shr", 5}, {"sar", 7}};
+    if (auto it = SHIFTS.find(mnemonic); it != SHIFTS.end()) {
+        expect(2);
+        int size = sizeOf(ops[0]);
+        uint8_t prefix = size == 2 ? 0x66 : 0;
+        uint8_t wordOp = size == 1 ? 0 : 1;
+        if (ops[1].isImmediate() && ops[1].imm == 1) {
+            encode(prefix, size == 8, {static_cast<uint8_t>(0xD0 | wordOp)}, it->second, ops[0]);
+        } else if (ops[1].isImmediate()) {
+            encode(prefix, size == 8, {static_cast<uint8_t>(0xC0 | wordOp)}, it->second, ops[0], 1);
+            immediate(ops[1].imm, 1);
+        } else if (ops[1].isGeneral() && ops[1].reg.number == 1 && ops[1].reg.size == 1) {
+            encode(prefix, size == 8, {static_cast<uint8_t>(0xD2 | wordOp)}, it->second, ops[0]);
+        } else {
+            fail("shift count must be an immediate or cl");
+        }
+        return true;
+    }
+
+    if (mnemonic == "call") {
+        expect(1);
+        if (ops[0].kind == Operand::Kind::SYMBOL) {
+            byte(0xE8);
+            relocate(ops[0].symbol, RelocationType::PLT32, -4);
+            immediate(0, 4);
+        } else {
+            encode(0, false, {0xFF}, 2, ops[0]);
+        }
+        return true;
+    }
+    if (mnemonic.size() >= 2 && mnemonic[0] == 'j') {
+        int condition = -1;
+        if (mnemonic != "jmp") {
+            auto it = conditionTable().find(mnemonic.substr(1));
+            if (it == conditionTable().end()) return false;
+            condition = it->second;
+        }
+        expect(1);
+        if (ops[0].kind == Operand::Kind::SYMBOL) {
+            branches_.push_back({mark(), condition, ops[0].symbol});
+        } else if (condition < 0) {
+            encode(0, false, {0xFF}, 4, ops[0]);
+        } else {
+            fail("conditional jump needs a label");
+        }
+        return true;
+    }
+    if (mnemonic.substr(0, 3) == "set") {
+        auto it = conditionTable().find(mnemonic.substr(3));
+        if (it == conditionTable().end()) return false;
+        expect(1);
+        if (sizeOf(ops[0]) != 1) fail("operand size");
+        encode(0, false, {0x0F, static_cast<uint8_t>(0x90 | it->second)}, 0, ops[0]);
+        return true;
+    }
+    return false;
+}
+
+bool Assembler::vectorInstruction(std::string_view mnemonic, Operand* ops, size_t count) {
+    bool avx = mnemonic.size() > 1 && mnemonic[0] == 'v';
+    std::string_view base = avx ? mnemonic.substr(1) : mnemonic;
+    auto vectorOperand = [&](const Operand& op) {
+        if (!op.isVector() && !op.isMemory()) fail("expected a vector register or memory");
+    };
+    auto pp = [](uint8_t prefix) { return prefix == 0x66 ? 1 : prefix == 0xF3 ? 2 : prefix == 0xF2 ? 3 : 0; };
+
+    if (auto it = packedTable().find(base); it != packedTable().end()) {
+        const PackedOp& op = it->second;
+        if (avx) {
+            if (count != 3 || !ops[0].isVector() || !ops[1].isVector()) fail("expected 3 operands");
+            vectorOperand(ops[2]);
+            vex(pp(op.prefix), op.map, false, ops[0].reg.size == 32, ops[0].reg.number, ops[1].reg.number, ops[2]);
+            byte(op.opcode);
+            modrm(ops[0].reg.number, ops[2], 0);
+        } else {
+            if (count != 2 || !ops[0].isVector() || ops[0].reg.size != 16) fail("expected xmm operands");
+            vectorOperand(ops[1]);
+            if (op.map == 2) {
+                encode(op.prefix, false, {0x0F, 0x38, op.opcode}, ops[0].reg.number, ops[1]);
+            } else {
+                encode(op.prefix, false, {0x0F, op.opcode}, ops[0].reg.number, ops[1]);
+            }
+        }
+        return true;
+    }
+
+    if (auto it = packedShiftTable().find(base); it != packedShiftTable().end()) {
+        auto [opcode, extension] = it->second;
+        const Operand& source = avx ? ops[1] : ops[0];
+        const Operand& amount = avx ? ops[2] : ops[1];
+        if (count != (avx ? 3u : 2u) || !ops[0].isVector() || !source.isVector() || !amount.isImmediate()) {
+            fail("bad operands");
+        }
+        if (avx) {
+            // The destination goes in VEX.vvvv, the source in ModRM.rm
+            vex(1, 1, false, ops[0].reg.size == 32, extension, ops[0].reg.number, source);
+            byte(opcode);
+            modrm(extension, source, 1);
+        } else {
+            encode(0x66, false, {0x0F, opcode}, extension, source, 1);
+        }
+        immediate(amount.imm, 1);
+        return true;
+    }
+
+    static const std::unordered_map<std::string_view, uint8_t> SHUFFLES = {
+        {"pshufd", 0x66}, {"pshuflw", 0xF2}, {"pshufhw", 0xF3}};
+    if (auto it = SHUFFLES.find(base); it != SHUFFLES.end()) {
+        if (count != 3 || !ops[0].isVector() || !ops[2].isImmediate()) fail("bad operands");
+        vectorOperand(ops[1]);
+        if (avx) {
+            vex(pp(it->second), 1, false, ops[0].reg.size == 32, ops[0].reg.number, 0, ops[1]);
+            byte(0x70);
+            modrm(ops[0].reg.number, ops[1], 1);
+        } else {
+            encode(it->second, false, {0x0F, 0x70}, ops[0].reg.number, ops[1], 1);
+        }
+        immediate(ops[2].imm, 1);
+        return true;
+    }
+
+    if (base == "movdqu" || base == "movdqa") {
+        if (count != 2) fail("expected 2 operands");
+        uint8_t prefix = base == "movdqu" ? 0xF3 : 0x66;
+        bool load = ops[0].isVector();
+        const Operand& reg = load ? ops[0] : ops[1];
+        const Operand& rm = load ? ops[1] : ops[0];
+        if (!reg.isVector()) fail("bad operands");
+        vectorOperand(rm);
+        uint8_t opcode = load ? 0x6F : 0x7F;
+        if (avx) {
+            vex(pp(prefix), 1, false, reg.reg.size == 32, reg.reg.number, 0, rm);
+            byte(opcode);
+            modrm(reg.reg.number, rm, 0);
+        } else {
+            encode(prefix, false, {0x0F, opcode}, reg.reg.number, rm);
+        }
+        return true;
+    }
+
+    if (base == "movq" || base == "movd") {
+        if (count != 2) fail("expected 2 operands");
+        bool w = base == "movq";
+        bool toVector = ops[0].isVector();
+        const Operand& vector = toVector ? ops[0] : ops[1];
+        const Operand& other = toVector ? ops[1] : ops[0];
+        if (!vector.isVector() || vector.reg.size != 16 || !(other.isGeneral() || other.isMemory())) {
+            fail("bad operands");
+        }
+        uint8_t opcode = toVector ? 0x6E : 0x7E;
+        if (avx) {
+            vex(1, 1, w, false, vector.reg.number, 0, other);
+            byte(opcode);
+            modrm(vector.reg.number, other, 0);
+        } else {
+            encode(0x66, w, {0x0F, opcode}, vector.reg.number, other);
+        }
+        return true;
+    }
+
+    static const std::unordered_map<std::string_view, uint8_t> BROADCASTS = {
+        {"vpbroadcastb", 0x78}, {"vpbroadcastw", 0x79}, {"vpbroadcastd", 0x58}, {"vpbroadcastq", 0x59}};
+    if (auto it = BROADCASTS.find(mnemonic); it != BROADCASTS.end()) {
+        if (count != 2 || !ops[0].isVector()) fail("bad operands");
+        if (!(ops[1].isVector() && ops[1].reg.size == 16) && !ops[1].isMemory()) fail("bad operands");
+        vex(1, 2, false, ops[0].reg.size == 32, ops[0].reg.number, 0, ops[1]);
+        byte(it->second);
+        modrm(ops[0].reg.number, ops[1], 0);
+        return true;
+    }
+    return false;
+}
+
+// Size every branch, then splice the branch bytes into the text. shift[k]
+// is the size of the first k branches.
+std::vector<uint8_t> Assembler::layoutText(std::vector<size_t>& shift) {
+    shift.assign(branches_.size() + 1, 0);
+    auto address = [&](const Mark& m) { return m.position + shift[m.branches]; };
+    auto branchSize = [](const Branch& b) { return b.wide ? (b.condition < 0 ? 5 : 6) : 2; };
+
+    std::vector<const Mark*> targets(branches_.size());
+    for (size_t i = 0; i < branches_.size(); ++i) {
+        auto it = textLabels_.find(branches_[i].label);
+        if (it == textLabels_.end()) {
+            throw std::runtime_error("x64 assembler: undefined label '" + std::string(branches_[i].label) + "'");
+        }
+        targets[i] = &it->second;
+    }
+
+    // Start short and widen what does not reach; widening only moves
+    // code apart, so this settles
+    for (bool changed = true; changed;) {
+        for (size_t i = 0; i < branches_.size(); ++i) {
+            shift[i + 1] = shift[i] + branchSize(branches_[i]);
+        }
+        changed = false;
+        for (size_t i = 0; i < branches_.size(); ++i) {
+            Branch& b = branches_[i];
+            if (b.wide) continue;
+            int64_t end = static_cast<int64_t>(address(b.at) + 2);
+            if (!fitsInt8(static_cast<int64_t>(address(*targets[i])) - end)) {
+                b.wide = true;
+                changed = true;
+            }
+        }
+    }
+
+    std::vector<uint8_t> code;
+    code.reserve(text_.size() + shift.back());
+    size_t copied = 0;
+    for (size_t i = 0; i < branches_.size(); ++i) {
+        const Branch& b = branches_[i];
+        code.insert(code.end(), text_.begin() + copied, text_.begin() + b.at.position);
+        copied = b.at.position;
+        int64_t end = static_cast<int64_t>(address(b.at) + branchSize(b));
+        int64_t displacement = static_cast<int64_t>(address(*targets[i])) - end;
+        if (!b.wide) {
+            code.push_back(b.condition < 0 ? 0xEB : static_cast<uint8_t>(0x70 | b.condition));
+            code.push_back(static_cast<uint8_t>(displacement));
+            continue;
+        }
+        if (b.condition < 0) {
+            code.push_back(0xE9);
+        } else {
+            code.push_back(0x0F);
+            code.push_back(static_cast<uint8_t>(0x80 | b.condition));
+        }
+        for (int k = 0; k < 4; ++k) {
+            code.push_back(static_cast<uint8_t>(static_cast<uint32_t>(displacement) >> (8 * k)));
+        }
+    }
+    code.insert(code.end(), text_.begin() + copied, text_.end());
+    return code;
+}
+
+ObjectCode Assembler::run(std::string_view assembly) {
+    while (!assembly.empty()) {
+        size_t newline = assembly.find('\n');
+        statement(trim(assembly.substr(0, newline)));
+        if (newline == std::string_view::npos) break;
+        assembly = assembly.substr(newline + 1);
+    }
+    line_ = {};
+
+    ObjectCode object;
+    std::vector<size_t> shift;
+    object.text = layoutText(shift);
+    object.data = std::move(data_);
+    auto offset = [&](Section section, const Mark& m) {
+        return section == Section::TEXT ? m.position + shift[m.branches] : m.position;
+    };
+
+    for (const auto& def : definitions_) {
+        if (globals_.count(def.name)) {
+            object.symbols.push_back({std::string(def.name), def.section, offset(def.section, def.mark), 0, true});
+        }
+    }
+    object.sizeSymbols();
+
+    object.relocations.reserve(relocations_.size());
+    for (const auto& r : relocations_) {
+        object.relocations.push_back({r.section, offset(r.section, r.mark), std::string(r.symbol), r.type, r.addend});
+    }
+    return object;
+}
+
+} // namespace
+
+ObjectCode assembleX64(std::string_view assembly) {
+    Assembler assembler;
+    return assembler.run(assembly);
+}
+
+} // namespace syclang
@@ -1,9 +1,119 @@
 #include "syclang/codegen/x64/x64_codegen.h"
+#include "syclang/codegen/x64/x64_assembler.h"
+#include "syclang/codegen/x64/x64_peephole.h"
+#include "syclang/thread_pool.h"
+#include "syclang/trace.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
 #include <sstream>
 #include <iomanip>
+#include <optional>
+#include <string_view>
 
 namespace syclang {
 
+namespace {
+
+// Registers reserved as scratch for instruction selection: rax/rdx for
+// results, idiv and setcc, rcx for shift counts, r11 for 64-bit immediates
+bool isScratchRegister(const std::string& name) {
+    return name == "rax" || name == "rcx" || name == "rdx" || name == "r11";
+}
+
+const char* const ARGUMENT_REGISTERS[] = {"rdi", "rsi", "rdx", "rcx", "r8", "r9"};
+
+bool isComparison(Opcode op) {
+    return op == Opcode::EQ || op == Opcode::NE || op == Opcode::LT ||
+           op == Opcode::GT || op == Opcode::LE || op == Opcode::GE;
+}
+
+// Condition-code suffix for a comparison and for its negation
+const char* conditionCode(Opcode op, bool negate) {
+    switch (op) {
+        case Opcode::EQ: return negate ? "ne" : "e";
+        case Opcode::NE: return negate ? "e" : "ne";
+        case Opcode::LT: return negate ? "ge" : "l";
+        case Opcode::GT: return negate ? "le" : "g";
+        case Opcode::LE: return negate ? "g" : "le";
+        case Opcode::GE: return negate ? "l" : "ge";
+        default: return negate ? "e" : "ne";
+    }
+}
+
+// The low `bytes` of a 64-bit register: rbx -> ebx/bx/bl, rsi -> sil,
+// r12 -> r12d/r12w/r12b
+std::string subRegister(const std::string& reg, size_t bytes) {
+    if (bytes >= 8) return reg;
+    if (std::isdigit(static_cast<unsigned char>(reg[1]))) {
+        return reg + (bytes == 4 ? "d" : bytes == 2 ? "w" : "b");
+    }
+    std::string base = reg.substr(1);
+    if (bytes == 4) return "e" + base;
+    if (bytes == 2) return base;
+    return base[1] == 'x' ? base.substr(0, 1) + "l" : base + "l";
+}
+
+const char* pointerSize(size_t bytes) {
+    switch (bytes) {
+        case 1: return "byte ptr ";
+        case 2: return "word ptr ";
+        case 4: return "dword ptr ";
+        default: return "qword ptr ";
+    }
+}
+
+// Suffix of packed-integer instructions for a lane size (paddb .. paddq)
+const char* laneSuffix(size_t bytes) {
+    switch (bytes) {
+        case 1: return "b";
+        case 2: return "w";
+        case 4: return "d";
+        default: return "q";
+    }
+}
+
+MachineInstruction makeInstruction(const char* mnemonic, std::string dst, std::string src) {
+    MachineInstruction inst;
+    inst.mnemonic = mnemonic;
+    inst.operands = {std::move(dst), std::move(src)};
+    return inst;
+}
+
+// Values narrower than 64 bits are held sign- or zero-extended by type
+MachineInstruction extendedLoad(IRType type, const std::string& reg, const std::string& address) {
+    switch (type) {
+        case IRType::I8: return makeInstruction("movsx", reg, "byte ptr " + address);
+        case IRType::U8:
+        case IRType::BOOL: return makeInstruction("movzx", reg, "byte ptr " + address);
+        case IRType::I16: return makeInstruction("movsx", reg, "word ptr " + address);
+        case IRType::U16: return makeInstruction("movzx", reg, "word ptr " + address);
+        case IRType::I32: return makeInstruction("movsxd", reg, "dword ptr " + address);
+        case IRType::U32:
+        case IRType::F32: return makeInstruction("mov", subRegister(reg, 4), "dword ptr " + address);
+        default: return makeInstruction("mov", reg, "qword ptr " + address);
+    }
+}
+
+// Re-extend the low bits of `reg` for `type`; nothing for 64-bit types
+std::optional<MachineInstruction> extendInPlace(IRType type, const std::string& reg) {
+    switch (type) {
+        case IRType::I8: return makeInstruction("movsx", reg, subRegister(reg, 1));
+        case IRType::U8:
+        case IRType::BOOL: return makeInstruction("movzx", reg, subRegister(reg, 1));
+        case IRType::I16: return makeInstruction("movsx", reg, subRegister(reg, 2));
+        case IRType::U16: return makeInstruction("movzx", reg, subRegister(reg, 2));
+        case IRType::I32: return makeInstruction("movsxd", reg, subRegister(reg, 4));
+        case IRType::U32:
+        case IRType::F32: return makeInstruction("mov", subRegister(reg, 4), subRegister(reg, 4));
+        default: return std::nullopt;
+    }
+}
+
+constexpr int VECTOR_REGISTERS = 16; // xmm0-15 (ymm0-15), all caller-saved
+
+} // namespace
+
 X64CodeGenerator::X64CodeGenerator() {
     arch_ = Architecture::X64;
     currentStackOffset_ = 0;
@@ -20,298 +130,737 @@ void X64CodeGenerator::initRegisters() {
     };
 }
 
+std::vector<AllocatableRegister> X64CodeGenerator::allocatableRegisters() const {
+    std::vector<AllocatableRegister> result;
+    for (size_t i = 0; i < registers_.size(); ++i) {
+        if (!isScratchRegister(registers_[i].name)) {
+            result.push_back({static_cast<int>(i), registers_[i].isCallerSave});
+        }
+    }
+    return result;
+}
+
 void X64CodeGenerator::generate(std::shared_ptr<IRModule> module) {
+    TraceScope trace("codegen", "codegen");
     output_.clear();
+    module_ = module;
+    const IRArena& arena = module->arena;
+    
+    // Functions are independent: each one is emitted by its own worker
+    // generator into a private buffer (the arena is only read), and the
+    // buffers are joined in module order so output is deterministic.
+    // Functions are emitted in batches and each batch is joined before
+    // the next starts, so with an output file attached only a batch's
+    // text is held at once. With the peephole pass on, the worker
+    // collects its function's instructions, rewrites them and only then
+    // prints them. For machine code the worker then assembles that text
+    // right away, so the module's assembly is never built.
+    if (!emitObjectCode_) {
+        output_ << "# x64 Assembly Generated by SysLang\n";
+        output_ << ".intel_syntax noprefix\n";
+        output_ << ".section .text\n\n";
+    }
+    std::vector<OutputBuffer> functionText(module->functions.size());
+    std::vector<ObjectCode> functionCode(emitObjectCode_ ? module->functions.size() : 0);
+    std::vector<std::vector<AllocationStats>> functionStats(module->functions.size());
+    std::vector<PeepholeStats> functionPeephole(module->functions.size());
+    auto emitOne = [&](size_t index) {
+        X64CodeGenerator worker;
+        worker.module_ = module;
+        worker.peephole_ = peephole_;
+        worker.emitFunction(*module->functions[index]);
+        if (peephole_) {
+            TraceScope peephole("peephole", "codegen", module->functions[index]->name);
+            functionPeephole[index] = worker.runPeephole(peepholeX64);
+        }
+        if (emitObjectCode_) {
+            TraceScope assemble("assemble", "codegen", module->functions[index]->name);
+            functionCode[index] = assembleX64(worker.output_.str());
+        } else {
+            functionText[index] = std::move(worker.output_);
+        }
+        functionStats[index] = std::move(worker.allocationStats_);
+    };
+    size_t batch = pool_ ? std::max<size_t>(64, pool_->concurrency() * 16) : 1;
+    for (size_t first = 0; first < functionText.size(); first += batch) {
+        size_t count = std::min(batch, functionText.size() - first);
+        if (pool_) {
+            parallelFor(*pool_, count, [&](size_t i) { emitOne(first + i); });
+        } else {
+            emitOne(first);
+        }
+        for (size_t i = first; i < first + count; ++i) {
+            output_.append(std::move(functionText[i]));
+        }
+    }
     
-    output_ += "# x64 Assembly Generated by SysLang\n";
-    output_ += ".section .text\n\n";
+    allocationStats_.clear();
+    for (auto& stats : functionStats) {
+        allocationStats_.insert(allocationStats_.end(), stats.begin(), stats.end());
+    }
+    peepholeStats_ = PeepholeStats();
+    for (const auto& stats : functionPeephole) {
+        peepholeStats_ += stats;
+    }
     
-    // Generate functions
-    for (const auto& func : module->functions) {
-        output_ += ".global " + func->name + "\n";
-        output_ += func->name + ":\n";
-        
-        emitPrologue(func->name);
+    object_ = ObjectCode();
+    if (emitObjectCode_) {
+        for (const auto& code : functionCode) {
+            object_.append(code);
+        }
+        for (ValueId varId : module->globalVariables) {
+            object_.defineData(arena.value(varId).name, 8, 8);
+        }
+        return;
+    }
+    
+    output_ << ".section .data\n\n";
+    
+    // Generate global variables
+    for (ValueId varId : module->globalVariables) {
+        const IRValue& var = arena.value(varId);
+        output_ << ".global " << var.name << "\n";
+        output_ << var.name << ":\n";
+        output_ << "    .zero 8\n\n";
+    }
+}
+
+void X64CodeGenerator::emitFunction(const IRFunction& func) {
+    // Extern declarations have no body to emit
+    if (func.blocks.empty()) return;
+    TraceScope trace("codegen function", "codegen", func.name);
+    
+    const IRArena& arena = module_->arena;
+    FunctionLiveness liveness(arena, func);
+    liveness_ = &liveness;
+    {
+        TraceScope allocation("register allocation", "codegen", func.name);
+        allocation_ = allocateLinearScan(liveness, allocatableRegisters());
+    }
+    recordAllocation(func.name, allocation_);
+    
+    emitLine(".global " + func.name);
+    emitLabel(func.name);
+    
+    wideVectors_ = false;
+    for (BlockId blockId : func.blocks) {
+        for (InstId instId : arena.block(blockId).instructions) {
+            ValueId result = arena.instruction(instId).result;
+            wideVectors_ = wideVectors_ ||
+                           (result != INVALID_ID && getTypeSize(arena.value(result).getType()) == 32);
+        }
+    }
+    
+    emitPrologue(func.name);
+    emitArguments(func);
+    
+    // Generate basic blocks
+    edgeBlocks_.clear();
+    for (size_t b = 0; b < func.blocks.size(); ++b) {
+        const IRBasicBlock& block = arena.block(func.blocks[b]);
+        currentBlock_ = func.blocks[b];
+        vectorRegisters_ = assignVectorRegisters(arena, block, VECTOR_REGISTERS);
+        nextBlock_ = b + 1 < func.blocks.size() ? arena.block(func.blocks[b + 1]).name : "";
+        if (block.name != "entry") {
+            emitLabel(block.name);
+        }
         
-        // Generate basic blocks
-        for (const auto& block : func->blocks) {
-            if (block->name != "entry") {
-                output_ += block->name + ":\n";
+        const auto& insts = block.instructions;
+        for (size_t i = 0; i < insts.size(); ++i) {
+            const IRInstruction& inst = arena.instruction(insts[i]);
+            
+            // A comparison read only by the branch after it becomes cmp + jcc
+            if (isComparison(inst.opcode) && i + 1 < insts.size()) {
+                const IRInstruction& next = arena.instruction(insts[i + 1]);
+                auto interval = liveness.interval(inst.result);
+                if (next.opcode == Opcode::CONDBR && interval && interval->uses == 1 &&
+                    arena.operands(next)[0] == inst.result) {
+                    auto ops = arena.operands(inst);
+                    emitCompare(ops[0], ops[1]);
+                    emitBranch(conditionCode(inst.opcode, false), conditionCode(inst.opcode, true),
+                               branchTarget(next.targets[0]), branchTarget(next.targets[1]));
+                    break;
+                }
             }
             
-            for (const auto& inst : block->instructions) {
-                emitInstruction(inst);
+            emitInstruction(inst);
+            if (inst.isTerminator()) {
+                break; // Anything after a terminator is unreachable
             }
         }
-        
-        emitEpilogue(func->name);
-        output_ += "\n";
     }
     
-    output_ += ".section .data\n\n";
+    // Copies for conditional edges into PHIs, placed after the body so
+    // no block falls through into them
+    for (size_t e = 0; e < edgeBlocks_.size(); ++e) {
+        auto [from, to] = edgeBlocks_[e];
+        emitLabel(edgeLabel(from, to));
+        emitEdgeCopies(from, to);
+        emit("jmp", {arena.block(to).name});
+    }
     
-    // Generate global variables
-    for (const auto& var : module->globalVariables) {
-        output_ += ".global " + var->name + "\n";
-        output_ += var->name + ":\n";
-        output_ += "    .zero 8\n\n";
+    liveness_ = nullptr;
+    emitLine("");
+}
+
+void X64CodeGenerator::emitArguments(const IRFunction& func) {
+    // The arguments' registers may be allocated to other arguments, so
+    // they move as one parallel copy
+    std::vector<OperandMove> moves;
+    for (size_t i = 0; i < func.arguments.size(); ++i) {
+        if (isDead(func.arguments[i])) continue;
+        std::string source = i < 6 ? ARGUMENT_REGISTERS[i]
+                                   : "qword ptr [rbp + " + std::to_string(16 + 8 * (i - 6)) + "]";
+        moves.push_back({valueToOperand(func.arguments[i]), source});
+    }
+    for (const auto& move : sequenceMoves(std::move(moves), "r11")) {
+        emitOperandMove(move.dst, move.src);
     }
 }
 
 void X64CodeGenerator::emitPrologue(const std::string& funcName) {
-    output_ += "    push rbp\n";
-    output_ += "    mov rbp, rsp\n";
-    output_ += "    sub rsp, " + std::to_string(currentStackOffset_ + 32) + "\n";
+    savedRegisters_ = allocation_.calleeSavedUsed;
+    
+    // After push rbp the stack is 16-byte aligned; keep it that way
+    int saved = static_cast<int>(savedRegisters_.size()) * 8;
+    frameSize_ = static_cast<int>(allocation_.spillSlots) * 8;
+    if ((saved + frameSize_) % 16 != 0) {
+        frameSize_ += 8;
+    }
+    
+    emit("push", {"rbp"});
+    emit("mov", {"rbp", "rsp"});
+    for (int reg : savedRegisters_) {
+        emit("push", {registers_[reg].name});
+    }
+    if (frameSize_ > 0) {
+        emit("sub", {"rsp", std::to_string(frameSize_)});
+    }
 }
 
 void X64CodeGenerator::emitEpilogue(const std::string& funcName) {
-    output_ += "    leave\n";
-    output_ += "    ret\n";
+    if (savedRegisters_.empty()) {
+        emit("leave");
+    } else {
+        emit("lea", {"rsp", "[rbp - " + std::to_string(savedRegisters_.size() * 8) + "]"});
+        for (auto it = savedRegisters_.rbegin(); it != savedRegisters_.rend(); ++it) {
+            emit("pop", {registers_[*it].name});
+        }
+        emit("pop", {"rbp"});
+    }
+    emit("ret");
 }
 
-void X64CodeGenerator::emitInstruction(std::shared_ptr<IRInstruction> inst) {
-    switch (inst->opcode) {
+void X64CodeGenerator::emitInstruction(const IRInstruction& inst) {
+    const IRArena& arena = module_->arena;
+    auto ops = arena.operands(inst);
+    if (inst.result != INVALID_ID && isVectorType(arena.value(inst.result).getType())) {
+        emitVectorInstruction(inst);
+        return;
+    }
+    
+    switch (inst.opcode) {
         case Opcode::RET: {
-            if (inst->operands.size() > 0) {
-                output_ += "    mov rax, " + valueToOperand(inst->operands[0]) + "\n";
+            if (ops.size() > 0) {
+                emitMove("rax", ops[0]);
             }
-            break;
-        }
-        case Opcode::ADD: {
-            output_ += "    mov rax, " + valueToOperand(inst->operands[0]) + "\n";
-            output_ += "    add rax, " + valueToOperand(inst->operands[1]) + "\n";
-            if (inst->result) {
-                output_ += "    mov " + valueToOperand(inst->result) + ", rax\n";
+            if (wideVectors_) {
+                emit("vzeroupper"); // Avoid SSE transition stalls in the caller
             }
+            emitEpilogue("");
             break;
         }
-        case Opcode::SUB: {
-            output_ += "    mov rax, " + valueToOperand(inst->operands[0]) + "\n";
-            output_ += "    sub rax, " + valueToOperand(inst->operands[1]) + "\n";
-            if (inst->result) {
-                output_ += "    mov " + valueToOperand(inst->result) + ", rax\n";
-            }
+        case Opcode::ADD: emitBinaryOp("add", inst.result, ops[0], ops[1]); break;
+        case Opcode::SUB: emitBinaryOp("sub", inst.result, ops[0], ops[1]); break;
+        case Opcode::MUL: emitBinaryOp("imul", inst.result, ops[0], ops[1]); break;
+        case Opcode::AND: emitBinaryOp("and", inst.result, ops[0], ops[1]); break;
+        case Opcode::OR: emitBinaryOp("or", inst.result, ops[0], ops[1]); break;
+        case Opcode::XOR: emitBinaryOp("xor", inst.result, ops[0], ops[1]); break;
+        case Opcode::DIV: emitDivide(inst.result, ops[0], ops[1], false); break;
+        case Opcode::MOD: emitDivide(inst.result, ops[0], ops[1], true); break;
+        case Opcode::SHL: emitShift("shl", inst.result, ops[0], ops[1]); break;
+        case Opcode::SHR: emitShift("shr", inst.result, ops[0], ops[1]); break;
+        case Opcode::NEG:
+        case Opcode::BIT_NOT: {
+            if (isDead(inst.result)) break;
+            std::string reg = isRegister(inst.result) ? valueToOperand(inst.result) : "rax";
+            emitMove(reg, ops[0]);
+            emit(inst.opcode == Opcode::NEG ? "neg" : "not", {reg});
+            emitResult(inst.result, reg);
             break;
         }
-        case Opcode::MUL: {
-            output_ += "    mov rax, " + valueToOperand(inst->operands[0]) + "\n";
-            output_ += "    imul rax, " + valueToOperand(inst->operands[1]) + "\n";
-            if (inst->result) {
-                output_ += "    mov " + valueToOperand(inst->result) + ", rax\n";
-            }
+        case Opcode::NOT: {
+            if (isDead(inst.result)) break;
+            emitCompare(ops[0], INVALID_ID);
+            emit("sete", {"al"});
+            emit("movzx", {"eax", "al"});
+            emitResult(inst.result, "rax");
             break;
         }
-        case Opcode::DIV: {
-            output_ += "    mov rax, " + valueToOperand(inst->operands[0]) + "\n";
-            output_ += "    cqo\n";
-            output_ += "    idiv " + valueToOperand(inst->operands[1]) + "\n";
-            if (inst->result) {
-                output_ += "    mov " + valueToOperand(inst->result) + ", rax\n";
-            }
+        case Opcode::EQ:
+        case Opcode::NE:
+        case Opcode::LT:
+        case Opcode::GT:
+        case Opcode::LE:
+        case Opcode::GE: {
+            if (isDead(inst.result)) break;
+            emitCompare(ops[0], ops[1]);
+            emit(std::string("set") + conditionCode(inst.opcode, false), {"al"});
+            emit("movzx", {"eax", "al"});
+            emitResult(inst.result, "rax");
             break;
         }
-        case Opcode::AND: {
-            output_ += "    mov rax, " + valueToOperand(inst->operands[0]) + "\n";
-            output_ += "    and rax, " + valueToOperand(inst->operands[1]) + "\n";
-            if (inst->result) {
-                output_ += "    mov " + valueToOperand(inst->result) + ", rax\n";
+        case Opcode::LOAD: {
+            if (ops.size() == 2) {
+                emitIndexedLoad(inst);
+            } else if (arena.value(ops[0]).isVariable()) {
+                emitCopy(inst.result, ops[0]);
             }
             break;
         }
-        case Opcode::OR: {
-            output_ += "    mov rax, " + valueToOperand(inst->operands[0]) + "\n";
-            output_ += "    or rax, " + valueToOperand(inst->operands[1]) + "\n";
-            if (inst->result) {
-                output_ += "    mov " + valueToOperand(inst->result) + ", rax\n";
+        case Opcode::STORE: {
+            if (ops.size() == 3) {
+                emitIndexedStore(inst);
+            } else if (arena.value(ops[1]).isVariable()) {
+                emitCopy(ops[1], ops[0]);
             }
             break;
         }
-        case Opcode::XOR: {
-            output_ += "    mov rax, " + valueToOperand(inst->operands[0]) + "\n";
-            output_ += "    xor rax, " + valueToOperand(inst->operands[1]) + "\n";
-            if (inst->result) {
-                output_ += "    mov " + valueToOperand(inst->result) + ", rax\n";
-            }
+        case Opcode::TRUNC: emitTruncate(inst); break;
+        case Opcode::ALLOCA: {
+            // Locals live in registers or spill slots chosen by the allocator
             break;
         }
-        case Opcode::SHL: {
-            output_ += "    mov rax, " + valueToOperand(inst->operands[0]) + "\n";
-            output_ += "    mov rcx, " + valueToOperand(inst->operands[1]) + "\n";
-            output_ += "    shl rax, cl\n";
-            if (inst->result) {
-                output_ += "    mov " + valueToOperand(inst->result) + ", rax\n";
+        case Opcode::CALL: {
+            auto pushArgument = [&](ValueId arg) {
+                if (arena.value(arg).isConstant() && !isImm32(arg)) {
+                    emitMove("r11", arg);
+                    emit("push", {"r11"});
+                } else {
+                    emit("push", {valueToOperand(arg)});
+                }
+            };
+            // Arguments past the sixth go on the stack right to left, with
+            // padding below them so rsp is 16-byte aligned at the call
+            size_t count = std::min<size_t>(ops.size(), 6);
+            size_t stackBytes = (ops.size() - count) * 8;
+            if (stackBytes % 16 != 0) {
+                emit("sub", {"rsp", "8"});
+                stackBytes += 8;
             }
-            break;
-        }
-        case Opcode::SHR: {
-            output_ += "    mov rax, " + valueToOperand(inst->operands[0]) + "\n";
-            output_ += "    mov rcx, " + valueToOperand(inst->operands[1]) + "\n";
-            output_ += "    shr rax, cl\n";
-            if (inst->result) {
-                output_ += "    mov " + valueToOperand(inst->result) + ", rax\n";
+            for (size_t i = ops.size(); i-- > count;) {
+                pushArgument(ops[i]);
             }
-            break;
-        }
-        case Opcode::NEG: {
-            output_ += "    mov rax, " + valueToOperand(inst->operands[0]) + "\n";
-            output_ += "    neg rax\n";
-            if (inst->result) {
-                output_ += "    mov " + valueToOperand(inst->result) + ", rax\n";
+            // Stage register arguments on the stack too: an argument may
+            // currently sit in another argument's register
+            for (size_t i = 0; i < count; ++i) {
+                pushArgument(ops[i]);
             }
-            break;
-        }
-        case Opcode::NOT: {
-            output_ += "    mov rax, " + valueToOperand(inst->operands[0]) + "\n";
-            output_ += "    test rax, rax\n";
-            output_ += "    sete al\n";
-            output_ += "    movzx rax, al\n";
-            if (inst->result) {
-                output_ += "    mov " + valueToOperand(inst->result) + ", rax\n";
+            for (size_t i = count; i-- > 0;) {
+                emit("pop", {ARGUMENT_REGISTERS[i]});
             }
-            break;
-        }
-        case Opcode::BIT_NOT: {
-            output_ += "    mov rax, " + valueToOperand(inst->operands[0]) + "\n";
-            output_ += "    not rax\n";
-            if (inst->result) {
-                output_ += "    mov " + valueToOperand(inst->result) + ", rax\n";
+            emit("call", {inst.callee != INVALID_ID ? arena.value(inst.callee).name
+                                                    : std::string("external_function")});
+            if (stackBytes > 0) {
+                emit("add", {"rsp", std::to_string(stackBytes)});
             }
+            emitResult(inst.result, "rax");
             break;
         }
-        case Opcode::EQ: {
-            output_ += "    mov rax, " + valueToOperand(inst->operands[0]) + "\n";
-            output_ += "    cmp rax, " + valueToOperand(inst->operands[1]) + "\n";
-            output_ += "    sete al\n";
-            output_ += "    movzx rax, al\n";
-            if (inst->result) {
-                output_ += "    mov " + valueToOperand(inst->result) + ", rax\n";
+        case Opcode::BR:
+        case Opcode::CONDBR: {
+            BlockId target = inst.targets[0];
+            if (inst.opcode == Opcode::CONDBR) {
+                const IRValue& cond = arena.value(ops[0]);
+                if (!cond.isConstant()) {
+                    emit("cmp", {valueToOperand(ops[0]), "0"});
+                    emitBranch("ne", "e", branchTarget(inst.targets[0]),
+                               branchTarget(inst.targets[1]));
+                    break;
+                }
+                target = cond.value_.intValue != 0 ? inst.targets[0] : inst.targets[1];
             }
-            break;
-        }
-        case Opcode::NE: {
-            output_ += "    mov rax, " + valueToOperand(inst->operands[0]) + "\n";
-            output_ += "    cmp rax, " + valueToOperand(inst->operands[1]) + "\n";
-            output_ += "    setne al\n";
-            output_ += "    movzx rax, al\n";
-            if (inst->result) {
-                output_ += "    mov " + valueToOperand(inst->result) + ", rax\n";
+            emitEdgeCopies(currentBlock_, target);
+            const std::string& label = arena.block(target).name;
+            if (label != nextBlock_) {
+                emit("jmp", {label});
             }
             break;
         }
-        case Opcode::LT: {
-            output_ += "    mov rax, " + valueToOperand(inst->operands[0]) + "\n";
-            output_ += "    cmp rax, " + valueToOperand(inst->operands[1]) + "\n";
-            output_ += "    setl al\n";
-            output_ += "    movzx rax, al\n";
-            if (inst->result) {
-                output_ += "    mov " + valueToOperand(inst->result) + ", rax\n";
-            }
+        case Opcode::PHI: {
+            // Copied on the incoming edges
             break;
         }
-        case Opcode::GT: {
-            output_ += "    mov rax, " + valueToOperand(inst->operands[0]) + "\n";
-            output_ += "    cmp rax, " + valueToOperand(inst->operands[1]) + "\n";
-            output_ += "    setg al\n";
-            output_ += "    movzx rax, al\n";
-            if (inst->result) {
-                output_ += "    mov " + valueToOperand(inst->result) + ", rax\n";
-            }
+        default:
             break;
+    }
+}
+
+std::string X64CodeGenerator::valueToOperand(ValueId value) {
+    const IRValue& val = module_->arena.value(value);
+    if (val.isConstant()) {
+        return std::to_string(val.value_.intValue);
+    }
+    if (val.isGlobal) {
+        return "qword ptr [rip + " + val.name + "]";
+    }
+    
+    ValueLocation loc = allocation_.locate(value);
+    if (loc.kind == ValueLocation::Kind::REGISTER) {
+        return registers_[loc.index].name;
+    }
+    if (loc.kind == ValueLocation::Kind::STACK) {
+        int offset = static_cast<int>(savedRegisters_.size()) * 8 + (loc.index + 1) * 8;
+        return "qword ptr [rbp - " + std::to_string(offset) + "]";
+    }
+    return "0"; // Read but never written: any value will do
+}
+
+bool X64CodeGenerator::isRegister(ValueId value) const {
+    return allocation_.locate(value).kind == ValueLocation::Kind::REGISTER;
+}
+
+bool X64CodeGenerator::isMemory(ValueId value) const {
+    const IRValue& val = module_->arena.value(value);
+    if (val.isConstant()) return false;
+    return val.isGlobal || allocation_.locate(value).kind == ValueLocation::Kind::STACK;
+}
+
+bool X64CodeGenerator::isImm32(ValueId value) const {
+    const IRValue& val = module_->arena.value(value);
+    return val.isConstant() && val.value_.intValue >= INT32_MIN && val.value_.intValue <= INT32_MAX;
+}
+
+bool X64CodeGenerator::isDead(ValueId value) const {
+    if (value == INVALID_ID) return true;
+    const IRValue& val = module_->arena.value(value);
+    return !val.isGlobal && allocation_.locate(value).kind == ValueLocation::Kind::NONE;
+}
+
+void X64CodeGenerator::emitMove(const std::string& reg, ValueId value) {
+    std::string source = valueToOperand(value);
+    if (source != reg) {
+        emit("mov", {reg, source});
+    }
+}
+
+void X64CodeGenerator::emitCopy(ValueId dst, ValueId src) {
+    if (isDead(dst)) return;
+    std::string target = valueToOperand(dst);
+    std::string source = valueToOperand(src);
+    if (target == source) return;
+    
+    // x64 has no memory-to-memory move or 64-bit immediate store
+    bool constant = module_->arena.value(src).isConstant();
+    if (isMemory(dst) && (isMemory(src) || (constant && !isImm32(src)))) {
+        emitMove("rax", src);
+        source = "rax";
+    }
+    emit("mov", {target, source});
+}
+
+void X64CodeGenerator::emitResult(ValueId dst, const std::string& reg) {
+    if (isDead(dst)) return;
+    std::string target = valueToOperand(dst);
+    if (target != reg) {
+        emit("mov", {target, reg});
+    }
+}
+
+void X64CodeGenerator::emitBinaryOp(const char* mnemonic, ValueId dst, ValueId left, ValueId right) {
+    if (isDead(dst)) return;
+    
+    // Compute in the destination register when it has one. The result
+    // may share a register with an operand read for the last time here;
+    // when that is the right-hand one, swap (commutative) or use rax.
+    std::string reg = isRegister(dst) ? valueToOperand(dst) : "rax";
+    if (reg != "rax" && valueToOperand(right) == reg && valueToOperand(left) != reg) {
+        std::string_view op = mnemonic;
+        if (op == "add" || op == "imul" || op == "and" || op == "or" || op == "xor") {
+            std::swap(left, right);
+        } else {
+            reg = "rax";
         }
-        case Opcode::LE: {
-            output_ += "    mov rax, " + valueToOperand(inst->operands[0]) + "\n";
-            output_ += "    cmp rax, " + valueToOperand(inst->operands[1]) + "\n";
-            output_ += "    setle al\n";
-            output_ += "    movzx rax, al\n";
-            if (inst->result) {
-                output_ += "    mov " + valueToOperand(inst->result) + ", rax\n";
-            }
-            break;
+    }
+    std::string rhs = valueToOperand(right);
+    if (module_->arena.value(right).isConstant() && !isImm32(right)) {
+        emitMove("r11", right);
+        rhs = "r11";
+    }
+    emitMove(reg, left);
+    emit(mnemonic, {reg, rhs});
+    emitResult(dst, reg);
+}
+
+void X64CodeGenerator::emitShift(const char* mnemonic, ValueId dst, ValueId left, ValueId right) {
+    if (isDead(dst)) return;
+    
+    std::string reg = isRegister(dst) ? valueToOperand(dst) : "rax";
+    std::string count;
+    if (module_->arena.value(right).isConstant()) {
+        count = std::to_string(module_->arena.value(right).value_.intValue & 63);
+    } else {
+        emitMove("rcx", right);
+        count = "cl";
+    }
+    emitMove(reg, left);
+    emit(mnemonic, {reg, count});
+    emitResult(dst, reg);
+}
+
+void X64CodeGenerator::emitDivide(ValueId dst, ValueId left, ValueId right, bool remainder) {
+    if (isDead(dst)) return;
+    
+    std::string divisor = valueToOperand(right);
+    if (module_->arena.value(right).isConstant()) {
+        emitMove("r11", right);
+        divisor = "r11";
+    }
+    emitMove("rax", left);
+    emit("cqo");
+    emit("idiv", {divisor});
+    emitResult(dst, remainder ? "rdx" : "rax");
+}
+
+void X64CodeGenerator::emitCompare(ValueId left, ValueId right) {
+    const IRArena& arena = module_->arena;
+    std::string lhs = valueToOperand(left);
+    std::string rhs = right == INVALID_ID ? "0" : valueToOperand(right);
+    
+    // cmp takes r/m on the left and r/m or imm32 on the right, not both memory
+    if (arena.value(left).isConstant() ||
+        (right != INVALID_ID && isMemory(left) && isMemory(right))) {
+        emitMove("rax", left);
+        lhs = "rax";
+    }
+    if (right != INVALID_ID && arena.value(right).isConstant() && !isImm32(right)) {
+        emitMove("r11", right);
+        rhs = "r11";
+    }
+    emit("cmp", {lhs, rhs});
+}
+
+std::string X64CodeGenerator::elementAddress(ValueId base, ValueId index, size_t scale) {
+    std::string b = "rax";
+    if (isRegister(base)) {
+        b = valueToOperand(base);
+    } else {
+        emitMove("rax", base);
+    }
+    const IRValue& idx = module_->arena.value(index);
+    if (idx.isConstant()) {
+        int64_t offset = idx.value_.intValue * static_cast<int64_t>(scale);
+        if (offset >= INT32_MIN && offset <= INT32_MAX) {
+            if (offset == 0) return "[" + b + "]";
+            return "[" + b + (offset < 0 ? " - " : " + ") + std::to_string(std::abs(offset)) + "]";
         }
-        case Opcode::GE: {
-            output_ += "    mov rax, " + valueToOperand(inst->operands[0]) + "\n";
-            output_ += "    cmp rax, " + valueToOperand(inst->operands[1]) + "\n";
-            output_ += "    setge al\n";
-            output_ += "    movzx rax, al\n";
-            if (inst->result) {
-                output_ += "    mov " + valueToOperand(inst->result) + ", rax\n";
-            }
-            break;
+    }
+    std::string i = "r11";
+    if (isRegister(index)) {
+        i = valueToOperand(index);
+    } else {
+        emitMove("r11", index);
+    }
+    return "[" + b + " + " + i + "*" + std::to_string(scale) + "]";
+}
+
+void X64CodeGenerator::emitIndexedLoad(const IRInstruction& inst) {
+    if (isDead(inst.result)) return;
+    auto ops = module_->arena.operands(inst);
+    IRType type = module_->arena.value(inst.result).getType();
+    std::string address = elementAddress(ops[0], ops[1], std::max<size_t>(getTypeSize(type), 1));
+    std::string reg = isRegister(inst.result) ? valueToOperand(inst.result) : "rax";
+    emit(extendedLoad(type, reg, address));
+    emitResult(inst.result, reg);
+}
+
+void X64CodeGenerator::emitIndexedStore(const IRInstruction& inst) {
+    const IRArena& arena = module_->arena;
+    auto ops = arena.operands(inst);
+    const IRValue& value = arena.value(ops[0]);
+    IRType type = value.getType();
+    if (isVectorType(type)) {
+        size_t lane = getTypeSize(vectorElementType(type));
+        std::string address = elementAddress(ops[1], ops[2], lane);
+        bool wide = getTypeSize(type) == 32;
+        emit(wide ? "vmovdqu" : "movdqu",
+             {(wide ? "ymmword ptr " : "xmmword ptr ") + address, vectorRegister(ops[0])});
+        return;
+    }
+    
+    size_t bytes = getTypeSize(type) ? getTypeSize(type) : 8;
+    std::string source;
+    if (value.isConstant() && (bytes < 8 || isImm32(ops[0]))) {
+        int64_t bits = value.value_.intValue;
+        if (bytes < 4) {
+            bits &= (int64_t{1} << (8 * bytes)) - 1;
+        } else if (bytes == 4) {
+            bits = static_cast<int32_t>(bits);
+        }
+        source = std::to_string(bits);
+    } else if (isRegister(ops[0])) {
+        source = subRegister(valueToOperand(ops[0]), bytes);
+    } else {
+        emitMove("rdx", ops[0]);
+        source = subRegister("rdx", bytes);
+    }
+    std::string address = elementAddress(ops[1], ops[2], bytes);
+    emit("mov", {pointerSize(bytes) + address, source});
+}
+
+void X64CodeGenerator::emitTruncate(const IRInstruction& inst) {
+    if (isDead(inst.result)) return;
+    auto ops = module_->arena.operands(inst);
+    std::string reg = isRegister(inst.result) ? valueToOperand(inst.result) : "rax";
+    emitMove(reg, ops[0]);
+    if (auto extend = extendInPlace(module_->arena.value(inst.result).getType(), reg)) {
+        emit(std::move(*extend));
+    }
+    emitResult(inst.result, reg);
+}
+
+std::string X64CodeGenerator::vectorRegister(ValueId value) const {
+    bool wide = getTypeSize(module_->arena.value(value).getType()) == 32;
+    auto it = vectorRegisters_.find(value);
+    int number = it == vectorRegisters_.end() ? 0 : it->second;
+    return (wide ? "ymm" : "xmm") + std::to_string(number);
+}
+
+void X64CodeGenerator::emitVectorInstruction(const IRInstruction& inst) {
+    const IRArena& arena = module_->arena;
+    auto ops = arena.operands(inst);
+    IRType type = arena.value(inst.result).getType();
+    bool wide = getTypeSize(type) == 32;
+    size_t lane = getTypeSize(vectorElementType(type));
+    std::string d = vectorRegister(inst.result);
+    
+    // AVX2 has three-operand forms; SSE computes in place, and the result
+    // never shares a register with an operand (assignVectorRegisters)
+    auto emitOp = [&](const std::string& mnemonic, const std::string& a, const std::string& b) {
+        if (wide) {
+            emit("v" + mnemonic, {d, a, b});
+            return;
+        }
+        if (a != d) {
+            emit("movdqa", {d, a});
         }
+        emit(mnemonic, {d, b});
+    };
+    std::string suffix = laneSuffix(lane);
+    
+    switch (inst.opcode) {
         case Opcode::LOAD: {
-            auto var = std::dynamic_pointer_cast<IRVariable>(inst->operands[0]);
-            if (var) {
-                output_ += "    mov rax, [rbp - " + std::to_string(16 + var->offset) + "]\n";
-                if (inst->result) {
-                    output_ += "    mov " + valueToOperand(inst->result) + ", rax\n";
-                }
-            }
+            std::string address = elementAddress(ops[0], ops[1], lane);
+            emit(wide ? "vmovdqu" : "movdqu", {d, (wide ? "ymmword ptr " : "xmmword ptr ") + address});
             break;
         }
-        case Opcode::STORE: {
-            auto var = std::dynamic_pointer_cast<IRVariable>(inst->operands[1]);
-            if (var) {
-                output_ += "    mov rax, " + valueToOperand(inst->operands[0]) + "\n";
-                output_ += "    mov [rbp - " + std::to_string(16 + var->offset) + "], rax\n";
+        case Opcode::SPLAT: {
+            emitMove("rax", ops[0]);
+            if (wide) {
+                std::string low = "xmm" + d.substr(3);
+                emit("vmovq", {low, "rax"});
+                emit("vpbroadcast" + suffix, {d, low});
+                break;
+            }
+            emit("movq", {d, "rax"});
+            if (lane == 1) {
+                emit("punpcklbw", {d, d});
+            }
+            if (lane <= 2) {
+                emit("pshuflw", {d, d, "0"});
+            }
+            if (lane == 8) {
+                emit("punpcklqdq", {d, d});
+            } else {
+                emit("pshufd", {d, d, "0"});
             }
             break;
         }
-        case Opcode::ALLOCA: {
-            // Stack allocation is handled in prologue
+        case Opcode::ADD: emitOp("padd" + suffix, vectorRegister(ops[0]), vectorRegister(ops[1])); break;
+        case Opcode::SUB: emitOp("psub" + suffix, vectorRegister(ops[0]), vectorRegister(ops[1])); break;
+        case Opcode::MUL:
+            emitOp(lane == 2 ? "pmullw" : "pmulld", vectorRegister(ops[0]), vectorRegister(ops[1]));
             break;
-        }
-        case Opcode::CALL: {
-            // For now, assume function name is in operands[0]
-            // This is simplified
-            output_ += "    call external_function\n";
+        case Opcode::AND: emitOp("pand", vectorRegister(ops[0]), vectorRegister(ops[1])); break;
+        case Opcode::OR: emitOp("por", vectorRegister(ops[0]), vectorRegister(ops[1])); break;
+        case Opcode::XOR: emitOp("pxor", vectorRegister(ops[0]), vectorRegister(ops[1])); break;
+        case Opcode::SHL:
+        case Opcode::SHR: {
+            std::string count = std::to_string(arena.value(ops[1]).value_.intValue & 63);
+            emitOp((inst.opcode == Opcode::SHL ? "psll" : "psrl") + suffix, vectorRegister(ops[0]), count);
             break;
         }
-        case Opcode::BR: {
-            output_ += "    jmp " + inst->label + "\n";
+        case Opcode::NEG:
+            emitOp("pxor", d, d);
+            emitOp("psub" + suffix, d, vectorRegister(ops[0]));
             break;
-        }
-        case Opcode::CONDBR: {
-            output_ += "    cmp rax, 1\n";
-            output_ += "    jne false_branch\n";
-            output_ += "    jmp true_branch\n";
+        case Opcode::BIT_NOT:
+            emitOp("pcmpeqd", d, d);
+            emitOp("pxor", d, vectorRegister(ops[0]));
             break;
-        }
         default:
             break;
     }
 }
 
-std::string X64CodeGenerator::valueToOperand(std::shared_ptr<IRValue> value) {
-    auto constant = std::dynamic_pointer_cast<IRConstant>(value);
-    if (constant) {
-        return "$" + constant->toString();
+std::string X64CodeGenerator::branchTarget(BlockId to) {
+    // Edges whose copies all coalesced need no block of their own
+    if (!hasPhis(to) || edgeMoves(currentBlock_, to).empty()) {
+        return module_->arena.block(to).name;
     }
-    
-    auto var = std::dynamic_pointer_cast<IRVariable>(value);
-    if (var) {
-        if (var->isGlobal) {
-            return var->name;
+    std::pair<BlockId, BlockId> edge{currentBlock_, to};
+    if (std::find(edgeBlocks_.begin(), edgeBlocks_.end(), edge) == edgeBlocks_.end()) {
+        edgeBlocks_.push_back(edge);
+    }
+    return edgeLabel(currentBlock_, to);
+}
+
+std::vector<CodeGenerator::OperandMove> X64CodeGenerator::edgeMoves(BlockId from, BlockId to) {
+    std::vector<OperandMove> moves;
+    for (auto [result, incoming] : edgeCopies(from, to)) {
+        std::string dst = isDead(result) ? "" : valueToOperand(result);
+        std::string src = valueToOperand(incoming);
+        if (!dst.empty() && dst != src) {
+            moves.push_back({dst, src});
         }
-        return "[rbp - " + std::to_string(16 + var->offset) + "]";
     }
-    
-    return "rax"; // Default
+    return moves;
 }
 
-std::string X64CodeGenerator::emitBinaryOp(Opcode op, std::shared_ptr<IRValue> left, 
-                                           std::shared_ptr<IRValue> right) {
-    // Handled in emitInstruction
-    return "";
+void X64CodeGenerator::emitEdgeCopies(BlockId from, BlockId to) {
+    for (const auto& move : sequenceMoves(edgeMoves(from, to), "r11")) {
+        emitOperandMove(move.dst, move.src);
+    }
 }
 
-std::string X64CodeGenerator::emitUnaryOp(Opcode op, std::shared_ptr<IRValue> operand) {
-    // Handled in emitInstruction
-    return "";
+void X64CodeGenerator::emitOperandMove(const std::string& dst, const std::string& src) {
+    if (dst == src) return;
+    bool wideImmediate = false;
+    if (std::isdigit(static_cast<unsigned char>(src[0])) || src[0] == '-') {
+        int64_t value = std::stoll(src);
+        wideImmediate = value < INT32_MIN || value > INT32_MAX;
+    }
+    // Same restrictions as emitCopy: no memory-to-memory or imm64 store
+    if (dst.find('[') != std::string::npos &&
+        (src.find('[') != std::string::npos || wideImmediate)) {
+        emit("mov", {"rax", src});
+        emit("mov", {dst, "rax"});
+        return;
+    }
+    emit("mov", {dst, src});
 }
 
-std::string X64CodeGenerator::emitComparison(Opcode op) {
-    // Handled in emitInstruction
-    return "";
+void X64CodeGenerator::emitBranch(const char* condition, const char* inverse,
+                                  const std::string& onTrue, const std::string& onFalse) {
+    // Fall through to whichever successor is laid out next
+    if (onFalse == nextBlock_) {
+        emit(std::string("j") + condition, {onTrue});
+        return;
+    }
+    emit(std::string("j") + inverse, {onFalse});
+    if (onTrue != nextBlock_) {
+        emit("jmp", {onTrue});
+    }
 }
 
 } // namespace syclang
@@ -0,0 +1,930 @@
+#include "syclang/codegen/x64/x64_peephole.h"
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstdint>
+#include <initializer_list>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+
+namespace syclang {
+
+namespace {
+
+// Liveness bits: the sixteen general registers by encoding number, then
+// the flags
+constexpr int RAX = 0, RCX = 1, RDX = 2, RBX = 3, RSP = 4, RBP = 5, RSI = 6, RDI = 7;
+constexpr int FLAGS = 16;
+constexpr uint64_t ALL = (uint64_t{1} << 17) - 1;
+
+constexpr uint64_t bit(int number) {
+    return uint64_t{1} << number;
+}
+
+// System V: argument registers, what a call may change and what a
+// return hands back to the caller
+constexpr uint64_t ARGUMENTS = bit(RDI) | bit(RSI) | bit(RDX) | bit(RCX) | bit(8) | bit(9);
+constexpr uint64_t CALL_CLOBBERED = bit(RAX) | bit(RCX) | bit(RDX) | bit(RSI) | bit(RDI) | bit(8) |
+                                    bit(9) | bit(10) | bit(11) | bit(FLAGS);
+constexpr uint64_t RETURN_LIVE = bit(RAX) | bit(RBX) | bit(RSP) | bit(RBP) | bit(12) | bit(13) |
+                                 bit(14) | bit(15);
+
+// Windows that rename or fold across instructions look this far ahead
+constexpr int WINDOW = 32;
+constexpr int MAX_ROUNDS = 8;
+
+const char* const REGISTER_NAMES[4][16] = {
+    {"rax", "rcx", "rdx", "rbx", "rsp", "rbp", "rsi", "rdi",
+     "r8", "r9", "r10", "r11", "r12", "r13", "r14", "r15"},
+    {"eax", "ecx", "edx", "ebx", "esp", "ebp", "esi", "edi",
+     "r8d", "r9d", "r10d", "r11d", "r12d", "r13d", "r14d", "r15d"},
+    {"ax", "cx", "dx", "bx", "sp", "bp", "si", "di",
+     "r8w", "r9w", "r10w", "r11w", "r12w", "r13w", "r14w", "r15w"},
+    {"al", "cl", "dl", "bl", "spl", "bpl", "sil", "dil",
+     "r8b", "r9b", "r10b", "r11b", "r12b", "r13b", "r14b", "r15b"}};
+
+struct Register {
+    int number = -1;
+    int bytes = 0;
+};
+
+// Parsed by hand: operands are decoded millions of times per module
+Register findRegister(std::string_view name) {
+    if (name.size() < 2 || name.size() > 4) return Register();
+    // r8-r15 with an optional d/w/b suffix
+    if (name[0] == 'r' && std::isdigit(static_cast<unsigned char>(name[1]))) {
+        int number = name[1] - '0';
+        size_t end = 2;
+        if (number == 1 && name.size() > 2 && name[2] >= '0' && name[2] <= '5') {
+            number = 10 + (name[2] - '0');
+            end = 3;
+        }
+        if (number < 8) return Register();
+        if (end == name.size()) return {number, 8};
+        if (end + 1 != name.size()) return Register();
+        switch (name[end]) {
+            case 'd': return {number, 4};
+            case 'w': return {number, 2};
+            case 'b': return {number, 1};
+            default: return Register();
+        }
+    }
+    // The legacy eight: a two-letter stem with a size prefix or suffix
+    int bytes = 2;
+    std::string_view stem = name;
+    if (name.size() == 3 && (name[0] == 'r' || name[0] == 'e')) {
+        bytes = name[0] == 'r' ? 8 : 4;
+        stem = name.substr(1);
+    } else if (name.size() == 3 && name[2] == 'l') {
+        bytes = 1; // spl, bpl, sil, dil
+        stem = name.substr(0, 2);
+        if (stem != "sp" && stem != "bp" && stem != "si" && stem != "di") return Register();
+    } else if (name.size() == 2 && name[1] == 'l') {
+        bytes = 1; // al, cl, dl, bl
+        stem = std::string_view(name.data(), 1);
+    } else if (name.size() != 2) {
+        return Register();
+    }
+    static constexpr std::string_view STEMS[8] = {"ax", "cx", "dx", "bx", "sp", "bp", "si", "di"};
+    for (int number = 0; number < 8; ++number) {
+        std::string_view candidate = STEMS[number];
+        if (bytes == 1 && stem.size() == 1 ? candidate[0] == stem[0] && number < 4 : candidate == stem) {
+            return {number, bytes};
+        }
+    }
+    return Register();
+}
+
+// Number of a 64-bit register operand, or -1
+int fullRegister(std::string_view operand) {
+    Register reg = findRegister(operand);
+    return reg.bytes == 8 ? reg.number : -1;
+}
+
+bool isMemory(std::string_view operand) {
+    return operand.find('[') != std::string_view::npos;
+}
+
+bool isQuadword(std::string_view operand) {
+    return operand.substr(0, 10) == "qword ptr " && isMemory(operand);
+}
+
+std::optional<int64_t> immediate(std::string_view operand) {
+    if (operand.empty() || !(std::isdigit(static_cast<unsigned char>(operand[0])) || operand[0] == '-')) {
+        return std::nullopt;
+    }
+    int64_t value = 0;
+    auto [end, error] = std::from_chars(operand.data(), operand.data() + operand.size(), value);
+    if (error != std::errc() || end != operand.data() + operand.size()) return std::nullopt;
+    return value;
+}
+
+bool fitsInt32(int64_t value) {
+    return value >= INT32_MIN && value <= INT32_MAX;
+}
+
+std::optional<int64_t> immediate32(std::string_view operand) {
+    auto value = immediate(operand);
+    return value && fitsInt32(*value) ? value : std::nullopt;
+}
+
+// Call f(offset, length, register) for each register an operand names:
+// the operand itself, or an address's base and index. Rip-relative
+// addresses name a symbol, not a register.
+template <typename F>
+void forEachRegister(std::string_view operand, F&& f) {
+    size_t open = operand.find('[');
+    if (open == std::string_view::npos) {
+        Register reg = findRegister(operand);
+        if (reg.number >= 0) f(0, operand.size(), reg);
+        return;
+    }
+    if (operand.find("rip", open) != std::string_view::npos) return;
+    for (size_t i = open + 1; i < operand.size();) {
+        if (!std::isalnum(static_cast<unsigned char>(operand[i]))) {
+            ++i;
+            continue;
+        }
+        size_t end = i;
+        while (end < operand.size() && std::isalnum(static_cast<unsigned char>(operand[end]))) ++end;
+        Register reg = findRegister(operand.substr(i, end - i));
+        if (reg.number >= 0) f(i, end - i, reg);
+        i = end;
+    }
+}
+
+uint64_t registersIn(std::string_view operand) {
+    uint64_t mask = 0;
+    forEachRegister(operand, [&](size_t, size_t, Register reg) { mask |= bit(reg.number); });
+    return mask;
+}
+
+uint64_t mentioned(const MachineInstruction& inst) {
+    uint64_t mask = 0;
+    for (const std::string& operand : inst.operands) mask |= registersIn(operand);
+    return mask;
+}
+
+// Registers `inst` names by a narrower view than their 64-bit name
+uint64_t namedNarrow(const MachineInstruction& inst) {
+    uint64_t mask = 0;
+    for (const std::string& operand : inst.operands) {
+        forEachRegister(operand, [&](size_t, size_t, Register reg) {
+            if (reg.bytes != 8) mask |= bit(reg.number);
+        });
+    }
+    return mask;
+}
+
+void renameRegister(MachineInstruction& inst, int from, int to) {
+    for (std::string& operand : inst.operands) {
+        std::string renamed;
+        size_t copied = 0;
+        forEachRegister(operand, [&](size_t offset, size_t length, Register reg) {
+            if (reg.number != from) return;
+            renamed.append(operand, copied, offset - copied);
+            renamed += REGISTER_NAMES[0][to];
+            copied = offset + length;
+        });
+        if (copied > 0) {
+            renamed.append(operand, copied, std::string::npos);
+            operand = std::move(renamed);
+        }
+    }
+}
+
+bool isConditionCode(std::string_view code) {
+    static const std::unordered_set<std::string_view> codes = {
+        "o", "no", "b", "c", "nae", "ae", "nb", "nc", "e", "z", "ne", "nz", "be", "na", "a", "nbe",
+        "s", "ns", "p", "pe", "np", "po", "l", "nge", "ge", "nl", "le", "ng", "g", "nle"};
+    return codes.count(code) > 0;
+}
+
+bool isArithmetic(std::string_view mnemonic) {
+    return mnemonic == "add" || mnemonic == "sub" || mnemonic == "and" || mnemonic == "or" ||
+           mnemonic == "xor" || mnemonic == "adc" || mnemonic == "sbb";
+}
+
+bool isShift(std::string_view mnemonic) {
+    return mnemonic == "shl" || mnemonic == "sal" || mnemonic == "shr" || mnemonic == "sar" ||
+           mnemonic == "rol" || mnemonic == "ror";
+}
+
+// Registers and flags `inst` reads and writes. `known` is false for
+// instructions outside the modelled subset (vector code), which are
+// assumed to read everything.
+RegisterEffects effectsOf(const MachineInstruction& inst, bool& known) {
+    RegisterEffects e;
+    known = true;
+    const std::string& m = inst.mnemonic;
+    const std::vector<std::string>& ops = inst.operands;
+    size_t count = ops.size();
+    auto unknown = [&] {
+        known = false;
+        e = RegisterEffects();
+        e.uses = ALL;
+    };
+    // A written operand: registers narrower than 32 bits keep their
+    // upper bits, so they are read as well
+    auto destination = [&](const std::string& operand) {
+        if (isMemory(operand)) {
+            e.uses |= registersIn(operand);
+            e.pure = false;
+            return;
+        }
+        Register reg = findRegister(operand);
+        if (reg.number < 0) {
+            unknown();
+            return;
+        }
+        e.defs |= bit(reg.number);
+        if (reg.bytes < 4) e.uses |= bit(reg.number);
+    };
+
+    if ((m == "mov" || m == "movzx" || m == "movsx" || m == "movsxd" || m == "lea") && count == 2) {
+        e.pure = true;
+        e.uses |= registersIn(ops[1]);
+        destination(ops[0]);
+    } else if (isArithmetic(m) && count == 2) {
+        e.pure = true;
+        e.uses |= registersIn(ops[0]) | registersIn(ops[1]);
+        Register reg = findRegister(ops[0]);
+        if ((m == "xor" || m == "sub") && ops[0] == ops[1] && reg.bytes >= 4) {
+            e.uses = 0; // Zeroing idiom
+        }
+        if (m == "adc" || m == "sbb") e.uses |= bit(FLAGS);
+        destination(ops[0]);
+        e.defs |= bit(FLAGS);
+    } else if ((m == "cmp" || m == "test") && count == 2) {
+        e.pure = true;
+        e.uses |= registersIn(ops[0]) | registersIn(ops[1]);
+        e.defs |= bit(FLAGS);
+    } else if ((m == "imul" || m == "mul") && count == 1) {
+        e.pure = true;
+        e.uses |= bit(RAX) | registersIn(ops[0]);
+        e.defs |= bit(RAX) | bit(RDX) | bit(FLAGS);
+    } else if (m == "imul" && (count == 2 || count == 3)) {
+        e.pure = true;
+        e.uses |= registersIn(ops[1]) | (count == 2 ? registersIn(ops[0]) : 0);
+        destination(ops[0]);
+        e.defs |= bit(FLAGS);
+    } else if ((m == "div" || m == "idiv") && count == 1) {
+        e.uses |= bit(RAX) | bit(RDX) | registersIn(ops[0]);
+        e.defs |= bit(RAX) | bit(RDX) | bit(FLAGS);
+    } else if (isShift(m) && count == 2) {
+        e.pure = true;
+        e.uses |= registersIn(ops[0]);
+        if (ops[1] == "cl") {
+            // A zero count leaves the flags as they were
+            e.uses |= bit(RCX) | bit(FLAGS);
+            e.defs |= bit(FLAGS);
+        } else if (auto amount = immediate(ops[1])) {
+            if ((*amount & (findRegister(ops[0]).bytes == 8 ? 63 : 31)) != 0) {
+                e.defs |= bit(FLAGS);
+                if (m == "rol" || m == "ror") e.uses |= bit(FLAGS);
+            }
+        } else {
+            unknown();
+            return e;
+        }
+        destination(ops[0]);
+    } else if ((m == "neg" || m == "not" || m == "inc" || m == "dec") && count == 1) {
+        e.pure = true;
+        e.uses |= registersIn(ops[0]);
+        destination(ops[0]);
+        if (m == "neg") e.defs |= bit(FLAGS);
+        if (m == "inc" || m == "dec") {
+            e.uses |= bit(FLAGS); // They keep the carry flag
+            e.defs |= bit(FLAGS);
+        }
+    } else if ((m == "cqo" || m == "cdq") && count == 0) {
+        e.pure = true;
+        e.uses |= bit(RAX);
+        e.defs |= bit(RDX);
+    } else if (m.size() > 3 && m.compare(0, 3, "set") == 0 && isConditionCode(m.substr(3)) && count == 1) {
+        e.pure = true;
+        e.uses |= bit(FLAGS);
+        destination(ops[0]);
+    } else if (m.size() > 4 && m.compare(0, 4, "cmov") == 0 && isConditionCode(m.substr(4)) && count == 2) {
+        e.pure = true;
+        e.uses |= bit(FLAGS) | registersIn(ops[0]) | registersIn(ops[1]);
+        destination(ops[0]);
+    } else if (m == "jmp" && count == 1) {
+        if (isMemory(ops[0]) || findRegister(ops[0]).number >= 0) {
+            unknown();
+        } else {
+            e.branches = true;
+            e.target = ops[0];
+        }
+        e.fallsThrough = false;
+    } else if (m.size() > 1 && m[0] == 'j' && isConditionCode(m.substr(1)) && count == 1) {
+        e.uses |= bit(FLAGS);
+        e.branches = true;
+        e.target = ops[0];
+    } else if (m == "call" && count == 1) {
+        e.uses |= ARGUMENTS | bit(RAX) | bit(RSP) | registersIn(ops[0]);
+        e.defs |= CALL_CLOBBERED;
+    } else if (m == "ret" && count == 0) {
+        e.uses |= RETURN_LIVE;
+        e.fallsThrough = false;
+    } else if (m == "push" && count == 1) {
+        e.uses |= bit(RSP) | registersIn(ops[0]);
+        e.defs |= bit(RSP);
+    } else if (m == "pop" && count == 1) {
+        e.uses |= bit(RSP);
+        e.defs |= bit(RSP);
+        destination(ops[0]);
+        e.pure = false;
+    } else if (m == "leave" && count == 0) {
+        e.uses |= bit(RBP);
+        e.defs |= bit(RSP) | bit(RBP);
+    } else if (m == "nop" || m == "vzeroupper") {
+        // Leaves the general registers alone
+    } else {
+        unknown();
+    }
+    // The stack and frame pointers are never dead: spill slots, saved
+    // registers and the return address hang off them
+    if (e.defs & (bit(RSP) | bit(RBP))) e.pure = false;
+    return e;
+}
+
+MachineInstruction makeInstruction(std::string mnemonic, std::initializer_list<std::string> operands) {
+    MachineInstruction inst;
+    inst.mnemonic = std::move(mnemonic);
+    inst.operands = operands;
+    return inst;
+}
+
+// Address text for base + index * scale + displacement
+std::string address(int base, int index, int scale, int64_t displacement) {
+    std::string text = "[";
+    if (base >= 0) text += REGISTER_NAMES[0][base];
+    if (index >= 0) {
+        if (base >= 0) text += " + ";
+        text += REGISTER_NAMES[0][index];
+        if (scale > 1) text += "*" + std::to_string(scale);
+    }
+    if (displacement != 0) {
+        text += displacement < 0 ? " - " : " + ";
+        text += std::to_string(displacement < 0 ? -displacement : displacement);
+    }
+    return text + "]";
+}
+
+class X64Peephole {
+public:
+    explicit X64Peephole(std::vector<MachineInstruction>& code) : code_(code) {}
+
+    PeepholeStats run() {
+        size_t before = countInstructions();
+        stats_.instructions = before;
+
+        // Rewrites that delete instructions feed each other (a push/pop
+        // pair becomes a copy that a rename then absorbs), so they run to
+        // a fixed point. Each sweep uses the liveness computed before it:
+        // every rewrite reads no register that was not read before, so
+        // the facts stay safe (if pessimistic) outside the windows already
+        // rewritten, which a sweep never revisits.
+        for (int round = 0; round < MAX_ROUNDS; ++round) {
+            analyze();
+            size_t dead = removeDeadWrites(code_, effects_, live_);
+            stats_.deadWrites += dead;
+            bool changed = sweep(&X64Peephole::simplify) || dead > 0;
+            if (!changed) break;
+        }
+        // Then shorter encodings of what is left
+        analyze();
+        sweep(&X64Peephole::shorten);
+
+        stats_.removed = before - countInstructions();
+        return stats_;
+    }
+
+private:
+    static constexpr size_t NONE = static_cast<size_t>(-1);
+
+    std::vector<MachineInstruction>& code_;
+    std::vector<RegisterEffects> effects_;
+    std::vector<char> known_;
+    std::vector<uint64_t> named_;  // Registers the operands name
+    std::vector<uint64_t> narrow_; // Of those, the ones named by a narrower view
+    std::vector<uint64_t> live_;
+    std::vector<char> stale_; // Rewritten since analyze() last saw them
+    PeepholeStats stats_;
+
+    size_t countInstructions() const {
+        size_t count = 0;
+        for (const MachineInstruction& inst : code_) count += inst.isInstruction();
+        return count;
+    }
+
+    // Effects of the instructions rewritten since the last call (all of
+    // them the first time), then liveness over the whole function
+    void analyze() {
+        if (stale_.size() != code_.size()) {
+            stale_.assign(code_.size(), 1);
+            effects_.assign(code_.size(), RegisterEffects());
+            known_.assign(code_.size(), 0);
+            named_.assign(code_.size(), 0);
+            narrow_.assign(code_.size(), 0);
+        }
+        for (size_t i = 0; i < code_.size(); ++i) {
+            if (!stale_[i]) continue;
+            stale_[i] = 0;
+            bool known = false;
+            effects_[i] = code_[i].isInstruction() ? effectsOf(code_[i], known) : RegisterEffects();
+            known_[i] = known;
+            named_[i] = code_[i].isInstruction() ? mentioned(code_[i]) : 0;
+            narrow_[i] = code_[i].isInstruction() ? namedNarrow(code_[i]) : 0;
+        }
+        live_ = liveAfter(code_, effects_, ALL);
+    }
+
+    // Apply `rule` at each instruction, resuming after the window it
+    // rewrote; true if anything changed. A rule rewrites nothing outside
+    // [i, end], so only that window needs its effects recomputed.
+    bool sweep(size_t (X64Peephole::*rule)(size_t)) {
+        bool changed = false;
+        for (size_t i = 0; i < code_.size(); ++i) {
+            if (!code_[i].isInstruction()) continue;
+            size_t end = (this->*rule)(i);
+            if (end != NONE) {
+                changed = true;
+                std::fill(stale_.begin() + i, stale_.begin() + end + 1, 1);
+                i = end;
+            }
+        }
+        return changed;
+    }
+
+    // The next line after `i` that is not a removed instruction
+    size_t next(size_t i) const {
+        size_t j = i + 1;
+        while (j < code_.size() && code_[j].kind == MachineInstruction::Kind::INSTRUCTION &&
+               code_[j].removed) {
+            ++j;
+        }
+        return j;
+    }
+
+    // An instruction in straight-line code: not a label, a branch or an
+    // unmodelled instruction
+    bool straight(size_t j) const {
+        return j < code_.size() && code_[j].isInstruction() && known_[j] && !effects_[j].branches &&
+               effects_[j].fallsThrough;
+    }
+
+    bool deadAfter(size_t i, int reg) const {
+        return (live_[i] & bit(reg)) == 0;
+    }
+
+    uint64_t touched(size_t j) const {
+        return effects_[j].uses | effects_[j].defs | named_[j];
+    }
+
+    // `reg` may be renamed in instruction j: named only in full and never
+    // read or written implicitly
+    bool renamable(size_t j, int reg) const {
+        uint64_t implicit = (effects_[j].uses | effects_[j].defs) & ~named_[j];
+        return ((narrow_[j] | implicit) & bit(reg)) == 0;
+    }
+
+    void remove(size_t i) {
+        code_[i].removed = true;
+    }
+
+    size_t simplify(size_t i) {
+        for (auto rule : {&X64Peephole::selfMove, &X64Peephole::repeatedMove, &X64Peephole::identity,
+                          &X64Peephole::pushPop, &X64Peephole::forwardStore, &X64Peephole::loadOpStore,
+                          &X64Peephole::loadOp, &X64Peephole::foldImmediate,
+                          &X64Peephole::coalesceBackward, &X64Peephole::coalesceForward}) {
+            size_t end = (this->*rule)(i);
+            if (end != NONE) return end;
+        }
+        return NONE;
+    }
+
+    size_t shorten(size_t i) {
+        for (auto rule : {&X64Peephole::leaAdd, &X64Peephole::leaShiftAdd, &X64Peephole::multiply,
+                          &X64Peephole::testZero, &X64Peephole::narrowImmediate}) {
+            size_t end = (this->*rule)(i);
+            if (end != NONE) return end;
+        }
+        return NONE;
+    }
+
+    // mov r, r
+    size_t selfMove(size_t i) {
+        const MachineInstruction& inst = code_[i];
+        if (inst.mnemonic != "mov" || inst.operands.size() != 2 || fullRegister(inst.operands[0]) < 0 ||
+            inst.operands[0] != inst.operands[1]) {
+            return NONE;
+        }
+        remove(i);
+        ++stats_.redundantMoves;
+        return i;
+    }
+
+    // mov a, b then mov b, a or mov a, b again: the second copies nothing
+    size_t repeatedMove(size_t i) {
+        const MachineInstruction& inst = code_[i];
+        if (inst.mnemonic != "mov" || inst.operands.size() != 2 || fullRegister(inst.operands[0]) < 0 ||
+            fullRegister(inst.operands[1]) < 0) {
+            return NONE;
+        }
+        size_t j = next(i);
+        if (j >= code_.size() || !code_[j].isInstruction()) return NONE;
+        const MachineInstruction& second = code_[j];
+        if (second.mnemonic != "mov" || second.operands.size() != 2) return NONE;
+        bool swapped = second.operands[0] == inst.operands[1] && second.operands[1] == inst.operands[0];
+        bool repeated = second.operands == inst.operands;
+        if (!swapped && !repeated) return NONE;
+        remove(j);
+        ++stats_.redundantMoves;
+        return j;
+    }
+
+    // add/sub/or/xor r, 0, and r, -1, imul r, 1 and shifts by 0, when
+    // nothing reads their flags
+    size_t identity(size_t i) {
+        const MachineInstruction& inst = code_[i];
+        const auto& ops = inst.operands;
+        if (ops.empty() || fullRegister(ops[0]) < 0 || (live_[i] & bit(FLAGS))) return NONE;
+        auto value = immediate(ops.back());
+        if (!value) return NONE;
+        bool noop = false;
+        if (ops.size() == 2 && (inst.mnemonic == "add" || inst.mnemonic == "sub" || inst.mnemonic == "or" ||
+                                inst.mnemonic == "xor")) {
+            noop = *value == 0;
+        } else if (ops.size() == 2 && inst.mnemonic == "and") {
+            noop = *value == -1;
+        } else if (inst.mnemonic == "imul") {
+            noop = *value == 1 && (ops.size() == 2 || ops[1] == ops[0]);
+        } else if (ops.size() == 2 && isShift(inst.mnemonic)) {
+            noop = (*value & 63) == 0;
+        }
+        if (!noop) return NONE;
+        remove(i);
+        ++stats_.redundantMoves;
+        return i;
+    }
+
+    // push x ... pop y, with nothing between touching the stack: a copy,
+    // placed where the pop was if x is unchanged by then, or where the
+    // push was if nothing between touches y
+    size_t pushPop(size_t i) {
+        const MachineInstruction& push = code_[i];
+        if (push.mnemonic != "push" || push.operands.size() != 1) return NONE;
+        const std::string& source = push.operands[0];
+        uint64_t sourceRegisters = registersIn(source);
+        uint64_t between = 0;
+        bool sourceKept = true;
+        size_t j = next(i);
+        for (int steps = 0; steps < WINDOW; ++steps, j = next(j)) {
+            if (j >= code_.size() || !code_[j].isInstruction()) return NONE;
+            if (code_[j].mnemonic == "pop") break;
+            if (!straight(j) || (touched(j) & bit(RSP))) return NONE;
+            between |= touched(j);
+            sourceKept = sourceKept && (effects_[j].defs & sourceRegisters) == 0 &&
+                         (!isMemory(source) || effects_[j].pure);
+        }
+        if (j >= code_.size() || code_[j].mnemonic != "pop" || code_[j].operands.size() != 1) return NONE;
+        int target = fullRegister(code_[j].operands[0]);
+        if (target < 0) return NONE;
+        if (source == code_[j].operands[0] && sourceKept) {
+            remove(i);
+            remove(j);
+        } else if (sourceKept) {
+            code_[j] = makeInstruction("mov", {code_[j].operands[0], source});
+            remove(i);
+        } else if ((between & bit(target)) == 0) {
+            code_[i] = makeInstruction("mov", {code_[j].operands[0], source});
+            remove(j);
+        } else {
+            return NONE;
+        }
+        ++stats_.redundantMoves;
+        return j;
+    }
+
+    // mov [m], r then mov t, [m]: the load reads r
+    size_t forwardStore(size_t i) {
+        const MachineInstruction& store = code_[i];
+        if (store.mnemonic != "mov" || store.operands.size() != 2 || !isQuadword(store.operands[0])) {
+            return NONE;
+        }
+        const std::string& value = store.operands[1];
+        if (fullRegister(value) < 0 && !immediate32(value)) return NONE;
+        size_t j = next(i);
+        if (j >= code_.size() || !code_[j].isInstruction()) return NONE;
+        MachineInstruction& load = code_[j];
+        if (load.mnemonic != "mov" || load.operands.size() != 2 || fullRegister(load.operands[0]) < 0 ||
+            load.operands[1] != store.operands[0]) {
+            return NONE;
+        }
+        if (load.operands[0] == value) {
+            remove(j);
+        } else {
+            load.operands[1] = value;
+        }
+        ++stats_.memoryCombined;
+        return j;
+    }
+
+    // mov t, [m]; op t, s; mov [m], t -> op [m], s
+    size_t loadOpStore(size_t i) {
+        const MachineInstruction& load = code_[i];
+        if (load.mnemonic != "mov" || load.operands.size() != 2 || !isQuadword(load.operands[1])) return NONE;
+        int t = fullRegister(load.operands[0]);
+        const std::string& memory = load.operands[1];
+        if (t < 0 || (registersIn(memory) & bit(t))) return NONE;
+        size_t j = next(i);
+        if (j >= code_.size() || !code_[j].isInstruction()) return NONE;
+        const MachineInstruction& op = code_[j];
+        if (!isArithmetic(op.mnemonic) || op.mnemonic == "adc" || op.mnemonic == "sbb" ||
+            op.operands.size() != 2 || op.operands[0] != load.operands[0]) {
+            return NONE;
+        }
+        const std::string& source = op.operands[1];
+        int s = fullRegister(source);
+        if ((s < 0 || s == t) && !immediate32(source)) return NONE;
+        size_t k = next(j);
+        if (k >= code_.size() || !code_[k].isInstruction()) return NONE;
+        const MachineInstruction& store = code_[k];
+        if (store.mnemonic != "mov" || store.operands.size() != 2 || store.operands[0] != memory ||
+            store.operands[1] != load.operands[0] || !deadAfter(k, t)) {
+            return NONE;
+        }
+        code_[i] = makeInstruction(op.mnemonic, {memory, source});
+        remove(j);
+        remove(k);
+        ++stats_.memoryCombined;
+        return k;
+    }
+
+    // mov t, [m] then an instruction reading t once: it reads [m] instead
+    size_t loadOp(size_t i) {
+        const MachineInstruction& load = code_[i];
+        if (load.mnemonic != "mov" || load.operands.size() != 2 || !isQuadword(load.operands[1])) return NONE;
+        int t = fullRegister(load.operands[0]);
+        const std::string& memory = load.operands[1];
+        if (t < 0 || (registersIn(memory) & bit(t))) return NONE;
+        size_t j = next(i);
+        if (j >= code_.size() || !code_[j].isInstruction() || !deadAfter(j, t)) return NONE;
+        MachineInstruction& user = code_[j];
+        const auto& ops = user.operands;
+        const std::string& m = user.mnemonic;
+        bool binary = isArithmetic(m) || m == "cmp" || m == "imul" || m == "mov";
+        if (binary && ops.size() == 2 && ops[1] == load.operands[0] && fullRegister(ops[0]) >= 0 &&
+            ops[0] != ops[1]) {
+            user.operands[1] = memory; // op r, t
+            if (m == "mov") ++stats_.redundantMoves;
+            else ++stats_.memoryCombined;
+        } else if (m == "cmp" && ops.size() == 2 && ops[0] == load.operands[0] &&
+                   ((fullRegister(ops[1]) >= 0 && ops[1] != ops[0]) || immediate32(ops[1]))) {
+            user.operands[0] = memory; // cmp t, s
+            ++stats_.memoryCombined;
+        } else if (m == "push" && ops.size() == 1 && ops[0] == load.operands[0]) {
+            user.operands[0] = memory;
+            ++stats_.memoryCombined;
+        } else {
+            return NONE;
+        }
+        remove(i);
+        return j;
+    }
+
+    // mov t, imm then the next instruction touching t reads it as its
+    // last operand, and t dies there: the constant goes in its place
+    size_t foldImmediate(size_t i) {
+        const MachineInstruction& load = code_[i];
+        if (load.mnemonic != "mov" || load.operands.size() != 2) return NONE;
+        int t = fullRegister(load.operands[0]);
+        auto value = immediate32(load.operands[1]);
+        if (t < 0 || !value) return NONE;
+        const std::string& reg = load.operands[0];
+        size_t k = next(i);
+        for (int steps = 0; steps < WINDOW && straight(k) && !(touched(k) & bit(t)); ++steps) {
+            k = next(k);
+        }
+        if (!straight(k) || !deadAfter(k, t) || (effects_[k].defs & bit(t)) ||
+            (effects_[k].uses & ~named_[k] & bit(t))) {
+            return NONE;
+        }
+        MachineInstruction& user = code_[k];
+        auto& ops = user.operands;
+        const std::string& m = user.mnemonic;
+        if (ops.empty() || ops.back() != reg) return NONE;
+        for (size_t o = 0; o + 1 < ops.size(); ++o) {
+            if (registersIn(ops[o]) & bit(t)) return NONE;
+        }
+        bool wide = ops.size() == 2 && (fullRegister(ops[0]) >= 0 || isQuadword(ops[0]));
+        if ((isArithmetic(m) || m == "cmp" || m == "mov") && wide) {
+            ops[1] = load.operands[1];
+        } else if (m == "imul" && ops.size() == 2 && fullRegister(ops[0]) >= 0) {
+            user = makeInstruction("imul", {ops[0], ops[0], load.operands[1]});
+        } else if (m == "push" && ops.size() == 1) {
+            ops[0] = load.operands[1];
+        } else {
+            return NONE;
+        }
+        remove(i);
+        ++stats_.foldedImmediates;
+        return k;
+    }
+
+    // An instruction that only defines t, then code that copies t to y
+    // where t dies: compute in y directly. y must be untouched between.
+    size_t coalesceBackward(size_t i) {
+        const MachineInstruction& def = code_[i];
+        if (def.operands.empty() || !effects_[i].pure || !known_[i]) return NONE;
+        int t = fullRegister(def.operands[0]);
+        if (t < 0 || t == RSP || t == RBP || !(effects_[i].defs & bit(t)) || (effects_[i].uses & bit(t)) ||
+            !renamable(i, t)) {
+            return NONE;
+        }
+        uint64_t between = 0;
+        size_t k = next(i);
+        for (int steps = 0; steps < WINDOW && straight(k); ++steps, k = next(k)) {
+            const MachineInstruction& inst = code_[k];
+            if (inst.mnemonic == "mov" && inst.operands.size() == 2 && inst.operands[1] == def.operands[0] &&
+                deadAfter(k, t)) {
+                int y = fullRegister(inst.operands[0]);
+                if (y < 0 || y == t || y == RSP || y == RBP || (between & bit(y)) ||
+                    (effects_[i].defs & ~bit(t) & bit(y))) {
+                    return NONE;
+                }
+                for (size_t j = i; j < k; j = next(j)) renameRegister(code_[j], t, y);
+                remove(k);
+                ++stats_.redundantMoves;
+                return k;
+            }
+            if (!renamable(k, t) || deadAfter(k, t)) return NONE;
+            between |= touched(k);
+        }
+        return NONE;
+    }
+
+    // mov t, x where x dies: use x in t's place until t dies
+    size_t coalesceForward(size_t i) {
+        const MachineInstruction& copy = code_[i];
+        if (copy.mnemonic != "mov" || copy.operands.size() != 2) return NONE;
+        int t = fullRegister(copy.operands[0]);
+        int x = fullRegister(copy.operands[1]);
+        if (t < 0 || x < 0 || t == x || t == RSP || t == RBP || x == RSP || x == RBP || !deadAfter(i, x)) {
+            return NONE;
+        }
+        size_t k = next(i);
+        for (int steps = 0; steps < WINDOW && straight(k); ++steps, k = next(k)) {
+            if ((touched(k) & bit(x)) || !renamable(k, t)) return NONE;
+            if (deadAfter(k, t)) {
+                for (size_t j = next(i); j <= k; j = next(j)) renameRegister(code_[j], t, x);
+                remove(i);
+                ++stats_.redundantMoves;
+                return k;
+            }
+        }
+        return NONE;
+    }
+
+    // mov t, a; add t, b -> lea t, [a + b] (also add/sub of a constant)
+    size_t leaAdd(size_t i) {
+        const MachineInstruction& copy = code_[i];
+        if (copy.mnemonic != "mov" || copy.operands.size() != 2) return NONE;
+        int t = fullRegister(copy.operands[0]);
+        int a = fullRegister(copy.operands[1]);
+        if (t < 0 || a < 0 || t == a) return NONE;
+        size_t j = next(i);
+        if (!straight(j) || (live_[j] & bit(FLAGS))) return NONE;
+        const MachineInstruction& op = code_[j];
+        if ((op.mnemonic != "add" && op.mnemonic != "sub") || op.operands.size() != 2 ||
+            op.operands[0] != copy.operands[0]) {
+            return NONE;
+        }
+        std::string target;
+        int b = fullRegister(op.operands[1]);
+        if (auto value = immediate32(op.operands[1])) {
+            if (op.mnemonic == "sub" && *value == INT32_MIN) return NONE;
+            target = address(a, -1, 1, op.mnemonic == "sub" ? -*value : *value);
+        } else if (op.mnemonic == "add" && b >= 0 && b != t) {
+            if (b == RSP) std::swap(a, b);
+            if (b == RSP) return NONE;
+            target = address(a, b, 1, 0);
+        } else {
+            return NONE;
+        }
+        code_[i] = makeInstruction("lea", {REGISTER_NAMES[0][t], target});
+        remove(j);
+        ++stats_.shorterForms;
+        return j;
+    }
+
+    // mov t, a; shl t, 1..3; add t, b -> lea t, [b + a*2..8]
+    size_t leaShiftAdd(size_t i) {
+        const MachineInstruction& copy = code_[i];
+        if (copy.mnemonic != "mov" || copy.operands.size() != 2) return NONE;
+        int t = fullRegister(copy.operands[0]);
+        int a = fullRegister(copy.operands[1]);
+        if (t < 0 || a < 0 || t == a || a == RSP) return NONE;
+        size_t j = next(i);
+        if (!straight(j)) return NONE;
+        const MachineInstruction& shift = code_[j];
+        auto amount = shift.operands.size() == 2 ? immediate(shift.operands[1]) : std::nullopt;
+        if ((shift.mnemonic != "shl" && shift.mnemonic != "sal") || shift.operands[0] != copy.operands[0] ||
+            !amount || *amount < 1 || *amount > 3) {
+            return NONE;
+        }
+        size_t k = next(j);
+        if (!straight(k) || (live_[k] & bit(FLAGS))) return NONE;
+        const MachineInstruction& add = code_[k];
+        if (add.mnemonic != "add" || add.operands.size() != 2 || add.operands[0] != copy.operands[0]) {
+            return NONE;
+        }
+        int b = fullRegister(add.operands[1]);
+        if (b < 0 || b == t) return NONE;
+        code_[i] = makeInstruction("lea", {REGISTER_NAMES[0][t], address(b, a, 1 << *amount, 0)});
+        remove(j);
+        remove(k);
+        ++stats_.shorterForms;
+        return k;
+    }
+
+    // imul by 2, 3, 5 or 9 -> lea; mov t, a; imul t, c -> imul t, a, c
+    size_t multiply(size_t i) {
+        MachineInstruction& inst = code_[i];
+        const auto& ops = inst.operands;
+        if (inst.mnemonic == "mov" && ops.size() == 2) {
+            int t = fullRegister(ops[0]);
+            int a = fullRegister(ops[1]);
+            size_t j = next(i);
+            if (t < 0 || a < 0 || t == a || !straight(j)) return NONE;
+            const MachineInstruction& mul = code_[j];
+            if (mul.mnemonic != "imul" || mul.operands.size() != 2 || mul.operands[0] != ops[0] ||
+                !immediate32(mul.operands[1])) {
+                return NONE;
+            }
+            code_[j] = makeInstruction("imul", {ops[0], ops[1], mul.operands[1]});
+            remove(i);
+            ++stats_.shorterForms;
+            multiply(j); // The three-operand form may become lea as well
+            return j;
+        }
+        if (inst.mnemonic != "imul" || (ops.size() != 2 && ops.size() != 3) || (live_[i] & bit(FLAGS))) {
+            return NONE;
+        }
+        int t = fullRegister(ops[0]);
+        int a = fullRegister(ops.size() == 3 ? ops[1] : ops[0]);
+        auto factor = immediate(ops.back());
+        if (t < 0 || a < 0 || a == RSP || !factor) return NONE;
+        if (*factor == 2) {
+            inst = makeInstruction("lea", {REGISTER_NAMES[0][t], address(a, a, 1, 0)});
+        } else if (*factor == 3 || *factor == 5 || *factor == 9) {
+            inst = makeInstruction("lea", {REGISTER_NAMES[0][t], address(a, a, static_cast<int>(*factor - 1), 0)});
+        } else {
+            return NONE;
+        }
+        ++stats_.shorterForms;
+        return i;
+    }
+
+    // cmp r, 0 -> test r, r
+    size_t testZero(size_t i) {
+        MachineInstruction& inst = code_[i];
+        if (inst.mnemonic != "cmp" || inst.operands.size() != 2 || inst.operands[1] != "0" ||
+            findRegister(inst.operands[0]).number < 0) {
+            return NONE;
+        }
+        inst = makeInstruction("test", {inst.operands[0], inst.operands[0]});
+        ++stats_.shorterForms;
+        return i;
+    }
+
+    // mov r64, 0 -> xor r32, r32 where the flags are dead; other
+    // constants below 2^32 -> mov r32, imm (writing r32 clears the rest)
+    size_t narrowImmediate(size_t i) {
+        MachineInstruction& inst = code_[i];
+        if (inst.mnemonic != "mov" || inst.operands.size() != 2) return NONE;
+        int r = fullRegister(inst.operands[0]);
+        auto value = immediate(inst.operands[1]);
+        if (r < 0 || !value || *value < 0 || *value > 0xFFFFFFFFLL) return NONE;
+        std::string narrow = REGISTER_NAMES[1][r];
+        if (*value == 0 && !(live_[i] & bit(FLAGS))) {
+            inst = makeInstruction("xor", {narrow, narrow});
+        } else {
+            inst = makeInstruction("mov", {narrow, inst.operands[1]});
+        }
+        ++stats_.shorterForms;
+        return i;
+    }
+};
+
+} // namespace
+
+PeepholeStats peepholeX64(std::vector<MachineInstruction>& code) {
+    return X64Peephole(code).run();
+}
+
+} // namespace syclang
@@ -0,0 +1,178 @@
+#include "syclang/compile_cache.h"
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <thread>
+
+namespace syclang {
+
+namespace {
+
+// Bumped whenever the entry layout changes
+constexpr char ENTRY_MAGIC[8] = {'S', 'Y', 'C', 'C', 1, 0, 0, 0};
+constexpr size_t HASH_DIGITS = 32;
+constexpr size_t HEADER_SIZE = sizeof(ENTRY_MAGIC) + 8 + HASH_DIGITS;
+
+uint64_t rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+uint64_t fmix(uint64_t k) {
+    k ^= k >> 33;
+    k *= 0xFF51AFD7ED558CCDull;
+    k ^= k >> 33;
+    k *= 0xC4CEB9FE1A85EC53ull;
+    k ^= k >> 33;
+    return k;
+}
+
+uint64_t load64(const unsigned char* p) {
+    uint64_t value = 0;
+    for (int i = 7; i >= 0; --i) value = value << 8 | p[i];
+    return value;
+}
+
+// The executable, or when it cannot be read, the time this file was built
+const std::string& compilerIdentity() {
+    static const std::string identity = [] {
+        std::ifstream file("/proc/self/exe", std::ios::binary | std::ios::ate);
+        if (file) {
+            std::string bytes(static_cast<size_t>(file.tellg()), '\0');
+            file.seekg(0);
+            if (file.read(bytes.data(), static_cast<std::streamsize>(bytes.size())) && !bytes.empty()) {
+                return hashContent(bytes);
+            }
+        }
+        return std::string("SysLang " __DATE__ " " __TIME__);
+    }();
+    return identity;
+}
+
+// Unique among every thread and process writing the same entry
+std::string temporarySuffix() {
+    static std::atomic<uint64_t> counter{0};
+    uint64_t ticks = static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+    return ".tmp" + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + "-" +
+           std::to_string(ticks) + "-" + std::to_string(counter++);
+}
+
+} // namespace
+
+std::string hashContent(std::string_view bytes) {
+    const uint64_t c1 = 0x87C37B91114253D5ull;
+    const uint64_t c2 = 0x4CF5AD432745937Full;
+    const auto* data = reinterpret_cast<const unsigned char*>(bytes.data());
+    size_t blocks = bytes.size() / 16;
+    uint64_t h1 = 0;
+    uint64_t h2 = 0;
+
+    for (size_t i = 0; i < blocks; ++i) {
+        uint64_t k1 = load64(data + i * 16);
+        uint64_t k2 = load64(data + i * 16 + 8);
+        k1 *= c1; k1 = rotl(k1, 31); k1 *= c2; h1 ^= k1;
+        h1 = rotl(h1, 27); h1 += h2; h1 = h1 * 5 + 0x52DCE729;
+        k2 *= c2; k2 = rotl(k2, 33); k2 *= c1; h2 ^= k2;
+        h2 = rotl(h2, 31); h2 += h1; h2 = h2 * 5 + 0x38495AB5;
+    }
+
+    // The last 0-15 bytes
+    const unsigned char* tail = data + blocks * 16;
+    size_t rest = bytes.size() & 15;
+    uint64_t k1 = 0;
+    uint64_t k2 = 0;
+    for (size_t i = rest; i > 8; --i) k2 = k2 << 8 | tail[i - 1];
+    for (size_t i = rest < 8 ? rest : 8; i > 0; --i) k1 = k1 << 8 | tail[i - 1];
+    if (rest > 8) {
+        k2 *= c2; k2 = rotl(k2, 33); k2 *= c1; h2 ^= k2;
+    }
+    if (rest > 0) {
+        k1 *= c1; k1 = rotl(k1, 31); k1 *= c2; h1 ^= k1;
+    }
+
+    h1 ^= bytes.size();
+    h2 ^= bytes.size();
+    h1 += h2;
+    h2 += h1;
+    h1 = fmix(h1);
+    h2 = fmix(h2);
+    h1 += h2;
+    h2 += h1;
+
+    static const char DIGITS[] = "0123456789abcdef";
+    std::string hex(HASH_DIGITS, '0');
+    for (int i = 0; i < 16; ++i) {
+        hex[15 - i] = DIGITS[(h1 >> (4 * i)) & 0xF];
+        hex[31 - i] = DIGITS[(h2 >> (4 * i)) & 0xF];
+    }
+    return hex;
+}
+
+CompileCache::CompileCache(std::string directory) : directory_(std::move(directory)) {}
+
+std::string CompileCache::keyFor(std::string_view source, std::string_view options) {
+    std::string material = compilerIdentity();
+    material += '\0';
+    material += options;
+    material += '\0';
+    material += hashContent(source);
+    return hashContent(material);
+}
+
+std::string CompileCache::pathFor(const std::string& key) const {
+    return (std::filesystem::path(directory_) / key.substr(0, 2) / key.substr(2)).string();
+}
+
+std::optional<std::string> CompileCache::lookup(const std::string& key) {
+    std::ifstream file(pathFor(key), std::ios::binary | std::ios::ate);
+    if (file) {
+        size_t size = static_cast<size_t>(file.tellg());
+        char header[HEADER_SIZE];
+        file.seekg(0);
+        if (size >= HEADER_SIZE && file.read(header, HEADER_SIZE) &&
+            std::memcmp(header, ENTRY_MAGIC, sizeof(ENTRY_MAGIC)) == 0) {
+            uint64_t length = load64(reinterpret_cast<const unsigned char*>(header + sizeof(ENTRY_MAGIC)));
+            std::string output(size - HEADER_SIZE, '\0');
+            if (length == output.size() && file.read(output.data(), static_cast<std::streamsize>(output.size())) &&
+                hashContent(output).compare(0, HASH_DIGITS, header + HEADER_SIZE - HASH_DIGITS, HASH_DIGITS) == 0) {
+                ++hits_;
+                return output;
+            }
+        }
+    }
+    ++misses_;
+    return std::nullopt;
+}
+
+bool CompileCache::store(const std::string& key, std::string_view output) {
+    namespace fs = std::filesystem;
+    fs::path path = pathFor(key);
+    std::error_code error;
+    fs::create_directories(path.parent_path(), error);
+    if (error) {
+        return false;
+    }
+
+    fs::path temporary = path.string() + temporarySuffix();
+    {
+        std::ofstream file(temporary, std::ios::binary);
+        char length[8];
+        for (int i = 0; i < 8; ++i) length[i] = static_cast<char>(static_cast<uint64_t>(output.size()) >> (8 * i));
+        file.write(ENTRY_MAGIC, sizeof(ENTRY_MAGIC));
+        file.write(length, sizeof(length));
+        file << hashContent(output) << output;
+        if (!file) {
+            file.close();
+            fs::remove(temporary, error);
+            return false;
+        }
+    }
+    fs::rename(temporary, path, error);
+    if (error) {
+        fs::remove(temporary, error);
+        return false;
+    }
+    return true;
+}
+
+} // namespace syclang
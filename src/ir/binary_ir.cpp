@@ -0,0 +1,496 @@
+#include "syclang/ir/binary_ir.h"
+#include <cstring>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace syclang {
+
+namespace {
+
+// Header: magic, version, target (arch, format), function count, then the
+// offsets of the module record, string table and function index, and the
+// file size. Function records follow it, then those three sections.
+constexpr char MAGIC[4] = {'S', 'Y', 'I', 'R'};
+constexpr size_t HEADER_SIZE = 48;
+constexpr size_t INDEX_ENTRY_SIZE = 16; // Record offset (8), size (4), name (4)
+
+enum ValueTag : uint8_t {
+    CONSTANT_VALUE, // type, bits
+    LOCAL_VALUE,    // type, name, register, stack offset
+    GLOBAL_VALUE,   // position in the module's globals
+    SYMBOL_VALUE    // name, type; interned like IRArena::createSymbol
+};
+
+// Which optional instruction fields follow the operands
+constexpr uint8_t HAS_RESULT = 1;
+constexpr uint8_t HAS_TARGET = 2;
+constexpr uint8_t HAS_FALSE_TARGET = 4;
+constexpr uint8_t HAS_CALLEE = 8;
+
+constexpr uint8_t FUNCTION_VARIADIC = 1;
+
+void putVarint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out += static_cast<char>(value | 0x80);
+        value >>= 7;
+    }
+    out += static_cast<char>(value);
+}
+
+// Zigzag, so small negative numbers stay short
+void putSigned(std::string& out, int64_t value) {
+    putVarint(out, (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+}
+
+template <typename T>
+void putFixed(std::string& out, size_t at, T value) {
+    for (size_t i = 0; i < sizeof(T); ++i) out[at + i] = static_cast<char>(static_cast<uint64_t>(value) >> (8 * i));
+}
+
+template <typename T>
+T getFixed(const char* data) {
+    uint64_t value = 0;
+    for (size_t i = 0; i < sizeof(T); ++i) value |= static_cast<uint64_t>(static_cast<uint8_t>(data[i])) << (8 * i);
+    return static_cast<T>(value);
+}
+
+class StringTable {
+public:
+    uint32_t add(const std::string& text) {
+        auto [it, added] = index_.emplace(text, static_cast<uint32_t>(strings_.size()));
+        if (added) strings_.push_back(&it->first);
+        return it->second;
+    }
+
+    void write(std::string& out) const {
+        putVarint(out, strings_.size());
+        for (const std::string* text : strings_) {
+            putVarint(out, text->size());
+            out += *text;
+        }
+    }
+
+private:
+    std::unordered_map<std::string, uint32_t> index_;
+    std::vector<const std::string*> strings_; // Keys of index_, which never move
+};
+
+// One function's record. Values and blocks are numbered in the order the
+// record first mentions them.
+class FunctionWriter {
+public:
+    FunctionWriter(const IRModule& module, const std::unordered_map<ValueId, uint32_t>& globals,
+                   StringTable& strings)
+        : module_(module), globals_(globals), strings_(strings) {}
+
+    void write(const IRFunction& function, std::string& out) {
+        const IRArena& arena = module_.arena;
+        for (BlockId block : function.blocks) {
+            blocks_.emplace(block, static_cast<uint32_t>(blocks_.size()));
+        }
+
+        // Instructions first: they decide the value table
+        std::string body;
+        for (ValueId argument : function.arguments) {
+            putVarint(body, valueIndex(argument));
+        }
+        for (BlockId block : function.blocks) {
+            putVarint(body, strings_.add(arena.block(block).name));
+        }
+        for (BlockId block : function.blocks) {
+            const auto& instructions = arena.block(block).instructions;
+            putVarint(body, instructions.size());
+            for (InstId id : instructions) {
+                writeInstruction(arena.instruction(id), body);
+            }
+        }
+
+        putVarint(out, strings_.add(function.name));
+        out += static_cast<char>(function.returnType);
+        out += static_cast<char>(function.isVariadic ? FUNCTION_VARIADIC : 0);
+        out += static_cast<char>(function.inlineHint);
+        putSigned(out, function.stackSize);
+        putVarint(out, function.parameters.size());
+        for (const auto& [type, name] : function.parameters) {
+            out += static_cast<char>(type);
+            putVarint(out, strings_.add(name));
+        }
+        putVarint(out, values_.size());
+        for (ValueId id : values_) {
+            writeValue(id, out);
+        }
+        putVarint(out, function.arguments.size());
+        putVarint(out, function.blocks.size());
+        out += body;
+    }
+
+private:
+    uint32_t valueIndex(ValueId id) {
+        auto [it, added] = valueIndex_.emplace(id, static_cast<uint32_t>(values_.size()));
+        if (added) values_.push_back(id);
+        return it->second;
+    }
+
+    uint32_t blockIndex(BlockId id) const {
+        auto it = blocks_.find(id);
+        if (it == blocks_.end()) {
+            throw std::runtime_error("Binary IR: branch to a block outside its function");
+        }
+        return it->second;
+    }
+
+    void writeValue(ValueId id, std::string& out) {
+        const IRValue& value = module_.arena.value(id);
+        if (value.isConstant()) {
+            out += static_cast<char>(CONSTANT_VALUE);
+            out += static_cast<char>(value.getType());
+            putSigned(out, value.value_.intValue);
+        } else if (auto global = globals_.find(id); global != globals_.end()) {
+            out += static_cast<char>(GLOBAL_VALUE);
+            putVarint(out, global->second);
+        } else if (value.isGlobal) {
+            out += static_cast<char>(SYMBOL_VALUE);
+            putVarint(out, strings_.add(value.name));
+            out += static_cast<char>(value.getType());
+        } else {
+            out += static_cast<char>(LOCAL_VALUE);
+            out += static_cast<char>(value.getType());
+            putVarint(out, strings_.add(value.name));
+            putSigned(out, value.registerNum);
+            putSigned(out, value.offset);
+        }
+    }
+
+    void writeInstruction(const IRInstruction& inst, std::string& out) {
+        const IRArena& arena = module_.arena;
+        uint8_t fields = (inst.result != INVALID_ID ? HAS_RESULT : 0) |
+                         (inst.targets[0] != INVALID_ID ? HAS_TARGET : 0) |
+                         (inst.targets[1] != INVALID_ID ? HAS_FALSE_TARGET : 0) |
+                         (inst.callee != INVALID_ID ? HAS_CALLEE : 0);
+        out += static_cast<char>(inst.opcode);
+        out += static_cast<char>(fields);
+        if (inst.result != INVALID_ID) putVarint(out, valueIndex(inst.result));
+        auto operands = arena.operands(inst);
+        putVarint(out, operands.size());
+        for (ValueId operand : operands) {
+            putVarint(out, valueIndex(operand));
+        }
+        if (inst.opcode == Opcode::PHI) {
+            for (BlockId block : arena.incomingBlocks(inst)) {
+                putVarint(out, blockIndex(block));
+            }
+        }
+        if (fields & HAS_TARGET) putVarint(out, blockIndex(inst.targets[0]));
+        if (fields & HAS_FALSE_TARGET) putVarint(out, blockIndex(inst.targets[1]));
+        if (fields & HAS_CALLEE) putVarint(out, valueIndex(inst.callee));
+    }
+
+    const IRModule& module_;
+    const std::unordered_map<ValueId, uint32_t>& globals_;
+    StringTable& strings_;
+    std::unordered_map<ValueId, uint32_t> valueIndex_;
+    std::vector<ValueId> values_;
+    std::unordered_map<BlockId, uint32_t> blocks_;
+};
+
+[[noreturn]] void damaged(const std::string& what) { throw std::runtime_error("Binary IR: " + what); }
+
+// Bounds-checked reads over one record
+class Decoder {
+public:
+    Decoder(const char* begin, const char* end) : at_(begin), end_(end) {}
+
+    uint8_t byte() {
+        if (at_ == end_) damaged("record is truncated");
+        return static_cast<uint8_t>(*at_++);
+    }
+
+    uint64_t varint() {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            uint8_t next = byte();
+            value |= static_cast<uint64_t>(next & 0x7F) << shift;
+            if (!(next & 0x80)) return value;
+        }
+        damaged("varint is too long");
+    }
+
+    int64_t signedVarint() {
+        uint64_t value = varint();
+        return static_cast<int64_t>((value >> 1) ^ (0 - (value & 1)));
+    }
+
+    // A position below `limit`
+    uint32_t index(size_t limit, const char* what) {
+        uint64_t value = varint();
+        if (value >= limit) damaged(std::string(what) + " out of range");
+        return static_cast<uint32_t>(value);
+    }
+
+    IRType type() {
+        uint8_t value = byte();
+        if (value > static_cast<uint8_t>(IRType::V8F32)) damaged("unknown type");
+        return static_cast<IRType>(value);
+    }
+
+    std::string_view bytes(size_t count) {
+        if (static_cast<size_t>(end_ - at_) < count) damaged("record is truncated");
+        std::string_view text(at_, count);
+        at_ += count;
+        return text;
+    }
+
+private:
+    const char* at_;
+    const char* end_;
+};
+
+} // namespace
+
+std::string writeBinaryIR(const IRModule& module) {
+    std::string out(HEADER_SIZE, '\0');
+    StringTable strings;
+    std::unordered_map<ValueId, uint32_t> globals;
+    for (size_t i = 0; i < module.globalVariables.size(); ++i) {
+        globals.emplace(module.globalVariables[i], static_cast<uint32_t>(i));
+    }
+
+    std::vector<std::pair<uint64_t, uint32_t>> records; // Offset, name
+    for (const auto& function : module.functions) {
+        records.emplace_back(out.size(), strings.add(function->name));
+        FunctionWriter(module, globals, strings).write(*function, out);
+    }
+
+    uint64_t moduleOffset = out.size();
+    putVarint(out, strings.add(module.name));
+    putVarint(out, module.globalVariables.size());
+    for (ValueId id : module.globalVariables) {
+        const IRValue& global = module.arena.value(id);
+        out += static_cast<char>(global.getType());
+        putVarint(out, strings.add(global.name));
+        out += static_cast<char>(global.isGlobal);
+        putSigned(out, global.registerNum);
+        putSigned(out, global.offset);
+    }
+
+    uint64_t stringsOffset = out.size();
+    strings.write(out);
+
+    uint64_t indexOffset = out.size();
+    out.resize(indexOffset + records.size() * INDEX_ENTRY_SIZE);
+    for (size_t i = 0; i < records.size(); ++i) {
+        uint64_t end = i + 1 < records.size() ? records[i + 1].first : moduleOffset;
+        size_t at = indexOffset + i * INDEX_ENTRY_SIZE;
+        putFixed<uint64_t>(out, at, records[i].first);
+        putFixed<uint32_t>(out, at + 8, static_cast<uint32_t>(end - records[i].first));
+        putFixed<uint32_t>(out, at + 12, records[i].second);
+    }
+
+    std::memcpy(out.data(), MAGIC, sizeof(MAGIC));
+    putFixed<uint32_t>(out, 4, BINARY_IR_VERSION);
+    out[8] = static_cast<char>(module.targetArch);
+    out[9] = static_cast<char>(module.outputFormat);
+    putFixed<uint32_t>(out, 12, static_cast<uint32_t>(records.size()));
+    putFixed<uint64_t>(out, 16, moduleOffset);
+    putFixed<uint64_t>(out, 24, stringsOffset);
+    putFixed<uint64_t>(out, 32, indexOffset);
+    putFixed<uint64_t>(out, 40, out.size());
+    return out;
+}
+
+bool isBinaryIR(std::string_view bytes) {
+    return bytes.size() >= sizeof(MAGIC) && std::memcmp(bytes.data(), MAGIC, sizeof(MAGIC)) == 0;
+}
+
+std::unique_ptr<BinaryIRReader> BinaryIRReader::open(const std::string& path, std::string& error) {
+    std::unique_ptr<SourceBuffer> buffer = SourceBuffer::open(path, error);
+    if (!buffer) {
+        return nullptr;
+    }
+    return open(std::move(buffer), error);
+}
+
+std::unique_ptr<BinaryIRReader> BinaryIRReader::open(std::unique_ptr<SourceBuffer> buffer, std::string& error) {
+    const std::string& name = buffer->name();
+    const char* data = buffer->data();
+    size_t size = buffer->size();
+    if (size < HEADER_SIZE || !isBinaryIR(buffer->text())) {
+        error = "'" + name + "' is not binary IR";
+        return nullptr;
+    }
+    uint32_t version = getFixed<uint32_t>(data + 4);
+    if (version != BINARY_IR_VERSION) {
+        error = "'" + name + "' is binary IR version " + std::to_string(version) + ", this compiler reads version " +
+                std::to_string(BINARY_IR_VERSION);
+        return nullptr;
+    }
+
+    std::unique_ptr<BinaryIRReader> reader(new BinaryIRReader());
+    uint8_t arch = static_cast<uint8_t>(data[8]);
+    uint8_t format = static_cast<uint8_t>(data[9]);
+    uint32_t functions = getFixed<uint32_t>(data + 12);
+    reader->moduleOffset_ = getFixed<uint64_t>(data + 16);
+    uint64_t stringsOffset = getFixed<uint64_t>(data + 24);
+    uint64_t indexOffset = getFixed<uint64_t>(data + 32);
+    reader->moduleEnd_ = stringsOffset;
+    if (getFixed<uint64_t>(data + 40) != size || arch > static_cast<uint8_t>(Architecture::ARM64) ||
+        format > static_cast<uint8_t>(OutputFormat::RAW) || reader->moduleOffset_ < HEADER_SIZE ||
+        reader->moduleOffset_ > stringsOffset || stringsOffset > indexOffset ||
+        (size - indexOffset) / INDEX_ENTRY_SIZE != functions || (size - indexOffset) % INDEX_ENTRY_SIZE) {
+        error = "'" + name + "' is damaged binary IR";
+        return nullptr;
+    }
+    reader->arch_ = static_cast<Architecture>(arch);
+    reader->format_ = static_cast<OutputFormat>(format);
+
+    try {
+        Decoder strings(data + stringsOffset, data + indexOffset);
+        uint64_t count = strings.varint();
+        if (count > indexOffset - stringsOffset) damaged("string count out of range");
+        reader->strings_.reserve(count);
+        for (uint64_t i = 0; i < count; ++i) {
+            reader->strings_.push_back(strings.bytes(strings.varint()));
+        }
+    } catch (const std::runtime_error& e) {
+        error = "'" + name + "': " + e.what();
+        return nullptr;
+    }
+
+    reader->index_.resize(functions);
+    for (uint32_t i = 0; i < functions; ++i) {
+        const char* entry = data + indexOffset + i * INDEX_ENTRY_SIZE;
+        IndexEntry& index = reader->index_[i];
+        index.offset = getFixed<uint64_t>(entry);
+        index.size = getFixed<uint32_t>(entry + 8);
+        index.name = getFixed<uint32_t>(entry + 12);
+        if (index.offset < HEADER_SIZE || index.offset > reader->moduleOffset_ ||
+            index.size > reader->moduleOffset_ - index.offset ||
+            index.name >= reader->strings_.size()) {
+            error = "'" + name + "' has a damaged function index";
+            return nullptr;
+        }
+    }
+    reader->buffer_ = std::move(buffer);
+    return reader;
+}
+
+std::shared_ptr<IRModule> BinaryIRReader::createModule() const {
+    auto module = std::make_shared<IRModule>();
+    module->targetArch = arch_;
+    module->outputFormat = format_;
+
+    Decoder in(buffer_->data() + moduleOffset_, buffer_->data() + moduleEnd_);
+    module->name = std::string(strings_[in.index(strings_.size(), "string")]);
+    uint64_t globals = in.varint();
+    for (uint64_t i = 0; i < globals; ++i) {
+        IRType type = in.type();
+        std::string_view name = strings_[in.index(strings_.size(), "string")];
+        ValueId id = module->arena.createVariable(type, std::string(name));
+        IRValue& global = module->arena.value(id);
+        global.isGlobal = in.byte() != 0;
+        global.registerNum = static_cast<int>(in.signedVarint());
+        global.offset = static_cast<int>(in.signedVarint());
+        module->addGlobalVariable(id);
+    }
+    return module;
+}
+
+std::shared_ptr<IRFunction> BinaryIRReader::loadFunction(size_t function, IRModule& module) const {
+    const IndexEntry& entry = index_.at(function);
+    const char* record = buffer_->data() + entry.offset;
+    Decoder in(record, record + entry.size);
+    IRArena& arena = module.arena;
+    auto string = [&] { return std::string(strings_[in.index(strings_.size(), "string")]); };
+
+    auto result = std::make_shared<IRFunction>();
+    result->name = string();
+    result->returnType = in.type();
+    result->isVariadic = (in.byte() & FUNCTION_VARIADIC) != 0;
+    uint8_t hint = in.byte();
+    if (hint > static_cast<uint8_t>(InlineHint::NEVER)) damaged("unknown inline hint");
+    result->inlineHint = static_cast<InlineHint>(hint);
+    result->stackSize = static_cast<int>(in.signedVarint());
+    uint64_t parameters = in.varint();
+    for (uint64_t i = 0; i < parameters; ++i) {
+        IRType type = in.type();
+        result->parameters.emplace_back(type, string());
+    }
+
+    std::vector<ValueId> values(in.index(entry.size + 1, "value count"));
+    for (ValueId& id : values) {
+        uint8_t tag = in.byte();
+        if (tag == CONSTANT_VALUE) {
+            IRType type = in.type();
+            id = arena.createConstant(type, static_cast<uint64_t>(in.signedVarint()));
+        } else if (tag == LOCAL_VALUE) {
+            IRType type = in.type();
+            id = arena.createVariable(type, string());
+            arena.value(id).registerNum = static_cast<int>(in.signedVarint());
+            arena.value(id).offset = static_cast<int>(in.signedVarint());
+        } else if (tag == GLOBAL_VALUE) {
+            id = module.globalVariables[in.index(module.globalVariables.size(), "global")];
+        } else if (tag == SYMBOL_VALUE) {
+            id = arena.createSymbol(string());
+            arena.value(id).setType(in.type());
+        } else {
+            damaged("unknown value kind");
+        }
+    }
+
+    std::vector<ValueId> arguments(in.index(entry.size + 1, "argument count"));
+    std::vector<BlockId> blocks(in.index(entry.size + 1, "block count"));
+    for (ValueId& argument : arguments) {
+        argument = values[in.index(values.size(), "value")];
+    }
+    result->arguments = std::move(arguments);
+    for (BlockId& block : blocks) {
+        block = arena.createBlock(string());
+        result->addBlock(block);
+    }
+
+    std::vector<ValueId> operands;
+    std::vector<BlockId> incoming;
+    for (BlockId block : blocks) {
+        uint64_t count = in.index(entry.size + 1, "instruction count");
+        auto& instructions = arena.block(block).instructions;
+        instructions.reserve(count);
+        for (uint64_t i = 0; i < count; ++i) {
+            uint8_t opcode = in.byte();
+            if (opcode > static_cast<uint8_t>(Opcode::SPLAT)) damaged("unknown opcode");
+            uint8_t fields = in.byte();
+            ValueId resultValue = fields & HAS_RESULT ? values[in.index(values.size(), "value")] : INVALID_ID;
+            operands.resize(in.index(entry.size + 1, "operand count"));
+            for (ValueId& operand : operands) {
+                operand = values[in.index(values.size(), "value")];
+            }
+            InstId id;
+            if (opcode == static_cast<uint8_t>(Opcode::PHI)) {
+                incoming.resize(operands.size());
+                for (BlockId& from : incoming) {
+                    from = blocks[in.index(blocks.size(), "block")];
+                }
+                id = arena.createInstruction(Opcode::PHI, std::span<const ValueId>(), resultValue);
+                arena.setIncoming(arena.instruction(id), operands, incoming);
+            } else {
+                id = arena.createInstruction(static_cast<Opcode>(opcode), operands, resultValue);
+            }
+            IRInstruction& inst = arena.instruction(id);
+            if (fields & HAS_TARGET) inst.targets[0] = blocks[in.index(blocks.size(), "block")];
+            if (fields & HAS_FALSE_TARGET) inst.targets[1] = blocks[in.index(blocks.size(), "block")];
+            if (fields & HAS_CALLEE) inst.callee = values[in.index(values.size(), "value")];
+            instructions.push_back(id);
+        }
+    }
+    module.addFunction(result);
+    return result;
+}
+
+std::shared_ptr<IRModule> BinaryIRReader::load() const {
+    std::shared_ptr<IRModule> module = createModule();
+    for (size_t i = 0; i < index_.size(); ++i) {
+        loadFunction(i, *module);
+    }
+    return module;
+}
+
+} // namespace syclang
@@ -0,0 +1,94 @@
+#include "syclang/ir/call_graph.h"
+#include <algorithm>
+
+namespace syclang {
+
+CallGraph::CallGraph(const IRModule& module) {
+    const IRArena& arena = module.arena;
+    const auto& functions = module.functions;
+    nodes_.resize(functions.size());
+    selfCalls_.assign(functions.size(), false);
+    for (size_t f = 0; f < functions.size(); ++f) {
+        byName_.emplace(functions[f]->name, static_cast<int>(f));
+    }
+
+    for (size_t f = 0; f < functions.size(); ++f) {
+        for (BlockId block : functions[f]->blocks) {
+            for (InstId instId : arena.block(block).instructions) {
+                const IRInstruction& inst = arena.instruction(instId);
+                if (inst.opcode != Opcode::CALL) continue;
+                int callee = inst.callee == INVALID_ID ? -1 : find(arena.value(inst.callee).name);
+                nodes_[f].calls.push_back({instId, block, callee});
+                if (callee < 0) continue;
+                selfCalls_[f] = selfCalls_[f] || callee == static_cast<int>(f);
+                auto& callers = nodes_[callee].callers;
+                if (std::find(callers.begin(), callers.end(), static_cast<int>(f)) == callers.end()) {
+                    callers.push_back(static_cast<int>(f));
+                }
+            }
+        }
+    }
+
+    // Tarjan's algorithm, iterative; a component is emitted once all its
+    // callees' components are
+    std::vector<int> index(nodes_.size(), -1);
+    std::vector<int> lowlink(nodes_.size(), 0);
+    std::vector<bool> onStack(nodes_.size(), false);
+    std::vector<int> stack;
+    int counter = 0;
+    struct Frame {
+        int node;
+        size_t next;
+    };
+    for (size_t root = 0; root < nodes_.size(); ++root) {
+        if (index[root] >= 0) continue;
+        std::vector<Frame> frames{{static_cast<int>(root), 0}};
+        index[root] = lowlink[root] = counter++;
+        stack.push_back(static_cast<int>(root));
+        onStack[root] = true;
+        while (!frames.empty()) {
+            Frame& frame = frames.back();
+            const auto& calls = nodes_[frame.node].calls;
+            if (frame.next < calls.size()) {
+                int callee = calls[frame.next++].callee;
+                if (callee < 0) continue;
+                if (index[callee] < 0) {
+                    index[callee] = lowlink[callee] = counter++;
+                    stack.push_back(callee);
+                    onStack[callee] = true;
+                    frames.push_back({callee, 0});
+                } else if (onStack[callee]) {
+                    lowlink[frame.node] = std::min(lowlink[frame.node], index[callee]);
+                }
+                continue;
+            }
+            int node = frame.node;
+            frames.pop_back();
+            if (!frames.empty()) {
+                lowlink[frames.back().node] = std::min(lowlink[frames.back().node], lowlink[node]);
+            }
+            if (lowlink[node] != index[node]) continue;
+            std::vector<int> component;
+            int member;
+            do {
+                member = stack.back();
+                stack.pop_back();
+                onStack[member] = false;
+                nodes_[member].component = static_cast<int>(components_.size());
+                component.push_back(member);
+            } while (member != node);
+            components_.push_back(std::move(component));
+        }
+    }
+}
+
+int CallGraph::find(const std::string& name) const {
+    auto it = byName_.find(name);
+    return it == byName_.end() ? -1 : it->second;
+}
+
+bool CallGraph::isRecursive(int node) const {
+    return selfCalls_[node] || components_[nodes_[node].component].size() > 1;
+}
+
+} // namespace syclang
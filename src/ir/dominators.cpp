@@ -0,0 +1,160 @@
+#include "syclang/ir/dominators.h"
+#include <algorithm>
+
+namespace syclang {
+
+DominatorTree::DominatorTree(const IRArena& arena, const IRFunction& func) {
+    size_t count = func.blocks.size();
+    nodes_.resize(count);
+    index_.reserve(count);
+    for (size_t b = 0; b < count; ++b) {
+        index_[func.blocks[b]] = static_cast<uint32_t>(b);
+    }
+    if (count == 0) return;
+
+    for (size_t b = 0; b < count; ++b) {
+        bool terminated = false;
+        for (InstId instId : arena.block(func.blocks[b]).instructions) {
+            const IRInstruction& inst = arena.instruction(instId);
+            int targetCount = inst.opcode == Opcode::BR ? 1 : inst.opcode == Opcode::CONDBR ? 2 : 0;
+            for (int t = 0; t < targetCount; ++t) {
+                if (index_.count(inst.targets[t])) {
+                    nodes_[b].successors.push_back(inst.targets[t]);
+                }
+            }
+            if (inst.isTerminator()) {
+                terminated = true;
+                break;
+            }
+        }
+        if (!terminated && b + 1 < count) {
+            nodes_[b].successors.push_back(func.blocks[b + 1]);
+        }
+        for (BlockId succ : nodes_[b].successors) {
+            nodes_[index_[succ]].predecessors.push_back(func.blocks[b]);
+        }
+    }
+
+    // Depth-first postorder from the entry block
+    std::vector<BlockId> postorder;
+    std::vector<bool> visited(count, false);
+    std::vector<std::pair<uint32_t, size_t>> stack; // (block index, next successor)
+    stack.push_back({0, 0});
+    visited[0] = true;
+    while (!stack.empty()) {
+        auto& [b, next] = stack.back();
+        if (next < nodes_[b].successors.size()) {
+            uint32_t succ = index_[nodes_[b].successors[next++]];
+            if (!visited[succ]) {
+                visited[succ] = true;
+                stack.push_back({succ, 0});
+            }
+            continue;
+        }
+        postorder.push_back(func.blocks[b]);
+        stack.pop_back();
+    }
+    rpo_.assign(postorder.rbegin(), postorder.rend());
+    for (uint32_t i = 0; i < rpo_.size(); ++i) {
+        nodes_[index_[rpo_[i]]].rpoIndex = i;
+    }
+
+    // Iterate idom(b) = intersection over processed predecessors until stable
+    auto intersect = [&](BlockId a, BlockId b) {
+        while (a != b) {
+            while (node(a).rpoIndex > node(b).rpoIndex) a = node(a).idom;
+            while (node(b).rpoIndex > node(a).rpoIndex) b = node(b).idom;
+        }
+        return a;
+    };
+    BlockId entry = func.blocks[0];
+    nodes_[0].idom = entry;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t i = 1; i < rpo_.size(); ++i) {
+            Node& current = nodes_[index_[rpo_[i]]];
+            BlockId newIdom = INVALID_ID;
+            for (BlockId pred : current.predecessors) {
+                if (node(pred).idom == INVALID_ID) continue; // Not processed yet
+                newIdom = newIdom == INVALID_ID ? pred : intersect(pred, newIdom);
+            }
+            if (current.idom != newIdom) {
+                current.idom = newIdom;
+                changed = true;
+            }
+        }
+    }
+    nodes_[0].idom = INVALID_ID;
+    for (size_t i = 1; i < rpo_.size(); ++i) {
+        nodes_[index_[node(rpo_[i]).idom]].children.push_back(rpo_[i]);
+    }
+
+    // Dominance frontiers: walk up from each predecessor of a join point
+    // until reaching the join point's immediate dominator
+    for (BlockId block : rpo_) {
+        const Node& join = node(block);
+        if (join.predecessors.size() < 2) continue;
+        for (BlockId pred : join.predecessors) {
+            if (!isReachable(pred)) continue;
+            for (BlockId runner = pred; runner != join.idom; runner = node(runner).idom) {
+                auto& frontier = nodes_[index_[runner]].frontier;
+                if (std::find(frontier.begin(), frontier.end(), block) == frontier.end()) {
+                    frontier.push_back(block);
+                }
+            }
+        }
+    }
+
+    // Preorder intervals make dominates() a constant-time check
+    uint32_t clock = 0;
+    std::vector<std::pair<BlockId, size_t>> walk;
+    walk.push_back({entry, 0});
+    nodes_[0].enter = clock++;
+    while (!walk.empty()) {
+        auto& [block, next] = walk.back();
+        Node& current = nodes_[index_[block]];
+        if (next < current.children.size()) {
+            BlockId child = current.children[next++];
+            nodes_[index_[child]].enter = clock++;
+            walk.push_back({child, 0});
+            continue;
+        }
+        current.exit = clock++;
+        walk.pop_back();
+    }
+}
+
+bool DominatorTree::isReachable(BlockId block) const {
+    auto it = index_.find(block);
+    return it != index_.end() && nodes_[it->second].rpoIndex != UNREACHED;
+}
+
+const std::vector<BlockId>& DominatorTree::successors(BlockId block) const {
+    return node(block).successors;
+}
+
+const std::vector<BlockId>& DominatorTree::predecessors(BlockId block) const {
+    return node(block).predecessors;
+}
+
+BlockId DominatorTree::idom(BlockId block) const {
+    return node(block).idom;
+}
+
+const std::vector<BlockId>& DominatorTree::children(BlockId block) const {
+    return node(block).children;
+}
+
+const std::vector<BlockId>& DominatorTree::frontier(BlockId block) const {
+    return node(block).frontier;
+}
+
+bool DominatorTree::dominates(BlockId a, BlockId b) const {
+    if (!isReachable(a) || !isReachable(b)) return false;
+    const Node& outer = node(a);
+    const Node& inner = node(b);
+    return outer.enter <= inner.enter && inner.exit <= outer.exit;
+}
+
+} // namespace syclang
@@ -1,4 +1,6 @@
 #include "syclang/ir/ir.h"
+#include <algorithm>
+#include <cstring>
 #include <sstream>
 
 namespace syclang {
@@ -19,13 +21,23 @@ std::ostream& operator<<(std::ostream& os, IRType type) {
         case IRType::BOOL: os << "bool"; break;
         case IRType::VOID: os << "void"; break;
         case IRType::POINTER: os << "ptr"; break;
+        case IRType::V16I8: os << "<16 x i8>"; break;
+        case IRType::V8I16: os << "<8 x i16>"; break;
+        case IRType::V4I32: os << "<4 x i32>"; break;
+        case IRType::V2I64: os << "<2 x i64>"; break;
+        case IRType::V4F32: os << "<4 x f32>"; break;
+        case IRType::V32I8: os << "<32 x i8>"; break;
+        case IRType::V16I16: os << "<16 x i16>"; break;
+        case IRType::V8I32: os << "<8 x i32>"; break;
+        case IRType::V4I64: os << "<4 x i64>"; break;
+        case IRType::V8F32: os << "<8 x f32>"; break;
         default: os << "unknown"; break;
     }
     return os;
 }
 
-size_t IRValue::getSize() const {
-    switch (type_) {
+size_t getTypeSize(IRType type) {
+    switch (type) {
         case IRType::I8:
         case IRType::U8:
         case IRType::BOOL:
@@ -44,47 +56,59 @@ size_t IRValue::getSize() const {
             return 8;
         case IRType::VOID:
             return 0;
+        case IRType::V16I8:
+        case IRType::V8I16:
+        case IRType::V4I32:
+        case IRType::V2I64:
+        case IRType::V4F32:
+            return 16;
+        case IRType::V32I8:
+        case IRType::V16I16:
+        case IRType::V8I32:
+        case IRType::V4I64:
+        case IRType::V8F32:
+            return 32;
     }
     return 0;
 }
 
-std::shared_ptr<IRConstant> IRConstant::createI32(int32_t value) {
-    auto constant = std::make_shared<IRConstant>(IRType::I32);
-    constant->value_.intValue = value;
-    return constant;
-}
-
-std::shared_ptr<IRConstant> IRConstant::createI64(int64_t value) {
-    auto constant = std::make_shared<IRConstant>(IRType::I64);
-    constant->value_.intValue = value;
-    return constant;
-}
-
-std::shared_ptr<IRConstant> IRConstant::createU32(uint32_t value) {
-    auto constant = std::make_shared<IRConstant>(IRType::U32);
-    constant->value_.uintValue = value;
-    return constant;
-}
-
-std::shared_ptr<IRConstant> IRConstant::createU64(uint64_t value) {
-    auto constant = std::make_shared<IRConstant>(IRType::U64);
-    constant->value_.uintValue = value;
-    return constant;
-}
-
-std::shared_ptr<IRConstant> IRConstant::createF64(double value) {
-    auto constant = std::make_shared<IRConstant>(IRType::F64);
-    constant->value_.floatValue = value;
-    return constant;
+IRType vectorType(IRType element, size_t bytes) {
+    if (bytes != 16 && bytes != 32) return IRType::VOID;
+    bool wide = bytes == 32;
+    if (element == IRType::F32) return wide ? IRType::V8F32 : IRType::V4F32;
+    switch (getTypeSize(element)) {
+        case 1: return wide ? IRType::V32I8 : IRType::V16I8;
+        case 2: return wide ? IRType::V16I16 : IRType::V8I16;
+        case 4: return wide ? IRType::V8I32 : IRType::V4I32;
+        case 8: return wide ? IRType::V4I64 : IRType::V2I64;
+        default: return IRType::VOID;
+    }
 }
 
-std::shared_ptr<IRConstant> IRConstant::createBool(bool value) {
-    auto constant = std::make_shared<IRConstant>(IRType::BOOL);
-    constant->value_.intValue = value ? 1 : 0;
-    return constant;
+IRType vectorElementType(IRType type) {
+    switch (type) {
+        case IRType::V16I8:
+        case IRType::V32I8: return IRType::I8;
+        case IRType::V8I16:
+        case IRType::V16I16: return IRType::I16;
+        case IRType::V4I32:
+        case IRType::V8I32: return IRType::I32;
+        case IRType::V2I64:
+        case IRType::V4I64: return IRType::I64;
+        case IRType::V4F32:
+        case IRType::V8F32: return IRType::F32;
+        default: return type;
+    }
 }
 
-std::string IRConstant::toString() const {
+std::string IRValue::toString() const {
+    if (isVariable()) {
+        if (isGlobal) {
+            return "@" + name;
+        }
+        return "%" + name;
+    }
+    
     std::stringstream ss;
     switch (type_) {
         case IRType::I8:
@@ -112,26 +136,136 @@ std::string IRConstant::toString() const {
     return ss.str();
 }
 
-std::shared_ptr<IRVariable> IRVariable::create(IRType type, const std::string& name) {
-    auto var = std::make_shared<IRVariable>(type);
-    var->name = name;
-    var->registerNum = -1;
-    var->isGlobal = false;
-    var->offset = 0;
-    return var;
+ValueId IRArena::createConstant(IRType type, uint64_t bits) {
+    ConstantKey key{type, bits};
+    auto it = constants_.find(key);
+    if (it != constants_.end()) {
+        return it->second;
+    }
+    
+    IRValue constant;
+    constant.kind = IRValue::Kind::CONSTANT;
+    constant.setType(type);
+    constant.value_.uintValue = bits;
+    ValueId id = values_.add(std::move(constant));
+    constants_.emplace(key, id);
+    constantCount_++;
+    return id;
 }
 
-std::string IRVariable::toString() const {
-    if (isGlobal) {
-        return "@" + name;
+ValueId IRArena::createI32(int32_t value) {
+    return createConstant(IRType::I32, static_cast<uint64_t>(static_cast<int64_t>(value)));
+}
+
+ValueId IRArena::createI64(int64_t value) {
+    return createConstant(IRType::I64, static_cast<uint64_t>(value));
+}
+
+ValueId IRArena::createU32(uint32_t value) {
+    return createConstant(IRType::U32, value);
+}
+
+ValueId IRArena::createU64(uint64_t value) {
+    return createConstant(IRType::U64, value);
+}
+
+ValueId IRArena::createF64(double value) {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return createConstant(IRType::F64, bits);
+}
+
+ValueId IRArena::createBool(bool value) {
+    return createConstant(IRType::BOOL, value ? 1 : 0);
+}
+
+ValueId IRArena::createVariable(IRType type, const std::string& name) {
+    ValueId id = values_.allocate(1);
+    IRValue& var = values_[id];
+    var.kind = IRValue::Kind::VARIABLE;
+    var.setType(type);
+    var.name = name;
+    return id;
+}
+
+ValueId IRArena::createSymbol(const std::string& name) {
+    auto it = symbols_.find(name);
+    if (it != symbols_.end()) return it->second;
+    ValueId id = createVariable(IRType::POINTER, name);
+    values_[id].isGlobal = true;
+    symbols_.emplace(name, id);
+    return id;
+}
+
+InstId IRArena::createInstruction(Opcode op, std::initializer_list<ValueId> operands,
+                                  ValueId result) {
+    return createInstruction(op, std::span<const ValueId>(operands.begin(), operands.size()),
+                             result);
+}
+
+InstId IRArena::createInstruction(Opcode op, std::span<const ValueId> operands,
+                                  ValueId result) {
+    InstId id = instructions_.allocate(1);
+    IRInstruction& inst = instructions_[id];
+    inst.opcode = op;
+    inst.result = result;
+    setOperands(inst, operands);
+    return id;
+}
+
+BlockId IRArena::createBlock(const std::string& name) {
+    BlockId id = blocks_.allocate(1);
+    blocks_[id].name = name;
+    // Most blocks are short; one up-front allocation avoids regrowth
+    blocks_[id].instructions.reserve(8);
+    return id;
+}
+
+void IRArena::setOperands(IRInstruction& inst, std::span<const ValueId> operands) {
+    uint32_t count = static_cast<uint32_t>(operands.size());
+    if (count > inst.operandCount) {
+        // Old range is abandoned; the arena is freed as a whole
+        inst.operandBegin = count ? operands_.allocate(count) : 0;
     }
-    return "%" + name;
+    inst.operandCount = count;
+    if (count == 0) return;
+    std::copy(operands.begin(), operands.end(), operands_.data(inst.operandBegin));
 }
 
-std::string IRInstruction::toString() const {
+void IRArena::setIncoming(IRInstruction& inst, std::span<const ValueId> values,
+                          std::span<const BlockId> blocks) {
+    // Always takes a fresh range: the old one may have been sized by
+    // setOperands, without room for the blocks
+    uint32_t count = static_cast<uint32_t>(values.size());
+    inst.operandBegin = count ? operands_.allocate(count * 2) : 0;
+    inst.operandCount = count;
+    if (count == 0) return;
+    std::copy(values.begin(), values.end(), operands_.data(inst.operandBegin));
+    std::copy(blocks.begin(), blocks.end(), operands_.data(inst.operandBegin + count));
+}
+
+IRArena::Stats IRArena::getStats() const {
+    Stats stats;
+    stats.values = values_.size();
+    stats.constants = constantCount_;
+    stats.instructions = instructions_.size();
+    stats.blocks = blocks_.size();
+    stats.operands = operands_.size();
+    stats.bytes = values_.capacityBytes() + instructions_.capacityBytes() +
+                  blocks_.capacityBytes() + operands_.capacityBytes();
+    stats.usedBytes = values_.size() * sizeof(IRValue) + instructions_.size() * sizeof(IRInstruction) +
+                      blocks_.size() * sizeof(IRBasicBlock) + operands_.size() * sizeof(ValueId);
+    return stats;
+}
+
+std::string IRArena::toString(const IRInstruction& inst) const {
     std::stringstream ss;
     
-    switch (opcode) {
+    if (inst.result != INVALID_ID) {
+        ss << value(inst.result).toString() << " = ";
+    }
+    
+    switch (inst.opcode) {
         case Opcode::ADD: ss << "add"; break;
         case Opcode::SUB: ss << "sub"; break;
         case Opcode::MUL: ss << "mul"; break;
@@ -167,24 +301,50 @@ std::string IRInstruction::toString() const {
         case Opcode::UITOFP: ss << "uitofp"; break;
         case Opcode::SITOFP: ss << "sitofp"; break;
         case Opcode::BITCAST: ss << "bitcast"; break;
+        case Opcode::SPLAT: ss << "splat"; break;
     }
     
+    // Vector results are spelled out; everything else is a scalar
+    if (inst.result != INVALID_ID && isVectorType(value(inst.result).getType())) {
+        ss << " " << value(inst.result).getType();
+    }
     ss << " ";
-    for (size_t i = 0; i < operands.size(); ++i) {
-        if (i > 0) ss << ", ";
-        ss << operands[i]->toString();
+    auto ops = operands(inst);
+    if (inst.callee != INVALID_ID) {
+        ss << value(inst.callee).toString() << (ops.empty() ? "" : ", ");
+    }
+    if (inst.opcode == Opcode::PHI) {
+        auto from = incomingBlocks(inst);
+        for (size_t i = 0; i < ops.size(); ++i) {
+            ss << (i ? ", [" : "[") << value(ops[i]).toString() << ", %" << block(from[i]).name << "]";
+        }
+        return ss.str();
+    }
+    bool first = true;
+    for (ValueId op : ops) {
+        if (!first) ss << ", ";
+        ss << value(op).toString();
+        first = false;
+    }
+    
+    for (BlockId target : inst.targets) {
+        if (target != INVALID_ID) {
+            if (!first) ss << ", ";
+            ss << "label %" << block(target).name;
+            first = false;
+        }
     }
     
     return ss.str();
 }
 
-void IRFunction::addBlock(std::shared_ptr<IRBasicBlock> block) {
+void IRFunction::addBlock(BlockId block) {
     blocks.push_back(block);
 }
 
-std::shared_ptr<IRBasicBlock> IRFunction::getCurrentBlock() {
+BlockId IRFunction::getCurrentBlock() const {
     if (blocks.empty()) {
-        return nullptr;
+        return INVALID_ID;
     }
     return blocks.back();
 }
@@ -193,7 +353,7 @@ void IRModule::addFunction(std::shared_ptr<IRFunction> func) {
     functions.push_back(func);
 }
 
-void IRModule::addGlobalVariable(std::shared_ptr<IRVariable> var) {
+void IRModule::addGlobalVariable(ValueId var) {
     globalVariables.push_back(var);
 }
 
@@ -211,7 +371,7 @@ std::string IRModule::dump() const {
     
     // Global variables
     for (const auto& var : globalVariables) {
-        ss << var->toString() << " = global ";
+        ss << arena.value(var).toString() << " = global ";
         // Emit type...
         ss << " zeroinitializer\n";
     }
@@ -223,14 +383,15 @@ std::string IRModule::dump() const {
         ss << "define " << func->name << "(";
         for (size_t i = 0; i < func->parameters.size(); ++i) {
             if (i > 0) ss << ", ";
-            ss << func->parameters[i].second << " %" << func->parameters[i].first;
+            ss << func->parameters[i].first << " %" << func->parameters[i].second;
         }
         ss << ") {\n";
         
-        for (const auto& block : func->blocks) {
-            ss << block->name << ":\n";
-            for (const auto& inst : block->instructions) {
-                ss << "  " << inst->toString() << "\n";
+        for (BlockId blockId : func->blocks) {
+            const IRBasicBlock& block = arena.block(blockId);
+            ss << block.name << ":\n";
+            for (InstId instId : block.instructions) {
+                ss << "  " << arena.toString(arena.instruction(instId)) << "\n";
             }
         }
         
@@ -1,17 +1,21 @@
 #include "syclang/ir/ir_generator.h"
+#include "syclang/ir/mem2reg.h"
 #include "syclang/parser/ast.h"
+#include "syclang/trace.h"
 #include <iostream>
 
 namespace syclang {
 
 IRGenerator::IRGenerator(Architecture arch)
-    : arch_(arch), currentFunction_(nullptr), currentBlock_(nullptr),
+    : arch_(arch), currentFunction_(nullptr), currentBlock_(INVALID_ID),
       labelCounter_(0), tempCounter_(0) {}
 
 std::shared_ptr<IRModule> IRGenerator::generate(std::shared_ptr<Program> program) {
+    TraceScope trace("irgen", "frontend");
     auto module = std::make_shared<IRModule>();
     module->name = "module";
     module->targetArch = arch_;
+    module_ = module;
     
     // First pass: collect all function declarations
     for (const auto& decl : program->declarations) {
@@ -20,6 +24,13 @@ std::shared_ptr<IRModule> IRGenerator::generate(std::shared_ptr<Program> program
             auto func = std::make_shared<IRFunction>();
             func->name = funcDecl->name;
             func->isVariadic = funcDecl->isVariadic;
+            for (const auto& attribute : funcDecl->attributes) {
+                if (attribute == "inline") {
+                    func->inlineHint = InlineHint::ALWAYS;
+                } else if (attribute == "noinline") {
+                    func->inlineHint = InlineHint::NEVER;
+                }
+            }
             
             // Convert return type
             func->returnType = convertType(funcDecl->returnType);
@@ -50,6 +61,7 @@ std::shared_ptr<IRModule> IRGenerator::generate(std::shared_ptr<Program> program
     }
     
     currentFunction_ = nullptr;
+    module_ = nullptr;
     return module;
 }
 
@@ -82,18 +94,47 @@ IRType IRGenerator::convertType(std::shared_ptr<Type> type) {
 }
 
 void IRGenerator::generateFunctionBody(std::shared_ptr<FunctionDecl> funcDecl) {
+    TraceScope trace("irgen function", "frontend", funcDecl->name);
     // Create entry block
-    auto entryBlock = std::make_shared<IRBasicBlock>();
-    entryBlock->name = "entry";
-    currentFunction_->addBlock(entryBlock);
-    currentBlock_ = entryBlock;
+    BlockId entryBlock = module_->arena.createBlock("entry");
+    startBlock(entryBlock);
+    
+    // Parameters arrive as values and are copied into ordinary locals, so
+    // assigning to one works like any other variable
+    IRArena& arena = module_->arena;
+    variables_.clear();
+    elementTypes_.clear();
+    for (const auto& [name, type] : funcDecl->params) {
+        notePointer(name, type);
+    }
+    for (const auto& [type, name] : currentFunction_->parameters) {
+        ValueId argument = arena.createVariable(type, name);
+        currentFunction_->arguments.push_back(argument);
+        ValueId var = arena.createVariable(type, name);
+        arena.value(var).offset = currentFunction_->stackSize;
+        emit(Opcode::ALLOCA, {}, var);
+        currentFunction_->stackSize += arena.value(var).getSize();
+        emit(Opcode::STORE, {argument, var});
+        variables_[name] = var;
+    }
     
     // Generate function body
     generateBlock(funcDecl->body);
+    
+    // Fall off the end of the function: implicit return
+    if (!isTerminated()) {
+        emit(Opcode::RET);
+    }
+    
+    // Locals become SSA values with PHIs at control-flow joins
+    TraceScope ssa("mem2reg", "frontend", funcDecl->name);
+    promoteMemoryToRegisters(arena, *currentFunction_);
 }
 
 void IRGenerator::generateBlock(std::shared_ptr<BlockStmt> block) {
     for (const auto& stmt : block->statements) {
+        // Anything after a return/branch in the same block is unreachable
+        if (isTerminated()) break;
         generateStatement(stmt);
     }
 }
@@ -119,120 +160,79 @@ void IRGenerator::generateStatement(std::shared_ptr<Statement> stmt) {
 }
 
 void IRGenerator::generateLet(std::shared_ptr<LetStmt> let) {
-    auto var = IRVariable::create(convertType(let->type), let->name);
-    var->isGlobal = false;
-    var->offset = currentFunction_->stackSize;
+    IRArena& arena = module_->arena;
+    ValueId var = arena.createVariable(convertType(let->type), let->name);
+    arena.value(var).offset = currentFunction_->stackSize;
     
     // Allocate stack space
-    auto allocaInst = std::make_shared<IRInstruction>(Opcode::ALLOCA);
-    allocaInst->result = var;
-    currentBlock_->instructions.push_back(allocaInst);
+    emit(Opcode::ALLOCA, {}, var);
     
-    currentFunction_->stackSize += var->getSize();
+    currentFunction_->stackSize += arena.value(var).getSize();
     
     // Initialize if needed
     if (let->init) {
-        auto value = generateExpression(let->init);
-        auto storeInst = std::make_shared<IRInstruction>(Opcode::STORE);
-        storeInst->operands.push_back(value);
-        storeInst->operands.push_back(var);
-        currentBlock_->instructions.push_back(storeInst);
+        ValueId value = generateExpression(let->init);
+        if (value != INVALID_ID) {
+            emit(Opcode::STORE, {value, var});
+        }
     }
     
     variables_[let->name] = var;
+    notePointer(let->name, let->type);
 }
 
 void IRGenerator::generateReturn(std::shared_ptr<ReturnStmt> ret) {
-    auto inst = std::make_shared<IRInstruction>(Opcode::RET);
-    if (ret->expr) {
-        inst->operands.push_back(generateExpression(ret->expr));
+    ValueId value = ret->expr ? generateExpression(ret->expr) : INVALID_ID;
+    if (value != INVALID_ID) {
+        emit(Opcode::RET, {value});
+    } else {
+        emit(Opcode::RET);
     }
-    currentBlock_->instructions.push_back(inst);
 }
 
 void IRGenerator::generateIf(std::shared_ptr<IfStmt> ifStmt) {
-    auto condition = generateExpression(ifStmt->condition);
+    ValueId condition = generateExpression(ifStmt->condition);
     
     // Create blocks
-    auto thenBlock = std::make_shared<IRBasicBlock>();
-    auto elseBlock = std::make_shared<IRBasicBlock>();
-    auto mergeBlock = std::make_shared<IRBasicBlock>();
-    
-    thenBlock->name = newLabel("then");
-    elseBlock->name = newLabel("else");
-    mergeBlock->name = newLabel("merge");
+    BlockId thenBlock = newBlock("then");
+    BlockId elseBlock = ifStmt->elseBranch ? newBlock("else") : INVALID_ID;
+    BlockId mergeBlock = newBlock("merge");
     
     // Conditional branch
-    auto condBr = std::make_shared<IRInstruction>(Opcode::CONDBR);
-    condBr->operands.push_back(condition);
-    condBr->operands.push_back(IRConstant::createI64(1)); // TODO: Use proper label
-    condBr->operands.push_back(IRConstant::createI64(2));
-    currentBlock_->instructions.push_back(condBr);
+    emitCondBranch(condition, thenBlock, elseBlock != INVALID_ID ? elseBlock : mergeBlock);
     
     // Generate then block
-    currentBlock_ = thenBlock;
-    currentFunction_->addBlock(thenBlock);
+    startBlock(thenBlock);
     generateStatement(ifStmt->thenBranch);
-    
-    if (!currentBlock_->instructions.empty() && 
-        currentBlock_->instructions.back()->opcode != Opcode::RET) {
-        auto br = std::make_shared<IRInstruction>(Opcode::BR);
-        currentBlock_->instructions.push_back(br);
-    }
+    emitBranch(mergeBlock);
     
     // Generate else block if present
     if (ifStmt->elseBranch) {
-        currentBlock_ = elseBlock;
-        currentFunction_->addBlock(elseBlock);
+        startBlock(elseBlock);
         generateStatement(ifStmt->elseBranch);
-        
-        if (!currentBlock_->instructions.empty() && 
-            currentBlock_->instructions.back()->opcode != Opcode::RET) {
-            auto br = std::make_shared<IRInstruction>(Opcode::BR);
-            currentBlock_->instructions.push_back(br);
-        }
+        emitBranch(mergeBlock);
     }
     
-    currentBlock_ = mergeBlock;
-    currentFunction_->addBlock(mergeBlock);
+    startBlock(mergeBlock);
 }
 
 void IRGenerator::generateWhile(std::shared_ptr<WhileStmt> whileStmt) {
-    auto condBlock = std::make_shared<IRBasicBlock>();
-    auto bodyBlock = std::make_shared<IRBasicBlock>();
-    auto exitBlock = std::make_shared<IRBasicBlock>();
-    
-    condBlock->name = newLabel("while.cond");
-    bodyBlock->name = newLabel("while.body");
-    exitBlock->name = newLabel("while.exit");
+    BlockId condBlock = newBlock("while.cond");
+    BlockId bodyBlock = newBlock("while.body");
+    BlockId exitBlock = newBlock("while.exit");
     
     // Branch to condition
-    auto br = std::make_shared<IRInstruction>(Opcode::BR);
-    currentBlock_->instructions.push_back(br);
+    emitBranch(condBlock);
+    startBlock(condBlock);
     
-    currentFunction_->addBlock(condBlock);
-    currentBlock_ = condBlock;
+    ValueId condition = generateExpression(whileStmt->condition);
+    emitCondBranch(condition, bodyBlock, exitBlock);
     
-    auto condition = generateExpression(whileStmt->condition);
-    
-    auto condBr = std::make_shared<IRInstruction>(Opcode::CONDBR);
-    condBr->operands.push_back(condition);
-    condBr->operands.push_back(IRConstant::createI64(1));
-    condBr->operands.push_back(IRConstant::createI64(2));
-    currentBlock_->instructions.push_back(condBr);
-    
-    currentFunction_->addBlock(bodyBlock);
-    currentBlock_ = bodyBlock;
+    startBlock(bodyBlock);
     generateStatement(whileStmt->body);
+    emitBranch(condBlock);
     
-    if (!currentBlock_->instructions.empty() && 
-        currentBlock_->instructions.back()->opcode != Opcode::RET) {
-        auto brBack = std::make_shared<IRInstruction>(Opcode::BR);
-        currentBlock_->instructions.push_back(brBack);
-    }
-    
-    currentFunction_->addBlock(exitBlock);
-    currentBlock_ = exitBlock;
+    startBlock(exitBlock);
 }
 
 void IRGenerator::generateFor(std::shared_ptr<ForStmt> forStmt) {
@@ -241,57 +241,37 @@ void IRGenerator::generateFor(std::shared_ptr<ForStmt> forStmt) {
         generateStatement(forStmt->init);
     }
     
-    auto condBlock = std::make_shared<IRBasicBlock>();
-    auto bodyBlock = std::make_shared<IRBasicBlock>();
-    auto updateBlock = std::make_shared<IRBasicBlock>();
-    auto exitBlock = std::make_shared<IRBasicBlock>();
-    
-    condBlock->name = newLabel("for.cond");
-    bodyBlock->name = newLabel("for.body");
-    updateBlock->name = newLabel("for.update");
-    exitBlock->name = newLabel("for.exit");
+    BlockId condBlock = newBlock("for.cond");
+    BlockId bodyBlock = newBlock("for.body");
+    BlockId updateBlock = newBlock("for.update");
+    BlockId exitBlock = newBlock("for.exit");
     
     // Branch to condition
-    auto br = std::make_shared<IRInstruction>(Opcode::BR);
-    currentBlock_->instructions.push_back(br);
-    
-    currentFunction_->addBlock(condBlock);
-    currentBlock_ = condBlock;
+    emitBranch(condBlock);
+    startBlock(condBlock);
     
     if (forStmt->condition) {
-        auto condition = generateExpression(forStmt->condition);
-        auto condBr = std::make_shared<IRInstruction>(Opcode::CONDBR);
-        condBr->operands.push_back(condition);
-        condBr->operands.push_back(IRConstant::createI64(1));
-        condBr->operands.push_back(IRConstant::createI64(2));
-        currentBlock_->instructions.push_back(condBr);
+        ValueId condition = generateExpression(forStmt->condition);
+        emitCondBranch(condition, bodyBlock, exitBlock);
+    } else {
+        emitBranch(bodyBlock);
     }
     
-    currentFunction_->addBlock(bodyBlock);
-    currentBlock_ = bodyBlock;
+    startBlock(bodyBlock);
     generateStatement(forStmt->body);
+    emitBranch(updateBlock);
     
-    if (!currentBlock_->instructions.empty() && 
-        currentBlock_->instructions.back()->opcode != Opcode::RET) {
-        auto br = std::make_shared<IRInstruction>(Opcode::BR);
-        currentBlock_->instructions.push_back(br);
-    }
-    
-    currentFunction_->addBlock(updateBlock);
-    currentBlock_ = updateBlock;
+    startBlock(updateBlock);
     if (forStmt->update) {
         generateExpression(forStmt->update);
     }
+    emitBranch(condBlock);
     
-    auto brCond = std::make_shared<IRInstruction>(Opcode::BR);
-    currentBlock_->instructions.push_back(brCond);
-    
-    currentFunction_->addBlock(exitBlock);
-    currentBlock_ = exitBlock;
+    startBlock(exitBlock);
 }
 
-std::shared_ptr<IRValue> IRGenerator::generateExpression(std::shared_ptr<Expression> expr) {
-    if (!expr) return nullptr;
+ValueId IRGenerator::generateExpression(std::shared_ptr<Expression> expr) {
+    if (!expr) return INVALID_ID;
     
     if (auto lit = std::dynamic_pointer_cast<LiteralExpr>(expr)) {
         return generateLiteral(lit);
@@ -313,47 +293,57 @@ std::shared_ptr<IRValue> IRGenerator::generateExpression(std::shared_ptr<Express
         return generateAsm(asmExpr);
     }
     
-    return nullptr;
+    return INVALID_ID;
 }
 
-std::shared_ptr<IRValue> IRGenerator::generateLiteral(std::shared_ptr<LiteralExpr> lit) {
+ValueId IRGenerator::generateLiteral(std::shared_ptr<LiteralExpr> lit) {
+    IRArena& arena = module_->arena;
     switch (lit->kind) {
         case LiteralExpr::Kind::INT:
-            return IRConstant::createI64(std::stoll(lit->value));
+            return arena.createI64(std::stoll(lit->value));
         case LiteralExpr::Kind::FLOAT:
-            return IRConstant::createF64(std::stod(lit->value));
+            return arena.createF64(std::stod(lit->value));
         case LiteralExpr::Kind::BOOL:
-            return IRConstant::createBool(lit->value == "true");
+            return arena.createBool(lit->value == "true");
         case LiteralExpr::Kind::STRING:
             // For now, just return a pointer
-            return IRConstant::createI64(0); // TODO: String handling
+            return arena.createI64(0); // TODO: String handling
         default:
-            return nullptr;
+            return INVALID_ID;
     }
 }
 
-std::shared_ptr<IRValue> IRGenerator::generateIdentifier(std::shared_ptr<IdentifierExpr> ident) {
+ValueId IRGenerator::generateIdentifier(std::shared_ptr<IdentifierExpr> ident) {
     // Look up in variables
     auto it = variables_.find(ident->name);
     if (it != variables_.end()) {
         // Load the variable
-        auto loadInst = std::make_shared<IRInstruction>(Opcode::LOAD);
-        loadInst->operands.push_back(it->second);
-        auto result = newTemp();
-        loadInst->result = result;
-        currentBlock_->instructions.push_back(loadInst);
+        ValueId result = newTemp();
+        emit(Opcode::LOAD, {it->second}, result);
         return result;
     }
     
     // Could be a function reference
-    return nullptr;
+    return INVALID_ID;
 }
 
-std::shared_ptr<IRValue> IRGenerator::generateBinary(std::shared_ptr<BinaryExpr> binary) {
-    auto left = generateExpression(binary->left);
-    auto right = generateExpression(binary->right);
+ValueId IRGenerator::generateBinary(std::shared_ptr<BinaryExpr> binary) {
+    switch (binary->op) {
+        case TokenType::EQUAL:
+        case TokenType::PLUS_EQUAL:
+        case TokenType::MINUS_EQUAL:
+        case TokenType::STAR_EQUAL:
+        case TokenType::SLASH_EQUAL:
+        case TokenType::PERCENT_EQUAL:
+            return generateAssignment(binary);
+        default:
+            break;
+    }
     
-    if (!left || !right) return nullptr;
+    ValueId left = generateExpression(binary->left);
+    ValueId right = generateExpression(binary->right);
+    
+    if (left == INVALID_ID || right == INVALID_ID) return INVALID_ID;
     
     Opcode op;
     switch (binary->op) {
@@ -373,22 +363,86 @@ std::shared_ptr<IRValue> IRGenerator::generateBinary(std::shared_ptr<BinaryExpr>
         case TokenType::GREATER: op = Opcode::GT; break;
         case TokenType::LESS_EQUAL: op = Opcode::LE; break;
         case TokenType::GREATER_EQUAL: op = Opcode::GE; break;
-        default: return left; // Assignment handled elsewhere
+        default: return left;
     }
     
-    auto inst = std::make_shared<IRInstruction>(op);
-    inst->operands.push_back(left);
-    inst->operands.push_back(right);
-    auto result = newTemp();
-    inst->result = result;
-    currentBlock_->instructions.push_back(inst);
+    ValueId result = newTemp();
+    emit(op, {left, right}, result);
     
     return result;
 }
 
-std::shared_ptr<IRValue> IRGenerator::generateUnary(std::shared_ptr<UnaryExpr> unary) {
-    auto operand = generateExpression(unary->operand);
-    if (!operand) return nullptr;
+namespace {
+
+// The operation of a compound assignment (x op= v)
+Opcode compoundOpcode(TokenType op) {
+    switch (op) {
+        case TokenType::MINUS_EQUAL: return Opcode::SUB;
+        case TokenType::STAR_EQUAL: return Opcode::MUL;
+        case TokenType::SLASH_EQUAL: return Opcode::DIV;
+        case TokenType::PERCENT_EQUAL: return Opcode::MOD;
+        default: return Opcode::ADD;
+    }
+}
+
+} // namespace
+
+ValueId IRGenerator::generateAssignment(std::shared_ptr<BinaryExpr> assign) {
+    if (auto index = std::dynamic_pointer_cast<IndexExpr>(assign->left)) {
+        return generateIndexAssignment(index, assign);
+    }
+    
+    // Otherwise only plain variables are assignable
+    auto target = std::dynamic_pointer_cast<IdentifierExpr>(assign->left);
+    if (!target) return INVALID_ID;
+    auto it = variables_.find(target->name);
+    if (it == variables_.end()) return INVALID_ID;
+    
+    ValueId value = generateExpression(assign->right);
+    if (value == INVALID_ID) return INVALID_ID;
+    
+    // Compound assignment: x op= v  ->  x = x op v
+    if (assign->op != TokenType::EQUAL) {
+        ValueId current = newTemp();
+        emit(Opcode::LOAD, {it->second}, current);
+        ValueId combined = newTemp();
+        emit(compoundOpcode(assign->op), {current, value}, combined);
+        value = combined;
+    }
+    
+    emit(Opcode::STORE, {value, it->second});
+    return value;
+}
+
+ValueId IRGenerator::generateIndexAssignment(std::shared_ptr<IndexExpr> target,
+                                             std::shared_ptr<BinaryExpr> assign) {
+    ValueId base = generateExpression(target->base);
+    ValueId idx = generateExpression(target->index);
+    ValueId value = generateExpression(assign->right);
+    if (base == INVALID_ID || idx == INVALID_ID || value == INVALID_ID) return INVALID_ID;
+    
+    IRType type = elementType(target->base);
+    if (assign->op != TokenType::EQUAL) {
+        ValueId current = newTemp(type);
+        emit(Opcode::LOAD, {base, idx}, current);
+        ValueId combined = newTemp();
+        emit(compoundOpcode(assign->op), {current, value}, combined);
+        value = combined;
+    }
+    
+    // The stored value's type gives the width written
+    if (module_->arena.value(value).getType() != type) {
+        ValueId narrowed = newTemp(type);
+        emit(Opcode::TRUNC, {value}, narrowed);
+        value = narrowed;
+    }
+    emit(Opcode::STORE, {value, base, idx});
+    return value;
+}
+
+ValueId IRGenerator::generateUnary(std::shared_ptr<UnaryExpr> unary) {
+    ValueId operand = generateExpression(unary->operand);
+    if (operand == INVALID_ID) return INVALID_ID;
     
     Opcode op;
     switch (unary->op) {
@@ -398,37 +452,34 @@ std::shared_ptr<IRValue> IRGenerator::generateUnary(std::shared_ptr<UnaryExpr> u
         default: return operand;
     }
     
-    auto inst = std::make_shared<IRInstruction>(op);
-    inst->operands.push_back(operand);
-    auto result = newTemp();
-    inst->result = result;
-    currentBlock_->instructions.push_back(inst);
+    ValueId result = newTemp();
+    emit(op, {operand}, result);
     
     return result;
 }
 
-std::shared_ptr<IRValue> IRGenerator::generateCall(std::shared_ptr<CallExpr> call) {
-    std::vector<std::shared_ptr<IRValue>> args;
+ValueId IRGenerator::generateCall(std::shared_ptr<CallExpr> call) {
+    std::vector<ValueId> args;
     for (const auto& arg : call->args) {
-        args.push_back(generateExpression(arg));
+        ValueId value = generateExpression(arg);
+        if (value != INVALID_ID) {
+            args.push_back(value);
+        }
     }
     
-    auto inst = std::make_shared<IRInstruction>(Opcode::CALL);
-    // Add function reference
-    // inst->operands.push_back(...);
-    for (const auto& arg : args) {
-        inst->operands.push_back(arg);
+    // Direct calls name their function; anything else stays indirect
+    ValueId result = newTemp();
+    InstId inst = module_->arena.createInstruction(Opcode::CALL, args, result);
+    if (auto name = std::dynamic_pointer_cast<IdentifierExpr>(call->callee)) {
+        module_->arena.instruction(inst).callee = module_->arena.createSymbol(name->name);
     }
-    
-    auto result = newTemp();
-    inst->result = result;
-    currentBlock_->instructions.push_back(inst);
+    module_->arena.block(currentBlock_).instructions.push_back(inst);
     
     return result;
 }
 
-std::shared_ptr<IRValue> IRGenerator::generateCast(std::shared_ptr<CastExpr> cast) {
-    auto value = generateExpression(cast->expr);
+ValueId IRGenerator::generateCast(std::shared_ptr<CastExpr> cast) {
+    ValueId value = generateExpression(cast->expr);
     IRType targetType = convertType(cast->targetType);
     
     // For now, just return the value
@@ -436,45 +487,94 @@ std::shared_ptr<IRValue> IRGenerator::generateCast(std::shared_ptr<CastExpr> cas
     return value;
 }
 
-std::shared_ptr<IRValue> IRGenerator::generateIndex(std::shared_ptr<IndexExpr> index) {
-    auto base = generateExpression(index->base);
-    auto idx = generateExpression(index->index);
+ValueId IRGenerator::generateIndex(std::shared_ptr<IndexExpr> index) {
+    ValueId base = generateExpression(index->base);
+    ValueId idx = generateExpression(index->index);
+    if (base == INVALID_ID || idx == INVALID_ID) return INVALID_ID;
     
-    // Load from indexed location
-    auto loadInst = std::make_shared<IRInstruction>(Opcode::LOAD);
-    loadInst->operands.push_back(base);
-    loadInst->operands.push_back(idx);
-    
-    auto result = newTemp();
-    loadInst->result = result;
-    currentBlock_->instructions.push_back(loadInst);
+    // Load the element at base + idx * size, extended to 64 bits
+    ValueId result = newTemp(elementType(index->base));
+    emit(Opcode::LOAD, {base, idx}, result);
     
     return result;
 }
 
-std::shared_ptr<IRValue> IRGenerator::generateMemberAccess(std::shared_ptr<MemberAccessExpr> access) {
-    auto obj = generateExpression(access->object);
+IRType IRGenerator::elementType(std::shared_ptr<Expression> base) const {
+    // Pointers without a known pointee index 64-bit words
+    if (auto ident = std::dynamic_pointer_cast<IdentifierExpr>(base)) {
+        auto it = elementTypes_.find(ident->name);
+        if (it != elementTypes_.end()) return it->second;
+    }
+    return IRType::I64;
+}
+
+ValueId IRGenerator::generateMemberAccess(std::shared_ptr<MemberAccessExpr> access) {
+    ValueId obj = generateExpression(access->object);
     
     // Calculate offset and load
     // TODO: Implement struct field access
     return obj;
 }
 
-std::shared_ptr<IRValue> IRGenerator::generateAsm(std::shared_ptr<AsmExpr> asmExpr) {
+ValueId IRGenerator::generateAsm(std::shared_ptr<AsmExpr> asmExpr) {
     // For now, just emit the inline assembly as a comment
     // TODO: Implement proper inline assembly support
-    return nullptr;
+    return INVALID_ID;
 }
 
-std::shared_ptr<IRVariable> IRGenerator::newTemp() {
-    auto temp = std::make_shared<IRVariable>(IRType::I64);
-    temp->name = "t" + std::to_string(tempCounter_++);
-    temp->isGlobal = false;
-    return temp;
+ValueId IRGenerator::newTemp(IRType type) {
+    return module_->arena.createVariable(type, "t" + std::to_string(tempCounter_++));
+}
+
+void IRGenerator::notePointer(const std::string& name, std::shared_ptr<Type> type) {
+    if (type && type->category == TypeCategory::POINTER && type->baseType) {
+        IRType element = convertType(type->baseType);
+        if (getTypeSize(element) > 0) {
+            elementTypes_[name] = element;
+            return;
+        }
+    }
+    elementTypes_.erase(name);
 }
 
 std::string IRGenerator::newLabel(const std::string& prefix) {
     return prefix + std::to_string(labelCounter_++);
 }
 
+BlockId IRGenerator::newBlock(const std::string& prefix) {
+    return module_->arena.createBlock(newLabel(prefix));
+}
+
+void IRGenerator::startBlock(BlockId block) {
+    currentFunction_->addBlock(block);
+    currentBlock_ = block;
+}
+
+InstId IRGenerator::emit(Opcode op, std::initializer_list<ValueId> operands, ValueId result) {
+    InstId inst = module_->arena.createInstruction(op, operands, result);
+    module_->arena.block(currentBlock_).instructions.push_back(inst);
+    return inst;
+}
+
+void IRGenerator::emitBranch(BlockId target) {
+    if (isTerminated()) return;
+    InstId br = emit(Opcode::BR);
+    module_->arena.instruction(br).targets[0] = target;
+}
+
+void IRGenerator::emitCondBranch(ValueId condition, BlockId ifTrue, BlockId ifFalse) {
+    InstId condBr = condition != INVALID_ID ? emit(Opcode::CONDBR, {condition})
+                                            : emit(Opcode::CONDBR);
+    IRInstruction& inst = module_->arena.instruction(condBr);
+    inst.targets[0] = ifTrue;
+    inst.targets[1] = ifFalse;
+}
+
+bool IRGenerator::isTerminated() const {
+    const IRArena& arena = module_->arena;
+    const IRBasicBlock& block = arena.block(currentBlock_);
+    return !block.instructions.empty() &&
+           arena.instruction(block.instructions.back()).isTerminator();
+}
+
 } // namespace syclang
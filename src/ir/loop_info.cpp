@@ -0,0 +1,86 @@
+#include "syclang/ir/loop_info.h"
+#include <algorithm>
+#include <unordered_map>
+
+namespace syclang {
+
+LoopInfo::LoopInfo(const IRFunction& func, const DominatorTree& dom) {
+    std::unordered_map<BlockId, size_t> layout;
+    for (size_t b = 0; b < func.blocks.size(); ++b) {
+        layout[func.blocks[b]] = b;
+    }
+
+    std::unordered_map<BlockId, size_t> loopOf; // Header -> index in loops_
+    for (BlockId block : dom.reversePostorder()) {
+        for (BlockId succ : dom.successors(block)) {
+            if (!dom.dominates(succ, block)) continue;
+            auto [it, inserted] = loopOf.try_emplace(succ, loops_.size());
+            if (inserted) {
+                Loop loop;
+                loop.header = succ;
+                loop.members.insert(succ);
+                loops_.push_back(std::move(loop));
+            }
+            Loop& loop = loops_[it->second];
+            if (std::find(loop.latches.begin(), loop.latches.end(), block) == loop.latches.end()) {
+                loop.latches.push_back(block);
+            }
+            // Walk backwards from the latch up to the header
+            std::vector<BlockId> work{block};
+            while (!work.empty()) {
+                BlockId current = work.back();
+                work.pop_back();
+                if (!loop.members.insert(current).second) continue;
+                for (BlockId pred : dom.predecessors(current)) {
+                    if (dom.isReachable(pred)) work.push_back(pred);
+                }
+            }
+        }
+    }
+
+    for (Loop& loop : loops_) {
+        for (BlockId block : func.blocks) {
+            if (block != loop.header && loop.contains(block)) loop.blocks.push_back(block);
+        }
+        loop.blocks.insert(loop.blocks.begin(), loop.header);
+        for (BlockId block : loop.blocks) {
+            for (BlockId succ : dom.successors(block)) {
+                if (!loop.contains(succ) &&
+                    std::find(loop.exits.begin(), loop.exits.end(), succ) == loop.exits.end()) {
+                    loop.exits.push_back(succ);
+                }
+            }
+        }
+        BlockId outside = INVALID_ID;
+        size_t outsideCount = 0;
+        for (BlockId pred : dom.predecessors(loop.header)) {
+            if (!loop.contains(pred)) {
+                outside = pred;
+                ++outsideCount;
+            }
+        }
+        if (outsideCount == 1 && dom.successors(outside).size() == 1) {
+            loop.preheader = outside;
+        }
+    }
+
+    // Inner loops are strictly smaller than the loops around them
+    std::sort(loops_.begin(), loops_.end(), [&](const Loop& a, const Loop& b) {
+        if (a.members.size() != b.members.size()) return a.members.size() < b.members.size();
+        return layout[a.header] < layout[b.header];
+    });
+    for (size_t i = 0; i < loops_.size(); ++i) {
+        for (size_t j = i + 1; j < loops_.size(); ++j) {
+            if (loops_[j].contains(loops_[i].header)) {
+                loops_[i].parent = static_cast<int>(j);
+                break;
+            }
+        }
+    }
+    for (size_t i = loops_.size(); i-- > 0;) {
+        int parent = loops_[i].parent;
+        loops_[i].depth = parent < 0 ? 1 : loops_[parent].depth + 1;
+    }
+}
+
+} // namespace syclang
@@ -0,0 +1,316 @@
+#include "syclang/ir/mem2reg.h"
+#include "syclang/ir/dominators.h"
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace syclang {
+
+namespace {
+
+struct Phi {
+    InstId inst;
+    uint32_t variable;
+    BlockId block;
+    std::vector<ValueId> incoming; // Parallel to the block's predecessors
+    bool removed = false;
+};
+
+// Drop instructions after the first terminator, then blocks the entry
+// cannot reach; neither is ever executed
+void removeUnreachable(IRArena& arena, IRFunction& func) {
+    for (BlockId blockId : func.blocks) {
+        auto& insts = arena.block(blockId).instructions;
+        auto terminator = std::find_if(insts.begin(), insts.end(), [&](InstId id) {
+            return arena.instruction(id).isTerminator();
+        });
+        if (terminator != insts.end()) {
+            insts.erase(terminator + 1, insts.end());
+        }
+    }
+    DominatorTree cfg(arena, func);
+    if (cfg.reversePostorder().size() != func.blocks.size()) {
+        std::erase_if(func.blocks, [&](BlockId block) { return !cfg.isReachable(block); });
+    }
+}
+
+} // namespace
+
+size_t promoteMemoryToRegisters(IRArena& arena, IRFunction& func) {
+    if (func.blocks.empty()) return 0;
+    removeUnreachable(arena, func);
+    DominatorTree dom(arena, func);
+
+    std::unordered_map<BlockId, uint32_t> blockIndex;
+    for (uint32_t b = 0; b < func.blocks.size(); ++b) {
+        blockIndex[func.blocks[b]] = b;
+    }
+
+    // Candidates: local ALLOCAs whose address never escapes a LOAD/STORE
+    std::unordered_map<ValueId, uint32_t> variableIndex;
+    std::vector<ValueId> variables;
+    for (BlockId blockId : func.blocks) {
+        for (InstId instId : arena.block(blockId).instructions) {
+            const IRInstruction& inst = arena.instruction(instId);
+            if (inst.opcode == Opcode::ALLOCA && inst.result != INVALID_ID &&
+                !arena.value(inst.result).isGlobal && !variableIndex.count(inst.result)) {
+                variableIndex[inst.result] = static_cast<uint32_t>(variables.size());
+                variables.push_back(inst.result);
+            }
+        }
+    }
+    std::vector<bool> promotable(variables.size(), true);
+    for (BlockId blockId : func.blocks) {
+        for (InstId instId : arena.block(blockId).instructions) {
+            const IRInstruction& inst = arena.instruction(instId);
+            auto ops = arena.operands(inst);
+            for (size_t i = 0; i < ops.size(); ++i) {
+                auto it = variableIndex.find(ops[i]);
+                if (it == variableIndex.end()) continue;
+                bool access = (inst.opcode == Opcode::LOAD && ops.size() == 1) ||
+                              (inst.opcode == Opcode::STORE && ops.size() == 2 && i == 1);
+                if (!access) promotable[it->second] = false;
+            }
+        }
+    }
+    std::unordered_map<ValueId, uint32_t> promoted;
+    std::vector<ValueId> promotedVariables;
+    for (size_t v = 0; v < variables.size(); ++v) {
+        if (promotable[v]) {
+            promoted[variables[v]] = static_cast<uint32_t>(promotedVariables.size());
+            promotedVariables.push_back(variables[v]);
+        }
+    }
+    if (promotedVariables.empty()) return 0;
+    size_t count = promotedVariables.size();
+
+    auto promotedIndex = [&](ValueId value) {
+        auto it = promoted.find(value);
+        return it == promoted.end() ? INVALID_ID : it->second;
+    };
+
+    // Blocks that store each variable, and whether any block reads it
+    // before writing it (otherwise no PHI can ever be live)
+    std::vector<std::vector<BlockId>> defBlocks(count);
+    std::vector<bool> readAcrossBlocks(count, false);
+    std::vector<uint32_t> storedIn(count, INVALID_ID);
+    for (uint32_t b = 0; b < func.blocks.size(); ++b) {
+        for (InstId instId : arena.block(func.blocks[b]).instructions) {
+            const IRInstruction& inst = arena.instruction(instId);
+            auto ops = arena.operands(inst);
+            if (inst.opcode == Opcode::LOAD && ops.size() == 1) {
+                uint32_t v = promotedIndex(ops[0]);
+                if (v != INVALID_ID && storedIn[v] != b) readAcrossBlocks[v] = true;
+            } else if (inst.opcode == Opcode::STORE && ops.size() == 2) {
+                uint32_t v = promotedIndex(ops[1]);
+                if (v != INVALID_ID && storedIn[v] != b) {
+                    storedIn[v] = b;
+                    defBlocks[v].push_back(func.blocks[b]);
+                }
+            }
+        }
+    }
+
+    // PHI placement at the iterated dominance frontier
+    std::vector<Phi> phis;
+    std::vector<std::vector<size_t>> blockPhis(func.blocks.size());
+    std::vector<uint32_t> hasPhi(func.blocks.size(), INVALID_ID);
+    std::vector<uint32_t> queued(func.blocks.size(), INVALID_ID);
+    uint32_t version = 0;
+    for (uint32_t v = 0; v < count; ++v) {
+        if (!readAcrossBlocks[v]) continue;
+        std::vector<BlockId> worklist = defBlocks[v];
+        for (BlockId block : worklist) queued[blockIndex[block]] = v;
+        while (!worklist.empty()) {
+            BlockId block = worklist.back();
+            worklist.pop_back();
+            for (BlockId join : dom.frontier(block)) {
+                uint32_t j = blockIndex[join];
+                if (hasPhi[j] == v) continue;
+                hasPhi[j] = v;
+                const IRValue& variable = arena.value(promotedVariables[v]);
+                ValueId result = arena.createVariable(variable.getType(),
+                                                      variable.name + "." + std::to_string(++version));
+                blockPhis[j].push_back(phis.size());
+                phis.push_back({arena.createInstruction(Opcode::PHI, {}, result), v, join,
+                                std::vector<ValueId>(dom.predecessors(join).size(), INVALID_ID)});
+                if (queued[j] != v) {
+                    queued[j] = v;
+                    worklist.push_back(join);
+                }
+            }
+        }
+    }
+
+    // Rename along the dominator tree: each variable's stack holds the
+    // value of its latest store on the path from the entry
+    std::vector<std::vector<ValueId>> stacks(count);
+    std::unordered_map<ValueId, ValueId> replacement;
+    ValueId undefined = arena.createI64(0);
+    auto current = [&](uint32_t v) { return stacks[v].empty() ? undefined : stacks[v].back(); };
+    auto resolve = [&](ValueId value) {
+        auto it = replacement.find(value);
+        return it == replacement.end() ? value : it->second;
+    };
+
+    struct Frame {
+        BlockId block;
+        std::vector<uint32_t> pushed; // Variables to pop on exit
+        size_t nextChild = 0;
+    };
+    std::vector<Frame> walk;
+    auto enter = [&](BlockId blockId) {
+        Frame frame{blockId, {}, 0};
+        uint32_t b = blockIndex[blockId];
+        for (size_t p : blockPhis[b]) {
+            stacks[phis[p].variable].push_back(arena.instruction(phis[p].inst).result);
+            frame.pushed.push_back(phis[p].variable);
+        }
+
+        auto& insts = arena.block(blockId).instructions;
+        std::vector<InstId> kept;
+        kept.reserve(blockPhis[b].size() + insts.size());
+        for (size_t p : blockPhis[b]) kept.push_back(phis[p].inst);
+        for (InstId instId : insts) {
+            IRInstruction& inst = arena.instruction(instId);
+            auto ops = arena.operands(inst);
+            if (inst.opcode == Opcode::ALLOCA && promotedIndex(inst.result) != INVALID_ID) {
+                continue;
+            }
+            if (inst.opcode == Opcode::LOAD && ops.size() == 1) {
+                uint32_t v = promotedIndex(ops[0]);
+                if (v != INVALID_ID) {
+                    if (inst.result != INVALID_ID) replacement[inst.result] = current(v);
+                    continue;
+                }
+            }
+            if (inst.opcode == Opcode::STORE && ops.size() == 2) {
+                uint32_t v = promotedIndex(ops[1]);
+                if (v != INVALID_ID) {
+                    stacks[v].push_back(resolve(ops[0]));
+                    frame.pushed.push_back(v);
+                    continue;
+                }
+            }
+            for (ValueId& op : ops) op = resolve(op);
+            kept.push_back(instId);
+        }
+        insts.swap(kept);
+
+        // Fill in this block's edge into each successor's PHIs
+        const auto& successors = dom.successors(blockId);
+        for (size_t s = 0; s < successors.size(); ++s) {
+            BlockId succ = successors[s];
+            if (std::find(successors.begin(), successors.begin() + s, succ) !=
+                successors.begin() + s) {
+                continue; // Both CONDBR targets: handled on the first visit
+            }
+            const auto& preds = dom.predecessors(succ);
+            for (size_t p : blockPhis[blockIndex[succ]]) {
+                for (size_t i = 0; i < preds.size(); ++i) {
+                    if (preds[i] == blockId) phis[p].incoming[i] = current(phis[p].variable);
+                }
+            }
+        }
+        walk.push_back(std::move(frame));
+    };
+
+    enter(func.blocks[0]);
+    while (!walk.empty()) {
+        Frame& frame = walk.back();
+        const auto& children = dom.children(frame.block);
+        if (frame.nextChild < children.size()) {
+            enter(children[frame.nextChild++]);
+            continue;
+        }
+        for (uint32_t v : frame.pushed) stacks[v].pop_back();
+        walk.pop_back();
+    }
+
+    // A PHI whose inputs are all itself or one other value is that value
+    std::unordered_map<ValueId, size_t> phiOf;
+    for (size_t p = 0; p < phis.size(); ++p) {
+        phiOf[arena.instruction(phis[p].inst).result] = p;
+    }
+    std::unordered_map<ValueId, ValueId> forward;
+    auto follow = [&](ValueId value) {
+        for (auto it = forward.find(value); it != forward.end(); it = forward.find(value)) {
+            value = it->second;
+        }
+        return value;
+    };
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (Phi& phi : phis) {
+            if (phi.removed) continue;
+            ValueId self = arena.instruction(phi.inst).result;
+            ValueId unique = INVALID_ID;
+            bool trivial = true;
+            for (ValueId& value : phi.incoming) {
+                value = follow(value);
+                if (value == self || value == unique) continue;
+                if (unique != INVALID_ID) {
+                    trivial = false;
+                    break;
+                }
+                unique = value;
+            }
+            if (trivial) {
+                forward[self] = unique == INVALID_ID ? undefined : unique;
+                phi.removed = true;
+                changed = true;
+            }
+        }
+    }
+
+    // Keep only PHIs that something other than a dead PHI reads
+    std::vector<size_t> liveWork;
+    std::vector<bool> live(phis.size(), false);
+    auto markLive = [&](ValueId value) {
+        auto it = phiOf.find(value);
+        if (it != phiOf.end() && !phis[it->second].removed && !live[it->second]) {
+            live[it->second] = true;
+            liveWork.push_back(it->second);
+        }
+    };
+    for (BlockId blockId : func.blocks) {
+        for (InstId instId : arena.block(blockId).instructions) {
+            IRInstruction& inst = arena.instruction(instId);
+            if (inst.opcode == Opcode::PHI) continue;
+            for (ValueId& op : arena.operands(inst)) {
+                if (!forward.empty()) op = follow(op);
+                markLive(op);
+            }
+        }
+    }
+    while (!liveWork.empty()) {
+        size_t p = liveWork.back();
+        liveWork.pop_back();
+        for (ValueId& value : phis[p].incoming) {
+            value = follow(value);
+            markLive(value);
+        }
+    }
+
+    std::unordered_set<InstId> dropped;
+    for (size_t p = 0; p < phis.size(); ++p) {
+        if (!live[p]) {
+            dropped.insert(phis[p].inst);
+            continue;
+        }
+        arena.setIncoming(arena.instruction(phis[p].inst), phis[p].incoming,
+                          dom.predecessors(phis[p].block));
+    }
+    if (!dropped.empty()) {
+        for (uint32_t b = 0; b < blockPhis.size(); ++b) {
+            if (blockPhis[b].empty()) continue;
+            std::erase_if(arena.block(func.blocks[b]).instructions,
+                          [&](InstId id) { return dropped.count(id) != 0; });
+        }
+    }
+    return count;
+}
+
+} // namespace syclang
@@ -0,0 +1,85 @@
+#include "syclang/ir/use_def.h"
+#include <algorithm>
+
+namespace syclang {
+
+UseDefChains::UseDefChains(const IRArena& arena, const IRFunction& func) {
+    for (BlockId blockId : func.blocks) {
+        for (InstId instId : arena.block(blockId).instructions) {
+            const IRInstruction& inst = arena.instruction(instId);
+            blocks_[instId] = blockId;
+            if (inst.result != INVALID_ID) {
+                entry(inst.result).definition = instId;
+            }
+            for (ValueId op : arena.operands(inst)) {
+                entry(op).users.push_back(instId);
+            }
+        }
+    }
+}
+
+InstId UseDefChains::definition(ValueId value) const {
+    auto it = values_.find(value);
+    return it == values_.end() ? INVALID_ID : it->second.definition;
+}
+
+std::span<const InstId> UseDefChains::users(ValueId value) const {
+    auto it = values_.find(value);
+    if (it == values_.end()) return {};
+    return it->second.users;
+}
+
+BlockId UseDefChains::blockOf(InstId inst) const {
+    auto it = blocks_.find(inst);
+    return it == blocks_.end() ? INVALID_ID : it->second;
+}
+
+void UseDefChains::replaceAllUses(IRArena& arena, ValueId from, ValueId to) {
+    if (from == to) return;
+    auto it = values_.find(from);
+    if (it == values_.end() || it->second.users.empty()) return;
+    std::vector<InstId> moved = std::move(it->second.users);
+    it->second.users.clear();
+    for (InstId user : moved) {
+        for (ValueId& op : arena.operands(arena.instruction(user))) {
+            if (op == from) op = to;
+        }
+    }
+    // `moved` repeats a user once per slot, matching the slots rewritten
+    auto& target = entry(to).users;
+    target.insert(target.end(), moved.begin(), moved.end());
+}
+
+void UseDefChains::insert(const IRArena& arena, InstId inst, BlockId block) {
+    const IRInstruction& instruction = arena.instruction(inst);
+    blocks_[inst] = block;
+    if (instruction.result != INVALID_ID) {
+        entry(instruction.result).definition = inst;
+    }
+    for (ValueId op : arena.operands(instruction)) {
+        entry(op).users.push_back(inst);
+    }
+}
+
+void UseDefChains::erase(const IRArena& arena, InstId inst) {
+    const IRInstruction& instruction = arena.instruction(inst);
+    for (ValueId op : arena.operands(instruction)) {
+        auto it = values_.find(op);
+        if (it == values_.end()) continue;
+        auto& users = it->second.users;
+        auto user = std::find(users.begin(), users.end(), inst);
+        if (user != users.end()) {
+            *user = users.back();
+            users.pop_back();
+        }
+    }
+    if (instruction.result != INVALID_ID) {
+        auto it = values_.find(instruction.result);
+        if (it != values_.end() && it->second.definition == inst) {
+            it->second.definition = INVALID_ID;
+        }
+    }
+    blocks_.erase(inst);
+}
+
+} // namespace syclang
@@ -1,4 +1,5 @@
 #include "syclang/lexer/chinese_lexer.h"
+#include "syclang/lexer/keyword_table.h"
 #include <algorithm>
 
 namespace syclang {
@@ -13,75 +14,14 @@ ChineseKeywordMap::ChineseKeywordMap() {
 }
 
 void ChineseKeywordMap::initializeMap() {
-    // 函数相关
-    chineseToEnglish_["计算"] = TokenType::KW_FN;
-    chineseToEnglish_["函数"] = TokenType::KW_FN;
-    chineseToEnglish_["功能"] = TokenType::KW_FN;
-    
-    // 控制流
-    chineseToEnglish_["如果"] = TokenType::KW_IF;
-    chineseToEnglish_["若"] = TokenType::KW_IF;
-    chineseToEnglish_["否则"] = TokenType::KW_ELSE;
-    chineseToEnglish_["其它"] = TokenType::KW_ELSE;
-    
-    // 循环
-    chineseToEnglish_["循环"] = TokenType::KW_WHILE;
-    chineseToEnglish_["当"] = TokenType::KW_WHILE;
-    chineseToEnglish_["遍历"] = TokenType::KW_FOR;
-    chineseToEnglish_["针对"] = TokenType::KW_FOR;
-    
-    // 返回
-    chineseToEnglish_["返回"] = TokenType::KW_RETURN;
-    chineseToEnglish_["回传"] = TokenType::KW_RETURN;
-    
-    // 变量
-    chineseToEnglish_["变量"] = TokenType::KW_LET;
-    chineseToEnglish_["设"] = TokenType::KW_LET;
-    chineseToEnglish_["可变"] = TokenType::KW_MUT;
-    chineseToEnglish_["常量"] = TokenType::KW_CONST;
-    
-    // 结构
-    chineseToEnglish_["结构"] = TokenType::KW_STRUCT;
-    chineseToEnglish_["类"] = TokenType::KW_STRUCT;
-    chineseToEnglish_["枚举"] = TokenType::KW_ENUM;
-    chineseToEnglish_["联合"] = TokenType::KW_UNION;
-    
-    // 特性
-    chineseToEnglish_["特性"] = TokenType::KW_TRAIT;
-    chineseToEnglish_["接口"] = TokenType::KW_TRAIT;
-    chineseToEnglish_["实现"] = TokenType::KW_IMPL;
-    
-    // 布尔值
-    chineseToEnglish_["真"] = TokenType::KW_TRUE;
-    chineseToEnglish_["假"] = TokenType::KW_FALSE;
-    chineseToEnglish_["空"] = TokenType::KW_NULL;
-    
-    // 异步
-    chineseToEnglish_["异步"] = TokenType::KW_ASYNC;
-    chineseToEnglish_["等待"] = TokenType::KW_AWAIT;
-    
-    // 模式匹配
-    chineseToEnglish_["匹配"] = TokenType::KW_MATCH;
-    chineseToEnglish_["模式"] = TokenType::KW_MATCH;
-    
-    // 类型
-    chineseToEnglish_["整数"] = TokenType::TYPE_I32;
-    chineseToEnglish_["浮点"] = TokenType::TYPE_F64;
-    chineseToEnglish_["字符"] = TokenType::TYPE_CHAR;
-    chineseToEnglish_["字符串"] = TokenType::TYPE_STRING;
-    chineseToEnglish_["布尔"] = TokenType::TYPE_BOOL;
-    chineseToEnglish_["无值"] = TokenType::TYPE_VOID;
-    
-    // 操作符
-    chineseToEnglish_["加"] = TokenType::PLUS;
-    chineseToEnglish_["减"] = TokenType::MINUS;
-    chineseToEnglish_["乘"] = TokenType::STAR;
-    chineseToEnglish_["除"] = TokenType::SLASH;
-    chineseToEnglish_["模"] = TokenType::PERCENT;
-    
-    // 反向映射（英文到中文）
-    for (const auto& pair : chineseToEnglish_) {
-        englishToChinese_[pair.second] = pair.first;
+    // 中文关键字与词法分析器共用同一张关键字表
+    for (const auto& entry : KEYWORDS) {
+        if (isChineseSpelling(entry.text)) {
+            chineseToEnglish_.emplace(std::string(entry.text), entry.type);
+            
+            // 反向映射（英文到中文），取表中第一个别名
+            englishToChinese_.emplace(entry.type, std::string(entry.text));
+        }
     }
 }
 
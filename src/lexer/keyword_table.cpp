@@ -0,0 +1,79 @@
+#include "syclang/lexer/keyword_table.h"
+#include <array>
+#include <cstdint>
+
+namespace syclang {
+
+namespace {
+
+// Slot count must be a power of two; 1024 keeps the seed search short
+constexpr uint32_t TABLE_SIZE = 1024;
+constexpr uint8_t EMPTY_SLOT = 0xFF;
+
+static_assert(KEYWORD_COUNT < EMPTY_SLOT, "keyword index must fit in a slot byte");
+
+constexpr uint32_t hashKeyword(std::string_view word, uint32_t seed) {
+    // FNV-1a, seeded
+    uint32_t hash = 2166136261u ^ seed;
+    for (char c : word) {
+        hash ^= static_cast<uint8_t>(c);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+constexpr size_t maxKeywordLength() {
+    size_t length = 0;
+    for (const auto& entry : KEYWORDS) {
+        if (entry.text.size() > length) {
+            length = entry.text.size();
+        }
+    }
+    return length;
+}
+
+struct PerfectHashTable {
+    uint32_t seed;
+    std::array<uint8_t, TABLE_SIZE> slots;
+};
+
+// Search for a seed under which every keyword lands in its own slot
+consteval PerfectHashTable buildTable() {
+    for (uint32_t seed = 0;; ++seed) {
+        PerfectHashTable table{seed, {}};
+        table.slots.fill(EMPTY_SLOT);
+
+        bool collision = false;
+        for (size_t i = 0; i < KEYWORD_COUNT && !collision; ++i) {
+            uint32_t slot = hashKeyword(KEYWORDS[i].text, seed) & (TABLE_SIZE - 1);
+            if (table.slots[slot] != EMPTY_SLOT) {
+                collision = true;
+            } else {
+                table.slots[slot] = static_cast<uint8_t>(i);
+            }
+        }
+
+        if (!collision) {
+            return table;
+        }
+    }
+}
+
+constexpr PerfectHashTable TABLE = buildTable();
+constexpr size_t MAX_KEYWORD_LENGTH = maxKeywordLength();
+
+} // namespace
+
+TokenType lookupKeyword(std::string_view word) {
+    if (word.size() > MAX_KEYWORD_LENGTH) {
+        return TokenType::IDENTIFIER;
+    }
+
+    uint8_t index = TABLE.slots[hashKeyword(word, TABLE.seed) & (TABLE_SIZE - 1)];
+    if (index != EMPTY_SLOT && KEYWORDS[index].text == word) {
+        return KEYWORDS[index].type;
+    }
+    return TokenType::IDENTIFIER;
+}
+
+} // namespace syclang
@@ -1,12 +1,19 @@
 #include "syclang/lexer/lexer.h"
+#include "syclang/lexer/keyword_table.h"
+#include "syclang/lexer/simd_scan.h"
+#include "syclang/trace.h"
 #include <cctype>
 #include <iostream>
+#include <stdexcept>
 
 namespace syclang {
 
-Lexer::Lexer(const std::string& source)
+Lexer::Lexer(std::string_view source)
     : source_(source), position_(0), line_(1), column_(1) {}
 
+Lexer::Lexer(const SourceBuffer& buffer)
+    : Lexer(buffer.text()) {}
+
 char Lexer::peek(size_t offset) {
     if (position_ + offset >= source_.size()) {
         return '\0';
@@ -14,6 +21,32 @@ char Lexer::peek(size_t offset) {
     return source_[position_ + offset];
 }
 
+bool Lexer::isIdentifierStart(size_t pos) const {
+    if (pos >= source_.size()) return false;
+    unsigned char c = static_cast<unsigned char>(source_[pos]);
+    if (c < 0x80) {
+        return isalpha(c) || c == '_';
+    }
+    
+    // UTF-8 letters (Chinese identifiers and keywords), but not the CJK
+    // punctuation block U+3000-U+303F (E3 80 xx) or full-width forms
+    // U+FF00-U+FF7F (EF BC xx, EF BD xx)
+    unsigned char next = pos + 1 < source_.size() ? static_cast<unsigned char>(source_[pos + 1]) : 0;
+    if (c == 0xE3 && next == 0x80) return false;
+    if (c == 0xEF && (next == 0xBC || next == 0xBD)) return false;
+    return c >= 0xC0;
+}
+
+bool Lexer::isIdentifierPart(size_t pos) const {
+    if (pos >= source_.size()) return false;
+    unsigned char c = static_cast<unsigned char>(source_[pos]);
+    if (c < 0x80) {
+        return isalnum(c) || c == '_';
+    }
+    // Continuation bytes belong to the character already accepted
+    return c < 0xC0 || isIdentifierStart(pos);
+}
+
 char Lexer::advance() {
     char c = peek();
     if (c != '\0') {
@@ -28,29 +61,46 @@ char Lexer::advance() {
     return c;
 }
 
-void Lexer::skipWhitespace() {
-    while (isspace(peek())) {
-        advance();
+void Lexer::advanceTo(size_t newPos) {
+    // Bulk advance: count newlines in one pass instead of per character
+    const char* begin = source_.data() + position_;
+    const char* end = source_.data() + newPos;
+    size_t newlines = activeScanKernels().countNewlines(begin, end);
+    if (newlines == 0) {
+        column_ += newPos - position_;
+    } else {
+        const char* lastNewline = end - 1;
+        while (*lastNewline != '\n') {
+            --lastNewline;
+        }
+        line_ += newlines;
+        column_ = static_cast<size_t>(end - lastNewline);
     }
+    position_ = newPos;
+}
+
+void Lexer::skipWhitespace() {
+    const char* end = source_.data() + source_.size();
+    const char* next = activeScanKernels().skipWhitespace(source_.data() + position_, end);
+    advanceTo(static_cast<size_t>(next - source_.data()));
 }
 
 void Lexer::skipComment() {
+    const ScanKernels& scan = activeScanKernels();
+    const char* base = source_.data();
+    const char* end = base + source_.size();
+    
     if (peek() == '/' && peek(1) == '/') {
-        // Single line comment
-        while (peek() != '\0' && peek() != '\n') {
-            advance();
-        }
+        // Single line comment (the newline itself is left for skipWhitespace)
+        const char* newline = scan.findByte(base + position_ + 2, end, '\n');
+        advanceTo(static_cast<size_t>(newline - base));
     } else if (peek() == '/' && peek(1) == '*') {
         // Multi-line comment
-        advance(); // /
-        advance(); // *
-        while (!(peek() == '*' && peek(1) == '/') && peek() != '\0') {
-            advance();
-        }
-        if (peek() == '*' && peek(1) == '/') {
-            advance(); // *
-            advance(); // /
+        const char* close = scan.findBlockCommentEnd(base + position_ + 2, end);
+        if (close != end) {
+            close += 2; // */
         }
+        advanceTo(static_cast<size_t>(close - base));
     }
 }
 
@@ -65,7 +115,7 @@ Token Lexer::scanNumber() {
         advance();
     }
     
-    std::string value = source_.substr(start, position_ - start);
+    std::string_view value = source_.substr(start, position_ - start);
     return Token(TokenType::NUMBER, value, line_, column_);
 }
 
@@ -80,7 +130,7 @@ Token Lexer::scanString() {
         advance();
     }
     
-    std::string value = source_.substr(start, position_ - start);
+    std::string_view value = source_.substr(start, position_ - start);
     if (peek() == '"') {
         advance(); // Skip closing quote
     }
@@ -89,127 +139,118 @@ Token Lexer::scanString() {
 }
 
 Token Lexer::scanIdentifier() {
+    const ScanKernels& scan = activeScanKernels();
+    const char* base = source_.data();
+    const char* end = base + source_.size();
     size_t start = position_;
+    size_t pos = position_;
     
-    while (isalnum(peek()) || peek() == '_') {
-        advance();
+    // ASCII runs go through the vector kernel; UTF-8 bytes are checked one by one
+    for (;;) {
+        pos = static_cast<size_t>(scan.skipIdentifierChars(base + pos, end) - base);
+        if (pos >= source_.size() || static_cast<unsigned char>(source_[pos]) < 0x80 ||
+            !isIdentifierPart(pos)) {
+            break;
+        }
+        ++pos;
     }
+    // Identifiers never contain newlines
+    column_ += pos - position_;
+    position_ = pos;
     
-    std::string value = source_.substr(start, position_ - start);
-    
-    // Check for keywords
-    if (value == "fn") return Token(TokenType::KW_FN, value, line_, column_);
-    if (value == "let") return Token(TokenType::KW_LET, value, line_, column_);
-    if (value == "mut") return Token(TokenType::KW_MUT, value, line_, column_);
-    if (value == "if") return Token(TokenType::KW_IF, value, line_, column_);
-    if (value == "else") return Token(TokenType::KW_ELSE, value, line_, column_);
-    if (value == "while") return Token(TokenType::KW_WHILE, value, line_, column_);
-    if (value == "for") return Token(TokenType::KW_FOR, value, line_, column_);
-    if (value == "return") return Token(TokenType::KW_RETURN, value, line_, column_);
-    if (value == "struct") return Token(TokenType::KW_STRUCT, value, line_, column_);
-    if (value == "enum") return Token(TokenType::KW_ENUM, value, line_, column_);
-    if (value == "union") return Token(TokenType::KW_UNION, value, line_, column_);
-    if (value == "extern") return Token(TokenType::KW_EXTERN, value, line_, column_);
-    if (value == "true") return Token(TokenType::KW_TRUE, value, line_, column_);
-    if (value == "false") return Token(TokenType::KW_FALSE, value, line_, column_);
-    if (value == "null") return Token(TokenType::KW_NULL, value, line_, column_);
-    if (value == "asm") return Token(TokenType::KW_ASM, value, line_, column_);
-    if (value == "volatile") return Token(TokenType::KW_VOLATILE, value, line_, column_);
-    if (value == "i8") return Token(TokenType::TYPE_I8, value, line_, column_);
-    if (value == "i16") return Token(TokenType::TYPE_I16, value, line_, column_);
-    if (value == "i32") return Token(TokenType::TYPE_I32, value, line_, column_);
-    if (value == "i64") return Token(TokenType::TYPE_I64, value, line_, column_);
-    if (value == "u8") return Token(TokenType::TYPE_U8, value, line_, column_);
-    if (value == "u16") return Token(TokenType::TYPE_U16, value, line_, column_);
-    if (value == "u32") return Token(TokenType::TYPE_U32, value, line_, column_);
-    if (value == "u64") return Token(TokenType::TYPE_U64, value, line_, column_);
-    if (value == "f32") return Token(TokenType::TYPE_F32, value, line_, column_);
-    if (value == "f64") return Token(TokenType::TYPE_F64, value, line_, column_);
-    if (value == "bool") return Token(TokenType::TYPE_BOOL, value, line_, column_);
-    if (value == "void") return Token(TokenType::TYPE_VOID, value, line_, column_);
+    std::string_view value = source_.substr(start, position_ - start);
     
-    return Token(TokenType::IDENTIFIER, value, line_, column_);
+    // Keywords (English and Chinese) come from the perfect-hash table
+    return Token(lookupKeyword(value), value, line_, column_);
+}
+
+Token Lexer::makeToken(TokenType type, size_t start) const {
+    return Token(type, source_.substr(start, position_ - start), line_, column_);
 }
 
 Token Lexer::scanSymbol() {
+    size_t start = position_;
     char c = advance();
     char next = peek();
     
     switch (c) {
-        case '(': return Token(TokenType::LPAREN, "(", line_, column_);
-        case ')': return Token(TokenType::RPAREN, ")", line_, column_);
-        case '{': return Token(TokenType::LBRACE, "{", line_, column_);
-        case '}': return Token(TokenType::RBRACE, "}", line_, column_);
-        case '[': return Token(TokenType::LBRACKET, "[", line_, column_);
-        case ']': return Token(TokenType::RBRACKET, "]", line_, column_);
-        case ';': return Token(TokenType::SEMICOLON, ";", line_, column_);
+        case '(': return makeToken(TokenType::LPAREN, start);
+        case ')': return makeToken(TokenType::RPAREN, start);
+        case '{': return makeToken(TokenType::LBRACE, start);
+        case '}': return makeToken(TokenType::RBRACE, start);
+        case '[': return makeToken(TokenType::LBRACKET, start);
+        case ']': return makeToken(TokenType::RBRACKET, start);
+        case ';': return makeToken(TokenType::SEMICOLON, start);
         case ':': 
-            if (next == ':') { advance(); return Token(TokenType::COLON, "::", line_, column_); }
-            return Token(TokenType::COLON, ":", line_, column_);
-        case ',': return Token(TokenType::COMMA, ",", line_, column_);
-        case '.': return Token(TokenType::DOT, ".", line_, column_);
+            if (next == ':') { advance(); return makeToken(TokenType::COLON, start); }
+            return makeToken(TokenType::COLON, start);
+        case ',': return makeToken(TokenType::COMMA, start);
+        case '.': return makeToken(TokenType::DOT, start);
         
         case '+':
-            if (next == '+') { advance(); return Token(TokenType::PLUS_PLUS, "++", line_, column_); }
-            if (next == '=') { advance(); return Token(TokenType::PLUS_EQUAL, "+=", line_, column_); }
-            return Token(TokenType::PLUS, "+", line_, column_);
+            if (next == '+') { advance(); return makeToken(TokenType::PLUS_PLUS, start); }
+            if (next == '=') { advance(); return makeToken(TokenType::PLUS_EQUAL, start); }
+            return makeToken(TokenType::PLUS, start);
             
         case '-':
-            if (next == '-') { advance(); return Token(TokenType::MINUS_MINUS, "--", line_, column_); }
-            if (next == '=') { advance(); return Token(TokenType::MINUS_EQUAL, "-=", line_, column_); }
-            if (next == '>') { advance(); return Token(TokenType::ARROW, "->", line_, column_); }
-            return Token(TokenType::MINUS, "-", line_, column_);
+            if (next == '-') { advance(); return makeToken(TokenType::MINUS_MINUS, start); }
+            if (next == '=') { advance(); return makeToken(TokenType::MINUS_EQUAL, start); }
+            if (next == '>') { advance(); return makeToken(TokenType::ARROW, start); }
+            return makeToken(TokenType::MINUS, start);
             
         case '*':
-            if (next == '=') { advance(); return Token(TokenType::STAR_EQUAL, "*=", line_, column_); }
-            return Token(TokenType::STAR, "*", line_, column_);
+            if (next == '=') { advance(); return makeToken(TokenType::STAR_EQUAL, start); }
+            return makeToken(TokenType::STAR, start);
             
         case '/':
-            if (next == '=') { advance(); return Token(TokenType::SLASH_EQUAL, "/=", line_, column_); }
-            return Token(TokenType::SLASH, "/", line_, column_);
+            if (next == '=') { advance(); return makeToken(TokenType::SLASH_EQUAL, start); }
+            return makeToken(TokenType::SLASH, start);
             
         case '%':
-            if (next == '=') { advance(); return Token(TokenType::PERCENT_EQUAL, "%=", line_, column_); }
-            return Token(TokenType::PERCENT, "%", line_, column_);
+            if (next == '=') { advance(); return makeToken(TokenType::PERCENT_EQUAL, start); }
+            return makeToken(TokenType::PERCENT, start);
             
         case '=':
-            if (next == '=') { advance(); return Token(TokenType::EQUAL_EQUAL, "==", line_, column_); }
-            if (next == '>') { advance(); return Token(TokenType::FAT_ARROW, "=>", line_, column_); }
-            return Token(TokenType::EQUAL, "=", line_, column_);
+            if (next == '=') { advance(); return makeToken(TokenType::EQUAL_EQUAL, start); }
+            if (next == '>') { advance(); return makeToken(TokenType::FAT_ARROW, start); }
+            return makeToken(TokenType::EQUAL, start);
             
         case '!':
-            if (next == '=') { advance(); return Token(TokenType::NOT_EQUAL, "!=", line_, column_); }
-            return Token(TokenType::NOT, "!", line_, column_);
+            if (next == '=') { advance(); return makeToken(TokenType::NOT_EQUAL, start); }
+            return makeToken(TokenType::NOT, start);
             
         case '<':
-            if (next == '=') { advance(); return Token(TokenType::LESS_EQUAL, "<=", line_, column_); }
-            if (next == '<') { advance(); return Token(TokenType::SHL, "<<", line_, column_); }
-            return Token(TokenType::LESS, "<", line_, column_);
+            if (next == '=') { advance(); return makeToken(TokenType::LESS_EQUAL, start); }
+            if (next == '<') { advance(); return makeToken(TokenType::SHL, start); }
+            return makeToken(TokenType::LESS, start);
             
         case '>':
-            if (next == '=') { advance(); return Token(TokenType::GREATER_EQUAL, ">=", line_, column_); }
-            if (next == '>') { advance(); return Token(TokenType::SHR, ">>", line_, column_); }
-            return Token(TokenType::GREATER, ">", line_, column_);
+            if (next == '=') { advance(); return makeToken(TokenType::GREATER_EQUAL, start); }
+            if (next == '>') { advance(); return makeToken(TokenType::SHR, start); }
+            return makeToken(TokenType::GREATER, start);
             
         case '&':
-            if (next == '&') { advance(); return Token(TokenType::AND_AND, "&&", line_, column_); }
-            return Token(TokenType::BIT_AND, "&", line_, column_);
+            if (next == '&') { advance(); return makeToken(TokenType::AND_AND, start); }
+            return makeToken(TokenType::BIT_AND, start);
             
         case '|':
-            if (next == '|') { advance(); return Token(TokenType::OR_OR, "||", line_, column_); }
-            return Token(TokenType::BIT_OR, "|", line_, column_);
+            if (next == '|') { advance(); return makeToken(TokenType::OR_OR, start); }
+            return makeToken(TokenType::BIT_OR, start);
             
         case '^':
-            return Token(TokenType::BIT_XOR, "^", line_, column_);
+            return makeToken(TokenType::BIT_XOR, start);
             
         case '~':
-            return Token(TokenType::BIT_NOT, "~", line_, column_);
+            return makeToken(TokenType::BIT_NOT, start);
             
         case '?':
-            return Token(TokenType::QUESTION, "?", line_, column_);
+            return makeToken(TokenType::QUESTION, start);
+            
+        case '#':
+            return makeToken(TokenType::AT_SIGN, start);
             
         default:
-            return Token(TokenType::UNKNOWN, std::string(1, c), line_, column_);
+            return makeToken(TokenType::UNKNOWN, start);
     }
 }
 
@@ -223,7 +264,7 @@ Token Lexer::nextToken() {
     }
     
     if (position_ >= source_.size()) {
-        return Token(TokenType::EOF_TOKEN, "", line_, column_);
+        return makeToken(TokenType::EOF_TOKEN, position_);
     }
     
     char c = peek();
@@ -236,7 +277,7 @@ Token Lexer::nextToken() {
         return scanString();
     }
     
-    if (isalpha(c) || c == '_') {
+    if (isIdentifierStart(position_)) {
         return scanIdentifier();
     }
     
@@ -260,16 +301,28 @@ Token Lexer::peekToken(size_t offset) {
     return token;
 }
 
-std::vector<Token> Lexer::tokenize() {
-    std::vector<Token> tokens;
-    Token token = nextToken();
+TokenStream Lexer::tokenize() {
+    TraceScope trace("lex", "frontend");
+    // SourceBuffer::open reports this as an error; a view from elsewhere
+    // would silently wrap every position past 4 GiB
+    if (source_.size() > SourceBuffer::MAX_SIZE) {
+        throw std::length_error("source is too large: sources must be under 4 GiB");
+    }
+    TokenStream tokens(source_);
+    // Typical source averages a token every 3-4 bytes
+    tokens.reserve(source_.size() / 3 + 1);
     
-    while (!token.is(TokenType::EOF_TOKEN)) {
-        tokens.push_back(token);
-        token = nextToken();
+    for (;;) {
+        // Every token value is a slice of source_, so it reduces to offset/length
+        Token token = nextToken();
+        uint32_t offset = static_cast<uint32_t>(token.value().data() - source_.data());
+        tokens.push(token.type(), offset, static_cast<uint32_t>(token.value().size()),
+                    static_cast<uint32_t>(token.line()), static_cast<uint32_t>(token.column()));
+        if (token.is(TokenType::EOF_TOKEN)) {
+            break;
+        }
     }
     
-    tokens.push_back(token); // Add EOF token
     return tokens;
 }
 
@@ -0,0 +1,326 @@
+#include "syclang/lexer/simd_scan.h"
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define SYCLANG_SCAN_X86 1
+#include <emmintrin.h>
+#if defined(__GNUC__) || defined(__clang__)
+#define SYCLANG_SCAN_AVX2 1
+#include <immintrin.h>
+#endif
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+namespace syclang {
+
+namespace {
+
+inline unsigned countTrailingZeros(uint32_t mask) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return index;
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+// ---------------------------------------------------------------------------
+// Scalar kernels (also used for the tails of the vector loops)
+// ---------------------------------------------------------------------------
+
+inline bool isWhitespaceByte(unsigned char c) {
+    return c == ' ' || static_cast<unsigned char>(c - '\t') <= '\r' - '\t';
+}
+
+inline bool isIdentifierByte(unsigned char c) {
+    return static_cast<unsigned char>((c | 0x20) - 'a') <= 'z' - 'a' ||
+           static_cast<unsigned char>(c - '0') <= 9 || c == '_';
+}
+
+const char* skipWhitespaceScalar(const char* p, const char* end) {
+    while (p < end && isWhitespaceByte(static_cast<unsigned char>(*p))) ++p;
+    return p;
+}
+
+const char* skipIdentifierCharsScalar(const char* p, const char* end) {
+    while (p < end && isIdentifierByte(static_cast<unsigned char>(*p))) ++p;
+    return p;
+}
+
+const char* findByteScalar(const char* p, const char* end, char c) {
+    while (p < end && *p != c) ++p;
+    return p;
+}
+
+const char* findBlockCommentEndScalar(const char* p, const char* end) {
+    while (p + 1 < end && !(p[0] == '*' && p[1] == '/')) ++p;
+    return p + 1 < end ? p : end;
+}
+
+size_t countNewlinesScalar(const char* p, const char* end) {
+    size_t count = 0;
+    for (; p < end; ++p) {
+        count += *p == '\n';
+    }
+    return count;
+}
+
+const ScanKernels SCALAR_KERNELS = {
+    ScanIsa::SCALAR, "scalar",
+    skipWhitespaceScalar, skipIdentifierCharsScalar, findByteScalar,
+    findBlockCommentEndScalar, countNewlinesScalar
+};
+
+#ifdef SYCLANG_SCAN_X86
+
+// ---------------------------------------------------------------------------
+// SSE2 kernels: 16 bytes per step. Unsigned range checks use the
+// min_epu8(x, limit) == x idiom since SSE2 has no unsigned compare.
+// ---------------------------------------------------------------------------
+
+inline __m128i inRangeSse2(__m128i v, char low, char span) {
+    __m128i rel = _mm_sub_epi8(v, _mm_set1_epi8(low));
+    return _mm_cmpeq_epi8(_mm_min_epu8(rel, _mm_set1_epi8(span)), rel);
+}
+
+inline uint32_t whitespaceMaskSse2(__m128i v) {
+    __m128i space = _mm_cmpeq_epi8(v, _mm_set1_epi8(' '));
+    return _mm_movemask_epi8(_mm_or_si128(space, inRangeSse2(v, '\t', '\r' - '\t')));
+}
+
+inline uint32_t identifierMaskSse2(__m128i v) {
+    __m128i alpha = inRangeSse2(_mm_or_si128(v, _mm_set1_epi8(0x20)), 'a', 'z' - 'a');
+    __m128i digit = inRangeSse2(v, '0', 9);
+    __m128i underscore = _mm_cmpeq_epi8(v, _mm_set1_epi8('_'));
+    return _mm_movemask_epi8(_mm_or_si128(_mm_or_si128(alpha, digit), underscore));
+}
+
+const char* skipWhitespaceSse2(const char* p, const char* end) {
+    while (end - p >= 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        uint32_t mask = ~whitespaceMaskSse2(v) & 0xFFFF;
+        if (mask) return p + countTrailingZeros(mask);
+        p += 16;
+    }
+    return skipWhitespaceScalar(p, end);
+}
+
+const char* skipIdentifierCharsSse2(const char* p, const char* end) {
+    while (end - p >= 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        uint32_t mask = ~identifierMaskSse2(v) & 0xFFFF;
+        if (mask) return p + countTrailingZeros(mask);
+        p += 16;
+    }
+    return skipIdentifierCharsScalar(p, end);
+}
+
+const char* findByteSse2(const char* p, const char* end, char c) {
+    __m128i needle = _mm_set1_epi8(c);
+    while (end - p >= 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        uint32_t mask = _mm_movemask_epi8(_mm_cmpeq_epi8(v, needle));
+        if (mask) return p + countTrailingZeros(mask);
+        p += 16;
+    }
+    return findByteScalar(p, end, c);
+}
+
+const char* findBlockCommentEndSse2(const char* p, const char* end) {
+    __m128i star = _mm_set1_epi8('*');
+    __m128i slash = _mm_set1_epi8('/');
+    // Compare each byte and its successor, so keep one byte of slack
+    while (end - p >= 17) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        __m128i next = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 1));
+        uint32_t mask = _mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(v, star), _mm_cmpeq_epi8(next, slash)));
+        if (mask) return p + countTrailingZeros(mask);
+        p += 16;
+    }
+    return findBlockCommentEndScalar(p, end);
+}
+
+size_t countNewlinesSse2(const char* p, const char* end) {
+    // Per-byte counters (cmpeq yields -1, so subtract) folded into 64-bit
+    // sums with sad_epu8 before any counter can reach 256
+    __m128i newline = _mm_set1_epi8('\n');
+    __m128i zero = _mm_setzero_si128();
+    __m128i totals = zero;
+    while (end - p >= 16) {
+        __m128i counters = zero;
+        for (int i = 0; i < 255 && end - p >= 16; ++i, p += 16) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            counters = _mm_sub_epi8(counters, _mm_cmpeq_epi8(v, newline));
+        }
+        totals = _mm_add_epi64(totals, _mm_sad_epu8(counters, zero));
+    }
+    size_t count = static_cast<size_t>(_mm_cvtsi128_si64(totals)) +
+                   static_cast<size_t>(_mm_cvtsi128_si64(_mm_unpackhi_epi64(totals, totals)));
+    return count + countNewlinesScalar(p, end);
+}
+
+const ScanKernels SSE2_KERNELS = {
+    ScanIsa::SSE2, "sse2",
+    skipWhitespaceSse2, skipIdentifierCharsSse2, findByteSse2,
+    findBlockCommentEndSse2, countNewlinesSse2
+};
+
+#endif // SYCLANG_SCAN_X86
+
+#ifdef SYCLANG_SCAN_AVX2
+
+// ---------------------------------------------------------------------------
+// AVX2 kernels: 32 bytes per step, compiled for AVX2 regardless of the
+// baseline flags and only selected when the CPU reports support.
+// ---------------------------------------------------------------------------
+
+#define SYCLANG_AVX2_TARGET __attribute__((target("avx2")))
+
+SYCLANG_AVX2_TARGET inline __m256i inRangeAvx2(__m256i v, char low, char span) {
+    __m256i rel = _mm256_sub_epi8(v, _mm256_set1_epi8(low));
+    return _mm256_cmpeq_epi8(_mm256_min_epu8(rel, _mm256_set1_epi8(span)), rel);
+}
+
+SYCLANG_AVX2_TARGET const char* skipWhitespaceAvx2(const char* p, const char* end) {
+    while (end - p >= 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        __m256i space = _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' '));
+        __m256i control = inRangeAvx2(v, '\t', '\r' - '\t');
+        uint32_t mask = ~static_cast<uint32_t>(
+            _mm256_movemask_epi8(_mm256_or_si256(space, control)));
+        if (mask) return p + countTrailingZeros(mask);
+        p += 32;
+    }
+    return skipWhitespaceSse2(p, end);
+}
+
+SYCLANG_AVX2_TARGET const char* skipIdentifierCharsAvx2(const char* p, const char* end) {
+    while (end - p >= 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        __m256i alpha = inRangeAvx2(_mm256_or_si256(v, _mm256_set1_epi8(0x20)), 'a', 'z' - 'a');
+        __m256i digit = inRangeAvx2(v, '0', 9);
+        __m256i underscore = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_'));
+        uint32_t mask = ~static_cast<uint32_t>(_mm256_movemask_epi8(
+            _mm256_or_si256(_mm256_or_si256(alpha, digit), underscore)));
+        if (mask) return p + countTrailingZeros(mask);
+        p += 32;
+    }
+    return skipIdentifierCharsSse2(p, end);
+}
+
+SYCLANG_AVX2_TARGET const char* findByteAvx2(const char* p, const char* end, char c) {
+    __m256i needle = _mm256_set1_epi8(c);
+    while (end - p >= 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        uint32_t mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, needle));
+        if (mask) return p + countTrailingZeros(mask);
+        p += 32;
+    }
+    return findByteSse2(p, end, c);
+}
+
+SYCLANG_AVX2_TARGET const char* findBlockCommentEndAvx2(const char* p, const char* end) {
+    __m256i star = _mm256_set1_epi8('*');
+    __m256i slash = _mm256_set1_epi8('/');
+    while (end - p >= 33) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        __m256i next = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 1));
+        uint32_t mask = _mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(v, star), _mm256_cmpeq_epi8(next, slash)));
+        if (mask) return p + countTrailingZeros(mask);
+        p += 32;
+    }
+    return findBlockCommentEndSse2(p, end);
+}
+
+SYCLANG_AVX2_TARGET size_t countNewlinesAvx2(const char* p, const char* end) {
+    __m256i newline = _mm256_set1_epi8('\n');
+    __m256i zero = _mm256_setzero_si256();
+    __m256i totals = zero;
+    while (end - p >= 32) {
+        __m256i counters = zero;
+        for (int i = 0; i < 255 && end - p >= 32; ++i, p += 32) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+            counters = _mm256_sub_epi8(counters, _mm256_cmpeq_epi8(v, newline));
+        }
+        totals = _mm256_add_epi64(totals, _mm256_sad_epu8(counters, zero));
+    }
+    size_t count = static_cast<size_t>(_mm256_extract_epi64(totals, 0)) +
+                   static_cast<size_t>(_mm256_extract_epi64(totals, 1)) +
+                   static_cast<size_t>(_mm256_extract_epi64(totals, 2)) +
+                   static_cast<size_t>(_mm256_extract_epi64(totals, 3));
+    return count + countNewlinesSse2(p, end);
+}
+
+const ScanKernels AVX2_KERNELS = {
+    ScanIsa::AVX2, "avx2",
+    skipWhitespaceAvx2, skipIdentifierCharsAvx2, findByteAvx2,
+    findBlockCommentEndAvx2, countNewlinesAvx2
+};
+
+bool cpuSupportsAvx2() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+
+#endif // SYCLANG_SCAN_AVX2
+
+const ScanKernels* detectBestKernels() {
+#ifdef SYCLANG_SCAN_AVX2
+    if (cpuSupportsAvx2()) {
+        return &AVX2_KERNELS;
+    }
+#endif
+#ifdef SYCLANG_SCAN_X86
+    return &SSE2_KERNELS;
+#else
+    return &SCALAR_KERNELS;
+#endif
+}
+
+const ScanKernels*& activeKernelsSlot() {
+    static const ScanKernels* active = detectBestKernels();
+    return active;
+}
+
+} // namespace
+
+const ScanKernels* getScanKernels(ScanIsa isa) {
+    switch (isa) {
+        case ScanIsa::SCALAR:
+            return &SCALAR_KERNELS;
+        case ScanIsa::SSE2:
+#ifdef SYCLANG_SCAN_X86
+            return &SSE2_KERNELS;
+#else
+            return nullptr;
+#endif
+        case ScanIsa::AVX2:
+#ifdef SYCLANG_SCAN_AVX2
+            return cpuSupportsAvx2() ? &AVX2_KERNELS : nullptr;
+#else
+            return nullptr;
+#endif
+    }
+    return nullptr;
+}
+
+const ScanKernels& activeScanKernels() {
+    return *activeKernelsSlot();
+}
+
+bool setActiveScanIsa(ScanIsa isa) {
+    const ScanKernels* kernels = getScanKernels(isa);
+    if (!kernels) {
+        return false;
+    }
+    activeKernelsSlot() = kernels;
+    return true;
+}
+
+} // namespace syclang
@@ -0,0 +1,115 @@
+#include "syclang/lexer/source_buffer.h"
+#include <cerrno>
+#include <cstring>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define SYCLANG_HAVE_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <fstream>
+#include <sstream>
+#endif
+
+namespace syclang {
+
+namespace {
+
+std::string tooLarge(const std::string& path) {
+    return "File '" + path + "' is too large: sources must be under 4 GiB";
+}
+
+} // namespace
+
+SourceBuffer::~SourceBuffer() {
+#ifdef SYCLANG_HAVE_MMAP
+    if (mapped_) {
+        munmap(const_cast<char*>(data_), size_);
+    }
+#endif
+}
+
+std::unique_ptr<SourceBuffer> SourceBuffer::open(const std::string& path, std::string& error) {
+    std::unique_ptr<SourceBuffer> buffer(new SourceBuffer());
+    buffer->name_ = path;
+
+#ifdef SYCLANG_HAVE_MMAP
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        error = "Cannot open file '" + path + "': " + std::strerror(errno);
+        return nullptr;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+        if (static_cast<uint64_t>(info.st_size) > MAX_SIZE) {
+            error = tooLarge(path);
+            ::close(fd);
+            return nullptr;
+        }
+        size_t size = static_cast<size_t>(info.st_size);
+        void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping != MAP_FAILED) {
+            ::close(fd);
+            // The lexer reads front to back exactly once
+            madvise(mapping, size, MADV_SEQUENTIAL);
+            buffer->data_ = static_cast<const char*>(mapping);
+            buffer->size_ = size;
+            buffer->mapped_ = true;
+            return buffer;
+        }
+    }
+
+    // Not mappable (pipe, empty file, ...): read it into memory
+    std::string contents;
+    char chunk[65536];
+    for (;;) {
+        ssize_t count = ::read(fd, chunk, sizeof(chunk));
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            error = "Cannot read file '" + path + "': " + std::strerror(errno);
+            ::close(fd);
+            return nullptr;
+        }
+        if (count == 0) break;
+        contents.append(chunk, static_cast<size_t>(count));
+        if (contents.size() > MAX_SIZE) {
+            error = tooLarge(path);
+            ::close(fd);
+            return nullptr;
+        }
+    }
+    ::close(fd);
+#else
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        error = "Cannot open file '" + path + "'";
+        return nullptr;
+    }
+    std::stringstream stream;
+    stream << file.rdbuf();
+    std::string contents = stream.str();
+    if (contents.size() > MAX_SIZE) {
+        error = tooLarge(path);
+        return nullptr;
+    }
+#endif
+
+    buffer->owned_ = std::move(contents);
+    buffer->data_ = buffer->owned_.data();
+    buffer->size_ = buffer->owned_.size();
+    return buffer;
+}
+
+std::unique_ptr<SourceBuffer> SourceBuffer::fromString(std::string name, std::string contents) {
+    std::unique_ptr<SourceBuffer> buffer(new SourceBuffer());
+    buffer->name_ = std::move(name);
+    buffer->owned_ = std::move(contents);
+    buffer->data_ = buffer->owned_.data();
+    buffer->size_ = buffer->owned_.size();
+    return buffer;
+}
+
+} // namespace syclang
@@ -1,15 +1,11 @@
 #include "syclang/lexer/token.h"
+#include "syclang/lexer/keyword_table.h"
 
 namespace syclang {
 
 bool Token::isChineseKeyword() const {
-    // 检查值中是否包含中文字符
-    for (char c : value_) {
-        if (c >= 0x4E00 && c <= 0x9FFF) { // 中文字符范围
-            return true;
-        }
-    }
-    return false;
+    // 中文拼写且在关键字表中
+    return isChineseSpelling(value_) && lookupKeyword(value_) != TokenType::IDENTIFIER;
 }
 
 std::string Token::toString() const {
@@ -110,7 +106,7 @@ std::string Token::toString() const {
         default: typeName = "UNKNOWN"; break;
     }
     
-    std::string result = typeName + "(" + value_ + ")";
+    std::string result = typeName + "(" + std::string(value_) + ")";
     if (!chineseDescription_.empty()) {
         result += " [" + chineseDescription_ + "]";
     }
@@ -1,48 +1,585 @@
+#include <atomic>
+#include <cctype>
+#include <charconv>
+#include <cstdio>
+#include <fcntl.h>
+#include <filesystem>
 #include <iostream>
 #include <fstream>
-#include <string>
+#include <mutex>
+#include <optional>
+#include <set>
 #include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <unistd.h>
 #include "syclang/lexer/lexer.h"
+#include "syclang/lexer/source_buffer.h"
 #include "syclang/parser/parser.h"
 #include "syclang/ir/ir_generator.h"
+#include "syclang/ir/binary_ir.h"
+#include "syclang/optimizer/optimizer.h"
 #include "syclang/codegen/x64/x64_codegen.h"
 #include "syclang/codegen/arm64/arm64_codegen.h"
+#include "syclang/codegen/elf_writer.h"
+#include "syclang/codegen/pe_writer.h"
+#include "syclang/compile_cache.h"
 #include "syclang/ir/ir.h"
+#include "syclang/thread_pool.h"
+#include "syclang/trace.h"
 
 using namespace syclang;
 
 void printUsage(const char* programName) {
-    std::cout << "Usage: " << programName << " [OPTIONS] <input_file>\n"
+    std::cout << "Usage: " << programName << " [OPTIONS] <input_file>... [@response_file]\n"
               << "\nOptions:\n"
               << "  --arch <architecture>  Target architecture (x64 or arm64, default: x64)\n"
-              << "  --output <file>       Output file (default: output.s)\n"
-              << "  --format <format>     Output format (elf, pe, efi, raw, default: elf)\n"
+              << "  --output <file>       Output file (default: output.s, a.out for --format elf,\n"
+              << "                        output.o with -c, output.exe/.efi for pe/efi; single\n"
+              << "                        input only)\n"
+              << "  --output-dir <dir>    Directory for per-input outputs (multiple inputs)\n"
+              << "  --format <format>     Output format (elf, pe, efi, raw, default: assembly text);\n"
+              << "                        elf is a static Linux executable, pe a Windows console\n"
+              << "                        program, efi an EFI application entered at efi_main and\n"
+              << "                        raw a flat binary, all assembled and linked in process\n"
+              << "  -c                    With --format elf, write a relocatable object instead\n"
+              << "  --link <file>         With --format elf, pe or efi, link an ELF object or\n"
+              << "                        archive into the image (e.g. the runtime, libsyclang_rt.a)\n"
               << "  --ir                  Output IR instead of assembly\n"
+              << "  --ir-binary           Output binary IR (.bir), which later runs take as input in\n"
+              << "                        place of source to optimize or generate code without parsing\n"
+              << "  -O<level>             Optimization level (0-2, default: 1); 2 also runs the\n"
+              << "                        machine-level peephole pass on generated code\n"
+              << "  -j, --jobs <n>        Parallel jobs for files and functions, 1 to 1024\n"
+              << "                        (default: all cores)\n"
+              << "  --regalloc-stats      Print per-function register allocation statistics\n"
+              << "  --passes <list>       Comma-separated optimizer passes run instead of the -O\n"
+              << "                        pipeline (inline, sccp, gvn, loops, dce)\n"
+              << "  --time-passes         Print wall time, instruction counts and IR memory per pass\n"
+              << "  --loop-report         Print what -O2 did to each loop, with cycle estimates\n"
+              << "  --cache-dir <dir>     Reuse outputs of earlier compilations of the same source\n"
+              << "                        with the same options, stored in <dir>\n"
+              << "  --trace-out <file>    Write a Chrome trace (JSON) of the compilation phases, for\n"
+              << "                        chrome://tracing or ui.perfetto.dev\n"
+              << "  --vector-isa <isa>    SIMD for -O2 loop vectorization (none, sse2, avx2, neon,\n"
+              << "                        default: sse2 on x64, neon on arm64)\n"
               << "  --help                Show this help message\n"
+              << "\nArguments of the form @file are read from a response file\n"
+              << "(whitespace-separated, double quotes group words).\n"
               << "\nExample:\n"
               << "  " << programName << " --arch x64 --output program.s hello.syl\n"
-              << "  " << programName << " --arch arm64 --format efi --output boot.efi efi_hello.syl\n";
+              << "  " << programName << " --format elf --link libsyclang_rt.a --output hello hello.syl\n"
+              << "  " << programName << " --arch arm64 --format efi --output boot.efi efi_hello.syl\n"
+              << "  " << programName << " -j 16 --output-dir build/ @modules.rsp\n";
 }
 
-std::string readFile(const std::string& filename) {
-    std::ifstream file(filename);
-    if (!file) {
-        std::cerr << "Error: Cannot open file '" << filename << "'\n";
-        exit(1);
+struct CompileOptions {
+    Architecture arch = Architecture::X64;
+    std::optional<OutputFormat> format; // Unset: assembly text
+    bool relocatable = false;           // -c
+    ObjectCode linkInputs;              // --link objects, for executable images
+    bool outputIR = false;
+    bool outputBinaryIR = false; // --ir-binary
+    bool allocationStats = false;
+    int optimizationLevel = 1;
+    bool loopReport = false;
+    VectorIsa vectorIsa = VectorIsa::NONE;
+    std::optional<std::string> pipeline; // --passes, replacing the -O pipeline
+    bool timePasses = false;
+    CompileCache* cache = nullptr; // --cache-dir
+    std::string linkHash;          // Content hash of the --link files
+};
+
+// One input file. log holds the progress messages, errors the diagnostics;
+// both are printed by the driver in input order.
+struct CompileJob {
+    std::string inputFile;
+    std::string outputFile;
+    std::string log;
+    std::string errors;
+    bool succeeded = false;
+};
+
+// More threads than this would only contend for the same cores
+constexpr unsigned MAX_JOBS = 1024;
+
+// The value of -j/--jobs: a whole number from 1 to MAX_JOBS
+std::optional<unsigned> parseJobs(const std::string& text) {
+    unsigned jobs = 0;
+    const char* end = text.data() + text.size();
+    auto [parsed, error] = std::from_chars(text.data(), end, jobs);
+    if (text.empty() || error != std::errc() || parsed != end || jobs == 0 || jobs > MAX_JOBS) {
+        return std::nullopt;
     }
-    
-    std::stringstream buffer;
-    buffer << file.rdbuf();
-    return buffer.str();
+    return jobs;
 }
 
-void writeFile(const std::string& filename, const std::string& content) {
-    std::ofstream file(filename);
+bool writeFile(const std::string& filename, const std::string& content) {
+    std::ofstream file(filename, std::ios::binary);
     if (!file) {
-        std::cerr << "Error: Cannot create file '" << filename << "'\n";
-        exit(1);
+        return false;
     }
     file << content;
+    return static_cast<bool>(file);
+}
+
+bool writeFile(const std::string& filename, const OutputBuffer& content) {
+    int fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd < 0) {
+        return false;
+    }
+    bool written = content.writeTo(fd);
+    return ::close(fd) == 0 && written;
+}
+
+// An output file written while it is generated. It goes to a temporary
+// file next to `path` that replaces it only once finish() succeeds, so a
+// failed compilation leaves the previous output as it was.
+class StreamedFile {
+public:
+    ~StreamedFile() {
+        if (fd_ >= 0) {
+            ::close(fd_);
+            std::remove(temporary_.c_str());
+        }
+    }
+
+    bool open(const std::string& path) {
+        static std::atomic<unsigned> counter{0};
+        path_ = path;
+        temporary_ = path + ".tmp." + std::to_string(::getpid()) + "." + std::to_string(counter++);
+        fd_ = ::open(temporary_.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0666);
+        return fd_ >= 0;
+    }
+    int fd() const { return fd_; }
+
+    // Write what `output` still holds, close the file and move it into place
+    bool finish(OutputBuffer& output) {
+        bool written = output.flush();
+        written = ::close(fd_) == 0 && written;
+        fd_ = -1;
+        written = written && std::rename(temporary_.c_str(), path_.c_str()) == 0;
+        if (!written) {
+            std::remove(temporary_.c_str());
+        }
+        return written;
+    }
+
+private:
+    std::string path_;
+    std::string temporary_;
+    int fd_ = -1;
+};
+
+// Append the arguments in a response file, expanding nested @files
+bool readResponseFile(const std::string& filename, std::vector<std::string>& args,
+                      int depth, std::string& error) {
+    if (depth > 8) {
+        error = "Response files nested too deeply at '" + filename + "'";
+        return false;
+    }
+    std::ifstream file(filename);
+    if (!file) {
+        error = "Cannot open response file '" + filename + "'";
+        return false;
+    }
+
+    std::string contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    std::string word;
+    bool inWord = false;
+    bool quoted = false;
+    for (size_t i = 0; i <= contents.size(); ++i) {
+        char c = i < contents.size() ? contents[i] : '\n';
+        if (c == '"') {
+            quoted = !quoted;
+            inWord = true;
+        } else if (!quoted && isspace(static_cast<unsigned char>(c))) {
+            if (inWord) {
+                if (word.size() > 1 && word[0] == '@') {
+                    if (!readResponseFile(word.substr(1), args, depth + 1, error)) {
+                        return false;
+                    }
+                } else {
+                    args.push_back(word);
+                }
+                word.clear();
+                inWord = false;
+            }
+        } else {
+            word += c;
+            inWord = true;
+        }
+    }
+    return true;
+}
+
+// Machine code rather than text: every format once one is asked for
+bool writesBinary(const CompileOptions& options) {
+    return !options.outputIR && options.format.has_value();
+}
+
+// A linked program: an ELF executable or a PE image
+bool writesExecutable(const CompileOptions& options) {
+    return writesBinary(options) && options.format != OutputFormat::RAW && !options.relocatable;
+}
+
+// Extension of an output file: .bir, .ir, .s, .o, .bin, .exe or .efi, none for
+// ELF executables
+std::string outputExtension(const CompileOptions& options) {
+    if (options.outputBinaryIR) return ".bir";
+    if (options.outputIR) return ".ir";
+    if (!writesBinary(options)) return ".s";
+    switch (*options.format) {
+    case OutputFormat::RAW: return ".bin";
+    case OutputFormat::PE: return ".exe";
+    case OutputFormat::EFI: return ".efi";
+    default: return options.relocatable ? ".o" : "";
+    }
+}
+
+// <dir>/<stem><extension> for an input when compiling several files
+std::string outputPathFor(const std::string& inputFile, const std::string& outputDir, const std::string& extension) {
+    size_t slash = inputFile.find_last_of("/\\");
+    std::string base = slash == std::string::npos ? inputFile : inputFile.substr(slash + 1);
+    std::string stem = base.substr(0, base.find_last_of('.'));
+
+    if (outputDir.empty()) {
+        // Next to the input
+        std::string dir = slash == std::string::npos ? "" : inputFile.substr(0, slash + 1);
+        return dir + stem + extension;
+    }
+    if (outputDir.back() == '/' || outputDir.back() == '\\') {
+        return outputDir + stem + extension;
+    }
+    return outputDir + "/" + stem + extension;
+}
+
+// Every option that changes the output file, for cache keys. Reports
+// (--time-passes and the like) only change the log.
+std::string cacheOptions(const CompileOptions& options) {
+    std::ostringstream key;
+    key << "arch=" << static_cast<int>(options.arch)
+        << " format=" << (options.format ? static_cast<int>(*options.format) : -1)
+        << " c=" << options.relocatable << " ir=" << options.outputIR << options.outputBinaryIR << " O=" << options.optimizationLevel
+        << " vector=" << static_cast<int>(options.vectorIsa) << " passes=" << options.pipeline.value_or("-")
+        << " link=" << options.linkHash;
+    return key.str();
+}
+
+// The options that shape the optimized IR, for the keys of cached IR:
+// a module optimized once serves every format and link it is built for
+std::string irCacheOptions(const CompileOptions& options) {
+    std::ostringstream key;
+    key << "bir arch=" << static_cast<int>(options.arch) << " O=" << options.optimizationLevel
+        << " vector=" << static_cast<int>(options.vectorIsa) << " passes=" << options.pipeline.value_or("-");
+    return key.str();
+}
+
+// The optimized IR an earlier compilation stored under `key`, or null
+std::shared_ptr<IRModule> loadCachedIR(const std::string& key, const CompileOptions& options,
+                                       std::ostringstream& log) {
+    std::optional<std::string> bytes = options.cache->lookup(key);
+    if (!bytes) {
+        return nullptr;
+    }
+    std::string error;
+    auto reader = BinaryIRReader::open(SourceBuffer::fromString(key, std::move(*bytes)), error);
+    if (!reader || reader->targetArch() != options.arch) {
+        return nullptr;
+    }
+    try {
+        auto module = reader->load();
+        log << "IR cache hit: " << key << "\n";
+        return module;
+    } catch (const std::runtime_error&) {
+        return nullptr;
+    }
+}
+
+// Lex, parse and generate IR, or report the parse errors and return null
+std::shared_ptr<IRModule> parseSource(const SourceBuffer& source, const std::string& inputFile,
+                                      const CompileOptions& options, std::ostringstream& log,
+                                      std::ostringstream& errors) {
+    // Lexical analysis
+    log << "Lexical analysis...\n";
+    syclang::Lexer lexer(source);
+    auto tokens = lexer.tokenize();
+    log << "  Found " << tokens.size() << " tokens\n";
+
+    // Syntax parsing
+    log << "Parsing...\n";
+    syclang::Parser parser(tokens);
+    auto program = parser.parse();
+
+    if (!parser.getErrors().empty()) {
+        errors << "\nParsing errors in " << inputFile << ":\n";
+        for (const auto& error : parser.getErrors()) {
+            errors << "  " << error << "\n";
+        }
+        return nullptr;
+    }
+    log << "  Parsed " << program->declarations.size() << " declarations\n";
+
+    // IR generation
+    log << "Generating IR...\n";
+    syclang::IRGenerator irGenerator(options.arch);
+    auto module = irGenerator.generate(program);
+    log << "  Generated " << module->functions.size() << " functions\n";
+    return module;
+}
+
+// IR from an earlier --ir-binary run, or null after reporting why not
+std::shared_ptr<IRModule> loadBinaryIR(std::unique_ptr<SourceBuffer> source, const std::string& inputFile,
+                                       const CompileOptions& options, std::ostringstream& log,
+                                       std::ostringstream& errors) {
+    log << "Loading binary IR...\n";
+    std::string error;
+    auto reader = BinaryIRReader::open(std::move(source), error);
+    if (!reader) {
+        errors << "Error: " << error << "\n";
+        return nullptr;
+    }
+    if (reader->targetArch() != options.arch) {
+        errors << "Error: " << inputFile << " holds IR for "
+               << (reader->targetArch() == Architecture::X64 ? "x64" : "arm64") << "; pass the same --arch\n";
+        return nullptr;
+    }
+    auto module = reader->load();
+    log << "  Loaded " << module->functions.size() << " functions\n";
+    return module;
+}
+
+// Run the optimizer over `module` as the options ask, if they ask at all
+void optimizeModule(std::shared_ptr<IRModule>& module, const CompileOptions& options, std::ostringstream& log) {
+    if (options.optimizationLevel == 0 && !options.pipeline) {
+        return;
+    }
+    log << "Optimizing...\n";
+    syclang::Optimizer optimizer;
+    optimizer.setOptimizationLevel(options.optimizationLevel);
+    if (options.pipeline) {
+        optimizer.setPipeline(*options.pipeline);
+    }
+    syclang::LoopOptions loopOptions;
+    loopOptions.vectorIsa = options.vectorIsa;
+    optimizer.setLoopOptions(loopOptions);
+    optimizer.optimize(module);
+    const auto& stats = optimizer.getStats();
+    log << "  Inlined " << stats.inlinedCalls << " calls. Folded " << stats.foldedConstants << " constants and "
+        << stats.foldedBranches << " branches, removed " << stats.unreachableBlocks
+        << " unreachable blocks, " << stats.redundantInstructions << " redundant and "
+        << stats.deadInstructions << " dead instructions\n";
+    if (options.loopReport) {
+        log << optimizer.formatLoopReport();
+    }
+    if (options.timePasses) {
+        log << optimizer.formatPassTimings();
+    }
+}
+
+// Source or binary IR in, the contents of the output file appended to
+// `output` (which may be writing them to the file as they come); false
+// once the errors are reported. With an `irKey`, the optimized IR is
+// read from the cache when there, and stored there when not.
+bool compileSource(std::unique_ptr<SourceBuffer> source, const std::string& inputFile, const CompileOptions& options,
+                   const std::string& irKey, ThreadPool* pool, OutputBuffer& output, std::ostringstream& log,
+                   std::ostringstream& errors) {
+    std::shared_ptr<IRModule> module;
+    if (!irKey.empty() && !options.loopReport && !options.timePasses) {
+        TraceScope cacheTrace("IR cache lookup", "driver", inputFile);
+        module = loadCachedIR(irKey, options, log);
+    }
+    if (!module) {
+        module = isBinaryIR(source->text()) ? loadBinaryIR(std::move(source), inputFile, options, log, errors)
+                                            : parseSource(*source, inputFile, options, log, errors);
+        if (!module) {
+            return false;
+        }
+        optimizeModule(module, options, log);
+        if (!irKey.empty() && !options.cache->store(irKey, writeBinaryIR(*module))) {
+            log << "  Could not store the IR in the cache\n";
+        }
+    }
+    module->outputFormat = options.format.value_or(OutputFormat::ELF);
+
+    // Output IR or assembly
+    if (options.outputBinaryIR) {
+        log << "Outputting binary IR...\n";
+        output << writeBinaryIR(*module);
+    } else if (options.outputIR) {
+        log << "Outputting IR...\n";
+        output << module->dump();
+    } else {
+        log << "Code generation for "
+            << (options.arch == Architecture::X64 ? "x64" : "ARM64") << "...\n";
+
+        std::unique_ptr<syclang::CodeGenerator> codegen;
+        if (options.arch == Architecture::X64) {
+            codegen = std::make_unique<syclang::X64CodeGenerator>();
+        } else {
+            codegen = std::make_unique<syclang::ARM64CodeGenerator>();
+        }
+
+        // Binary formats need no assembler or linker: the backends
+        // assemble in process
+        bool binary = writesBinary(options);
+        codegen->setThreadPool(pool);
+        codegen->setEmitObjectCode(binary);
+        codegen->setPeephole(options.optimizationLevel >= 2);
+        if (output.file() >= 0) {
+            codegen->setOutputFile(output.file());
+        }
+        codegen->generate(module);
+        if (options.optimizationLevel >= 2) {
+            log << codegen->getPeepholeStats().format();
+        }
+        if (binary) {
+            const ObjectCode& object = codegen->getObjectCode();
+            log << "  Assembled " << object.text.size() << " bytes of code and " << object.data.size()
+                << " bytes of data\n";
+            std::vector<uint8_t> image;
+            if (options.format == OutputFormat::RAW) {
+                image = linkFlatImage(object);
+                log << "  Resolved " << object.relocations.size() << " relocations\n";
+            } else if (options.relocatable) {
+                image = writeElfObject(object, options.arch);
+                log << "  Wrote an ELF object with " << object.relocations.size() << " relocations\n";
+            } else {
+                ObjectCode program = object;
+                program.append(options.linkInputs, 16);
+                if (options.format == OutputFormat::ELF) {
+                    image = writeElfExecutable(program, options.arch);
+                    log << "  Linked " << program.relocations.size() << " relocations into an ELF executable\n";
+                } else {
+                    image = writePeImage(program, options.arch, *options.format);
+                    log << "  Linked " << program.relocations.size() << " relocations into a PE32+ "
+                        << (options.format == OutputFormat::EFI ? "EFI application" : "program") << "\n";
+                }
+            }
+            output << std::string_view(reinterpret_cast<const char*>(image.data()), image.size());
+        } else {
+            output.append(codegen->takeOutput());
+        }
+        if (options.allocationStats) {
+            log << codegen->formatAllocationStats();
+        }
+    }
+    return true;
+}
+
+// Full pipeline for one file. Touches nothing but the job, so any number
+// of these may run concurrently; codegen also fans out over `pool`.
+void compileFile(CompileJob& job, const CompileOptions& options, ThreadPool* pool) {
+    TraceScope trace("compile", "driver", job.inputFile);
+    std::ostringstream log;
+    std::ostringstream errors;
+
+    try {
+        // Read source file
+        log << "Reading source file: " << job.inputFile << "\n";
+        // Mapped for the whole compilation: tokens are slices of it
+        std::string readError;
+        std::unique_ptr<SourceBuffer> source;
+        {
+            TraceScope readTrace("read source", "driver", job.inputFile);
+            source = SourceBuffer::open(job.inputFile, readError);
+        }
+        if (!source) {
+            errors << "Error: " << readError << "\n";
+            job.log = log.str();
+            job.errors = errors.str();
+            return;
+        }
+
+        // Unchanged sources with unchanged options come from the cache,
+        // unless a report on the compilation itself was asked for
+        std::string cacheKey;
+        std::string irKey;
+        std::optional<std::string> cached;
+        if (options.cache) {
+            TraceScope cacheTrace("cache lookup", "driver", job.inputFile);
+            cacheKey = CompileCache::keyFor(source->text(), cacheOptions(options));
+            // A miss still skips parsing and optimizing when only the code
+            // generation options changed. IR outputs and IR inputs have
+            // nothing to gain from a second entry.
+            if (!options.outputIR && !options.outputBinaryIR && !isBinaryIR(source->text())) {
+                irKey = CompileCache::keyFor(source->text(), irCacheOptions(options));
+            }
+            if (!options.allocationStats && !options.loopReport && !options.timePasses) {
+                cached = options.cache->lookup(cacheKey);
+            }
+            if (cached) {
+                log << "Cache hit: " << cacheKey << "\n";
+            }
+        }
+
+        // With no cache entry to fill, the output goes to the file page by
+        // page while it is generated instead of being held whole
+        OutputBuffer output;
+        StreamedFile streamed;
+        if (!cached) {
+            if (!options.cache) {
+                if (!streamed.open(job.outputFile)) {
+                    errors << "Error: Cannot create file '" << job.outputFile << "'\n";
+                    job.log = log.str();
+                    job.errors = errors.str();
+                    return;
+                }
+                output.setFile(streamed.fd());
+            }
+            if (!compileSource(std::move(source), job.inputFile, options, irKey, pool, output, log, errors)) {
+                job.log = log.str();
+                job.errors = errors.str();
+                return;
+            }
+            if (options.cache && !options.cache->store(cacheKey, output.str())) {
+                log << "  Could not store the output in the cache\n";
+            }
+        }
+
+        // Write output file
+        TraceScope writeTrace("write output", "driver", job.outputFile);
+        bool written;
+        if (cached) {
+            written = writeFile(job.outputFile, *cached);
+        } else if (streamed.fd() >= 0) {
+            written = streamed.finish(output);
+        } else {
+            written = writeFile(job.outputFile, output);
+        }
+        if (!written) {
+            errors << "Error: Cannot create file '" << job.outputFile << "'\n";
+        } else {
+            if (writesExecutable(options) && options.format == OutputFormat::ELF) {
+                namespace fs = std::filesystem;
+                fs::permissions(job.outputFile, fs::perms::owner_exec | fs::perms::group_exec | fs::perms::others_exec,
+                                fs::perm_options::add);
+            }
+            log << "Output written to: " << job.outputFile << "\n";
+            job.succeeded = true;
+        }
+    } catch (const std::exception& e) {
+        errors << "Error: " << job.inputFile << ": " << e.what() << "\n";
+    }
+
+    job.log = log.str();
+    job.errors = errors.str();
+}
+
+// Write the trace --trace-out asked for, if any
+bool finishTrace(const std::string& path) {
+    if (path.empty()) {
+        return true;
+    }
+    Trace::stop();
+    std::string error;
+    if (!Trace::writeJson(path, error)) {
+        std::cerr << "Error: " << error << "\n";
+        return false;
+    }
+    std::cout << "Trace written to: " << path << " (" << Trace::eventCount() << " events)\n";
+    return true;
 }
 
 int main(int argc, char* argv[]) {
@@ -50,131 +587,312 @@ int main(int argc, char* argv[]) {
         printUsage(argv[0]);
         return 1;
     }
-    
-    // Parse command line arguments
-    std::string inputFile;
-    std::string outputFile = "output.s";
-    Architecture arch = Architecture::X64;
-    OutputFormat format = OutputFormat::ELF;
-    bool outputIR = false;
-    
+
+    // Expand response files first so they can hold options as well
+    std::vector<std::string> args;
     for (int i = 1; i < argc; ++i) {
         std::string arg = argv[i];
-        
+        if (arg.size() > 1 && arg[0] == '@') {
+            std::string error;
+            if (!readResponseFile(arg.substr(1), args, 0, error)) {
+                std::cerr << "Error: " << error << "\n";
+                return 1;
+            }
+        } else {
+            args.push_back(arg);
+        }
+    }
+
+    // Parse command line arguments
+    std::vector<std::string> inputFiles;
+    std::string outputFile;
+    std::string outputDir;
+    CompileOptions options;
+    unsigned jobs = 0;
+    std::string vectorIsa;
+    std::string traceFile;
+    std::vector<std::string> linkFiles;
+    std::string cacheDir;
+
+    for (size_t i = 0; i < args.size(); ++i) {
+        const std::string& arg = args[i];
+        bool hasValue = i + 1 < args.size();
+
         if (arg == "--help") {
             printUsage(argv[0]);
             return 0;
-        } else if (arg == "--arch" && i + 1 < argc) {
-            std::string archStr = argv[++i];
+        } else if (arg == "--arch" && hasValue) {
+            std::string archStr = args[++i];
             if (archStr == "x64" || archStr == "x86_64") {
-                arch = Architecture::X64;
+                options.arch = Architecture::X64;
             } else if (archStr == "arm64" || archStr == "aarch64") {
-                arch = Architecture::ARM64;
+                options.arch = Architecture::ARM64;
             } else {
                 std::cerr << "Error: Unknown architecture '" << archStr << "'\n";
                 return 1;
             }
-        } else if (arg == "--output" && i + 1 < argc) {
-            outputFile = argv[++i];
-        } else if (arg == "--format" && i + 1 < argc) {
-            std::string formatStr = argv[++i];
+        } else if (arg == "--output" && hasValue) {
+            outputFile = args[++i];
+        } else if (arg == "--output-dir" && hasValue) {
+            outputDir = args[++i];
+        } else if (arg == "--format" && hasValue) {
+            std::string formatStr = args[++i];
             if (formatStr == "elf") {
-                format = OutputFormat::ELF;
+                options.format = OutputFormat::ELF;
             } else if (formatStr == "pe") {
-                format = OutputFormat::PE;
+                options.format = OutputFormat::PE;
             } else if (formatStr == "efi") {
-                format = OutputFormat::EFI;
+                options.format = OutputFormat::EFI;
             } else if (formatStr == "raw") {
-                format = OutputFormat::RAW;
+                options.format = OutputFormat::RAW;
             } else {
                 std::cerr << "Error: Unknown format '" << formatStr << "'\n";
                 return 1;
             }
+        } else if (((arg == "-j" || arg == "--jobs") && hasValue) ||
+                   (arg.size() > 2 && arg.compare(0, 2, "-j") == 0)) {
+            std::string value = arg.size() > 2 && arg[1] == 'j' ? arg.substr(2) : args[++i];
+            std::optional<unsigned> parsed = parseJobs(value);
+            if (!parsed) {
+                std::cerr << "Error: " << (arg == "--jobs" ? "--jobs" : "-j") << " takes a number of jobs from 1 to "
+                          << MAX_JOBS << ", not '" << value << "'\n";
+                return 1;
+            }
+            jobs = *parsed;
         } else if (arg == "--ir") {
-            outputIR = true;
-        } else if (arg[0] != '-') {
-            inputFile = arg;
+            options.outputIR = true;
+        } else if (arg == "--ir-binary") {
+            options.outputIR = true;
+            options.outputBinaryIR = true;
+        } else if (arg.size() == 3 && arg.compare(0, 2, "-O") == 0 &&
+                   isdigit(static_cast<unsigned char>(arg[2]))) {
+            options.optimizationLevel = arg[2] - '0';
+        } else if (arg == "--vector-isa" && hasValue) {
+            vectorIsa = args[++i];
+        } else if (arg == "--passes" && hasValue) {
+            options.pipeline = args[++i];
+        } else if (arg == "--time-passes") {
+            options.timePasses = true;
+        } else if (arg == "--trace-out" && hasValue) {
+            traceFile = args[++i];
+        } else if (arg == "--loop-report") {
+            options.loopReport = true;
+        } else if (arg == "--regalloc-stats") {
+            options.allocationStats = true;
+        } else if (arg == "-c") {
+            options.relocatable = true;
+        } else if (arg == "--link" && hasValue) {
+            linkFiles.push_back(args[++i]);
+        } else if (arg == "--cache-dir" && hasValue) {
+            cacheDir = args[++i];
+        } else if (!arg.empty() && arg[0] != '-') {
+            inputFiles.push_back(arg);
         } else {
             std::cerr << "Error: Unknown option '" << arg << "'\n";
             return 1;
         }
     }
-    
-    if (inputFile.empty()) {
+
+    // The vector ISA must belong to the target
+    options.vectorIsa = defaultVectorIsa(options.arch);
+    if (!vectorIsa.empty()) {
+        bool x64 = options.arch == Architecture::X64;
+        if (vectorIsa == "none") {
+            options.vectorIsa = VectorIsa::NONE;
+        } else if (vectorIsa == "sse2" && x64) {
+            options.vectorIsa = VectorIsa::SSE2;
+        } else if (vectorIsa == "avx2" && x64) {
+            options.vectorIsa = VectorIsa::AVX2;
+        } else if (vectorIsa == "neon" && !x64) {
+            options.vectorIsa = VectorIsa::NEON;
+        } else {
+            std::cerr << "Error: Vector ISA '" << vectorIsa << "' is not available on "
+                      << (x64 ? "x64" : "arm64") << "\n";
+            return 1;
+        }
+    }
+
+    // Unknown pass names are reported once, not per input
+    if (options.pipeline) {
+        Optimizer optimizer;
+        try {
+            optimizer.setPipeline(*options.pipeline);
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << " (available:";
+            for (const auto& pass : optimizer.getPassManager().passes()) {
+                std::cerr << " " << pass.name;
+            }
+            std::cerr << ")\n";
+            return 1;
+        }
+    }
+
+    if (inputFiles.empty()) {
         std::cerr << "Error: No input file specified\n";
         printUsage(argv[0]);
         return 1;
     }
-    
+    if (inputFiles.size() > 1 && !outputFile.empty()) {
+        std::cerr << "Error: --output takes a single input; use --output-dir for several\n";
+        return 1;
+    }
+    bool executable = writesExecutable(options);
+    if (options.relocatable && options.format != OutputFormat::ELF) {
+        std::cerr << "Error: -c needs --format elf\n";
+        return 1;
+    }
+    if (!linkFiles.empty() && !executable) {
+        std::cerr << "Error: --link needs --format elf (without -c), pe or efi\n";
+        return 1;
+    }
+
+    // Objects to link are read once and shared by every input
+    for (const auto& path : linkFiles) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file) {
+            std::cerr << "Error: Cannot open '" << path << "'\n";
+            return 1;
+        }
+        std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        // Local symbols are named after the path, so it counts too
+        options.linkHash = hashContent(options.linkHash + path + '\0' +
+                                       hashContent(std::string_view(reinterpret_cast<const char*>(bytes.data()),
+                                                                    bytes.size())));
+        try {
+            options.linkInputs.append(readElfObject(bytes, path, options.arch), 16);
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << "\n";
+            return 1;
+        }
+    }
+
+    if (!outputDir.empty()) {
+        std::error_code error;
+        std::filesystem::create_directories(outputDir, error);
+        if (error) {
+            std::cerr << "Error: Cannot create directory '" << outputDir << "': " << error.message() << "\n";
+            return 1;
+        }
+    }
+
+    std::optional<CompileCache> cache;
+    if (!cacheDir.empty()) {
+        cache.emplace(cacheDir);
+        options.cache = &*cache;
+    }
+
+    // Assign every input its output path up front so results never depend
+    // on scheduling
+    std::vector<CompileJob> compileJobs(inputFiles.size());
+    std::set<std::string> outputPaths;
+    for (size_t i = 0; i < inputFiles.size(); ++i) {
+        compileJobs[i].inputFile = inputFiles[i];
+        if (!outputFile.empty()) {
+            compileJobs[i].outputFile = outputFile;
+        } else if (inputFiles.size() == 1 && outputDir.empty()) {
+            compileJobs[i].outputFile = executable && options.format == OutputFormat::ELF
+                                            ? "a.out"
+                                            : "output" + outputExtension(options);
+        } else {
+            compileJobs[i].outputFile = outputPathFor(inputFiles[i], outputDir, outputExtension(options));
+        }
+        if (!outputPaths.insert(compileJobs[i].outputFile).second) {
+            std::cerr << "Error: Inputs '" << inputFiles[i] << "' and another file both write '"
+                      << compileJobs[i].outputFile << "'\n";
+            return 1;
+        }
+    }
+
     std::cout << "SysLang Compiler v1.0.0\n";
     std::cout << "======================\n";
-    
-    // Read source file
-    std::cout << "Reading source file: " << inputFile << "\n";
-    std::string source = readFile(inputFile);
-    
-    // Lexical analysis
-    std::cout << "Lexical analysis...\n";
-    syclang::Lexer lexer(source);
-    auto tokens = lexer.tokenize();
-    std::cout << "  Found " << tokens.size() << " tokens\n";
-    
-    // Syntax parsing
-    std::cout << "Parsing...\n";
-    syclang::Parser parser(tokens);
-    auto program = parser.parse();
-    
-    if (!parser.getErrors().empty()) {
-        std::cerr << "\nParsing errors:\n";
-        for (const auto& error : parser.getErrors()) {
-            std::cerr << "  " << error << "\n";
-        }
-        return 1;
+
+    // Shared by per-file tasks and per-function code generation
+    ThreadPool pool(jobs);
+    if (!traceFile.empty()) {
+        Trace::start();
     }
-    std::cout << "  Parsed " << program->declarations.size() << " declarations\n";
-    
-    // IR generation
-    std::cout << "Generating IR...\n";
-    syclang::IRGenerator irGenerator(arch);
-    auto module = irGenerator.generate(program);
-    module->outputFormat = format;
-    std::cout << "  Generated " << module->functions.size() << " functions\n";
     
-    // Output IR or assembly
-    std::string output;
-    if (outputIR) {
-        std::cout << "Outputting IR...\n";
-        output = module->dump();
-    } else {
-        std::cout << "Code generation for " 
-                  << (arch == Architecture::X64 ? "x64" : "ARM64") << "...\n";
-        
-        std::unique_ptr<syclang::CodeGenerator> codegen;
-        if (arch == Architecture::X64) {
-            codegen = std::make_unique<syclang::X64CodeGenerator>();
+    if (compileJobs.size() == 1) {
+        CompileJob& job = compileJobs[0];
+        compileFile(job, options, &pool);
+        std::cout << job.log;
+        std::cerr << job.errors;
+        if (!finishTrace(traceFile) || !job.succeeded) {
+            return 1;
+        }
+
+        // Post-processing instructions
+        const std::string& output = job.outputFile;
+        if (executable && options.format == OutputFormat::ELF) {
+            std::cout << "\nStatically linked executable, run with: "
+                      << (output.find_first_of("/\\") == std::string::npos ? "./" : "") << output << "\n";
+        } else if (executable && options.format == OutputFormat::EFI) {
+            std::cout << "\nEFI application: copy to EFI/BOOT/BOOT"
+                      << (options.arch == Architecture::X64 ? "X64" : "AA64") << ".EFI on a FAT partition to boot it\n";
+        } else if (executable) {
+            std::cout << "\nWindows console program: " << output << "\n";
+        } else if (options.relocatable) {
+            std::cout << "\nTo link: cc -o program " << output << "\n";
+        } else if (options.outputBinaryIR) {
+            std::cout << "\nBinary IR: pass " << output << " to syclang in place of the source to continue\n";
+        } else if (options.format == OutputFormat::RAW && !options.outputIR) {
+            std::cout << "\nFlat binary: position-independent, entry points at their symbol offsets\n";
         } else {
-            codegen = std::make_unique<syclang::ARM64CodeGenerator>();
+            std::cout << "\nTo assemble and link:\n";
+            std::cout << "  as -o output.o " << output << "\n";
+            std::cout << "  ld -o program output.o\n";
         }
-        
-        codegen->generate(module);
-        output = codegen->getOutput();
+
+        std::cout << "\nCompilation successful!\n";
+        return 0;
     }
-    
-    // Write output file
-    writeFile(outputFile, output);
-    std::cout << "Output written to: " << outputFile << "\n";
-    
-    // Post-processing instructions
-    if (format == OutputFormat::EFI) {
-        std::cout << "\nNote: For EFI application, you need to:\n";
-        std::cout << "  1. Assemble the output with: as -o output.o " << outputFile << "\n";
-        std::cout << "  2. Link with EFI libraries: ld -o " << outputFile.substr(0, outputFile.find_last_of('.')) << ".efi output.o -lefi\n";
-    } else {
-        std::cout << "\nTo assemble and link:\n";
-        std::cout << "  as -o output.o " << outputFile << "\n";
-        std::cout << "  ld -o program output.o\n";
+
+    // Several inputs: one pool task per file. Results are reported in input
+    // order as soon as every earlier file has finished.
+    std::cout << "Compiling " << compileJobs.size() << " files with "
+              << pool.concurrency() << " jobs\n";
+
+    std::mutex reportMutex;
+    std::vector<char> finished(compileJobs.size(), 0);
+    size_t nextToReport = 0;
+    size_t failures = 0;
+
+    TaskGroup group(pool);
+    for (size_t i = 0; i < compileJobs.size(); ++i) {
+        group.run([&, i] {
+            compileFile(compileJobs[i], options, &pool);
+
+            std::lock_guard<std::mutex> lock(reportMutex);
+            finished[i] = 1;
+            while (nextToReport < compileJobs.size() && finished[nextToReport]) {
+                const CompileJob& job = compileJobs[nextToReport];
+                std::cout << "[" << nextToReport + 1 << "/" << compileJobs.size() << "] "
+                          << job.inputFile
+                          << (job.succeeded ? " -> " + job.outputFile : " FAILED") << "\n";
+                std::cerr << job.errors;
+                failures += job.succeeded ? 0 : 1;
+                ++nextToReport;
+            }
+        });
+    }
+    group.wait();
+
+    // Each file's log, with any pass timings, loop reports and allocation
+    // statistics, once everything has finished
+    for (const CompileJob& job : compileJobs) {
+        std::cout << "\n" << job.inputFile << ":\n" << job.log;
+    }
+    if (!finishTrace(traceFile)) {
+        return 1;
+    }
+    if (cache) {
+        std::cout << "Cache: " << cache->hits() << " hits, " << cache->misses() << " misses\n";
+    }
+
+    if (failures > 0) {
+        std::cerr << "\n" << failures << " of " << compileJobs.size() << " files failed\n";
+        return 1;
     }
-    
     std::cout << "\nCompilation successful!\n";
     return 0;
 }
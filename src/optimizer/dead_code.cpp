@@ -0,0 +1,60 @@
+#include "syclang/optimizer/dead_code.h"
+#include "syclang/ir/use_def.h"
+#include <algorithm>
+#include <unordered_set>
+#include <vector>
+
+namespace syclang {
+
+namespace {
+
+bool hasSideEffects(const IRInstruction& inst) {
+    switch (inst.opcode) {
+        case Opcode::STORE:
+        case Opcode::CALL:
+        case Opcode::BR:
+        case Opcode::CONDBR:
+        case Opcode::RET:
+            return true;
+        default:
+            return false;
+    }
+}
+
+} // namespace
+
+size_t eliminateDeadCode(IRArena& arena, IRFunction& func) {
+    UseDefChains chains(arena, func);
+
+    std::unordered_set<InstId> live;
+    std::vector<InstId> worklist;
+    for (BlockId blockId : func.blocks) {
+        for (InstId instId : arena.block(blockId).instructions) {
+            if (hasSideEffects(arena.instruction(instId))) {
+                live.insert(instId);
+                worklist.push_back(instId);
+            }
+        }
+    }
+    while (!worklist.empty()) {
+        InstId instId = worklist.back();
+        worklist.pop_back();
+        for (ValueId op : arena.operands(arena.instruction(instId))) {
+            InstId def = chains.definition(op);
+            if (def != INVALID_ID && live.insert(def).second) {
+                worklist.push_back(def);
+            }
+        }
+    }
+
+    size_t removed = 0;
+    for (BlockId blockId : func.blocks) {
+        auto& insts = arena.block(blockId).instructions;
+        size_t before = insts.size();
+        std::erase_if(insts, [&](InstId id) { return live.count(id) == 0; });
+        removed += before - insts.size();
+    }
+    return removed;
+}
+
+} // namespace syclang
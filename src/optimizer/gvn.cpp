@@ -0,0 +1,132 @@
+#include "syclang/optimizer/gvn.h"
+#include "syclang/ir/dominators.h"
+#include "syclang/ir/use_def.h"
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace syclang {
+
+namespace {
+
+struct Expression {
+    Opcode opcode;
+    IRType type;
+    ValueId left;
+    ValueId right;
+
+    bool operator==(const Expression& other) const {
+        return opcode == other.opcode && type == other.type && left == other.left &&
+               right == other.right;
+    }
+};
+
+struct ExpressionHash {
+    size_t operator()(const Expression& e) const {
+        uint64_t key = (static_cast<uint64_t>(e.left) << 32) | e.right;
+        key ^= (static_cast<uint64_t>(e.opcode) << 8 | static_cast<uint64_t>(e.type)) *
+               0x9E3779B97F4A7C15ull;
+        key ^= key >> 29;
+        key *= 0xBF58476D1CE4E5B9ull;
+        return static_cast<size_t>(key ^ (key >> 32));
+    }
+};
+
+bool isCommutative(Opcode op) {
+    return op == Opcode::ADD || op == Opcode::MUL || op == Opcode::AND || op == Opcode::OR ||
+           op == Opcode::XOR || op == Opcode::EQ || op == Opcode::NE;
+}
+
+// The key of a pure instruction, or false for anything else
+bool makeExpression(const IRArena& arena, const IRInstruction& inst, Expression& e) {
+    if (inst.result == INVALID_ID) return false;
+    auto ops = arena.operands(inst);
+    bool binary = inst.opcode <= Opcode::SHR ||
+                  (inst.opcode >= Opcode::EQ && inst.opcode <= Opcode::GE);
+    bool unary = (inst.opcode >= Opcode::NEG && inst.opcode <= Opcode::BIT_NOT) ||
+                 (inst.opcode >= Opcode::TRUNC && inst.opcode <= Opcode::BITCAST);
+    if (binary && ops.size() == 2) {
+        e = {inst.opcode, arena.value(inst.result).getType(), ops[0], ops[1]};
+    } else if (unary && ops.size() == 1) {
+        e = {inst.opcode, arena.value(inst.result).getType(), ops[0], INVALID_ID};
+    } else {
+        return false;
+    }
+    if (e.opcode == Opcode::GT || e.opcode == Opcode::GE) {
+        e.opcode = e.opcode == Opcode::GT ? Opcode::LT : Opcode::LE;
+        std::swap(e.left, e.right);
+    }
+    if (isCommutative(e.opcode) && e.right < e.left) {
+        std::swap(e.left, e.right);
+    }
+    return true;
+}
+
+} // namespace
+
+size_t numberValues(IRArena& arena, IRFunction& func) {
+    if (func.blocks.empty()) return 0;
+    return numberValues(arena, func, DominatorTree(arena, func));
+}
+
+size_t numberValues(IRArena& arena, IRFunction& func, const DominatorTree& dom) {
+    if (func.blocks.empty()) return 0;
+    UseDefChains chains(arena, func);
+
+    // Available expressions: entries made in a block are undone on
+    // leaving its dominator subtree
+    std::unordered_map<Expression, ValueId, ExpressionHash> available;
+    std::vector<Expression> added;
+    struct Frame {
+        BlockId block;
+        size_t addedMark;
+        size_t nextChild;
+    };
+    std::vector<Frame> walk;
+    std::unordered_set<InstId> removed;
+
+    auto enter = [&](BlockId blockId) {
+        walk.push_back({blockId, added.size(), 0});
+        for (InstId instId : arena.block(blockId).instructions) {
+            const IRInstruction& inst = arena.instruction(instId);
+            Expression e;
+            if (!makeExpression(arena, inst, e)) continue;
+            auto [it, inserted] = available.try_emplace(e, inst.result);
+            if (inserted) {
+                added.push_back(e);
+                continue;
+            }
+            // Later instructions read the leader from here on, which is
+            // what lets their own keys match
+            chains.replaceAllUses(arena, inst.result, it->second);
+            chains.erase(arena, instId);
+            removed.insert(instId);
+        }
+    };
+
+    enter(func.blocks[0]);
+    while (!walk.empty()) {
+        Frame& frame = walk.back();
+        const auto& children = dom.children(frame.block);
+        if (frame.nextChild < children.size()) {
+            enter(children[frame.nextChild++]);
+            continue;
+        }
+        for (size_t i = frame.addedMark; i < added.size(); ++i) {
+            available.erase(added[i]);
+        }
+        added.resize(frame.addedMark);
+        walk.pop_back();
+    }
+
+    if (!removed.empty()) {
+        for (BlockId blockId : func.blocks) {
+            std::erase_if(arena.block(blockId).instructions,
+                          [&](InstId id) { return removed.count(id) != 0; });
+        }
+    }
+    return removed.size();
+}
+
+} // namespace syclang
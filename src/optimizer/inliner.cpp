@@ -0,0 +1,235 @@
+#include "syclang/optimizer/inliner.h"
+#include "syclang/ir/call_graph.h"
+#include "syclang/ir/dominators.h"
+#include "syclang/ir/loop_info.h"
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace syclang {
+
+namespace {
+
+constexpr int CALL_OVERHEAD = 5;
+constexpr int CONSTANT_ARGUMENT_BONUS = 2;
+
+// Instructions that survive into the emitted code
+size_t codeSize(const IRArena& arena, const IRFunction& func) {
+    size_t size = 0;
+    for (BlockId block : func.blocks) {
+        for (InstId instId : arena.block(block).instructions) {
+            Opcode op = arena.instruction(instId).opcode;
+            size += op != Opcode::PHI && op != Opcode::ALLOCA && op != Opcode::BR && op != Opcode::RET;
+        }
+    }
+    return size;
+}
+
+size_t instructionCount(const IRArena& arena, const IRFunction& func) {
+    size_t count = 0;
+    for (BlockId block : func.blocks) count += arena.block(block).instructions.size();
+    return count;
+}
+
+class Inliner {
+public:
+    Inliner(IRModule& module, const CallGraph& graph, const InlineOptions& options)
+        : module_(module), arena_(module.arena), options_(options), graph_(graph) {}
+
+    size_t run() {
+        size_t inlined = 0;
+        for (const auto& component : graph_.components()) {
+            for (int node : component) {
+                inlined += inlineInto(node);
+            }
+        }
+        return inlined;
+    }
+
+private:
+    IRModule& module_;
+    IRArena& arena_;
+    const InlineOptions& options_;
+    const CallGraph& graph_;
+    unsigned serial_ = 0; // Keeps the labels of every inlined copy distinct
+
+    bool shouldInline(const CallGraph::CallSite& site, bool hot, size_t callerSize) const {
+        if (site.callee < 0) return false;
+        const IRFunction& callee = *module_.functions[site.callee];
+        if (callee.blocks.empty() || callee.isVariadic || callee.inlineHint == InlineHint::NEVER) {
+            return false;
+        }
+        // A copy of one step of a cycle still makes the recursive call
+        if (graph_.isRecursive(site.callee)) return false;
+        auto args = arena_.operands(arena_.instruction(site.call));
+        if (args.size() != callee.arguments.size()) return false;
+        if (callee.inlineHint == InlineHint::ALWAYS) return true;
+
+        int size = static_cast<int>(codeSize(arena_, callee));
+        int benefit = CALL_OVERHEAD + static_cast<int>(args.size());
+        for (ValueId arg : args) {
+            if (arena_.value(arg).isConstant()) benefit += CONSTANT_ARGUMENT_BONUS;
+        }
+        int threshold = options_.threshold + (hot ? options_.hotBonus : 0);
+        return size - benefit <= threshold && callerSize + size <= options_.maxCallerSize;
+    }
+
+    size_t inlineInto(int node) {
+        IRFunction& caller = *module_.functions[node];
+        const auto& calls = graph_.nodes()[node].calls;
+        if (caller.blocks.empty() || calls.empty()) return 0;
+
+        std::unordered_set<BlockId> inLoop;
+        {
+            DominatorTree dom(arena_, caller);
+            LoopInfo loops(caller, dom);
+            for (const auto& loop : loops.loops()) {
+                inLoop.insert(loop.blocks.begin(), loop.blocks.end());
+            }
+        }
+
+        // Last call first: splitting a block only moves the instructions
+        // after the call, which hold no call site still to be visited
+        size_t inlined = 0;
+        size_t callerSize = instructionCount(arena_, caller);
+        for (size_t c = calls.size(); c-- > 0;) {
+            const CallGraph::CallSite& site = calls[c];
+            if (!shouldInline(site, inLoop.count(site.block) != 0, callerSize)) continue;
+            inlineCall(caller, site, *module_.functions[site.callee]);
+            callerSize = instructionCount(arena_, caller);
+            ++inlined;
+        }
+        return inlined;
+    }
+
+    void inlineCall(IRFunction& caller, const CallGraph::CallSite& site, const IRFunction& callee) {
+        const IRInstruction call = arena_.instruction(site.call);
+        std::vector<ValueId> args(arena_.operands(call).begin(), arena_.operands(call).end());
+        std::string suffix = ".i" + std::to_string(serial_++);
+
+        // Split the block after the call; its successors' PHIs now see the
+        // second half as their predecessor
+        auto& insts = arena_.block(site.block).instructions;
+        auto at = std::find(insts.begin(), insts.end(), site.call);
+        BlockId cont = arena_.createBlock(arena_.block(site.block).name + suffix + ".ret");
+        std::vector<InstId> tail(at + 1, insts.end());
+        insts.erase(at, insts.end());
+        arena_.block(cont).instructions = tail;
+        if (!tail.empty() && arena_.instruction(tail.back()).isTerminator()) {
+            const IRInstruction& term = arena_.instruction(tail.back());
+            for (BlockId succ : term.targets) {
+                if (succ == INVALID_ID) continue;
+                for (InstId instId : arena_.block(succ).instructions) {
+                    IRInstruction& phi = arena_.instruction(instId);
+                    if (phi.opcode != Opcode::PHI) break;
+                    std::vector<ValueId> values(arena_.operands(phi).begin(), arena_.operands(phi).end());
+                    std::vector<BlockId> from(arena_.incomingBlocks(phi).begin(),
+                                              arena_.incomingBlocks(phi).end());
+                    std::replace(from.begin(), from.end(), site.block, cont);
+                    arena_.setIncoming(phi, values, from);
+                }
+            }
+        }
+
+        // Blocks and results first, so PHIs can refer forward
+        std::unordered_map<BlockId, BlockId> blocks;
+        std::unordered_map<ValueId, ValueId> values;
+        for (size_t i = 0; i < callee.arguments.size(); ++i) {
+            values[callee.arguments[i]] = args[i];
+        }
+        std::vector<BlockId> copies;
+        for (BlockId block : callee.blocks) {
+            BlockId copy = arena_.createBlock(callee.name + suffix + "." + arena_.block(block).name);
+            blocks[block] = copy;
+            copies.push_back(copy);
+            for (InstId instId : arena_.block(block).instructions) {
+                ValueId result = arena_.instruction(instId).result;
+                if (result == INVALID_ID) continue;
+                const IRValue& original = arena_.value(result);
+                values[result] = arena_.createVariable(original.getType(), original.name + suffix);
+            }
+        }
+        auto mapped = [&](ValueId value) {
+            auto it = values.find(value);
+            return it == values.end() ? value : it->second;
+        };
+
+        std::vector<ValueId> returned;
+        std::vector<BlockId> returnBlocks;
+        for (size_t b = 0; b < callee.blocks.size(); ++b) {
+            for (InstId instId : arena_.block(callee.blocks[b]).instructions) {
+                const IRInstruction& inst = arena_.instruction(instId);
+                std::vector<ValueId> ops;
+                for (ValueId op : arena_.operands(inst)) ops.push_back(mapped(op));
+                InstId clone;
+                if (inst.opcode == Opcode::RET) {
+                    // Returning becomes a jump to the rest of the caller
+                    returned.push_back(ops.empty() ? arena_.createI64(0) : ops[0]);
+                    returnBlocks.push_back(copies[b]);
+                    clone = arena_.createInstruction(Opcode::BR);
+                    arena_.instruction(clone).targets[0] = cont;
+                } else if (inst.opcode == Opcode::PHI) {
+                    std::vector<BlockId> from;
+                    for (BlockId pred : arena_.incomingBlocks(inst)) from.push_back(blocks.at(pred));
+                    ValueId result = mapped(inst.result);
+                    clone = arena_.createInstruction(Opcode::PHI, {}, result);
+                    arena_.setIncoming(arena_.instruction(clone), ops, from);
+                } else {
+                    ValueId result = inst.result == INVALID_ID ? INVALID_ID : mapped(inst.result);
+                    BlockId targets[2] = {inst.targets[0], inst.targets[1]};
+                    ValueId symbol = inst.callee;
+                    clone = arena_.createInstruction(inst.opcode, ops, result);
+                    IRInstruction& copy = arena_.instruction(clone);
+                    copy.callee = symbol;
+                    for (int t = 0; t < 2; ++t) {
+                        if (targets[t] != INVALID_ID) copy.targets[t] = blocks.at(targets[t]);
+                    }
+                }
+                arena_.block(copies[b]).instructions.push_back(clone);
+            }
+        }
+
+        InstId enter = arena_.createInstruction(Opcode::BR);
+        arena_.instruction(enter).targets[0] = copies.front();
+        arena_.block(site.block).instructions.push_back(enter);
+
+        auto position = std::find(caller.blocks.begin(), caller.blocks.end(), site.block) + 1;
+        copies.push_back(cont);
+        caller.blocks.insert(position, copies.begin(), copies.end());
+        caller.stackSize += callee.stackSize;
+
+        // The call's result is whatever came back, joined when there are
+        // several returns
+        if (call.result == INVALID_ID) return;
+        ValueId result = arena_.createI64(0);
+        if (returned.size() == 1) {
+            result = returned[0];
+        } else if (returned.size() > 1) {
+            result = arena_.createVariable(arena_.value(call.result).getType(),
+                                           arena_.value(call.result).name + suffix);
+            InstId phi = arena_.createInstruction(Opcode::PHI, {}, result);
+            arena_.setIncoming(arena_.instruction(phi), returned, returnBlocks);
+            auto& contInsts = arena_.block(cont).instructions;
+            contInsts.insert(contInsts.begin(), phi);
+        }
+        for (BlockId block : caller.blocks) {
+            for (InstId instId : arena_.block(block).instructions) {
+                for (ValueId& op : arena_.operands(arena_.instruction(instId))) {
+                    if (op == call.result) op = result;
+                }
+            }
+        }
+    }
+};
+
+} // namespace
+
+size_t inlineFunctions(IRModule& module, const InlineOptions& options) {
+    return inlineFunctions(module, CallGraph(module), options);
+}
+
+size_t inlineFunctions(IRModule& module, const CallGraph& graph, const InlineOptions& options) {
+    return Inliner(module, graph, options).run();
+}
+
+} // namespace syclang
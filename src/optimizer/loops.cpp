@@ -0,0 +1,499 @@
+#include "syclang/optimizer/loops.h"
+#include "syclang/ir/dominators.h"
+#include "syclang/ir/loop_info.h"
+#include "syclang/ir/use_def.h"
+#include "syclang/optimizer/sccp.h"
+#include <algorithm>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace syclang {
+
+namespace {
+
+constexpr int64_t MAX_SIMULATED_TRIPS = 1 << 16;
+
+bool isComparison(Opcode op) {
+    return op >= Opcode::EQ && op <= Opcode::GE;
+}
+
+double blockCycles(const IRArena& arena, const std::vector<BlockId>& blocks) {
+    double cycles = 0;
+    for (BlockId block : blocks) {
+        for (InstId instId : arena.block(block).instructions) {
+            cycles += instructionLatency(arena.instruction(instId).opcode);
+        }
+    }
+    return cycles;
+}
+
+// Pure and safe to execute even where the loop would not have
+bool isSpeculatable(const IRArena& arena, const IRInstruction& inst) {
+    if (inst.result == INVALID_ID) return false;
+    auto ops = arena.operands(inst);
+    Opcode op = inst.opcode;
+    if (op == Opcode::DIV || op == Opcode::MOD) {
+        if (ops.size() != 2) return false;
+        const IRValue& divisor = arena.value(ops[1]);
+        return divisor.isConstant() && divisor.value_.intValue != 0 && divisor.value_.intValue != -1;
+    }
+    return (op <= Opcode::SHR && ops.size() == 2) || (isComparison(op) && ops.size() == 2) ||
+           (op >= Opcode::NEG && op <= Opcode::BIT_NOT && ops.size() == 1) ||
+           (op >= Opcode::TRUNC && op <= Opcode::BITCAST && ops.size() == 1);
+}
+
+InstId terminatorOf(const IRArena& arena, BlockId block) {
+    const auto& insts = arena.block(block).instructions;
+    if (insts.empty() || !arena.instruction(insts.back()).isTerminator()) return INVALID_ID;
+    return insts.back();
+}
+
+// Insert before the block's terminator
+void insertBeforeTerminator(IRArena& arena, BlockId block, InstId inst) {
+    auto& insts = arena.block(block).instructions;
+    auto at = insts.end();
+    if (!insts.empty() && arena.instruction(insts.back()).isTerminator()) --at;
+    insts.insert(at, inst);
+}
+
+// A header PHI stepped by an invariant amount on the latch edge
+struct InductionVariable {
+    InstId phi;
+    ValueId value;
+    ValueId init;
+    ValueId step;
+    Opcode update; // ADD or SUB
+};
+
+class LoopOptimizer {
+public:
+    LoopOptimizer(IRArena& arena, IRFunction& func, const LoopOptions& options)
+        : arena_(arena), func_(func), options_(options) {}
+
+    std::vector<LoopReport> run(const LoopInfo* info) {
+        std::vector<LoopReport> reports;
+        if (func_.blocks.empty()) return reports;
+        loops_ = info ? info->loops() : LoopInfo(func_, DominatorTree(arena_, func_)).loops();
+        if (loops_.empty()) return reports;
+
+        // Vectorizing adds blocks, so the loops are found again afterwards
+        std::vector<LoopVectorization> vectorized;
+        if (options_.vectorIsa != VectorIsa::NONE) {
+            vectorized = vectorizeLoops(arena_, func_, options_.vectorIsa);
+            if (std::any_of(vectorized.begin(), vectorized.end(),
+                            [](const LoopVectorization& v) { return v.vectorHeader != INVALID_ID; })) {
+                loops_ = LoopInfo(func_, DominatorTree(arena_, func_)).loops();
+            }
+        }
+        // Kept current by every rewrite below except unrolling, which runs last
+        chains_.emplace(arena_, func_);
+
+        reports.resize(loops_.size());
+        for (size_t l = 0; l < loops_.size(); ++l) {
+            reports[l].function = func_.name;
+            reports[l].header = arena_.block(loops_[l].header).name;
+            reports[l].depth = loops_[l].depth;
+            reports[l].cyclesBefore = blockCycles(arena_, loops_[l].blocks);
+            for (const LoopVectorization& v : vectorized) {
+                if (v.header == loops_[l].header) {
+                    reports[l].vectorNote = v.reason;
+                    if (v.vectorHeader != INVALID_ID) reports[l].vectorLanes = v.lanes;
+                }
+            }
+        }
+
+        for (size_t l = 0; l < loops_.size(); ++l) {
+            if (loops_[l].preheader == INVALID_ID) continue;
+            if (options_.hoistInvariants) reports[l].hoisted = hoistInvariants(loops_[l]);
+            if (options_.reduceStrength) reports[l].reduced = reduceStrength(loops_[l]);
+        }
+
+        std::vector<bool> innermost(loops_.size(), true);
+        for (const auto& loop : loops_) {
+            if (loop.parent >= 0) innermost[loop.parent] = false;
+        }
+        for (size_t l = 0; l < loops_.size(); ++l) {
+            reports[l].tripCount = tripCount(loops_[l]);
+        }
+        for (size_t l = 0; l < loops_.size(); ++l) {
+            if (innermost[l] && options_.unrollFactor > 1) {
+                reports[l].unrollFactor = unroll(l, reports[l].tripCount);
+            }
+        }
+        for (size_t l = 0; l < loops_.size(); ++l) {
+            reports[l].cyclesAfter = blockCycles(arena_, loops_[l].blocks) / reports[l].unrollFactor;
+        }
+        return reports;
+    }
+
+private:
+    IRArena& arena_;
+    IRFunction& func_;
+    const LoopOptions& options_;
+    std::vector<LoopInfo::Loop> loops_;
+    std::optional<UseDefChains> chains_;
+
+    // Constants, arguments and values computed outside the loop. Variables
+    // that still live in memory (globals, non-promoted locals) may be
+    // stored to inside the loop, so they never count.
+    bool isInvariant(const LoopInfo::Loop& loop, ValueId value) const {
+        const UseDefChains& chains = *chains_;
+        if (arena_.value(value).isConstant()) return true;
+        InstId def = chains.definition(value);
+        if (def == INVALID_ID) {
+            return std::find(func_.arguments.begin(), func_.arguments.end(), value) !=
+                   func_.arguments.end();
+        }
+        return arena_.instruction(def).opcode != Opcode::ALLOCA && !loop.contains(chains.blockOf(def));
+    }
+
+    size_t hoistInvariants(const LoopInfo::Loop& loop) {
+        std::unordered_set<ValueId> hoisted;
+        auto invariant = [&](ValueId value) {
+            return hoisted.count(value) != 0 || isInvariant(loop, value);
+        };
+        size_t count = 0;
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (BlockId block : loop.blocks) {
+                auto& insts = arena_.block(block).instructions;
+                for (size_t i = 0; i < insts.size();) {
+                    const IRInstruction& inst = arena_.instruction(insts[i]);
+                    auto ops = arena_.operands(inst);
+                    if (!isSpeculatable(arena_, inst) || !std::all_of(ops.begin(), ops.end(), invariant)) {
+                        ++i;
+                        continue;
+                    }
+                    InstId moved = insts[i];
+                    hoisted.insert(inst.result);
+                    insts.erase(insts.begin() + i);
+                    insertBeforeTerminator(arena_, loop.preheader, moved);
+                    chains_->erase(arena_, moved);
+                    chains_->insert(arena_, moved, loop.preheader);
+                    ++count;
+                    changed = true;
+                }
+            }
+        }
+        return count;
+    }
+
+    // Header PHIs of the form i = phi [init, preheader], [i +/- step, latch]
+    std::vector<InductionVariable> inductionVariables(const LoopInfo::Loop& loop) const {
+        const UseDefChains& chains = *chains_;
+        std::vector<InductionVariable> result;
+        if (loop.latches.size() != 1) return result;
+        BlockId latch = loop.latches[0];
+        for (InstId instId : arena_.block(loop.header).instructions) {
+            const IRInstruction& phi = arena_.instruction(instId);
+            if (phi.opcode != Opcode::PHI) break;
+            auto values = arena_.operands(phi);
+            auto from = arena_.incomingBlocks(phi);
+            if (values.size() != 2) continue;
+            size_t back = from[0] == latch ? 0 : 1;
+            if (from[back] != latch || from[1 - back] != loop.preheader) continue;
+            InstId updateId = chains.definition(values[back]);
+            if (updateId == INVALID_ID || !loop.contains(chains.blockOf(updateId))) continue;
+            const IRInstruction& update = arena_.instruction(updateId);
+            auto ops = arena_.operands(update);
+            if (ops.size() != 2) continue;
+            ValueId step = INVALID_ID;
+            if (update.opcode == Opcode::ADD && ops[0] == phi.result) step = ops[1];
+            else if (update.opcode == Opcode::ADD && ops[1] == phi.result) step = ops[0];
+            else if (update.opcode == Opcode::SUB && ops[0] == phi.result) step = ops[1];
+            if (step == INVALID_ID || !isInvariant(loop, step)) continue;
+            result.push_back({instId, phi.result, values[1 - back], step, update.opcode});
+        }
+        return result;
+    }
+
+    // a * b in the preheader, folded when both are constants
+    ValueId multiplyInPreheader(const LoopInfo::Loop& loop, IRType type, ValueId a, ValueId b) {
+        const IRValue& left = arena_.value(a);
+        const IRValue& right = arena_.value(b);
+        if (left.isConstant() && right.isConstant()) {
+            auto folded = foldOperation(Opcode::MUL, type, type, left.value_.uintValue,
+                                        right.value_.uintValue);
+            if (folded) return arena_.createConstant(type, *folded);
+        }
+        ValueId product = arena_.createVariable(type, arena_.value(a).isConstant()
+                                                          ? arena_.value(b).name + ".scaled"
+                                                          : arena_.value(a).name + ".scaled");
+        InstId multiply = arena_.createInstruction(Opcode::MUL, {a, b}, product);
+        insertBeforeTerminator(arena_, loop.preheader, multiply);
+        chains_->insert(arena_, multiply, loop.preheader);
+        return product;
+    }
+
+    size_t reduceStrength(const LoopInfo::Loop& loop) {
+        UseDefChains& chains = *chains_;
+        auto ivs = inductionVariables(loop);
+        if (ivs.empty()) return 0;
+        BlockId latch = loop.latches[0];
+
+        size_t count = 0;
+        std::unordered_set<InstId> removed;
+        for (const InductionVariable& iv : ivs) {
+            std::vector<InstId> users(chains.users(iv.value).begin(), chains.users(iv.value).end());
+            for (InstId userId : users) {
+                if (removed.count(userId)) continue;
+                const IRInstruction& user = arena_.instruction(userId);
+                auto ops = arena_.operands(user);
+                if (user.opcode != Opcode::MUL || ops.size() != 2) continue;
+                if (!loop.contains(chains.blockOf(userId))) continue;
+                ValueId factor = ops[0] == iv.value ? ops[1] : ops[0];
+                if (factor == iv.value || !isInvariant(loop, factor)) continue;
+
+                // j = i * k is itself stepped by step * k
+                ValueId product = user.result;
+                IRType type = arena_.value(product).getType();
+                const std::string name = arena_.value(product).name;
+                ValueId start = multiplyInPreheader(loop, type, iv.init, factor);
+                ValueId stride = multiplyInPreheader(loop, type, iv.step, factor);
+                ValueId phiValue = arena_.createVariable(type, name + ".iv");
+                ValueId next = arena_.createVariable(type, name + ".next");
+                InstId phi = arena_.createInstruction(Opcode::PHI, {}, phiValue);
+                ValueId incoming[2] = {start, next};
+                BlockId blocks[2] = {loop.preheader, latch};
+                arena_.setIncoming(arena_.instruction(phi), incoming, blocks);
+                auto& header = arena_.block(loop.header).instructions;
+                header.insert(header.begin(), phi);
+                InstId step = arena_.createInstruction(iv.update, {phiValue, stride}, next);
+                insertBeforeTerminator(arena_, latch, step);
+                chains.insert(arena_, phi, loop.header);
+                chains.insert(arena_, step, latch);
+
+                chains.erase(arena_, userId);
+                chains.replaceAllUses(arena_, product, phiValue);
+                removed.insert(userId);
+                ++count;
+            }
+        }
+        if (!removed.empty()) {
+            for (BlockId block : loop.blocks) {
+                std::erase_if(arena_.block(block).instructions,
+                              [&](InstId id) { return removed.count(id) != 0; });
+            }
+        }
+        return count;
+    }
+
+    // The header's exit test: CONDBR on a comparison of an induction
+    // variable with a constant, and the target that stays in the loop
+    struct ExitTest {
+        InstId compare = INVALID_ID;
+        bool continueWhen = true;
+    };
+    ExitTest exitTest(const LoopInfo::Loop& loop) const {
+        ExitTest test;
+        InstId term = terminatorOf(arena_, loop.header);
+        if (term == INVALID_ID) return test;
+        const IRInstruction& branch = arena_.instruction(term);
+        auto ops = arena_.operands(branch);
+        if (branch.opcode != Opcode::CONDBR || ops.size() != 1) return test;
+        bool trueInside = loop.contains(branch.targets[0]);
+        bool falseInside = loop.contains(branch.targets[1]);
+        if (trueInside == falseInside) return test;
+        for (InstId instId : arena_.block(loop.header).instructions) {
+            if (arena_.instruction(instId).result == ops[0] &&
+                isComparison(arena_.instruction(instId).opcode)) {
+                test.compare = instId;
+            }
+        }
+        test.continueWhen = trueInside;
+        return test;
+    }
+
+    int64_t tripCount(const LoopInfo::Loop& loop) {
+        if (loop.preheader == INVALID_ID) return -1;
+        ExitTest test = exitTest(loop);
+        if (test.compare == INVALID_ID) return -1;
+        const IRInstruction& compare = arena_.instruction(test.compare);
+        auto ops = arena_.operands(compare);
+        if (ops.size() != 2) return -1;
+        for (const InductionVariable& iv : inductionVariables(loop)) {
+            size_t side = ops[0] == iv.value ? 0 : ops[1] == iv.value ? 1 : 2;
+            if (side == 2) continue;
+            const IRValue& bound = arena_.value(ops[1 - side]);
+            const IRValue& init = arena_.value(iv.init);
+            const IRValue& step = arena_.value(iv.step);
+            if (!bound.isConstant() || !init.isConstant() || !step.isConstant()) return -1;
+
+            IRType type = arena_.value(iv.value).getType();
+            IRType resultType = arena_.value(compare.result).getType();
+            uint64_t value = init.value_.uintValue;
+            for (int64_t trips = 0; trips <= MAX_SIMULATED_TRIPS; ++trips) {
+                uint64_t left = side == 0 ? value : bound.value_.uintValue;
+                uint64_t right = side == 0 ? bound.value_.uintValue : value;
+                auto taken = foldOperation(compare.opcode, resultType, type, left, right);
+                if (!taken) return -1;
+                if ((*taken != 0) != test.continueWhen) return trips;
+                auto next = foldOperation(iv.update, type, type, value, step.value_.uintValue);
+                if (!next) return -1;
+                value = *next;
+            }
+            return -1;
+        }
+        return -1;
+    }
+
+    // Body blocks in execution order when the loop is a straight chain
+    // header -> b1 -> ... -> bn -> header, else empty
+    std::vector<BlockId> bodyChain(const LoopInfo::Loop& loop) const {
+        std::vector<BlockId> chain;
+        if (loop.latches.size() != 1 || loop.exits.size() != 1) return chain;
+        const IRInstruction& branch = arena_.instruction(terminatorOf(arena_, loop.header));
+        BlockId block = loop.contains(branch.targets[0]) ? branch.targets[0] : branch.targets[1];
+        while (block != loop.header) {
+            if (std::find(chain.begin(), chain.end(), block) != chain.end()) return {};
+            InstId term = terminatorOf(arena_, block);
+            if (term == INVALID_ID || arena_.instruction(term).opcode != Opcode::BR) return {};
+            const auto& insts = arena_.block(block).instructions;
+            if (arena_.instruction(insts.front()).opcode == Opcode::PHI) return {};
+            chain.push_back(block);
+            block = arena_.instruction(term).targets[0];
+        }
+        if (chain.size() + 1 != loop.blocks.size() || chain.back() != loop.latches[0]) return {};
+        return chain;
+    }
+
+    unsigned unroll(size_t index, int64_t trips) {
+        LoopInfo::Loop& loop = loops_[index];
+        if (trips < 2 || loop.preheader == INVALID_ID) return 1;
+        std::vector<BlockId> chain = bodyChain(loop);
+        if (chain.empty()) return 1;
+
+        // The header's own work (the exit test and anything before it)
+        // runs on every trip, so each copy repeats it minus the branch
+        std::vector<InstId> headerWork;
+        std::vector<InstId> phis;
+        for (InstId instId : arena_.block(loop.header).instructions) {
+            const IRInstruction& inst = arena_.instruction(instId);
+            if (inst.opcode == Opcode::PHI) phis.push_back(instId);
+            else if (!inst.isTerminator()) headerWork.push_back(instId);
+        }
+        size_t bodySize = headerWork.size();
+        for (BlockId block : chain) bodySize += arena_.block(block).instructions.size();
+
+        unsigned factor = std::min<int64_t>(options_.unrollFactor, trips);
+        while (factor > 1 && (trips % factor != 0 || (factor - 1) * bodySize > options_.maxUnrolledSize)) {
+            --factor;
+        }
+        if (factor < 2) return 1;
+
+        BlockId latch = chain.back();
+        std::vector<ValueId> latchValues;
+        for (InstId phi : phis) {
+            const IRInstruction& inst = arena_.instruction(phi);
+            auto from = arena_.incomingBlocks(inst);
+            auto values = arena_.operands(inst);
+            size_t i = std::find(from.begin(), from.end(), latch) - from.begin();
+            latchValues.push_back(i < values.size() ? values[i] : INVALID_ID);
+        }
+        if (std::find(latchValues.begin(), latchValues.end(), INVALID_ID) != latchValues.end()) {
+            return 1;
+        }
+
+        std::unordered_map<ValueId, ValueId> previous; // Identity for the original body
+        auto mapped = [](const std::unordered_map<ValueId, ValueId>& map, ValueId value) {
+            auto it = map.find(value);
+            return it == map.end() ? value : it->second;
+        };
+        InstId lastBranch = terminatorOf(arena_, latch);
+        BlockId lastBlock = latch;
+        std::vector<BlockId> added;
+        for (unsigned copy = 1; copy < factor; ++copy) {
+            std::unordered_map<ValueId, ValueId> map;
+            for (size_t p = 0; p < phis.size(); ++p) {
+                map[arena_.instruction(phis[p]).result] = mapped(previous, latchValues[p]);
+            }
+            std::vector<BlockId> copies;
+            for (BlockId block : chain) {
+                copies.push_back(arena_.createBlock(arena_.block(block).name + ".u" + std::to_string(copy)));
+            }
+            auto cloneInto = [&](BlockId target, InstId instId) {
+                const IRInstruction& inst = arena_.instruction(instId);
+                std::vector<ValueId> ops;
+                for (ValueId op : arena_.operands(inst)) ops.push_back(mapped(map, op));
+                ValueId result = INVALID_ID;
+                if (inst.result != INVALID_ID) {
+                    const IRValue& original = arena_.value(inst.result);
+                    result = arena_.createVariable(original.getType(),
+                                                   original.name + ".u" + std::to_string(copy));
+                    map[inst.result] = result;
+                }
+                Opcode opcode = inst.opcode;
+                ValueId callee = inst.callee;
+                InstId clone = arena_.createInstruction(opcode, ops, result);
+                arena_.instruction(clone).callee = callee;
+                arena_.block(target).instructions.push_back(clone);
+            };
+            for (InstId instId : headerWork) cloneInto(copies[0], instId);
+            for (size_t b = 0; b < chain.size(); ++b) {
+                const auto insts = arena_.block(chain[b]).instructions;
+                for (size_t i = 0; i + 1 < insts.size(); ++i) cloneInto(copies[b], insts[i]);
+                InstId branch = arena_.createInstruction(Opcode::BR);
+                arena_.instruction(branch).targets[0] =
+                    b + 1 < chain.size() ? copies[b + 1] : loop.header;
+                arena_.block(copies[b]).instructions.push_back(branch);
+            }
+            arena_.instruction(lastBranch).targets[0] = copies[0];
+            lastBranch = arena_.block(copies.back()).instructions.back();
+            lastBlock = copies.back();
+            added.insert(added.end(), copies.begin(), copies.end());
+            previous = std::move(map);
+        }
+
+        // The back edge now leaves the last copy with its values
+        for (size_t p = 0; p < phis.size(); ++p) {
+            IRInstruction& inst = arena_.instruction(phis[p]);
+            std::vector<ValueId> values(arena_.operands(inst).begin(), arena_.operands(inst).end());
+            std::vector<BlockId> from(arena_.incomingBlocks(inst).begin(),
+                                      arena_.incomingBlocks(inst).end());
+            for (size_t i = 0; i < from.size(); ++i) {
+                if (from[i] == latch) {
+                    from[i] = lastBlock;
+                    values[i] = mapped(previous, latchValues[p]);
+                }
+            }
+            arena_.setIncoming(inst, values, from);
+        }
+
+        auto at = std::find(func_.blocks.begin(), func_.blocks.end(), latch);
+        func_.blocks.insert(at + 1, added.begin(), added.end());
+        for (int l = static_cast<int>(index); l >= 0; l = loops_[l].parent) {
+            loops_[l].blocks.insert(loops_[l].blocks.end(), added.begin(), added.end());
+            loops_[l].members.insert(added.begin(), added.end());
+        }
+        loop.latches = {lastBlock};
+        return factor;
+    }
+};
+
+} // namespace
+
+double instructionLatency(Opcode op) {
+    switch (op) {
+        case Opcode::MUL: return 3;
+        case Opcode::DIV:
+        case Opcode::MOD: return 25;
+        case Opcode::LOAD: return 4;
+        case Opcode::CALL: return 10;
+        case Opcode::PHI:
+        case Opcode::ALLOCA: return 0;
+        default: return 1;
+    }
+}
+
+std::vector<LoopReport> optimizeLoops(IRArena& arena, IRFunction& func, const LoopOptions& options) {
+    return LoopOptimizer(arena, func, options).run(nullptr);
+}
+
+std::vector<LoopReport> optimizeLoops(IRArena& arena, IRFunction& func, const LoopInfo& loops,
+                                      const LoopOptions& options) {
+    return LoopOptimizer(arena, func, options).run(&loops);
+}
+
+} // namespace syclang
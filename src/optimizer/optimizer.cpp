@@ -1,153 +1,113 @@
 #include "syclang/optimizer/optimizer.h"
-#include <iostream>
-#include <algorithm>
-#include <unordered_set>
+#include "syclang/optimizer/dead_code.h"
+#include "syclang/optimizer/gvn.h"
+#include "syclang/optimizer/sccp.h"
+#include "syclang/trace.h"
+#include <cstdio>
 
 namespace syclang {
 
 Optimizer::Optimizer() {
     optimizationLevel_ = 1;
+    registerPasses();
 }
 
-void Optimizer::optimize(std::shared_ptr<IRModule> module) {
-    std::cout << "Running optimizations...\n";
-    
-    // Dead code elimination
-    if (optimizationLevel_ >= 1) {
-        eliminateDeadCode(module);
-    }
-    
-    // Constant folding
-    if (optimizationLevel_ >= 1) {
-        foldConstants(module);
-    }
-    
-    // Common subexpression elimination
-    if (optimizationLevel_ >= 2) {
-        eliminateCommonSubexpressions(module);
-    }
-    
-    // Loop optimizations
-    if (optimizationLevel_ >= 2) {
-        optimizeLoops(module);
-    }
-    
-    std::cout << "Optimizations complete.\n";
+void Optimizer::registerPasses() {
+    // Inlining goes first in -O2, so the passes after it see through the
+    // calls and constant arguments fold in the copied bodies
+    passManager_.registerPass({"inline", "Inline small calls bottom-up over the call graph",
+                               {Analysis::CALL_GRAPH},
+                               [this](IRModule& module, AnalysisManager& analyses) {
+                                   size_t inlined = syclang::inlineFunctions(
+                                       module, analyses.callGraph(), inlineOptions_);
+                                   stats_.inlinedCalls += inlined;
+                                   return inlined ? PreservedAnalyses::none() : PreservedAnalyses::all();
+                               },
+                               nullptr});
+
+    // Constant propagation before the rest: the conditions and arithmetic
+    // it folds away leave dead code behind
+    passManager_.registerPass({"sccp", "Sparse conditional constant propagation", {}, nullptr,
+                               [this](IRArena& arena, IRFunction& func, AnalysisManager&) {
+                                   auto result = propagateConstants(arena, func);
+                                   stats_.foldedConstants += result.folded;
+                                   stats_.foldedBranches += result.branches;
+                                   stats_.unreachableBlocks += result.removedBlocks;
+                                   bool cfgChanged = result.branches || result.removedBlocks;
+                                   return cfgChanged ? PreservedAnalyses::none() : PreservedAnalyses::all();
+                               }});
+
+    passManager_.registerPass({"gvn", "Dominator-scoped global value numbering",
+                               {Analysis::DOMINATORS}, nullptr,
+                               [this](IRArena& arena, IRFunction& func, AnalysisManager& analyses) {
+                                   stats_.redundantInstructions +=
+                                       numberValues(arena, func, analyses.dominators(func));
+                                   return PreservedAnalyses::all();
+                               }});
+
+    // Vectorizing and unrolling add blocks; hoisting and strength
+    // reduction only move and add instructions
+    passManager_.registerPass({"loops", "Vectorize, hoist invariants, reduce strength and unroll",
+                               {Analysis::LOOPS}, nullptr,
+                               [this](IRArena& arena, IRFunction& func, AnalysisManager& analyses) {
+                                   auto reports = syclang::optimizeLoops(arena, func, analyses.loops(func),
+                                                                         loopOptions_);
+                                   bool cfgChanged = false;
+                                   for (const auto& report : reports) {
+                                       cfgChanged |= report.vectorLanes > 1 || report.unrollFactor > 1;
+                                   }
+                                   loopReports_.insert(loopReports_.end(), reports.begin(), reports.end());
+                                   return cfgChanged ? PreservedAnalyses::none() : PreservedAnalyses::all();
+                               }});
+
+    passManager_.registerPass({"dce", "Dead code elimination over use-def chains", {}, nullptr,
+                               [this](IRArena& arena, IRFunction& func, AnalysisManager&) {
+                                   stats_.deadInstructions += syclang::eliminateDeadCode(arena, func);
+                                   return PreservedAnalyses::all();
+                               }});
 }
 
-void Optimizer::eliminateDeadCode(std::shared_ptr<IRModule> module) {
-    // Remove unreachable code and unused variables
-    for (auto& func : module->functions) {
-        for (auto& block : func->blocks) {
-            // Mark used instructions
-            std::set<std::shared_ptr<IRInstruction>> used;
-            for (auto& inst : block->instructions) {
-                if (inst->opcode == Opcode::RET || inst->opcode == Opcode::STORE) {
-                    used.insert(inst);
-                }
-            }
-            
-            // Remove unused instructions (simplified)
-            auto newEnd = std::remove_if(block->instructions.begin(), 
-                                        block->instructions.end(),
-                                        [&used](const std::shared_ptr<IRInstruction>& inst) {
-                                            return used.find(inst) == used.end();
-                                        });
-            block->instructions.erase(newEnd, block->instructions.end());
-        }
-    }
+std::string Optimizer::pipelineForLevel(int level) {
+    if (level >= 2) return "inline,sccp,gvn,loops,dce";
+    if (level == 1) return "sccp,dce";
+    return "";
 }
 
-void Optimizer::foldConstants(std::shared_ptr<IRModule> module) {
-    // Simplify constant expressions
-    for (auto& func : module->functions) {
-        for (auto& block : func->blocks) {
-            for (auto& inst : block->instructions) {
-                // Check if both operands are constants
-                auto leftConst = std::dynamic_pointer_cast<IRConstant>(inst->operands[0]);
-                auto rightConst = std::dynamic_pointer_cast<IRConstant>(inst->operands[1]);
-                
-                if (leftConst && rightConst) {
-                    // Fold the operation
-                    int64_t result = 0;
-                    bool canFold = true;
-                    
-                    switch (inst->opcode) {
-                        case Opcode::ADD:
-                            result = leftConst->value_.intValue + rightConst->value_.intValue;
-                            break;
-                        case Opcode::SUB:
-                            result = leftConst->value_.intValue - rightConst->value_.intValue;
-                            break;
-                        case Opcode::MUL:
-                            result = leftConst->value_.intValue * rightConst->value_.intValue;
-                            break;
-                        case Opcode::DIV:
-                            if (rightConst->value_.intValue != 0) {
-                                result = leftConst->value_.intValue / rightConst->value_.intValue;
-                            } else {
-                                canFold = false;
-                            }
-                            break;
-                        default:
-                            canFold = false;
-                    }
-                    
-                    if (canFold) {
-                        // Replace instruction with constant
-                        inst->operands.clear();
-                        inst->operands.push_back(IRConstant::createI64(result));
-                        inst->opcode = Opcode::LOAD; // Changed to load constant
-                    }
-                }
-            }
-        }
-    }
+void Optimizer::setPipeline(const std::string& pipeline) {
+    passManager_.setPipeline(pipeline);
+    explicitPipeline_ = true;
 }
 
-void Optimizer::eliminateCommonSubexpressions(std::shared_ptr<IRModule> module) {
-    // Identify and eliminate redundant computations
-    // This is a simplified implementation
-    for (auto& func : module->functions) {
-        for (auto& block : func->blocks) {
-            std::map<std::string, std::shared_ptr<IRValue>> valueMap;
-            
-            for (auto& inst : block->instructions) {
-                if (inst->operands.size() >= 2) {
-                    // Create a key for this expression
-                    std::string key = std::to_string(static_cast<int>(inst->opcode));
-                    for (const auto& op : inst->operands) {
-                        key += ":" + op->toString();
-                    }
-                    
-                    // Check if we've seen this expression before
-                    auto it = valueMap.find(key);
-                    if (it != valueMap.end()) {
-                        // Replace with previous result
-                        inst->result = it->second;
-                    } else if (inst->result) {
-                        // Store this result for future use
-                        valueMap[key] = inst->result;
-                    }
-                }
-            }
+void Optimizer::optimize(std::shared_ptr<IRModule> module) {
+    TraceScope trace("optimize", "optimizer");
+    if (!explicitPipeline_) {
+        // Setting the same pipeline again would drop the earlier timings
+        std::string current;
+        for (const auto& name : passManager_.pipeline()) {
+            current += (current.empty() ? "" : ",") + name;
         }
+        std::string pipeline = pipelineForLevel(optimizationLevel_);
+        if (pipeline != current) passManager_.setPipeline(pipeline);
     }
+    passManager_.run(*module);
 }
 
-void Optimizer::optimizeLoops(std::shared_ptr<IRModule> module) {
-    // Perform loop optimizations: invariant code motion, induction variable analysis, etc.
-    // This is a placeholder for a full loop optimizer
-    for (auto& func : module->functions) {
-        for (auto& block : func->blocks) {
-            // Identify loop headers and perform optimizations
-            // Simplified: just mark loops for now
-            if (block->name.find("while") != std::string::npos ||
-                block->name.find("for") != std::string::npos) {
-                // This is a loop block
-            }
-        }
+std::string Optimizer::formatLoopReport() const {
+    std::string text = "Loops:\n";
+    char line[200];
+    std::snprintf(line, sizeof(line), "  %-20s %-16s %5s %6s %7s %7s %6s %6s %14s\n", "function",
+                  "header", "depth", "trips", "hoisted", "reduced", "unroll", "lanes", "cycles/iter");
+    text += line;
+    for (const auto& loop : loopReports_) {
+        std::string trips = loop.tripCount < 0 ? "?" : std::to_string(loop.tripCount);
+        std::snprintf(line, sizeof(line), "  %-20s %-16s %5u %6s %7zu %7zu %6u %6u %6.1f -> %5.1f",
+                      loop.function.c_str(), loop.header.c_str(), loop.depth, trips.c_str(),
+                      loop.hoisted, loop.reduced, loop.unrollFactor, loop.vectorLanes,
+                      loop.cyclesBefore, loop.cyclesAfter);
+        text += line;
+        text += loop.vectorNote.empty() ? "\n" : "  (" + loop.vectorNote + ")\n";
     }
+    return text;
 }
 
 } // namespace syclang
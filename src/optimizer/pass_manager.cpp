@@ -0,0 +1,250 @@
+#include "syclang/optimizer/pass_manager.h"
+#include "syclang/trace.h"
+#include <chrono>
+#include <cstdio>
+#include <stdexcept>
+
+namespace syclang {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+size_t instructionCount(const IRModule& module) {
+    size_t count = 0;
+    for (const auto& func : module.functions) {
+        for (BlockId block : func->blocks) count += module.arena.block(block).instructions.size();
+    }
+    return count;
+}
+
+constexpr size_t ANALYSIS_COUNT = static_cast<size_t>(Analysis::COUNT);
+
+} // namespace
+
+const char* analysisName(Analysis analysis) {
+    switch (analysis) {
+        case Analysis::DOMINATORS: return "dominator-tree";
+        case Analysis::LOOPS: return "loop-info";
+        case Analysis::CALL_GRAPH: return "call-graph";
+        default: return "?";
+    }
+}
+
+// Only require() counts reuse: a pass asking again for what it required
+// is not a second use
+
+const DominatorTree& AnalysisManager::dominators(const IRFunction& func) {
+    auto& cached = functions_[&func].dominators;
+    if (cached) return *cached;
+    Stats& s = stats(Analysis::DOMINATORS);
+    TraceScope trace(analysisName(Analysis::DOMINATORS), "analysis", func.name);
+    auto start = Clock::now();
+    cached = std::make_unique<DominatorTree>(module_.arena, func);
+    s.seconds += secondsSince(start);
+    ++s.computed;
+    return *cached;
+}
+
+const LoopInfo& AnalysisManager::loops(const IRFunction& func) {
+    FunctionResults& results = functions_[&func];
+    if (results.loops) return *results.loops;
+    if (results.dominators) ++stats(Analysis::DOMINATORS).reused;
+    const DominatorTree& dom = dominators(func);
+    Stats& s = stats(Analysis::LOOPS);
+    TraceScope trace(analysisName(Analysis::LOOPS), "analysis", func.name);
+    auto start = Clock::now();
+    results.loops = std::make_unique<LoopInfo>(func, dom);
+    s.seconds += secondsSince(start);
+    ++s.computed;
+    return *results.loops;
+}
+
+const CallGraph& AnalysisManager::callGraph() {
+    if (callGraph_) return *callGraph_;
+    Stats& s = stats(Analysis::CALL_GRAPH);
+    TraceScope trace(analysisName(Analysis::CALL_GRAPH), "analysis");
+    auto start = Clock::now();
+    callGraph_ = std::make_unique<CallGraph>(module_);
+    s.seconds += secondsSince(start);
+    ++s.computed;
+    return *callGraph_;
+}
+
+void AnalysisManager::require(Analysis analysis, const IRFunction* func) {
+    if (analysis == Analysis::CALL_GRAPH) {
+        if (callGraph_) ++stats(analysis).reused;
+        callGraph();
+        return;
+    }
+    if (!func) return;
+    auto it = functions_.find(func);
+    bool valid = it != functions_.end() &&
+                 (analysis == Analysis::DOMINATORS ? it->second.dominators != nullptr
+                                                      : it->second.loops != nullptr);
+    if (valid) {
+        ++stats(analysis).reused;
+    } else if (analysis == Analysis::DOMINATORS) {
+        dominators(*func);
+    } else {
+        loops(*func);
+    }
+}
+
+void AnalysisManager::invalidate(const IRFunction& func, const PreservedAnalyses& preserved) {
+    auto it = functions_.find(&func);
+    if (it == functions_.end()) return;
+    if (!preserved.preserves(Analysis::DOMINATORS)) {
+        it->second.dominators.reset();
+        it->second.loops.reset();
+    }
+    if (!preserved.preserves(Analysis::LOOPS)) it->second.loops.reset();
+}
+
+void AnalysisManager::invalidateModule(const PreservedAnalyses& preserved) {
+    if (!preserved.preserves(Analysis::CALL_GRAPH)) callGraph_.reset();
+}
+
+void PassManager::registerPass(PassInfo info) {
+    if (byName_.count(info.name)) {
+        throw std::runtime_error("Pass '" + info.name + "' is registered twice");
+    }
+    if (!info.runOnModule == !info.runOnFunction) {
+        throw std::runtime_error("Pass '" + info.name + "' must run on either the module or functions");
+    }
+    byName_.emplace(info.name, passes_.size());
+    passes_.push_back(std::move(info));
+}
+
+const PassInfo* PassManager::find(const std::string& name) const {
+    auto it = byName_.find(name);
+    return it == byName_.end() ? nullptr : &passes_[it->second];
+}
+
+void PassManager::setPipeline(const std::string& pipeline) {
+    std::vector<std::string> names;
+    size_t begin = 0;
+    while (!pipeline.empty()) {
+        size_t end = pipeline.find(',', begin);
+        if (end == std::string::npos) end = pipeline.size();
+        std::string name = pipeline.substr(begin, end - begin);
+        size_t first = name.find_first_not_of(" \t");
+        size_t last = name.find_last_not_of(" \t");
+        if (first == std::string::npos) {
+            throw std::runtime_error("Empty pass name in pipeline '" + pipeline + "'");
+        }
+        names.push_back(name.substr(first, last - first + 1));
+        if (end == pipeline.size()) break;
+        begin = end + 1;
+    }
+    setPipeline(names);
+}
+
+void PassManager::setPipeline(const std::vector<std::string>& names) {
+    for (const auto& name : names) {
+        if (!find(name)) throw std::runtime_error("Unknown pass '" + name + "'");
+    }
+    pipeline_ = names;
+    timings_.clear();
+}
+
+void PassManager::run(IRModule& module) {
+    AnalysisManager analyses(module);
+    auto analysisSeconds = [&] {
+        double seconds = 0;
+        for (size_t a = 0; a < ANALYSIS_COUNT; ++a) {
+            seconds += analyses.getStats(static_cast<Analysis>(a)).seconds;
+        }
+        return seconds;
+    };
+    auto prepare = [&](const PassInfo& pass, const IRFunction* func) {
+        for (Analysis analysis : pass.required) analyses.require(analysis, func);
+    };
+
+    timings_.resize(pipeline_.size());
+    for (size_t p = 0; p < pipeline_.size(); ++p) {
+        const PassInfo& pass = passes_[byName_.at(pipeline_[p])];
+        PassTiming& timing = timings_[p];
+        timing.name = pass.name;
+        TraceScope trace(pass.name, "optimizer");
+        timing.instructionsBefore += instructionCount(module);
+        timing.arenaBytesBefore += module.arena.getStats().usedBytes;
+
+        // Analyses computed while the pass runs are charged to them
+        double seconds = 0;
+        auto measure = [&](auto&& body) {
+            double analysed = analysisSeconds();
+            auto start = Clock::now();
+            PreservedAnalyses preserved = body();
+            seconds += secondsSince(start) - (analysisSeconds() - analysed);
+            return preserved;
+        };
+
+        if (pass.runOnModule) {
+            prepare(pass, nullptr);
+            PreservedAnalyses preserved = measure([&] { return pass.runOnModule(module, analyses); });
+            for (const auto& func : module.functions) analyses.invalidate(*func, preserved);
+            analyses.invalidateModule(preserved);
+        } else {
+            PreservedAnalyses moduleWide = PreservedAnalyses::all();
+            for (const auto& func : module.functions) {
+                if (func->blocks.empty()) continue;
+                TraceScope functionTrace(pass.name, "optimizer", func->name);
+                prepare(pass, func.get());
+                PreservedAnalyses preserved =
+                    measure([&] { return pass.runOnFunction(module.arena, *func, analyses); });
+                analyses.invalidate(*func, preserved);
+                if (!preserved.preserves(Analysis::CALL_GRAPH)) moduleWide.abandon(Analysis::CALL_GRAPH);
+            }
+            analyses.invalidateModule(moduleWide);
+        }
+
+        timing.seconds += seconds;
+        timing.instructionsAfter += instructionCount(module);
+        timing.arenaBytesAfter += module.arena.getStats().usedBytes;
+    }
+
+    for (size_t a = 0; a < ANALYSIS_COUNT; ++a) {
+        const auto& s = analyses.getStats(static_cast<Analysis>(a));
+        analysisStats_[a].computed += s.computed;
+        analysisStats_[a].reused += s.reused;
+        analysisStats_[a].seconds += s.seconds;
+    }
+}
+
+std::string PassManager::formatTimings() const {
+    double total = 0;
+    for (const auto& timing : timings_) total += timing.seconds;
+    for (const auto& s : analysisStats_) total += s.seconds;
+    auto percent = [&](double seconds) { return total > 0 ? 100.0 * seconds / total : 0.0; };
+
+    std::string text = "Pass timings:\n";
+    char line[200];
+    std::snprintf(line, sizeof(line), "  %-22s %9s %6s %21s %19s\n", "pass", "wall ms", "%",
+                  "instructions", "arena KiB");
+    text += line;
+    for (const auto& timing : timings_) {
+        std::snprintf(line, sizeof(line), "  %-22s %9.3f %5.1f%% %9zu -> %-8zu %8.1f -> %.1f\n",
+                      timing.name.c_str(), timing.seconds * 1e3, percent(timing.seconds),
+                      timing.instructionsBefore, timing.instructionsAfter,
+                      timing.arenaBytesBefore / 1024.0, timing.arenaBytesAfter / 1024.0);
+        text += line;
+    }
+    for (size_t a = 0; a < ANALYSIS_COUNT; ++a) {
+        const auto& s = analysisStats_[a];
+        if (s.computed == 0 && s.reused == 0) continue;
+        std::string name = std::string("(") + analysisName(static_cast<Analysis>(a)) + ")";
+        std::snprintf(line, sizeof(line), "  %-22s %9.3f %5.1f%%   %zu computed, %zu reused\n",
+                      name.c_str(), s.seconds * 1e3, percent(s.seconds), s.computed, s.reused);
+        text += line;
+    }
+    std::snprintf(line, sizeof(line), "  %-22s %9.3f\n", "total", total * 1e3);
+    text += line;
+    return text;
+}
+
+} // namespace syclang
@@ -0,0 +1,464 @@
+#include "syclang/optimizer/sccp.h"
+#include "syclang/ir/use_def.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace syclang {
+
+namespace {
+
+unsigned bitWidth(IRType type) {
+    switch (type) {
+        case IRType::BOOL: return 1;
+        case IRType::I8: case IRType::U8: return 8;
+        case IRType::I16: case IRType::U16: return 16;
+        case IRType::I32: case IRType::U32: return 32;
+        default: return 64;
+    }
+}
+
+bool isSigned(IRType type) {
+    return type == IRType::I8 || type == IRType::I16 || type == IRType::I32 || type == IRType::I64;
+}
+
+bool isFloat(IRType type) {
+    return type == IRType::F32 || type == IRType::F64;
+}
+
+// Wrap an integer to the width of `type` and extend it back to 64 bits
+uint64_t normalize(IRType type, uint64_t bits) {
+    if (type == IRType::BOOL) return bits != 0;
+    unsigned width = bitWidth(type);
+    if (width == 64) return bits;
+    uint64_t mask = (uint64_t{1} << width) - 1;
+    bits &= mask;
+    if (isSigned(type) && (bits >> (width - 1)) != 0) {
+        bits |= ~mask;
+    }
+    return bits;
+}
+
+double toDouble(uint64_t bits) {
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+uint64_t fromDouble(IRType type, double value) {
+    if (type == IRType::F32) {
+        value = static_cast<float>(value);
+    }
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+bool isComparison(Opcode op) {
+    return op == Opcode::EQ || op == Opcode::NE || op == Opcode::LT || op == Opcode::GT ||
+           op == Opcode::LE || op == Opcode::GE;
+}
+
+template <typename T>
+bool compare(Opcode op, T a, T b) {
+    switch (op) {
+        case Opcode::EQ: return a == b;
+        case Opcode::NE: return a != b;
+        case Opcode::LT: return a < b;
+        case Opcode::GT: return a > b;
+        case Opcode::LE: return a <= b;
+        default: return a >= b;
+    }
+}
+
+std::optional<uint64_t> foldFloat(Opcode op, IRType resultType, uint64_t left, uint64_t right) {
+    double a = toDouble(left);
+    double b = toDouble(right);
+    if (isComparison(op)) {
+        return normalize(resultType, compare(op, a, b));
+    }
+    if (!isFloat(resultType)) return std::nullopt;
+    switch (op) {
+        case Opcode::ADD: return fromDouble(resultType, a + b);
+        case Opcode::SUB: return fromDouble(resultType, a - b);
+        case Opcode::MUL: return fromDouble(resultType, a * b);
+        case Opcode::DIV: return fromDouble(resultType, a / b);
+        case Opcode::MOD: return fromDouble(resultType, std::fmod(a, b));
+        case Opcode::NEG: return fromDouble(resultType, -a);
+        default: return std::nullopt;
+    }
+}
+
+} // namespace
+
+std::optional<uint64_t> foldOperation(Opcode op, IRType resultType, IRType operandType,
+                                      uint64_t left, uint64_t right) {
+    switch (op) {
+        case Opcode::TRUNC:
+        case Opcode::BITCAST:
+            if (isFloat(operandType) != isFloat(resultType) || operandType == IRType::F32 ||
+                resultType == IRType::F32) {
+                return std::nullopt;
+            }
+            return isFloat(resultType) ? left : normalize(resultType, left);
+        case Opcode::ZEXT:
+        case Opcode::SEXT: {
+            if (isFloat(operandType) || isFloat(resultType)) return std::nullopt;
+            unsigned width = bitWidth(operandType);
+            uint64_t value = width == 64 ? left : left & ((uint64_t{1} << width) - 1);
+            if (op == Opcode::SEXT && width < 64 && (value >> (width - 1)) != 0) {
+                value |= ~((uint64_t{1} << width) - 1);
+            }
+            return normalize(resultType, value);
+        }
+        case Opcode::FPTOSI:
+        case Opcode::FPTOUI: {
+            if (!isFloat(operandType) || isFloat(resultType)) return std::nullopt;
+            double value = std::trunc(toDouble(left));
+            unsigned width = bitWidth(resultType);
+            if (op == Opcode::FPTOSI) {
+                double limit = std::ldexp(1.0, static_cast<int>(width) - 1);
+                if (!(value >= -limit && value < limit)) return std::nullopt;
+                return normalize(resultType, static_cast<uint64_t>(static_cast<int64_t>(value)));
+            }
+            if (!(value >= 0 && value < std::ldexp(1.0, static_cast<int>(width)))) {
+                return std::nullopt;
+            }
+            return normalize(resultType, static_cast<uint64_t>(value));
+        }
+        case Opcode::SITOFP:
+        case Opcode::UITOFP: {
+            if (isFloat(operandType) || !isFloat(resultType)) return std::nullopt;
+            uint64_t value = normalize(operandType, left);
+            if (op == Opcode::SITOFP) {
+                return fromDouble(resultType, static_cast<double>(static_cast<int64_t>(value)));
+            }
+            unsigned width = bitWidth(operandType);
+            if (width < 64) value &= (uint64_t{1} << width) - 1;
+            return fromDouble(resultType, static_cast<double>(value));
+        }
+        default:
+            break;
+    }
+
+    if (isFloat(operandType) || isFloat(resultType)) {
+        if (!isFloat(operandType)) return std::nullopt;
+        if (op == Opcode::NOT) return normalize(resultType, toDouble(left) == 0.0);
+        return foldFloat(op, resultType, left, right);
+    }
+
+    if (isComparison(op)) {
+        uint64_t a = normalize(operandType, left);
+        uint64_t b = normalize(operandType, right);
+        bool result = isSigned(operandType)
+                          ? compare(op, static_cast<int64_t>(a), static_cast<int64_t>(b))
+                          : compare(op, a, b);
+        return normalize(resultType, result);
+    }
+
+    uint64_t a = normalize(resultType, left);
+    uint64_t b = normalize(resultType, right);
+    unsigned width = bitWidth(resultType);
+    switch (op) {
+        case Opcode::ADD: return normalize(resultType, a + b);
+        case Opcode::SUB: return normalize(resultType, a - b);
+        case Opcode::MUL: return normalize(resultType, a * b);
+        case Opcode::AND: return normalize(resultType, a & b);
+        case Opcode::OR: return normalize(resultType, a | b);
+        case Opcode::XOR: return normalize(resultType, a ^ b);
+        case Opcode::SHL: return normalize(resultType, a << (b & 63));
+        case Opcode::SHR: {
+            uint64_t value = width == 64 ? a : a & ((uint64_t{1} << width) - 1);
+            return normalize(resultType, value >> (b & 63));
+        }
+        case Opcode::DIV:
+        case Opcode::MOD: {
+            if (b == 0) return std::nullopt;
+            if (!isSigned(resultType)) {
+                return normalize(resultType, op == Opcode::DIV ? a / b : a % b);
+            }
+            int64_t x = static_cast<int64_t>(a);
+            int64_t y = static_cast<int64_t>(b);
+            // The most negative value divided by -1 overflows (and traps)
+            int64_t minimum = static_cast<int64_t>(normalize(resultType, uint64_t{1} << (width - 1)));
+            if (y == -1 && x == minimum) {
+                return std::nullopt;
+            }
+            return normalize(resultType, static_cast<uint64_t>(op == Opcode::DIV ? x / y : x % y));
+        }
+        case Opcode::NEG: return normalize(resultType, uint64_t{0} - a);
+        case Opcode::BIT_NOT: return normalize(resultType, ~a);
+        case Opcode::NOT: return normalize(resultType, normalize(operandType, left) == 0);
+        default: return std::nullopt;
+    }
+}
+
+namespace {
+
+struct Lattice {
+    enum class State : uint8_t { UNKNOWN, CONSTANT, VARIES };
+    State state = State::UNKNOWN;
+    uint64_t bits = 0;
+};
+
+class Solver {
+public:
+    Solver(IRArena& arena, IRFunction& func) : arena_(arena), func_(func), chains_(arena, func) {
+        for (uint32_t b = 0; b < func.blocks.size(); ++b) {
+            blockIndex_[func.blocks[b]] = b;
+        }
+        executable_.assign(func.blocks.size(), false);
+    }
+
+    ConstantPropagationStats run() {
+        ConstantPropagationStats stats;
+        if (func_.blocks.empty()) return stats;
+        solve();
+        rewrite(stats);
+        return stats;
+    }
+
+private:
+    IRArena& arena_;
+    IRFunction& func_;
+    UseDefChains chains_;
+    std::unordered_map<BlockId, uint32_t> blockIndex_;
+    std::unordered_map<ValueId, Lattice> values_;
+    std::vector<bool> executable_;
+    std::unordered_set<uint64_t> edges_; // Executable (from, to) pairs
+    std::vector<std::pair<BlockId, BlockId>> edgeWork_;
+    std::vector<InstId> valueWork_;
+
+    static uint64_t edgeKey(BlockId from, BlockId to) {
+        return (static_cast<uint64_t>(from) << 32) | to;
+    }
+    bool isExecutable(BlockId from, BlockId to) const {
+        return edges_.count(edgeKey(from, to)) != 0;
+    }
+
+    Lattice lattice(ValueId value) {
+        const IRValue& v = arena_.value(value);
+        if (v.isConstant()) {
+            return {Lattice::State::CONSTANT, v.value_.uintValue};
+        }
+        if (chains_.definition(value) == INVALID_ID) {
+            return {Lattice::State::VARIES, 0}; // Argument, global or memory
+        }
+        auto it = values_.find(value);
+        return it == values_.end() ? Lattice{} : it->second;
+    }
+
+    // Lower a value's lattice to `next` and revisit its users if it moved
+    void update(ValueId value, Lattice next) {
+        Lattice& current = values_[value];
+        if (current.state == next.state && current.bits == next.bits) return;
+        if (current.state == Lattice::State::CONSTANT && next.state == Lattice::State::CONSTANT) {
+            next.state = Lattice::State::VARIES; // Two different constants
+        }
+        if (next.state < current.state) return;
+        current = next;
+        for (InstId user : chains_.users(value)) {
+            valueWork_.push_back(user);
+        }
+    }
+
+    void markEdge(BlockId from, BlockId to) {
+        if (blockIndex_.count(to) && edges_.insert(edgeKey(from, to)).second) {
+            edgeWork_.push_back({from, to});
+        }
+    }
+
+    void solve() {
+        BlockId entry = func_.blocks[0];
+        edgeWork_.push_back({INVALID_ID, entry});
+        while (!edgeWork_.empty() || !valueWork_.empty()) {
+            while (!edgeWork_.empty()) {
+                auto [from, to] = edgeWork_.back();
+                edgeWork_.pop_back();
+                uint32_t b = blockIndex_[to];
+                bool first = !executable_[b];
+                executable_[b] = true;
+                for (InstId instId : arena_.block(to).instructions) {
+                    const IRInstruction& inst = arena_.instruction(instId);
+                    if (!first && inst.opcode != Opcode::PHI) break;
+                    visit(instId, to);
+                }
+                if (first && !endsInTerminator(to) && b + 1 < func_.blocks.size()) {
+                    markEdge(to, func_.blocks[b + 1]); // Falls through
+                }
+            }
+            while (!valueWork_.empty() && edgeWork_.empty()) {
+                InstId instId = valueWork_.back();
+                valueWork_.pop_back();
+                BlockId block = chains_.blockOf(instId);
+                if (block != INVALID_ID && executable_[blockIndex_[block]]) {
+                    visit(instId, block);
+                }
+            }
+        }
+    }
+
+    bool endsInTerminator(BlockId block) const {
+        const auto& insts = arena_.block(block).instructions;
+        return !insts.empty() && arena_.instruction(insts.back()).isTerminator();
+    }
+
+    void visit(InstId instId, BlockId block) {
+        const IRInstruction& inst = arena_.instruction(instId);
+        auto ops = arena_.operands(inst);
+        switch (inst.opcode) {
+            case Opcode::BR:
+                markEdge(block, inst.targets[0]);
+                return;
+            case Opcode::CONDBR: {
+                Lattice cond = ops.empty() ? Lattice{Lattice::State::VARIES, 0} : lattice(ops[0]);
+                if (cond.state == Lattice::State::CONSTANT) {
+                    markEdge(block, inst.targets[cond.bits != 0 ? 0 : 1]);
+                } else {
+                    // Unknown conditions are treated as varying: a condition
+                    // still unknown here has no reaching definition
+                    markEdge(block, inst.targets[0]);
+                    markEdge(block, inst.targets[1]);
+                }
+                return;
+            }
+            case Opcode::PHI: {
+                auto from = arena_.incomingBlocks(inst);
+                Lattice meet;
+                for (size_t i = 0; i < ops.size(); ++i) {
+                    if (!isExecutable(from[i], block)) continue;
+                    Lattice input = lattice(ops[i]);
+                    if (input.state == Lattice::State::UNKNOWN) continue;
+                    if (input.state == Lattice::State::VARIES ||
+                        (meet.state == Lattice::State::CONSTANT && meet.bits != input.bits)) {
+                        meet = {Lattice::State::VARIES, 0};
+                        break;
+                    }
+                    meet = input;
+                }
+                update(inst.result, meet);
+                return;
+            }
+            default:
+                break;
+        }
+        if (inst.result == INVALID_ID) return;
+        update(inst.result, evaluate(inst, ops));
+    }
+
+    Lattice evaluate(const IRInstruction& inst, std::span<const ValueId> ops) {
+        constexpr Lattice varies{Lattice::State::VARIES, 0};
+        bool unary = inst.opcode == Opcode::NEG || inst.opcode == Opcode::NOT ||
+                     inst.opcode == Opcode::BIT_NOT ||
+                     (inst.opcode >= Opcode::TRUNC && inst.opcode <= Opcode::BITCAST);
+        bool binary = inst.opcode <= Opcode::SHR || isComparison(inst.opcode);
+        if (!(unary && ops.size() == 1) && !(binary && ops.size() == 2)) return varies;
+
+        Lattice left = lattice(ops[0]);
+        Lattice right = binary ? lattice(ops[1]) : Lattice{Lattice::State::CONSTANT, 0};
+        if (left.state == Lattice::State::VARIES || right.state == Lattice::State::VARIES) {
+            return varies;
+        }
+        if (left.state == Lattice::State::UNKNOWN || right.state == Lattice::State::UNKNOWN) {
+            return {};
+        }
+
+        // Comparisons and conversions look at the operand type: that of a
+        // non-constant operand when there is one, constants being untyped
+        // literals in practice
+        IRType operandType = arena_.value(ops[0]).getType();
+        if (binary && arena_.value(ops[0]).isConstant() && arena_.value(ops[1]).isVariable()) {
+            operandType = arena_.value(ops[1]).getType();
+        }
+        IRType resultType = arena_.value(inst.result).getType();
+        auto folded = foldOperation(inst.opcode, resultType, operandType, left.bits, right.bits);
+        return folded ? Lattice{Lattice::State::CONSTANT, *folded} : varies;
+    }
+
+    void rewrite(ConstantPropagationStats& stats) {
+        std::unordered_set<InstId> removed;
+        for (uint32_t b = 0; b < func_.blocks.size(); ++b) {
+            if (!executable_[b]) continue;
+            for (InstId instId : arena_.block(func_.blocks[b]).instructions) {
+                IRInstruction& inst = arena_.instruction(instId);
+                if (inst.opcode == Opcode::CONDBR) {
+                    auto ops = arena_.operands(inst);
+                    Lattice cond = ops.empty() ? Lattice{} : lattice(ops[0]);
+                    if (cond.state == Lattice::State::CONSTANT) {
+                        chains_.erase(arena_, instId);
+                        inst.opcode = Opcode::BR;
+                        inst.targets[0] = inst.targets[cond.bits != 0 ? 0 : 1];
+                        inst.targets[1] = INVALID_ID;
+                        arena_.setOperands(inst, {});
+                        ++stats.branches;
+                    }
+                    continue;
+                }
+                if (inst.result == INVALID_ID || inst.opcode == Opcode::CALL ||
+                    inst.opcode == Opcode::LOAD || inst.opcode == Opcode::ALLOCA) {
+                    continue;
+                }
+                Lattice value = lattice(inst.result);
+                if (value.state != Lattice::State::CONSTANT) continue;
+                ValueId constant = arena_.createConstant(arena_.value(inst.result).getType(), value.bits);
+                chains_.replaceAllUses(arena_, inst.result, constant);
+                chains_.erase(arena_, instId);
+                removed.insert(instId);
+                ++stats.folded;
+            }
+        }
+
+        // PHIs keep only the inputs of edges that can run; one input left
+        // means no merge at all
+        for (uint32_t b = 0; b < func_.blocks.size(); ++b) {
+            if (!executable_[b]) continue;
+            BlockId block = func_.blocks[b];
+            for (InstId instId : arena_.block(block).instructions) {
+                IRInstruction& inst = arena_.instruction(instId);
+                if (inst.opcode != Opcode::PHI) break;
+                if (removed.count(instId)) continue;
+                auto values = arena_.operands(inst);
+                auto from = arena_.incomingBlocks(inst);
+                std::vector<ValueId> keptValues;
+                std::vector<BlockId> keptBlocks;
+                for (size_t i = 0; i < values.size(); ++i) {
+                    if (isExecutable(from[i], block)) {
+                        keptValues.push_back(values[i]);
+                        keptBlocks.push_back(from[i]);
+                    }
+                }
+                bool single = std::all_of(keptValues.begin(), keptValues.end(),
+                                          [&](ValueId v) { return v == keptValues.front(); });
+                if (!keptValues.empty() && single && keptValues.front() != inst.result) {
+                    chains_.erase(arena_, instId);
+                    chains_.replaceAllUses(arena_, inst.result, keptValues.front());
+                    removed.insert(instId);
+                } else if (keptValues.size() != values.size()) {
+                    // The chains still list this PHI under the dropped
+                    // inputs; rewriting those later finds nothing to change
+                    arena_.setIncoming(inst, keptValues, keptBlocks);
+                }
+            }
+        }
+
+        for (uint32_t b = 0; b < func_.blocks.size(); ++b) {
+            if (!executable_[b]) continue;
+            auto& insts = arena_.block(func_.blocks[b]).instructions;
+            std::erase_if(insts, [&](InstId id) { return removed.count(id) != 0; });
+        }
+        size_t before = func_.blocks.size();
+        std::erase_if(func_.blocks, [&](BlockId block) { return !executable_[blockIndex_[block]]; });
+        stats.removedBlocks = before - func_.blocks.size();
+    }
+};
+
+} // namespace
+
+ConstantPropagationStats propagateConstants(IRArena& arena, IRFunction& func) {
+    return Solver(arena, func).run();
+}
+
+} // namespace syclang
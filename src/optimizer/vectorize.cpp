@@ -0,0 +1,634 @@
+#include "syclang/optimizer/vectorize.h"
+#include "syclang/ir/dominators.h"
+#include "syclang/ir/loop_info.h"
+#include "syclang/ir/use_def.h"
+#include "syclang/optimizer/loops.h"
+#include <algorithm>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace syclang {
+
+const char* vectorIsaName(VectorIsa isa) {
+    switch (isa) {
+        case VectorIsa::SSE2: return "sse2";
+        case VectorIsa::AVX2: return "avx2";
+        case VectorIsa::NEON: return "neon";
+        default: return "none";
+    }
+}
+
+size_t vectorRegisterBytes(VectorIsa isa) {
+    switch (isa) {
+        case VectorIsa::SSE2:
+        case VectorIsa::NEON: return 16;
+        case VectorIsa::AVX2: return 32;
+        default: return 0;
+    }
+}
+
+int vectorRegisterCount(VectorIsa isa) {
+    // What the backends hand out: xmm/ymm0-15, and v0-v7 plus v16-v31
+    switch (isa) {
+        case VectorIsa::SSE2:
+        case VectorIsa::AVX2: return 16;
+        case VectorIsa::NEON: return 24;
+        default: return 0;
+    }
+}
+
+VectorIsa defaultVectorIsa(Architecture arch) {
+    return arch == Architecture::ARM64 ? VectorIsa::NEON : VectorIsa::SSE2;
+}
+
+namespace {
+
+// Wrapping integer operations: their low bits only depend on the low
+// bits of the operands, so they can run at the element width
+bool isLaneOperation(Opcode op) {
+    switch (op) {
+        case Opcode::ADD: case Opcode::SUB: case Opcode::MUL:
+        case Opcode::AND: case Opcode::OR: case Opcode::XOR:
+        case Opcode::SHL: case Opcode::SHR:
+        case Opcode::NEG: case Opcode::BIT_NOT:
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool isComparison(Opcode op) {
+    return op >= Opcode::EQ && op <= Opcode::GE;
+}
+
+// Whether the backends lower `op` on lanes of `lane` bytes. x64 has no
+// byte multiply or shift and SSE2 no 32-bit multiply (pmulld is SSE4.1);
+// neither has a 64-bit lane multiply.
+bool isLowered(VectorIsa isa, Opcode op, size_t lane) {
+    switch (op) {
+        case Opcode::MUL:
+            if (isa == VectorIsa::NEON) return lane <= 4;
+            return lane == 2 || (isa == VectorIsa::AVX2 && lane == 4);
+        case Opcode::SHL:
+        case Opcode::SHR:
+            return isa == VectorIsa::NEON || lane >= 2;
+        default:
+            return true;
+    }
+}
+
+// Cycles of the code emitted for one vector instruction
+double vectorLatency(VectorIsa isa, Opcode op) {
+    switch (op) {
+        case Opcode::MUL: return 5;
+        case Opcode::SPLAT: return isa == VectorIsa::NEON ? 1 : 3;
+        case Opcode::NEG:
+        case Opcode::BIT_NOT: return isa == VectorIsa::NEON ? 1 : 2;
+        default: return instructionLatency(op);
+    }
+}
+
+bool isUnsignedLoad(IRType type) {
+    return type == IRType::U8 || type == IRType::U16 || type == IRType::U32 || type == IRType::BOOL;
+}
+
+// Most vector values live at once in a block, counted the way the
+// backends assign registers (CodeGenerator::assignVectorRegisters)
+int vectorPressure(const IRArena& arena, const IRBasicBlock& block) {
+    std::unordered_map<ValueId, size_t> lastRead;
+    const auto& insts = block.instructions;
+    for (size_t i = 0; i < insts.size(); ++i) {
+        for (ValueId op : arena.operands(arena.instruction(insts[i]))) {
+            if (isVectorType(arena.value(op).getType())) lastRead[op] = i;
+        }
+    }
+    int live = 0;
+    int peak = 0;
+    for (size_t i = 0; i < insts.size(); ++i) {
+        const IRInstruction& inst = arena.instruction(insts[i]);
+        if (inst.result != INVALID_ID && isVectorType(arena.value(inst.result).getType())) {
+            peak = std::max(peak, live + 1);
+            live += lastRead.count(inst.result) != 0;
+        }
+        for (ValueId op : arena.operands(inst)) {
+            auto read = lastRead.find(op);
+            if (read != lastRead.end() && read->second == i) {
+                --live;
+                lastRead.erase(read);
+            }
+        }
+    }
+    return peak;
+}
+
+// A loop that passed the legality checks
+struct CountedLoop {
+    ValueId iv = INVALID_ID;
+    ValueId init = INVALID_ID;
+    ValueId bound = INVALID_ID;
+    Opcode test = Opcode::LT;     // Continue while test(iv, bound): LT or LE
+    InstId increment = INVALID_ID;
+    std::vector<BlockId> chain;   // Body blocks in execution order
+    IRType element = IRType::VOID;
+    std::vector<ValueId> storedBases;
+    std::vector<ValueId> loadedBases;
+};
+
+class LoopVectorizer {
+public:
+    LoopVectorizer(IRArena& arena, IRFunction& func, VectorIsa isa)
+        : arena_(arena), func_(func), isa_(isa) {}
+
+    std::vector<LoopVectorization> run() {
+        std::vector<LoopVectorization> results;
+        if (func_.blocks.empty() || vectorRegisterBytes(isa_) == 0) return results;
+        DominatorTree dom(arena_, func_);
+        std::vector<LoopInfo::Loop> loops = LoopInfo(func_, dom).loops();
+        std::vector<bool> innermost(loops.size(), true);
+        for (const auto& loop : loops) {
+            if (loop.parent >= 0) innermost[loop.parent] = false;
+        }
+        for (size_t l = 0; l < loops.size(); ++l) {
+            if (!innermost[l]) continue;
+            // Vectorizing a loop only adds blocks and retargets its own
+            // preheader, so the other loops stay as found
+            chains_.emplace(arena_, func_);
+            results.push_back(vectorize(loops[l]));
+        }
+        return results;
+    }
+
+private:
+    IRArena& arena_;
+    IRFunction& func_;
+    VectorIsa isa_;
+    std::optional<UseDefChains> chains_;
+    std::unordered_set<ValueId> lanes_;   // Scalar values that become vectors
+    std::unordered_set<ValueId> uniform_; // Values defined in the loop from invariants only
+    std::unordered_set<ValueId> zeroExtended_; // Lane values known to have clear upper bits
+
+    bool isInvariant(const LoopInfo::Loop& loop, ValueId value) const {
+        if (arena_.value(value).isConstant()) return true;
+        InstId def = chains_->definition(value);
+        if (def == INVALID_ID) {
+            return std::find(func_.arguments.begin(), func_.arguments.end(), value) !=
+                   func_.arguments.end();
+        }
+        return arena_.instruction(def).opcode != Opcode::ALLOCA && !loop.contains(chains_->blockOf(def));
+    }
+
+    bool isUniform(const LoopInfo::Loop& loop, ValueId value) const {
+        return uniform_.count(value) != 0 || isInvariant(loop, value);
+    }
+
+    LoopVectorization vectorize(const LoopInfo::Loop& loop) {
+        LoopVectorization result;
+        result.header = loop.header;
+        lanes_.clear();
+        uniform_.clear();
+        zeroExtended_.clear();
+
+        CountedLoop counted;
+        result.reason = analyze(loop, counted);
+        if (*result.reason) return result;
+
+        size_t lane = getTypeSize(counted.element);
+        result.lanes = static_cast<unsigned>(vectorRegisterBytes(isa_) / lane);
+        const IRValue& init = arena_.value(counted.init);
+        const IRValue& bound = arena_.value(counted.bound);
+        if (init.isConstant() && bound.isConstant()) {
+            int64_t trips = bound.value_.intValue - init.value_.intValue +
+                            (counted.test == Opcode::LE ? 1 : 0);
+            if (trips < static_cast<int64_t>(result.lanes)) {
+                result.reason = "too few iterations";
+                return result;
+            }
+        }
+
+        for (BlockId block : loop.blocks) {
+            for (InstId instId : arena_.block(block).instructions) {
+                result.scalarCycles += instructionLatency(arena_.instruction(instId).opcode);
+            }
+        }
+
+        // Built detached and only linked in when it pays off
+        const std::string& name = arena_.block(loop.header).name;
+        BlockId vecHeader = arena_.createBlock(name + ".vec");
+        BlockId vecBody = arena_.createBlock(name + ".vbody");
+        IRType indexType = arena_.value(counted.iv).getType();
+        ValueId vi = arena_.createVariable(indexType, arena_.value(counted.iv).name + ".vec");
+        ValueId next = buildBody(counted, vecBody, vi, result.lanes);
+
+        if (vectorPressure(arena_, arena_.block(vecBody)) > vectorRegisterCount(isa_)) {
+            result.reason = "too many live vectors";
+            return result;
+        }
+        double cycles = 3; // Header: lane-limit add, compare and branch
+        for (InstId instId : arena_.block(vecBody).instructions) {
+            const IRInstruction& inst = arena_.instruction(instId);
+            bool vector = inst.result != INVALID_ID && isVectorType(arena_.value(inst.result).getType());
+            cycles += vector ? vectorLatency(isa_, inst.opcode) : instructionLatency(inst.opcode);
+        }
+        result.vectorCycles = cycles / result.lanes;
+        if (result.vectorCycles >= result.scalarCycles) {
+            result.reason = "not profitable";
+            return result;
+        }
+
+        bool checked = link(loop, counted, vecHeader, vecBody, vi, next, result.lanes);
+        result.vectorHeader = vecHeader;
+        result.reason = checked ? "vectorized with alias check" : "vectorized";
+        return result;
+    }
+
+    // Empty when the loop can be vectorized, else why not
+    const char* analyze(const LoopInfo::Loop& loop, CountedLoop& counted) {
+        if (loop.preheader == INVALID_ID) return "no preheader";
+        if (loop.latches.size() != 1 || loop.exits.size() != 1) return "not a counted loop";
+
+        // Header: i = phi, test of i against an invariant, branch
+        const auto& header = arena_.block(loop.header).instructions;
+        if (header.size() > 1 && arena_.instruction(header[1]).opcode == Opcode::PHI) {
+            return "value carried between iterations";
+        }
+        if (header.size() != 3) return "not a counted loop";
+        const IRInstruction& phi = arena_.instruction(header[0]);
+        const IRInstruction& compare = arena_.instruction(header[1]);
+        const IRInstruction& branch = arena_.instruction(header[2]);
+        if (phi.opcode != Opcode::PHI || !isComparison(compare.opcode) ||
+            branch.opcode != Opcode::CONDBR || arena_.operands(branch).size() != 1 ||
+            arena_.operands(branch)[0] != compare.result || !loop.contains(branch.targets[0]) ||
+            loop.contains(branch.targets[1])) {
+            return "not a counted loop";
+        }
+        auto values = arena_.operands(phi);
+        auto from = arena_.incomingBlocks(phi);
+        if (values.size() != 2) return "not a counted loop";
+        size_t back = from[0] == loop.latches[0] ? 0 : 1;
+        if (from[back] != loop.latches[0] || from[1 - back] != loop.preheader) {
+            return "not a counted loop";
+        }
+        counted.iv = phi.result;
+        counted.init = values[1 - back];
+
+        auto ops = arena_.operands(compare);
+        if (ops.size() != 2) return "not a counted loop";
+        Opcode test = compare.opcode;
+        ValueId bound = INVALID_ID;
+        if (ops[0] == counted.iv && (test == Opcode::LT || test == Opcode::LE)) {
+            bound = ops[1];
+        } else if (ops[1] == counted.iv && (test == Opcode::GT || test == Opcode::GE)) {
+            bound = ops[0];
+            test = test == Opcode::GT ? Opcode::LT : Opcode::LE;
+        }
+        if (bound == INVALID_ID || bound == counted.iv || !isInvariant(loop, bound)) {
+            return "not a counted loop";
+        }
+        counted.bound = bound;
+        counted.test = test;
+
+        // i + 1 on the way round, read by nothing but the PHI
+        counted.increment = chains_->definition(values[back]);
+        if (counted.increment == INVALID_ID || !loop.contains(chains_->blockOf(counted.increment))) {
+            return "not a counted loop";
+        }
+        const IRInstruction& increment = arena_.instruction(counted.increment);
+        auto step = arena_.operands(increment);
+        if (increment.opcode != Opcode::ADD || step.size() != 2) return "not a counted loop";
+        ValueId one = step[0] == counted.iv ? step[1] : step[1] == counted.iv ? step[0] : INVALID_ID;
+        if (one == INVALID_ID || !arena_.value(one).isConstant() || arena_.value(one).value_.intValue != 1 ||
+            chains_->users(increment.result).size() != 1) {
+            return "not a counted loop";
+        }
+
+        // Body: header -> b1 -> ... -> latch -> header
+        BlockId block = branch.targets[0];
+        while (block != loop.header) {
+            if (std::find(counted.chain.begin(), counted.chain.end(), block) != counted.chain.end()) {
+                return "body is not a straight chain";
+            }
+            const auto& insts = arena_.block(block).instructions;
+            if (insts.empty() || arena_.instruction(insts.back()).opcode != Opcode::BR) {
+                return "body is not a straight chain";
+            }
+            counted.chain.push_back(block);
+            block = arena_.instruction(insts.back()).targets[0];
+        }
+        if (counted.chain.size() + 1 != loop.blocks.size() || counted.chain.back() != loop.latches[0]) {
+            return "body is not a straight chain";
+        }
+
+        for (BlockId b : counted.chain) {
+            const auto& insts = arena_.block(b).instructions;
+            for (size_t i = 0; i + 1 < insts.size(); ++i) {
+                if (insts[i] == counted.increment) continue;
+                if (const char* reason = classify(loop, counted, arena_.instruction(insts[i]))) {
+                    return reason;
+                }
+            }
+        }
+        if (counted.storedBases.empty()) return "no stores";
+
+        // i may only index memory besides being tested and stepped
+        for (InstId user : chains_->users(counted.iv)) {
+            if (user == header[1] || user == counted.increment) continue;
+            const IRInstruction& inst = arena_.instruction(user);
+            auto args = arena_.operands(inst);
+            bool indexes = (inst.opcode == Opcode::LOAD && args.size() == 2 && args[0] != counted.iv) ||
+                           (inst.opcode == Opcode::STORE && args.size() == 3 && args[0] != counted.iv &&
+                            args[1] != counted.iv);
+            if (!indexes && loop.contains(chains_->blockOf(user))) {
+                return "induction variable used as a value";
+            }
+        }
+        return "";
+    }
+
+    // Sort one body instruction into lanes_ or uniform_; a reason if it
+    // cannot be vectorized
+    const char* classify(const LoopInfo::Loop& loop, CountedLoop& counted, const IRInstruction& inst) {
+        auto ops = arena_.operands(inst);
+        auto element = [&](IRType type) -> const char* {
+            if (type == IRType::F64 || getTypeSize(type) == 0) return "unsupported element type";
+            if (counted.element == IRType::VOID) {
+                counted.element = type;
+            } else if (getTypeSize(type) != getTypeSize(counted.element) ||
+                       (type == IRType::F32) != (counted.element == IRType::F32)) {
+                return "mixed element types";
+            }
+            return nullptr;
+        };
+        auto laneOrUniform = [&](ValueId value) {
+            return lanes_.count(value) != 0 || isUniform(loop, value);
+        };
+
+        switch (inst.opcode) {
+            case Opcode::LOAD: {
+                if (ops.size() != 2 || ops[1] != counted.iv) return "non-unit-stride access";
+                if (!isInvariant(loop, ops[0])) return "variant base pointer";
+                IRType type = arena_.value(inst.result).getType();
+                if (const char* reason = element(type)) return reason;
+                lanes_.insert(inst.result);
+                if (isUnsignedLoad(type)) zeroExtended_.insert(inst.result);
+                counted.loadedBases.push_back(ops[0]);
+                return nullptr;
+            }
+            case Opcode::STORE: {
+                if (ops.size() != 3) return "stores to a scalar variable";
+                if (ops[2] != counted.iv) return "non-unit-stride access";
+                if (!isInvariant(loop, ops[1])) return "variant base pointer";
+                if (!laneOrUniform(ops[0])) return "unsupported instruction";
+                if (const char* reason = element(arena_.value(ops[0]).getType())) return reason;
+                counted.storedBases.push_back(ops[1]);
+                return nullptr;
+            }
+            case Opcode::TRUNC: {
+                if (ops.size() != 1) return "unsupported instruction";
+                if (isUniform(loop, ops[0])) {
+                    uniform_.insert(inst.result);
+                    return nullptr;
+                }
+                if (!lanes_.count(ops[0])) return "unsupported instruction";
+                if (const char* reason = element(arena_.value(inst.result).getType())) return reason;
+                lanes_.insert(inst.result);
+                return nullptr;
+            }
+            default:
+                break;
+        }
+
+        if (inst.result == INVALID_ID || ops.empty() || ops.size() > 2) return "unsupported instruction";
+        bool anyLane = std::any_of(ops.begin(), ops.end(), [&](ValueId v) { return lanes_.count(v) != 0; });
+        if (!anyLane) {
+            // Scalar work on invariants is repeated in the vector body
+            bool pure = (inst.opcode <= Opcode::GE && inst.opcode != Opcode::DIV && inst.opcode != Opcode::MOD) ||
+                        (inst.opcode >= Opcode::TRUNC && inst.opcode <= Opcode::BITCAST);
+            if (!pure || !std::all_of(ops.begin(), ops.end(), [&](ValueId v) { return isUniform(loop, v); })) {
+                return "unsupported instruction";
+            }
+            uniform_.insert(inst.result);
+            return nullptr;
+        }
+        if (!isLaneOperation(inst.opcode) || !std::all_of(ops.begin(), ops.end(), laneOrUniform)) {
+            return "unsupported instruction";
+        }
+        // Loaded floats are only moved and masked, never computed on
+        if (counted.element == IRType::F32 && inst.opcode != Opcode::AND && inst.opcode != Opcode::OR &&
+            inst.opcode != Opcode::XOR && inst.opcode != Opcode::BIT_NOT) {
+            return "floating-point arithmetic";
+        }
+        size_t lane = getTypeSize(counted.element);
+        if (!isLowered(isa_, inst.opcode, lane)) return "operation has no vector form";
+        if (inst.opcode == Opcode::SHL || inst.opcode == Opcode::SHR) {
+            // Immediate counts within the lane. A logical right shift of a
+            // wider value only matches when the bits above the lane are clear.
+            const IRValue& count = arena_.value(ops[1]);
+            if (!lanes_.count(ops[0]) || !count.isConstant() || count.value_.uintValue >= lane * 8) {
+                return "variable shift";
+            }
+            if (inst.opcode == Opcode::SHR && lane < 8 && !zeroExtended_.count(ops[0])) {
+                return "right shift of a wrapped value";
+            }
+        }
+        lanes_.insert(inst.result);
+        return nullptr;
+    }
+
+    // Pairs of distinct bases that must be far enough apart, stored first
+    std::vector<std::pair<ValueId, ValueId>> aliasPairs(const CountedLoop& counted) const {
+        std::vector<ValueId> stored = counted.storedBases;
+        std::sort(stored.begin(), stored.end());
+        stored.erase(std::unique(stored.begin(), stored.end()), stored.end());
+        std::vector<ValueId> all = stored;
+        all.insert(all.end(), counted.loadedBases.begin(), counted.loadedBases.end());
+        std::sort(all.begin(), all.end());
+        all.erase(std::unique(all.begin(), all.end()), all.end());
+
+        std::vector<std::pair<ValueId, ValueId>> pairs;
+        for (ValueId s : stored) {
+            for (ValueId b : all) {
+                bool seen = std::binary_search(stored.begin(), stored.end(), b) && b < s;
+                if (b != s && !seen) pairs.push_back({s, b});
+            }
+        }
+        return pairs;
+    }
+
+    // The loop body with lane values replaced by vectors indexed by vi;
+    // returns vi + lanes
+    ValueId buildBody(const CountedLoop& counted, BlockId target, ValueId vi, unsigned lanes) {
+        IRType vectorTy = vectorType(counted.element, vectorRegisterBytes(isa_));
+        std::unordered_map<ValueId, ValueId> map;   // Lane values and uniform copies
+        std::unordered_map<ValueId, ValueId> splats;
+        auto& insts = arena_.block(target).instructions;
+        auto mapped = [&](ValueId value) {
+            auto it = map.find(value);
+            return it == map.end() ? value : it->second;
+        };
+        // Vectors never leave their block, so invariants are splat here
+        auto vectorOf = [&](ValueId value) {
+            if (lanes_.count(value)) return map.at(value);
+            auto it = splats.find(value);
+            if (it != splats.end()) return it->second;
+            ValueId splat = arena_.createVariable(vectorTy, arena_.value(value).isConstant()
+                                                                ? "splat"
+                                                                : arena_.value(value).name + ".splat");
+            insts.push_back(arena_.createInstruction(Opcode::SPLAT, {mapped(value)}, splat));
+            splats[value] = splat;
+            return splat;
+        };
+
+        for (BlockId block : counted.chain) {
+            const auto body = arena_.block(block).instructions;
+            for (size_t i = 0; i + 1 < body.size(); ++i) {
+                if (body[i] == counted.increment) continue;
+                const IRInstruction& inst = arena_.instruction(body[i]);
+                std::vector<ValueId> ops(arena_.operands(inst).begin(), arena_.operands(inst).end());
+                if (inst.opcode == Opcode::STORE) {
+                    ValueId value = vectorOf(ops[0]);
+                    insts.push_back(arena_.createInstruction(Opcode::STORE, {value, ops[1], vi}));
+                    continue;
+                }
+                if (uniform_.count(inst.result)) {
+                    for (ValueId& op : ops) op = mapped(op);
+                    const IRValue& original = arena_.value(inst.result);
+                    ValueId copy = arena_.createVariable(original.getType(), original.name + ".vec");
+                    insts.push_back(arena_.createInstruction(inst.opcode, ops, copy));
+                    map[inst.result] = copy;
+                    continue;
+                }
+                if (inst.opcode == Opcode::TRUNC) {
+                    // Lanes already have the element width
+                    map[inst.result] = map.at(ops[0]);
+                    continue;
+                }
+                ValueId result = arena_.createVariable(vectorTy, arena_.value(inst.result).name + ".v");
+                if (inst.opcode == Opcode::LOAD) {
+                    ops[1] = vi;
+                } else if (inst.opcode == Opcode::SHL || inst.opcode == Opcode::SHR) {
+                    ops[0] = vectorOf(ops[0]);
+                } else {
+                    for (ValueId& op : ops) op = vectorOf(op);
+                }
+                insts.push_back(arena_.createInstruction(inst.opcode, ops, result));
+                map[inst.result] = result;
+            }
+        }
+
+        IRType indexType = arena_.value(vi).getType();
+        ValueId next = arena_.createVariable(indexType, arena_.value(vi).name + ".next");
+        insts.push_back(arena_.createInstruction(Opcode::ADD, {vi, arena_.createConstant(indexType, lanes)}, next));
+        insts.push_back(arena_.createInstruction(Opcode::BR)); // Target set by link()
+        return next;
+    }
+
+    // Put the vector loop between the preheader and the original header;
+    // true if it is guarded by an overlap test
+    bool link(const LoopInfo::Loop& loop, const CountedLoop& counted, BlockId vecHeader,
+              BlockId vecBody, ValueId vi, ValueId next, unsigned lanes) {
+        const std::string& name = arena_.block(loop.header).name;
+        IRType indexType = arena_.value(counted.iv).getType();
+        BlockId vecExit = arena_.createBlock(name + ".vexit");
+        std::vector<BlockId> added;
+
+        // Overlap test: distinct bases at least one vector apart
+        BlockId entry = vecHeader;
+        auto pairs = aliasPairs(counted);
+        BlockId check = INVALID_ID;
+        if (!pairs.empty()) {
+            check = arena_.createBlock(name + ".vcheck");
+            auto& insts = arena_.block(check).instructions;
+            int64_t width = static_cast<int64_t>(vectorRegisterBytes(isa_));
+            ValueId safe = INVALID_ID;
+            for (size_t p = 0; p < pairs.size(); ++p) {
+                // |stored - other| >= one vector
+                std::string prefix = "vdist" + std::to_string(p);
+                ValueId distance = arena_.createVariable(IRType::I64, prefix);
+                ValueId above = arena_.createVariable(IRType::BOOL, prefix + ".above");
+                ValueId below = arena_.createVariable(IRType::BOOL, prefix + ".below");
+                ValueId apart = arena_.createVariable(IRType::BOOL, prefix + ".apart");
+                insts.push_back(arena_.createInstruction(Opcode::SUB, {pairs[p].first, pairs[p].second},
+                                                         distance));
+                insts.push_back(arena_.createInstruction(Opcode::GE, {distance, arena_.createI64(width)}, above));
+                insts.push_back(arena_.createInstruction(Opcode::LE, {distance, arena_.createI64(-width)}, below));
+                insts.push_back(arena_.createInstruction(Opcode::OR, {above, below}, apart));
+                if (safe != INVALID_ID) {
+                    ValueId both = arena_.createVariable(IRType::BOOL, prefix + ".all");
+                    insts.push_back(arena_.createInstruction(Opcode::AND, {safe, apart}, both));
+                    apart = both;
+                }
+                safe = apart;
+            }
+            InstId branch = arena_.createInstruction(Opcode::CONDBR, {safe});
+            arena_.instruction(branch).targets[0] = vecHeader;
+            arena_.instruction(branch).targets[1] = vecExit;
+            insts.push_back(branch);
+            entry = check;
+            added.push_back(check);
+        }
+        BlockId enter = check != INVALID_ID ? check : loop.preheader;
+
+        // vi = phi; if (vi + lanes - 1 < n) vbody else vexit
+        InstId phi = arena_.createInstruction(Opcode::PHI, {}, vi);
+        ValueId incoming[2] = {counted.init, next};
+        BlockId blocks[2] = {enter, vecBody};
+        arena_.setIncoming(arena_.instruction(phi), incoming, blocks);
+        ValueId last = arena_.createVariable(indexType, arena_.value(vi).name + ".last");
+        ValueId inRange = arena_.createVariable(IRType::BOOL, arena_.value(vi).name + ".test");
+        auto& header = arena_.block(vecHeader).instructions;
+        header.push_back(phi);
+        header.push_back(arena_.createInstruction(
+            Opcode::ADD, {vi, arena_.createConstant(indexType, lanes - 1)}, last));
+        header.push_back(arena_.createInstruction(counted.test, {last, counted.bound}, inRange));
+        InstId test = arena_.createInstruction(Opcode::CONDBR, {inRange});
+        arena_.instruction(test).targets[0] = vecBody;
+        arena_.instruction(test).targets[1] = vecExit;
+        header.push_back(test);
+        arena_.instruction(arena_.block(vecBody).instructions.back()).targets[0] = vecHeader;
+        added.push_back(vecHeader);
+        added.push_back(vecBody);
+
+        // The scalar loop resumes where the vector one stopped
+        ValueId resume = vi;
+        auto& exit = arena_.block(vecExit).instructions;
+        if (check != INVALID_ID) {
+            resume = arena_.createVariable(indexType, arena_.value(counted.iv).name + ".resume");
+            InstId merge = arena_.createInstruction(Opcode::PHI, {}, resume);
+            ValueId starts[2] = {counted.init, vi};
+            BlockId preds[2] = {check, vecHeader};
+            arena_.setIncoming(arena_.instruction(merge), starts, preds);
+            exit.push_back(merge);
+        }
+        InstId toScalar = arena_.createInstruction(Opcode::BR);
+        arena_.instruction(toScalar).targets[0] = loop.header;
+        exit.push_back(toScalar);
+        added.push_back(vecExit);
+
+        IRInstruction& scalarPhi = arena_.instruction(arena_.block(loop.header).instructions.front());
+        std::vector<ValueId> values(arena_.operands(scalarPhi).begin(), arena_.operands(scalarPhi).end());
+        std::vector<BlockId> from(arena_.incomingBlocks(scalarPhi).begin(),
+                                  arena_.incomingBlocks(scalarPhi).end());
+        for (size_t i = 0; i < from.size(); ++i) {
+            if (from[i] == loop.preheader) {
+                from[i] = vecExit;
+                values[i] = resume;
+            }
+        }
+        arena_.setIncoming(scalarPhi, values, from);
+
+        IRInstruction& enterBranch = arena_.instruction(arena_.block(loop.preheader).instructions.back());
+        enterBranch.targets[0] = entry;
+        auto at = std::find(func_.blocks.begin(), func_.blocks.end(), loop.header);
+        func_.blocks.insert(at, added.begin(), added.end());
+        return check != INVALID_ID;
+    }
+};
+
+} // namespace
+
+std::vector<LoopVectorization> vectorizeLoops(IRArena& arena, IRFunction& func, VectorIsa isa) {
+    return LoopVectorizer(arena, func, isa).run();
+}
+
+} // namespace syclang
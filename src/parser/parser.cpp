@@ -1,27 +1,43 @@
 #include "syclang/parser/parser.h"
+#include "syclang/trace.h"
 #include <iostream>
 
 namespace syclang {
 
-Parser::Parser(const std::vector<Token>& tokens)
+Parser::Parser(const TokenStream& tokens)
     : tokens_(tokens), position_(0) {}
 
-Token Parser::current() const {
+TokenType Parser::current() const {
     if (position_ < tokens_.size()) {
-        return tokens_[position_];
+        return tokens_.type(position_);
     }
-    return Token(TokenType::EOF_TOKEN, "", 0, 0);
+    return TokenType::EOF_TOKEN;
 }
 
-Token Parser::peek(size_t offset) const {
+TokenType Parser::peek(size_t offset) const {
     if (position_ + offset < tokens_.size()) {
-        return tokens_[position_ + offset];
+        return tokens_.type(position_ + offset);
     }
-    return Token(TokenType::EOF_TOKEN, "", 0, 0);
+    return TokenType::EOF_TOKEN;
+}
+
+std::string_view Parser::currentValue() const {
+    if (position_ < tokens_.size()) {
+        return tokens_.value(position_);
+    }
+    return std::string_view();
+}
+
+std::string_view Parser::previousValue() const {
+    return tokens_.value(position_ - 1);
+}
+
+bool Parser::check(TokenType type) const {
+    return current() == type;
 }
 
 bool Parser::advance() {
-    if (!current().is(TokenType::EOF_TOKEN)) {
+    if (!check(TokenType::EOF_TOKEN)) {
         position_++;
         return true;
     }
@@ -29,7 +45,7 @@ bool Parser::advance() {
 }
 
 bool Parser::match(TokenType type) {
-    if (current().is(type)) {
+    if (check(type)) {
         advance();
         return true;
     }
@@ -45,17 +61,18 @@ bool Parser::consume(TokenType type, const std::string& message) {
 }
 
 void Parser::error(const std::string& message) {
-    Token token = current();
-    std::string error_msg = "Error at line " + std::to_string(token.line()) + 
-                           ", column " + std::to_string(token.column()) + 
+    size_t index = position_ < tokens_.size() ? position_ : tokens_.size() - 1;
+    std::string error_msg = "Error at line " + std::to_string(tokens_.line(index)) + 
+                           ", column " + std::to_string(tokens_.column(index)) + 
                            ": " + message;
     errors_.push_back(error_msg);
 }
 
 std::shared_ptr<Program> Parser::parse() {
+    TraceScope trace("parse", "frontend");
     auto program = std::make_shared<Program>();
     
-    while (!current().is(TokenType::EOF_TOKEN)) {
+    while (!check(TokenType::EOF_TOKEN)) {
         auto decl = parseDeclaration();
         if (decl) {
             program->declarations.push_back(decl);
@@ -66,10 +83,27 @@ std::shared_ptr<Program> Parser::parse() {
 }
 
 std::shared_ptr<Declaration> Parser::parseDeclaration() {
-    Token token = current();
+    // Attributes: #[name, name] ...
+    std::vector<std::string> attributes;
+    while (match(TokenType::AT_SIGN)) {
+        consume(TokenType::LBRACKET, "Expected '[' after '#'");
+        do {
+            std::string_view name = currentValue();
+            if (!consume(TokenType::IDENTIFIER, "Expected attribute name")) break;
+            attributes.push_back(std::string(name));
+        } while (match(TokenType::COMMA));
+        consume(TokenType::RBRACKET, "Expected ']'");
+    }
     
     if (match(TokenType::KW_FN)) {
-        return parseFunctionDecl();
+        auto func = parseFunctionDecl();
+        if (func) {
+            func->attributes = std::move(attributes);
+        }
+        return func;
+    }
+    if (!attributes.empty()) {
+        error("Attributes only apply to functions");
     }
     
     if (match(TokenType::KW_STRUCT)) {
@@ -89,11 +123,11 @@ std::shared_ptr<FunctionDecl> Parser::parseFunctionDecl() {
     auto func = std::make_shared<FunctionDecl>();
     
     // Function name
-    Token nameToken = current();
+    std::string_view name = currentValue();
     if (!consume(TokenType::IDENTIFIER, "Expected function name")) {
         return nullptr;
     }
-    func->name = nameToken.value();
+    func->name = name;
     
     // Parameters
     if (!consume(TokenType::LPAREN, "Expected '('")) {
@@ -101,36 +135,39 @@ std::shared_ptr<FunctionDecl> Parser::parseFunctionDecl() {
     }
     
     while (!match(TokenType::RPAREN)) {
-        Token paramName = current();
+        std::string_view paramName = currentValue();
         if (!consume(TokenType::IDENTIFIER, "Expected parameter name")) {
             // Skip to next comma or closing parenthesis
-            while (!current().is(TokenType::COMMA) &&
-                   !current().is(TokenType::RPAREN) &&
-                   !current().is(TokenType::EOF_TOKEN)) {
+            while (!check(TokenType::COMMA) &&
+                   !check(TokenType::RPAREN) &&
+                   !check(TokenType::EOF_TOKEN)) {
                 advance();
             }
             if (match(TokenType::COMMA)) {
                 continue;
             }
+            match(TokenType::RPAREN);
             break;
         }
         if (!consume(TokenType::COLON, "Expected ':'")) {
             // Skip to next comma or closing parenthesis
-            while (!current().is(TokenType::COMMA) &&
-                   !current().is(TokenType::RPAREN) &&
-                   !current().is(TokenType::EOF_TOKEN)) {
+            while (!check(TokenType::COMMA) &&
+                   !check(TokenType::RPAREN) &&
+                   !check(TokenType::EOF_TOKEN)) {
                 advance();
             }
             if (match(TokenType::COMMA)) {
                 continue;
             }
+            match(TokenType::RPAREN);
             break;
         }
         auto paramType = parseType();
         
-        func->params.push_back({paramName.value(), paramType});
+        func->params.push_back({std::string(paramName), paramType});
         
         if (!match(TokenType::COMMA)) {
+            consume(TokenType::RPAREN, "Expected ')'");
             break;
         }
     }
@@ -138,9 +175,9 @@ std::shared_ptr<FunctionDecl> Parser::parseFunctionDecl() {
     // Return type
     if (!consume(TokenType::ARROW, "Expected '->'")) {
         // Try to parse anyway, but skip return type parsing
-        while (!current().is(TokenType::LBRACE) &&
-               !current().is(TokenType::KW_EXTERN) &&
-               !current().is(TokenType::EOF_TOKEN)) {
+        while (!check(TokenType::LBRACE) &&
+               !check(TokenType::KW_EXTERN) &&
+               !check(TokenType::EOF_TOKEN)) {
             advance();
         }
     } else {
@@ -160,19 +197,19 @@ std::shared_ptr<FunctionDecl> Parser::parseFunctionDecl() {
 std::shared_ptr<StructDecl> Parser::parseStructDecl() {
     auto structDecl = std::make_shared<StructDecl>();
     
-    Token nameToken = current();
+    std::string_view name = currentValue();
     consume(TokenType::IDENTIFIER, "Expected struct name");
-    structDecl->name = nameToken.value();
+    structDecl->name = name;
     
     consume(TokenType::LBRACE, "Expected '{'");
     
-    while (!match(TokenType::RBRACE)) {
-        Token fieldName = current();
+    while (!match(TokenType::RBRACE) && !check(TokenType::EOF_TOKEN)) {
+        std::string_view fieldName = currentValue();
         consume(TokenType::IDENTIFIER, "Expected field name");
         consume(TokenType::COLON, "Expected ':'");
         auto fieldType = parseType();
         
-        structDecl->fields.push_back({fieldName.value(), fieldType});
+        structDecl->fields.push_back({std::string(fieldName), fieldType});
         consume(TokenType::SEMICOLON, "Expected ';'");
     }
     
@@ -182,24 +219,24 @@ std::shared_ptr<StructDecl> Parser::parseStructDecl() {
 std::shared_ptr<EnumDecl> Parser::parseEnumDecl() {
     auto enumDecl = std::make_shared<EnumDecl>();
     
-    Token nameToken = current();
+    std::string_view name = currentValue();
     consume(TokenType::IDENTIFIER, "Expected enum name");
-    enumDecl->name = nameToken.value();
+    enumDecl->name = name;
     
     consume(TokenType::LBRACE, "Expected '{'");
     
     int64_t value = 0;
-    while (!match(TokenType::RBRACE)) {
-        Token variantName = current();
+    while (!match(TokenType::RBRACE) && !check(TokenType::EOF_TOKEN)) {
+        std::string_view variantName = currentValue();
         consume(TokenType::IDENTIFIER, "Expected variant name");
         
         if (match(TokenType::EQUAL)) {
-            Token valueToken = current();
+            std::string_view valueText = currentValue();
             consume(TokenType::NUMBER, "Expected enum value");
-            value = std::stoll(valueToken.value());
+            value = std::stoll(std::string(valueText));
         }
         
-        enumDecl->values.push_back({variantName.value(), value++});
+        enumDecl->values.push_back({std::string(variantName), value++});
         
         if (!match(TokenType::COMMA)) {
             break;
@@ -210,8 +247,6 @@ std::shared_ptr<EnumDecl> Parser::parseEnumDecl() {
 }
 
 std::shared_ptr<Statement> Parser::parseStatement() {
-    Token token = current();
-    
     if (match(TokenType::KW_LET)) {
         return parseLet();
     }
@@ -232,7 +267,7 @@ std::shared_ptr<Statement> Parser::parseStatement() {
         return parseReturn();
     }
     
-    if (current().is(TokenType::LBRACE)) {
+    if (check(TokenType::LBRACE)) {
         return parseBlock();
     }
     
@@ -241,9 +276,9 @@ std::shared_ptr<Statement> Parser::parseStatement() {
     auto exprStmt = parseExprStmt();
     if (!exprStmt->expr) {
         // If parsing failed, skip to the next semicolon or other delimiter
-        while (!current().is(TokenType::SEMICOLON) &&
-               !current().is(TokenType::RBRACE) &&
-               !current().is(TokenType::EOF_TOKEN)) {
+        while (!check(TokenType::SEMICOLON) &&
+               !check(TokenType::RBRACE) &&
+               !check(TokenType::EOF_TOKEN)) {
             advance();
         }
         if (match(TokenType::SEMICOLON)) {
@@ -258,8 +293,8 @@ std::shared_ptr<BlockStmt> Parser::parseBlock() {
     
     if (!consume(TokenType::LBRACE, "Expected '{'")) {
         // Skip to the next closing brace to avoid infinite loop
-        while (!current().is(TokenType::RBRACE) &&
-               !current().is(TokenType::EOF_TOKEN)) {
+        while (!check(TokenType::RBRACE) &&
+               !check(TokenType::EOF_TOKEN)) {
             advance();
         }
         if (match(TokenType::RBRACE)) {
@@ -268,7 +303,7 @@ std::shared_ptr<BlockStmt> Parser::parseBlock() {
         return nullptr;
     }
     
-    while (!current().is(TokenType::RBRACE) && !current().is(TokenType::EOF_TOKEN)) {
+    while (!check(TokenType::RBRACE) && !check(TokenType::EOF_TOKEN)) {
         auto stmt = parseStatement();
         if (stmt) {
             block->statements.push_back(stmt);
@@ -285,18 +320,18 @@ std::shared_ptr<LetStmt> Parser::parseLet() {
     
     let->isMutable = match(TokenType::KW_MUT);
     
-    Token nameToken = current();
+    std::string_view name = currentValue();
     if (!consume(TokenType::IDENTIFIER, "Expected variable name")) {
         // Skip to next semicolon
-        while (!current().is(TokenType::SEMICOLON) &&
-               !current().is(TokenType::RBRACE) &&
-               !current().is(TokenType::EOF_TOKEN)) {
+        while (!check(TokenType::SEMICOLON) &&
+               !check(TokenType::RBRACE) &&
+               !check(TokenType::EOF_TOKEN)) {
             advance();
         }
         consume(TokenType::SEMICOLON, "Expected ';'");
         return nullptr;
     }
-    let->name = nameToken.value();
+    let->name = name;
     
     if (match(TokenType::COLON)) {
         let->type = parseType();
@@ -318,9 +353,9 @@ std::shared_ptr<ExprStmt> Parser::parseExprStmt() {
         consume(TokenType::SEMICOLON, "Expected ';'");
     } else {
         // Skip to next semicolon or other statement delimiter
-        while (!current().is(TokenType::SEMICOLON) &&
-               !current().is(TokenType::RBRACE) &&
-               !current().is(TokenType::EOF_TOKEN)) {
+        while (!check(TokenType::SEMICOLON) &&
+               !check(TokenType::RBRACE) &&
+               !check(TokenType::EOF_TOKEN)) {
             advance();
         }
         if (match(TokenType::SEMICOLON)) {
@@ -333,7 +368,7 @@ std::shared_ptr<ExprStmt> Parser::parseExprStmt() {
 std::shared_ptr<ReturnStmt> Parser::parseReturn() {
     auto ret = std::make_shared<ReturnStmt>();
     
-    if (!current().is(TokenType::SEMICOLON)) {
+    if (!check(TokenType::SEMICOLON)) {
         ret->expr = parseExpression();
     }
     
@@ -384,7 +419,7 @@ std::shared_ptr<ForStmt> Parser::parseFor() {
         consume(TokenType::SEMICOLON, "Expected ';'");
     }
     
-    if (!current().is(TokenType::RPAREN)) {
+    if (!check(TokenType::RPAREN)) {
         forStmt->update = parseExpression();
     }
     
@@ -401,21 +436,21 @@ std::shared_ptr<Expression> Parser::parseExpression() {
 std::shared_ptr<Expression> Parser::parseAssignment() {
     auto expr = parseLogicalOr();
     
-    if (current().is(TokenType::EQUAL) ||
-        current().is(TokenType::PLUS_EQUAL) ||
-        current().is(TokenType::MINUS_EQUAL) ||
-        current().is(TokenType::STAR_EQUAL) ||
-        current().is(TokenType::SLASH_EQUAL) ||
-        current().is(TokenType::PERCENT_EQUAL)) {
+    if (check(TokenType::EQUAL) ||
+        check(TokenType::PLUS_EQUAL) ||
+        check(TokenType::MINUS_EQUAL) ||
+        check(TokenType::STAR_EQUAL) ||
+        check(TokenType::SLASH_EQUAL) ||
+        check(TokenType::PERCENT_EQUAL)) {
         
-        Token op = current();
+        TokenType op = current();
         advance();
         auto right = parseAssignment();
         
         auto binary = std::make_shared<BinaryExpr>();
         binary->left = expr;
         binary->right = right;
-        binary->op = op.type();
+        binary->op = op;
         return binary;
     }
     
@@ -500,12 +535,14 @@ std::shared_ptr<Expression> Parser::parseBitwiseAnd() {
 std::shared_ptr<Expression> Parser::parseEquality() {
     auto expr = parseComparison();
     
-    while (match(TokenType::EQUAL_EQUAL) || match(TokenType::NOT_EQUAL)) {
+    while (check(TokenType::EQUAL_EQUAL) || check(TokenType::NOT_EQUAL)) {
+        TokenType op = current();
+        advance();
         auto right = parseComparison();
         auto binary = std::make_shared<BinaryExpr>();
         binary->left = expr;
         binary->right = right;
-        binary->op = tokens_[position_ - 1].type();
+        binary->op = op;
         expr = binary;
     }
     
@@ -515,13 +552,15 @@ std::shared_ptr<Expression> Parser::parseEquality() {
 std::shared_ptr<Expression> Parser::parseComparison() {
     auto expr = parseShift();
     
-    while (match(TokenType::LESS) || match(TokenType::LESS_EQUAL) ||
-           match(TokenType::GREATER) || match(TokenType::GREATER_EQUAL)) {
+    while (check(TokenType::LESS) || check(TokenType::LESS_EQUAL) ||
+           check(TokenType::GREATER) || check(TokenType::GREATER_EQUAL)) {
+        TokenType op = current();
+        advance();
         auto right = parseShift();
         auto binary = std::make_shared<BinaryExpr>();
         binary->left = expr;
         binary->right = right;
-        binary->op = tokens_[position_ - 1].type();
+        binary->op = op;
         expr = binary;
     }
     
@@ -531,12 +570,14 @@ std::shared_ptr<Expression> Parser::parseComparison() {
 std::shared_ptr<Expression> Parser::parseShift() {
     auto expr = parseAdditive();
     
-    while (match(TokenType::SHL) || match(TokenType::SHR)) {
+    while (check(TokenType::SHL) || check(TokenType::SHR)) {
+        TokenType op = current();
+        advance();
         auto right = parseAdditive();
         auto binary = std::make_shared<BinaryExpr>();
         binary->left = expr;
         binary->right = right;
-        binary->op = tokens_[position_ - 1].type();
+        binary->op = op;
         expr = binary;
     }
     
@@ -546,12 +587,14 @@ std::shared_ptr<Expression> Parser::parseShift() {
 std::shared_ptr<Expression> Parser::parseAdditive() {
     auto expr = parseMultiplicative();
     
-    while (match(TokenType::PLUS) || match(TokenType::MINUS)) {
+    while (check(TokenType::PLUS) || check(TokenType::MINUS)) {
+        TokenType op = current();
+        advance();
         auto right = parseMultiplicative();
         auto binary = std::make_shared<BinaryExpr>();
         binary->left = expr;
         binary->right = right;
-        binary->op = tokens_[position_ - 1].type();
+        binary->op = op;
         expr = binary;
     }
     
@@ -561,12 +604,14 @@ std::shared_ptr<Expression> Parser::parseAdditive() {
 std::shared_ptr<Expression> Parser::parseMultiplicative() {
     auto expr = parsePrefix();
     
-    while (match(TokenType::STAR) || match(TokenType::SLASH) || match(TokenType::PERCENT)) {
+    while (check(TokenType::STAR) || check(TokenType::SLASH) || check(TokenType::PERCENT)) {
+        TokenType op = current();
+        advance();
         auto right = parsePrefix();
         auto binary = std::make_shared<BinaryExpr>();
         binary->left = expr;
         binary->right = right;
-        binary->op = tokens_[position_ - 1].type();
+        binary->op = op;
         expr = binary;
     }
     
@@ -574,9 +619,10 @@ std::shared_ptr<Expression> Parser::parseMultiplicative() {
 }
 
 std::shared_ptr<Expression> Parser::parsePrefix() {
-    if (match(TokenType::MINUS) || match(TokenType::NOT) || match(TokenType::BIT_NOT)) {
+    if (check(TokenType::MINUS) || check(TokenType::NOT) || check(TokenType::BIT_NOT)) {
         auto unary = std::make_shared<UnaryExpr>();
-        unary->op = tokens_[position_ - 1].type();
+        unary->op = current();
+        advance();
         unary->isPrefix = true;
         unary->operand = parsePrefix();
         return unary;
@@ -597,6 +643,7 @@ std::shared_ptr<Expression> Parser::parsePostfix() {
             while (!match(TokenType::RPAREN)) {
                 call->args.push_back(parseExpression());
                 if (!match(TokenType::COMMA)) {
+                    consume(TokenType::RPAREN, "Expected ')'");
                     break;
                 }
             }
@@ -613,9 +660,9 @@ std::shared_ptr<Expression> Parser::parsePostfix() {
             // Member access
             auto access = std::make_shared<MemberAccessExpr>();
             access->object = expr;
-            Token member = current();
+            std::string_view member = currentValue();
             consume(TokenType::IDENTIFIER, "Expected member name");
-            access->member = member.value();
+            access->member = member;
             expr = access;
         } else {
             break;
@@ -629,14 +676,14 @@ std::shared_ptr<Expression> Parser::parsePrimary() {
     if (match(TokenType::NUMBER)) {
         auto lit = std::make_shared<LiteralExpr>();
         lit->kind = LiteralExpr::Kind::INT;
-        lit->value = tokens_[position_ - 1].value();
+        lit->value = previousValue();
         return lit;
     }
     
     if (match(TokenType::STRING)) {
         auto lit = std::make_shared<LiteralExpr>();
         lit->kind = LiteralExpr::Kind::STRING;
-        lit->value = tokens_[position_ - 1].value();
+        lit->value = previousValue();
         return lit;
     }
     
@@ -656,7 +703,7 @@ std::shared_ptr<Expression> Parser::parsePrimary() {
     
     if (match(TokenType::IDENTIFIER)) {
         auto ident = std::make_shared<IdentifierExpr>();
-        ident->name = tokens_[position_ - 1].value();
+        ident->name = previousValue();
         return ident;
     }
     
@@ -673,9 +720,9 @@ std::shared_ptr<Expression> Parser::parsePrimary() {
 
 std::shared_ptr<Type> Parser::parseType() {
     auto type = std::make_shared<Type>();
-    Token token = current();
+    std::string_view name = currentValue();
     
-    switch (token.type()) {
+    switch (current()) {
         case TokenType::TYPE_I8:
             advance();
             type->category = TypeCategory::I8;
@@ -726,7 +773,7 @@ std::shared_ptr<Type> Parser::parseType() {
             break;
         case TokenType::IDENTIFIER:
             advance();
-            type->name = token.value();
+            type->name = name;
             type->category = TypeCategory::STRUCT; // Assume struct for now
             break;
         default:
@@ -0,0 +1,207 @@
+#include "syclang/thread_pool.h"
+#include <algorithm>
+#include <chrono>
+
+namespace syclang {
+
+namespace {
+
+// Worker identity of the current thread, used to route nested submissions
+thread_local const ThreadPool* t_pool = nullptr;
+thread_local unsigned t_queueIndex = 0;
+
+} // namespace
+
+ThreadPool::ThreadPool(unsigned concurrency)
+    : pending_(0), nextQueue_(0), stopping_(false) {
+    unsigned workerCount = defaultConcurrency(concurrency) - 1;
+
+    // One deque per worker plus one for submissions from outside the pool
+    for (unsigned i = 0; i <= workerCount; ++i) {
+        queues_.push_back(std::make_unique<WorkQueue>());
+    }
+    workers_.reserve(workerCount);
+    for (unsigned i = 0; i < workerCount; ++i) {
+        workers_.emplace_back([this, i] { workerLoop(i); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+}
+
+unsigned ThreadPool::defaultConcurrency(unsigned requested) {
+    if (requested > 0) {
+        return requested;
+    }
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    size_t index;
+    if (t_pool == this) {
+        index = t_queueIndex;
+    } else {
+        index = nextQueue_.fetch_add(1, std::memory_order_relaxed) % queues_.size();
+    }
+
+    // Count first so a worker never sees a task that is not yet counted
+    pending_.fetch_add(1);
+    {
+        std::lock_guard<std::mutex> lock(queues_[index]->mutex);
+        queues_[index]->tasks.push_back(std::move(task));
+    }
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+    }
+    wake_.notify_one();
+}
+
+bool ThreadPool::takeTask(unsigned home, std::function<void()>& task) {
+    if (pending_.load() == 0) {
+        return false;
+    }
+
+    // Own deque: newest first (LIFO keeps nested work cache-warm)
+    if (home < queues_.size()) {
+        WorkQueue& own = *queues_[home];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            pending_.fetch_sub(1);
+            return true;
+        }
+    }
+
+    // Steal the oldest task from someone else
+    size_t count = queues_.size();
+    for (size_t offset = 1; offset <= count; ++offset) {
+        WorkQueue& victim = *queues_[(home + offset) % count];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            pending_.fetch_sub(1);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ThreadPool::runPendingTask() {
+    unsigned home = t_pool == this ? t_queueIndex : static_cast<unsigned>(queues_.size() - 1);
+    std::function<void()> task;
+    if (!takeTask(home, task)) {
+        return false;
+    }
+    task();
+    return true;
+}
+
+void ThreadPool::workerLoop(unsigned index) {
+    t_pool = this;
+    t_queueIndex = index;
+
+    for (;;) {
+        std::function<void()> task;
+        if (takeTask(index, task)) {
+            task();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleepMutex_);
+        wake_.wait(lock, [this] { return stopping_ || pending_.load() > 0; });
+        if (stopping_ && pending_.load() == 0) {
+            return;
+        }
+    }
+}
+
+TaskGroup::~TaskGroup() {
+    try {
+        wait();
+    } catch (...) {
+        // Errors are only reported through an explicit wait()
+    }
+}
+
+void TaskGroup::run(std::function<void()> task) {
+    outstanding_.fetch_add(1);
+    pool_.submit([this, task = std::move(task)] {
+        std::exception_ptr error;
+        try {
+            task();
+        } catch (...) {
+            error = std::current_exception();
+        }
+
+        // Decrement under the lock: wait() takes it before returning, so
+        // the group cannot be destroyed while this task still touches it
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (error && !error_) {
+            error_ = error;
+        }
+        if (outstanding_.fetch_sub(1) == 1) {
+            done_.notify_all();
+        }
+    });
+}
+
+void TaskGroup::wait() {
+    while (outstanding_.load() > 0) {
+        if (pool_.runPendingTask()) {
+            continue;
+        }
+        // Our tasks are running elsewhere; nap until one finishes or new
+        // work may have been queued
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_.wait_for(lock, std::chrono::milliseconds(1),
+                       [this] { return outstanding_.load() == 0; });
+    }
+
+    std::exception_ptr error;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::swap(error, error_);
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+void parallelFor(ThreadPool& pool, size_t count, const std::function<void(size_t)>& body) {
+    if (count == 0) {
+        return;
+    }
+    if (count == 1 || pool.concurrency() == 1) {
+        for (size_t i = 0; i < count; ++i) {
+            body(i);
+        }
+        return;
+    }
+
+    // A few chunks per thread balances uneven items without flooding the deques
+    size_t chunks = std::min<size_t>(count, static_cast<size_t>(pool.concurrency()) * 4);
+    size_t chunkSize = (count + chunks - 1) / chunks;
+
+    TaskGroup group(pool);
+    for (size_t begin = 0; begin < count; begin += chunkSize) {
+        size_t end = std::min(count, begin + chunkSize);
+        group.run([&body, begin, end] {
+            for (size_t i = begin; i < end; ++i) {
+                body(i);
+            }
+        });
+    }
+    group.wait();
+}
+
+} // namespace syclang
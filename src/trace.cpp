@@ -0,0 +1,139 @@
+#include "syclang/trace.h"
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace syclang {
+
+std::atomic<bool> Trace::enabled_{false};
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Event {
+    std::string name;
+    const char* category;
+    std::string detail;
+    uint64_t start;
+    uint64_t duration;
+};
+
+struct ThreadBuffer {
+    unsigned tid;
+    std::vector<Event> events;
+};
+
+// Buffers live as long as the process: pool threads keep pointing at theirs
+std::mutex g_buffersMutex;
+std::vector<std::unique_ptr<ThreadBuffer>> g_buffers;
+Clock::time_point g_origin = Clock::now();
+
+thread_local ThreadBuffer* t_buffer = nullptr;
+
+ThreadBuffer& threadBuffer() {
+    if (!t_buffer) {
+        std::lock_guard<std::mutex> lock(g_buffersMutex);
+        g_buffers.push_back(std::make_unique<ThreadBuffer>());
+        g_buffers.back()->tid = static_cast<unsigned>(g_buffers.size());
+        t_buffer = g_buffers.back().get();
+    }
+    return *t_buffer;
+}
+
+void appendEscaped(std::string& out, const std::string& text) {
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned char>(c));
+            out += escaped;
+        } else {
+            out += c;
+        }
+    }
+}
+
+} // namespace
+
+void Trace::start() {
+    std::lock_guard<std::mutex> lock(g_buffersMutex);
+    for (auto& buffer : g_buffers) buffer->events.clear();
+    g_origin = Clock::now();
+    enabled_.store(true, std::memory_order_relaxed);
+}
+
+void Trace::stop() {
+    enabled_.store(false, std::memory_order_relaxed);
+}
+
+uint64_t Trace::now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - g_origin).count();
+}
+
+void Trace::record(std::string name, const char* category, std::string detail,
+                   uint64_t start, uint64_t end) {
+    threadBuffer().events.push_back({std::move(name), category, std::move(detail), start, end - start});
+}
+
+size_t Trace::eventCount() {
+    std::lock_guard<std::mutex> lock(g_buffersMutex);
+    size_t count = 0;
+    for (const auto& buffer : g_buffers) count += buffer->events.size();
+    return count;
+}
+
+std::string Trace::toJson() {
+    std::lock_guard<std::mutex> lock(g_buffersMutex);
+    std::string out = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    char number[96];
+    for (const auto& buffer : g_buffers) {
+        if (buffer->events.empty()) continue;
+        // Threads are numbered in the order they first recorded
+        std::snprintf(number, sizeof(number),
+                      "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,", first ? "" : ",",
+                      buffer->tid);
+        out += number;
+        out += "\"args\":{\"name\":\"thread " + std::to_string(buffer->tid) + "\"}}";
+        first = false;
+        for (const auto& event : buffer->events) {
+            out += ",\n{\"name\":\"";
+            appendEscaped(out, event.name);
+            out += "\",\"cat\":\"";
+            appendEscaped(out, event.category);
+            std::snprintf(number, sizeof(number), "\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f",
+                          buffer->tid, event.start / 1e3, event.duration / 1e3);
+            out += number;
+            if (!event.detail.empty()) {
+                out += ",\"args\":{\"detail\":\"";
+                appendEscaped(out, event.detail);
+                out += "\"}";
+            }
+            out += "}";
+        }
+    }
+    out += "\n]}\n";
+    return out;
+}
+
+bool Trace::writeJson(const std::string& path, std::string& error) {
+    std::ofstream file(path);
+    if (!file) {
+        error = "Cannot create file '" + path + "'";
+        return false;
+    }
+    file << toJson();
+    if (!file) {
+        error = "Cannot write file '" + path + "'";
+        return false;
+    }
+    return true;
+}
+
+} // namespace syclang
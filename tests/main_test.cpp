@@ -1,8 +1,70 @@
 #include "syclang/lexer/lexer.h"
+#include "syclang/lexer/simd_scan.h"
 #include "syclang/parser/parser.h"
 #include "syclang/ir/ir_generator.h"
+#include "syclang/ir/binary_ir.h"
+#include "syclang/ir/call_graph.h"
+#include "syclang/ir/dominators.h"
+#include "syclang/ir/loop_info.h"
+#include "syclang/ir/use_def.h"
+#include "syclang/optimizer/dead_code.h"
+#include "syclang/optimizer/gvn.h"
+#include "syclang/optimizer/inliner.h"
+#include "syclang/optimizer/loops.h"
+#include "syclang/optimizer/optimizer.h"
+#include "syclang/optimizer/pass_manager.h"
+#include "syclang/optimizer/sccp.h"
+#include "syclang/optimizer/vectorize.h"
+#include "syclang/thread_pool.h"
+#include "syclang/trace.h"
+#include "syclang/codegen/x64/x64_codegen.h"
+#include "syclang/codegen/arm64/arm64_codegen.h"
+#include "syclang/codegen/x64/x64_assembler.h"
+#include "syclang/codegen/arm64/arm64_assembler.h"
+#include "syclang/codegen/elf_writer.h"
+#include "syclang/codegen/pe_writer.h"
+#include "syclang/codegen/output_buffer.h"
+#include "syclang/compile_cache.h"
+#include "syclang/codegen/linear_scan.h"
+#include "syclang/codegen/graph_coloring.h"
+#include "syclang/codegen/x64/x64_peephole.h"
+#include "syclang/codegen/arm64/arm64_peephole.h"
+#include <algorithm>
+#include <atomic>
 #include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <filesystem>
+#include <fstream>
 #include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <limits>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Lexed, parsed and lowered to IR, as the driver does before optimizing
+std::shared_ptr<syclang::IRModule> buildModule(std::string_view source,
+                                               syclang::Architecture arch = syclang::Architecture::X64) {
+    syclang::Lexer lexer(source);
+    auto tokens = lexer.tokenize();
+    syclang::Parser parser(tokens);
+    return syclang::IRGenerator(arch).generate(parser.parse());
+}
+
+// Instructions in `func` with opcode `op`
+size_t countOpcode(const syclang::IRArena& arena, const syclang::IRFunction& func, syclang::Opcode op) {
+    size_t n = 0;
+    for (syclang::BlockId block : func.blocks) {
+        for (syclang::InstId instId : arena.block(block).instructions) {
+            n += arena.instruction(instId).opcode == op;
+        }
+    }
+    return n;
+}
 
 void test_lexer() {
     std::cout << "Testing Lexer...\n";
@@ -14,6 +76,22 @@ void test_lexer() {
     assert(!tokens.empty());
     assert(tokens[0].is(syclang::TokenType::KW_FN));
     
+    // Keyword table covers English and Chinese spellings; identifiers
+    // are slices of the source
+    std::string mixed = "如果 while whiles 返回 i64 计算结果";
+    syclang::Lexer mixedLexer(mixed);
+    auto mixedTokens = mixedLexer.tokenize();
+    assert(mixedTokens.size() == 7);
+    assert(mixedTokens[0].is(syclang::TokenType::KW_IF));
+    assert(mixedTokens[0].isChineseKeyword());
+    assert(mixedTokens[1].is(syclang::TokenType::KW_WHILE));
+    assert(mixedTokens[2].is(syclang::TokenType::IDENTIFIER));
+    assert(mixedTokens[2].value().data() == mixed.data() + mixed.find("whiles"));
+    assert(mixedTokens[3].is(syclang::TokenType::KW_RETURN));
+    assert(mixedTokens[4].is(syclang::TokenType::TYPE_I64));
+    assert(mixedTokens[5].is(syclang::TokenType::IDENTIFIER));
+    assert(mixedTokens[5].value() == "计算结果");
+    
     std::cout << "  Lexer tests passed!\n";
 }
 
@@ -30,6 +108,26 @@ void test_parser() {
     assert(program != nullptr);
     assert(!program->declarations.empty());
     
+    // Parameter lists, call arguments and binary operators
+    std::string binarySource = "fn sub(a: i64, b: i64) -> i64 { return a - b * f(a, 2); }";
+    syclang::Lexer binaryLexer(binarySource);
+    auto binaryTokens = binaryLexer.tokenize();
+    assert(binaryTokens.value(1) == "sub");
+    assert(binaryTokens.is(binaryTokens.size() - 1, syclang::TokenType::EOF_TOKEN));
+    
+    syclang::Parser binaryParser(binaryTokens);
+    auto binaryProgram = binaryParser.parse();
+    assert(binaryParser.getErrors().empty());
+    auto func = std::dynamic_pointer_cast<syclang::FunctionDecl>(binaryProgram->declarations[0]);
+    assert(func->params.size() == 2);
+    auto ret = std::dynamic_pointer_cast<syclang::ReturnStmt>(func->body->statements[0]);
+    auto sub = std::dynamic_pointer_cast<syclang::BinaryExpr>(ret->expr);
+    assert(sub->op == syclang::TokenType::MINUS);
+    auto mul = std::dynamic_pointer_cast<syclang::BinaryExpr>(sub->right);
+    assert(mul->op == syclang::TokenType::STAR);
+    auto call = std::dynamic_pointer_cast<syclang::CallExpr>(mul->right);
+    assert(call->args.size() == 2);
+    
     std::cout << "  Parser tests passed!\n";
 }
 
@@ -37,19 +135,1742 @@ void test_ir_generation() {
     std::cout << "Testing IR Generation...\n";
     
     std::string source = "fn main() -> i32 { return 0; }";
+    auto module = buildModule(source);
+    
+    assert(module != nullptr);
+    assert(!module->functions.empty());
+    
+    std::cout << "  IR Generation tests passed!\n";
+}
+
+void test_ir_arena() {
+    std::cout << "Testing IR Arena...\n";
+    
+    syclang::IRArena arena;
+    
+    // Constants are interned by (type, bits)
+    syclang::ValueId a = arena.createI64(42);
+    syclang::ValueId b = arena.createI64(42);
+    syclang::ValueId c = arena.createI32(42);
+    assert(a == b);
+    assert(a != c);
+    assert(arena.value(a).isConstant());
+    
+    // References stay valid while the slabs grow past a chunk
+    syclang::ValueId var = arena.createVariable(syclang::IRType::I32, "x");
+    const syclang::IRValue& varRef = arena.value(var);
+    for (int i = 0; i < 10000; ++i) {
+        arena.createVariable(syclang::IRType::I64, "t" + std::to_string(i));
+    }
+    assert(&varRef == &arena.value(var));
+    assert(varRef.name == "x");
+    
+    syclang::InstId inst = arena.createInstruction(syclang::Opcode::ADD, {var, a}, var);
+    assert(arena.operands(arena.instruction(inst)).size() == 2);
+    assert(arena.toString(arena.instruction(inst)) == "%x = add %x, 42");
+    
+    // Operand ranges longer than a chunk get consecutive chunks of their own
+    std::vector<syclang::ValueId> wide(3 * syclang::Slab<syclang::ValueId>::CHUNK_SIZE);
+    std::vector<syclang::BlockId> from(wide.size());
+    for (size_t i = 0; i < wide.size(); ++i) {
+        wide[i] = arena.createI64(static_cast<int64_t>(i));
+        from[i] = static_cast<syclang::BlockId>(i);
+    }
+    syclang::InstId call = arena.createInstruction(syclang::Opcode::CALL, wide);
+    syclang::InstId phi = arena.createInstruction(syclang::Opcode::PHI, {}, var);
+    arena.setIncoming(arena.instruction(phi), wide, from);
+    syclang::InstId after = arena.createInstruction(syclang::Opcode::ADD, {a, a}, var);
+    auto callOperands = arena.operands(arena.instruction(call));
+    assert(std::equal(callOperands.begin(), callOperands.end(), wide.begin(), wide.end()));
+    auto phiOperands = arena.operands(arena.instruction(phi));
+    assert(std::equal(phiOperands.begin(), phiOperands.end(), wide.begin(), wide.end()));
+    auto incoming = arena.incomingBlocks(arena.instruction(phi));
+    assert(std::equal(incoming.begin(), incoming.end(), from.begin(), from.end()));
+    assert(arena.operands(arena.instruction(after))[1] == a);
+    assert(arena.operands(arena.instruction(inst))[0] == var);
+    
+    std::cout << "  IR Arena tests passed!\n";
+}
+
+void test_ssa_construction() {
+    std::cout << "Testing SSA Construction...\n";
+    
+    std::string source =
+        "fn pick(x: i64, n: i64) -> i64 {\n"
+        "    let mut acc: i64 = x;\n"
+        "    let mut i: i64 = 0;\n"
+        "    let mut unset: i64;\n"
+        "    while (i < n) {\n"
+        "        if (i % 2 == 0) {\n"
+        "            acc = acc + i;\n"
+        "        } else {\n"
+        "            acc = acc - 1;\n"
+        "        }\n"
+        "        i += 1;\n"
+        "    }\n"
+        "    return acc + unset;\n"
+        "}\n";
+    auto module = buildModule(source);
+    const auto& arena = module->arena;
+    const auto& func = *module->functions[0];
+    assert(func.arguments.size() == 2);
+    
+    // Every local is promoted: no memory traffic is left
+    std::map<std::string, std::vector<size_t>> phisByBlock; // Block name -> input counts
+    bool readsArgument = false;
+    for (syclang::BlockId block : func.blocks) {
+        bool leading = true;
+        for (syclang::InstId instId : arena.block(block).instructions) {
+            const auto& inst = arena.instruction(instId);
+            assert(inst.opcode != syclang::Opcode::LOAD);
+            assert(inst.opcode != syclang::Opcode::STORE);
+            assert(inst.opcode != syclang::Opcode::ALLOCA);
+            if (inst.opcode == syclang::Opcode::PHI) {
+                assert(leading); // PHIs head their block
+                phisByBlock[arena.block(block).name].push_back(arena.operands(inst).size());
+            } else {
+                leading = false;
+            }
+            for (syclang::ValueId op : arena.operands(inst)) {
+                readsArgument |= op == func.arguments[1];
+            }
+        }
+    }
+    assert(readsArgument);
+    
+    // The loop header merges acc and i; the if/else join merges acc
+    size_t headerPhis = 0, joinPhis = 0;
+    for (const auto& [name, inputs] : phisByBlock) {
+        for (size_t count : inputs) assert(count == 2);
+        if (name.rfind("while.cond", 0) == 0) headerPhis = inputs.size();
+        if (name.rfind("merge", 0) == 0) joinPhis = inputs.size();
+    }
+    assert(headerPhis == 2);
+    assert(joinPhis == 1);
+    assert(module->dump().find("phi [") != std::string::npos);
+    
+    // The entry dominates everything; the loop header is its own frontier
+    syclang::DominatorTree dom(arena, func);
+    assert(dom.reversePostorder().size() == func.blocks.size());
+    for (syclang::BlockId block : func.blocks) {
+        assert(dom.dominates(func.blocks[0], block));
+        const std::string& name = arena.block(block).name;
+        if (name.rfind("while.body", 0) == 0) {
+            const auto& frontier = dom.frontier(block);
+            assert(frontier.size() == 1);
+            assert(arena.block(frontier[0]).name.rfind("while.cond", 0) == 0);
+        }
+    }
+    
+    std::cout << "  SSA construction tests passed!\n";
+}
+
+void test_dead_code_elimination() {
+    std::cout << "Testing Dead Code Elimination...\n";
+    
+    std::string source =
+        "fn f(x: i64) -> i64 {\n"
+        "    let unused: i64 = x * 3 + 1;\n"
+        "    let y: i64 = x + 2;\n"
+        "    log(y);\n"
+        "    let z: i64 = y - x;\n"
+        "    return y;\n"
+        "}\n";
+    auto module = buildModule(source);
+    auto& arena = module->arena;
+    auto& func = *module->functions[0];
+    
+    // x feeds the multiply, the add and the subtract
+    syclang::UseDefChains chains(arena, func);
+    syclang::ValueId x = func.arguments[0];
+    assert(chains.definition(x) == syclang::INVALID_ID);
+    assert(chains.users(x).size() == 3);
+    for (syclang::InstId user : chains.users(x)) {
+        const auto& inst = arena.instruction(user);
+        assert(chains.definition(inst.result) == user);
+        assert(chains.blockOf(user) == func.blocks[0]);
+    }
+    assert(countOpcode(arena, func, syclang::Opcode::MUL) == 1);
+    assert(countOpcode(arena, func, syclang::Opcode::SUB) == 1);
+    
+    // The unused arithmetic goes; the call stays although its result is unused
+    size_t removed = syclang::eliminateDeadCode(arena, func);
+    assert(removed == 3);
+    assert(countOpcode(arena, func, syclang::Opcode::MUL) == 0);
+    assert(countOpcode(arena, func, syclang::Opcode::SUB) == 0);
+    assert(countOpcode(arena, func, syclang::Opcode::ADD) == 1);
+    assert(countOpcode(arena, func, syclang::Opcode::CALL) == 1);
+    assert(countOpcode(arena, func, syclang::Opcode::RET) == 1);
+    assert(syclang::eliminateDeadCode(arena, func) == 0);
+    
+    // Redirecting uses moves them between chains
+    syclang::UseDefChains after(arena, func);
+    syclang::ValueId y = arena.operands(arena.instruction(after.users(x)[0]))[0] == x
+                             ? arena.instruction(after.users(x)[0]).result
+                             : syclang::INVALID_ID;
+    assert(y != syclang::INVALID_ID);
+    size_t yUsers = after.users(y).size();
+    syclang::ValueId seven = arena.createI64(7);
+    after.replaceAllUses(arena, y, seven);
+    assert(!after.isUsed(y));
+    assert(after.users(seven).size() == yUsers);
+    
+    std::cout << "  Dead code elimination tests passed!\n";
+}
+
+void test_constant_propagation() {
+    std::cout << "Testing Constant Propagation...\n";
+    
+    using syclang::IRType;
+    using syclang::Opcode;
+    using syclang::foldOperation;
+    auto bits = [](int64_t v) { return static_cast<uint64_t>(v); };
+    
+    // Arithmetic wraps at the width of the result type
+    assert(*foldOperation(Opcode::ADD, IRType::U8, IRType::U8, 200, 100) == 44);
+    assert(*foldOperation(Opcode::ADD, IRType::I32, IRType::I32, 0x7fffffff, 1) == bits(-2147483648LL));
+    assert(*foldOperation(Opcode::MUL, IRType::I64, IRType::I64, bits(-3), 7) == bits(-21));
+    assert(*foldOperation(Opcode::SHR, IRType::I64, IRType::I64, bits(-8), 1) == 0x7ffffffffffffffcULL);
+    assert(*foldOperation(Opcode::MOD, IRType::I64, IRType::I64, bits(-7), 3) == bits(-1));
+    
+    // Signedness of a comparison comes from its operands
+    assert(*foldOperation(Opcode::LT, IRType::I64, IRType::I64, bits(-1), 1) == 1);
+    assert(*foldOperation(Opcode::LT, IRType::I64, IRType::U64, bits(-1), 1) == 0);
+    
+    // Conversions
+    assert(*foldOperation(Opcode::SEXT, IRType::I64, IRType::I8, 0x80) == bits(-128));
+    assert(*foldOperation(Opcode::ZEXT, IRType::I64, IRType::I8, bits(-1)) == 255);
+    assert(*foldOperation(Opcode::TRUNC, IRType::U16, IRType::I64, 0x12345) == 0x2345);
+    double three = 3.0;
+    uint64_t threeBits;
+    std::memcpy(&threeBits, &three, sizeof(threeBits));
+    assert(*foldOperation(Opcode::SITOFP, IRType::F64, IRType::I64, 3) == threeBits);
+    assert(*foldOperation(Opcode::FPTOSI, IRType::I64, IRType::F64, threeBits) == 3);
+    
+    // Trapping or undefined operations stay
+    assert(!foldOperation(Opcode::DIV, IRType::I64, IRType::I64, 1, 0));
+    assert(!foldOperation(Opcode::DIV, IRType::I8, IRType::I8, bits(-128), bits(-1)));
+    double huge = 1e30;
+    uint64_t hugeBits;
+    std::memcpy(&hugeBits, &huge, sizeof(hugeBits));
+    assert(!foldOperation(Opcode::FPTOSI, IRType::I32, IRType::F64, hugeBits));
+    
+    // Configuration constants decide every branch: what is left is
+    // straight-line code returning a constant
+    std::string source =
+        "fn config() -> i64 {\n"
+        "    let mode: i64 = 2;\n"
+        "    let mut flags: i64 = 0;\n"
+        "    if (mode == 2) {\n"
+        "        flags = flags | 4;\n"
+        "    } else {\n"
+        "        flags = probe(1);\n"
+        "    }\n"
+        "    if (flags > 3) {\n"
+        "        flags = flags * 3;\n"
+        "    }\n"
+        "    return flags;\n"
+        "}\n"
+        "fn steady(n: i64) -> i64 {\n"
+        "    let mut x: i64 = 1;\n"
+        "    let mut i: i64 = 0;\n"
+        "    while (i < n) {\n"
+        "        x = x * 1;\n"
+        "        i = i + 1;\n"
+        "    }\n"
+        "    return x;\n"
+        "}\n";
+    auto module = buildModule(source);
+    const auto& arena = module->arena;
+    
+    syclang::Optimizer optimizer;
+    optimizer.optimize(module);
+    assert(optimizer.getStats().foldedBranches >= 2);
+    assert(optimizer.getStats().unreachableBlocks >= 1);
+    
+    auto returned = [&](const syclang::IRFunction& func, size_t& condBranches) {
+        syclang::ValueId value = syclang::INVALID_ID;
+        condBranches = 0;
+        for (syclang::BlockId block : func.blocks) {
+            for (syclang::InstId instId : arena.block(block).instructions) {
+                const auto& inst = arena.instruction(instId);
+                assert(inst.opcode != Opcode::CALL);
+                condBranches += inst.opcode == Opcode::CONDBR;
+                if (inst.opcode == Opcode::RET) value = arena.operands(inst)[0];
+            }
+        }
+        return value;
+    };
+    size_t condBranches = 0;
+    syclang::ValueId config = returned(*module->functions[0], condBranches);
+    assert(condBranches == 0);
+    assert(arena.value(config).isConstant());
+    assert(arena.value(config).value_.intValue == 12);
+    
+    // x is 1 on entry and stays 1 around the loop; only the loop test varies
+    syclang::ValueId steady = returned(*module->functions[1], condBranches);
+    assert(condBranches == 1);
+    assert(arena.value(steady).isConstant());
+    assert(arena.value(steady).value_.intValue == 1);
+    
+    std::cout << "  Constant propagation tests passed!\n";
+}
+
+void test_value_numbering() {
+    std::cout << "Testing Global Value Numbering...\n";
+    
+    std::string source =
+        "fn f(a: i64, b: i64, c: bool) -> i64 {\n"
+        "    let x: i64 = a * b + 1;\n"
+        "    let mut r: i64 = 0;\n"
+        "    if (c) {\n"
+        "        r = b * a + 1;\n"
+        "        if (a < b) { r = r + a - b; }\n"
+        "        if (b > a) { r = r * 2; }\n"
+        "    } else {\n"
+        "        r = a - b;\n"
+        "    }\n"
+        "    return x + r + (a - b);\n"
+        "}\n";
+    auto module = buildModule(source);
+    auto& arena = module->arena;
+    auto& func = *module->functions[0];
+    
+    assert(countOpcode(arena, func, syclang::Opcode::MUL) == 3);
+    size_t subs = countOpcode(arena, func, syclang::Opcode::SUB);
+    
+    // b * a + 1 in the then-branch is the entry's a * b + 1, and b > a is
+    // a < b. The else-branch a - b does not dominate the one after the
+    // join, so both stay (as does the then-branch r + a - b).
+    size_t removed = syclang::numberValues(arena, func);
+    assert(removed == 3);
+    assert(countOpcode(arena, func, syclang::Opcode::MUL) == 2);
+    assert(countOpcode(arena, func, syclang::Opcode::GT) == 0);
+    assert(countOpcode(arena, func, syclang::Opcode::LT) == 1);
+    assert(countOpcode(arena, func, syclang::Opcode::SUB) == subs);
+    assert(syclang::numberValues(arena, func) == 0);
+    
+    std::cout << "  Global value numbering tests passed!\n";
+}
+
+void test_loop_optimization() {
+    std::cout << "Testing Loop Optimization...\n";
+    
+    std::string source =
+        "fn f(a: i64, b: i64, n: i64) -> i64 {\n"
+        "    let mut s: i64 = 0;\n"
+        "    let mut i: i64 = 0;\n"
+        "    while (i < n) {\n"
+        "        let mut j: i64 = 0;\n"
+        "        while (j < 16) {\n"
+        "            s = s + j * 5 + a * b;\n"
+        "            j = j + 1;\n"
+        "        }\n"
+        "        i = i + 1;\n"
+        "    }\n"
+        "    return s;\n"
+        "}\n";
+    auto module = buildModule(source);
+    auto& arena = module->arena;
+    auto& func = *module->functions[0];
+    
+    // Two nested loops, the inner one listed first
+    {
+        syclang::DominatorTree dom(arena, func);
+        syclang::LoopInfo info(func, dom);
+        const auto& loops = info.loops();
+        assert(loops.size() == 2);
+        assert(loops[0].depth == 2 && loops[1].depth == 1);
+        assert(loops[0].parent == 1 && loops[1].parent == -1);
+        assert(loops[1].contains(loops[0].header));
+        assert(!loops[0].contains(loops[1].header));
+        assert(loops[0].preheader != syclang::INVALID_ID);
+        assert(loops[0].latches.size() == 1 && loops[0].exits.size() == 1);
+    }
+    
+    // a * b leaves both loops, j * 5 becomes an induction variable and the
+    // 16-trip inner loop is unrolled by 4; the new variable's start and step
+    // fold, so the only multiply left is the hoisted one
+    auto reports = syclang::optimizeLoops(arena, func);
+    assert(reports.size() == 2);
+    const auto& inner = reports[0];
+    assert(inner.depth == 2 && inner.tripCount == 16);
+    assert(inner.hoisted == 1 && inner.reduced == 1 && inner.unrollFactor == 4);
+    assert(inner.cyclesAfter < inner.cyclesBefore);
+    assert(reports[1].tripCount == -1 && reports[1].hoisted == 1);
+    assert(countOpcode(arena, func, syclang::Opcode::MUL) == 1);
+    {
+        syclang::DominatorTree dom(arena, func);
+        syclang::LoopInfo info(func, dom);
+        for (const auto& loop : info.loops()) {
+            for (syclang::BlockId block : loop.blocks) {
+                for (syclang::InstId instId : arena.block(block).instructions) {
+                    assert(arena.instruction(instId).opcode != syclang::Opcode::MUL);
+                }
+            }
+        }
+    }
+    
+    // Nothing left to do on a second run
+    for (const auto& report : syclang::optimizeLoops(arena, func)) {
+        assert(report.hoisted == 0 && report.reduced == 0 && report.unrollFactor == 1);
+    }
+    
+    std::cout << "  Loop optimization tests passed!\n";
+}
+
+void test_loop_vectorization() {
+    std::cout << "Testing Loop Vectorization...\n";
+    
+    std::string source =
+        "fn add(d: u8*, a: u8*, b: u8*, n: i64) -> i64 {\n"
+        "    let mut i: i64 = 0;\n"
+        "    while (i < n) {\n"
+        "        d[i] = a[i] + b[i] + 3;\n"
+        "        i = i + 1;\n"
+        "    }\n"
+        "    return i;\n"
+        "}\n"
+        "fn inplace(d: u32*, n: i64) -> i64 {\n"
+        "    let mut i: i64 = 0;\n"
+        "    while (i < n) {\n"
+        "        d[i] = d[i] * 3;\n"
+        "        i = i + 1;\n"
+        "    }\n"
+        "    return 0;\n"
+        "}\n"
+        "fn sum(a: i64*, n: i64) -> i64 {\n"
+        "    let mut s: i64 = 0;\n"
+        "    let mut i: i64 = 0;\n"
+        "    while (i < n) {\n"
+        "        s = s + a[i];\n"
+        "        i = i + 1;\n"
+        "    }\n"
+        "    return s;\n"
+        "}\n";
+    // One byte vector per trip, guarded by an overlap test between the
+    // three pointers; the scalar loop stays behind for the remainder
+    auto module = buildModule(source);
+    auto& arena = module->arena;
+    auto& add = *module->functions[0];
+    size_t blocks = add.blocks.size();
+    auto results = syclang::vectorizeLoops(arena, add, syclang::VectorIsa::SSE2);
+    assert(results.size() == 1);
+    assert(results[0].vectorHeader != syclang::INVALID_ID && results[0].lanes == 16);
+    assert(results[0].vectorCycles < results[0].scalarCycles);
+    assert(std::string(results[0].reason) == "vectorized with alias check");
+    assert(add.blocks.size() == blocks + 4);
+    assert(countOpcode(arena, add, syclang::Opcode::SPLAT) == 1);
+    {
+        syclang::DominatorTree dom(arena, add);
+        syclang::LoopInfo info(add, dom);
+        assert(info.loops().size() == 2);
+        for (const auto& loop : info.loops()) {
+            for (syclang::BlockId block : loop.blocks) {
+                for (syclang::InstId instId : arena.block(block).instructions) {
+                    const auto& inst = arena.instruction(instId);
+                    if (inst.result == syclang::INVALID_ID) continue;
+                    if (syclang::isVectorType(arena.value(inst.result).getType())) {
+                        assert(arena.value(inst.result).getType() == syclang::IRType::V16I8);
+                        assert(loop.header == results[0].vectorHeader);
+                    }
+                }
+            }
+        }
+    }
+    
+    // Loading and storing the same base needs no test; SSE2 has no 32-bit
+    // multiply but AVX2 does; reductions stay scalar
+    auto& inplace = *module->functions[1];
+    auto sse2 = syclang::vectorizeLoops(arena, inplace, syclang::VectorIsa::SSE2);
+    assert(sse2.size() == 1 && sse2[0].vectorHeader == syclang::INVALID_ID);
+    auto avx2 = syclang::vectorizeLoops(arena, inplace, syclang::VectorIsa::AVX2);
+    assert(avx2[0].lanes == 8 && std::string(avx2[0].reason) == "vectorized");
+    auto& sum = *module->functions[2];
+    auto reduction = syclang::vectorizeLoops(arena, sum, syclang::VectorIsa::AVX2);
+    assert(reduction.size() == 1 && reduction[0].vectorHeader == syclang::INVALID_ID);
+    
+    syclang::X64CodeGenerator x64;
+    x64.generate(module);
+    std::string output = x64.getOutput();
+    assert(output.find("paddb xmm") != std::string::npos);
+    assert(output.find("movdqu xmmword ptr") != std::string::npos);
+    assert(output.find("vpmulld ymm") != std::string::npos);
+    assert(output.find("vzeroupper") != std::string::npos);
+    
+    // The -O2 pipeline vectorizes for NEON on ARM64
+    auto armModule = buildModule(source, syclang::Architecture::ARM64);
+    syclang::Optimizer optimizer;
+    optimizer.setOptimizationLevel(2);
+    syclang::LoopOptions options;
+    options.vectorIsa = syclang::defaultVectorIsa(syclang::Architecture::ARM64);
+    optimizer.setLoopOptions(options);
+    optimizer.optimize(armModule);
+    size_t vectorized = 0;
+    for (const auto& report : optimizer.getLoopReports()) {
+        vectorized += report.vectorLanes > 1;
+    }
+    assert(vectorized == 2);
+    syclang::ARM64CodeGenerator arm;
+    arm.generate(armModule);
+    std::string armOutput = arm.getOutput();
+    assert(armOutput.find(".16b") != std::string::npos);
+    assert(armOutput.find("mul v") != std::string::npos);
+    assert(armOutput.find("ldr q") != std::string::npos);
+    // Each vector access takes its address in x16 on a line of its own
+    assert(armOutput.find(", [x16]\n") != std::string::npos);
+    assert(!syclang::assembleArm64(armOutput).text.empty());
+    
+    std::cout << "  Loop vectorization tests passed!\n";
+}
+
+void test_function_inlining() {
+    std::cout << "Testing Function Inlining...\n";
+    
+    std::string source =
+        "fn sq(x: i64) -> i64 { return x * x; }\n"
+        "fn clamp(x: i64, lo: i64, hi: i64) -> i64 {\n"
+        "    if (x < lo) { return lo; }\n"
+        "    if (x > hi) { return hi; }\n"
+        "    return x;\n"
+        "}\n"
+        "#[noinline]\n"
+        "fn twice(x: i64) -> i64 { return x + x; }\n"
+        "fn even(n: i64) -> i64 { if (n == 0) { return 1; } return odd(n - 1); }\n"
+        "fn odd(n: i64) -> i64 { if (n == 0) { return 0; } return even(n - 1); }\n"
+        "fn run(n: i64) -> i64 {\n"
+        "    return clamp(sq(n), 0, 400) + twice(n) + even(n);\n"
+        "}\n";
+    auto calls = [](const syclang::IRArena& arena, const syclang::IRFunction& func) {
+        std::vector<std::string> names;
+        for (syclang::BlockId block : func.blocks) {
+            for (syclang::InstId instId : arena.block(block).instructions) {
+                const auto& inst = arena.instruction(instId);
+                if (inst.opcode == syclang::Opcode::CALL) {
+                    names.push_back(arena.value(inst.callee).name);
+                }
+            }
+        }
+        return names;
+    };
+    
+    // even and odd form one component, visited before run calls into it
+    auto module = buildModule(source);
+    auto& arena = module->arena;
+    {
+        syclang::CallGraph graph(*module);
+        int run = graph.find("run"), even = graph.find("even"), odd = graph.find("odd");
+        assert(run >= 0 && graph.find("missing") == -1);
+        assert(graph.nodes()[run].calls.size() == 4);
+        assert(graph.nodes()[even].component == graph.nodes()[odd].component);
+        assert(graph.nodes()[run].component > graph.nodes()[even].component);
+        assert(graph.isRecursive(even) && graph.isRecursive(odd));
+        assert(!graph.isRecursive(run) && !graph.isRecursive(graph.find("sq")));
+        assert(graph.nodes()[graph.find("sq")].callers.size() == 1);
+    }
+    
+    // Small leaf functions disappear into run; the hinted and the
+    // recursive ones stay calls
+    size_t inlined = syclang::inlineFunctions(*module);
+    assert(inlined == 2);
+    auto& run = *module->functions[5];
+    assert(run.name == "run");
+    auto remaining = calls(arena, run);
+    std::sort(remaining.begin(), remaining.end());
+    assert((remaining == std::vector<std::string>{"even", "twice"}));
+    assert(calls(arena, *module->functions[4]) == std::vector<std::string>{"even"});
+    // clamp's three returns meet in one PHI at the continuation
+    assert(countOpcode(arena, run, syclang::Opcode::PHI) == 1);
+    
+    // #[inline] overrides the size limit
+    source = "#[inline]\n"
+             "fn big(x: i64) -> i64 {\n"
+             "    let mut s: i64 = 0;\n"
+             "    let mut i: i64 = 0;\n"
+             "    while (i < x) { s = s + i * 3 + (i ^ 5) - (i & 7) + (s >> 2); i = i + 1; }\n"
+             "    return s;\n"
+             "}\n"
+             "fn run(n: i64) -> i64 { return big(n) + big(n + 1); }\n";
+    auto forced = buildModule(source);
+    syclang::InlineOptions tight;
+    tight.threshold = 0;
+    assert(syclang::inlineFunctions(*forced, tight) == 2);
+    assert(calls(forced->arena, *forced->functions[1]).empty());
+    
+    // Calls name their target in the emitted code
+    auto kept = buildModule(source);
+    syclang::X64CodeGenerator x64;
+    x64.generate(kept);
+    assert(x64.getOutput().find("call big") != std::string::npos);
+    syclang::ARM64CodeGenerator arm;
+    arm.generate(kept);
+    assert(arm.getOutput().find("bl big") != std::string::npos);
+    
+    std::cout << "  Function inlining tests passed!\n";
+}
+
+void test_pass_manager() {
+    std::cout << "Testing Pass Manager...\n";
+    
+    std::string source =
+        "fn f(n: i64) -> i64 {\n"
+        "    let mut s: i64 = 0;\n"
+        "    let mut i: i64 = 0;\n"
+        "    while (i < n) { s = s + i * 4; i = i + 1; }\n"
+        "    if (1 < 2) { return s; }\n"
+        "    return 0;\n"
+        "}\n"
+        "fn g(a: i64) -> i64 { return a * 2 + a * 2; }\n";
+    using syclang::Analysis;
+    using syclang::PreservedAnalyses;
+    auto throws = [](auto&& body) {
+        try {
+            body();
+        } catch (const std::runtime_error&) {
+            return true;
+        }
+        return false;
+    };
+    
+    // Required analyses are computed once and reused until a pass says
+    // it broke them
+    syclang::PassManager manager;
+    size_t visits = 0;
+    manager.registerPass({"look", "", {Analysis::DOMINATORS}, nullptr,
+                          [&](syclang::IRArena&, syclang::IRFunction& func, syclang::AnalysisManager& analyses) {
+                              assert(analyses.dominators(func).reversePostorder().front() == func.blocks[0]);
+                              ++visits;
+                              return PreservedAnalyses::all();
+                          }});
+    manager.registerPass({"clobber", "", {}, nullptr,
+                          [](syclang::IRArena&, syclang::IRFunction&, syclang::AnalysisManager&) {
+                              return PreservedAnalyses::none();
+                          }});
+    assert(throws([&] { manager.registerPass({"look", "", {}, nullptr, nullptr}); }));
+    assert(throws([&] { manager.setPipeline("look,missing"); }));
+    assert(throws([&] { manager.setPipeline("look,,look"); }));
+    auto module = buildModule(source);
+    manager.setPipeline("look, look");
+    manager.run(*module);
+    assert(visits == 4);
+    assert(manager.getAnalysisStats(Analysis::DOMINATORS).computed == 2);
+    assert(manager.getAnalysisStats(Analysis::DOMINATORS).reused == 2);
+    manager.setPipeline("look,clobber,look");
+    manager.run(*module);
+    assert(manager.getAnalysisStats(Analysis::DOMINATORS).computed == 6);
+    assert(manager.getTimings().size() == 3 && manager.getTimings()[1].name == "clobber");
+    
+    // The -O2 pipeline spelled out does exactly what -O2 does
+    auto level = buildModule(source);
+    syclang::Optimizer byLevel;
+    byLevel.setOptimizationLevel(2);
+    byLevel.optimize(level);
+    auto spelled = buildModule(source);
+    syclang::Optimizer byName;
+    byName.setPipeline(syclang::Optimizer::pipelineForLevel(2));
+    byName.optimize(spelled);
+    assert(level->dump() == spelled->dump());
+    assert(throws([&] { byName.setPipeline("sccp,unroll"); }));
+    
+    // Timings chain: each pass starts from what the previous one left;
+    // GVN keeps the CFG, so the loop pass reuses its dominator trees
+    const auto& timings = byLevel.getPassTimings();
+    assert(timings.size() == 5 && timings[0].name == "inline" && timings[4].name == "dce");
+    for (size_t p = 1; p < timings.size(); ++p) {
+        assert(timings[p].instructionsBefore == timings[p - 1].instructionsAfter);
+        assert(timings[p].seconds >= 0);
+    }
+    assert(timings[2].instructionsAfter < timings[2].instructionsBefore);
+    assert(byLevel.getStats().redundantInstructions >= 1);
+    assert(byLevel.getPassManager().getAnalysisStats(Analysis::DOMINATORS).reused >= 2);
+    std::string report = byLevel.formatPassTimings();
+    assert(report.find("(dominator-tree)") != std::string::npos);
+    assert(report.find("loops") != std::string::npos);
+    
+    std::cout << "  Pass manager tests passed!\n";
+}
+
+void test_compile_trace() {
+    std::cout << "Testing Compile Trace...\n";
+    
+    // Nothing is recorded until tracing starts
+    syclang::Trace::start();
+    syclang::Trace::stop();
+    { syclang::TraceScope ignored("ignored", "test"); }
+    assert(syclang::Trace::eventCount() == 0);
+    
+    syclang::Trace::start();
+    {
+        syclang::TraceScope outer("outer", "test", "say \"hi\"\n");
+        buildModule("fn main() -> i64 { return 1; }");
+    }
+    syclang::Trace::stop();
+    std::string json = syclang::Trace::toJson();
+    assert(json.find("\"traceEvents\"") != std::string::npos);
+    for (const char* name : {"outer", "lex", "parse", "irgen", "irgen function", "mem2reg"}) {
+        assert(json.find("\"name\":\"" + std::string(name) + "\"") != std::string::npos);
+    }
+    assert(json.find("\"detail\":\"say \\\"hi\\\"\\u000a\"") != std::string::npos);
+    assert(json.find("\"ph\":\"X\"") != std::string::npos);
+    size_t events = syclang::Trace::eventCount();
+    assert(events == 6);
+    
+    // Events from several threads all make it into the trace
+    syclang::Trace::start();
+    {
+        syclang::ThreadPool pool(4);
+        syclang::parallelFor(pool, 64, [](size_t) { syclang::TraceScope item("item", "test"); });
+    }
+    syclang::Trace::stop();
+    assert(syclang::Trace::eventCount() == 64);
+    
+    std::cout << "  Compile trace tests passed!\n";
+}
+
+void test_scan_kernels() {
+    std::cout << "Testing Scan Kernels...\n";
+    
+    // Inputs longer than a vector register, with the interesting byte at
+    // every possible offset
+    const syclang::ScanKernels* scalar = syclang::getScanKernels(syclang::ScanIsa::SCALAR);
+    const syclang::ScanIsa isas[] = {syclang::ScanIsa::SSE2, syclang::ScanIsa::AVX2};
+    for (syclang::ScanIsa isa : isas) {
+        const syclang::ScanKernels* scan = syclang::getScanKernels(isa);
+        if (!scan) {
+            continue;
+        }
+        for (size_t stop = 0; stop < 80; ++stop) {
+            std::string ws(stop, ' ');
+            for (size_t i = 0; i < stop; ++i) ws[i] = " \t\n\r\v\f"[i % 6];
+            ws += "x \n";
+            std::string ident(stop, 'a');
+            for (size_t i = 0; i < stop; ++i) ident[i] = "aZ_09Qz"[i % 7];
+            ident += "\xE4 ";
+            std::string comment(stop, '*');
+            comment += "*/ \n";
+            
+            for (const std::string* input : {&ws, &ident, &comment}) {
+                const char* b = input->data();
+                for (size_t cut = 0; cut <= input->size(); ++cut) {
+                    const char* end = b + cut;
+                    assert(scan->skipWhitespace(b, end) == scalar->skipWhitespace(b, end));
+                    assert(scan->skipIdentifierChars(b, end) == scalar->skipIdentifierChars(b, end));
+                    assert(scan->findByte(b, end, '\n') == scalar->findByte(b, end, '\n'));
+                    assert(scan->findBlockCommentEnd(b, end) == scalar->findBlockCommentEnd(b, end));
+                    assert(scan->countNewlines(b, end) == scalar->countNewlines(b, end));
+                }
+            }
+        }
+    }
+    
+    // Line/column tracking is unchanged by the bulk advance
+    std::string source = "/* one\n * two\n */ fn   // tail\n"
+                         "\t\t  long_identifier_name_over_sixteen_bytes\n\n  x";
     syclang::Lexer lexer(source);
     auto tokens = lexer.tokenize();
+    assert(tokens.size() == 4);
+    assert(tokens[0].is(syclang::TokenType::KW_FN));
+    assert(tokens[0].line() == 3 && tokens[0].column() == 7);
+    assert(tokens[1].value() == "long_identifier_name_over_sixteen_bytes");
+    assert(tokens[1].line() == 4 && tokens[1].column() == 44);
+    assert(tokens[2].line() == 6 && tokens[2].column() == 4);
     
-    syclang::Parser parser(tokens);
-    auto program = parser.parse();
+    std::cout << "  Scan kernel tests passed!\n";
+}
+
+void test_source_buffer() {
+    std::cout << "Testing Source Buffer...\n";
     
-    syclang::IRGenerator irGen(syclang::Architecture::X64);
-    auto module = irGen.generate(program);
+    std::string path = "syclang_source_buffer_test.syl";
+    {
+        std::ofstream file(path);
+        file << "fn main() -> i32 { return 0; }\n";
+    }
     
-    assert(module != nullptr);
-    assert(!module->functions.empty());
+    // Tokens are slices of the mapping itself, not copies
+    std::string error;
+    auto buffer = syclang::SourceBuffer::open(path, error);
+    assert(buffer != nullptr);
+    assert(buffer->size() == 31);
+    syclang::Lexer lexer(*buffer);
+    auto tokens = lexer.tokenize();
+    assert(tokens[1].value() == "main");
+    assert(tokens[1].value().data() == buffer->data() + 3);
+    std::remove(path.c_str());
     
-    std::cout << "  IR Generation tests passed!\n";
+    assert(syclang::SourceBuffer::open(path, error) == nullptr);
+    assert(!error.empty());
+    
+    // Token positions are 32-bit: 4 GiB (sparse, so nothing is written) is refused
+    {
+        std::ofstream file(path);
+    }
+    std::filesystem::resize_file(path, uint64_t(syclang::SourceBuffer::MAX_SIZE) + 1);
+    error.clear();
+    assert(syclang::SourceBuffer::open(path, error) == nullptr);
+    assert(error.find("too large") != std::string::npos);
+    std::remove(path.c_str());
+    
+    auto memory = syclang::SourceBuffer::fromString("memory", "let x");
+    assert(!memory->isMapped());
+    assert(memory->text() == "let x");
+    
+    std::cout << "  Source buffer tests passed!\n";
+}
+
+void test_thread_pool() {
+    std::cout << "Testing Thread Pool...\n";
+    
+    for (unsigned concurrency : {1u, 4u}) {
+        syclang::ThreadPool pool(concurrency);
+        assert(pool.concurrency() == concurrency);
+        
+        // Every index visited exactly once
+        std::vector<int> visits(1000, 0);
+        syclang::parallelFor(pool, visits.size(), [&](size_t i) { visits[i]++; });
+        for (int count : visits) {
+            assert(count == 1);
+        }
+        
+        // Groups nested inside pool tasks do not deadlock
+        std::atomic<int> leaves(0);
+        syclang::TaskGroup outer(pool);
+        for (int i = 0; i < 8; ++i) {
+            outer.run([&] {
+                syclang::TaskGroup inner(pool);
+                for (int j = 0; j < 8; ++j) {
+                    inner.run([&] { leaves++; });
+                }
+                inner.wait();
+            });
+        }
+        outer.wait();
+        assert(leaves == 64);
+        
+        // Task exceptions surface from wait()
+        syclang::TaskGroup failing(pool);
+        failing.run([] { throw std::runtime_error("task failed"); });
+        bool caught = false;
+        try {
+            failing.wait();
+        } catch (const std::runtime_error&) {
+            caught = true;
+        }
+        assert(caught);
+    }
+    
+    // Parallel codegen joins per-function output in module order
+    std::string source;
+    for (int i = 0; i < 64; ++i) {
+        source += "fn f" + std::to_string(i) + "() -> i64 { let x: i64 = " +
+                  std::to_string(i) + "; return x * 3; }\n";
+    }
+    auto module = buildModule(source);
+    
+    syclang::ThreadPool pool(4);
+    syclang::X64CodeGenerator serialX64, parallelX64;
+    serialX64.generate(module);
+    parallelX64.setThreadPool(&pool);
+    parallelX64.generate(module);
+    assert(serialX64.getOutput() == parallelX64.getOutput());
+    assert(serialX64.getOutput().find("f0:") < serialX64.getOutput().find("f63:"));
+    
+    syclang::ARM64CodeGenerator serialArm, parallelArm;
+    serialArm.generate(module);
+    parallelArm.setThreadPool(&pool);
+    parallelArm.generate(module);
+    assert(serialArm.getOutput() == parallelArm.getOutput());
+    
+    std::cout << "  Thread pool tests passed!\n";
+}
+
+void test_register_allocation() {
+    std::cout << "Testing Register Allocation...\n";
+    
+    std::string source =
+        "fn loop() -> i64 {\n"
+        "    let mut a: i64 = 1;\n"
+        "    let mut b: i64 = 2;\n"
+        "    let mut i: i64 = 0;\n"
+        "    while (i < 10) {\n"
+        "        a = a + b;\n"
+        "        b += helper(a, i);\n"
+        "        i = i + 1;\n"
+        "    }\n"
+        "    return a + b;\n"
+        "}\n";
+    auto module = buildModule(source);
+    const auto& arena = module->arena;
+    const auto& func = *module->functions[0];
+    
+    // Locals carried around the loop stay live across the call
+    syclang::FunctionLiveness liveness(arena, func);
+    bool sawCrossing = false;
+    for (const auto& interval : liveness.intervals()) {
+        assert(interval.start <= interval.end);
+        assert(interval.ranges.front().from == interval.start);
+        assert(interval.ranges.back().to == interval.end);
+        for (size_t r = 1; r < interval.ranges.size(); ++r) {
+            assert(interval.ranges[r - 1].to + 1 < interval.ranges[r].from);
+        }
+        if (arena.value(interval.value).name.rfind("i.", 0) == 0) {
+            assert(interval.crossesCall);
+            sawCrossing = true;
+        }
+    }
+    assert(sawCrossing);
+
+    // A parameter read after a call that opens the entry block lives
+    // across it
+    {
+        auto leading = buildModule("fn first(c: i64) -> i64 { helper(1); return c; }");
+        syclang::FunctionLiveness entry(leading->arena, *leading->functions[0]);
+        assert(entry.intervals().size() == 1);
+        assert(entry.intervals()[0].crossesCall);
+    }
+
+    // With one register, v1 is evicted to a slot after v0's slot interval
+    // has ended, though the two overlap earlier on
+    auto evictModule = buildModule(
+        "fn evict(p: i64, q: i64) -> i64 {\n"
+        "    let v0: i64 = p + 3;\n"
+        "    let v1: i64 = q + p;\n"
+        "    let v2: i64 = v1 * p;\n"
+        "    let v3: i64 = v2 + v2;\n"
+        "    let v4: i64 = v3 + v1;\n"
+        "    let v5: i64 = v3 * v4;\n"
+        "    let v6: i64 = v1 * p;\n"
+        "    let v7: i64 = v1 + v0;\n"
+        "    let v8: i64 = v1 - v7;\n"
+        "    return v4 + v3 + v1;\n"
+        "}\n");
+    syclang::FunctionLiveness evictLiveness(evictModule->arena, *evictModule->functions[0]);
+    
+    // Overlapping intervals never share a register or a spill slot;
+    // call-crossing values only get callee-saved ones; a tiny register
+    // file forces spills
+    auto allocate = [](const syclang::FunctionLiveness& candidate, size_t registerCount) {
+        std::vector<syclang::AllocatableRegister> registers;
+        for (size_t r = 0; r < registerCount; ++r) {
+            registers.push_back({static_cast<int>(r), r % 2 == 0});
+        }
+        auto allocation = syclang::allocateLinearScan(candidate, registers);
+        const auto& intervals = candidate.intervals();
+        for (size_t i = 0; i < intervals.size(); ++i) {
+            auto loc = allocation.locate(intervals[i].value);
+            assert(loc.kind != syclang::ValueLocation::Kind::NONE);
+            if (loc.kind == syclang::ValueLocation::Kind::REGISTER && intervals[i].crossesCall) {
+                assert(loc.index % 2 == 1);
+            }
+            for (size_t j = i + 1; j < intervals.size(); ++j) {
+                auto other = allocation.locate(intervals[j].value);
+                bool overlap = syclang::FunctionLiveness::overlaps(intervals[i], intervals[j]);
+                if (overlap && other.kind == loc.kind) {
+                    assert(other.index != loc.index);
+                }
+            }
+        }
+        return allocation;
+    };
+    for (size_t registerCount : {1u, 2u, 3u, 10u}) {
+        auto allocation = allocate(liveness, registerCount);
+        assert((allocation.spilledValues > 0) == (registerCount < 10));
+        allocate(evictLiveness, registerCount);
+    }
+    
+    // With enough registers the x64 backend touches no stack slots
+    syclang::X64CodeGenerator x64;
+    x64.generate(module);
+    std::string output = x64.getOutput();
+    assert(output.find(".intel_syntax noprefix") != std::string::npos);
+    assert(output.find("qword ptr [rbp") == std::string::npos);
+    assert(output.find("push rbx") != std::string::npos);
+    
+    std::cout << "  Register allocation tests passed!\n";
+}
+
+void test_graph_coloring() {
+    std::cout << "Testing Graph Coloring...\n";
+    
+    std::string source =
+        "fn sum() -> i64 {\n"
+        "    let mut total: i64 = 0;\n"
+        "    let mut i: i64 = 0;\n"
+        "    while (i < 100) {\n"
+        "        total = total + i * 3;\n"
+        "        i = i + 1;\n"
+        "    }\n"
+        "    let extra: i64 = helper(total, i);\n"
+        "    return total + extra;\n"
+        "}\n";
+    auto module = buildModule(source, syclang::Architecture::ARM64);
+    const auto& arena = module->arena;
+    const auto& func = *module->functions[0];
+    syclang::FunctionLiveness liveness(arena, func);
+    
+    // PHI inputs are copies; most of them coalesce
+    std::vector<syclang::AllocatableRegister> registers;
+    for (int r = 0; r < 8; ++r) {
+        registers.push_back({r, r < 4});
+    }
+    auto allocation = syclang::allocateGraphColoring(arena, func, liveness, registers);
+    assert(allocation.spilledValues == 0);
+    assert(allocation.coalescedMoves > 0);
+    for (const auto& interval : liveness.intervals()) {
+        auto loc = allocation.locate(interval.value);
+        assert(loc.kind == syclang::ValueLocation::Kind::REGISTER);
+        if (arena.value(interval.value).name.rfind("total.", 0) == 0) {
+            assert(loc.index >= 4); // Live across the call: callee-saved
+        }
+    }
+    
+    // Two registers are not enough; spills that never overlap share slots
+    auto tight = syclang::allocateGraphColoring(arena, func, liveness, {{0, true}, {1, false}});
+    assert(tight.spilledValues > 0);
+    assert(tight.spillSlots <= tight.spilledValues);
+    
+    // The loop runs entirely in registers and stats are reported per function
+    syclang::ARM64CodeGenerator arm;
+    arm.generate(module);
+    std::string output = arm.getOutput();
+    size_t loop = output.find("while.body");
+    size_t exit = output.find("while.exit", loop);
+    assert(loop != std::string::npos && exit != std::string::npos);
+    assert(output.substr(loop, exit - loop).find("[sp") == std::string::npos);
+    assert(arm.getAllocationStats().size() == 1);
+    assert(arm.getAllocationStats()[0].function == "sum");
+    assert(arm.getAllocationStats()[0].coalescedMoves > 0);
+    assert(arm.formatAllocationStats().find("sum") != std::string::npos);
+    
+    std::cout << "  Graph coloring tests passed!\n";
+}
+
+void test_x64_assembler() {
+    std::cout << "Testing x64 Assembler...\n";
+    
+    // Bytes and relocations as GNU as produces them
+    syclang::ObjectCode object = syclang::assembleX64(
+        ".intel_syntax noprefix\n"
+        ".section .text\n"
+        ".global f\n"
+        "f:\n"
+        "    push rbp\n"
+        "    mov rbp, rsp\n"
+        "    mov rax, qword ptr [rip + g]\n"
+        "    add rax, 1000\n"
+        "    mov byte ptr [r12 + 3], sil\n"
+        "    vpaddd ymm8, ymm9, ymm10\n"
+        "    call h\n"
+        "    leave\n"
+        "    ret\n"
+        ".section .data\n"
+        ".global g\n"
+        "g:\n"
+        "    .zero 8\n");
+    const std::vector<uint8_t> expected = {
+        0x55, 0x48, 0x89, 0xe5, 0x48, 0x8b, 0x05, 0x00, 0x00, 0x00, 0x00, 0x48,
+        0x05, 0xe8, 0x03, 0x00, 0x00, 0x41, 0x88, 0x74, 0x24, 0x03, 0xc4, 0x41,
+        0x35, 0xfe, 0xc2, 0xe8, 0x00, 0x00, 0x00, 0x00, 0xc9, 0xc3};
+    assert(object.text == expected);
+    assert(object.data.size() == 8);
+    assert(object.relocations.size() == 2);
+    assert(object.relocations[0].symbol == "g" && object.relocations[0].offset == 7);
+    assert(object.relocations[0].type == syclang::RelocationType::PC32 && object.relocations[0].addend == -4);
+    assert(object.relocations[1].symbol == "h" && object.relocations[1].offset == 0x1c);
+    assert(object.relocations[1].type == syclang::RelocationType::PLT32);
+    const syclang::ObjectSymbol* f = object.findSymbol("f");
+    assert(f && f->section == syclang::Section::TEXT && f->offset == 0 && f->size == expected.size());
+    assert(object.findSymbol("g")->section == syclang::Section::DATA);
+    
+    // Branches are rel8 where they reach and rel32 where they do not
+    std::string body;
+    for (int i = 0; i < 130; ++i) body += "    nop\n";
+    object = syclang::assembleX64("top:\n    jne top\n    jmp end\n" + body + "end:\n    je top\n");
+    assert(object.text.size() == 2 + 5 + 130 + 6);
+    assert(object.text[0] == 0x75 && object.text[1] == 0xfe);
+    assert(object.text[2] == 0xe9 && object.text[3] == 130);
+    assert(object.text[137] == 0x0f && object.text[138] == 0x84);
+    
+    bool threw = false;
+    try {
+        syclang::assembleX64("    jmp nowhere\n");
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+    threw = false;
+    try {
+        syclang::assembleX64("    frobnicate rax\n");
+    } catch (const std::runtime_error& e) {
+        threw = std::string(e.what()).find("frobnicate") != std::string::npos;
+    }
+    assert(threw);
+    
+    // The code generator's machine code is its assembly text, assembled
+    std::string source =
+        "fn sq(x: i64) -> i64 { return x * x; }\n"
+        "fn run(n: i64) -> i64 {\n"
+        "    let mut s: i64 = 0;\n"
+        "    let mut i: i64 = 0;\n"
+        "    while (i < n) { s = s + sq(i); i = i + 1; }\n"
+        "    return s;\n"
+        "}\n";
+    auto module = buildModule(source);
+    syclang::X64CodeGenerator text;
+    text.generate(module);
+    syclang::X64CodeGenerator machine;
+    assert(machine.canEmitObjectCode());
+    machine.setEmitObjectCode(true);
+    machine.generate(module);
+    assert(machine.getOutput().empty());
+    const syclang::ObjectCode& code = machine.getObjectCode();
+    assert(code.text == syclang::assembleX64(text.getOutput()).text);
+    assert(code.findSymbol("sq") && code.findSymbol("run")->offset == code.findSymbol("sq")->size);
+    
+    // In a flat image the call to sq points at sq
+    std::vector<uint8_t> image = syclang::linkFlatImage(code);
+    const syclang::Relocation& call = code.relocations[0];
+    assert(call.symbol == "sq");
+    int32_t displacement = 0;
+    std::memcpy(&displacement, &image[call.offset], 4);
+    assert(static_cast<int64_t>(call.offset) + 4 + displacement == 0);
+    
+    syclang::ObjectCode unresolved = syclang::assembleX64("    call missing\n");
+    threw = false;
+    try {
+        syclang::linkFlatImage(unresolved);
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+    
+    std::cout << "  x64 assembler tests passed!\n";
+}
+
+void test_elf_writer() {
+    std::cout << "Testing ARM64 Assembler and ELF Writer...\n";
+    
+    // Words as llvm-mc encodes them; bl and the :lo12: pair are relocated
+    syclang::ObjectCode arm = syclang::assembleArm64(
+        ".global f\n"
+        "f:\n"
+        "    stp x29, x30, [sp, #-16]!\n"
+        "loop:\n"
+        "    mov x0, #-16\n"
+        "    adrp x16, g\n"
+        "    ldr x1, [x16, :lo12:g]\n"
+        "    add v0.4s, v1.4s, v2.4s\n"
+        "    bl h\n"
+        "    b.ge loop\n"
+        "    ldp x29, x30, [sp], #16\n"
+        "    ret\n");
+    const uint32_t words[] = {0xa9bf7bfd, 0x928001e0, 0x90000010, 0xf9400201, 0x4ea28420,
+                              0x94000000, 0x54ffff6a, 0xa8c17bfd, 0xd65f03c0};
+    assert(arm.text.size() == sizeof(words));
+    assert(std::memcmp(arm.text.data(), words, sizeof(words)) == 0);
+    assert(arm.relocations.size() == 3);
+    assert(arm.relocations[0].type == syclang::RelocationType::ADR_PREL_PG_HI21 && arm.relocations[0].offset == 8);
+    assert(arm.relocations[1].type == syclang::RelocationType::LDST64_ABS_LO12_NC);
+    assert(arm.relocations[2].type == syclang::RelocationType::CALL26 && arm.relocations[2].symbol == "h");
+    bool threw = false;
+    try {
+        syclang::assembleArm64("    cbz x0, nowhere\n");
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+    
+    // A relocatable object reads back as the code it was written from
+    syclang::ObjectCode object = syclang::assembleX64(
+        ".intel_syntax noprefix\n"
+        ".global main\n"
+        "main:\n"
+        "    mov rax, qword ptr [rip + answer]\n"
+        "    call helper\n"
+        "    ret\n"
+        ".section .data\n"
+        ".global answer\n"
+        "answer:\n"
+        "    .zero 8\n");
+    object.data[0] = 42;
+    std::vector<uint8_t> elf = syclang::writeElfObject(object, syclang::Architecture::X64);
+    assert(elf.size() > 64 && elf[0] == 0x7f && elf[1] == 'E' && elf[4] == 2 && elf[16] == 1 && elf[18] == 62);
+    syclang::ObjectCode back = syclang::readElfObject(elf, "unit.o", syclang::Architecture::X64);
+    assert(back.text == object.text && back.data == object.data);
+    assert(back.relocations.size() == 2 && back.relocations[1].symbol == "helper");
+    assert(back.relocations[0].addend == -4 && back.relocations[0].offset == 3);
+    assert(back.findSymbol("main") && back.findSymbol("answer")->section == syclang::Section::DATA);
+    
+    // ar archives link every member
+    std::string header = "unit.o/";
+    header.resize(48, ' ');
+    header += std::to_string(elf.size());
+    header.resize(58, ' ');
+    header += "`\n";
+    std::vector<uint8_t> archive(header.begin(), header.end());
+    archive.insert(archive.begin(), {'!', '<', 'a', 'r', 'c', 'h', '>', '\n'});
+    archive.insert(archive.end(), elf.begin(), elf.end());
+    back = syclang::readElfObject(archive, "lib.a", syclang::Architecture::X64);
+    assert(back.text == object.text && back.relocations.size() == 2);
+    threw = false;
+    try {
+        syclang::readElfObject(elf, "unit.o", syclang::Architecture::ARM64);
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+    
+    // An executable needs every symbol; _start is added to call main
+    threw = false;
+    try {
+        syclang::writeElfExecutable(object, syclang::Architecture::X64);
+    } catch (const std::runtime_error& e) {
+        threw = std::string(e.what()).find("helper") != std::string::npos;
+    }
+    assert(threw);
+    object.append(syclang::assembleX64(".global helper\nhelper:\n    ret\n"));
+    std::vector<uint8_t> executable = syclang::writeElfExecutable(object, syclang::Architecture::X64);
+    assert(executable[16] == 2);
+    uint64_t entry = 0;
+    std::memcpy(&entry, &executable[24], 8);
+    assert(entry >= 0x400000 && entry < 0x400000 + executable.size());
+    // The first segment maps the file from its start, so the entry's
+    // file offset is its distance from the base
+    assert(executable[entry - 0x400000] == 0x31); // xor ebp, ebp
+    threw = false;
+    try {
+        syclang::writeElfExecutable(syclang::assembleX64("f:\n    ret\n"), syclang::Architecture::X64);
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+    
+    // ARM64 machine code is the ARM64 assembly text, assembled
+    std::string source = "fn sq(x: i64) -> i64 { return x * x; }\n"
+                         "fn main() -> i64 { return sq(7); }\n";
+    auto module = buildModule(source, syclang::Architecture::ARM64);
+    syclang::ARM64CodeGenerator text;
+    text.generate(module);
+    syclang::ARM64CodeGenerator machine;
+    machine.setEmitObjectCode(true);
+    machine.generate(module);
+    assert(machine.getObjectCode().text == syclang::assembleArm64(text.getOutput()).text);
+    executable = syclang::writeElfExecutable(machine.getObjectCode(), syclang::Architecture::ARM64);
+    assert(executable[18] == 183);
+    
+    std::cout << "  ARM64 assembler and ELF writer tests passed!\n";
+}
+
+// Run a static executable and return its exit status
+int runExecutable(const std::vector<uint8_t>& image, const std::string& name) {
+    std::string path = (std::filesystem::temp_directory_path() / name).string();
+    {
+        std::ofstream out(path, std::ios::binary);
+        out.write(reinterpret_cast<const char*>(image.data()), static_cast<std::streamsize>(image.size()));
+    }
+    chmod(path.c_str(), 0755);
+    pid_t child = fork();
+    if (child == 0) {
+        execl(path.c_str(), path.c_str(), static_cast<char*>(nullptr));
+        _exit(127);
+    }
+    int status = 0;
+    waitpid(child, &status, 0);
+    std::remove(path.c_str());
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+void test_stack_arguments() {
+    std::cout << "Testing Stack-Passed Arguments...\n";
+    
+    // Eight arguments leave two for the stack, nine leave three and need
+    // padding to keep the call aligned
+    std::string source =
+        "fn w8(a: i64, b: i64, c: i64, d: i64, e: i64, f: i64, g: i64, h: i64) -> i64 {\n"
+        "    return a + b * 2 + c * 3 + d * 4 + e * 5 + f * 6 + g * 7 + h * 8;\n"
+        "}\n"
+        "fn w9(a: i64, b: i64, c: i64, d: i64, e: i64, f: i64, g: i64, h: i64, i: i64) -> i64 {\n"
+        "    return a + b * 2 + c * 3 + d * 4 + e * 5 + f * 6 + g * 7 + h * 8 + i * 9;\n"
+        "}\n"
+        "fn main() -> i64 {\n"
+        "    return w8(1, 2, 3, 4, 5, 6, 7, 8) + w9(1, 2, 3, 4, 5, 6, 7, 8, 9) - 285;\n"
+        "}\n";
+    for (int level = 0; level <= 2; ++level) {
+        auto module = buildModule(source);
+        syclang::Optimizer optimizer;
+        optimizer.setOptimizationLevel(level);
+        optimizer.optimize(module);
+        
+        syclang::X64CodeGenerator x64;
+        x64.setPeephole(level > 0);
+        x64.setEmitObjectCode(true);
+        x64.generate(module);
+        auto executable = syclang::writeElfExecutable(x64.getObjectCode(), syclang::Architecture::X64);
+#if defined(__linux__) && defined(__x86_64__)
+        assert(runExecutable(executable, "syclang_stack_arguments_x64") == 204);
+#endif
+        
+        syclang::ARM64CodeGenerator arm;
+        arm.setPeephole(level > 0);
+        arm.setEmitObjectCode(true);
+        arm.generate(module);
+        executable = syclang::writeElfExecutable(arm.getObjectCode(), syclang::Architecture::ARM64);
+#if defined(__linux__) && defined(__aarch64__)
+        assert(runExecutable(executable, "syclang_stack_arguments_arm64") == 204);
+#endif
+    }
+    
+    // ARM64 stores the extra arguments at the bottom of the caller's
+    // frame, which the callee reads above its frame record
+    syclang::ARM64CodeGenerator arm;
+    arm.generate(buildModule(source, syclang::Architecture::ARM64));
+    std::string output = arm.getOutput();
+    size_t main = output.find("\nmain:\n");
+    assert(main != std::string::npos);
+    size_t outgoing = output.find("    str x9, [sp, #0]\n", main);
+    assert(outgoing > output.find("bl w8", main) && outgoing < output.find("bl w9", main));
+    assert(output.find("[sp, #0]", output.find("bl w9", main)) == std::string::npos); // Saves sit above it
+    assert(output.find("[x29, #16]") < main);
+    
+    std::cout << "  Stack-passed argument tests passed!\n";
+}
+
+void test_pe_writer() {
+    std::cout << "Testing PE/EFI Writer...\n";
+    
+    auto read32 = [](const std::vector<uint8_t>& bytes, size_t at) {
+        return static_cast<uint32_t>(bytes[at] | bytes[at + 1] << 8 | bytes[at + 2] << 16 | bytes[at + 3] << 24);
+    };
+    syclang::ObjectCode object = syclang::assembleArm64(
+        ".global efi_main\n"
+        "helper:\n"
+        "    ret\n"
+        "efi_main:\n"
+        "    b helper\n");
+    object.defineData("table", 8, 8);
+    object.relocations.push_back({syclang::Section::DATA, 0, "efi_main", syclang::RelocationType::ABS64, 0});
+    std::vector<uint8_t> efi = syclang::writePeImage(object, syclang::Architecture::ARM64, syclang::OutputFormat::EFI);
+    assert(efi[0] == 'M' && efi[1] == 'Z');
+    size_t pe = read32(efi, 0x3C);
+    assert(efi[pe] == 'P' && efi[pe + 1] == 'E' && efi[pe + 2] == 0);
+    assert((efi[pe + 4] | efi[pe + 5] << 8) == 0xAA64);
+    size_t optional = pe + 24;
+    assert((efi[optional] | efi[optional + 1] << 8) == 0x20B);
+    assert(efi[optional + 68] == 10); // EFI application
+    // Text at 0x1000, entered at efi_main directly: the AArch64 calling
+    // conventions agree
+    assert(read32(efi, optional + 16) == 0x1004);
+    // Data on the next page holds efi_main's address, with a DIR64 fixup
+    // in the base relocation directory
+    uint32_t relocations = read32(efi, optional + 112 + 5 * 8);
+    assert(relocations == 0x3000 && read32(efi, optional + 112 + 5 * 8 + 4) == 12);
+    size_t sections = optional + 240;
+    assert(std::string(reinterpret_cast<const char*>(&efi[sections + 40])) == ".data");
+    assert(read32(efi, read32(efi, sections + 40 + 20)) == 0x1004);
+    size_t relocationFile = read32(efi, sections + 80 + 20);
+    assert(read32(efi, relocationFile) == 0x2000 && read32(efi, relocationFile + 8) == 0xA000);
+    assert(efi == syclang::writePeImage(object, syclang::Architecture::ARM64, syclang::OutputFormat::EFI));
+    
+    // On x64 the entry point is a thunk from the Microsoft convention
+    std::string source = "fn efi_main(image: i64, table: i64) -> i64 { return table; }\n";
+    auto module = buildModule(source);
+    syclang::X64CodeGenerator codegen;
+    codegen.setEmitObjectCode(true);
+    codegen.generate(module);
+    efi = syclang::writePeImage(codegen.getObjectCode(), syclang::Architecture::X64, syclang::OutputFormat::EFI);
+    assert((efi[pe + 4] | efi[pe + 5] << 8) == 0x8664);
+    uint32_t entry = read32(efi, optional + 16);
+    size_t text = read32(efi, sections + 20);
+    assert(entry > 0x1000 && efi[text + entry - 0x1000] == 0x57); // push rdi
+    assert(read32(efi, optional + 112 + 5 * 8) == 0); // Nothing to fix up
+    
+    // Windows programs start at main
+    bool threw = false;
+    try {
+        syclang::writePeImage(codegen.getObjectCode(), syclang::Architecture::X64, syclang::OutputFormat::PE);
+    } catch (const std::runtime_error& e) {
+        threw = std::string(e.what()).find("'main'") != std::string::npos;
+    }
+    assert(threw);
+    threw = false;
+    try {
+        syclang::writePeImage(syclang::assembleX64(".global efi_main\nefi_main:\n    jmp missing\n"),
+                              syclang::Architecture::X64, syclang::OutputFormat::EFI);
+    } catch (const std::runtime_error& e) {
+        threw = std::string(e.what()).find("missing") != std::string::npos;
+    }
+    assert(threw);
+    
+    std::cout << "  PE/EFI writer tests passed!\n";
+}
+
+void test_compile_cache() {
+    std::cout << "Testing Compile Cache...\n";
+    
+    // MurmurHash3 x64 128, as the reference implementation computes it
+    assert(syclang::hashContent("") == "00000000000000000000000000000000");
+    assert(syclang::hashContent("hello world") == "533f6046eb7f610eab97467d60eb63b1");
+    assert(syclang::hashContent("The quick brown fox jumps over the lazy dog") ==
+           "e34bbc7bbc071b6c7a433ca9c49a9347");
+    assert(syclang::hashContent("0123456789abcdefg") == "8e32612daa45f9de0800f4c206c372ee");
+    
+    std::string key = syclang::CompileCache::keyFor("fn main() {}", "arch=0 O=1");
+    assert(key.size() == 32);
+    assert(key == syclang::CompileCache::keyFor("fn main() {}", "arch=0 O=1"));
+    assert(key != syclang::CompileCache::keyFor("fn main() {}", "arch=0 O=2"));
+    assert(key != syclang::CompileCache::keyFor("fn main() { }", "arch=0 O=1"));
+    
+    namespace fs = std::filesystem;
+    fs::path directory = fs::temp_directory_path() / ("syclang_cache_test_" + key);
+    fs::remove_all(directory);
+    syclang::CompileCache cache(directory.string());
+    assert(!cache.lookup(key));
+    std::string output("binary\0output", 13);
+    assert(cache.store(key, output));
+    auto hit = cache.lookup(key);
+    assert(hit && *hit == output);
+    assert(cache.hits() == 1 && cache.misses() == 1);
+    
+    // A damaged entry is a miss, and storing again repairs it
+    fs::path entry = directory / key.substr(0, 2) / key.substr(2);
+    assert(fs::file_size(entry) > output.size());
+    {
+        std::fstream file(entry, std::ios::binary | std::ios::in | std::ios::out);
+        file.seekp(-1, std::ios::end);
+        file.put('X');
+    }
+    assert(!cache.lookup(key));
+    fs::resize_file(entry, 10);
+    assert(!cache.lookup(key));
+    assert(cache.store(key, output) && cache.lookup(key) == output);
+    assert(std::distance(fs::directory_iterator(entry.parent_path()), fs::directory_iterator()) == 1);
+    fs::remove_all(directory);
+    
+    std::cout << "  Compile cache tests passed!\n";
+}
+
+void test_binary_ir() {
+    std::cout << "Testing Binary IR...\n";
+    
+    std::string source =
+        "fn square(x: i64) -> i64 { return x * x; }\n"
+        "fn sum(n: i64) -> i64 {\n"
+        "    let mut s: i64 = 0;\n"
+        "    let mut i: i64 = 0;\n"
+        "    while (i < n) {\n"
+        "        if (i > 3) { s = s + square(i); } else { s = s - 1; }\n"
+        "        i = i + 1;\n"
+        "    }\n"
+        "    return s;\n"
+        "}\n";
+    auto module = buildModule(source);
+    syclang::ValueId global = module->arena.createVariable(syclang::IRType::I64, "counter");
+    module->arena.value(global).isGlobal = true;
+    module->addGlobalVariable(global);
+    syclang::Optimizer optimizer;
+    optimizer.setOptimizationLevel(2);
+    optimizer.optimize(module);
+    size_t phis = 0;
+    for (const auto& func : module->functions) {
+        phis += countOpcode(module->arena, *func, syclang::Opcode::PHI);
+    }
+    assert(phis > 0);
+    
+    // Written to disk and mapped back, the module prints and compiles the same
+    std::string bytes = syclang::writeBinaryIR(*module);
+    assert(syclang::isBinaryIR(bytes) && bytes.size() < module->dump().size());
+    std::string path = (std::filesystem::temp_directory_path() / "syclang_binary_ir_test.bir").string();
+    {
+        std::ofstream file(path, std::ios::binary);
+        file << bytes;
+    }
+    std::string error;
+    auto reader = syclang::BinaryIRReader::open(path, error);
+    assert(reader && error.empty());
+    assert(reader->targetArch() == syclang::Architecture::X64 && reader->functionCount() == module->functions.size());
+    auto loaded = reader->load();
+    assert(loaded->dump() == module->dump());
+    assert(loaded->globalVariables.size() == 1 && loaded->arena.value(loaded->globalVariables[0]).name == "counter");
+    syclang::X64CodeGenerator original;
+    original.generate(module);
+    syclang::X64CodeGenerator reloaded;
+    reloaded.generate(loaded);
+    assert(original.getOutput() == reloaded.getOutput());
+    
+    // Functions decode one at a time, in any order
+    assert(reader->functionName(1) == "sum");
+    auto partial = reader->createModule();
+    auto sum = reader->loadFunction(1, *partial);
+    assert(sum->name == "sum" && partial->functions.size() == 1);
+    assert(sum->blocks.size() == module->functions[1]->blocks.size());
+    std::remove(path.c_str());
+    
+    // Damage is reported, not trusted
+    auto bufferOf = [](std::string contents) {
+        return syclang::SourceBuffer::fromString("damaged.bir", std::move(contents));
+    };
+    std::string versioned = bytes;
+    versioned[4] = 2;
+    assert(!syclang::BinaryIRReader::open(bufferOf(versioned), error) && error.find("version 2") != std::string::npos);
+    assert(!syclang::BinaryIRReader::open(bufferOf(bytes.substr(0, bytes.size() - 1)), error));
+    std::string scrambled = bytes;
+    for (size_t i = 48; i < 80; ++i) scrambled[i] = static_cast<char>(0xFF);
+    reader = syclang::BinaryIRReader::open(bufferOf(scrambled), error);
+    assert(reader);
+    bool threw = false;
+    try {
+        reader->load();
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+    
+    std::cout << "  Binary IR tests passed!\n";
+}
+
+void test_output_buffer() {
+    std::cout << "Testing Output Buffer...\n";
+    
+    syclang::OutputBuffer out;
+    std::string expected;
+    out << "mov " << std::string("rax") << ", " << 42 << '\n';
+    expected += "mov rax, 42\n";
+    out << -7 << " " << std::numeric_limits<int64_t>::min() << " " << std::numeric_limits<uint64_t>::max()
+        << " " << size_t(0) << "\n";
+    expected += "-7 -9223372036854775808 18446744073709551615 0\n";
+    assert(out.str() == expected && out.size() == expected.size());
+    
+    // Pieces larger than a page, and many small ones, split across pages
+    std::string large(syclang::OutputBuffer::PAGE_SIZE * 2 + 17, 'x');
+    out << large;
+    expected += large;
+    for (int i = 0; i < 20000; ++i) {
+        out << "    add r" << i % 16 << ", " << i << "\n";
+        expected += "    add r" + std::to_string(i % 16) + ", " + std::to_string(i) + "\n";
+    }
+    assert(out.str() == expected);
+    
+    // Joining takes over large buffers and copies small ones
+    syclang::OutputBuffer joined;
+    syclang::OutputBuffer small;
+    small << "small\n";
+    joined.append(std::move(small));
+    joined.append(std::move(out));
+    assert(small.empty() && out.empty());
+    assert(joined.str() == "small\n" + expected);
+    joined.clear();
+    assert(joined.empty() && joined.str().empty());
+    
+    // With a file attached, pages go to the file and the rest on flush()
+    namespace fs = std::filesystem;
+    fs::path path = fs::temp_directory_path() / "syclang_output_buffer_test.s";
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    assert(fd >= 0);
+    syclang::OutputBuffer streamed;
+    streamed.setFile(fd);
+    streamed << expected;
+    assert(streamed.size() == expected.size() && streamed.str().size() < syclang::OutputBuffer::PAGE_SIZE);
+    assert(streamed.flush() && streamed.str().empty());
+    ::close(fd);
+    std::ifstream file(path, std::ios::binary);
+    std::string written((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    assert(written == expected);
+    
+    // Code generators stream the same assembly they would return
+    std::string source;
+    for (int i = 0; i < 1500; ++i) {
+        source += "fn g" + std::to_string(i) + "(a: i64, b: i64) -> i64 { return a * " + std::to_string(i) +
+                  " + b; }\n";
+    }
+    auto module = buildModule(source);
+    syclang::ThreadPool pool(4);
+    syclang::X64CodeGenerator inMemory;
+    inMemory.generate(module);
+    fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    syclang::X64CodeGenerator toFile;
+    toFile.setThreadPool(&pool);
+    toFile.setOutputFile(fd);
+    toFile.generate(module);
+    syclang::OutputBuffer rest = toFile.takeOutput();
+    assert(rest.size() == inMemory.getOutput().size() && rest.str().size() < rest.size());
+    assert(rest.flush());
+    ::close(fd);
+    file = std::ifstream(path, std::ios::binary);
+    written.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    assert(written == inMemory.getOutput());
+    fs::remove(path);
+    
+    std::cout << "  Output buffer tests passed!\n";
+}
+
+void test_peephole() {
+    std::cout << "Testing Peephole Optimization...\n";
+
+    auto rewrite = [](const std::string& text, syclang::PeepholeStats (*pass)(std::vector<syclang::MachineInstruction>&),
+                      syclang::PeepholeStats& stats) {
+        auto code = syclang::decodeMachineCode(text);
+        stats = pass(code);
+        syclang::OutputBuffer out;
+        syclang::printMachineCode(code, out);
+        return out.str();
+    };
+
+    // Copies, constants, load-op-store, zeroing, compares with zero and
+    // multiplies by 9, all within what liveness allows
+    syclang::PeepholeStats stats;
+    std::string x64 = rewrite(
+        ".intel_syntax noprefix\n"
+        "g:\n"
+        "    push rbp\n"
+        "    mov rbp, rsp\n"
+        "    mov rax, rax\n"
+        "    mov rcx, 5\n"
+        "    add rdi, rcx\n"
+        "    mov rax, qword ptr [rbp - 8]\n"
+        "    add rax, rdi\n"
+        "    mov qword ptr [rbp - 8], rax\n"
+        "    push rsi\n"
+        "    pop rdx\n"
+        "    mov rax, 0\n"
+        "    cmp rdx, 0\n"
+        "    je g.done\n"
+        "    mov rcx, rdx\n"
+        "    imul rcx, 9\n"
+        "    mov rax, rcx\n"
+        "g.done:\n"
+        "    leave\n"
+        "    ret\n",
+        syclang::peepholeX64, stats);
+    assert(x64 ==
+           ".intel_syntax noprefix\n"
+           "g:\n"
+           "    push rbp\n"
+           "    mov rbp, rsp\n"
+           "    add rdi, 5\n"
+           "    add qword ptr [rbp - 8], rdi\n"
+           "    mov rdx, rsi\n"
+           "    xor eax, eax\n"
+           "    test rdx, rdx\n"
+           "    je g.done\n"
+           "    lea rax, [rdx + rdx*8]\n"
+           "g.done:\n"
+           "    leave\n"
+           "    ret\n");
+    assert(stats.instructions == 18 && stats.removed == 7);
+    assert(stats.redundantMoves > 0 && stats.foldedImmediates == 1 && stats.memoryCombined == 1 &&
+           stats.shorterForms > 0);
+    assert(syclang::assembleX64(x64).text.size() > 0);
+
+    // The flags from `add` reach `jne`, so mov 0 may not become xor
+    x64 = rewrite("f:\n    add rdi, rsi\n    mov rax, 0\n    jne f\n    ret\n", syclang::peepholeX64, stats);
+    assert(x64 == "f:\n    add rdi, rsi\n    mov eax, 0\n    jne f\n    ret\n");
+
+    // test r, r encodes like GNU as
+    const std::vector<uint8_t> testBytes = {0x48, 0x85, 0xc0, 0x85, 0xd1, 0x4d, 0x85, 0xc8};
+    assert(syclang::assembleX64("    test rax, rax\n    test ecx, edx\n    test r8, r9\n").text == testBytes);
+
+    // ARM64: immediates, store-to-load forwarding, shifted operands, madd
+    // and cbz
+    std::string arm64 = rewrite(
+        "f:\n"
+        "    stp x29, x30, [sp, #-16]!\n"
+        "    mov x29, sp\n"
+        "    sub sp, sp, #16\n"
+        "    mov x9, #3\n"
+        "    add x10, x0, x9\n"
+        "    str x10, [sp, #8]\n"
+        "    ldr x11, [sp, #8]\n"
+        "    mov x12, x11\n"
+        "    lsl x13, x1, #3\n"
+        "    add x12, x12, x13\n"
+        "    mul x14, x12, x1\n"
+        "    add x14, x14, x2\n"
+        "    mov x0, x14\n"
+        "    mov x9, #8\n"
+        "    mul x0, x0, x9\n"
+        "    cmp x0, #0\n"
+        "    b.eq f.done\n"
+        "    mov x9, #255\n"
+        "    and x0, x0, x9\n"
+        "f.done:\n"
+        "    mov sp, x29\n"
+        "    ldp x29, x30, [sp], #16\n"
+        "    ret\n",
+        syclang::peepholeArm64, stats);
+    assert(arm64 ==
+           "f:\n"
+           "    stp x29, x30, [sp, #-16]!\n"
+           "    mov x29, sp\n"
+           "    sub sp, sp, #16\n"
+           "    add x10, x0, #3\n"
+           "    str x10, [sp, #8]\n"
+           "    add x10, x10, x1, lsl #3\n"
+           "    madd x0, x10, x1, x2\n"
+           "    lsl x0, x0, #3\n"
+           "    cbz x0, f.done\n"
+           "    and x0, x0, #255\n"
+           "f.done:\n"
+           "    mov sp, x29\n"
+           "    ldp x29, x30, [sp], #16\n"
+           "    ret\n");
+    assert(stats.instructions == 22 && stats.removed == 9);
+    assert(stats.foldedImmediates == 3 && stats.memoryCombined == 1 && stats.shorterForms == 3);
+    assert(syclang::assembleArm64(arm64).text.size() == 13 * 4);
+
+    // Whole modules: fewer instructions, the same labels, and object code
+    // the in-process assemblers accept
+    std::string source;
+    for (int i = 0; i < 40; ++i) {
+        source += "fn h" + std::to_string(i) + "(a: i64, b: i64) -> i64 {\n"
+                  "    let mut s: i64 = 0;\n"
+                  "    let mut k: i64 = 0;\n"
+                  "    while (k < b) { s = s + a * " + std::to_string(i % 9 + 1) + " + (k ^ 255); k = k + 1; }\n"
+                  "    if (s == 0) { return a; }\n"
+                  "    return s - " + std::to_string(i) + ";\n"
+                  "}\n";
+    }
+    auto module = buildModule(source);
+    // Instruction and label lines
+    auto count = [](const std::string& text, bool labels) {
+        size_t lines = 0;
+        std::istringstream in(text);
+        for (std::string line; std::getline(in, line);) {
+            bool instruction = line.rfind("    ", 0) == 0 && line.find_first_not_of(' ') != std::string::npos &&
+                               line[line.find_first_not_of(' ')] != '.';
+            bool label = !line.empty() && line[0] != ' ' && line.back() == ':';
+            lines += labels ? label : instruction;
+        }
+        return lines;
+    };
+    for (bool arm : {false, true}) {
+        std::unique_ptr<syclang::CodeGenerator> plain, optimized, object;
+        if (arm) {
+            plain = std::make_unique<syclang::ARM64CodeGenerator>();
+            optimized = std::make_unique<syclang::ARM64CodeGenerator>();
+            object = std::make_unique<syclang::ARM64CodeGenerator>();
+        } else {
+            plain = std::make_unique<syclang::X64CodeGenerator>();
+            optimized = std::make_unique<syclang::X64CodeGenerator>();
+            object = std::make_unique<syclang::X64CodeGenerator>();
+        }
+        optimized->setPeephole(true);
+        object->setPeephole(true);
+        object->setEmitObjectCode(true);
+        plain->generate(module);
+        optimized->generate(module);
+        object->generate(module);
+        std::string before = plain->getOutput();
+        std::string after = optimized->getOutput();
+        const syclang::PeepholeStats& total = optimized->getPeepholeStats();
+        assert(plain->getPeepholeStats().instructions == 0);
+        assert(total.instructions == count(before, false));
+        assert(count(after, false) == total.instructions - total.removed && total.removed > 0);
+        assert(count(after, true) == count(before, true));
+        assert(object->getObjectCode().text.size() > 0);
+        assert(object->getPeepholeStats().removed == total.removed);
+    }
+
+    std::cout << "  Peephole tests passed!\n";
 }
 
 int main() {
@@ -60,6 +1881,29 @@ int main() {
         test_lexer();
         test_parser();
         test_ir_generation();
+        test_ir_arena();
+        test_ssa_construction();
+        test_dead_code_elimination();
+        test_constant_propagation();
+        test_value_numbering();
+        test_loop_optimization();
+        test_loop_vectorization();
+        test_function_inlining();
+        test_pass_manager();
+        test_compile_trace();
+        test_scan_kernels();
+        test_source_buffer();
+        test_thread_pool();
+        test_register_allocation();
+        test_graph_coloring();
+        test_x64_assembler();
+        test_elf_writer();
+        test_stack_arguments();
+        test_pe_writer();
+        test_compile_cache();
+        test_binary_ir();
+        test_output_buffer();
+        test_peephole();
         
         std::cout << "\nAll tests passed!\n";
         return 0;